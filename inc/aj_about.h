@@ -207,6 +207,15 @@ AJ_Status AJ_AboutIconHandleGetContent(AJ_Message* msg, AJ_Message* reply);
  */
 void AJ_AboutSetShouldAnnounce();
 
+/**
+ * If AJ_ABOUT_CACHE is set, the serialized bodies of the Announce signal and of GetAboutData
+ * replies are cached. The cache is invalidated by AJ_AboutSetShouldAnnounce(), by changes to the
+ * object list and by the property store when a value changes. An application that supplies its
+ * own property getter must call this function, or AJ_AboutSetShouldAnnounce(), when the values it
+ * returns change.
+ */
+void AJ_AboutInvalidateCache();
+
 /**
  * Sets the announce flag on a list of objects
  *
@@ -169,6 +169,29 @@ typedef AJ_Status (*SendFunction)(void* context, uint8_t* buf, size_t len, size_
 
 void AJ_ARDP_InitFunctions(ReceiveFunction recv, SendFunction send);
 
+/*
+ *      The ARDP connection state for a bus attachment context.
+ */
+typedef struct _AJ_ArdpState AJ_ArdpState;
+
+/*
+ *      Allocate ARDP state for a bus attachment context. Called by AJ_BusContextCreate().
+ *      Returns NULL if the allocation failed.
+ */
+AJ_ArdpState* AJ_ARDP_StateNew(void);
+
+/*
+ *      Free ARDP state allocated by AJ_ARDP_StateNew(). The connection must have been
+ *      disconnected. Called by AJ_BusContextDestroy().
+ */
+void AJ_ARDP_StateFree(AJ_ArdpState* state);
+
+/*
+ *      Select the ARDP state used by the ARDP functions, NULL selects the default state.
+ *      Called by AJ_BusContextSelect().
+ */
+void AJ_ARDP_StateSelect(AJ_ArdpState* state);
+
 #ifdef __cplusplus
 }
 #endif
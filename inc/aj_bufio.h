@@ -71,6 +71,29 @@ typedef AJ_Status (*AJ_TxFunc)(struct _AJ_IOBuffer* buf);
  */
 typedef AJ_Status (*AJ_RxFunc)(struct _AJ_IOBuffer* buf, uint32_t len, uint32_t timeout);
 
+/**
+ * A contiguous piece of data to be sent
+ */
+typedef struct _AJ_IOVec {
+    const uint8_t* data; /**< Start of the data */
+    uint32_t len;        /**< Length of the data */
+} AJ_IOVec;
+
+/**
+ * Function pointer type for an abstracted gathering transmit function. All of the data described
+ * by the vector is sent, in order, before the function returns. The buffer read and write pointers
+ * are not used.
+ *
+ * @param buf      The transmit buffer identifying the connection
+ * @param iov      The pieces of data to send
+ * @param iovCount The number of entries in iov
+ *
+ * @return
+ *         - AJ_OK if all the data was sent
+ *         - AJ_ERR_WRITE if the send failed
+ */
+typedef AJ_Status (*AJ_TxvFunc)(struct _AJ_IOBuffer* buf, const AJ_IOVec* iov, uint16_t iovCount);
+
 #define AJ_IO_BUF_RX     1 /**< I/O direction is receive */
 #define AJ_IO_BUF_TX     2 /**< I/O direction is send */
 
@@ -94,6 +117,7 @@ typedef struct _AJ_IOBuffer {
         AJ_TxFunc send;
         AJ_RxFunc recv;
     };
+    AJ_TxvFunc sendv;   /**< Optional gathering send function, NULL if the transport does not have one */
     uint32_t scope_id;  /**< Scope id of the interface that received an IPV6 packet */
     void* context;      /**< Abstracted context for managing I/O */
 
@@ -114,6 +114,19 @@ typedef void (*AJ_EndManagementFunc)();
 
 #define AJ_MAX_NAME_SIZE 20  /**< Maximum length for a bus unique name */
 
+#if !defined(AJ_MAX_TX_REFS)
+#define AJ_MAX_TX_REFS 4     /**< Maximum number of application buffers referenced by an outgoing message */
+#endif
+
+/**
+ * An application buffer that is sent in place of bytes in the transmit buffer, see AJ_MarshalArrayRef.
+ */
+typedef struct _AJ_TxRef {
+    AJ_IOVec data;       /**< The referenced application data */
+    uint16_t offset;     /**< Offset in the transmit buffer at which the data is sent */
+    uint8_t gap;         /**< Bytes skipped in the transmit buffer to keep the alignment of later arguments */
+} AJ_TxRef;
+
 /**
  * Session description.
  *
@@ -159,6 +172,10 @@ typedef struct _AJ_BusAttachment {
     AJ_Session* sessions;                           /**< Linked list describing all ongoing sessions this bus attachment is involved in */
     AJ_StartManagementFunc startManagementCallback; /**< Callback for the start of a security management session */
     AJ_EndManagementFunc endManagementCallback;     /**< Callback for the end of a security management session */
+    AJ_TxRef txRefs[AJ_MAX_TX_REFS];                /**< Application buffers referenced by the message being marshaled */
+    uint8_t numTxRefs;                              /**< Number of entries in txRefs */
+    uint32_t txRefBytes;                            /**< Total length of the referenced application buffers */
+    struct _AJ_BusContext* context;                 /**< Per-attachment state or NULL to use the default state */
 } AJ_BusAttachment;
 
 /**
@@ -679,6 +696,40 @@ AJ_Status AJ_BusPropSet(AJ_Message* msg, AJ_BusPropSetCallback callback, void* c
  */
 AJ_Status AJ_BusEnableSecurity(AJ_BusAttachment* bus, const uint32_t* suites, size_t numsuites);
 
+/**
+ * Give a bus attachment its own name map, registered objects, reply contexts, timers and transport
+ * state so that more than one bus attachment can be used in a process. Bus attachments that do not
+ * have a context share the default state, which is how a single bus attachment is used.
+ *
+ * The rest of the API operates on the state of the selected bus attachment. AJ_FindBusAndConnect(),
+ * AJ_Disconnect() and AJ_UnmarshalMsg() select the bus attachment they are called with, other
+ * functions such as AJ_RegisterObjects() and AJ_SetTimer() require the application to call
+ * AJ_BusContextSelect() first.
+ *
+ * @param bus  The bus attachment, this must be called before connecting
+ *
+ * @return
+ *          - AJ_OK if the context was created
+ *          - AJ_ERR_RESOURCES if the context could not be allocated
+ */
+AJ_Status AJ_BusContextCreate(AJ_BusAttachment* bus);
+
+/**
+ * Free the context created by AJ_BusContextCreate(). The bus attachment must be disconnected. If
+ * the bus attachment was selected the default state is selected.
+ *
+ * @param bus  The bus attachment
+ */
+void AJ_BusContextDestroy(AJ_BusAttachment* bus);
+
+/**
+ * Select the state of a bus attachment. Selecting a bus attachment that does not have a context
+ * selects the default state.
+ *
+ * @param bus  The bus attachment
+ */
+void AJ_BusContextSelect(const AJ_BusAttachment* bus);
+
 #ifdef __cplusplus
 }
 #endif
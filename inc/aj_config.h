@@ -51,9 +51,22 @@ extern "C" {
 
 /* Network options */
 #define AJ_CONNECT_LOCALHOST        0           //Enable to bypass discovery and connect locally
+#if !defined(AJ_MAX_TIMERS)
 #define AJ_MAX_TIMERS               4           //maximum number of timers              (aj_helper.c)
+#endif
 #define AJ_ROUTING_NODE_BLACKLIST_SIZE 16       //maximum number of blacklisted routing nodes
-#define AJ_ROUTING_NODE_RESPONSELIST_SIZE 3     //maximum number of routing node responses to track
+#if !defined(AJ_ROUTING_NODE_RESPONSELIST_SIZE)
+#define AJ_ROUTING_NODE_RESPONSELIST_SIZE 8     //maximum number of routing node responses to track
+#endif
+#define AJ_ROUTING_NODE_PROBE_COUNT 4           //number of best routing node responses probed in parallel (aj_connect.c)
+#define AJ_ROUTING_NODE_PROBE_TIMEOUT 1000      //how long to wait for the first probed routing node to answer
+#define AJ_ROUTING_NODE_PROBE_GRACE 100         //how long to wait for the other probed routing nodes once one has answered
+#define AJ_ROUTING_NODE_RTT_WEIGHT  32          //priority added per millisecond of measured round trip time
+#if !defined(AJ_ROUTING_NODE_CACHE)
+#define AJ_ROUTING_NODE_CACHE       1           //remember the last good routing node for each prefix in NVRAM (aj_connect.c)
+#endif
+#define AJ_ROUTING_NODE_CACHE_SIZE  4           //number of prefixes with a cached routing node
+#define AJ_ROUTING_NODE_CACHE_MAX_FAILURES 2    //consecutive failures before a cached routing node is no longer tried first
 #define AJ_TX_DATA_SIZE             5000        //minimum size of network transmit buffer
 #define AJ_RX_DATA_SIZE             5000        //minimum size of network receive buffer
 
@@ -64,11 +77,19 @@ extern "C" {
 #define AJ_MASTER_SECRET_LEN        48          //Length of the master secret - RFC 5246
 #define AJ_SESSION_KEY_LEN          16          //Length of the session key (for AES128-CCM)
 #define AJ_ADHOC_LEN                16          //AD-HOC maximal passcode length        (aj_auth.h)
+#if !defined(AJ_NAME_MAP_GUID_SIZE)
 #define AJ_NAME_MAP_GUID_SIZE       4           //aj_guid.c
+#endif
+#if !defined(AJ_MAX_CREDS)
 #define AJ_MAX_CREDS                40          //Max number of credentials that can store credentials (aj_creds.h)
+#endif
+#if !defined(AJ_CREDS_INDEX)
+#define AJ_CREDS_INDEX              0           //Keep the type, id hash and expiration of each credential slot in RAM (aj_creds.c)
+#endif
 #define AJ_LOCAL_GUID_NV_ID         AJ_NVRAM_ID_CREDS_BEGIN
 #define AJ_CREDS_NV_ID_BEGIN        (AJ_LOCAL_GUID_NV_ID + 1)
 #define AJ_CREDS_NV_ID_END          (AJ_CREDS_NV_ID_BEGIN + AJ_MAX_CREDS)
+#define AJ_ROUTING_NODE_CACHE_NV_ID AJ_NVRAM_ID_FRAMEWORK_BEGIN     //routing node cache (aj_connect.c)
 
 
 /* Timeouts */
@@ -96,11 +117,65 @@ extern "C" {
 #define AJ_MAX_OBJECT_LISTS      (9)               //maximum number of object lists        (aj_introspect.c)
 #endif
 
+#if !defined(AJ_MSGID_INDEX_SIZE)
+#define AJ_MSGID_INDEX_SIZE      (0)               //slots in the message id lookup index, 0 to disable (aj_introspect.c)
+#endif
+
+#if !defined(AJ_INTROSPECT_CACHE_SIZE)
+#define AJ_INTROSPECT_CACHE_SIZE (0)               //introspection documents cached by object path and language, 0 to disable (aj_introspect.c)
+#endif
+
+#if !defined(AJ_MSG_ARENA_SIZE)
+#define AJ_MSG_ARENA_SIZE        (0)               //bytes per chunk of the per-message arena for unmarshal temporaries, 0 to use the heap (aj_msg.c)
+#endif
+
+/* Pool allocator */
+#if !defined(AJ_POOL_STATS)
+#define AJ_POOL_STATS               0           //Count allocs, failures, borrows and use per pool for AJ_PoolGetStats() (aj_malloc.c)
+#endif
+#if !defined(AJ_POOL_INDEX)
+#define AJ_POOL_INDEX               0           //Select pools with a size lookup table in the heap, one byte per AJ_HEAP_POOL_ROUNDING bytes of the largest pool (aj_malloc.c)
+#endif
+
 /* Crypto */
 #define AJ_CCM_TRACE                0           //Enables fine-grained tracing for debugging new implementations.
+#if !defined(AJ_AES_KEY_CACHE)
+#define AJ_AES_KEY_CACHE            0           //Keep expanded session and group keys in the name map (aj_guid.c)
+#endif
+
+/* Serial */
+#if !defined(AJ_CRC16_SLICING)
+#define AJ_CRC16_SLICING            0           //Fold four bytes per step with 1.5KB of extra tables (aj_crc16.c)
+#endif
+
+/* NVRAM */
+#if !defined(AJ_NVRAM_JOURNAL)
+#define AJ_NVRAM_JOURNAL            0           //Map the NVRAM block files and journal changes instead of rewriting the files, POSIX only (aj_target_nvram.c)
+#endif
+#if !defined(AJ_NVRAM_INDEX_SIZE)
+#define AJ_NVRAM_INDEX_SIZE         (0)         //slots in the NVRAM entry index, 0 to disable (aj_nvram.c)
+#endif
+#if !defined(AJ_NVRAM_JOURNAL_SIZE)
+#define AJ_NVRAM_JOURNAL_SIZE       4096        //journal bytes per block before the mapping is synced to the block file (aj_target_nvram.c)
+#endif
+
+/* Threading */
+#if !defined(AJ_THREAD_LOCAL)
+#define AJ_THREAD_LOCAL                         //storage class of per-thread bus state, empty on single-threaded targets
+#endif
+#if !defined(AJ_SHARED_LOCK)
+#define AJ_SHARED_LOCK()                        //serializes NVRAM, credentials and random number generation across threads, must be recursive (aj_nvram.c, aj_creds.c)
+#define AJ_SHARED_UNLOCK()
+#endif
 
 #define _SO_REUSEPORT               0       //Linux target
 
+/* About */
+#if !defined(AJ_ABOUT_CACHE)
+#define AJ_ABOUT_CACHE              0           //Cache the serialized Announce and GetAboutData bodies (aj_about.c)
+#endif
+#define AJ_ABOUT_CACHE_LANGUAGES    2           //number of languages with a cached GetAboutData reply (aj_about.c)
+
 /* About client Announcement buffer */
 #define AJ_MAX_NUM_OF_OBJ_DESC      (32)           //number of object descriptions in an Announcement payload (aj_about.c)
 #define AJ_MAX_NUM_OF_INTERFACES    (16)           //number of interfaces per object description in an Annoucement payload (aj_about.c)
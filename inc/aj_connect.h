@@ -169,6 +169,52 @@ AJ_Status AJ_SelectRoutingNodeFromResponseList(AJ_Service* service);
 
 uint8_t AJ_GetRoutingNodeResponseListSize();
 
+#ifdef AJ_NET_PROBE
+/**
+ * Probe the best routing nodes in the response list in parallel. The measured round trip times
+ * are folded into the score used by AJ_SelectRoutingNodeFromResponseList() and routing nodes that
+ * refuse the connection are not selected. If none of the routing nodes answer the list is left
+ * unchanged.
+ *
+ * @param timeout  How long to wait for the first routing node to answer
+ *
+ * @return
+ *          - AJ_OK if the list was probed or there was nothing to probe
+ *          - An error status if none of the routing nodes answered
+ */
+AJ_Status AJ_ProbeRoutingNodeResponseList(uint32_t timeout);
+#endif
+
+/**
+ * Get the routing node cached for a service name prefix. AJ_FindBusAndConnect() connects to the
+ * cached routing node directly and only runs discovery if that fails. Only available when
+ * AJ_ROUTING_NODE_CACHE is enabled.
+ *
+ * @param prefix        The service name prefix
+ * @param[out] service  Returns the cached routing node
+ *
+ * @return
+ *          - AJ_OK if a routing node is cached and has not failed too often
+ *          - AJ_ERR_NO_MATCH if there is no usable routing node for the prefix
+ */
+AJ_Status AJ_GetCachedRoutingNode(const char* prefix, AJ_Service* service);
+
+/**
+ * Record the result of connecting to a routing node. A successful connection makes the routing
+ * node the cached one for the prefix, a failed connection counts against the cached routing node
+ * if it is the same one.
+ *
+ * @param prefix     The service name prefix
+ * @param service    The routing node
+ * @param connected  TRUE if the connection succeeded
+ */
+void AJ_CacheRoutingNode(const char* prefix, const AJ_Service* service, uint8_t connected);
+
+/**
+ * Forget all the cached routing nodes
+ */
+void AJ_ClearRoutingNodeCache(void);
+
 /**
  * Clear the list of blacklisted routing nodes.
  */
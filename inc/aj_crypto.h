@@ -42,6 +42,32 @@
 extern "C" {
 #endif
 
+/*
+ * Set AJ_AES_CT to build the constant-time bitsliced AES backend (aj_crypto_aes_ct.c) instead of
+ * the table based backend (aj_sw_crypto.c)
+ */
+#if !defined(AJ_AES_CT)
+#define AJ_AES_CT 0
+#endif
+
+/**
+ * Number of words in an expanded AES-128 key schedule
+ */
+#if AJ_AES_CT
+#define AJ_AES_SCHEDULE_LEN (48 + 88)
+#else
+#define AJ_AES_SCHEDULE_LEN 48
+#endif
+
+/**
+ * An expanded AES-128 key. A key that is used for many messages can be expanded once with
+ * AJ_AES_ExpandKey and passed to AJ_Encrypt_CCM_Key and AJ_Decrypt_CCM_Key instead of expanding
+ * the raw key for every message.
+ */
+typedef struct _AJ_AES_Key {
+    uint32_t schedule[AJ_AES_SCHEDULE_LEN]; /**< The expanded key schedule */
+} AJ_AES_Key;
+
 /**
  * Implements AES-CCM (Counter with CBC-MAC) encryption as described in RFC 3610. The message in
  * encrypted in place.
@@ -91,6 +117,118 @@ AJ_Status AJ_Decrypt_CCM(const uint8_t* key,
                          const uint8_t* nonce,
                          uint32_t nLen);
 
+/**
+ * Implements AES-CCM encryption using an expanded key, see AJ_Encrypt_CCM.
+ *
+ * @param aesKey  The expanded AES-128 encryption key
+ * @param msg     The buffer containing the entire message that is to be encrypted
+ * @param msgLen  The length of the entire message
+ * @param hdrLen  The length of the header portion that will be authenticated but not encrypted
+ * @param tagLen  The length of the authentication tag to be appended to the message
+ * @param nonce   The nonce
+ * @param nLen    The length of the nonce
+ *
+ * @return
+ *         - AJ_OK if the CCM context is initialized
+ *         - AJ_ERR_RESOURCES if the resources required are not available.
+ */
+AJ_Status AJ_Encrypt_CCM_Key(const AJ_AES_Key* aesKey,
+                             uint8_t* msg,
+                             uint32_t msgLen,
+                             uint32_t hdrLen,
+                             uint8_t tagLen,
+                             const uint8_t* nonce,
+                             uint32_t nLen);
+
+/**
+ * Implements AES-CCM decryption using an expanded key, see AJ_Decrypt_CCM.
+ *
+ * @param aesKey  The expanded AES-128 encryption key
+ * @param msg     The buffer containing the entire message to be decrypted.
+ * @param msgLen  The length of the entire message, excluding the tag.
+ * @param hdrLen  The length of the header portion that will be authenticated but not encrypted
+ * @param tagLen  The length of the authentication tag to be appended to the message
+ * @param nonce   The nonce
+ * @param nLen    The length of the nonce
+ *
+ * @return
+ *         - AJ_OK if the CCM context is initialized
+ *         - AJ_ERR_RESOURCES if the resources required are not available.
+ */
+AJ_Status AJ_Decrypt_CCM_Key(const AJ_AES_Key* aesKey,
+                             uint8_t* msg,
+                             uint32_t msgLen,
+                             uint32_t hdrLen,
+                             uint8_t tagLen,
+                             const uint8_t* nonce,
+                             uint32_t nLen);
+
+/**
+ * State for AES-CCM encryption or decryption of a message body that is presented in several
+ * pieces, for example when a message is sent or received in chunks.
+ */
+typedef struct _AJ_CCM_Stream {
+    AJ_AES_Key key;       /**< The expanded key */
+    uint8_t ctr[16];      /**< Counter block for CTR mode */
+    uint8_t mac[16];      /**< Running CBC-MAC */
+    uint8_t s0[16];       /**< Key stream block that encrypts the authentication tag */
+    uint8_t ks[16];       /**< Key stream for a block that spans two pieces */
+    uint8_t mb[16];       /**< Plaintext for a block that spans two pieces */
+    uint8_t pos;          /**< Offset into the spanning block */
+    uint8_t tagLen;       /**< Length of the authentication tag */
+    uint8_t decrypt;      /**< TRUE if decrypting */
+} AJ_CCM_Stream;
+
+/**
+ * Start AES-CCM encryption or decryption of a message body that will be processed in pieces by
+ * AJ_CCM_Update. The message header must be contiguous and is authenticated immediately.
+ *
+ * @param ccm      The stream state to initialize
+ * @param aesKey   The expanded AES-128 key, this is copied into the stream state
+ * @param hdr      The header portion that will be authenticated but not encrypted
+ * @param msgLen   The length of the entire message excluding the tag
+ * @param hdrLen   The length of the header portion
+ * @param tagLen   The length of the authentication tag
+ * @param nonce    The nonce
+ * @param nLen     The length of the nonce
+ * @param decrypt  TRUE to decrypt, FALSE to encrypt
+ *
+ * @return
+ *         - AJ_OK if the stream state is initialized
+ *         - AJ_ERR_RESOURCES if the resources required are not available.
+ */
+AJ_Status AJ_CCM_Start(AJ_CCM_Stream* ccm,
+                       const AJ_AES_Key* aesKey,
+                       const uint8_t* hdr,
+                       uint32_t msgLen,
+                       uint32_t hdrLen,
+                       uint8_t tagLen,
+                       const uint8_t* nonce,
+                       uint32_t nLen,
+                       uint8_t decrypt);
+
+/**
+ * Encrypt or decrypt the next piece of the message body in place. Pieces can be any length.
+ *
+ * @param ccm   The stream state
+ * @param data  The data to encrypt or decrypt
+ * @param len   The length of the data
+ */
+void AJ_CCM_Update(AJ_CCM_Stream* ccm, uint8_t* data, uint32_t len);
+
+/**
+ * Complete the authentication tag and clear the stream state. When encrypting the encrypted tag is
+ * written to the tag buffer, when decrypting the tag in the buffer is decrypted and verified.
+ *
+ * @param ccm  The stream state
+ * @param tag  Buffer for the tagLen byte authentication tag
+ *
+ * @return
+ *         - AJ_OK if the tag was written or verified
+ *         - AJ_ERR_SECURITY if the tag did not verify
+ */
+AJ_Status AJ_CCM_Final(AJ_CCM_Stream* ccm, uint8_t* tag);
+
 /**
  * Return a string of randomly generated bytes.
  *
@@ -120,11 +258,28 @@ AJ_Status AJ_RandHex(char* rand, uint32_t bufLen, uint32_t len);
  */
 void AJ_AES_Enable(const uint8_t* key);
 
+/**
+ * Enable AES using a key that has already been expanded. The expanded key must remain valid until
+ * AJ_AES_Disable is called.
+ *
+ * @param aesKey  The expanded key
+ */
+void AJ_AES_EnableKey(const AJ_AES_Key* aesKey);
+
 /**
  * Disable AES freeing any resources that were allocated
  */
 void AJ_AES_Disable(void);
 
+/**
+ * Expand an AES-128 key. The expanded key should be cleared with AJ_MemZeroSecure when it is no
+ * longer needed.
+ *
+ * @param aesKey  Returns the expanded key
+ * @param key     The 16 byte key to expand
+ */
+void AJ_AES_ExpandKey(AJ_AES_Key* aesKey, const uint8_t* key);
+
 /**
  * Compare two buffers in constant time. For any two inputs buf1 and buf2, and
  * fixed count, the function will use the same number of cycles.
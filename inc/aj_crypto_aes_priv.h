@@ -74,6 +74,58 @@ void AJ_AES_CBC_128_ENCRYPT(const uint8_t* key, const uint8_t* in, uint8_t* out,
  */
 void AJ_AES_ECB_128_ENCRYPT(const uint8_t* key, const uint8_t* in, uint8_t* out);
 
+/**
+ * Single pass AES CCM over the message body. Each block is encrypted or decrypted in counter mode
+ * and the plaintext block is added to the CBC-MAC in the same pass.
+ *
+ * @param key      The AES encryption key
+ * @param data     The data to encrypt or decrypt in place
+ * @param len      The length of the data, the final block may be partial
+ * @param ctr      Pointer to the 16 byte counter block, this is updated
+ * @param mac      Pointer to the 16 byte CBC-MAC, this is updated
+ * @param decrypt  TRUE to decrypt the data, FALSE to encrypt it
+ */
+void AJ_AES_CCM_128(const uint8_t* key, uint8_t* data, uint32_t len, uint8_t* ctr, uint8_t* mac, uint8_t decrypt);
+
+/*
+ * AES-NI is used on x86-64 if the processor supports it
+ */
+#if !defined(AJ_AES_NI)
+#if defined(__x86_64__) && defined(__GNUC__)
+#define AJ_AES_NI 1
+#else
+#define AJ_AES_NI 0
+#endif
+#endif
+
+#if AJ_AES_NI
+/**
+ * Check if the processor supports the AES-NI instructions
+ *
+ * @return TRUE if AES-NI is available
+ */
+uint8_t AJ_AESNI_Available(void);
+
+/**
+ * Enable or disable the use of AES-NI, this is used to compare the performance of the backends
+ *
+ * @param enable  TRUE to use AES-NI if the processor supports it, FALSE to use the software backend
+ */
+void AJ_AESNI_Enable(uint8_t enable);
+
+/**
+ * AES-NI implementation of AJ_AES_CCM_128
+ *
+ * @param schedule The expanded key
+ * @param data     The data to encrypt or decrypt in place
+ * @param len      The length of the data, the final block may be partial
+ * @param ctr      Pointer to the 16 byte counter block, this is updated
+ * @param mac      Pointer to the 16 byte CBC-MAC, this is updated
+ * @param decrypt  TRUE to decrypt the data, FALSE to encrypt it
+ */
+void AJ_AESNI_CCM_128(const uint32_t* schedule, uint8_t* data, uint32_t len, uint8_t* ctr, uint8_t* mac, uint8_t decrypt);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -77,6 +77,21 @@ typedef struct _AJ_Service {
  */
 AJ_Status AJ_Discover(const char* prefix, AJ_Service* service, uint32_t timeout, uint32_t selectionTimeout);
 
+/**
+ * Parse an mDNS response looking for a routing node that advertises a name with the prefix. This is
+ * called by AJ_Discover() for every mDNS packet received. Packets that do not contain the prefix are
+ * rejected before any records are parsed and only records for the GUID in the SRV record are looked at.
+ *
+ * @param rxBuf    The buffer holding the response
+ * @param prefix   The service name prefix
+ * @param service  Returns information about the routing node if there was a match
+ *
+ * @return
+ *          - AJ_OK if the response is from a routing node that advertises the prefix
+ *          - AJ_ERR_NO_MATCH otherwise
+ */
+AJ_Status AJ_ParseMDNSResponse(AJ_IOBuffer* rxBuf, const char* prefix, AJ_Service* service);
+
 #ifdef __cplusplus
 }
 #endif
@@ -39,6 +39,7 @@
 #include <ajtcl/aj_target.h>
 #include <ajtcl/aj_status.h>
 #include <ajtcl/aj_bus.h>
+#include <ajtcl/aj_crypto.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -91,6 +92,33 @@ AJ_Status AJ_GUID_FromString(AJ_GUID* guid, const char* str);
  */
 void AJ_GUID_ClearNameMap(void);
 
+/**
+ * The name map for a bus attachment context
+ */
+typedef struct _AJ_NameMapState AJ_NameMapState;
+
+/**
+ * Allocate the name map for a bus attachment context. Called by AJ_BusContextCreate().
+ *
+ * @return The new name map or NULL if the allocation failed
+ */
+AJ_NameMapState* AJ_GUID_NameMapStateNew(void);
+
+/**
+ * Free a name map allocated by AJ_GUID_NameMapStateNew(), session keys held in the map are cleared.
+ * Called by AJ_BusContextDestroy().
+ *
+ * @param state  The name map to free
+ */
+void AJ_GUID_NameMapStateFree(AJ_NameMapState* state);
+
+/**
+ * Select the name map that the name map functions operate on. Called by AJ_BusContextSelect().
+ *
+ * @param state  The name map to select or NULL to select the default name map
+ */
+void AJ_GUID_NameMapStateSelect(AJ_NameMapState* state);
+
 /**
  * Adds a unique name to the GUID map.
  *
@@ -220,6 +248,37 @@ AJ_Status AJ_GetRemoteUniqueName(const char* name, const char** unique);
  */
 AJ_Status AJ_GetGroupKey(const char* name, uint8_t* key);
 
+/**
+ * Gets the expanded session key for an entry from the GUID map. The key is expanded once when the
+ * session key is set so it does not need to be expanded for every message. Only available when
+ * AJ_AES_KEY_CACHE is enabled.
+ *
+ * @param name         The unique or well-known name for a remote peer
+ * @param aesKey       Returns a pointer to the expanded session key, this is only valid until the
+ *                     entry is changed or deleted
+ * @param role         Indicates which peer initiated the session key
+ * @param authVersion  Indicates the authentication version associated with this key
+ *
+ * @return  Return AJ_Status
+ *          - AJ_OK if the key was obtained
+ *          - AJ_ERR_NO_MATCH if there is no entry to the peer
+ */
+AJ_Status AJ_GetSessionAesKey(const char* name, const AJ_AES_Key** aesKey, uint8_t* role, uint32_t* authVersion);
+
+/**
+ * Gets the expanded group key for an entry from the GUID map. Only available when AJ_AES_KEY_CACHE
+ * is enabled.
+ *
+ * @param name    The unique or well-known name for a remote peer or NULL to get the local group key.
+ * @param aesKey  Returns a pointer to the expanded group key, this is only valid until the entry
+ *                is changed or deleted
+ *
+ * @return  Return AJ_Status
+ *          - AJ_OK if the key was obtained
+ *          - AJ_ERR_NO_MATCH if there is no entry to the peer
+ */
+AJ_Status AJ_GetGroupAesKey(const char* name, const AJ_AES_Key** aesKey);
+
 /**
  * Handle an add match reply message
  *
@@ -147,7 +147,8 @@ typedef void (*TimeoutHandler)(void* context);
 /**
  *  Start a timer
  *
- * @param relative_time The time (relative to now) when the timer should first go off
+ * @param relative_time The time (relative to now) when the timer should first go off, at most
+ *                      0x7FFFFFFF milliseconds
  * @param handler       The callback to execute after <relative_time> milliseconds
  * @param context       The context pointer that will be passed into the handler
  * @param repeat        If nonzero, repeat this timer every <repeat> msec
@@ -158,12 +159,51 @@ typedef void (*TimeoutHandler)(void* context);
 uint32_t AJ_SetTimer(uint32_t relative_time, TimeoutHandler handler, void* context, uint32_t repeat);
 
 /**
- *  Cancel the timer specified
+ *  Cancel the timer specified. It is safe to cancel a one-shot timer that has already fired
+ *  provided the id has not been reused by a later call to AJ_SetTimer.
  *
  * @param id    The id of the timer to cancel (returned by AJ_SetTimer)
  */
 void AJ_CancelTimer(uint32_t id);
 
+/**
+ *  Call the handlers for all the timers that have expired. This is called by AJ_RunAllJoynService
+ *  and can be called by applications that run their own message loop. Timers are kept ordered by
+ *  expiry time so the cost is logarithmic in the number of timers set, and expiry times are
+ *  compared in a way that is safe when the millisecond clock wraps.
+ *
+ * @return The time in milliseconds until the next timer is due, or AJ_TIMER_FOREVER if no
+ *         timers are set. This is the longest the caller can sleep without delaying a timer.
+ */
+uint32_t AJ_RunExpiredTimers(void);
+
+/**
+ * Timers for a bus attachment context
+ */
+typedef struct _AJ_TimerState AJ_TimerState;
+
+/**
+ * Allocate the timers for a bus attachment context. Called by AJ_BusContextCreate().
+ *
+ * @return The new timer state or NULL if the allocation failed
+ */
+AJ_TimerState* AJ_TimerStateNew(void);
+
+/**
+ * Free timers allocated by AJ_TimerStateNew(). Called by AJ_BusContextDestroy().
+ *
+ * @param state  The timer state to free
+ */
+void AJ_TimerStateFree(AJ_TimerState* state);
+
+/**
+ * Select the timers that AJ_SetTimer(), AJ_CancelTimer() and AJ_RunExpiredTimers() operate on.
+ * Called by AJ_BusContextSelect().
+ *
+ * @param state  The timer state to select or NULL to select the default timers
+ */
+void AJ_TimerStateSelect(AJ_TimerState* state);
+
 /**
  * Helper function that connects to a bus initializes an AllJoyn service.
  *
@@ -296,6 +336,39 @@ AJ_Status AJ_StartClientByPeerDescription(AJ_BusAttachment* bus,
                                           const AJ_SessionOpts* opts);
 #endif
 
+#ifdef AJ_GATEWAY
+/**
+ * Function run by AJ_GatewayRun() on the thread of a bus attachment
+ *
+ * @param bus      The bus attachment, its context is selected on the calling thread
+ * @param context  The context passed to AJ_GatewayRun()
+ */
+typedef void (*AJ_GatewayFunc)(AJ_BusAttachment* bus, void* context);
+
+/**
+ * Run each bus attachment on its own thread so that discovery, authentication and message
+ * handling for different bus attachments proceed in parallel. The selected bus state is
+ * per-thread so the API is used on each thread exactly as it is for a single bus attachment.
+ * Bus attachments that do not have a context are given one for the duration of the call.
+ *
+ * AJ_Initialize() must be called first. Settings that are not part of the bus context, such as
+ * the About property store and the claim configuration, are shared by all the threads.
+ *
+ * @param buses     Array of bus attachments
+ * @param numBuses  Number of bus attachments
+ * @param func      Function to run on each thread, typically a loop that connects, registers
+ *                  objects and calls AJ_UnmarshalMsg() until the application exits
+ * @param context   Passed to func
+ *
+ * @return
+ *          - AJ_OK once func has returned on every thread
+ *          - AJ_ERR_NULL if buses or func is NULL
+ *          - AJ_ERR_RESOURCES if a context or thread could not be created, threads that were
+ *            started are still run to completion
+ */
+AJ_Status AJ_GatewayRun(AJ_BusAttachment* buses, uint16_t numBuses, AJ_GatewayFunc func, void* context);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -192,6 +192,7 @@ typedef const char* (*AJ_DescriptionLookupFunc)(uint32_t descId, const char* lan
 #define AJ_OBJ_FLAG_ANNOUNCED 0x08  /**< If set this bit indicates this object is announced by ABOUT */
 #define AJ_OBJ_FLAG_IS_PROXY  0x10  /**< If set this bit indicates this object is a proxy object */
 #define AJ_OBJ_FLAG_DESCRIBED 0x20  /**< If set this bit indicates this object has descriptions and is announced by ABOUT with 'org.allseen.Introspectable' interface added to the announcement */
+#define AJ_OBJ_FLAG_STREAMED  0x40  /**< If set this bit indicates that encrypted method calls and signals to this object may be decrypted as they are loaded, see AJ_UnmarshalArrayChunk() */
 
 #define AJ_OBJ_FLAGS_ALL_INCLUDE_MASK 0xFF  /**< The include filter mask for the object iterator indicating ALL objects */
 
@@ -482,7 +483,9 @@ AJ_Status AJ_SetProxyObjectPath(AJ_Object* proxyObjects, uint32_t msgId, const c
 /**
  * Internal function to allocate a reply context for a method call message. Reply contexts are used
  * to associate method replies with method calls. Depending on avaiable system resources the number
- * of reply contexts may be very limited, in some cases only one reply context.
+ * of reply contexts may be very limited, in some cases only one reply context. The number is set by
+ * AJ_NUM_REPLY_CONTEXTS, lookup by serial number and timeout checks do not scan all the contexts so
+ * this can be set to several hundred on platforms with enough memory.
  *
  * @param msg      A method call message that needs a reply context
  * @param timeout  The time to wait for a reply  (0 to use the internal default)
@@ -494,9 +497,49 @@ AJ_Status AJ_SetProxyObjectPath(AJ_Object* proxyObjects, uint32_t msgId, const c
 AJ_Status AJ_AllocReplyContext(AJ_Message* msg, uint32_t timeout);
 
 /**
- * Internal function to release all reply contexts. Called when disconnecting from the bus.
+ * Internal function to release all reply contexts. Called when disconnecting from the bus. Reply
+ * handlers for calls that are still pending are called with a timeout error message.
+ *
+ * @param bus  The bus attachment that is disconnecting
+ */
+void AJ_ReleaseReplyContexts(AJ_BusAttachment* bus);
+
+/**
+ * The registered objects and pending method calls for a bus attachment context
+ */
+typedef struct _AJ_IntrospectState AJ_IntrospectState;
+
+/**
+ * Allocate the object lists and reply contexts for a bus attachment context. Only the standard
+ * objects are registered in the new state. Called by AJ_BusContextCreate().
+ *
+ * @return The new state or NULL if the allocation failed
+ */
+AJ_IntrospectState* AJ_IntrospectStateNew(void);
+
+/**
+ * Free state allocated by AJ_IntrospectStateNew(). Called by AJ_BusContextDestroy().
+ *
+ * @param state  The state to free
+ */
+void AJ_IntrospectStateFree(AJ_IntrospectState* state);
+
+/**
+ * Select the object lists and reply contexts used for registering objects, identifying messages
+ * and matching replies. Called by AJ_BusContextSelect().
+ *
+ * @param state  The state to select or NULL to select the default state
+ */
+void AJ_IntrospectStateSelect(AJ_IntrospectState* state);
+
+/**
+ * Get the number of method calls that are waiting for a reply. Applications that pipeline method
+ * calls can use this to keep the number of calls in flight below AJ_NUM_REPLY_CONTEXTS.
+ *
+ * @return  The number of allocated reply contexts
  */
-void AJ_ReleaseReplyContexts(void);
+AJ_EXPORT
+uint16_t AJ_GetPendingReplyCount(void);
 
 /**
  * Internal function to check for timed out method calls. Returns TRUE and sets some information in
@@ -516,6 +559,35 @@ uint8_t AJ_TimedOutMethodCall(AJ_Message* msg);
  */
 void AJ_ReleaseReplyContext(AJ_Message* msg);
 
+/**
+ * Register a handler for the reply to a method call as an alternative to handling the reply in the
+ * application's message loop. This must be called after AJ_MarshalMethodCall() and before
+ * AJ_DeliverMsg(). When the reply (or a timeout error) is received AJ_UnmarshalMsg() calls the
+ * handler and then continues to wait for the next message, the reply is not returned to the caller.
+ *
+ * The handler must not call AJ_UnmarshalMsg() but can marshal and deliver new messages.
+ *
+ * @param msg      The method call message
+ * @param handler  The function to call with the reply
+ * @param context  An application context passed to the handler
+ *
+ * @return   Return AJ_Status
+ *         - AJ_OK if the handler was registered
+ *         - AJ_ERR_NO_MATCH if there is no reply context for the message
+ */
+AJ_EXPORT
+AJ_Status AJ_SetReplyHandler(const AJ_Message* msg, AJ_ReplyHandler handler, void* context);
+
+/**
+ * Internal function called by AJ_UnmarshalMsg() to pass a method reply to the reply handler
+ * registered for the method call.
+ *
+ * @param msg  A message that has just been unmarshaled
+ *
+ * @return  Returns TRUE if the message was handled and closed, FALSE otherwise.
+ */
+uint8_t AJ_DispatchReplyHandler(AJ_Message* msg);
+
 /**
  * Recursively set and/or clear the object flags on an application object and all the children of
  * the object. This function can be called to disable, hide, or secure and entire object tree. Note
@@ -542,6 +614,16 @@ void AJ_ReleaseReplyContext(AJ_Message* msg);
 AJ_EXPORT
 AJ_Status AJ_SetObjectFlags(const char* objPath, uint8_t setFlags, uint8_t clearFlags);
 
+/**
+ * Discard the cached introspection XML for the selected bus attachment (see AJ_INTROSPECT_CACHE_SIZE).
+ * The cache is flushed when objects are registered, when object flags or proxy object paths are set
+ * through the API, and when the description languages are registered. An application whose
+ * description lookup function returns different descriptions over time must call this function
+ * after the descriptions change.
+ */
+AJ_EXPORT
+void AJ_IntrospectInvalidateCache(void);
+
 /**
  * Returns the member type for a given message or property Id. Returns 0 if the
  * identifier is not a message or property identifier.
@@ -209,13 +209,18 @@ struct _AJ_Message {
      */
     uint8_t sigOffset;         /**< Offset to current position in the signature */
     uint8_t varOffset;         /**< For variant marshalling/unmarshalling - Offset to start of variant signature */
-    uint16_t bodyBytes;        /**< Running count of the number body bytes written */
+    uint32_t bodyBytes;        /**< Running count of the number body bytes written */
     AJ_BusAttachment* bus;     /**< Bus attachment for this message */
     struct _AJ_Arg* outer;     /**< Container arg current being marshaled */
     uint32_t timeout;          /**< Remaining time to wait for all bytes of this message */
     uint32_t authVersion;      /**< Authentication version used */
     uint8_t expired;           /**< For indicating whether the Rx message has expired */
     AJ_MsgHeader raw;          /**< The raw original message header (before endian swaps) */
+    struct _AJ_RxStream* rxStream; /**< Decryption state for a message that is decrypted as it is loaded */
+    uint32_t chunkBytes;       /**< Bytes remaining in an array being unmarshaled in chunks */
+    uint8_t chunkType;         /**< Element type of an array being unmarshaled in chunks */
+    uint8_t useArena;          /**< Unmarshal temporaries for this message can be allocated from an arena */
+    struct _AJ_MsgArena* arena; /**< Arena chunks for unmarshal temporaries, released by AJ_CloseMsg */
 };
 
 /**
@@ -334,6 +339,36 @@ AJ_Status AJ_UnmarshalArgs(AJ_Message* msg, const char* signature, ...);
 AJ_EXPORT
 AJ_Status AJ_UnmarshalRaw(AJ_Message* msg, const void** data, size_t len, size_t* actual);
 
+/**
+ * Unmarshals an array of scalar values in chunks. This allows arrays that are larger than the
+ * network receive buffer to be unmarshaled. Call this function repeatedly until it returns
+ * AJ_ERR_NO_MORE, after which the remaining arguments can be unmarshaled as usual. Each chunk holds
+ * a whole number of array elements.
+ *
+ * Space in the receive buffer is reused to load each chunk so the data pointer is only valid until
+ * the next call and pointers returned for arguments unmarshaled earlier are no longer valid after
+ * the first call. Only top-level arguments can be unmarshaled in chunks.
+ *
+ * Encrypted messages that are too large for the receive buffer are only delivered to objects that
+ * have the AJ_OBJ_FLAG_STREAMED flag set. These messages are authenticated by AJ_CloseMsg() so the
+ * application must not act on the array data until AJ_CloseMsg() has returned AJ_OK.
+ *
+ * @param msg     A pointer to the message currently being unmarshaled
+ * @param typeId  The element type of the array, for example AJ_ARG_BYTE
+ * @param data    Returns a pointer to the next chunk of array data
+ * @param len     Returns the length of the chunk in bytes
+ *
+ * @return
+ *          - AJ_OK if a chunk was unmarshaled
+ *          - AJ_ERR_NO_MORE if the entire array has been unmarshaled
+ *          - AJ_ERR_SIGNATURE if the next argument is not an array of typeId
+ *          - AJ_ERR_UNMARSHAL if the array was badly formed
+ *          - AJ_ERR_UNEXPECTED if the array is not a top-level argument
+ *          - AJ_ERR_READ if there was a read failure
+ */
+AJ_EXPORT
+AJ_Status AJ_UnmarshalArrayChunk(AJ_Message* msg, uint8_t typeId, const void** data, size_t* len);
+
 /**
  * Begin unmarshalling a container argument.
  *
@@ -378,13 +413,47 @@ AJ_Status AJ_UnmarshalVariant(AJ_Message* msg, const char** sig);
  * values are no longer valid so this function should not be called until the message and its
  * arguments are no longer needed.
  *
+ * An encrypted message that is too large for the network receive buffer is decrypted as it is
+ * loaded and cannot be authenticated until all of it has been received. Such messages are only
+ * delivered to objects that have the AJ_OBJ_FLAG_STREAMED flag set, other large encrypted messages
+ * are discarded. For these messages the authentication tag is checked here and the application
+ * must not act on the message contents unless this function returns AJ_OK.
+ *
  * @param msg     The message to close.
  *
- * @return   Return AJ_Status
+ * @return
+ *          - AJ_OK if the message was closed
+ *          - AJ_ERR_SECURITY if the message was decrypted as it was loaded and failed authentication
+ *          - AJ_ERR_READ if there was a read failure
  */
 AJ_EXPORT
 AJ_Status AJ_CloseMsg(AJ_Message* msg);
 
+/**
+ * Allocates memory for a temporary that is only needed while a message is being unmarshaled, for
+ * example the nodes of a certificate chain or policy unmarshaled from the message. For a message
+ * returned by AJ_UnmarshalMsg the memory is carved from an arena that is released in one go when
+ * the message is closed; for other messages (e.g. ones set up by AJ_LocalMsg) the memory comes from
+ * the heap.
+ *
+ * @param msg     The message the temporary belongs to
+ * @param size    The number of bytes to allocate
+ *
+ * @return  A pointer to the memory or NULL if it could not be allocated
+ */
+AJ_EXPORT
+void* AJ_MsgArenaAlloc(AJ_Message* msg, size_t size);
+
+/**
+ * Frees memory returned by AJ_MsgArenaAlloc or AJ_Malloc. Memory that belongs to the arena of an
+ * open message is left for AJ_CloseMsg to release, anything else is returned to the heap. This must
+ * be called before the message the memory was allocated for is closed.
+ *
+ * @param mem     The memory to free, may be NULL
+ */
+AJ_EXPORT
+void AJ_MsgArenaFree(void* mem);
+
 /**
  * Like AJ_CloseMsg(), this function closes an ummarshalled method call and release resources but
  * returns a reply context that can be used later to generate a reply message. This allows an
@@ -426,6 +495,46 @@ typedef uint32_t AJ_SessionId;
 AJ_EXPORT
 AJ_Status AJ_MarshalMethodCall(AJ_BusAttachment* bus, AJ_Message* msg, uint32_t msgId, const char* destination, AJ_SessionId sessionId, uint8_t flags, uint32_t timeout);
 
+/**
+ * Type for a function that handles the reply to a method call.
+ *
+ * @param reply    The method reply or error message. For a timed-out method call this is the
+ *                 internally generated timeout error, also used for calls still pending when
+ *                 the bus disconnects. The message is closed when the handler returns.
+ * @param context  The application context registered with the handler.
+ */
+typedef void (*AJ_ReplyHandler)(AJ_Message* reply, void* context);
+
+/**
+ * Marshal a METHOD_CALL message and register a handler for the reply. This allows an application
+ * to deliver a number of method calls back to back without waiting for each reply. The replies are
+ * passed to the handlers from inside AJ_UnmarshalMsg() as they arrive, in any order, and are not
+ * returned to the application's message loop. See AJ_SetReplyHandler().
+ *
+ * The number of calls that can be in flight is limited by AJ_NUM_REPLY_CONTEXTS.
+ *
+ * @param bus          The bus attachment
+ * @param msg          Pointer to a message structure
+ * @param msgId        The message identifier for this message
+ * @param destination  Bus address of the destination for this message
+ * @param sessionId    The session this message is for.
+ * @param flags        A logical OR of the applicable message flags, must not include
+ *                     AJ_FLAG_NO_REPLY_EXPECTED
+ * @param timeout      Time in milliseconds to allow for a reply to the message before the handler
+ *                     is called with a timeout error message.
+ * @param handler      The function to call with the reply
+ * @param context      An application context passed to the handler
+ *
+ * @return
+ *          - AJ_OK if a message header was succesfully marshaled
+ *          - AJ_ERR_INVALID if no reply is expected
+ *          - AJ_ERR_RESOURCES if the message is too big to marshal into the message buffer or
+ *            there are no reply contexts available
+ *          - AJ_ERR_WRITE if there was a write failure
+ */
+AJ_EXPORT
+AJ_Status AJ_MarshalMethodCallWithHandler(AJ_BusAttachment* bus, AJ_Message* msg, uint32_t msgId, const char* destination, AJ_SessionId sessionId, uint8_t flags, uint32_t timeout, AJ_ReplyHandler handler, void* context);
+
 /**
  * Marshal a SIGNAL message.
  *
@@ -663,6 +772,29 @@ AJ_Status AJ_MarshalArg(AJ_Message* msg, AJ_Arg* arg);
 AJ_EXPORT
 AJ_Status AJ_MarshalRaw(AJ_Message* msg, const void* data, size_t len);
 
+/**
+ * Marshal an array of scalar values by reference. The array data is not copied into the transmit
+ * buffer, it is sent directly from the application buffer when the message is delivered (and
+ * encrypted on the way out if the message is encrypted). The application buffer must not be
+ * modified or freed until AJ_DeliverMsg returns. Arrays referenced this way can be much larger than
+ * the transmit buffer.
+ *
+ * Only top-level arguments can be marshaled by reference, not elements of containers, and a message
+ * with referenced arrays cannot be delivered with AJ_DeliverMsgPartial().
+ *
+ * @param msg     A pointer to the message currently being marshaled
+ * @param typeId  The element type of the array, for example AJ_ARG_BYTE
+ * @param data    The array data
+ * @param len     The length of the array data in bytes
+ *
+ * @return
+ *          - AJ_OK if the array was succesfully marshaled.
+ *          - AJ_ERR_MARSHAL if the array does not match the message signature
+ *          - AJ_ERR_RESOURCES if too many arrays have been referenced
+ */
+AJ_EXPORT
+AJ_Status AJ_MarshalArrayRef(AJ_Message* msg, uint8_t typeId, const void* data, size_t len);
+
 /**
  * Begin marshalling a container argument.
  *
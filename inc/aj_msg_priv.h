@@ -128,6 +128,34 @@ size_t AJ_GetTypeSize(char typeId);
 AJ_EXPORT
 AJ_Status AJ_LookupMessageId(AJ_Message* msg, uint8_t* secure);
 
+/**
+ * Check if an identified message may be decrypted as it is loaded. This is only allowed for method
+ * calls and signals to application objects that have the AJ_OBJ_FLAG_STREAMED flag set and that are
+ * not on the properties interface, so no built-in handler ever sees a message that has not been
+ * authenticated yet.
+ *
+ * @param msg    The message, already identified
+ *
+ * @return  TRUE if the message may be decrypted as it is loaded
+ */
+AJ_EXPORT
+uint8_t AJ_StreamedMessageAllowed(const AJ_Message* msg);
+
+/**
+ * Enable or disable the message id index used by AJ_LookupMessageId(). The index is only compiled
+ * in if AJ_MSGID_INDEX_SIZE is non-zero and is enabled by default. When disabled, or if there are
+ * more members than AJ_MSGID_INDEX_SIZE slots, message ids are found by a linear scan of the object
+ * lists. Both methods return the same message id. The setting applies to the currently selected
+ * bus context.
+ *
+ * Note that the index is only rebuilt when objects are registered or modified through the API, for
+ * example by AJ_SetObjectFlags() or AJ_SetProxyObjectPath().
+ *
+ * @param enable  TRUE to use the index, FALSE to force a linear scan
+ */
+AJ_EXPORT
+void AJ_EnableMessageIdIndex(uint8_t enable);
+
 /**
  * Lookup a property identifier and get the property signature
  *
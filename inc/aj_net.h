@@ -108,10 +108,87 @@ void AJ_Net_MCastDown(AJ_MCastSocket* mcastSock);
 
 /**
  * Function that signals AJ_Net_Recv() to bail out early if it
- * is blocking on select.
+ * is blocking on select. It may be called from any thread. In
+ * gateway builds (AJ_GATEWAY) each thread has its own event loop
+ * and only a wait on the calling thread is interrupted.
  */
 void AJ_Net_Interrupt(void);
 
+#ifdef AJ_NET_EVENT_LOOP
+/**
+ * Function called when a file descriptor added to the network event loop becomes readable.
+ * Readiness is edge-triggered so the handler should read until the read would block.
+ *
+ * @param fd       The file descriptor that is readable
+ * @param context  The context passed to AJ_Net_AddFd()
+ */
+typedef void (*AJ_FdHandler)(int fd, void* context);
+
+/**
+ * Add an application file descriptor to the network event loop. The handler is called whenever
+ * the file descriptor becomes readable while the bus attachment is waiting for network I/O or
+ * while the application is calling AJ_Net_Poll().
+ *
+ * @param fd       The file descriptor to add
+ * @param handler  Function to call when the file descriptor becomes readable
+ * @param context  Context passed to the handler
+ *
+ * @return
+ *          - AJ_OK if the file descriptor was added
+ *          - AJ_ERR_RESOURCES if too many file descriptors have been added
+ *          - AJ_ERR_FAILURE if the file descriptor could not be added
+ */
+AJ_Status AJ_Net_AddFd(int fd, AJ_FdHandler handler, void* context);
+
+/**
+ * Remove a file descriptor added by AJ_Net_AddFd() from the network event loop
+ *
+ * @param fd  The file descriptor to remove
+ */
+void AJ_Net_RemoveFd(int fd);
+
+/**
+ * Wait for and dispatch events on the application file descriptors added to the network event
+ * loop. Network sockets that become readable are noted so they can be read later without waiting.
+ *
+ * @param timeout  How long to wait for an event in milliseconds
+ *
+ * @return
+ *          - AJ_OK if at least one event was dispatched
+ *          - AJ_ERR_TIMEOUT if no events were dispatched before the timeout expired
+ *          - AJ_ERR_INTERRUPTED if the wait was interrupted by AJ_Net_Interrupt()
+ *          - AJ_ERR_READ if waiting for events failed
+ */
+AJ_Status AJ_Net_Poll(uint32_t timeout);
+#endif
+
+#ifdef AJ_NET_PROBE
+/**
+ * Round trip time reported for a routing node that could not be reached
+ */
+#define AJ_NET_PROBE_UNREACHABLE 0xFFFFFFFF
+
+/**
+ * Open TCP connections to several routing nodes at the same time and measure how long each one
+ * takes to be accepted. The connections are closed again straight away. Routing nodes that are
+ * down are found in one round trip instead of one connect timeout each.
+ *
+ * @param services     The routing nodes to probe, each must have a TCP4 or TCP6 address
+ * @param numServices  The number of routing nodes
+ * @param[out] rtt     Returns the connect time of each routing node in milliseconds, or
+ *                     AJ_NET_PROBE_UNREACHABLE if the connection was refused or failed
+ * @param timeout      How long to wait for the first routing node to answer
+ * @param grace        How long to wait for the others once the first one has answered. Routing
+ *                     nodes that are still pending are given the time waited so far.
+ *
+ * @return
+ *          - AJ_OK if at least one routing node answered
+ *          - AJ_ERR_CONNECT if none of the routing nodes answered
+ *          - AJ_ERR_RESOURCES if the probe could not be allocated
+ */
+AJ_Status AJ_Net_Probe(const struct _AJ_Service* services, uint8_t numServices, uint32_t* rtt, uint32_t timeout, uint32_t grace);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
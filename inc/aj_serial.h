@@ -53,7 +53,29 @@ extern "C" {
  * maximum and minimum window sizes
  */
 #define MIN_WINDOW_SIZE        1
-#define MAX_WINDOW_SIZE        4
+#define MAX_WINDOW_SIZE        32
+
+/*
+ * Largest window a peer that only has 3 bit sequence numbers can use
+ */
+#define LEGACY_WINDOW_SIZE     4
+
+/*
+ * SLAP version 2 added 6 bit sequence numbers, windows up to MAX_WINDOW_SIZE and selective acks
+ */
+#define SLAP_VERSION_SACK_FEATURE  2
+
+/*
+ * A selective ack payload is the sequence number it is relative to followed by a 32 bit map of
+ * the packets after it that have been received
+ */
+#define AJ_SERIAL_SACK_LEN     5
+
+/*
+ * Bounds in milliseconds on the resend timeout computed from the measured round trip time
+ */
+#define AJ_SERIAL_MIN_RESEND_TIMEOUT  2
+#define AJ_SERIAL_MAX_RESEND_TIMEOUT  2000
 
 /**
  * Packet header is four bytes.
@@ -147,12 +169,22 @@ extern AJ_LinkParameters AJ_SerialLinkParams;
 
 /**
  * Determine relative ordering of two sequence numbers. Sequence numbers are
- * modulo 8 so 0 > 7.
+ * modulo 8 (or 64) so 0 > 7.
  *
  * This is used to test for ACKs and to detect gaps in the sequence of received
  * packets.
  */
-#define SEQ_GT(s1, s2)  (((7 + (s1) - (s2)) & 7) < AJ_SerialLinkParams.windowSize)
+#define SEQ_GT(s1, s2)  (((AJ_SERIAL_SEQ_MASK + (s1) - (s2)) & AJ_SERIAL_SEQ_MASK) < AJ_SerialLinkParams.windowSize)
+
+/**
+ * TRUE if both ends of the link support selective acks and 6 bit sequence numbers.
+ */
+#define AJ_SERIAL_SACK_ENABLED()  (AJ_SerialLinkParams.protoVersion >= SLAP_VERSION_SACK_FEATURE)
+
+/**
+ * Sequence numbers are modulo 64 with selective acks and modulo 8 without.
+ */
+#define AJ_SERIAL_SEQ_MASK  (AJ_SERIAL_SACK_ENABLED() ? 0x3F : 0x07)
 
 
 /**
@@ -164,8 +196,25 @@ extern AJ_LinkParameters AJ_SerialLinkParams;
 /*
  * Handle a link control packet.
  */
-void AJ_SerialLinkPacket(uint8_t* buffer,
-                         uint16_t len);
+void AJ_Serial_LinkPacket(uint8_t* buffer,
+                          uint16_t len);
+
+/**
+ * Run the SLAP state machine once: process received buffers, queue transmit buffers and
+ * fire any expired resend, ack or link control timers.
+ */
+void AJ_StateMachine();
+
+/**
+ * Find the first SLIP special (boundary or escape) byte in a buffer. Runs of ordinary bytes
+ * are tested a machine word at a time so SLIP encode and decode can copy them in bulk.
+ *
+ * @param buf   The bytes to scan
+ * @param len   The number of bytes to scan
+ *
+ * @return  The offset of the first boundary or escape byte, or len if there is none
+ */
+uint16_t AJ_SlipScan(const uint8_t* buf, uint16_t len);
 
 
 /**
@@ -76,17 +76,24 @@ void AJ_SerialTX_EnqueuePkt(uint8_t type,
 
 /**
  * This function is called by the receive layer when a data packet or an explicit ACK
- * has been received. The ACK value is one greater (modulo 8) than the seq number of the
+ * has been received. The ACK value is one greater (modulo the sequence space) than the seq number of the
  * last packet successfully received.
  */
-void AJ_SerialTX_ReceivedAck(uint8_t ack);
+void AJ_SerialTx_ReceivedAck(uint8_t ack);
+
+/**
+ * This function is called by the receive layer when an explicit ACK carries a
+ * selective ack of AJ_SERIAL_SACK_LEN bytes: the peer's next expected sequence
+ * number followed by a big-endian bitmap of the packets it holds after it.
+ */
+void AJ_SerialTx_ReceivedSack(const uint8_t* sack);
 
 
 /**
  * This function is called from the receive side with the sequence number of
  * the last packet received.
  */
-void AJ_SerialTX_ReceivedSeq(uint8_t seq);
+void AJ_SerialTx_ReceivedSeq(uint8_t seq);
 
 /**
  * This function is called from the state machine to resend any data packets
@@ -121,6 +121,28 @@ typedef void (*AJ_SerialTxFunc)(uint8_t* buf, uint32_t len);
  */
 AJ_Status AJ_SerialIOInit(AJ_SerIOConfig* config);
 
+/**
+ * @brief Open and configure the UART used by the serial transport
+ *
+ * @param ttyName  The name of the serial device, for example "/dev/ttyUSB0"
+ * @param bitRate  The bit rate to configure the device for
+ *
+ * @return
+ *          - AJ_OK              if the device was opened and configured
+ *          - AJ_ERR_DRIVER      if the device could not be opened or configured
+ */
+AJ_Status AJ_SerialTargetInit(const char* ttyName, uint32_t bitRate);
+
+/**
+ * @brief Move bytes between the UART and the posted receive and transmit buffers
+ *
+ * Targets without interrupt driven serial I/O define AJ_SERIO_POLL and complete receive and
+ * transmit buffers from this function, which the SLAP state machine calls each time it runs.
+ *
+ * @param timeout  The longest time in milliseconds to wait for the UART to become ready
+ */
+void AJ_SerialIOPoll(uint32_t timeout);
+
 void AJ_SetRxCB(AJ_SerIORxCompleteFunc rx_cb);
 void AJ_SetTxCB(AJ_SerIOTxCompleteFunc tx_cb);
 void AJ_SetTxSerialTransmit(AJ_SerialTxFunc tx_func);
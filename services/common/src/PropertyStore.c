@@ -219,6 +219,7 @@ uint8_t AJSVC_PropertyStore_SetValueForLang(int8_t fieldIndex, int8_t langIndex,
         strncpy(propertyStoreRuntimeValues[fieldIndex].value[langIndex], value, var_size - 1);
         (propertyStoreRuntimeValues[fieldIndex].value[langIndex])[var_size - 1] = '\0';
     }
+    AJ_AboutInvalidateCache(); // The cached About data no longer matches
 
     return TRUE;
 }
@@ -409,6 +410,7 @@ AJ_Status AJSVC_PropertyStore_LoadAll()
             }
         }
     }
+    AJ_AboutInvalidateCache(); // The cached About data no longer matches
 
     return status;
 }
@@ -67,11 +67,115 @@ static struct {
 /*
  * Checked to see if announcements have been requested
  */
-static uint8_t doAnnounce = TRUE;
+static AJ_THREAD_LOCAL uint8_t doAnnounce = TRUE;
+
+#if AJ_ABOUT_CACHE
+/*
+ * A serialized message body. The first entry holds the Announce signal body, the others hold
+ * GetAboutData reply bodies for the most recently requested languages.
+ */
+typedef struct {
+    char* language;
+    uint8_t* body;
+    uint32_t len;
+    uint16_t port;
+} AboutCacheEntry;
+
+static AJ_THREAD_LOCAL AboutCacheEntry aboutCache[1 + AJ_ABOUT_CACHE_LANGUAGES];
+static AJ_THREAD_LOCAL uint8_t aboutCacheNext;
+
+#define ANNOUNCE_CACHE (&aboutCache[0])
+
+static void ClearCacheEntry(AboutCacheEntry* entry)
+{
+    AJ_Free(entry->language);
+    AJ_Free(entry->body);
+    memset(entry, 0, sizeof(AboutCacheEntry));
+}
+
+void AJ_AboutInvalidateCache()
+{
+    size_t i;
+
+    for (i = 0; i < ArraySize(aboutCache); ++i) {
+        ClearCacheEntry(&aboutCache[i]);
+    }
+}
+
+/*
+ * Copy the body of a message that has been fully marshaled into the transmit buffer
+ */
+static void SaveCacheEntry(AboutCacheEntry* entry, AJ_Message* msg)
+{
+    AJ_IOBuffer* ioBuf = &msg->bus->sock.tx;
+
+    AJ_Free(entry->body);
+    entry->body = NULL;
+    entry->len = 0;
+    /*
+     * The body must be contiguous in the transmit buffer and sent in the clear
+     */
+    if (!msg->hdr || msg->bus->numTxRefs || (msg->hdr->flags & AJ_FLAG_ENCRYPTED) || !msg->bodyBytes) {
+        return;
+    }
+    entry->body = AJ_Malloc(msg->bodyBytes);
+    if (entry->body) {
+        memcpy(entry->body, ioBuf->writePtr - msg->bodyBytes, msg->bodyBytes);
+        entry->len = msg->bodyBytes;
+    }
+}
+
+/*
+ * Write a cached body into a message that has only had its header marshaled
+ */
+static AJ_Status MarshalCacheEntry(AJ_Message* msg, const AboutCacheEntry* entry)
+{
+    AJ_Status status = AJ_DeliverMsgPartial(msg, entry->len);
+    if (status == AJ_OK) {
+        status = AJ_MarshalRaw(msg, entry->body, entry->len);
+    }
+    return status;
+}
+
+static AboutCacheEntry* FindLanguage(const char* language)
+{
+    size_t i;
+
+    for (i = 1; i < ArraySize(aboutCache); ++i) {
+        if (aboutCache[i].body && (strcmp(aboutCache[i].language, language) == 0)) {
+            return &aboutCache[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Replace the least recently added language
+ */
+static AboutCacheEntry* AddLanguage(const char* language)
+{
+    AboutCacheEntry* entry = &aboutCache[1 + aboutCacheNext];
+    size_t len = strlen(language) + 1;
+
+    aboutCacheNext = (aboutCacheNext + 1) % AJ_ABOUT_CACHE_LANGUAGES;
+    ClearCacheEntry(entry);
+    entry->language = AJ_Malloc(len);
+    if (!entry->language) {
+        return NULL;
+    }
+    memcpy(entry->language, language, len);
+    return entry;
+}
+#else
+void AJ_AboutInvalidateCache()
+{
+}
+#endif
 
 void AJ_AboutRegisterPropStoreGetter(AJ_AboutPropGetter propGetter)
 {
     PropStoreGetter = propGetter;
+    AJ_AboutInvalidateCache();
 }
 
 /*
@@ -134,7 +238,15 @@ AJ_Status AJ_AboutHandleGetAboutData(AJ_Message* msg, AJ_Message* reply)
 
     status = AJ_UnmarshalArgs(msg, "s", &language);
     if (status == AJ_OK) {
+#if AJ_ABOUT_CACHE
+        AboutCacheEntry* entry = FindLanguage(language);
+#endif
         AJ_MarshalReplyMsg(msg, reply);
+#if AJ_ABOUT_CACHE
+        if (entry && reply->hdr && !(reply->hdr->flags & AJ_FLAG_ENCRYPTED)) {
+            return MarshalCacheEntry(reply, entry);
+        }
+#endif
         if (PropStoreGetter) {
             status = PropStoreGetter(reply, language);
         } else {
@@ -142,6 +254,13 @@ AJ_Status AJ_AboutHandleGetAboutData(AJ_Message* msg, AJ_Message* reply)
         }
         if (status != AJ_OK) {
             status = MarshalDefaultProps(reply);
+#if AJ_ABOUT_CACHE
+        } else {
+            entry = AddLanguage(language);
+            if (entry) {
+                SaveCacheEntry(entry, reply);
+            }
+#endif
         }
     }
     return status;
@@ -250,6 +369,16 @@ AJ_Status AJ_AboutAnnounce(AJ_BusAttachment* bus)
     if (status != AJ_OK) {
         goto ErrorExit;
     }
+#if AJ_ABOUT_CACHE
+    if (ANNOUNCE_CACHE->body && (ANNOUNCE_CACHE->port == bus->aboutPort)) {
+        bus->aboutSerial = announcement.hdr->serialNum;
+        status = MarshalCacheEntry(&announcement, ANNOUNCE_CACHE);
+        if (status != AJ_OK) {
+            goto ErrorExit;
+        }
+        return AJ_DeliverMsg(&announcement);
+    }
+#endif
     status = AJ_MarshalArgs(&announcement, "q", (uint16_t)ABOUT_VERSION);
     if (status != AJ_OK) {
         goto ErrorExit;
@@ -270,6 +399,10 @@ AJ_Status AJ_AboutAnnounce(AJ_BusAttachment* bus)
     if (status != AJ_OK) {
         goto ErrorExit;
     }
+#if AJ_ABOUT_CACHE
+    SaveCacheEntry(ANNOUNCE_CACHE, &announcement);
+    ANNOUNCE_CACHE->port = bus->aboutPort;
+#endif
     bus->aboutSerial = announcement.hdr->serialNum;
     return AJ_DeliverMsg(&announcement);
 
@@ -359,10 +492,12 @@ ErrorExit:
 void AJ_AboutSetShouldAnnounce()
 {
     doAnnounce = TRUE;
+    AJ_AboutInvalidateCache();
 }
 
 void AJ_AboutSetAnnounceObjects(AJ_Object* objList)
 {
+    AJ_AboutInvalidateCache();
     if (objList) {
         while (objList->path) {
             objList->flags |= AJ_OBJ_FLAG_ANNOUNCED;
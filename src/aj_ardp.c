@@ -46,6 +46,7 @@ extern "C" {
 #include <ajtcl/aj_crypto.h>
 #include <ajtcl/aj_debug.h>
 #include <ajtcl/aj_util.h>
+#include <ajtcl/aj_config.h>
 
 #ifdef AJ_DEBUG_BUILD
 uint8_t dbgARDP = 0;
@@ -249,8 +250,6 @@ struct ArdpConnection {
     uint8_t confirm;        /* Flag to indicate that progress happened, do not send ARP re-probe */
 };
 
-static struct ArdpConnection* conn = NULL;
-
 /*
  * Important!!! All our numbers are within window size, the calculation below will hold.
  * If necessary, can add check that delta between the numbers does not exceed half-range.
@@ -267,16 +266,30 @@ static struct ArdpConnection* conn = NULL;
                                   (((tp) ((beg) + (sz)) < (beg)) && !(((p) < (beg)) && (p) >= (tp) ((beg) + (sz)))))
 
 
-/* Housekeeping for data (inside ARDP rBuf) that have been received and potentially not consumed */
-static struct {
-    uint8_t* readBuf;     /* Pointer to current unconsumed data */
-    uint16_t dataLen;     /* How many bytes are left to read */
-    ArdpRBuf* rxContext;  /* Pointer to ARDP rBuf from where the data are being currently consumed */
-} UDP_Recv_State;
+/*
+ * The ARDP state for a bus attachment context
+ */
+typedef struct _AJ_ArdpState {
+    struct ArdpConnection* conn;
+    /* Housekeeping for data (inside ARDP rBuf) that have been received and potentially not consumed */
+    struct {
+        uint8_t* readBuf;     /* Pointer to current unconsumed data */
+        uint16_t dataLen;     /* How many bytes are left to read */
+        ArdpRBuf* rxContext;  /* Pointer to ARDP rBuf from where the data are being currently consumed */
+    } UDP_Recv_State;
+    ReceiveFunction recvFunction;
+    SendFunction sendFunction;
+} AJ_ArdpState;
 
+/*
+ * ARDP state for bus attachments that do not have their own context
+ */
+static AJ_ArdpState defaultArdpState;
 
-static ReceiveFunction recvFunction;
-static SendFunction sendFunction;
+/*
+ * ARDP state for the currently selected bus attachment
+ */
+static AJ_THREAD_LOCAL AJ_ArdpState* ardpState = &defaultArdpState;
 
 /**************
  * End of definitions
@@ -284,8 +297,33 @@ static SendFunction sendFunction;
 
 void AJ_ARDP_InitFunctions(ReceiveFunction rcvFunc, SendFunction sndFunc)
 {
-    recvFunction = rcvFunc;
-    sendFunction = sndFunc;
+    ardpState->recvFunction = rcvFunc;
+    ardpState->sendFunction = sndFunc;
+}
+
+AJ_ArdpState* AJ_ARDP_StateNew(void)
+{
+    AJ_ArdpState* state = (AJ_ArdpState*)AJ_Malloc(sizeof(AJ_ArdpState));
+    if (state) {
+        memset(state, 0, sizeof(AJ_ArdpState));
+    }
+    return state;
+}
+
+void AJ_ARDP_StateFree(AJ_ArdpState* state)
+{
+    if (state) {
+        AJ_ASSERT(!state->conn);
+        if (ardpState == state) {
+            ardpState = &defaultArdpState;
+        }
+        AJ_Free(state);
+    }
+}
+
+void AJ_ARDP_StateSelect(AJ_ArdpState* state)
+{
+    ardpState = state ? state : &defaultArdpState;
 }
 
 static AJ_Status InitConnection()
@@ -293,35 +331,35 @@ static AJ_Status InitConnection()
     uint32_t rand32;
     uint32_t i;
 
-    conn = (struct ArdpConnection*) AJ_Malloc(sizeof(struct ArdpConnection));
-    if (conn == NULL) {
+    ardpState->conn = (struct ArdpConnection*) AJ_Malloc(sizeof(struct ArdpConnection));
+    if (ardpState->conn == NULL) {
         return AJ_ERR_RESOURCES;
     }
-    memset(conn, 0, sizeof(struct ArdpConnection));
+    memset(ardpState->conn, 0, sizeof(struct ArdpConnection));
 
     AJ_RandBytes((uint8_t*) &rand32, sizeof(uint32_t));
-    conn->local = (rand32 % 65534) + 1;  /* Allocate an "ephemeral" source port */
+    ardpState->conn->local = (rand32 % 65534) + 1;  /* Allocate an "ephemeral" source port */
 
     /* Initialize the sender side of the connection */
-    AJ_RandBytes((uint8_t*) &conn->snd.ISS, sizeof(conn->snd.ISS));
-    conn->snd.NXT = conn->snd.ISS + 1; /* The sequence number of the next segment to be sent over this connection */
-    conn->snd.UNA = conn->snd.ISS;     /* The oldest unacknowledged segment is the ISS */
-    conn->snd.LCS = conn->snd.ISS;     /* The most recently consumed segment (we keep this in sync with the other side) */
+    AJ_RandBytes((uint8_t*) &ardpState->conn->snd.ISS, sizeof(ardpState->conn->snd.ISS));
+    ardpState->conn->snd.NXT = ardpState->conn->snd.ISS + 1; /* The sequence number of the next segment to be sent over this connection */
+    ardpState->conn->snd.UNA = ardpState->conn->snd.ISS;     /* The oldest unacknowledged segment is the ISS */
+    ardpState->conn->snd.LCS = ardpState->conn->snd.ISS;     /* The most recently consumed segment (we keep this in sync with the other side) */
 
     for (i = 0; i < UDP_SEGMAX; i++) {
-        conn->snd.buf[i].next = &conn->snd.buf[(i + 1) % UDP_SEGMAX];
+        ardpState->conn->snd.buf[i].next = &ardpState->conn->snd.buf[(i + 1) % UDP_SEGMAX];
     }
 
     for (i = 0; i < UDP_SEGMAX; i++) {
-        conn->rcv.buf[i].next = &conn->rcv.buf[(i + 1) % UDP_SEGMAX];
+        ardpState->conn->rcv.buf[i].next = &ardpState->conn->rcv.buf[(i + 1) % UDP_SEGMAX];
     }
 
-    conn->rttInit = FALSE;
-    conn->rttMean = UDP_INITIAL_DATA_TIMEOUT;
-    conn->rttMeanUnit = UDP_INITIAL_DATA_TIMEOUT;
-    conn->rttMeanVar = 0;
+    ardpState->conn->rttInit = FALSE;
+    ardpState->conn->rttMean = UDP_INITIAL_DATA_TIMEOUT;
+    ardpState->conn->rttMeanUnit = UDP_INITIAL_DATA_TIMEOUT;
+    ardpState->conn->rttMeanVar = 0;
 
-    conn->backoff = 0;
+    ardpState->conn->backoff = 0;
     return AJ_OK;
 }
 
@@ -331,14 +369,14 @@ static void MarshalHeader(uint32_t* buf32, uint8_t flags, uint16_t dlen, uint32_
 
     *(txbuf + FLAGS_OFFSET) = flags;
     *(txbuf + HLEN_OFFSET) = (uint8_t)(ARDP_HEADER_SIZE >> 1);
-    *((uint16_t*) (txbuf + SRC_OFFSET)) = htons(conn->local);
-    *((uint16_t*) (txbuf + DST_OFFSET)) = htons(conn->foreign);
+    *((uint16_t*) (txbuf + SRC_OFFSET)) = htons(ardpState->conn->local);
+    *((uint16_t*) (txbuf + DST_OFFSET)) = htons(ardpState->conn->foreign);
     *((uint16_t*) (txbuf + DLEN_OFFSET)) = htons(dlen);
-    *((uint32_t*) (txbuf + SEQ_OFFSET)) = htonl(conn->snd.NXT);
-    *((uint32_t*) (txbuf + ACK_OFFSET)) = htonl(conn->rcv.CUR);
+    *((uint32_t*) (txbuf + SEQ_OFFSET)) = htonl(ardpState->conn->snd.NXT);
+    *((uint32_t*) (txbuf + ACK_OFFSET)) = htonl(ardpState->conn->rcv.CUR);
     *((uint32_t*) (txbuf + TTL_OFFSET)) = htonl(ttl);
-    *((uint32_t*) (txbuf + LCS_OFFSET)) = htonl(conn->rcv.LCS);
-    *((uint32_t*) (txbuf + ACKNXT_OFFSET)) = htonl(conn->snd.UNA);
+    *((uint32_t*) (txbuf + LCS_OFFSET)) = htonl(ardpState->conn->rcv.LCS);
+    *((uint32_t*) (txbuf + ACKNXT_OFFSET)) = htonl(ardpState->conn->snd.UNA);
     *((uint32_t*) (txbuf + SOM_OFFSET)) = htonl(som);
     *((uint16_t*) (txbuf + FCNT_OFFSET)) = htons(fcnt);
     *((uint16_t*) (txbuf + RSRV_OFFSET)) = 0;
@@ -350,18 +388,18 @@ static AJ_Status SendHeader(uint8_t flags)
     size_t sent;
     AJ_Status status;
 
-    AJ_InfoPrintf(("SendHeader(flags=0x%02x, seq=%u, ack=%u, lcs=%u)\n", flags, conn->snd.NXT, conn->rcv.CUR, conn->rcv.LCS));
+    AJ_InfoPrintf(("SendHeader(flags=0x%02x, seq=%u, ack=%u, lcs=%u)\n", flags, ardpState->conn->snd.NXT, ardpState->conn->rcv.CUR, ardpState->conn->rcv.LCS));
 
     /* Marshal the header structure into a byte buffer */
     MarshalHeader(buf32, flags, 0, ARDP_TTL_INFINITE, 0, 0);
 
     AJ_InfoPrintf(("SendHeader: cancel ackTimer\n"));
-    conn->ackTimer.retry = 0;
-    conn->rcv.pending = 0;
+    ardpState->conn->ackTimer.retry = 0;
+    ardpState->conn->rcv.pending = 0;
 
-    status = (*sendFunction)(conn->context, (uint8_t*) &buf32, ARDP_HEADER_SIZE, &sent, conn->confirm);
+    status = (*ardpState->sendFunction)(ardpState->conn->context, (uint8_t*) &buf32, ARDP_HEADER_SIZE, &sent, ardpState->conn->confirm);
     if (status == AJ_OK) {
-        conn->confirm = FALSE;
+        ardpState->conn->confirm = FALSE;
     }
     return status;
 }
@@ -369,15 +407,15 @@ static AJ_Status SendHeader(uint8_t flags)
 static AJ_Status SendSyn(uint16_t dataLen)
 {
     size_t sent;
-    uint8_t* txbuf = (uint8_t*) &(conn->snd.buf[0].data[0]);
+    uint8_t* txbuf = (uint8_t*) &(ardpState->conn->snd.buf[0].data[0]);
 
     /* Marshal SYN header */
     *(txbuf + FLAGS_OFFSET) = ARDP_FLAG_SYN | ARDP_FLAG_VER;
     *(txbuf + HLEN_OFFSET)  = ARDP_SYN_HEADER_SIZE >> 1;
-    *((uint16_t*) (txbuf + SRC_OFFSET)) = htons(conn->local);
+    *((uint16_t*) (txbuf + SRC_OFFSET)) = htons(ardpState->conn->local);
     *((uint16_t*) (txbuf + DST_OFFSET)) = 0; /* optional, can be removed to reduce code size */
     *((uint16_t*) (txbuf + DLEN_OFFSET)) = htons(dataLen);
-    *((uint32_t*) (txbuf + SEQ_OFFSET)) = htonl(conn->snd.ISS);
+    *((uint32_t*) (txbuf + SEQ_OFFSET)) = htonl(ardpState->conn->snd.ISS);
     *((uint32_t*) (txbuf + ACK_OFFSET)) = 0; /* optional , can be removed to reduce code size*/
     *((uint16_t*) (txbuf + SEGMAX_OFFSET)) = htons(UDP_SEGMAX);
     *((uint16_t*) (txbuf + SEGBMAX_OFFSET)) = htons(UDP_SEGBMAX);
@@ -385,12 +423,12 @@ static AJ_Status SendSyn(uint16_t dataLen)
     *((uint16_t*) (txbuf + OPTIONS_OFFSET)) = htons(ARDP_FLAG_SIMPLE_MODE | ARDP_FLAG_SDM);
     *((uint16_t*) (txbuf + SYN_RSRV_OFFSET)) = 0;
 
-    return (*sendFunction)(conn->context, (uint8_t*) &conn->snd.buf[0].data[0], ARDP_SYN_HEADER_SIZE + dataLen, &sent, FALSE);
+    return (*ardpState->sendFunction)(ardpState->conn->context, (uint8_t*) &ardpState->conn->snd.buf[0].data[0], ARDP_SYN_HEADER_SIZE + dataLen, &sent, FALSE);
 }
 
 static uint8_t IsDataRetransmitScheduled()
 {
-    if (((conn->snd.UNA + 1) != conn->snd.NXT) && (conn->snd.UNA != conn->snd.NXT)) {
+    if (((ardpState->conn->snd.UNA + 1) != ardpState->conn->snd.NXT) && (ardpState->conn->snd.UNA != ardpState->conn->snd.NXT)) {
         return TRUE;
     }
     return FALSE;
@@ -407,27 +445,27 @@ static AJ_Status ConnectTimerHandler()
 {
     AJ_Status status;
 
-    AJ_InfoPrintf(("ConnectTimerHandler: retries left %d\n", conn->connectTimer.retry));
+    AJ_InfoPrintf(("ConnectTimerHandler: retries left %d\n", ardpState->conn->connectTimer.retry));
 
-    if (conn->connectTimer.retry > 1) {
+    if (ardpState->conn->connectTimer.retry > 1) {
         size_t sent;
-        uint16_t len = conn->snd.buf[0].dataLen + ARDP_SYN_HEADER_SIZE;
+        uint16_t len = ardpState->conn->snd.buf[0].dataLen + ARDP_SYN_HEADER_SIZE;
         AJ_InfoPrintf(("ConnectTimerHandler: send %d bytes\n", len));
-        status = (*sendFunction)(conn->context, (uint8_t*) conn->snd.buf[0].data, len, &sent, FALSE);
+        status = (*ardpState->sendFunction)(ardpState->conn->context, (uint8_t*) ardpState->conn->snd.buf[0].data, len, &sent, FALSE);
         if (status == AJ_ERR_WOULD_BLOCK) {
             status = AJ_OK;
         }
-        conn->connectTimer.retry--;
+        ardpState->conn->connectTimer.retry--;
     } else {
         status = AJ_ERR_TIMEOUT;
     }
 
     if (status != AJ_OK) {
-        conn->state = CLOSED;
-        conn->connectTimer.retry = 0;
+        ardpState->conn->state = CLOSED;
+        ardpState->conn->connectTimer.retry = 0;
         AJ_ErrPrintf(("ConnectTimerHandler(): %s\n", AJ_StatusText(status)));
-        AJ_Free(conn);
-        conn = NULL;
+        AJ_Free(ardpState->conn);
+        ardpState->conn = NULL;
         return AJ_ERR_CONNECT;
     } else {
         return AJ_OK;
@@ -438,8 +476,8 @@ static uint32_t GetDataTimeout()
 {
     uint32_t timeout = UDP_TOTAL_DATA_RETRY_TIMEOUT;
 
-    if (conn->rttInit) {
-        timeout = MAX(timeout, (UDP_SEGMAX * UDP_SEGBMAX * (conn->rttMean >> 1)) / UDP_MTU);
+    if (ardpState->conn->rttInit) {
+        timeout = MAX(timeout, (UDP_SEGMAX * UDP_SEGBMAX * (ardpState->conn->rttMean >> 1)) / UDP_MTU);
     }
     return timeout;
 }
@@ -447,10 +485,10 @@ static uint32_t GetDataTimeout()
 static uint32_t GetRTO()
 {
     /* RTO = (rttMean + (4 * rttMeanVar)) << backoff */
-    uint32_t ms = (MAX((uint32_t)ARDP_MIN_RTO, conn->rttMean + (4 * conn->rttMeanVar))) << conn->backoff;
+    uint32_t ms = (MAX((uint32_t)ARDP_MIN_RTO, ardpState->conn->rttMean + (4 * ardpState->conn->rttMeanVar))) << ardpState->conn->backoff;
     AJ_InfoPrintf(("GetRTO(): rto=%u RTO = %u)\n", ms, MIN(ms, (uint32_t)ARDP_MAX_RTO)));
 
-    return MIN(MAX(ms, conn->snd.DACKT), (uint32_t)ARDP_MAX_RTO);
+    return MIN(MAX(ms, ardpState->conn->snd.DACKT), (uint32_t)ARDP_MAX_RTO);
 }
 
 static AJ_Status DataTimerHandler(ArdpSBuf* sBuf)
@@ -479,28 +517,28 @@ static AJ_Status DataTimerHandler(ArdpSBuf* sBuf)
 
             /* Currently, we do not check TTL for in-flight SND packets */
 
-            *((uint32_t*) (txbuf + ACK_OFFSET)) = htonl(conn->rcv.CUR);
-            *((uint32_t*) (txbuf + LCS_OFFSET)) = htonl(conn->rcv.LCS);
-            *((uint32_t*) (txbuf + ACKNXT_OFFSET)) = htonl(conn->snd.UNA);
+            *((uint32_t*) (txbuf + ACK_OFFSET)) = htonl(ardpState->conn->rcv.CUR);
+            *((uint32_t*) (txbuf + LCS_OFFSET)) = htonl(ardpState->conn->rcv.LCS);
+            *((uint32_t*) (txbuf + ACKNXT_OFFSET)) = htonl(ardpState->conn->snd.UNA);
 
-            AJ_InfoPrintf(("DataTimerHandler: send %d bytes (seq %u, ack %u)\n", len, seq, conn->rcv.CUR));
-            status =  (*sendFunction)(conn->context, (uint8_t*) sBuf->data, len, &sent, conn->confirm);
+            AJ_InfoPrintf(("DataTimerHandler: send %d bytes (seq %u, ack %u)\n", len, seq, ardpState->conn->rcv.CUR));
+            status =  (*ardpState->sendFunction)(ardpState->conn->context, (uint8_t*) sBuf->data, len, &sent, ardpState->conn->confirm);
             AJ_InitTimer(&sBuf->timer.tStart);
 
             if (status == AJ_OK) {
-                conn->backoff = MAX(conn->backoff, timer->retry);
-                if (conn->rttInit) {
+                ardpState->conn->backoff = MAX(ardpState->conn->backoff, timer->retry);
+                if (ardpState->conn->rttInit) {
                     timer->delta = GetRTO();
                 } else {
-                    timer->delta = MIN(UDP_INITIAL_DATA_TIMEOUT << conn->backoff, (uint32_t)ARDP_MAX_RTO);
+                    timer->delta = MIN(UDP_INITIAL_DATA_TIMEOUT << ardpState->conn->backoff, (uint32_t)ARDP_MAX_RTO);
                 }
-                AJ_InfoPrintf(("DataTimerHandler: backoff %u, delta %u\n", conn->backoff, timer->delta));
+                AJ_InfoPrintf(("DataTimerHandler: backoff %u, delta %u\n", ardpState->conn->backoff, timer->delta));
 
                 timer->retry++;
                 AJ_InfoPrintf(("DataTimerHandler: cancel ackTimer\n"));
-                conn->ackTimer.retry = 0;
-                conn->rcv.pending = 0;
-                conn->confirm = FALSE;
+                ardpState->conn->ackTimer.retry = 0;
+                ardpState->conn->rcv.pending = 0;
+                ardpState->conn->confirm = FALSE;
             } else {
                 AJ_ErrPrintf(("DataTimerHandler():Write to Socket went bad"));
             }
@@ -516,11 +554,11 @@ static AJ_Status CheckDataTimers()
     uint32_t idx;
 
     /* Check data retransmit timer */
-    idx = conn->snd.UNA % UDP_SEGMAX;
-    if (conn->snd.buf[idx].timer.retry != 0 &&
-        AJ_GetElapsedTime(&conn->snd.buf[idx].timer.tStart, TRUE) >= conn->snd.buf[idx].timer.delta) {
+    idx = ardpState->conn->snd.UNA % UDP_SEGMAX;
+    if (ardpState->conn->snd.buf[idx].timer.retry != 0 &&
+        AJ_GetElapsedTime(&ardpState->conn->snd.buf[idx].timer.tStart, TRUE) >= ardpState->conn->snd.buf[idx].timer.delta) {
         AJ_InfoPrintf(("CheckDataTimers: Fire data timer\n"));
-        return DataTimerHandler(&conn->snd.buf[idx]);
+        return DataTimerHandler(&ardpState->conn->snd.buf[idx]);
     }
     return AJ_OK;
 }
@@ -534,8 +572,8 @@ static AJ_Status CheckTimers()
      * Check connection timer. This timer is alive only when the connection is being established.
      * No other timers should be active on the connection.
      */
-    if (conn->connectTimer.retry != 0) {
-        if (AJ_GetElapsedTime(&conn->connectTimer.tStart, TRUE) >= conn->connectTimer.delta) {
+    if (ardpState->conn->connectTimer.retry != 0) {
+        if (AJ_GetElapsedTime(&ardpState->conn->connectTimer.tStart, TRUE) >= ardpState->conn->connectTimer.delta) {
             AJ_InfoPrintf(("CheckTimers: Fire connection timer\n"));
             return ConnectTimerHandler();
         }
@@ -543,27 +581,27 @@ static AJ_Status CheckTimers()
     }
 
     /* Check probe timer, it's always turned on */
-    delta = AJ_GetElapsedTime(&conn->probeTimer.tStart, TRUE);
-    if (delta >= conn->probeTimer.delta) {
-        if (conn->probeTimer.retry == 0) {
+    delta = AJ_GetElapsedTime(&ardpState->conn->probeTimer.tStart, TRUE);
+    if (delta >= ardpState->conn->probeTimer.delta) {
+        if (ardpState->conn->probeTimer.retry == 0) {
             AJ_ErrPrintf(("CheckTimers: link timeout\n"));
             return AJ_ERR_ARDP_PROBE_TIMEOUT;
         }
         AJ_InfoPrintf(("CheckTimers: Fire probe timer\n"));
         status = SendHeader(ARDP_FLAG_ACK | ARDP_FLAG_VER | ARDP_FLAG_NUL);
-        AJ_InitTimer(&conn->probeTimer.tStart);
-        conn->probeTimer.retry--;
+        AJ_InitTimer(&ardpState->conn->probeTimer.tStart);
+        ardpState->conn->probeTimer.retry--;
         if (IsDataRetransmitScheduled() == FALSE) {
-            conn->rttInit = FALSE;
+            ardpState->conn->rttInit = FALSE;
         }
     }
 
     status = CheckDataTimers();
 
     /* Check delayed ACK timer */
-    delta = AJ_GetElapsedTime(&conn->ackTimer.tStart, TRUE);
-    if ((conn->ackTimer.retry != 0) && ((delta >= conn->ackTimer.delta) || (conn->rcv.pending >= ARDP_MAX_ACK_PENDING))) {
-        AJ_InfoPrintf(("CheckTimers: Fire ACK timer (elapsed %u vs %u)\n", delta, conn->ackTimer.delta));
+    delta = AJ_GetElapsedTime(&ardpState->conn->ackTimer.tStart, TRUE);
+    if ((ardpState->conn->ackTimer.retry != 0) && ((delta >= ardpState->conn->ackTimer.delta) || (ardpState->conn->rcv.pending >= ARDP_MAX_ACK_PENDING))) {
+        AJ_InfoPrintf(("CheckTimers: Fire ACK timer (elapsed %u vs %u)\n", delta, ardpState->conn->ackTimer.delta));
         status = SendHeader(ARDP_FLAG_ACK | ARDP_FLAG_VER);
     }
 
@@ -574,8 +612,8 @@ static AJ_Status UnmarshalSynSegment(uint8_t* buf, struct ArdpSeg* seg)
 {
     uint16_t segmax;
     uint16_t segbmax;
-    conn->foreign = ntohs(*((uint16_t*)(buf + SRC_OFFSET))); /* The source ARDP port */
-    conn->snd.DACKT = ntohl(*((uint32_t*)(buf + DACKT_OFFSET))); /* Delayed ACK timeout from the other side.  */
+    ardpState->conn->foreign = ntohs(*((uint16_t*)(buf + SRC_OFFSET))); /* The source ARDP port */
+    ardpState->conn->snd.DACKT = ntohl(*((uint32_t*)(buf + DACKT_OFFSET))); /* Delayed ACK timeout from the other side.  */
 
     segmax = ntohs(*((uint16_t*)(buf + SEGMAX_OFFSET)));     /* Max number of unacknowledged packets other side can buffer */
     segbmax = ntohs(*((uint16_t*)(buf + SEGBMAX_OFFSET)));   /* Max size segment the other side can handle */
@@ -585,10 +623,10 @@ static AJ_Status UnmarshalSynSegment(uint8_t* buf, struct ArdpSeg* seg)
         return AJ_ERR_RANGE;
     }
 
-    conn->snd.SEGMAX = segmax;
+    ardpState->conn->snd.SEGMAX = segmax;
     AJ_InfoPrintf(("UnmarshalSynSegment: segmax=%d, segbmax=%d\n", segmax, segbmax));
-    conn->rcv.CUR = seg->SEQ;
-    conn->rcv.LCS = seg->SEQ;
+    ardpState->conn->rcv.CUR = seg->SEQ;
+    ardpState->conn->rcv.LCS = seg->SEQ;
     return AJ_OK;
 }
 
@@ -603,8 +641,8 @@ static AJ_Status RecvValidateSegment(uint8_t* rxbuf, uint16_t len, struct ArdpSe
     if (seg->FLG & ARDP_FLAG_RST) {
         /* This is a disconnect from the remote, no checks are needed */
         AJ_WarnPrintf(("Receive: Remote disconnect RST\n"));
-        AJ_Free(conn);
-        conn = NULL;
+        AJ_Free(ardpState->conn);
+        ardpState->conn = NULL;
         return AJ_ERR_ARDP_REMOTE_CONNECTION_RESET;
     }
 
@@ -637,8 +675,8 @@ static AJ_Status RecvValidateSegment(uint8_t* rxbuf, uint16_t len, struct ArdpSe
     seg->FCNT = ntohs(*((uint16_t*)(rxbuf + FCNT_OFFSET)));     /* Number of segments comprising fragmented message */
 
     /* Perform sequence validation checks */
-    if (SEQ32_LT(conn->snd.NXT, seg->ACK)) {
-        AJ_ErrPrintf(("Receive: ack %u ahead of SND>NXT %u\n", seg->ACK, conn->snd.NXT));
+    if (SEQ32_LT(ardpState->conn->snd.NXT, seg->ACK)) {
+        AJ_ErrPrintf(("Receive: ack %u ahead of SND>NXT %u\n", seg->ACK, ardpState->conn->snd.NXT));
         return AJ_ERR_INVALID;
     }
 
@@ -687,39 +725,39 @@ static void AdjustRTT(ArdpSBuf* sBuf)
     uint32_t rttUnit = rtt / units;
     int32_t err;
 
-    if (!conn->rttInit) {
-        conn->rttMean = rtt;
-        conn->rttMeanVar = rtt >> 1;
-        conn->rttInit = TRUE;
+    if (!ardpState->conn->rttInit) {
+        ardpState->conn->rttMean = rtt;
+        ardpState->conn->rttMeanVar = rtt >> 1;
+        ardpState->conn->rttInit = TRUE;
     }
 
-    err = rtt - conn->rttMean;
+    err = rtt - ardpState->conn->rttMean;
 
     AJ_InfoPrintf(("AdjustRtt: mean = %u, var =%u, rtt = %u, error = %d\n",
-                   conn->rttMean, conn->rttMeanVar, rtt, err));
-    conn->rttMean = (7 * conn->rttMean + rtt) >> 3;
+                   ardpState->conn->rttMean, ardpState->conn->rttMeanVar, rtt, err));
+    ardpState->conn->rttMean = (7 * ardpState->conn->rttMean + rtt) >> 3;
 
-    if ((rtt + conn->rttMeanVar) >= conn->rttMean) {
-        conn->rttMeanVar = (conn->rttMeanVar * 3 + ABS(err)) >> 2;
+    if ((rtt + ardpState->conn->rttMeanVar) >= ardpState->conn->rttMean) {
+        ardpState->conn->rttMeanVar = (ardpState->conn->rttMeanVar * 3 + ABS(err)) >> 2;
     } else {
-        conn->rttMeanVar = (conn->rttMeanVar * 31 + ABS(err)) >> 5;
+        ardpState->conn->rttMeanVar = (ardpState->conn->rttMeanVar * 31 + ABS(err)) >> 5;
     }
 
-    conn->rttMeanUnit = (7 * conn->rttMeanUnit + rttUnit) >> 3;
+    ardpState->conn->rttMeanUnit = (7 * ardpState->conn->rttMeanUnit + rttUnit) >> 3;
 
-    conn->backoff = 0;
+    ardpState->conn->backoff = 0;
 
-    AJ_InfoPrintf(("AdjustRtt: New mean = %u, var =%u\n", conn->rttMean, conn->rttMeanVar));
+    AJ_InfoPrintf(("AdjustRtt: New mean = %u, var =%u\n", ardpState->conn->rttMean, ardpState->conn->rttMeanVar));
 }
 
 static void UpdateSndSegments(uint32_t ack)
 {
     uint16_t idx = ack % UDP_SEGMAX;
-    ArdpSBuf* sBuf = &conn->snd.buf[idx];
+    ArdpSBuf* sBuf = &ardpState->conn->snd.buf[idx];
     uint32_t i;
 
     /* Nothing to clean up */
-    if (conn->snd.pending == 0) {
+    if (ardpState->conn->snd.pending == 0) {
         return;
     }
 
@@ -730,7 +768,7 @@ static void UpdateSndSegments(uint32_t ack)
         AdjustRTT(sBuf);
     }
 
-    sBuf = &conn->snd.buf[0];
+    sBuf = &ardpState->conn->snd.buf[0];
 
     /* Cycle through all the buffers */
     for (i = 0; i < UDP_SEGMAX; i++) {
@@ -744,10 +782,10 @@ static void UpdateSndSegments(uint32_t ack)
             sBuf->dataLen = 0;
             sBuf->inFlight = 0;
             sBuf->retransmits = 0;
-            conn->snd.pending--;
+            ardpState->conn->snd.pending--;
         }
 
-        if (conn->snd.pending == 0) {
+        if (ardpState->conn->snd.pending == 0) {
             break;
         }
         sBuf = sBuf->next;
@@ -756,16 +794,16 @@ static void UpdateSndSegments(uint32_t ack)
 
 static void FlushExpiredRcvMessages(uint32_t seq, uint32_t ackNXT)
 {
-    uint32_t idx =  conn->rcv.CUR % UDP_SEGMAX;
-    ArdpRBuf* rBuf = &conn->rcv.buf[idx];
+    uint32_t idx =  ardpState->conn->rcv.CUR % UDP_SEGMAX;
+    ArdpRBuf* rBuf = &ardpState->conn->rcv.buf[idx];
 
     AJ_InfoPrintf(("FlushExpiredRcvMessages: seq = %u, expected %u got %u\n",
-                   seq, conn->rcv.CUR + 1, ackNXT));
-    while (SEQ32_LT(conn->rcv.CUR + 1, ackNXT)) {
+                   seq, ardpState->conn->rcv.CUR + 1, ackNXT));
+    while (SEQ32_LT(ardpState->conn->rcv.CUR + 1, ackNXT)) {
         rBuf->fcnt = 0;
         rBuf->dataLen = 0;
         rBuf = rBuf->next;
-        conn->rcv.CUR++;
+        ardpState->conn->rcv.CUR++;
     }
 
     /*
@@ -774,11 +812,11 @@ static void FlushExpiredRcvMessages(uint32_t seq, uint32_t ackNXT)
      * reset Rx context to NULL.
      */
     if (rBuf->dataLen != 0) {
-        UDP_Recv_State.readBuf = rBuf->data;
-        UDP_Recv_State.dataLen = rBuf->dataLen;
-        UDP_Recv_State.rxContext = (void*) rBuf;
+        ardpState->UDP_Recv_State.readBuf = rBuf->data;
+        ardpState->UDP_Recv_State.dataLen = rBuf->dataLen;
+        ardpState->UDP_Recv_State.rxContext = (void*) rBuf;
     } else {
-        UDP_Recv_State.rxContext = NULL;
+        ardpState->UDP_Recv_State.rxContext = NULL;
     }
 }
 
@@ -787,18 +825,18 @@ static void AddRcvBuffer(struct ArdpSeg* seg, uint8_t* rxBuf, uint16_t dataOffse
     uint32_t idx = seg->SEQ % UDP_SEGMAX;
 
     AJ_InfoPrintf(("AddRcvBuffer: seq=%u\n", seg->SEQ));
-    AJ_ASSERT(conn->rcv.buf[idx].fcnt == 0);
-
-    conn->rcv.buf[idx].seq = seg->SEQ;
-    conn->rcv.buf[idx].som = seg->SOM;
-    conn->rcv.buf[idx].fcnt = seg->FCNT;
-    conn->rcv.buf[idx].dataLen = seg->DLEN;
-    memcpy(conn->rcv.buf[idx].data, rxBuf + dataOffset, seg->DLEN);
-
-    if (UDP_Recv_State.rxContext == NULL) {
-        UDP_Recv_State.readBuf = conn->rcv.buf[idx].data;
-        UDP_Recv_State.dataLen = seg->DLEN;
-        UDP_Recv_State.rxContext = (void*) &conn->rcv.buf[idx];
+    AJ_ASSERT(ardpState->conn->rcv.buf[idx].fcnt == 0);
+
+    ardpState->conn->rcv.buf[idx].seq = seg->SEQ;
+    ardpState->conn->rcv.buf[idx].som = seg->SOM;
+    ardpState->conn->rcv.buf[idx].fcnt = seg->FCNT;
+    ardpState->conn->rcv.buf[idx].dataLen = seg->DLEN;
+    memcpy(ardpState->conn->rcv.buf[idx].data, rxBuf + dataOffset, seg->DLEN);
+
+    if (ardpState->UDP_Recv_State.rxContext == NULL) {
+        ardpState->UDP_Recv_State.readBuf = ardpState->conn->rcv.buf[idx].data;
+        ardpState->UDP_Recv_State.dataLen = seg->DLEN;
+        ardpState->UDP_Recv_State.rxContext = (void*) &ardpState->conn->rcv.buf[idx];
     }
 }
 
@@ -808,10 +846,10 @@ static AJ_Status ArdpMachine(struct ArdpSeg* seg, uint8_t* rxBuf, uint16_t len)
 
     AJ_InfoPrintf(("ArdpMachine(seg=%p, buf=%p, len=%d)\n", seg, rxBuf, len));
 
-    switch (conn->state) {
+    switch (ardpState->conn->state) {
     case SYN_SENT:
         {
-            AJ_InfoPrintf(("ArdpMachine(): conn->state = SYN_SENT\n"));
+            AJ_InfoPrintf(("ArdpMachine(): ardpState->conn->state = SYN_SENT\n"));
 
             if (seg->FLG & ARDP_FLAG_SYN) {
                 AJ_InfoPrintf(("ArdpMachine(): SYN_SENT: SYN received\n"));
@@ -823,22 +861,22 @@ static AJ_Status ArdpMachine(struct ArdpSeg* seg, uint8_t* rxBuf, uint16_t len)
                         AJ_WarnPrintf(("ArdpMachine(): SYN_SENT: Unsupported protocol version 0x%x\n",
                                        seg->FLG & ARDP_VERSION_BITS));
                         status = AJ_ERR_ARDP_VERSION_NOT_SUPPORTED;
-                    } else if (!(seg->FLG & ARDP_FLAG_ACK) || (seg->ACK != conn->snd.ISS)) {
+                    } else if (!(seg->FLG & ARDP_FLAG_ACK) || (seg->ACK != ardpState->conn->snd.ISS)) {
                         AJ_WarnPrintf(("ArdpMachine(): SYN_SENT: does not ACK ISS\n"));
                         status = AJ_ERR_INVALID;
                     } else {
                         AJ_InfoPrintf(("ArdpMachine(): SYN_SENT: SYN | ACK received. state -> OPEN\n"));
 
-                        conn->snd.UNA = seg->ACK + 1;
-                        conn->state = OPEN;
-                        conn->snd.buf[0].timer.retry = 0;
-                        conn->snd.buf[0].dataLen = 0;
-                        conn->snd.buf[0].inFlight = 0;
+                        ardpState->conn->snd.UNA = seg->ACK + 1;
+                        ardpState->conn->state = OPEN;
+                        ardpState->conn->snd.buf[0].timer.retry = 0;
+                        ardpState->conn->snd.buf[0].dataLen = 0;
+                        ardpState->conn->snd.buf[0].inFlight = 0;
 
                         /* Initialize and kick off link timeout timer */
-                        InitTimer(&conn->probeTimer, UDP_LINK_TIMEOUT / UDP_KEEPALIVE_RETRIES, UDP_KEEPALIVE_RETRIES);
+                        InitTimer(&ardpState->conn->probeTimer, UDP_LINK_TIMEOUT / UDP_KEEPALIVE_RETRIES, UDP_KEEPALIVE_RETRIES);
 
-                        conn->confirm = TRUE;
+                        ardpState->conn->confirm = TRUE;
 
                         /*
                          * <SEQ=snd.NXT><ACK=RCV.CUR><ACK>
@@ -852,7 +890,7 @@ static AJ_Status ArdpMachine(struct ArdpSeg* seg, uint8_t* rxBuf, uint16_t len)
                 }
 
                 /* Stop connect retry timer */
-                conn->connectTimer.retry = 0;
+                ardpState->conn->connectTimer.retry = 0;
 
             }
 
@@ -862,7 +900,7 @@ static AJ_Status ArdpMachine(struct ArdpSeg* seg, uint8_t* rxBuf, uint16_t len)
     case CLOSE_WAIT:
     case OPEN:
         {
-            AJ_InfoPrintf(("ArdpMachine(): conn->state = %s\n", (conn->state == CLOSE_WAIT) ? "CLOSE_WAIT" : "OPEN"));
+            AJ_InfoPrintf(("ArdpMachine(): ardpState->conn->state = %s\n", (ardpState->conn->state == CLOSE_WAIT) ? "CLOSE_WAIT" : "OPEN"));
 
             if (seg->FLG & ARDP_FLAG_SYN) {
                 /* Ignore */
@@ -872,28 +910,28 @@ static AJ_Status ArdpMachine(struct ArdpSeg* seg, uint8_t* rxBuf, uint16_t len)
             if (seg->FLG & ARDP_FLAG_ACK) {
                 AJ_InfoPrintf(("ArdpMachine(): Got ACK %u LCS %u ACKNXT %u\n", seg->ACK, seg->LCS, seg->ACKNXT));
 
-                if (IN_RANGE(uint32_t, conn->snd.UNA, ((conn->snd.NXT - conn->snd.UNA) + 1), seg->ACK) == TRUE) {
-                    conn->snd.UNA = seg->ACK + 1;
+                if (IN_RANGE(uint32_t, ardpState->conn->snd.UNA, ((ardpState->conn->snd.NXT - ardpState->conn->snd.UNA) + 1), seg->ACK) == TRUE) {
+                    ardpState->conn->snd.UNA = seg->ACK + 1;
                     UpdateSndSegments(seg->ACK);
                 }
 
-                conn->snd.LCS = seg->LCS;
+                ardpState->conn->snd.LCS = seg->LCS;
 
-                if (conn->state == CLOSE_WAIT) {
-                    if (conn->snd.pending != 0) {
+                if (ardpState->conn->state == CLOSE_WAIT) {
+                    if (ardpState->conn->snd.pending != 0) {
                         return AJ_ERR_ARDP_DISCONNECTING;
                     } else {
                         return AJ_ERR_ARDP_DISCONNECTED;
                     }
                 }
-                conn->confirm = TRUE;
+                ardpState->conn->confirm = TRUE;
             }
 
             AJ_InfoPrintf(("ArdpMachine(): OPEN: seq = %u, we are waiting for %u, they wait for %u\n",
-                           seg->SEQ, conn->rcv.CUR + 1, seg->ACKNXT));
-            if (SEQ32_LT(conn->rcv.CUR + 1, seg->ACKNXT)) {
+                           seg->SEQ, ardpState->conn->rcv.CUR + 1, seg->ACKNXT));
+            if (SEQ32_LT(ardpState->conn->rcv.CUR + 1, seg->ACKNXT)) {
                 AJ_InfoPrintf(("ArdpMachine(): OPEN: seq = %u, expected %u got %u\n",
-                               seg->SEQ, conn->rcv.CUR + 1, seg->ACKNXT));
+                               seg->SEQ, ardpState->conn->rcv.CUR + 1, seg->ACKNXT));
                 FlushExpiredRcvMessages(seg->SEQ, seg->ACKNXT);
                 status = AJ_ERR_ARDP_RECV_EXPIRED;
             }
@@ -902,30 +940,30 @@ static AJ_Status ArdpMachine(struct ArdpSeg* seg, uint8_t* rxBuf, uint16_t len)
             if (seg->FLG & ARDP_FLAG_NUL) {
                 SendHeader(ARDP_FLAG_ACK | ARDP_FLAG_VER);
             } else if (seg->DLEN) {
-                if (conn->ackTimer.retry == 0) {
-                    InitTimer(&conn->ackTimer, UDP_DELAYED_ACK_TIMEOUT, 1);
+                if (ardpState->conn->ackTimer.retry == 0) {
+                    InitTimer(&ardpState->conn->ackTimer, UDP_DELAYED_ACK_TIMEOUT, 1);
                 }
-                conn->rcv.pending++;
+                ardpState->conn->rcv.pending++;
 
                 /* Update with new data */
-                if (SEQ32_LET((conn->rcv.CUR + 1), seg->SEQ)) {
+                if (SEQ32_LET((ardpState->conn->rcv.CUR + 1), seg->SEQ)) {
                     AddRcvBuffer(seg, rxBuf, ARDP_HEADER_SIZE);
-                    conn->rcv.CUR = seg->SEQ;
+                    ardpState->conn->rcv.CUR = seg->SEQ;
                     AJ_InfoPrintf(("ArdpMachine(): OPEN: received data with seq %u, som %u, fcnt %u\n",
                                    seg->SEQ, seg->SOM, seg->FCNT));
                 } else {
-                    AJ_InfoPrintf(("ArdpMachine(): OPEN: duplicate data with seq %u (cur=%u)\n", seg->SEQ, conn->rcv.CUR));
+                    AJ_InfoPrintf(("ArdpMachine(): OPEN: duplicate data with seq %u (cur=%u)\n", seg->SEQ, ardpState->conn->rcv.CUR));
                 }
             }
 
-            InitTimer(&conn->probeTimer, UDP_LINK_TIMEOUT / UDP_KEEPALIVE_RETRIES, UDP_KEEPALIVE_RETRIES);
+            InitTimer(&ardpState->conn->probeTimer, UDP_LINK_TIMEOUT / UDP_KEEPALIVE_RETRIES, UDP_KEEPALIVE_RETRIES);
 
             break;
         }
 
     default:
         status = AJ_ERR_DISALLOWED;
-        AJ_ASSERT(0 && "ArdpMachine(): unexpected conn->state %d");
+        AJ_ASSERT(0 && "ArdpMachine(): unexpected ardpState->conn->state %d");
         break;
     }
 
@@ -955,31 +993,31 @@ static void RecvReady(void* rxContext)
 {
     ArdpRBuf* rBuf = (ArdpRBuf*) rxContext;
 
-    AJ_InfoPrintf(("RecvReady: buf=%p, seq=%u, lcs=%u\n", rBuf, rBuf->seq, conn->rcv.LCS));
+    AJ_InfoPrintf(("RecvReady: buf=%p, seq=%u, lcs=%u\n", rBuf, rBuf->seq, ardpState->conn->rcv.LCS));
 
     rBuf->fcnt = 0;
     rBuf->dataLen = 0;
-    conn->rcv.LCS = rBuf->seq;
+    ardpState->conn->rcv.LCS = rBuf->seq;
 
-    if (conn->ackTimer.retry == 0) {
-        InitTimer(&conn->ackTimer, 0, 1);
+    if (ardpState->conn->ackTimer.retry == 0) {
+        InitTimer(&ardpState->conn->ackTimer, 0, 1);
     }
 }
 
 AJ_Status AJ_ARDP_StartMsgSend(uint32_t ttl)
 {
-    if (conn == NULL) {
+    if (ardpState->conn == NULL) {
         return AJ_ERR_DISALLOWED;
     }
 
     AJ_InfoPrintf(("ARDP_StartMsgSend: ttl=%d\n", ttl));
 
-    if (conn->snd.msgLenSent != 0) {
-        AJ_ASSERT(conn->snd.newMsg == FALSE);
+    if (ardpState->conn->snd.msgLenSent != 0) {
+        AJ_ASSERT(ardpState->conn->snd.newMsg == FALSE);
     }
-    conn->snd.newMsg = TRUE;
-    conn->snd.msgTTL = ttl;
-    conn->snd.msgLenSent = 0;
+    ardpState->conn->snd.newMsg = TRUE;
+    ardpState->conn->snd.msgTTL = ttl;
+    ardpState->conn->snd.msgLenSent = 0;
 
     return AJ_OK;
 }
@@ -1003,9 +1041,9 @@ static AJ_Status ARDP_Send(uint8_t* txBuf, uint16_t len)
     uint16_t offset;
     AJ_Status status;
 
-    AJ_InfoPrintf(("ARDP_Send: buf=%p, len=%d ((nxt %u, lcs %u))\n", txBuf, len, conn->snd.NXT, conn->snd.LCS));
+    AJ_InfoPrintf(("ARDP_Send: buf=%p, len=%d ((nxt %u, lcs %u))\n", txBuf, len, ardpState->conn->snd.NXT, ardpState->conn->snd.LCS));
 
-    if ((conn == NULL) || ((conn->state != OPEN))) {
+    if ((ardpState->conn == NULL) || ((ardpState->conn->state != OPEN))) {
         return AJ_ERR_DISALLOWED;
     }
 
@@ -1014,42 +1052,42 @@ static AJ_Status ARDP_Send(uint8_t* txBuf, uint16_t len)
         return status;
     }
 
-    pending = (conn->snd.NXT - conn->snd.LCS) - 1;
-    sBuf = &(conn->snd.buf[conn->snd.NXT % UDP_SEGMAX]);
+    pending = (ardpState->conn->snd.NXT - ardpState->conn->snd.LCS) - 1;
+    sBuf = &(ardpState->conn->snd.buf[ardpState->conn->snd.NXT % UDP_SEGMAX]);
 
-    AJ_ASSERT(conn->snd.pending <= UDP_SEGMAX);
-    if (conn->snd.pending == UDP_SEGMAX) {
-        AJ_InfoPrintf(("ARDP_Send: backpressure, all (%u) SND buffers are in flight\n", conn->snd.pending));
+    AJ_ASSERT(ardpState->conn->snd.pending <= UDP_SEGMAX);
+    if (ardpState->conn->snd.pending == UDP_SEGMAX) {
+        AJ_InfoPrintf(("ARDP_Send: backpressure, all (%u) SND buffers are in flight\n", ardpState->conn->snd.pending));
         return AJ_ERR_ARDP_BACKPRESSURE;
     }
     AJ_ASSERT(sBuf->inFlight == 0);
 
-    ttl = conn->snd.msgTTL;
+    ttl = ardpState->conn->snd.msgTTL;
     offset = sBuf->dataLen;
 
     /* If this is the start of a new message, extract the total message length */
-    if (conn->snd.newMsg == TRUE) {
+    if (ardpState->conn->snd.newMsg == TRUE) {
         AJ_MsgHeader* hdr = (AJ_MsgHeader*) txBuf;
-        conn->snd.msgLenTotal = sizeof(AJ_MsgHeader) + ((hdr->headerLen + 7) & 0xFFFFFFF8) + hdr->bodyLen;
-        AJ_InfoPrintf(("ARDP_Send: new message len = %u\n", conn->snd.msgLenTotal));
-        conn->snd.newMsg = FALSE;
-        conn->snd.msgSOM = conn->snd.NXT;
+        ardpState->conn->snd.msgLenTotal = sizeof(AJ_MsgHeader) + ((hdr->headerLen + 7) & 0xFFFFFFF8) + hdr->bodyLen;
+        AJ_InfoPrintf(("ARDP_Send: new message len = %u\n", ardpState->conn->snd.msgLenTotal));
+        ardpState->conn->snd.newMsg = FALSE;
+        ardpState->conn->snd.msgSOM = ardpState->conn->snd.NXT;
     }
 
     /*
      * Check whether there is enough local buffer space to fit the data.
      * Also, check if the remote side can currently accept these data.
      */
-    if (((len + offset) > (ARDP_MAX_DLEN * (UDP_SEGMAX - conn->snd.pending))) || ((len + offset) > (ARDP_MAX_DLEN * (conn->snd.SEGMAX - pending)))) {
-        AJ_InfoPrintf(("ARDP_Send: backpressure, cannot send %u (%u + %u): local send pending %u, remote consume pending %u\n", len + offset, len, offset, conn->snd.pending, pending));
+    if (((len + offset) > (ARDP_MAX_DLEN * (UDP_SEGMAX - ardpState->conn->snd.pending))) || ((len + offset) > (ARDP_MAX_DLEN * (ardpState->conn->snd.SEGMAX - pending)))) {
+        AJ_InfoPrintf(("ARDP_Send: backpressure, cannot send %u (%u + %u): local send pending %u, remote consume pending %u\n", len + offset, len, offset, ardpState->conn->snd.pending, pending));
         return AJ_ERR_ARDP_BACKPRESSURE;
     }
 
-    AJ_ASSERT(conn->snd.msgLenTotal > 0);
+    AJ_ASSERT(ardpState->conn->snd.msgLenTotal > 0);
 
-    if (conn->rttInit && (ttl != ARDP_TTL_INFINITE)) {
-        uint32_t expireThreshold = (conn->rttMeanUnit * (conn->snd.msgLenTotal + UDP_MTU - 1) / UDP_MTU) >> 1;
-        if ((ttl < (ARDP_TTL_MAX - conn->snd.DACKT)) && ((ttl + conn->snd.DACKT) <= expireThreshold)) {
+    if (ardpState->conn->rttInit && (ttl != ARDP_TTL_INFINITE)) {
+        uint32_t expireThreshold = (ardpState->conn->rttMeanUnit * (ardpState->conn->snd.msgLenTotal + UDP_MTU - 1) / UDP_MTU) >> 1;
+        if ((ttl < (ARDP_TTL_MAX - ardpState->conn->snd.DACKT)) && ((ttl + ardpState->conn->snd.DACKT) <= expireThreshold)) {
             return AJ_ERR_ARDP_SEND_EXPIRED;
         }
 
@@ -1059,7 +1097,7 @@ static AJ_Status ARDP_Send(uint8_t* txBuf, uint16_t len)
         }
     }
 
-    fcnt = (conn->snd.msgLenTotal + ARDP_MAX_DLEN - 1) / ARDP_MAX_DLEN;
+    fcnt = (ardpState->conn->snd.msgLenTotal + ARDP_MAX_DLEN - 1) / ARDP_MAX_DLEN;
 
     AJ_ASSERT(fcnt > 0);
 
@@ -1081,18 +1119,18 @@ static AJ_Status ARDP_Send(uint8_t* txBuf, uint16_t len)
          * to wait for more data to pack in. Do not send, do not update counters.
          * Note: Soft check (instead of checking len == 0): a precaution for avoiding infinite loop in case we miscalculated.
          */
-        if ((dataLen < ARDP_MAX_DLEN) && dataLen != (conn->snd.msgLenTotal - conn->snd.msgLenSent)) {
+        if ((dataLen < ARDP_MAX_DLEN) && dataLen != (ardpState->conn->snd.msgLenTotal - ardpState->conn->snd.msgLenSent)) {
             AJ_InfoPrintf(("ARDP_Send(): queued %d bytes\n", dataLen));
             break;
         }
 
         sBuf->inFlight = 1;
-        conn->snd.msgLenSent += dataLen;
+        ardpState->conn->snd.msgLenSent += dataLen;
 
-        MarshalHeader(sBuf->data, ARDP_FLAG_ACK | ARDP_FLAG_VER, dataLen, ttl, conn->snd.msgSOM, fcnt);
+        MarshalHeader(sBuf->data, ARDP_FLAG_ACK | ARDP_FLAG_VER, dataLen, ttl, ardpState->conn->snd.msgSOM, fcnt);
 
-        AJ_InfoPrintf(("ARDP_Send(): send %d bytes (seq %u, ack %u, lcs %u)\n", ARDP_HEADER_SIZE + dataLen, conn->snd.NXT, conn->rcv.CUR, conn->rcv.LCS));
-        status = (*sendFunction)(conn->context, (uint8_t*) sBuf->data, ARDP_HEADER_SIZE + dataLen, &sent, conn->confirm);
+        AJ_InfoPrintf(("ARDP_Send(): send %d bytes (seq %u, ack %u, lcs %u)\n", ARDP_HEADER_SIZE + dataLen, ardpState->conn->snd.NXT, ardpState->conn->rcv.CUR, ardpState->conn->rcv.LCS));
+        status = (*ardpState->sendFunction)(ardpState->conn->context, (uint8_t*) sBuf->data, ARDP_HEADER_SIZE + dataLen, &sent, ardpState->conn->confirm);
 
         if (status != AJ_OK) {
             AJ_ErrPrintf(("ARDP_Send(): %s\n", AJ_StatusText(status)));
@@ -1100,16 +1138,16 @@ static AJ_Status ARDP_Send(uint8_t* txBuf, uint16_t len)
         }
 
         AJ_InfoPrintf(("ArdpSend(): cancel ackTimer\n"));
-        conn->ackTimer.retry = 0;
-        conn->rcv.pending = 0;
-        conn->confirm = FALSE;
+        ardpState->conn->ackTimer.retry = 0;
+        ardpState->conn->rcv.pending = 0;
+        ardpState->conn->confirm = FALSE;
 
         len -= (dataLen - offset);
 
-        conn->snd.NXT++;
-        conn->snd.pending++;
+        ardpState->conn->snd.NXT++;
+        ardpState->conn->snd.pending++;
 
-        if (conn->rttInit) {
+        if (ardpState->conn->rttInit) {
             timeout = GetRTO();
         } else {
             timeout = UDP_INITIAL_DATA_TIMEOUT;
@@ -1130,7 +1168,7 @@ AJ_Status AJ_ARDP_Connect(uint8_t* data, uint16_t dataLen, void* context, AJ_Net
 {
     AJ_Status status;
 
-    memset(&UDP_Recv_State, 0, sizeof(UDP_Recv_State));
+    memset(&ardpState->UDP_Recv_State, 0, sizeof(ardpState->UDP_Recv_State));
 
     status = InitConnection();
 
@@ -1138,19 +1176,19 @@ AJ_Status AJ_ARDP_Connect(uint8_t* data, uint16_t dataLen, void* context, AJ_Net
         return status;
     }
     AJ_ASSERT(dataLen < (UDP_SEGBMAX - ARDP_SYN_HEADER_SIZE));
-    memcpy(((uint8_t*) conn->snd.buf[0].data) + ARDP_SYN_HEADER_SIZE, data, dataLen);
-    conn->snd.buf[0].dataLen = dataLen;
-    conn->snd.buf[0].inFlight = 1;
-    conn->context = context;
-    conn->netSock = netSock;
+    memcpy(((uint8_t*) ardpState->conn->snd.buf[0].data) + ARDP_SYN_HEADER_SIZE, data, dataLen);
+    ardpState->conn->snd.buf[0].dataLen = dataLen;
+    ardpState->conn->snd.buf[0].inFlight = 1;
+    ardpState->conn->context = context;
+    ardpState->conn->netSock = netSock;
 
     status = SendSyn(dataLen);
 
     if (status != AJ_OK) {
-        AJ_Free(conn);
+        AJ_Free(ardpState->conn);
     } else {
-        InitTimer(&conn->connectTimer, UDP_CONNECT_TIMEOUT, UDP_CONNECT_RETRIES);
-        conn->state = SYN_SENT;
+        InitTimer(&ardpState->conn->connectTimer, UDP_CONNECT_TIMEOUT, UDP_CONNECT_RETRIES);
+        ardpState->conn->state = SYN_SENT;
     }
 
     return status;
@@ -1159,20 +1197,20 @@ AJ_Status AJ_ARDP_Connect(uint8_t* data, uint16_t dataLen, void* context, AJ_Net
 void AJ_ARDP_Disconnect(uint8_t forced)
 {
     AJ_WarnPrintf(("ARDP Disconnect Request (local)\n"));
-    if (conn == NULL) {
+    if (ardpState->conn == NULL) {
         return;
     }
 
-    if ((forced == FALSE) && (conn->snd.pending != 0)) {
+    if ((forced == FALSE) && (ardpState->conn->snd.pending != 0)) {
         AJ_InfoPrintf(("ARDP_Disconnect: wait for tx queue to drain\n"));
-        conn->state = CLOSE_WAIT;
+        ardpState->conn->state = CLOSE_WAIT;
         /* Block here  to give data retransmits a chance to go through */
-        AJ_ARDP_Recv(&conn->netSock->rx, 0, UDP_DISCONNECT_TIMEOUT);
+        AJ_ARDP_Recv(&ardpState->conn->netSock->rx, 0, UDP_DISCONNECT_TIMEOUT);
         /*
          * If, while we are waiting, the remote disconnected, the connection is torn down at this point.
          * Nothing to do, just return.
          */
-        if (conn == NULL) {
+        if (ardpState->conn == NULL) {
             return;
         }
     }
@@ -1180,8 +1218,8 @@ void AJ_ARDP_Disconnect(uint8_t forced)
     AJ_WarnPrintf(("ARDP_Disconnect: Send RST\n"));
     SendHeader(ARDP_FLAG_RST | ARDP_FLAG_ACK | ARDP_FLAG_VER);
 
-    AJ_Free(conn);
-    conn = NULL;
+    AJ_Free(ardpState->conn);
+    ardpState->conn = NULL;
 }
 
 AJ_Status AJ_ARDP_Send(AJ_IOBuffer* buf)
@@ -1192,7 +1230,7 @@ AJ_Status AJ_ARDP_Send(AJ_IOBuffer* buf)
 
     AJ_InfoPrintf(("AJ_ARDP_Send(buf=0x%p)\n", buf));
 
-    if (conn == NULL) {
+    if (ardpState->conn == NULL) {
         return AJ_ERR_DISALLOWED;
     }
 
@@ -1212,11 +1250,11 @@ AJ_Status AJ_ARDP_Send(AJ_IOBuffer* buf)
                  * If we can't make room in the send window within a certain amount of time,
                  * assume that the connection has failed.
                  */
-                status = AJ_ARDP_Recv(&conn->netSock->rx, 0, ARDP_BACKPRESSURE_INTERVAL);
+                status = AJ_ARDP_Recv(&ardpState->conn->netSock->rx, 0, ARDP_BACKPRESSURE_INTERVAL);
 
                 if (status != AJ_OK && status != AJ_ERR_TIMEOUT) {
                     /* Something has gone wrong */
-                    AJ_ErrPrintf(("AJ_ARDP_Send: (*recvFunction) returns %s\n", AJ_StatusText(status)));
+                    AJ_ErrPrintf(("AJ_ARDP_Send: (*ardpState->recvFunction) returns %s\n", AJ_StatusText(status)));
                     return AJ_ERR_WRITE;
                 }
 
@@ -1246,8 +1284,8 @@ static void UpdateReadBuffer(AJ_IOBuffer* rxBuf, uint32_t len) {
 
     AJ_InfoPrintf(("UpdateRead: rxBuf %p, len %u\n", rxBuf, len));
 
-    while ((UDP_Recv_State.rxContext != NULL) && (UDP_Recv_State.readBuf != NULL) && (len != 0)) {
-        ArdpRBuf* rBuf = UDP_Recv_State.rxContext;
+    while ((ardpState->UDP_Recv_State.rxContext != NULL) && (ardpState->UDP_Recv_State.readBuf != NULL) && (len != 0)) {
+        ArdpRBuf* rBuf = ardpState->UDP_Recv_State.rxContext;
         size_t rx = AJ_IO_BUF_SPACE(rxBuf);
         uint32_t consumed;
 
@@ -1255,15 +1293,15 @@ static void UpdateReadBuffer(AJ_IOBuffer* rxBuf, uint32_t len) {
         rx = min(rx, len);
 
         /* How much we can consume from the current rBuf */
-        consumed = min(rx, UDP_Recv_State.dataLen);
+        consumed = min(rx, ardpState->UDP_Recv_State.dataLen);
 
-        memcpy(rxBuf->writePtr, UDP_Recv_State.readBuf, consumed);
+        memcpy(rxBuf->writePtr, ardpState->UDP_Recv_State.readBuf, consumed);
 
         /* Advance the write pointer */
         rxBuf->writePtr += consumed;
         len -= consumed;
 
-        if (consumed == UDP_Recv_State.dataLen) {
+        if (consumed == ardpState->UDP_Recv_State.dataLen) {
             /*
              * We are done with the current rBuf. Release and potentially
              * move on to next rBuf.
@@ -1274,17 +1312,17 @@ static void UpdateReadBuffer(AJ_IOBuffer* rxBuf, uint32_t len) {
             /* Advance to the next rBuf */
             if (rBuf->next->dataLen) {
                 AJ_InfoPrintf(("UpdateRead: Start reading from next RCV\n"));
-                UDP_Recv_State.readBuf = rBuf->next->data;
-                UDP_Recv_State.dataLen = rBuf->next->dataLen;
-                UDP_Recv_State.rxContext = rBuf->next;
+                ardpState->UDP_Recv_State.readBuf = rBuf->next->data;
+                ardpState->UDP_Recv_State.dataLen = rBuf->next->dataLen;
+                ardpState->UDP_Recv_State.rxContext = rBuf->next;
             } else {
                 AJ_InfoPrintf(("UpdateRead: Nothing in next RCV\n"));
-                memset(&UDP_Recv_State, 0, sizeof(UDP_Recv_State));
+                memset(&ardpState->UDP_Recv_State, 0, sizeof(ardpState->UDP_Recv_State));
             }
         } else {
             /* No more space to write data. Update the internal read state and return */
-            UDP_Recv_State.readBuf += rx;
-            UDP_Recv_State.dataLen -= rx;
+            ardpState->UDP_Recv_State.readBuf += rx;
+            ardpState->UDP_Recv_State.dataLen -= rx;
             return;
         }
     }
@@ -1299,14 +1337,14 @@ AJ_Status AJ_ARDP_Recv(AJ_IOBuffer* rxBuf, uint32_t len, uint32_t timeout)
 
     AJ_InfoPrintf(("AJ_ARDP_Recv(rxBuf=%p, len=%u, timeout=%u)\n", rxBuf, len, timeout));
 
-    if (conn == NULL) {
+    if (ardpState->conn == NULL) {
         return AJ_ERR_READ;
     }
 
     AJ_InitTimer(&end);
     AJ_TimeAddOffset(&end, timeout);
 
-    if ((len != 0) && (UDP_Recv_State.rxContext != NULL)) {
+    if ((len != 0) && (ardpState->UDP_Recv_State.rxContext != NULL)) {
         timeout2 = 0;
     }
 
@@ -1314,7 +1352,7 @@ AJ_Status AJ_ARDP_Recv(AJ_IOBuffer* rxBuf, uint32_t len, uint32_t timeout)
         uint32_t received = 0;
         uint8_t* buf = NULL;
 
-        status = (*recvFunction)(rxBuf->context, &buf, &received, timeout2);
+        status = (*ardpState->recvFunction)(rxBuf->context, &buf, &received, timeout2);
 
         localStatus = CheckTimers();
 
@@ -1328,10 +1366,10 @@ AJ_Status AJ_ARDP_Recv(AJ_IOBuffer* rxBuf, uint32_t len, uint32_t timeout)
         switch (status) {
         case AJ_ERR_TIMEOUT:
             AJ_InfoPrintf(("AJ_ARDP_Recv status %s, len = %u, rxContext = %p\n", AJ_StatusText(status),
-                           len, UDP_Recv_State.rxContext));
-            if ((len != 0) && (UDP_Recv_State.rxContext != NULL)) {
+                           len, ardpState->UDP_Recv_State.rxContext));
+            if ((len != 0) && (ardpState->UDP_Recv_State.rxContext != NULL)) {
                 status = AJ_OK;
-                AJ_InitTimer(&conn->probeTimer.tStart);
+                AJ_InitTimer(&ardpState->conn->probeTimer.tStart);
                 goto UPDATE_READ;
             }
             break;
@@ -1342,16 +1380,16 @@ AJ_Status AJ_ARDP_Recv(AJ_IOBuffer* rxBuf, uint32_t len, uint32_t timeout)
             if (status == AJ_OK) {
                 goto UPDATE_READ;
             } else if (status == AJ_ERR_ARDP_RECV_EXPIRED) {
-                AJ_InfoPrintf(("AJ_ARDP_Recv: Expired message, LCS %u\n", conn->rcv.LCS));
-                conn->rcv.LCS = conn->rcv.CUR;
-                if (conn->ackTimer.retry == 0) {
-                    InitTimer(&conn->ackTimer, ARDP_MIN_DELAYED_ACK_TIMEOUT, 1);
+                AJ_InfoPrintf(("AJ_ARDP_Recv: Expired message, LCS %u\n", ardpState->conn->rcv.LCS));
+                ardpState->conn->rcv.LCS = ardpState->conn->rcv.CUR;
+                if (ardpState->conn->ackTimer.retry == 0) {
+                    InitTimer(&ardpState->conn->ackTimer, ARDP_MIN_DELAYED_ACK_TIMEOUT, 1);
                 }
                 return status;
             } else if (status == AJ_ERR_ARDP_DISCONNECTING) {
                 /* We are waiting for either TX queue to drain or timeout */
                 break;
-            } else if ((status != AJ_ERR_ARDP_REMOTE_CONNECTION_RESET) && (conn->state != CLOSE_WAIT)) {
+            } else if ((status != AJ_ERR_ARDP_REMOTE_CONNECTION_RESET) && (ardpState->conn->state != CLOSE_WAIT)) {
                 AJ_WarnPrintf(("AJ_ARDP_Recv: received bad data, disconnecting\n"));
                 AJ_ARDP_Disconnect(TRUE);
             }
@@ -1373,7 +1411,7 @@ AJ_Status AJ_ARDP_Recv(AJ_IOBuffer* rxBuf, uint32_t len, uint32_t timeout)
     } while (AJ_CompareTime(now, end) < 0);
 
 UPDATE_READ:
-    if ((len != 0) && (UDP_Recv_State.rxContext != NULL)) {
+    if ((len != 0) && (ardpState->UDP_Recv_State.rxContext != NULL)) {
         UpdateReadBuffer(rxBuf, len);
         // can't possibly time out if data was recved!
         return AJ_OK;
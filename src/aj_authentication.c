@@ -995,7 +995,7 @@ static AJ_Status ECDSAUnmarshal(AJ_AuthenticationContext* ctx, AJ_Message* msg,
         }
         AJ_ConversationHash_Update_UInt8Array(ctx, CONVERSATION_V1, der.data, der.size);
 
-        node = (X509CertificateChain*) AJ_Malloc(sizeof (X509CertificateChain));
+        node = (X509CertificateChain*) AJ_MsgArenaAlloc(msg, sizeof (X509CertificateChain));
         if (NULL == node) {
             AJ_WarnPrintf(("ECDSAUnmarshal(ctx=%p, msg=%p): Resource error\n", ctx, msg));
             status = AJ_ERR_RESOURCES;
@@ -1118,7 +1118,7 @@ Exit:
     while (root) {
         node = root;
         root = root->next;
-        AJ_Free(node);
+        AJ_MsgArenaFree(node);
     }
     if (AJ_OK != status) {
         /* Free issuers */
@@ -104,32 +104,122 @@ Policy g_policy = { { 0, NULL }, NULL };
 #define POLICY_ACCESS               (POLICY_INCOMING | POLICY_OUTGOING)
 #define MANIFEST_ACCESS             (MANIFEST_INCOMING | MANIFEST_OUTGOING)
 
+/*
+ * Peer access is kept as bitsets indexed by the peer's name map index, one bitset
+ * for each of the access bits above and one for explicit deny.
+ */
+#define ACCESS_BITS                 8
+#define PEER_BITSET_SIZE            ((AJ_NAME_MAP_GUID_SIZE + 7) / 8)
+#define PEER_BYTE(peer)             ((peer) >> 3)
+#define PEER_BIT(peer)              ((uint8_t)(1 << ((peer) & 7)))
+
 /*
  * The main access control structure.
  * Maps message ids to peer's access.
  */
 typedef struct _AccessControlMember {
     uint32_t id;
+    uint8_t list;
     const char* obj;
     const char* ifn;
     const char* mbr;
-    uint8_t deny[AJ_NAME_MAP_GUID_SIZE];
-    uint8_t allow[AJ_NAME_MAP_GUID_SIZE];
-    struct _AccessControlMember* next;
+    uint8_t deny[PEER_BITSET_SIZE];
+    uint8_t allow[ACCESS_BITS][PEER_BITSET_SIZE];
 } AccessControlMember;
 
+/*
+ * Members are kept in a flat array in registration order with an open addressed
+ * hash index keyed by message id. Members of the same interface are adjacent.
+ */
+typedef struct _AccessControlTable {
+    AccessControlMember* members;
+    uint16_t count;
+    uint16_t size;
+    uint16_t* index;                /* Position of a member + 1, zero is an empty slot */
+    uint16_t indexSize;             /* A power of two, zero if there is no index */
+} AccessControlTable;
+
+#define ACCESS_INDEX_MIN_SIZE       16
+#define ACCESS_TABLE_GROW           16
+
 static AJ_PermissionRule* g_manifestRules = NULL;
-static AccessControlMember* g_access = NULL;
+static AJ_THREAD_LOCAL AccessControlTable g_access;
+
+static uint32_t AccessIndexSlot(uint32_t id, uint16_t indexSize)
+{
+    return ((id * 0x9E3779B1) >> 16) & (indexSize - 1);
+}
+
+/*
+ * Rebuilds the message id index after members have been added or removed.
+ * Without an index members are found by a linear scan.
+ */
+static void AccessControlIndex(void)
+{
+    uint16_t size = ACCESS_INDEX_MIN_SIZE;
+    uint16_t n;
+
+    AJ_Free(g_access.index);
+    g_access.index = NULL;
+    g_access.indexSize = 0;
+    if (!g_access.count) {
+        return;
+    }
+    while ((size < 0x8000) && (size < (2 * g_access.count))) {
+        size <<= 1;
+    }
+    if (g_access.count >= size) {
+        AJ_WarnPrintf(("AccessControlIndex(): Too many members to index - using linear lookup\n"));
+        return;
+    }
+    g_access.index = (uint16_t*) AJ_Malloc(size * sizeof (uint16_t));
+    if (NULL == g_access.index) {
+        AJ_WarnPrintf(("AccessControlIndex(): AJ_ERR_RESOURCES - using linear lookup\n"));
+        return;
+    }
+    memset(g_access.index, 0, size * sizeof (uint16_t));
+    g_access.indexSize = size;
+    /* Insert the newest members first so they are found first, as with the old reverse ordered list */
+    n = g_access.count;
+    while (n--) {
+        uint32_t slot = AccessIndexSlot(g_access.members[n].id, size);
+        while (g_access.index[slot]) {
+            slot = (slot + 1) & (size - 1);
+        }
+        g_access.index[slot] = n + 1;
+    }
+}
 
 static void AccessControlClose(void)
+{
+    AJ_Free(g_access.members);
+    AJ_Free(g_access.index);
+    memset(&g_access, 0, sizeof (g_access));
+}
+
+static AccessControlMember* AccessControlAdd(const char* obj, const char* ifn, const char* mbr, uint32_t id, uint8_t l)
 {
     AccessControlMember* member;
 
-    while (g_access) {
-        member = g_access;
-        g_access = g_access->next;
-        AJ_Free(member);
+    if (g_access.count == g_access.size) {
+        if (g_access.size > (0xFFFF - ACCESS_TABLE_GROW)) {
+            return NULL;
+        }
+        member = (AccessControlMember*) AJ_Realloc(g_access.members, (g_access.size + ACCESS_TABLE_GROW) * sizeof (AccessControlMember));
+        if (NULL == member) {
+            return NULL;
+        }
+        g_access.members = member;
+        g_access.size += ACCESS_TABLE_GROW;
     }
+    member = &g_access.members[g_access.count++];
+    memset(member, 0, sizeof (AccessControlMember));
+    member->obj = obj;
+    member->ifn = ifn;
+    member->mbr = mbr;
+    member->id = id;
+    member->list = l;
+    return member;
 }
 
 /*
@@ -142,6 +232,7 @@ static void AccessControlClose(void)
  */
 static AJ_Status AccessControlRegister(const AJ_Object* list, uint8_t l)
 {
+    AJ_Status status = AJ_OK;
     const AJ_Object* obj;
     const AJ_InterfaceDescription* interfaces;
     AJ_InterfaceDescription iface;
@@ -180,37 +271,25 @@ static AJ_Status AccessControlRegister(const AJ_Object* list, uint8_t l)
                 m = 0;
                 while (*iface) {
                     mbr = *iface++;
-                    member = (AccessControlMember*) AJ_Malloc(sizeof (AccessControlMember));
+                    member = AccessControlAdd(obj->path, ifn, mbr, AJ_ENCODE_MESSAGE_ID(l, n - 1, i, m), l);
                     if (NULL == member) {
                         AJ_WarnPrintf(("AccessControlRegister(list=%p, l=%x): AJ_ERR_RESOURCES\n", list, l));
+                        status = AJ_ERR_RESOURCES;
                         goto Exit;
                     }
-                    memset(member, 0, sizeof (AccessControlMember));
-                    member->obj = obj->path;
-                    member->ifn = ifn;
-                    member->mbr = mbr;
-                    member->id = AJ_ENCODE_MESSAGE_ID(l, n - 1, i, m);
-                    member->next = g_access;
-                    g_access = member;
                     properties |= (PROPERTY == MEMBER_TYPE(*mbr));
                     AJ_InfoPrintf(("AccessControlRegister: id 0x%08X obj %s ifn %s mbr %s\n", member->id, obj->path, ifn, mbr));
                     m++;
                 }
                 if (properties) {
                     /* Add special member to handle DBus.Properties GetAll method */
-                    member = (AccessControlMember*) AJ_Malloc(sizeof (AccessControlMember));
+                    /* Setting the member to "@" will match an PROPERTY with wildcard for member name */
+                    member = AccessControlAdd(obj->path, ifn, "@", AJ_INVALID_MSG_ID, l);
                     if (NULL == member) {
                         AJ_WarnPrintf(("AccessControlRegister(list=%p, l=%x): AJ_ERR_RESOURCES\n", list, l));
+                        status = AJ_ERR_RESOURCES;
                         goto Exit;
                     }
-                    memset(member, 0, sizeof (AccessControlMember));
-                    member->obj = obj->path;
-                    member->ifn = ifn;
-                    /* Setting the member to "@" will match an PROPERTY with wildcard for member name */
-                    member->mbr = "@";
-                    member->id = AJ_INVALID_MSG_ID;
-                    member->next = g_access;
-                    g_access = member;
                     AJ_InfoPrintf(("AccessControlRegister: id 0x%08X obj %s ifn %s mbr %s\n", member->id, obj->path, ifn, member->mbr));
                 }
             }
@@ -218,61 +297,104 @@ static AJ_Status AccessControlRegister(const AJ_Object* list, uint8_t l)
         }
     }
 
-    return AJ_OK;
-
 Exit:
-    return AJ_ERR_RESOURCES;
+    AccessControlIndex();
+    return status;
 }
 
 static void AccessControlDeregister(uint8_t l)
 {
-    AccessControlMember* node;
-    AccessControlMember* head = g_access;
+    uint16_t n;
+    uint16_t keep = 0;
 
-    /* Remove nodes from beginning of the list */
-    while (NULL != head) {
-        if (l == (head->id >> 24)) {
-            AJ_InfoPrintf(("AccessControlDeregister: id 0x%08X obj %s ifn %s mbr %s\n", head->id, head->obj, head->ifn, head->mbr));
-            node = head;
-            head = head->next;
-            AJ_Free(node);
+    for (n = 0; n < g_access.count; n++) {
+        AccessControlMember* member = &g_access.members[n];
+        if (l == member->list) {
+            AJ_InfoPrintf(("AccessControlDeregister: id 0x%08X obj %s ifn %s mbr %s\n", member->id, member->obj, member->ifn, member->mbr));
         } else {
-            break;
+            if (keep != n) {
+                memcpy(&g_access.members[keep], member, sizeof (AccessControlMember));
+            }
+            keep++;
         }
     }
-    g_access = head;
-    if (NULL == g_access) {
-        return;
-    }
-    /* Remove nodes from rest of the list */
-    while (NULL != head->next) {
-        if (l == (head->next->id >> 24)) {
-            AJ_InfoPrintf(("AccessControlDeregister: id 0x%08X obj %s ifn %s mbr %s\n", head->next->id, head->next->obj, head->next->ifn, head->next->mbr));
-            node = head->next;
-            head->next = node->next;
-            AJ_Free(node);
-        } else {
-            head = head->next;
-        }
+    if (keep != g_access.count) {
+        g_access.count = keep;
+        AccessControlIndex();
     }
 }
 
 static AccessControlMember* FindAccessControlMember(uint32_t id)
 {
-    AccessControlMember* mbr;
+    uint16_t n;
 
-    if (!g_access) {
+    if (!g_access.count) {
         AJ_WarnPrintf(("FindAccessControlMember(id=0x%08X): Access table not initialised\n", id));
         return NULL;
     }
 
-    // This linked list is a reverse ordered list
-    mbr = g_access;
-    while (mbr && (id != mbr->id)) {
-        mbr = mbr->next;
+    if (g_access.index) {
+        uint32_t slot = AccessIndexSlot(id, g_access.indexSize);
+        while ((n = g_access.index[slot]) != 0) {
+            if (id == g_access.members[n - 1].id) {
+                return &g_access.members[n - 1];
+            }
+            slot = (slot + 1) & (g_access.indexSize - 1);
+        }
+        return NULL;
+    }
+    /* Newest members first */
+    n = g_access.count;
+    while (n--) {
+        if (id == g_access.members[n].id) {
+            return &g_access.members[n];
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * The access a peer has to a member, nothing if the peer is explicitly denied
+ */
+static uint8_t MemberAccess(const AccessControlMember* acm, uint32_t peer)
+{
+    uint32_t byte = PEER_BYTE(peer);
+    uint8_t shift = peer & 7;
+    uint8_t acc = 0;
+    uint8_t b;
+
+    if ((acm->deny[byte] >> shift) & 1) {
+        return 0;
+    }
+    for (b = 0; b < ACCESS_BITS; b++) {
+        acc |= ((acm->allow[b][byte] >> shift) & 1) << b;
+    }
+    return acc;
+}
+
+static void MemberAllow(AccessControlMember* acm, uint32_t peer, uint8_t acc)
+{
+    uint32_t byte = PEER_BYTE(peer);
+    uint8_t bit = PEER_BIT(peer);
+    uint8_t b;
+
+    for (b = 0; acc; b++, acc >>= 1) {
+        if (acc & 1) {
+            acm->allow[b][byte] |= bit;
+        }
     }
+}
+
+static void MemberClear(AccessControlMember* acm, uint32_t peer)
+{
+    uint32_t byte = PEER_BYTE(peer);
+    uint8_t mask = ~PEER_BIT(peer);
+    uint8_t b;
 
-    return mbr;
+    for (b = 0; b < ACCESS_BITS; b++) {
+        acm->allow[b][byte] &= mask;
+    }
 }
 
 static uint32_t IsInterface(const char* std, const char* ifn)
@@ -304,10 +426,13 @@ static uint32_t StandardInterface(const char* ifn)
 
 static AccessControlMember* FindGetAllMember(const void* buf, size_t len)
 {
-    AccessControlMember* acm = g_access;
+    AccessControlMember* acm;
     const char* ifn;
+    uint16_t n = g_access.count;
 
-    while (acm) {
+    /* Newest members first */
+    while (n--) {
+        acm = &g_access.members[n];
         ifn = acm->ifn;
         /* Skip over secure annotation */
         if ((SECURE_TRUE == *ifn) || (SECURE_OFF == *ifn)) {
@@ -317,7 +442,6 @@ static AccessControlMember* FindGetAllMember(const void* buf, size_t len)
             /* Same interface */
             return acm;
         }
-        acm = acm->next;
     }
 
     return NULL;
@@ -347,12 +471,11 @@ static AJ_Status PropertiesInterfaceCheck(const AJ_Message* msg, uint8_t directi
     buf += sizeof (uint32_t);
     acm = FindGetAllMember(buf, len);
     if (acm) {
-        acc = acm->deny[peer] ? 0 : acm->allow[peer];
+        acc = MemberAccess(acm, peer);
         if ((POLICY_PRPALL_OUTGOING & acc) && (MANIFEST_PRPALL_OUTGOING & acc)) {
             return AJ_OK;
         }
     }
-    acm = acm->next;
 
     return AJ_ERR_ACCESS;
 }
@@ -395,7 +518,7 @@ AJ_Status AJ_AccessControlCheckMessage(const AJ_Message* msg, const char* name,
     }
 
     status = AJ_ERR_ACCESS;
-    acc = mbr->deny[peer] ? 0 : mbr->allow[peer];
+    acc = MemberAccess(mbr, peer);
     switch (direction) {
     case AJ_ACCESS_INCOMING:
         if ((POLICY_METHOD_INCOMING & acc) && (MANIFEST_METHOD_INCOMING & acc)) {
@@ -436,7 +559,7 @@ AJ_Status AJ_AccessControlCheckProperty(const AJ_Message* msg, uint32_t id, cons
     }
 
     status = AJ_ERR_ACCESS;
-    acc = mbr->deny[peer] ? 0 : mbr->allow[peer];
+    acc = MemberAccess(mbr, peer);
     switch (direction) {
     case AJ_ACCESS_INCOMING:
         switch (msg->msgId & 0xFF) {
@@ -501,8 +624,8 @@ AJ_Status AJ_AccessControlCheckProperty(const AJ_Message* msg, uint32_t id, cons
 AJ_Status AJ_AccessControlReset(const char* name)
 {
     AJ_Status status;
-    AccessControlMember* node = g_access;
     uint32_t peer;
+    uint16_t n;
 
     AJ_InfoPrintf(("AJ_AccessControlReset(name=%s)\n", name));
 
@@ -511,10 +634,9 @@ AJ_Status AJ_AccessControlReset(const char* name)
         AJ_WarnPrintf(("AJ_AccessControlReset(name=%s): Peer not in table\n", name));
         return status;
     }
-    while (node) {
-        node->allow[peer] = 0;
-        node->deny[peer] = 0;
-        node = node->next;
+    for (n = 0; n < g_access.count; n++) {
+        MemberClear(&g_access.members[n], peer);
+        g_access.members[n].deny[PEER_BYTE(peer)] &= ~PEER_BIT(peer);
     }
 
     return AJ_OK;
@@ -606,7 +728,7 @@ static void AJ_PermissionMemberFree(AJ_PermissionMember* head)
     while (head) {
         node = head;
         head = head->next;
-        AJ_Free(node);
+        AJ_MsgArenaFree(node);
     }
 }
 
@@ -617,7 +739,7 @@ static void AJ_PermissionRuleFree(AJ_PermissionRule* head)
         node = head;
         head = head->next;
         AJ_PermissionMemberFree(node->members);
-        AJ_Free(node);
+        AJ_MsgArenaFree(node);
     }
 }
 
@@ -625,7 +747,7 @@ void AJ_ManifestFree(AJ_Manifest* manifest)
 {
     if (manifest) {
         AJ_PermissionRuleFree(manifest->rules);
-        AJ_Free(manifest);
+        AJ_MsgArenaFree(manifest);
     }
 }
 
@@ -633,7 +755,7 @@ static void ManifestArrayElementFree(AJ_ManifestArray* node)
 {
     if (NULL != node) {
         AJ_ManifestFree(node->manifest);
-        AJ_Free(node);
+        AJ_MsgArenaFree(node);
     }
 }
 
@@ -655,7 +777,7 @@ static void AJ_PermissionPeerFree(AJ_PermissionPeer* head)
     while (head) {
         node = head;
         head = head->next;
-        AJ_Free(node);
+        AJ_MsgArenaFree(node);
     }
 }
 
@@ -667,7 +789,7 @@ static void AJ_PermissionACLFree(AJ_PermissionACL* head)
         head = head->next;
         AJ_PermissionPeerFree(node->peers);
         AJ_PermissionRuleFree(node->rules);
-        AJ_Free(node);
+        AJ_MsgArenaFree(node);
     }
 }
 
@@ -675,7 +797,7 @@ void AJ_PolicyFree(AJ_Policy* policy)
 {
     if (policy) {
         AJ_PermissionACLFree(policy->acls);
-        AJ_Free(policy);
+        AJ_MsgArenaFree(policy);
     }
 }
 
@@ -985,7 +1107,7 @@ static AJ_Status AJ_PermissionMemberUnmarshal(AJ_PermissionMember** head, AJ_Mes
         if (AJ_OK != status) {
             break;
         }
-        node = (AJ_PermissionMember*) AJ_Malloc(sizeof (AJ_PermissionMember));
+        node = (AJ_PermissionMember*) AJ_MsgArenaAlloc(msg, sizeof (AJ_PermissionMember));
         if (NULL == node) {
             goto Exit;
         }
@@ -1038,7 +1160,7 @@ static AJ_Status AJ_PermissionRuleUnmarshal(AJ_PermissionRule** head, AJ_Message
         if (AJ_OK != status) {
             break;
         }
-        node = (AJ_PermissionRule*) AJ_Malloc(sizeof (AJ_PermissionRule));
+        node = (AJ_PermissionRule*) AJ_MsgArenaAlloc(msg, sizeof (AJ_PermissionRule));
         if (NULL == node) {
             goto Exit;
         }
@@ -1086,7 +1208,7 @@ AJ_Status AJ_ManifestUnmarshal(AJ_Manifest** manifest, AJ_Message* msg)
     AJ_Arg outerStruct;
     uint8_t* beginning = NULL;
 
-    tmp = (AJ_Manifest*) AJ_Malloc(sizeof (AJ_Manifest));
+    tmp = (AJ_Manifest*) AJ_MsgArenaAlloc(msg, sizeof (AJ_Manifest));
     if (NULL == tmp) {
         return AJ_ERR_RESOURCES;
     }
@@ -1158,7 +1280,7 @@ AJ_Status AJ_ManifestArrayUnmarshal(AJ_ManifestArray** manifests, AJ_Message* ms
             break;
         }
 
-        node = (AJ_ManifestArray*)AJ_Malloc(sizeof(AJ_ManifestArray));
+        node = (AJ_ManifestArray*)AJ_MsgArenaAlloc(msg, sizeof(AJ_ManifestArray));
         if (NULL == node) {
             status = AJ_ERR_RESOURCES;
             break;
@@ -1212,7 +1334,7 @@ static AJ_Status AJ_PermissionPeerUnmarshal(AJ_PermissionPeer** head, AJ_Message
         if (AJ_OK != status) {
             break;
         }
-        node = (AJ_PermissionPeer*) AJ_Malloc(sizeof (AJ_PermissionPeer));
+        node = (AJ_PermissionPeer*) AJ_MsgArenaAlloc(msg, sizeof (AJ_PermissionPeer));
         if (NULL == node) {
             status = AJ_ERR_RESOURCES;
             goto Exit;
@@ -1292,7 +1414,7 @@ static AJ_Status AJ_PermissionACLUnmarshal(AJ_PermissionACL** head, AJ_Message*
         if (AJ_OK != status) {
             break;
         }
-        node = (AJ_PermissionACL*) AJ_Malloc(sizeof (AJ_PermissionACL));
+        node = (AJ_PermissionACL*) AJ_MsgArenaAlloc(msg, sizeof (AJ_PermissionACL));
         if (NULL == node) {
             goto Exit;
         }
@@ -1340,7 +1462,7 @@ AJ_Status AJ_PolicyUnmarshal(AJ_Policy** policy, AJ_Message* msg)
     AJ_Arg container;
     AJ_Policy* tmp = NULL;
 
-    tmp = (AJ_Policy*) AJ_Malloc(sizeof (AJ_Policy));
+    tmp = (AJ_Policy*) AJ_MsgArenaAlloc(msg, sizeof (AJ_Policy));
     if (NULL == tmp) {
         goto Exit;
     }
@@ -1489,21 +1611,17 @@ static uint8_t MemberType(uint8_t a, uint8_t b)
     return 0;
 }
 
-static uint8_t PermissionRuleAccess(AJ_PermissionRule* rule, AccessControlMember* acm, uint32_t peer, uint8_t with_public_key)
+/*
+ * The access the members of a rule grant to an access table member,
+ * the rule's object and interface have already been matched
+ */
+static uint8_t PermissionRuleAccess(const AJ_PermissionRule* rule, AccessControlMember* acm, uint32_t peer, uint8_t with_public_key)
 {
     AJ_PermissionMember* member;
     uint8_t type;
-    const char* obj;
-    const char* ifn;
     const char* mbr;
     uint8_t acc = 0;
 
-    obj = acm->obj;
-    ifn = acm->ifn;
-    /* Skip over secure annotation */
-    if ((SECURE_TRUE == *ifn) || (SECURE_OFF == *ifn)) {
-        ifn++;
-    }
     mbr = acm->mbr;
     type = MEMBER_TYPE(*mbr);
     mbr++;
@@ -1512,65 +1630,130 @@ static uint8_t PermissionRuleAccess(AJ_PermissionRule* rule, AccessControlMember
         mbr++;
     }
 
-    while (rule) {
-        if (AJ_CommonPath(rule->obj, obj, 0) && AJ_CommonPath(rule->ifn, ifn, 0)) {
-            member = rule->members;
-            while (member) {
-                if (AJ_CommonPath(member->mbr, mbr, type) && MemberType(member->type, type)) {
-                    /* Access is the union of all rules */
-                    switch (type) {
-                    case SIGNAL:
-                        if (AJ_ACTION_OBSERVE & member->action) {
-                            acc |= POLICY_SIGNAL_OUTGOING;
-                        }
-                        if (AJ_ACTION_PROVIDE & member->action) {
-                            acc |= POLICY_SIGNAL_INCOMING;
-                        }
-                        break;
+    member = rule->members;
+    while (member) {
+        if (AJ_CommonPath(member->mbr, mbr, type) && MemberType(member->type, type)) {
+            /* Access is the union of all rules */
+            switch (type) {
+            case SIGNAL:
+                if (AJ_ACTION_OBSERVE & member->action) {
+                    acc |= POLICY_SIGNAL_OUTGOING;
+                }
+                if (AJ_ACTION_PROVIDE & member->action) {
+                    acc |= POLICY_SIGNAL_INCOMING;
+                }
+                break;
 
-                    case METHOD:
-                        if (AJ_ACTION_PROVIDE & member->action) {
-                            acc |= POLICY_METHOD_OUTGOING;
-                        }
-                        if (AJ_ACTION_MODIFY & member->action) {
-                            acc |= POLICY_METHOD_INCOMING;
-                        }
-                        break;
+            case METHOD:
+                if (AJ_ACTION_PROVIDE & member->action) {
+                    acc |= POLICY_METHOD_OUTGOING;
+                }
+                if (AJ_ACTION_MODIFY & member->action) {
+                    acc |= POLICY_METHOD_INCOMING;
+                }
+                break;
 
-                    case PROPERTY:
-                        if (AJ_ACTION_PROVIDE & member->action) {
-                            acc |= POLICY_PRPSET_OUTGOING;
-                            acc |= POLICY_PRPGET_OUTGOING;
-                        }
-                        if (AJ_ACTION_MODIFY & member->action) {
-                            acc |= POLICY_PRPSET_INCOMING;
-                        }
-                        if (AJ_ACTION_OBSERVE & member->action) {
-                            acc |= POLICY_PRPGET_INCOMING;
-                        }
-                        break;
-                    }
-                    /* Only apply DENY if WITH_PUBLIC_KEY and rule is all wildcard */
-                    if (with_public_key && ('*' == rule->obj[0]) && ('*' == rule->ifn[0]) && ('*' == member->mbr[0]) && (0 == member->action)) {
-                        /* Explicit deny both directions */
-                        acm->deny[peer] = 1;
-                    }
+            case PROPERTY:
+                if (AJ_ACTION_PROVIDE & member->action) {
+                    acc |= POLICY_PRPSET_OUTGOING;
+                    acc |= POLICY_PRPGET_OUTGOING;
+                }
+                if (AJ_ACTION_MODIFY & member->action) {
+                    acc |= POLICY_PRPSET_INCOMING;
+                }
+                if (AJ_ACTION_OBSERVE & member->action) {
+                    acc |= POLICY_PRPGET_INCOMING;
                 }
-                member = member->next;
+                break;
+            }
+            /* Only apply DENY if WITH_PUBLIC_KEY and rule is all wildcard */
+            if (with_public_key && ('*' == rule->obj[0]) && ('*' == rule->ifn[0]) && ('*' == member->mbr[0]) && (0 == member->action)) {
+                /* Explicit deny both directions */
+                acm->deny[PEER_BYTE(peer)] |= PEER_BIT(peer);
             }
         }
-        rule = rule->next;
+        member = member->next;
     }
 
     return acc;
 }
 
+/*
+ * How the access granted by rules is stored
+ */
+#define APPLY_POLICY                0x01
+#define APPLY_MANIFEST              0x02
+#define APPLY_BOTH                  (APPLY_POLICY | APPLY_MANIFEST)
+
+/*
+ * Rules whose object and interface match are collected in batches
+ */
+#define APPLY_BATCH                 16
+
+/*
+ * Applies a list of rules for a peer to the whole access table. The members of an
+ * interface are adjacent in the table so the object and interface of each rule are
+ * matched once per interface rather than once per member.
+ */
+static void AccessControlApply(const AJ_PermissionRule* rules, uint32_t peer, uint8_t with_public_key, uint8_t apply)
+{
+    const AJ_PermissionRule* matched[APPLY_BATCH];
+    const AJ_PermissionRule* rule;
+    AccessControlMember* acm;
+    const char* obj;
+    const char* ifn;
+    uint16_t start = 0;
+    uint16_t end;
+    uint16_t n;
+    uint8_t num;
+    uint8_t acc;
+    uint8_t i;
+
+    while (start < g_access.count) {
+        obj = g_access.members[start].obj;
+        ifn = g_access.members[start].ifn;
+        end = start + 1;
+        while ((end < g_access.count) && (obj == g_access.members[end].obj) && (ifn == g_access.members[end].ifn)) {
+            end++;
+        }
+        /* Skip over secure annotation */
+        if ((SECURE_TRUE == *ifn) || (SECURE_OFF == *ifn)) {
+            ifn++;
+        }
+        rule = rules;
+        while (rule) {
+            num = 0;
+            while (rule && (num < APPLY_BATCH)) {
+                if (AJ_CommonPath(rule->obj, obj, 0) && AJ_CommonPath(rule->ifn, ifn, 0)) {
+                    matched[num++] = rule;
+                }
+                rule = rule->next;
+            }
+            for (n = start; num && (n < end); n++) {
+                acm = &g_access.members[n];
+                acc = 0;
+                /* Access is the union of all rules */
+                for (i = 0; i < num; i++) {
+                    acc |= PermissionRuleAccess(matched[i], acm, peer, with_public_key);
+                }
+                /* Manifest permissions are stored in the most significant part of the byte */
+                acc = ((APPLY_POLICY & apply) ? acc : 0) | ((APPLY_MANIFEST & apply) ? (acc << 4) : 0);
+#ifdef AJ_DEBUG_BUILD
+                if (acc) {
+                    AJ_InfoPrintf(("Access: 0x%08X %s %s %s %x\n", acm->id, acm->obj, acm->ifn, acm->mbr, acc));
+                }
+#endif
+                MemberAllow(acm, peer, acc);
+            }
+        }
+        start = end;
+    }
+}
+
 AJ_Status AJ_ManifestApply(AJ_Manifest* manifest, const char* name, AJ_AuthenticationContext* ctx)
 {
     AJ_Status status;
     uint32_t peer;
-    uint8_t acc;
-    AccessControlMember* acm;
     AJ_CredField manifest_data;
     AJ_SHA256_Context* digestHashCtx;
     AJ_ECCSignature eccSignature;
@@ -1676,19 +1859,7 @@ AJ_Status AJ_ManifestApply(AJ_Manifest* manifest, const char* name, AJ_Authentic
     ManifestDump(manifest);
 #endif
 
-    acm = g_access;
-    while (acm) {
-        acc = PermissionRuleAccess(manifest->rules, acm, peer, FALSE);
-        /* Manifest permissions are stored in the most significant part of the byte */
-        acc <<= 4;
-#ifdef AJ_DEBUG_BUILD
-        if (acc) {
-            AJ_InfoPrintf(("Access: 0x%08X %s %s %s %x\n", acm->id, acm->obj, acm->ifn, acm->mbr, acc));
-        }
-#endif
-        acm->allow[peer] |= acc;
-        acm = acm->next;
-    }
+    AccessControlApply(manifest->rules, peer, FALSE, APPLY_MANIFEST);
 
     return AJ_OK;
 }
@@ -1754,6 +1925,7 @@ AJ_Status AJ_PolicyApply(AJ_AuthenticationContext* ctx, const char* name)
     uint16_t info;
     uint8_t found;
     size_t i;
+    uint16_t n;
 
     AJ_InfoPrintf(("AJ_PolicyApply(ctx=%p, name=%s)\n", ctx, name));
 
@@ -1783,30 +1955,17 @@ AJ_Status AJ_PolicyApply(AJ_AuthenticationContext* ctx, const char* name)
                 }
             }
             if (found) {
-                acm = g_access;
-                while (acm) {
-                    acc = PermissionRuleAccess(acl->rules, acm, peer, found >> 1);
-                    if (AUTH_SUITE_ECDHE_ECDSA != ctx->suite) {
-                        /* We don't receive a manifest, so switch those bits on too */
-                        acc |= (acc << 4);
-                    }
-#ifdef AJ_DEBUG_BUILD
-                    if (acc) {
-                        AJ_InfoPrintf(("Access: 0x%08X %s %s %s %x\n", acm->id, acm->obj, acm->ifn, acm->mbr, acc));
-                    }
-#endif
-                    acm->allow[peer] |= acc;
-                    acm = acm->next;
-                }
+                /* We don't receive a manifest without ECDSA, so switch those bits on too */
+                AccessControlApply(acl->rules, peer, found >> 1, (AUTH_SUITE_ECDHE_ECDSA != ctx->suite) ? APPLY_BOTH : APPLY_POLICY);
             }
             acl = acl->next;
         }
     } else {
         AJ_InfoPrintf(("AJ_PolicyApply(ctx=%p, name=%p): No stored policy\n", ctx, name));
         /* Initial restricted access rights */
-        acm = g_access;
-        while (acm) {
-            acm->allow[peer] = 0;
+        for (n = 0; n < g_access.count; n++) {
+            acm = &g_access.members[n];
+            acc = 0;
             switch (acm->id) {
             case AJ_METHOD_SECURITY_GET_PROP:
             case AJ_PROPERTY_SEC_VERSION:
@@ -1818,7 +1977,7 @@ AJ_Status AJ_PolicyApply(AJ_AuthenticationContext* ctx, const char* name)
             case AJ_PROPERTY_SEC_CLAIM_CAPABILITIES:
             case AJ_PROPERTY_SEC_CLAIM_CAPABILITIES_INFO:
             case AJ_PROPERTY_CLAIMABLE_VERSION:
-                acm->allow[peer] = POLICY_INCOMING | MANIFEST_INCOMING;
+                acc = POLICY_INCOMING | MANIFEST_INCOMING;
                 break;
 
             case AJ_METHOD_CLAIMABLE_CLAIM:
@@ -1826,13 +1985,13 @@ AJ_Status AJ_PolicyApply(AJ_AuthenticationContext* ctx, const char* name)
                 AJ_SecurityGetClaimConfig(&state, &capabilities, &info);
                 if (APP_STATE_CLAIMABLE == state) {
                     if ((CLAIM_CAPABILITY_ECDHE_NULL & capabilities) && (AUTH_SUITE_ECDHE_NULL == ctx->suite)) {
-                        acm->allow[peer] = POLICY_INCOMING | MANIFEST_INCOMING;
+                        acc = POLICY_INCOMING | MANIFEST_INCOMING;
                     } else if ((CLAIM_CAPABILITY_ECDHE_PSK & capabilities) && (AUTH_SUITE_ECDHE_PSK == ctx->suite)) {
-                        acm->allow[peer] = POLICY_INCOMING | MANIFEST_INCOMING;
+                        acc = POLICY_INCOMING | MANIFEST_INCOMING;
                     } else if ((CLAIM_CAPABILITY_ECDHE_SPEKE & capabilities) && (AUTH_SUITE_ECDHE_SPEKE == ctx->suite)) {
-                        acm->allow[peer] = POLICY_INCOMING | MANIFEST_INCOMING;
+                        acc = POLICY_INCOMING | MANIFEST_INCOMING;
                     } else if ((CLAIM_CAPABILITY_ECDHE_ECDSA & capabilities) && (AUTH_SUITE_ECDHE_ECDSA == ctx->suite)) {
-                        acm->allow[peer] = POLICY_INCOMING | MANIFEST_INCOMING;
+                        acc = POLICY_INCOMING | MANIFEST_INCOMING;
                     }
                 }
                 break;
@@ -1860,9 +2019,10 @@ AJ_Status AJ_PolicyApply(AJ_AuthenticationContext* ctx, const char* name)
 
             default:
                 /* All allowed incoming and outgoing (Security 1.0) */
-                acm->allow[peer] = POLICY_ACCESS | MANIFEST_ACCESS;
+                acc = POLICY_ACCESS | MANIFEST_ACCESS;
             }
-            acm = acm->next;
+            MemberClear(acm, peer);
+            MemberAllow(acm, peer, acc);
         }
     }
 
@@ -1874,8 +2034,6 @@ AJ_Status AJ_MembershipApply(X509CertificateChain* root, AJ_ECCPublicKey* issuer
     AJ_Status status;
     Policy* policy = &g_policy;
     uint32_t peer;
-    uint8_t acc;
-    AccessControlMember* acm;
     AJ_PermissionACL* acl;
     uint8_t found;
 
@@ -1903,17 +2061,7 @@ AJ_Status AJ_MembershipApply(X509CertificateChain* root, AJ_ECCPublicKey* issuer
                 }
             }
             if (found) {
-                acm = g_access;
-                while (acm) {
-                    acc = PermissionRuleAccess(acl->rules, acm, peer, FALSE);
-#ifdef AJ_DEBUG_BUILD
-                    if (acc) {
-                        AJ_InfoPrintf(("Access: 0x%08X %s %s %s %x\n", acm->id, acm->obj, acm->ifn, acm->mbr, acc));
-                    }
-#endif
-                    acm->allow[peer] |= acc;
-                    acm = acm->next;
-                }
+                AccessControlApply(acl->rules, peer, FALSE, APPLY_POLICY);
             }
             acl = acl->next;
         }
@@ -57,6 +57,7 @@ void AJ_IOBufInit(AJ_IOBuffer* ioBuf, uint8_t* buffer, uint32_t bufLen, uint8_t
     ioBuf->writePtr = buffer;
     ioBuf->direction = direction;
     ioBuf->context = context;
+    ioBuf->sendv = NULL;
 }
 
 void AJ_IOBufRebase(AJ_IOBuffer* ioBuf, size_t preserve)
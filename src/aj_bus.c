@@ -51,6 +51,11 @@
 #include <ajtcl/aj_about.h>
 #include <ajtcl/aj_security.h>
 #include <ajtcl/aj_authentication.h>
+#include <ajtcl/aj_guid.h>
+#include <ajtcl/aj_helper.h>
+#ifdef AJ_ARDP
+#include <ajtcl/aj_ardp.h>
+#endif
 
 /**
  * Turn on per-module debug printing by setting this variable to non-zero value
@@ -507,6 +512,20 @@ AJ_Status AJ_BusHandleBusMessage(AJ_Message* msg)
     if (!msg->hdr) {
         return AJ_OK;
     }
+    /*
+     * Messages that are decrypted as they are loaded are not authenticated until they are closed
+     * so they are never handled here
+     */
+    if (msg->rxStream) {
+        AJ_ErrPrintf(("AJ_BusHandleBusMessage(): AJ_ERR_SECURITY\n"));
+        if ((msg->hdr->msgType == AJ_MSG_METHOD_CALL) && !(msg->hdr->flags & AJ_FLAG_NO_REPLY_EXPECTED)) {
+            status = AJ_MarshalStatusMsg(msg, &reply, AJ_ERR_SECURITY);
+            if (status == AJ_OK) {
+                status = AJ_DeliverMsg(&reply);
+            }
+        }
+        return status;
+    }
 
     switch (msg->msgId) {
     case AJ_METHOD_PING:
@@ -1254,3 +1273,85 @@ unmarshal_error:
     AJ_ErrPrintf(("AJ_BusHandleJoinSessionReply(msg=0x%p): Unmarshal error\n", msg));
     return status;
 }
+
+/*
+ * Per-attachment state
+ */
+typedef struct _AJ_BusContext {
+    AJ_NameMapState* nameMap;
+    AJ_IntrospectState* introspect;
+    AJ_TimerState* timers;
+#ifdef AJ_ARDP
+    AJ_ArdpState* ardp;
+#endif
+} AJ_BusContext;
+
+static void FreeContext(AJ_BusContext* context)
+{
+    AJ_GUID_NameMapStateFree(context->nameMap);
+    AJ_IntrospectStateFree(context->introspect);
+    AJ_TimerStateFree(context->timers);
+#ifdef AJ_ARDP
+    AJ_ARDP_StateFree(context->ardp);
+#endif
+    AJ_Free(context);
+}
+
+AJ_Status AJ_BusContextCreate(AJ_BusAttachment* bus)
+{
+    AJ_BusContext* context;
+    uint8_t allocated;
+
+    if (bus->context) {
+        return AJ_OK;
+    }
+    context = (AJ_BusContext*)AJ_Malloc(sizeof(AJ_BusContext));
+    if (!context) {
+        AJ_ErrPrintf(("AJ_BusContextCreate(): AJ_ERR_RESOURCES\n"));
+        return AJ_ERR_RESOURCES;
+    }
+    context->nameMap = AJ_GUID_NameMapStateNew();
+    context->introspect = AJ_IntrospectStateNew();
+    context->timers = AJ_TimerStateNew();
+    allocated = context->nameMap && context->introspect && context->timers;
+#ifdef AJ_ARDP
+    context->ardp = AJ_ARDP_StateNew();
+    allocated = allocated && context->ardp;
+#endif
+    if (!allocated) {
+        AJ_ErrPrintf(("AJ_BusContextCreate(): AJ_ERR_RESOURCES\n"));
+        FreeContext(context);
+        return AJ_ERR_RESOURCES;
+    }
+    bus->context = context;
+    return AJ_OK;
+}
+
+void AJ_BusContextDestroy(AJ_BusAttachment* bus)
+{
+    if (bus->context) {
+        FreeContext(bus->context);
+        bus->context = NULL;
+    }
+}
+
+void AJ_BusContextSelect(const AJ_BusAttachment* bus)
+{
+    AJ_BusContext* context = bus ? bus->context : NULL;
+
+    if (context) {
+        AJ_GUID_NameMapStateSelect(context->nameMap);
+        AJ_IntrospectStateSelect(context->introspect);
+        AJ_TimerStateSelect(context->timers);
+#ifdef AJ_ARDP
+        AJ_ARDP_StateSelect(context->ardp);
+#endif
+    } else {
+        AJ_GUID_NameMapStateSelect(NULL);
+        AJ_IntrospectStateSelect(NULL);
+        AJ_TimerStateSelect(NULL);
+#ifdef AJ_ARDP
+        AJ_ARDP_StateSelect(NULL);
+#endif
+    }
+}
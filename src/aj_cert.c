@@ -1004,7 +1004,7 @@ void AJ_X509ChainFree(X509CertificateChain* root)
     while (root) {
         node = root;
         root = root->next;
-        AJ_Free(node);
+        AJ_MsgArenaFree(node);
     }
 }
 
@@ -1064,7 +1064,7 @@ AJ_Status AJ_X509ChainUnmarshal(X509CertificateChain** root, AJ_Message* msg)
             AJ_WarnPrintf(("AJ_X509ChainUnmarshal(root=%p, msg=%p): Certificate format unknown\n", root, msg));
             goto Exit;
         }
-        node = (X509CertificateChain*) AJ_Malloc(sizeof (X509CertificateChain));
+        node = (X509CertificateChain*) AJ_MsgArenaAlloc(msg, sizeof (X509CertificateChain));
         if (NULL == node) {
             goto Exit;
         }
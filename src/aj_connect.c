@@ -53,6 +53,7 @@
 #include <ajtcl/aj_peer.h>
 #include <ajtcl/aj_authorisation.h>
 #include <ajtcl/aj_security.h>
+#include <ajtcl/aj_nvram.h>
 
 #ifdef AJ_ARDP
 #include <ajtcl/aj_ardp.h>
@@ -77,7 +78,7 @@ AJ_EXPORT uint8_t dbgCONNECT = 0;
 /*
  * Protocol version of the router you have connected to
  */
-static uint8_t routingProtoVersion = 0;
+static AJ_THREAD_LOCAL uint8_t routingProtoVersion = 0;
 /*
  * Minimum accepted protocol version of a router to be connected to
  * Version 10 (14.06) allows for NGNS and untrusted connection to router
@@ -360,25 +361,216 @@ ExitConnect:
 
 static void AddRoutingNodeToBlacklist(const AJ_Service* service, uint8_t addrTypes);
 
+#if AJ_ROUTING_NODE_CACHE
+static uint8_t ServiceIsEqual(const AJ_Service* A, const AJ_Service* B);
+
+/*
+ * Bumped when the layout of the cache entries changes
+ */
+#define RN_CACHE_VERSION  1
+
+/*
+ * Successes are counted up to this value, beyond that the entry is not rewritten on every connect
+ */
+#define RN_CACHE_MAX_SUCCESSES  16
+
+typedef struct {
+    uint32_t key;           /* Hash of the service name prefix, zero if the entry is unused */
+    uint16_t successes;     /* Number of successful connections */
+    uint16_t failures;      /* Number of consecutive failed connections */
+    AJ_Service service;     /* The routing node */
+} RNCacheEntry;
+
+typedef struct {
+    uint16_t version;
+    uint16_t entrySize;
+    RNCacheEntry entries[AJ_ROUTING_NODE_CACHE_SIZE];
+} RNCache;
+
+static uint32_t RNCacheKey(const char* prefix)
+{
+    uint32_t hash = 2166136261UL;
+    while (*prefix) {
+        hash = (hash ^ (uint8_t)*prefix++) * 16777619UL;
+    }
+    return hash ? hash : 1;
+}
+
+static void LoadRNCache(RNCache* cache)
+{
+    AJ_NV_DATASET* ds = AJ_NVRAM_Open(AJ_ROUTING_NODE_CACHE_NV_ID, "r", 0);
+    if (ds) {
+        if (AJ_NVRAM_Read(cache, sizeof(RNCache), ds) != sizeof(RNCache)) {
+            cache->version = 0;
+        }
+        AJ_NVRAM_Close(ds);
+    }
+    if (!ds || (cache->version != RN_CACHE_VERSION) || (cache->entrySize != sizeof(RNCacheEntry))) {
+        memset(cache, 0, sizeof(RNCache));
+        cache->version = RN_CACHE_VERSION;
+        cache->entrySize = sizeof(RNCacheEntry);
+    }
+}
+
+static void StoreRNCache(const RNCache* cache)
+{
+    AJ_NV_DATASET* ds = AJ_NVRAM_Open(AJ_ROUTING_NODE_CACHE_NV_ID, "w", sizeof(RNCache));
+    if (ds) {
+        AJ_NVRAM_Write(cache, sizeof(RNCache), ds);
+        AJ_NVRAM_Close(ds);
+    } else {
+        AJ_WarnPrintf(("StoreRNCache(): could not write the routing node cache\n"));
+    }
+}
+
+static RNCacheEntry* FindRNCacheEntry(RNCache* cache, uint32_t key)
+{
+    uint8_t i;
+    for (i = 0; i < AJ_ROUTING_NODE_CACHE_SIZE; ++i) {
+        if (cache->entries[i].key == key) {
+            return &cache->entries[i];
+        }
+    }
+    return NULL;
+}
+
+AJ_Status AJ_GetCachedRoutingNode(const char* prefix, AJ_Service* service)
+{
+    RNCache cache;
+    RNCacheEntry* entry;
+
+    LoadRNCache(&cache);
+    entry = FindRNCacheEntry(&cache, RNCacheKey(prefix));
+    if (!entry || (entry->failures >= AJ_ROUTING_NODE_CACHE_MAX_FAILURES) || (entry->service.pv < AJ_GetMinProtoVersion())) {
+        return AJ_ERR_NO_MATCH;
+    }
+    if (AJ_IsRoutingNodeBlacklisted(&entry->service)) {
+        return AJ_ERR_NO_MATCH;
+    }
+    *service = entry->service;
+    return AJ_OK;
+}
+
+void AJ_CacheRoutingNode(const char* prefix, const AJ_Service* service, uint8_t connected)
+{
+    RNCache cache;
+    RNCacheEntry* entry;
+    uint32_t key = RNCacheKey(prefix);
+    uint8_t same;
+
+    LoadRNCache(&cache);
+    entry = FindRNCacheEntry(&cache, key);
+    same = entry && ServiceIsEqual(&entry->service, service);
+    if (!connected) {
+        /*
+         * Only the cached routing node has a failure history
+         */
+        if (same) {
+            ++entry->failures;
+            StoreRNCache(&cache);
+        }
+        return;
+    }
+    if (same) {
+        if (!entry->failures && (entry->successes >= RN_CACHE_MAX_SUCCESSES)) {
+            return;
+        }
+        entry->failures = 0;
+        ++entry->successes;
+        entry->service = *service;
+    } else {
+        if (!entry) {
+            /*
+             * Use a free entry or replace the one with the worst history
+             */
+            uint8_t i;
+            entry = &cache.entries[0];
+            for (i = 0; i < AJ_ROUTING_NODE_CACHE_SIZE; ++i) {
+                RNCacheEntry* e = &cache.entries[i];
+                if (!e->key) {
+                    entry = e;
+                    break;
+                }
+                if ((e->failures > entry->failures) || ((e->failures == entry->failures) && (e->successes < entry->successes))) {
+                    entry = e;
+                }
+            }
+        }
+        entry->key = key;
+        entry->successes = 1;
+        entry->failures = 0;
+        entry->service = *service;
+    }
+    StoreRNCache(&cache);
+}
+
+void AJ_ClearRoutingNodeCache(void)
+{
+    if (AJ_NVRAM_Exist(AJ_ROUTING_NODE_CACHE_NV_ID)) {
+        AJ_NVRAM_Delete(AJ_ROUTING_NODE_CACHE_NV_ID);
+    }
+}
+
+#if !AJ_CONNECT_LOCALHOST && !defined(ARDUINO) && !defined(AJ_SERIAL_CONNECTION)
+#define RN_CACHE_CONNECT
+#endif
+#endif
+
+#ifdef RN_CACHE_CONNECT
+/*
+ * Returns TRUE if there is a cached routing node for the prefix that is worth trying
+ */
+static uint8_t TryCachedRoutingNode(const char* prefix, AJ_Service* service)
+{
+    if (AJ_GetCachedRoutingNode(prefix, service) != AJ_OK) {
+        return FALSE;
+    }
+#ifdef AJ_NET_PROBE
+    /*
+     * Connecting to a routing node that has gone away blocks until the connect times out so
+     * check that it is still there first, this costs one round trip.
+     */
+    if (service->addrTypes & (AJ_ADDR_TCP4 | AJ_ADDR_TCP6)) {
+        uint32_t rtt;
+        if (AJ_Net_Probe(service, 1, &rtt, AJ_ROUTING_NODE_PROBE_TIMEOUT, 0) != AJ_OK) {
+            AJ_InfoPrintf(("TryCachedRoutingNode(): cached routing node did not answer\n"));
+            AJ_CacheRoutingNode(prefix, service, FALSE);
+            return FALSE;
+        }
+    }
+#endif
+    return TRUE;
+}
+#endif
+
 AJ_Status AJ_FindBusAndConnect(AJ_BusAttachment* bus, const char* serviceName, uint32_t timeout)
 {
     AJ_Status status;
     AJ_Service service;
+#if defined(ARDUINO) || !defined(AJ_SERIAL_CONNECTION)
     AJ_Time connectionTimer;
     int32_t connectionTime;
+#endif
     uint8_t finished = FALSE;
-
+    struct _AJ_BusContext* context = bus->context;
+#ifdef RN_CACHE_CONNECT
+    uint8_t tryCache = TRUE;
+    uint8_t cached = FALSE;
+#endif
 #ifdef AJ_SERIAL_CONNECTION
     AJ_Time start, now;
     AJ_InitTimer(&start);
 #endif
 
+    AJ_BusContextSelect(bus);
+
     AJ_InfoPrintf(("AJ_FindBusAndConnect(bus=0x%p, serviceName=\"%s\", timeout=%d, selection timeout=%d.)\n", bus, serviceName, timeout, selectionTimeout));
 
     /*
-     * Clear the bus struct
+     * Clear the bus struct, the context belongs to the application
      */
     memset(bus, 0, sizeof(AJ_BusAttachment));
+    bus->context = context;
     bus->isProbeRequired = TRUE;
 
     /*
@@ -395,7 +587,9 @@ AJ_Status AJ_FindBusAndConnect(AJ_BusAttachment* bus, const char* serviceName, u
 
     while (finished == FALSE) {
         finished = TRUE;
+#if defined(ARDUINO) || !defined(AJ_SERIAL_CONNECTION)
         connectionTime = (int32_t) timeout;
+#endif
 
 #if AJ_CONNECT_LOCALHOST
         service.ipv4port = 9955;
@@ -427,7 +621,21 @@ AJ_Status AJ_FindBusAndConnect(AJ_BusAttachment* bus, const char* serviceName, u
 #else
         AJ_InitTimer(&connectionTimer);
         AJ_InfoPrintf(("AJ_FindBusAndConnect(): Connection timer started\n"));
+#ifdef RN_CACHE_CONNECT
+        /*
+         * Go straight to the routing node that worked last time, discovery is the fallback
+         */
+        cached = tryCache && TryCachedRoutingNode(serviceName, &service);
+        tryCache = FALSE;
+        if (cached) {
+            AJ_InfoPrintf(("AJ_FindBusAndConnect(): Trying cached routing node\n"));
+            status = AJ_OK;
+        } else {
+            status = AJ_Discover(serviceName, &service, timeout, selectionTimeout);
+        }
+#else
         status = AJ_Discover(serviceName, &service, timeout, selectionTimeout);
+#endif
         if (status != AJ_OK) {
             AJ_InfoPrintf(("AJ_FindBusAndConnect(): AJ_Discover status=%s\n", AJ_StatusText(status)));
             goto ExitConnect;
@@ -438,6 +646,13 @@ AJ_Status AJ_FindBusAndConnect(AJ_BusAttachment* bus, const char* serviceName, u
         status = AJ_Net_Connect(bus, &service);
         if (status != AJ_OK) {
             AJ_InfoPrintf(("AJ_FindBusAndConnect(): AJ_Net_Connect status=%s\n", AJ_StatusText(status)));
+#ifdef RN_CACHE_CONNECT
+            if (cached) {
+                AJ_CacheRoutingNode(serviceName, &service, FALSE);
+                finished = FALSE;
+                continue;
+            }
+#endif
             goto ExitConnect;
         }
 
@@ -458,6 +673,14 @@ AJ_Status AJ_FindBusAndConnect(AJ_BusAttachment* bus, const char* serviceName, u
         status = AJ_Authenticate(bus);
         if (status != AJ_OK) {
             AJ_InfoPrintf(("AJ_FindBusAndConnect(): AJ_Authenticate status=%s\n", AJ_StatusText(status)));
+#ifdef RN_CACHE_CONNECT
+            if (cached) {
+                AJ_CacheRoutingNode(serviceName, &service, FALSE);
+                AJ_Disconnect(bus);
+                finished = FALSE;
+                continue;
+            }
+#endif
 #if !AJ_CONNECT_LOCALHOST && !defined(ARDUINO) && !defined(AJ_SERIAL_CONNECTION)
             if ((status == AJ_ERR_ACCESS_ROUTING_NODE) || (status == AJ_ERR_OLD_VERSION)) {
                 AJ_InfoPrintf(("AJ_FindBusAndConnect(): Blacklisting routing node\n"));
@@ -507,6 +730,9 @@ AJ_Status AJ_FindBusAndConnect(AJ_BusAttachment* bus, const char* serviceName, u
             AJ_InfoPrintf(("AJ_FindBusAndConnect(): SetSignalRules status=%s\n", AJ_StatusText(status)));
             goto ExitConnect;
         }
+#ifdef RN_CACHE_CONNECT
+        AJ_CacheRoutingNode(serviceName, &service, TRUE);
+#endif
 
         AJ_InitRoutingNodeResponselist();
     }
@@ -601,6 +827,7 @@ AJ_Status AJ_ARDP_UDP_Connect(AJ_BusAttachment* bus, void* context, const AJ_Ser
 
 void AJ_Disconnect(AJ_BusAttachment* bus)
 {
+    AJ_BusContextSelect(bus);
     /*
      * Close security module
      */
@@ -609,7 +836,7 @@ void AJ_Disconnect(AJ_BusAttachment* bus)
     /*
      * We won't be getting any more method replies.
      */
-    AJ_ReleaseReplyContexts();
+    AJ_ReleaseReplyContexts(bus);
 
     /*
      * Disconnect the network closing sockets etc.
@@ -641,13 +868,14 @@ void AJ_Disconnect(AJ_BusAttachment* bus)
     AJ_BusRemoveAllSessions(bus);
 }
 
-static uint32_t RNBlacklistIP[AJ_ROUTING_NODE_BLACKLIST_SIZE];
-static uint16_t RNBlacklistPort[AJ_ROUTING_NODE_BLACKLIST_SIZE];
-static uint8_t RNBlacklistIndex = 0;
+static AJ_THREAD_LOCAL uint32_t RNBlacklistIP[AJ_ROUTING_NODE_BLACKLIST_SIZE];
+static AJ_THREAD_LOCAL uint16_t RNBlacklistPort[AJ_ROUTING_NODE_BLACKLIST_SIZE];
+static AJ_THREAD_LOCAL uint8_t RNBlacklistIndex = 0;
 
-static AJ_Service RNResponseList[AJ_ROUTING_NODE_RESPONSELIST_SIZE];
-static uint16_t RNAttemptsList[AJ_ROUTING_NODE_RESPONSELIST_SIZE];
-static uint8_t RNResponseListIndex = 0;
+static AJ_THREAD_LOCAL AJ_Service RNResponseList[AJ_ROUTING_NODE_RESPONSELIST_SIZE];
+static AJ_THREAD_LOCAL uint16_t RNAttemptsList[AJ_ROUTING_NODE_RESPONSELIST_SIZE];
+static AJ_THREAD_LOCAL uint32_t RNRttList[AJ_ROUTING_NODE_RESPONSELIST_SIZE];
+static AJ_THREAD_LOCAL uint8_t RNResponseListIndex = 0;
 
 uint8_t AJ_IsRoutingNodeBlacklisted(AJ_Service* service)
 {
@@ -667,7 +895,7 @@ uint8_t AJ_IsRoutingNodeBlacklisted(AJ_Service* service)
     return FALSE;
 }
 
-static uint8_t ServiceIsEqual(AJ_Service* A, AJ_Service* B) {
+static uint8_t ServiceIsEqual(const AJ_Service* A, const AJ_Service* B) {
 
     /*
      * Two services are equal if at least one of their address/port pairs match
@@ -771,6 +999,7 @@ void AJ_AddRoutingNodeToResponseList(AJ_Service* service)
     }
 
     RNResponseList[candidate] = *service;
+    RNRttList[candidate] = 0;
 
     if (RNResponseListIndex < AJ_ROUTING_NODE_RESPONSELIST_SIZE) {
         RNResponseListIndex++;
@@ -790,15 +1019,26 @@ void AJ_AddRoutingNodeToResponseList(AJ_Service* service)
     }
 }
 
+/*
+ * The score of a response is its service priority penalized by the round trip time measured when
+ * the routing nodes were probed. Lower is better.
+ */
+static uint32_t RoutingNodeScore(uint8_t i)
+{
+    return RNResponseList[i].priority + RNRttList[i] * AJ_ROUTING_NODE_RTT_WEIGHT;
+}
+
 AJ_Status AJ_SelectRoutingNodeFromResponseList(AJ_Service* service)
 {
     /*
      * The selection involves choosing the router with the
-     * highest protocol version and the lowest service priority
-     * (inverse of static rank/score).
+     * highest protocol version and the lowest score (service
+     * priority, the inverse of static rank/score, penalized by
+     * the measured round trip time).
      */
     uint8_t i = 1;
     uint8_t selectedIndex = 0;
+    uint32_t score = 0;
     uint32_t runningSum = 0;
     uint8_t skip = 0;
     uint32_t priority_idx = 0;
@@ -807,7 +1047,8 @@ AJ_Status AJ_SelectRoutingNodeFromResponseList(AJ_Service* service)
 
     if (RNResponseList[0].addrTypes != 0) {
         *service = RNResponseList[0];
-        runningSum = service->priority;
+        score = RoutingNodeScore(0);
+        runningSum = score;
         skip = RNAttemptsList[0];
         if (skip) {
             AJ_InfoPrintf(("Index 0 was previously selected\n"));
@@ -821,18 +1062,20 @@ AJ_Status AJ_SelectRoutingNodeFromResponseList(AJ_Service* service)
                 if (skip) {
                     *service = RNResponseList[i];
                     selectedIndex = i;
-                    runningSum = service->priority;
+                    score = RoutingNodeScore(i);
+                    runningSum = score;
                     skip = 0;
                     continue;
                 }
                 if (RNResponseList[i].pv < service->pv) {
                     continue;
                 }
-                if (RNResponseList[i].pv > service->pv || (RNResponseList[i].pv == service->pv && RNResponseList[i].priority < service->priority)) {
+                if (RNResponseList[i].pv > service->pv || (RNResponseList[i].pv == service->pv && RoutingNodeScore(i) < score)) {
                     *service = RNResponseList[i];
                     selectedIndex = i;
+                    score = RoutingNodeScore(i);
                     AJ_InfoPrintf(("Tentatively selecting routing node %x (pv = %d, port = %d, priority = %d).\n", service->ipv4, service->pv, service->ipv4port, service->priority));
-                } else if (RNResponseList[i].priority == service->priority) {
+                } else if (RoutingNodeScore(i) == score) {
                     /*
                      * Randomly select one of out of all the routing nodes with the same
                      * protocol version and priority with each node given an equal chance
@@ -845,7 +1088,7 @@ AJ_Status AJ_SelectRoutingNodeFromResponseList(AJ_Service* service)
                      */
                     rand32 = 0;
                     AJ_RandBytes((uint8_t*)&rand32, sizeof(rand32));
-                    priority_idx = RNResponseList[i].priority + runningSum;
+                    priority_idx = RoutingNodeScore(i) + runningSum;
                     priority_srv = runningSum;
                     runningSum = priority_idx;
                     rand32 %= (runningSum + 1);
@@ -893,6 +1136,76 @@ uint8_t AJ_GetRoutingNodeResponseListSize()
     return RNResponseListIndex;
 }
 
+#ifdef AJ_NET_PROBE
+/*
+ * Returns TRUE if response a ranks higher than response b by protocol version and priority
+ */
+static uint8_t IsBetterRoutingNode(uint8_t a, uint8_t b)
+{
+    if (RNResponseList[a].pv != RNResponseList[b].pv) {
+        return RNResponseList[a].pv > RNResponseList[b].pv;
+    }
+    return RNResponseList[a].priority < RNResponseList[b].priority;
+}
+
+AJ_Status AJ_ProbeRoutingNodeResponseList(uint32_t timeout)
+{
+    AJ_Status status;
+    AJ_Service probes[AJ_ROUTING_NODE_PROBE_COUNT];
+    uint32_t rtt[AJ_ROUTING_NODE_PROBE_COUNT];
+    uint8_t index[AJ_ROUTING_NODE_PROBE_COUNT];
+    uint8_t numProbes = 0;
+    uint8_t i;
+    uint8_t j;
+
+    /*
+     * Pick the best responses that have not been tried yet and have a TCP address
+     */
+    for (i = 0; i < RNResponseListIndex; ++i) {
+        if (RNAttemptsList[i] || !(RNResponseList[i].addrTypes & (AJ_ADDR_TCP4 | AJ_ADDR_TCP6))) {
+            continue;
+        }
+        for (j = numProbes; (j > 0) && IsBetterRoutingNode(i, index[j - 1]); --j) {
+            if (j < AJ_ROUTING_NODE_PROBE_COUNT) {
+                index[j] = index[j - 1];
+            }
+        }
+        if (j < AJ_ROUTING_NODE_PROBE_COUNT) {
+            index[j] = i;
+            if (numProbes < AJ_ROUTING_NODE_PROBE_COUNT) {
+                ++numProbes;
+            }
+        }
+    }
+    if (!numProbes) {
+        return AJ_OK;
+    }
+    for (j = 0; j < numProbes; ++j) {
+        probes[j] = RNResponseList[index[j]];
+    }
+    status = AJ_Net_Probe(probes, numProbes, rtt, timeout, AJ_ROUTING_NODE_PROBE_GRACE);
+    if (status != AJ_OK) {
+        /*
+         * Nothing answered over TCP so leave the list alone, the routing nodes may still be
+         * reachable over UDP.
+         */
+        AJ_InfoPrintf(("AJ_ProbeRoutingNodeResponseList(): status=%s\n", AJ_StatusText(status)));
+        return status;
+    }
+    for (j = 0; j < numProbes; ++j) {
+        i = index[j];
+        if (rtt[j] == AJ_NET_PROBE_UNREACHABLE) {
+            AJ_InfoPrintf(("AJ_ProbeRoutingNodeResponseList(): skipping unreachable routing node 0x%x\n", htonl(RNResponseList[i].ipv4)));
+            RNAttemptsList[i] = 1;
+        } else {
+            AJ_InfoPrintf(("AJ_ProbeRoutingNodeResponseList(): routing node 0x%x rtt=%u\n", htonl(RNResponseList[i].ipv4), rtt[j]));
+            RNRttList[i] = rtt[j];
+        }
+    }
+    return AJ_OK;
+}
+#endif
+
 static void AddRoutingNodeToBlacklist(const AJ_Service* service, uint8_t addrTypes)
 {
     if ((addrTypes & AJ_ADDR_TCP4) && (service->addrTypes & AJ_ADDR_TCP4)) {
@@ -912,6 +1225,7 @@ void AJ_InitRoutingNodeResponselist()
 {
     memset(RNResponseList, 0, sizeof(RNResponseList));
     memset(RNAttemptsList, 0, sizeof(RNAttemptsList));
+    memset(RNRttList, 0, sizeof(RNRttList));
     RNResponseListIndex = 0;
 }
 
@@ -45,6 +45,13 @@
 #include <ajtcl/aj_config.h>
 #include <ajtcl/aj_crypto_sha2.h>
 #include <ajtcl/aj_cert.h>
+#if AJ_CREDS_INDEX
+#ifdef ARDUINO
+#include <ajtcl/aj_target_nvram.h>
+#else
+#include "aj_target_nvram.h"
+#endif
+#endif
 
 /**
  * Turn on per-module debug printing by setting this variable to non-zero value
@@ -148,15 +155,146 @@ static uint16_t CredentialSize(uint16_t type, const AJ_CredField* id, uint32_t e
     return size;
 }
 
+#if AJ_CREDS_INDEX
+/*
+ * The credential index keeps the type, a hash of the id and the expiration of the credential in
+ * each slot so a lookup only opens the slots that can match and finding a free slot or the oldest
+ * credential does not open any. The index is rebuilt from NVRAM whenever the change count of the
+ * credentials block shows that entries were created or deleted other than through this module.
+ *
+ * The index is shared by all bus attachments. The public functions hold AJ_SHARED_LOCK from the
+ * refresh of the index, through the NVRAM accesses, until the index has been updated, so another
+ * thread cannot create or delete a credential the index does not know about.
+ */
+#define CRED_INDEX_EMPTY   0    /* The slot does not exist */
+#define CRED_INDEX_USED    1    /* The slot holds the credential described by the entry */
+#define CRED_INDEX_UNKNOWN 2    /* The slot exists but could not be read, it must be opened */
+
+typedef struct _CredIndexEntry {
+    uint8_t state;
+    uint16_t type;
+    uint32_t idHash;
+    uint32_t expiration;
+} CredIndexEntry;
+
+static CredIndexEntry credIndex[AJ_MAX_CREDS];
+static uint32_t credIndexChanges;
+static uint8_t credIndexValid = FALSE;
+
+static uint32_t CredIdHash(const AJ_CredField* id)
+{
+    uint32_t hash = 2166136261UL;
+    uint16_t i;
+
+    if (id) {
+        for (i = 0; i < id->size; ++i) {
+            hash = (hash ^ id->data[i]) * 16777619UL;
+        }
+    }
+    return hash;
+}
+
+static void CredIndexRead(uint16_t slot)
+{
+    CredIndexEntry* entry = &credIndex[slot - AJ_CREDS_NV_ID_BEGIN];
+    AJ_NV_DATASET* handle;
+    AJ_CredField id;
+
+    if (!AJ_NVRAM_Exist(slot)) {
+        entry->state = CRED_INDEX_EMPTY;
+        return;
+    }
+    entry->state = CRED_INDEX_UNKNOWN;
+    handle = AJ_NVRAM_Open(slot, "r", 0);
+    if (!handle) {
+        return;
+    }
+    id.size = 0;
+    id.data = NULL;
+    if ((AJ_OK == CredValueRead((uint8_t*) &entry->type, sizeof (uint16_t), handle)) &&
+        (AJ_OK == CredFieldRead(&id, handle)) &&
+        (AJ_OK == CredValueRead((uint8_t*) &entry->expiration, sizeof (uint32_t), handle))) {
+        entry->idHash = CredIdHash(&id);
+        entry->state = CRED_INDEX_USED;
+    }
+    AJ_CredFieldFree(&id);
+    AJ_NVRAM_Close(handle);
+}
+
+static void CredIndexRefresh(void)
+{
+    uint32_t changes = _AJ_GetNVChangeCount(AJ_CREDS_NV_ID_BEGIN);
+    uint16_t slot;
+
+    if (credIndexValid && (changes == credIndexChanges)) {
+        return;
+    }
+    AJ_InfoPrintf(("CredIndexRefresh(): rebuilding credential index\n"));
+    for (slot = AJ_CREDS_NV_ID_BEGIN; slot < AJ_CREDS_NV_ID_END; ++slot) {
+        CredIndexRead(slot);
+    }
+    credIndexChanges = changes;
+    credIndexValid = TRUE;
+}
+
+/*
+ * Record a change this module just made to a slot. The index must have been refreshed before the
+ * change was made, with AJ_SHARED_LOCK held since.
+ */
+static void CredIndexSet(uint16_t slot, uint8_t state, uint16_t type, const AJ_CredField* id, uint32_t expiration)
+{
+    CredIndexEntry* entry;
+
+    if (!credIndexValid || (slot < AJ_CREDS_NV_ID_BEGIN) || (slot >= AJ_CREDS_NV_ID_END)) {
+        return;
+    }
+    entry = &credIndex[slot - AJ_CREDS_NV_ID_BEGIN];
+    entry->state = state;
+    entry->type = type;
+    entry->idHash = CredIdHash(id);
+    entry->expiration = expiration;
+    credIndexChanges = _AJ_GetNVChangeCount(AJ_CREDS_NV_ID_BEGIN);
+}
+
+/*
+ * Returns FALSE if the index shows the slot cannot hold a credential of this type and id hash
+ */
+static uint8_t CredIndexMayMatch(uint16_t slot, uint16_t type, const AJ_CredField* id, uint32_t idHash)
+{
+    const CredIndexEntry* entry;
+
+    if ((slot < AJ_CREDS_NV_ID_BEGIN) || (slot >= AJ_CREDS_NV_ID_END)) {
+        return TRUE;
+    }
+    entry = &credIndex[slot - AJ_CREDS_NV_ID_BEGIN];
+    if (CRED_INDEX_EMPTY == entry->state) {
+        return FALSE;
+    }
+    if (CRED_INDEX_USED == entry->state) {
+        return (entry->type == type) && (!id || (entry->idHash == idHash));
+    }
+    return TRUE;
+}
+#endif
+
 static uint16_t FindCredsEmptySlot()
 {
     uint16_t id = AJ_CREDS_NV_ID_BEGIN;
 
+#if AJ_CREDS_INDEX
+    CredIndexRefresh();
+    for (; id < AJ_CREDS_NV_ID_END; id++) {
+        if (CRED_INDEX_EMPTY == credIndex[id - AJ_CREDS_NV_ID_BEGIN].state) {
+            return id;
+        }
+    }
+#else
     for (; id < AJ_CREDS_NV_ID_END; id++) {
         if (!AJ_NVRAM_Exist(id)) {
             return id;
         }
     }
+#endif
 
     return 0;
 }
@@ -169,8 +307,18 @@ static uint16_t CredentialFind(uint16_t type, const AJ_CredField* id, uint32_t*
     uint16_t value;
     AJ_CredField field;
     uint8_t found;
+#if AJ_CREDS_INDEX
+    uint32_t idHash = CredIdHash(id);
+
+    CredIndexRefresh();
+#endif
 
     for (; slot < AJ_CREDS_NV_ID_END; slot++) {
+#if AJ_CREDS_INDEX
+        if (!CredIndexMayMatch(slot, type, id, idHash)) {
+            continue;
+        }
+#endif
         if (!AJ_NVRAM_Exist(slot)) {
             continue;
         }
@@ -245,16 +393,32 @@ static uint16_t CredentialFind(uint16_t type, const AJ_CredField* id, uint32_t*
 static AJ_Status DeleteOldestCredential(uint16_t* deleted)
 {
     AJ_Status status = AJ_ERR_INVALID;
-    AJ_NV_DATASET* handle;
     uint16_t slot = AJ_CREDS_NV_ID_BEGIN;
     uint16_t oldestslot = 0;
     uint32_t oldestexp = 0xFFFFFFFF;
     uint16_t type;
+#if AJ_CREDS_INDEX
+    const CredIndexEntry* entry;
+#else
+    AJ_NV_DATASET* handle;
     AJ_CredField id;
     uint32_t expiration;
+#endif
 
     AJ_InfoPrintf(("DeleteOldestCredential(deleted=%p)\n", deleted));
 
+#if AJ_CREDS_INDEX
+    CredIndexRefresh();
+    type = AJ_CRED_TYPE_GENERIC;
+    for (; slot < AJ_CREDS_NV_ID_END; slot++) {
+        entry = &credIndex[slot - AJ_CREDS_NV_ID_BEGIN];
+        /* If older */
+        if ((CRED_INDEX_USED == entry->state) && (AJ_CRED_TYPE_GENERIC == entry->type) && (entry->expiration <= oldestexp)) {
+            oldestexp = entry->expiration;
+            oldestslot = slot;
+        }
+    }
+#else
     for (; slot < AJ_CREDS_NV_ID_END; slot++) {
         if (!AJ_NVRAM_Exist(slot)) {
             continue;
@@ -292,6 +456,7 @@ static AJ_Status DeleteOldestCredential(uint16_t* deleted)
             oldestslot = slot;
         }
     }
+#endif
 
     if (oldestslot) {
         AJ_InfoPrintf(("DeleteOldestCredential(deleted=%p): slot=%d exp=%08X\n", deleted, oldestslot, oldestexp));
@@ -315,6 +480,9 @@ static AJ_Status CredentialWrite(uint16_t type, const AJ_CredField* id, uint32_t
 
     AJ_InfoPrintf(("CredentialWrite(type=%04x, id=%p, expiration=%08x, data=%p, slot=%d)\n", type, id, expiration, data, slot));
 
+#if AJ_CREDS_INDEX
+    CredIndexRefresh();
+#endif
     size = CredentialSize(type, id, expiration, data);
     handle = AJ_NVRAM_Open(slot, "w", size);
     if (!handle) {
@@ -339,6 +507,9 @@ static AJ_Status CredentialWrite(uint16_t type, const AJ_CredField* id, uint32_t
 
 Exit:
     AJ_NVRAM_Close(handle);
+#if AJ_CREDS_INDEX
+    CredIndexSet(slot, (AJ_OK == status) ? CRED_INDEX_USED : CRED_INDEX_UNKNOWN, type, id, expiration);
+#endif
 
     return status;
 }
@@ -385,6 +556,7 @@ AJ_Status AJ_CredentialSet(uint16_t type, const AJ_CredField* id, uint32_t expir
 
     AJ_InfoPrintf(("AJ_CredentialSet(type=%04x, id=%p, expiration=%08x, data=%p)\n", type, id, expiration, data));
 
+    AJ_SHARED_LOCK();
     slot = CredentialFind(type, id, NULL, NULL, AJ_CREDS_NV_ID_BEGIN);
     if (!slot) {
         /*
@@ -404,20 +576,28 @@ AJ_Status AJ_CredentialSet(uint16_t type, const AJ_CredField* id, uint32_t expir
     } else {
         status = AJ_ERR_FAILURE;
     }
+    AJ_SHARED_UNLOCK();
 
     return status;
 }
 
 AJ_Status AJ_CredentialGet(uint16_t type, const AJ_CredField* id, uint32_t* expiration, AJ_CredField* data)
 {
+    uint16_t slot;
+
     AJ_InfoPrintf(("AJ_CredentialGet(type=%04x, id=%p, expiration=%p, data=%p)\n", type, id, expiration, data));
-    return CredentialFind(type, id, expiration, data, AJ_CREDS_NV_ID_BEGIN) ? AJ_OK : AJ_ERR_UNKNOWN;
+    AJ_SHARED_LOCK();
+    slot = CredentialFind(type, id, expiration, data, AJ_CREDS_NV_ID_BEGIN);
+    AJ_SHARED_UNLOCK();
+    return slot ? AJ_OK : AJ_ERR_UNKNOWN;
 }
 
 AJ_Status AJ_CredentialGetNext(uint16_t type, const AJ_CredField* id, uint32_t* expiration, AJ_CredField* data, uint16_t* slot)
 {
     AJ_InfoPrintf(("AJ_CredentialGet(type=%04x, id=%p, expiration=%p, data=%p)\n", type, id, expiration, data));
+    AJ_SHARED_LOCK();
     *slot = CredentialFind(type, id, expiration, data, *slot);
+    AJ_SHARED_UNLOCK();
     return *slot ? AJ_OK : AJ_ERR_UNKNOWN;
 }
 
@@ -558,6 +738,10 @@ AJ_Status AJ_CredentialDeleteSlot(uint16_t type, uint16_t slot)
 {
     AJ_Status status = AJ_ERR_FAILURE;
     if (slot > 0) {
+        AJ_SHARED_LOCK();
+#if AJ_CREDS_INDEX
+        CredIndexRefresh();
+#endif
         if ((type == AJ_CRED_TYPE_AES) ||
             (type == AJ_CRED_TYPE_PRIVATE) ||
             (type == AJ_GENERIC_MASTER_SECRET) ||
@@ -566,6 +750,12 @@ AJ_Status AJ_CredentialDeleteSlot(uint16_t type, uint16_t slot)
         } else {
             status = AJ_NVRAM_Delete(slot);
         }
+#if AJ_CREDS_INDEX
+        if (AJ_OK == status) {
+            CredIndexSet(slot, CRED_INDEX_EMPTY, 0, NULL, 0);
+        }
+#endif
+        AJ_SHARED_UNLOCK();
     }
     return status;
 }
@@ -573,10 +763,13 @@ AJ_Status AJ_CredentialDeleteSlot(uint16_t type, uint16_t slot)
 AJ_Status AJ_CredentialDelete(uint16_t type, const AJ_CredField* id)
 {
     AJ_Status status = AJ_ERR_FAILURE;
-    uint16_t slot = CredentialFind(type, id, NULL, NULL, AJ_CREDS_NV_ID_BEGIN);
+    uint16_t slot;
 
     AJ_InfoPrintf(("AJ_CredentialDelete(type=%04x, id=%p)\n", type, id));
+    AJ_SHARED_LOCK();
+    slot = CredentialFind(type, id, NULL, NULL, AJ_CREDS_NV_ID_BEGIN);
     status = AJ_CredentialDeleteSlot(type, slot);
+    AJ_SHARED_UNLOCK();
 
     return status;
 }
@@ -601,7 +794,17 @@ AJ_Status AJ_ClearCredentials(uint16_t type)
 
     AJ_InfoPrintf(("AJ_ClearCredentials(type=%04x)\n", type));
 
+    AJ_SHARED_LOCK();
+#if AJ_CREDS_INDEX
+    CredIndexRefresh();
+#endif
     for (; slot < AJ_CREDS_NV_ID_END; ++slot) {
+#if AJ_CREDS_INDEX
+        if ((CRED_INDEX_EMPTY == credIndex[slot - AJ_CREDS_NV_ID_BEGIN].state) ||
+            (type && (CRED_INDEX_USED == credIndex[slot - AJ_CREDS_NV_ID_BEGIN].state) && (credIndex[slot - AJ_CREDS_NV_ID_BEGIN].type != type))) {
+            continue;
+        }
+#endif
         if (!AJ_NVRAM_Exist(slot)) {
             continue;
         }
@@ -623,7 +826,11 @@ AJ_Status AJ_ClearCredentials(uint16_t type)
             }
         }
         AJ_NVRAM_Delete(slot);
+#if AJ_CREDS_INDEX
+        CredIndexSet(slot, CRED_INDEX_EMPTY, 0, NULL, 0);
+#endif
     }
+    AJ_SHARED_UNLOCK();
 
     return status;
 }
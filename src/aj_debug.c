@@ -31,16 +31,16 @@
  ******************************************************************************/
 #define AJ_MODULE DEBUG
 
+#include <ajtcl/aj_target.h>
 #include <ajtcl/aj_debug.h>
+#include <ajtcl/aj_config.h>
 
 uint8_t dbgDEBUG = 0;
 
 #ifdef AJ_DEBUG_BUILD
 
 
-#include <ajtcl/aj_target.h>
 #include <ajtcl/aj_util.h>
-#include <ajtcl/aj_config.h>
 
 #define Printable(c) (((c) >= ' ') && ((c) <= '~')) ? (c) : '.'
 
@@ -158,7 +158,7 @@ const char* AJ_StatusText(AJ_Status status)
 {
 #ifndef AJ_DEBUG_BUILD
     /* Expectation is that thin client status codes will NOT go beyond 255 */
-    static char code[4];
+    static AJ_THREAD_LOCAL char code[4];
 
 #ifdef _WIN32
     _snprintf_s(code, sizeof(code), _TRUNCATE, "%03u", status);
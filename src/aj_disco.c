@@ -258,39 +258,6 @@ typedef struct _MDNSHeader {
     uint16_t arCount;
 } MDNSHeader;
 
-typedef struct _MDNSARData {
-    char ipv4Addr[IPV4ADDRSIZE_U8];
-} MDNSARData;
-
-typedef struct _MDNSAAAARData {
-    char ipv6Addr[IPV6ADDRSIZE_U8];
-} MDNSAAAARData;
-
-typedef struct _MDNSDomainName {
-    char name[256];
-} MDNSDomainName;
-
-typedef struct _MDNSSrvRData {
-    uint16_t priority;
-    uint16_t weight;
-    uint16_t port;
-    MDNSDomainName target;
-} MDNSSrvRData;
-
-typedef struct _MDNSTextRData {
-    char BusNodeName[256];
-    char BusNodeTransport[256];
-    char BusNodeProtocolVersion[8];
-} MDNSTextRData;
-
-typedef union _MDNSRData {
-    MDNSARData aRData;
-    MDNSAAAARData aaaaRData;
-    MDNSSrvRData srvRData;
-    MDNSTextRData textRData;
-    MDNSDomainName ptrRData;
-} MDNSRData;
-
 typedef enum _RRType {
     A = 1,          //Host IPv4 Address
     NS = 2,         //Authoritative name server
@@ -314,21 +281,6 @@ typedef enum _RRType {
     NSEC = 47       //NSEC record
 } RRType;
 
-typedef enum _RRClass {
-    INTERNET = 1,   //Internet
-    CS = 2,         //CSNET class
-    CH = 3,         //CHAOS class
-    HS = 4          //Hesoid
-} RRClass;
-
-typedef struct _MDNSResourceRecord {
-    MDNSDomainName rrDomainName;
-    RRType rrType;
-    RRClass rrClass;
-    uint32_t rrTTL;
-    MDNSRData rdata;
-} MDNSResourceRecord;
-
 static AJ_Status ComposeMDnsReq(AJ_IOBuffer* txBuf, const char* prefix, AJ_GUID* guid, uint16_t sidVal)
 {
     uint16_t dataLength;
@@ -411,9 +363,12 @@ static AJ_Status ComposeMDnsReq(AJ_IOBuffer* txBuf, const char* prefix, AJ_GUID*
 
     uint8_t* pkt = (uint8_t*)txBuf->writePtr;
 
-    hdr[0] = (sidVal >> 8) & 0xFF;
-    hdr[1] = sidVal & 0xFF;
+    /*
+     * The template is shared by all threads so the sid is patched into the packet
+     */
     memcpy(pkt, hdr, sizeof(hdr));
+    pkt[0] = (sidVal >> 8) & 0xFF;
+    pkt[1] = sidVal & 0xFF;
     pkt += sizeof(hdr);
 
     memcpy(pkt, queries, sizeof(queries));
@@ -513,321 +468,256 @@ static size_t ParseMDNSHeader(uint8_t const* buffer, uint32_t bufsize, MDNSHeade
 
 }
 
-/**
-   For A and AAAA records, the passed buffer contains a 16 bit length then the address data
- **/
-static size_t ParseMDNSARData(uint8_t const* buffer, uint32_t bufsize, MDNSARData* a)
+/*
+ * The response parser works in place on the packet in a single pass. Names are compared where they
+ * are in the packet rather than being decoded and the rdata of a record is only looked at if the
+ * record is one that can contribute to a match.
+ */
+#define MDNS_HEADER_SIZE  12
+
+/*
+ * Names that have already been compared are remembered by the offset they resolve to so that a
+ * compression pointer to a name that was seen earlier in the packet is matched in one step.
+ */
+#define MDNS_NAME_CACHE_SIZE  8
+
+#define MDNS_NAME_OTHER   0   /* Not one of the names below */
+#define MDNS_NAME_TCP     1   /* _alljoyn._tcp.local */
+#define MDNS_NAME_UDP     2   /* _alljoyn._udp.local */
+#define MDNS_NAME_TARGET  3   /* The target of the SRV record */
+
+/*
+ * Length of the GUID label in the SRV record name <guid>._alljoyn._tcp.local
+ */
+#define MDNS_GUID_LABEL_LEN  32
+
+typedef struct _MDNSParser {
+    const uint8_t* pkt;                             /* The packet being parsed */
+    uint16_t len;                                   /* Length of the packet */
+    uint16_t target;                                /* Offset of the SRV target, zero if none yet */
+    uint8_t numCached;                              /* Number of entries in the name cache */
+    uint16_t cachedOffset[MDNS_NAME_CACHE_SIZE];    /* Offsets of names already compared */
+    uint8_t cachedName[MDNS_NAME_CACHE_SIZE];       /* What the names at those offsets are */
+} MDNSParser;
+
+/*
+ * Returns the offset just past the name at offset or zero if the name runs off the end of the
+ * packet. Compression pointers are not followed.
+ */
+static uint16_t MDNSSkipName(const MDNSParser* parser, uint16_t offset)
 {
-    if (bufsize < (IPV4ADDRSIZE_U8 + sizeof(uint16_t))) {
-        return 0;
-    }
-    if (buffer[0] != 0 || buffer[1] != IPV4ADDRSIZE_U8) {
-        return 0;
+    while (offset < parser->len) {
+        uint8_t sz = parser->pkt[offset];
+        if ((sz & 0xC0) == 0xC0) {
+            return ((offset + 2) <= parser->len) ? offset + 2 : 0;
+        }
+        if (sz & 0xC0) {
+            return 0;
+        }
+        offset += 1 + sz;
+        if (!sz) {
+            return offset;
+        }
     }
-    AJ_ASSERT(sizeof(a->ipv4Addr) == IPV4ADDRSIZE_U8);
-    memset(a->ipv4Addr, 0, IPV4ADDRSIZE_U8);
-    memcpy(a->ipv4Addr, (buffer + sizeof(uint16_t)), IPV4ADDRSIZE_U8);
-    return (IPV4ADDRSIZE_U8 + sizeof(uint16_t));
+    return 0;
 }
 
-static size_t ParseMDNSAAAARData(uint8_t const* buffer, uint32_t bufsize, MDNSAAAARData* a)
+/*
+ * Follows compression pointers from offset to a label and returns the offset of the label length or
+ * zero if the name is malformed. Pointers must point backwards so this always terminates.
+ */
+static uint16_t MDNSLabel(const MDNSParser* parser, uint16_t offset)
 {
-    if (bufsize < (IPV6ADDRSIZE_U8 + sizeof(uint16_t))) {
-        return 0;
+    while (((offset + 1) < parser->len) && ((parser->pkt[offset] & 0xC0) == 0xC0)) {
+        uint16_t pointer = ((parser->pkt[offset] & 0x3F) << 8) | parser->pkt[offset + 1];
+        if ((pointer >= offset) || (pointer < MDNS_HEADER_SIZE)) {
+            return 0;
+        }
+        offset = pointer;
     }
-    if (buffer[0] != 0 || buffer[1] != IPV6ADDRSIZE_U8) {
+    if ((offset >= parser->len) || (parser->pkt[offset] & 0xC0) || ((offset + 1 + parser->pkt[offset]) > parser->len)) {
         return 0;
     }
-    AJ_ASSERT(sizeof(a->ipv6Addr) == IPV6ADDRSIZE_U8);
-    memset(a->ipv6Addr, 0, IPV6ADDRSIZE_U8);
-    memcpy(a->ipv6Addr, (buffer + sizeof(uint16_t)), IPV6ADDRSIZE_U8);
-    return (IPV6ADDRSIZE_U8 + sizeof(uint16_t));
+    return offset;
 }
 
-static size_t ParseMDNSDefaultRData(uint8_t const* buffer, uint32_t bufsize)
+/*
+ * Compares the name at offset with a dotted name
+ */
+static uint8_t MDNSNameIs(const MDNSParser* parser, uint16_t offset, const char* name)
 {
-    // Default data is skipped as it's deemed to be a
-    // resource record type that is not currently used
-    // or reserved for future use.
-    uint16_t rdlen = 0;
-
-    if (bufsize < 2) {
-        return 0;
-    }
-    rdlen = (buffer[0] << 8 | buffer[1]);
-    bufsize -= 2;
-    if (bufsize < rdlen) {
-        return 0;
+    while ((offset = MDNSLabel(parser, offset)) != 0) {
+        uint8_t sz = parser->pkt[offset];
+        size_t len = strcspn(name, ".");
+        if (!sz) {
+            return *name == '\0';
+        }
+        if ((len != sz) || (memcmp(parser->pkt + offset + 1, name, sz) != 0)) {
+            return FALSE;
+        }
+        name += (name[len] == '.') ? len + 1 : len;
+        offset += 1 + sz;
     }
-    return rdlen + 2;
+    return FALSE;
 }
 
-static size_t ParseMDNSDomainName(uint8_t const* buffer, uint32_t bufsize, MDNSDomainName* domainName, const uint8_t* payload, uint32_t paylen)
+/*
+ * Compares two names in the packet, names that share a suffix match as soon as the suffix is reached
+ */
+static uint8_t MDNSNamesEqual(const MDNSParser* parser, uint16_t a, uint16_t b)
 {
-    // The expression for domain names can be a series of labels,
-    // a pointer to a byte offset of previously encountered series
-    // of labels, or a series of labels ending with a pointer to
-    // a previously encountered series of labels. Labels have a
-    // size limit of 63 octets and domain names have a size limit
-    // of 255 octets. We add an extra byte for the trailing null.
-    // A pointer is denoted by an octet where the first two bits
-    // are ones. Since the size of labels are at most 63 octets,
-    // the size of labels begin with two zero bits and can be
-    // easily distinguished from pointers.
-    uint32_t offset = 0;
-    size_t size = 0;
-    uint8_t const* pos = buffer;
-    int32_t len = bufsize;
-    memset(domainName->name, 0, 256);
-    while (len) {
-        if (((*pos & 0xc0) >> 6) == 3 && len > 1) {
-            uint32_t pointer = ((pos[0] << 8 | pos[1]) & 0x3FFF);
-            if (pointer >= paylen) {
-                AJ_ErrPrintf(("ParseMDNSDomainName(): Insufficient bufsize\n"));
-                return 0;
-            }
-            if (payload[pointer] & 0xc0) {
-                AJ_ErrPrintf(("ParseMDNSDomainName(): Invalid compression\n"));
-                return 0;
-            }
-            if (pos >= buffer) {
-                size += 2;
-            }
-            pos = payload + pointer;
-            len = (paylen - pointer);
-        } else {
-            uint8_t label_len = *pos;
-            pos++;
-            len--;
-            if (pos >= buffer) {
-                size++;
-            }
-            if (label_len > len) {
-                AJ_ErrPrintf(("ParseMDNSDomainName(): Insufficient bufsize\n"));
-                return 0;
-            }
-            if (domainName->name[0]) {
-                memcpy((domainName->name + offset), ".", 1);
-                offset++;
-            }
-            if ((label_len > 0) && (offset + label_len) < 256) {
-                memcpy((domainName->name + offset), (pos), label_len);
-                len -= label_len;
-                pos += label_len;
-                if (pos >= buffer) {
-                    size += label_len;
-                }
-                offset += label_len;
-            } else {
-                break;
-            }
+    for (;;) {
+        uint8_t sz;
+        a = MDNSLabel(parser, a);
+        b = MDNSLabel(parser, b);
+        if (!a || !b) {
+            return FALSE;
+        }
+        if (a == b) {
+            return TRUE;
+        }
+        sz = parser->pkt[a];
+        if ((sz != parser->pkt[b]) || (memcmp(parser->pkt + a + 1, parser->pkt + b + 1, sz) != 0)) {
+            return FALSE;
         }
+        if (!sz) {
+            return TRUE;
+        }
+        a += 1 + sz;
+        b += 1 + sz;
     }
-    return size;
 }
 
-static size_t ParseMDNSTextRData(uint8_t const* buffer, uint32_t bufsize, MDNSTextRData* textRData, uint8_t const* payload, uint32_t paylen, const char* prefix)
+/*
+ * Returns which of the names the parser is interested in the name at offset is
+ */
+static uint8_t MDNSNameId(MDNSParser* parser, uint16_t offset)
 {
-    //
-    // If there's not enough data in the buffer to even get the string size out
-    // then bail.
-    //
-    uint16_t rdlen = 0;
-    uint8_t const* p = NULL;
-    uint8_t* pos = NULL;
-    uint8_t sz = 0;
-    size_t size = 0;
-    memset(textRData->BusNodeName, 0, 256);
-    memset(textRData->BusNodeTransport, 0, 256);
-    memset(textRData->BusNodeProtocolVersion, 0, 8);
-
-    if (bufsize < 2) {
-        AJ_ErrPrintf(("ParseMDNSTextRData(): Insufficient bufsize %d", bufsize));
-        return 0;
-    }
-    rdlen = buffer[0] << 8 | buffer[1];
+    uint8_t id;
+    uint8_t i;
 
-    bufsize -= 2;
-    size = 2 + rdlen;
-
-    //
-    // If there's not enough data in the buffer then bail.
-    //
-    if (bufsize < rdlen) {
-        AJ_ErrPrintf(("ParseMDNSTextRData(): Insufficient bufsize %d", bufsize));
-        return 0;
+    offset = MDNSLabel(parser, offset);
+    if (!offset) {
+        return MDNS_NAME_OTHER;
     }
-    p = &buffer[2];
-    while (rdlen > 0 && bufsize > 0) {
-        sz = *p++;
-        bufsize--;
-        if (!sz || !bufsize ||  bufsize < sz) {
-            AJ_ErrPrintf(("ParseMDNSTextRData(): Insufficient bufsize %d", bufsize));
-            return 0;
+    for (i = 0; i < parser->numCached; ++i) {
+        if (parser->cachedOffset[i] == offset) {
+            return parser->cachedName[i];
         }
-        // For now we are only interested in three specific
-        // key-value pairs: the bus node transport, bus node
-        // name and the bus node protocol version.
-        pos = (uint8_t*) memchr((char const*)p, '=', sz);
-        if (pos) {
-            uint8_t indx = pos - p;
-            uint8_t valsz = (sz - indx - 1);
-            if (!memcmp(p, "ajpv", 4)) {
-                if (valsz < 8) {
-                    memcpy(textRData->BusNodeProtocolVersion, pos + 1, valsz);
-                }
-            }
-            if (!memcmp(p, "t_", 2) && !textRData->BusNodeName[0]) {
-                memcpy(textRData->BusNodeTransport, pos + 1, valsz);
-            }
-            if (!memcmp(p, "n_", 2) &&
-                (prefix != NULL) && (valsz >= strlen(prefix)) && !memcmp(pos + 1, prefix, strlen(prefix))) {
-                memcpy(textRData->BusNodeName, pos + 1, valsz);
-            }
-        }
-        p += sz;
-        rdlen -= sz + 1;
-        bufsize -= sz;
     }
-
-    if (rdlen != 0) {
-        AJ_ErrPrintf(("ParseMDNSTextRData(): Mismatched RDLength"));
-        return 0;
+    if (parser->target && MDNSNamesEqual(parser, offset, parser->target)) {
+        id = MDNS_NAME_TARGET;
+    } else if (MDNSNameIs(parser, offset, "_alljoyn._tcp.local")) {
+        id = MDNS_NAME_TCP;
+    } else if (MDNSNameIs(parser, offset, "_alljoyn._udp.local")) {
+        id = MDNS_NAME_UDP;
+    } else {
+        id = MDNS_NAME_OTHER;
     }
-    return size;
+    if (parser->numCached < MDNS_NAME_CACHE_SIZE) {
+        parser->cachedOffset[parser->numCached] = offset;
+        parser->cachedName[parser->numCached] = id;
+        ++parser->numCached;
+    }
+    return id;
 }
 
-static size_t ParseMDNSSrvRData(uint8_t const* buffer, uint32_t bufsize, MDNSSrvRData* srvRData, uint8_t* payload, uint32_t paylen)
+/*
+ * Returns the name id of the name at offset after the first label if the first label is the
+ * expected length, or MDNS_NAME_OTHER if it isn't.
+ */
+static uint8_t MDNSSuffixId(MDNSParser* parser, uint16_t offset, const char* label, uint8_t labelLen)
 {
-    uint16_t length = 0;
-    size_t size = 0;
-    size_t ret = 0;
-    uint8_t const* p = NULL;
-    if (bufsize < 2) {
-        AJ_ErrPrintf(("ParseMDNSSrvRData(): Insufficient bufsize %d", bufsize));
-        return 0;
+    offset = MDNSLabel(parser, offset);
+    if (!offset || (parser->pkt[offset] != labelLen)) {
+        return MDNS_NAME_OTHER;
     }
-
-    length = buffer[0] << 8 | buffer[1];
-    bufsize -= 2;
-
-    if (bufsize < length || length < 6) {
-        AJ_ErrPrintf(("ParseMDNSSrvRData(): Insufficient bufsize %d or invalid length %d", bufsize, length));
-        return 0;
+    if (label && (memcmp(parser->pkt + offset + 1, label, labelLen) != 0)) {
+        return MDNS_NAME_OTHER;
     }
-    srvRData->priority = buffer[2] << 8 | buffer[3];
-    bufsize -= 2;
-
-    srvRData->weight = buffer[4] << 8 | buffer[5];
-    bufsize -= 2;
+    return MDNSNameId(parser, offset + 1 + labelLen);
+}
 
-    srvRData->port = buffer[6] << 8 | buffer[7];
-    bufsize -= 2;
+/*
+ * Returns TRUE if the packet contains the string anywhere. The advertised names are carried in TXT
+ * strings which are never compressed so a packet that doesn't contain the prefix cannot match.
+ */
+static uint8_t MDNSContains(const uint8_t* pkt, uint32_t len, const char* str)
+{
+    size_t sz = strlen(str);
+    const uint8_t* end;
 
-    size = 8;
-    p = &buffer[size];
-    ret = ParseMDNSDomainName(p, bufsize, &(srvRData->target), payload, paylen);
-    if (ret) {
-        return (size + ret);
-    } else {
-        return 0;
+    if (!sz) {
+        return TRUE;
     }
+    if (sz > len) {
+        return FALSE;
+    }
+    end = pkt + len - sz + 1;
+    while (pkt < end) {
+        pkt = (const uint8_t*)memchr(pkt, str[0], end - pkt);
+        if (!pkt) {
+            break;
+        }
+        if (memcmp(pkt, str, sz) == 0) {
+            return TRUE;
+        }
+        ++pkt;
+    }
+    return FALSE;
 }
 
-static size_t ParseMDNSResourceRecord(uint8_t const* buffer, uint32_t bufsize, MDNSResourceRecord* record, uint8_t* payload, uint32_t paylen, const char* prefix)
+/*
+ * Looks through the strings of a TXT record for the key-value pairs the parser is interested in:
+ * the bus node transport and name from the advertise record and the protocol version from the
+ * sender-info record. Returns FALSE if the TXT record is malformed.
+ */
+static uint8_t ParseMDNSTextRData(const uint8_t* p, uint16_t rdlen, const char* prefix, uint8_t* transport, uint8_t* name, int32_t* pv)
 {
-    size_t processed = 0;
-    uint16_t ptr_len = 0;
-    uint8_t const* p = NULL;
-    size_t size = ParseMDNSDomainName(buffer, bufsize, &(record->rrDomainName), payload, paylen);
+    size_t prefixLen = strlen(prefix);
+    const uint8_t* end = p + rdlen;
 
-    if (size == 0 || bufsize < 8) {
-        AJ_ErrPrintf(("ParseMDNSResourceRecord(): Error occured while deserializing domain name\n"));
-        return 0;
-    }
+    while (p < end) {
+        uint8_t sz = *p++;
+        const uint8_t* val;
+        uint8_t valsz;
 
-    if (size > bufsize || ((size + 8) > bufsize)) {
-        AJ_ErrPrintf(("ParseMDNSResourceRecord(): Insufficient buffer size\n"));
-        return 0;
-    }
-    record->rrType = (RRType)((buffer[size] << 8) | buffer[size + 1]);
-
-    //Next two octets are CLASS
-    record->rrClass = (RRClass)((buffer[size + 2] << 8) | buffer[size + 3]);
-
-    //Next four octets are TTL
-    record->rrTTL = (buffer[size + 4] << 24) | (buffer[size + 5] << 16) | (buffer[size + 6] << 8) | buffer[size + 7];
-    bufsize -= (size + 8);
-    size += 8;
-    p = &buffer[size];
-
-    switch (record->rrType) {
-    case A:
-        AJ_InfoPrintf(("ParseMDNSResourceRecord(): Found an A record\n"));
-        processed = ParseMDNSARData(p, bufsize, &(record->rdata.aRData));
-        break;
-
-    case PTR:
-        AJ_InfoPrintf(("ParseMDNSResourceRecord(): Found a PTR record\n"));
-        ptr_len = (*p << 8 | *(p + 1));
-        p += 2;
-        bufsize -= 2;
-        if (ptr_len > bufsize) {
-            return 0;
+        if (!sz || (sz > (end - p))) {
+            AJ_ErrPrintf(("ParseMDNSTextRData(): Malformed TXT string\n"));
+            return FALSE;
         }
-        processed = ParseMDNSDomainName(p, bufsize, &(record->rdata.ptrRData), payload, paylen);
-        if (processed) {
-            processed += 2;
+        val = (const uint8_t*)memchr(p, '=', sz);
+        if (val) {
+            uint8_t keysz = (uint8_t)(val - p);
+            ++val;
+            valsz = sz - keysz - 1;
+            if ((keysz >= 4) && !memcmp(p, "ajpv", 4) && pv && (valsz < 8)) {
+                uint8_t i;
+                *pv = 0;
+                for (i = 0; (i < valsz) && (val[i] >= '0') && (val[i] <= '9'); ++i) {
+                    *pv = *pv * 10 + (val[i] - '0');
+                }
+            }
+            if ((keysz >= 2) && !memcmp(p, "t_", 2) && valsz) {
+                *transport = TRUE;
+            }
+            if ((keysz >= 2) && !memcmp(p, "n_", 2) && valsz && (valsz >= prefixLen) && !memcmp(val, prefix, prefixLen)) {
+                *name = TRUE;
+            }
         }
-        break;
-
-    case SRV:
-        AJ_InfoPrintf(("ParseMDNSResourceRecord(): Found a SRV record\n"));
-        processed = ParseMDNSSrvRData(p, bufsize, &(record->rdata.srvRData), payload, paylen);
-        break;
-
-    case TXT:
-        AJ_InfoPrintf(("ParseMDNSResourceRecord(): Found a TXT record\n"));
-        processed = ParseMDNSTextRData(p, bufsize, &(record->rdata.textRData), payload, paylen, prefix);
-        break;
-
-    case AAAA:
-        AJ_InfoPrintf(("ParseMDNSResourceRecord(): Found an AAAA record\n"));
-        processed = ParseMDNSAAAARData(p, bufsize, &(record->rdata.aaaaRData));
-        break;
-
-    case NS:
-    case MD:
-    case MF:
-    case CNAME:
-    case MB:
-    case MG:
-    case MR:
-    case RNULL:
-    case HINFO:
-    default:
-        AJ_InfoPrintf(("ParseMDNSResourceRecord(): Found a non-relevant or unknown record type that will be ignored\n"));
-        processed = ParseMDNSDefaultRData(p, bufsize);
-        break;
-    }
-    if (!processed) {
-        AJ_ErrPrintf(("ParseMDNSResourceRecord(): Error occured while deserializing resource data"));
-        return 0;
+        p += sz;
     }
-    size += processed;
-    return size;
+    return TRUE;
 }
 
-static AJ_Status ParseMDNSResp(AJ_IOBuffer* rxBuf, const char* prefix, AJ_Service* service)
+AJ_Status AJ_ParseMDNSResponse(AJ_IOBuffer* rxBuf, const char* prefix, AJ_Service* service)
 {
-    uint8_t* buffer = (uint8_t*)rxBuf->readPtr;
-    uint32_t bufsize = AJ_IO_BUF_AVAIL(rxBuf);
-    uint32_t paylen = bufsize;
+    MDNSParser parser;
     MDNSHeader header;
-    uint8_t* p = NULL;
-    int i = 0;
-    size_t ret = 0;
-    size_t size = 0;
+    uint32_t bufsize = AJ_IO_BUF_AVAIL(rxBuf);
+    uint32_t numRecords;
+    uint32_t i;
+    uint16_t offset;
     uint8_t alljoyn_ptr_record_tcp = 0;
     uint8_t alljoyn_ptr_record_udp = 0;
     uint8_t bus_transport = 0;
@@ -838,131 +728,140 @@ static AJ_Status ParseMDNSResp(AJ_IOBuffer* rxBuf, const char* prefix, AJ_Servic
     uint16_t service_port_udp = 0;
     uint16_t service_priority = 0;
     uint32_t protocol_version = 0;
-    uint8_t bus_addr[IPV4ADDRSIZE_U8] = { 0 };
-    uint8_t bus_aaa_addr[IPV6ADDRSIZE_U8] = { 0 };
-    uint8_t service_target[256] = { 0 };
-    MDNSResourceRecord r;
-
-    memset(&header, 0, sizeof(MDNSHeader));
-    size = ParseMDNSHeader(buffer, bufsize, &header);
-    if (size == 0) {
+    const uint8_t* bus_addr = NULL;
+    const uint8_t* bus_aaa_addr = NULL;
+
+    if (!prefix || (bufsize > 0xFFFF)) {
+        return AJ_ERR_NO_MATCH;
+    }
+    if (ParseMDNSHeader(rxBuf->readPtr, bufsize, &header) == 0) {
         AJ_ErrPrintf(("Error occured while deserializing header\n"));
         return AJ_ERR_NO_MATCH;
-    } else {
-        AJ_InfoPrintf(("Successfully parsed header with %d answers and %d additional\n", header.anCount, header.arCount));
     }
-
     if ((header.qrType & MDNS_QR) == 0) {
         return AJ_ERR_NO_MATCH;
     }
-    if (!header.anCount || !header.arCount) {
+    if (!header.anCount || !header.arCount || (bufsize <= MDNS_HEADER_SIZE)) {
         return AJ_ERR_NO_MATCH;
     }
-    if (size >= bufsize) {
+    if (!MDNSContains(rxBuf->readPtr, bufsize, prefix)) {
         return AJ_ERR_NO_MATCH;
     }
-    bufsize -= size;
-    p = &buffer[size];
-
-    for (i = 0; i < header.qdCount; i++) {
-        memset(&r, 0, sizeof(MDNSResourceRecord));
-        ret = ParseMDNSResourceRecord(p, bufsize, &r, buffer, paylen, NULL);
-        if (ret == 0 || ret > bufsize) {
-            AJ_ErrPrintf(("Error while deserializing question record.\n"));
+    memset(&parser, 0, sizeof(parser));
+    parser.pkt = rxBuf->readPtr;
+    parser.len = (uint16_t)bufsize;
+    offset = MDNS_HEADER_SIZE;
+
+    numRecords = (uint32_t)header.qdCount + header.anCount + header.m_nsCount + header.arCount;
+    for (i = 0; i < numRecords; ++i) {
+        uint16_t name = offset;
+        uint16_t type;
+        uint16_t rdlen;
+        const uint8_t* rdata;
+
+        offset = MDNSSkipName(&parser, offset);
+        if (!offset) {
+            AJ_ErrPrintf(("Error while deserializing record name\n"));
             return AJ_ERR_NO_MATCH;
         }
-        size += ret;
-        bufsize -= ret;
-        p += ret;
-        AJ_InfoPrintf(("Skipping unexpected question in response, will be silently ignored.\n"));
-    }
-    for (i = 0; i < header.anCount; i++) {
-        memset(&r, 0, sizeof(MDNSResourceRecord));
-        ret = ParseMDNSResourceRecord(p, bufsize, &r, buffer, paylen, NULL);
-        if (ret == 0 || ret > bufsize) {
-            AJ_ErrPrintf(("Error while deserializing answer record.\n"));
-            return AJ_ERR_NO_MATCH;
-        }
-        size += ret;
-        bufsize -= ret;
-        p += ret;
-        AJ_InfoPrintf(("Processed answer %d\n", (i + 1)));
-
-        if (r.rrType == PTR && !memcmp(r.rrDomainName.name, "_alljoyn._tcp.local", 19)) {
-            AJ_InfoPrintf(("Found _alljoyn_.tcp.local PTR record.\n"));
-            alljoyn_ptr_record_tcp = 1;
-        }
-
-        if (r.rrType == PTR && !memcmp(r.rrDomainName.name, "_alljoyn._udp.local", 19)) {
-            AJ_InfoPrintf(("Found _alljoyn_._udp.local PTR record.\n"));
-            alljoyn_ptr_record_udp = 1;
-        }
-
-        // We ignore the sender's "guid." (32 chars + 1 char for the dot) in the <guid>._alljoyn._tcp.local domain name.
-        if (r.rrType == SRV && !memcmp(r.rrDomainName.name + 33, "_alljoyn._tcp.local", 19)) {
-            AJ_InfoPrintf(("Found a SRV answer with domain name  %s.\n", r.rdata.srvRData.target.name));
-            memset(service_target, 0, 256);
-            memcpy(service_target, r.rdata.srvRData.target.name, 256);
-            service_port_tcp = r.rdata.srvRData.port;
-            service_priority = r.rdata.srvRData.priority;
-        }
-
-        // We ignore the sender's "guid." (32 chars + 1 char for the dot) in the <guid>._alljoyn._udp.local domain name.
-        if (r.rrType == SRV && !memcmp(r.rrDomainName.name + 33, "_alljoyn._udp.local", 19)) {
-            AJ_InfoPrintf(("Found a SRV answer with domain name  %s.\n", r.rdata.srvRData.target.name));
-            memset(service_target, 0, 256);
-            memcpy(service_target, r.rdata.srvRData.target.name, 256);
-            service_port_udp = r.rdata.srvRData.port;
-            service_priority = r.rdata.srvRData.priority;
+        if (i < header.qdCount) {
+            /*
+             * Questions have no TTL or rdata and are silently ignored
+             */
+            if ((offset + 4) > parser.len) {
+                return AJ_ERR_NO_MATCH;
+            }
+            offset += 4;
+            continue;
         }
-    }
-
-    // PTR record must be parsed and service port should be non-zero
-    // to continue with the parsing. Zero is an invalid service port.
-    if ((!alljoyn_ptr_record_tcp && !alljoyn_ptr_record_udp) || (!service_port_tcp && !service_port_udp)) {
-        return AJ_ERR_NO_MATCH;
-    }
-
-    for (i = 0; i < header.m_nsCount; i++) {
-        memset(&r, 0, sizeof(MDNSResourceRecord));
-        ret = ParseMDNSResourceRecord(p, bufsize, &r, buffer, paylen, NULL);
-        if (ret == 0 || ret > bufsize) {
-            AJ_ErrPrintf(("Error while deserializing authority record.\n"));
+        if ((offset + 10) > parser.len) {
             return AJ_ERR_NO_MATCH;
         }
-        size += ret;
-        bufsize -= ret;
-        p += ret;
-        AJ_InfoPrintf(("Skipping non-relevant authority record, will be silently ignored.\n"));
-    }
-    for (i = 0; i < header.arCount; i++) {
-        memset(&r, 0, sizeof(MDNSResourceRecord));
-        ret = ParseMDNSResourceRecord(p, bufsize, &r, buffer, paylen, prefix);
-        if (ret == 0 || ret > bufsize) {
-            AJ_ErrPrintf(("Error while deserializing additional record.\n"));
+        type = (parser.pkt[offset] << 8) | parser.pkt[offset + 1];
+        rdlen = (parser.pkt[offset + 8] << 8) | parser.pkt[offset + 9];
+        offset += 10;
+        if (rdlen > (parser.len - offset)) {
+            AJ_ErrPrintf(("Error while deserializing record data\n"));
             return AJ_ERR_NO_MATCH;
         }
-        size += ret;
-        bufsize -= ret;
-        p += ret;
-        AJ_InfoPrintf(("Processing additional record %d\n", (i + 1)));
-        if (r.rrType == TXT) {
-            // Ensure the advertise TXT record refers to the same guid in the SRV record.
-            if (!memcmp(r.rrDomainName.name, "advertise.", 10) && !memcmp(r.rrDomainName.name + 10, service_target, 38)) {
-                AJ_InfoPrintf(("Found advertise.* TXT record with full label %s.\n", r.rrDomainName.name));
-                // Ensure the sender-info TXT record included a transport and had the requested name prefix
-                if (r.rdata.textRData.BusNodeTransport[0] && r.rdata.textRData.BusNodeName[0]) {
-                    bus_transport = 1;
+        rdata = parser.pkt + offset;
+        offset += rdlen;
+
+        if (i < ((uint32_t)header.qdCount + header.anCount)) {
+            if (type == PTR) {
+                uint8_t id = MDNSNameId(&parser, name);
+                if (id == MDNS_NAME_TCP) {
+                    AJ_InfoPrintf(("Found _alljoyn_.tcp.local PTR record.\n"));
+                    alljoyn_ptr_record_tcp = 1;
+                } else if (id == MDNS_NAME_UDP) {
+                    AJ_InfoPrintf(("Found _alljoyn_._udp.local PTR record.\n"));
+                    alljoyn_ptr_record_udp = 1;
+                }
+            } else if (type == SRV) {
+                uint8_t id = MDNSSuffixId(&parser, name, NULL, MDNS_GUID_LABEL_LEN);
+                uint16_t target = (uint16_t)(rdata - parser.pkt) + 6;
+                if ((id == MDNS_NAME_TCP) || (id == MDNS_NAME_UDP)) {
+                    if ((rdlen < 7) || (MDNSSkipName(&parser, target) > offset) || !MDNSLabel(&parser, target)) {
+                        AJ_ErrPrintf(("Error while deserializing SRV record.\n"));
+                        return AJ_ERR_NO_MATCH;
+                    }
+                    AJ_InfoPrintf(("Found a SRV answer for %s.\n", (id == MDNS_NAME_TCP) ? "tcp" : "udp"));
+                    if (id == MDNS_NAME_TCP) {
+                        service_port_tcp = (rdata[4] << 8) | rdata[5];
+                    } else {
+                        service_port_udp = (rdata[4] << 8) | rdata[5];
+                    }
+                    service_priority = (rdata[0] << 8) | rdata[1];
+                    if (target != parser.target) {
+                        /*
+                         * Names that were compared against the previous target must be compared again
+                         */
+                        parser.target = target;
+                        parser.numCached = 0;
+                    }
                 }
             }
-            // Ensure the sender-info TXT record refers to the same guid in the SRV record.
-            if (!memcmp(r.rrDomainName.name, "sender-info.", 12) && !memcmp(r.rrDomainName.name + 12, service_target, 38)) {
-                AJ_InfoPrintf(("Found sender-info.* TXT record with full name: %s.\n", r.rrDomainName.name));
-                // If the sender-info TXT record included the protocol version
+            if (i == ((uint32_t)header.qdCount + header.anCount - 1)) {
+                /*
+                 * PTR record must be parsed and service port should be non-zero
+                 * to continue with the parsing. Zero is an invalid service port.
+                 */
+                if ((!alljoyn_ptr_record_tcp && !alljoyn_ptr_record_udp) || (!service_port_tcp && !service_port_udp)) {
+                    return AJ_ERR_NO_MATCH;
+                }
+            }
+            continue;
+        }
+        if (i < ((uint32_t)header.qdCount + header.anCount + header.m_nsCount)) {
+            continue;
+        }
+        /*
+         * Additional records only count if they refer to the same guid as the SRV record
+         */
+        if (type == TXT) {
+            if (MDNSSuffixId(&parser, name, "advertise", 9) == MDNS_NAME_TARGET) {
+                uint8_t transport = FALSE;
+                uint8_t found = FALSE;
+                AJ_InfoPrintf(("Found advertise.* TXT record.\n"));
+                if (!ParseMDNSTextRData(rdata, rdlen, prefix, &transport, &found, NULL)) {
+                    return AJ_ERR_NO_MATCH;
+                }
+                // Ensure the advertise TXT record included a transport and had the requested name prefix
+                if (transport && found) {
+                    bus_transport = 1;
+                }
+            } else if (MDNSSuffixId(&parser, name, "sender-info", 11) == MDNS_NAME_TARGET) {
+                uint8_t transport = FALSE;
+                uint8_t found = FALSE;
+                int32_t pv = -1;
+                AJ_InfoPrintf(("Found sender-info.* TXT record.\n"));
+                if (!ParseMDNSTextRData(rdata, rdlen, prefix, &transport, &found, &pv)) {
+                    return AJ_ERR_NO_MATCH;
+                }
                 protocol_version = 0;
-                if (r.rdata.textRData.BusNodeProtocolVersion[0]) {
+                if (pv >= 0) {
                     // Ensure that it greater than or equal to the minimum allowed
-                    protocol_version = atoi(r.rdata.textRData.BusNodeProtocolVersion);
+                    protocol_version = (uint32_t)pv;
                     if (protocol_version >= AJ_GetMinProtoVersion()) {
                         bus_protocol = 1;
                     }
@@ -975,22 +874,22 @@ static AJ_Status ParseMDNSResp(AJ_IOBuffer* rxBuf, const char* prefix, AJ_Servic
                     }
                 }
             }
-        }
-        // Ensure the A record refers to the same guid in the SRV record.
-        if (r.rrType == A && (memcmp(r.rrDomainName.name, service_target, 38) == 0)) {
-            AJ_InfoPrintf(("Found an A additional record.\n"));
-            AJ_ASSERT(sizeof(bus_addr) == IPV4ADDRSIZE_U8);
-            memset(bus_addr, 0, IPV4ADDRSIZE_U8);
-            memcpy(bus_addr, r.rdata.aRData.ipv4Addr, IPV4ADDRSIZE_U8);
-            bus_a_record = 1;
-        }
-        // Ensure the AAAA record refers to the same guid in the SRV record.
-        if (r.rrType == AAAA && (memcmp(r.rrDomainName.name, service_target, 38) == 0)) {
-            AJ_InfoPrintf(("Found an AAAA additional record.\n"));
-            AJ_ASSERT(sizeof(bus_aaa_addr) == IPV6ADDRSIZE_U8);
-            memset(bus_aaa_addr, 0, IPV6ADDRSIZE_U8);
-            memcpy(bus_aaa_addr, r.rdata.aaaaRData.ipv6Addr, IPV6ADDRSIZE_U8);
-            bus_aaaa_record = 1;
+        } else if ((type == A) || (type == AAAA)) {
+            if (MDNSNameId(&parser, name) == MDNS_NAME_TARGET) {
+                if (rdlen != ((type == A) ? IPV4ADDRSIZE_U8 : IPV6ADDRSIZE_U8)) {
+                    AJ_ErrPrintf(("Error while deserializing address record.\n"));
+                    return AJ_ERR_NO_MATCH;
+                }
+                if (type == A) {
+                    AJ_InfoPrintf(("Found an A additional record.\n"));
+                    bus_addr = rdata;
+                    bus_a_record = 1;
+                } else {
+                    AJ_InfoPrintf(("Found an AAAA additional record.\n"));
+                    bus_aaa_addr = rdata;
+                    bus_aaaa_record = 1;
+                }
+            }
         }
     }
 
@@ -1056,7 +955,7 @@ static AJ_Status ParseMDNSResp(AJ_IOBuffer* rxBuf, const char* prefix, AJ_Servic
 #define AJ_BURST_COUNT       3
 #define AJ_INITIAL_INTERVAL  1000
 
-static uint32_t searchId = 0;
+static AJ_THREAD_LOCAL uint32_t searchId = 0;
 
 AJ_Status AJ_Discover(const char* prefix, AJ_Service* service, uint32_t timeout, uint32_t selectionTimeout)
 {
@@ -1192,7 +1091,7 @@ AJ_Status AJ_Discover(const char* prefix, AJ_Service* service, uint32_t timeout,
             } else {
                 if (sock.rx.flags & AJ_IO_BUF_MDNS) {
                     memset(service, 0, sizeof(AJ_Service));
-                    status = ParseMDNSResp(&sock.rx, prefix, service);
+                    status = AJ_ParseMDNSResponse(&sock.rx, prefix, service);
                     if (status == AJ_OK) {
                         AJ_InfoPrintf(("AJ_Discover(): mDNS discovered \"%s\"\n", prefix));
 
@@ -1229,6 +1128,14 @@ AJ_Status AJ_Discover(const char* prefix, AJ_Service* service, uint32_t timeout,
     }
 
 _Exit:
+#ifdef AJ_NET_PROBE
+    /*
+     * Measure the routing nodes that responded so the nearest reachable one is selected
+     */
+    if (AJ_GetRoutingNodeResponseListSize() > 1) {
+        AJ_ProbeRoutingNodeResponseList(AJ_ROUTING_NODE_PROBE_TIMEOUT);
+    }
+#endif
     memset(service, 0, sizeof(AJ_Service));
     status = AJ_SelectRoutingNodeFromResponseList(service);
     /*
@@ -63,11 +63,53 @@ typedef struct _NameToGUID {
     uint32_t replySerial;
     uint32_t authVersion;
     AJ_SerialNum incoming;
+#if AJ_AES_KEY_CACHE
+    AJ_AES_Key sessionAesKey; /* Expanded session key */
+    AJ_AES_Key groupAesKey;   /* Expanded group key */
+#endif
+    uint16_t lruPrev;  /* Next more recently used mapping (slot + 1) */
+    uint16_t lruNext;  /* Next less recently used mapping (slot + 1) */
 } NameToGUID;
 
-static uint8_t localGroupKey[AJ_SESSION_KEY_LEN];
+#if AJ_NAME_MAP_GUID_SIZE >= 0x7FFF
+#error "AJ_NAME_MAP_GUID_SIZE is too large"
+#endif
+
+/*
+ * Open addressed hash index over the unique names and aliases in the name map. Each entry is the
+ * slot + 1 of a mapping with NAME_HASH_ALIAS set if the entry is keyed by the alias (service name)
+ * rather than the unique name, 0 marks an empty bucket. There are at most two keys per mapping so
+ * the index is never more than half full.
+ */
+#define NAME_HASH_SIZE  (4 * AJ_NAME_MAP_GUID_SIZE + 1)
+#define NAME_HASH_ALIAS 0x8000
+
+typedef struct _AJ_NameMapState {
+    uint8_t localGroupKey[AJ_SESSION_KEY_LEN];
+#if AJ_AES_KEY_CACHE
+    AJ_AES_Key localGroupAesKey;
+#endif
+    NameToGUID nameMap[AJ_NAME_MAP_GUID_SIZE];
+    uint16_t nameHash[NAME_HASH_SIZE];
+    /*
+     * Mappings in use are kept on a list ordered by most recent use, free slots are kept on a stack
+     */
+    uint16_t lruHead;
+    uint16_t lruTail;
+    uint16_t freeSlots[AJ_NAME_MAP_GUID_SIZE];
+    uint16_t numFree;
+    uint16_t slotsHighWater;
+} AJ_NameMapState;
+
+/*
+ * Name map for bus attachments that do not have their own context
+ */
+static AJ_NameMapState defaultNameMapState;
 
-static NameToGUID nameMap[AJ_NAME_MAP_GUID_SIZE];
+/*
+ * Name map for the currently selected bus attachment
+ */
+static AJ_THREAD_LOCAL AJ_NameMapState* nameMapState = &defaultNameMapState;
 
 static AJ_Status SetNameOwnerChangedRule(AJ_BusAttachment* bus, const char* oldOwner, uint8_t rule, uint32_t* serialNum);
 static AJ_Status NameHasOwner(AJ_Message* msg, const char* name, uint32_t* serialNum);
@@ -82,18 +124,121 @@ AJ_Status AJ_GUID_FromString(AJ_GUID* guid, const char* str)
     return AJ_HexToRaw(str, 2 * AJ_GUID_LEN, guid->val, AJ_GUID_LEN);
 }
 
+static uint32_t HashName(const char* name)
+{
+    uint32_t hash = 2166136261UL;
+    while (*name) {
+        hash = (hash ^ (uint8_t)*name++) * 16777619UL;
+    }
+    return hash % NAME_HASH_SIZE;
+}
+
+static const char* HashKey(uint16_t entry)
+{
+    NameToGUID* mapping = &nameMapState->nameMap[(entry & ~NAME_HASH_ALIAS) - 1];
+    return (entry & NAME_HASH_ALIAS) ? mapping->serviceName : mapping->uniqueName;
+}
+
+static void HashInsert(uint16_t entry)
+{
+    uint32_t pos = HashName(HashKey(entry));
+
+    while (nameMapState->nameHash[pos]) {
+        pos = (pos + 1) % NAME_HASH_SIZE;
+    }
+    nameMapState->nameHash[pos] = entry;
+}
+
+static void HashRemove(uint16_t entry)
+{
+    uint32_t pos = HashName(HashKey(entry));
+    uint32_t next;
+
+    while (nameMapState->nameHash[pos] != entry) {
+        if (!nameMapState->nameHash[pos]) {
+            return;
+        }
+        pos = (pos + 1) % NAME_HASH_SIZE;
+    }
+    /*
+     * Shift back any following entries that would no longer be reachable from their home bucket
+     */
+    next = pos;
+    while (TRUE) {
+        uint32_t home;
+        next = (next + 1) % NAME_HASH_SIZE;
+        if (!nameMapState->nameHash[next]) {
+            break;
+        }
+        home = HashName(HashKey(nameMapState->nameHash[next]));
+        if (((next > pos) && ((home <= pos) || (home > next))) || ((next < pos) && ((home <= pos) && (home > next)))) {
+            nameMapState->nameHash[pos] = nameMapState->nameHash[next];
+            pos = next;
+        }
+    }
+    nameMapState->nameHash[pos] = 0;
+}
+
+static void LruUnlink(uint16_t slot)
+{
+    NameToGUID* mapping = &nameMapState->nameMap[slot - 1];
+
+    if (mapping->lruPrev) {
+        nameMapState->nameMap[mapping->lruPrev - 1].lruNext = mapping->lruNext;
+    } else {
+        nameMapState->lruHead = mapping->lruNext;
+    }
+    if (mapping->lruNext) {
+        nameMapState->nameMap[mapping->lruNext - 1].lruPrev = mapping->lruPrev;
+    } else {
+        nameMapState->lruTail = mapping->lruPrev;
+    }
+    mapping->lruPrev = 0;
+    mapping->lruNext = 0;
+}
+
+static void LruPushFront(uint16_t slot)
+{
+    NameToGUID* mapping = &nameMapState->nameMap[slot - 1];
+
+    mapping->lruPrev = 0;
+    mapping->lruNext = nameMapState->lruHead;
+    if (nameMapState->lruHead) {
+        nameMapState->nameMap[nameMapState->lruHead - 1].lruPrev = slot;
+    } else {
+        nameMapState->lruTail = slot;
+    }
+    nameMapState->lruHead = slot;
+}
+
+/*
+ * Returns the hash index entry for a name, if alias is TRUE only aliases are matched
+ */
+static uint16_t FindName(const char* name, uint8_t alias)
+{
+    uint32_t pos = HashName(name);
+
+    while (nameMapState->nameHash[pos]) {
+        if ((!alias || (nameMapState->nameHash[pos] & NAME_HASH_ALIAS)) && (strcmp(HashKey(nameMapState->nameHash[pos]), name) == 0)) {
+            return nameMapState->nameHash[pos];
+        }
+        pos = (pos + 1) % NAME_HASH_SIZE;
+    }
+    return 0;
+}
+
 static NameToGUID* LookupName(const char* name)
 {
-    uint32_t i;
+    uint16_t slot;
     AJ_InfoPrintf(("LookupName(name=\"%s\")\n", name));
 
-    for (i = 0; i < AJ_NAME_MAP_GUID_SIZE; ++i) {
-        if (strcmp(nameMap[i].uniqueName, name) == 0) {
-            return &nameMap[i];
-        }
-        if (nameMap[i].serviceName && (strcmp(nameMap[i].serviceName, name)) == 0) {
-            return &nameMap[i];
+    slot = *name ? (FindName(name, FALSE) & ~NAME_HASH_ALIAS) : 0;
+    if (slot) {
+        if (nameMapState->lruHead != slot) {
+            LruUnlink(slot);
+            LruPushFront(slot);
         }
+        return &nameMapState->nameMap[slot - 1];
     }
     AJ_InfoPrintf(("LookupName(): NULL\n"));
     return NULL;
@@ -101,16 +246,81 @@ static NameToGUID* LookupName(const char* name)
 
 static NameToGUID* LookupReplySerial(uint32_t replySerial)
 {
-    uint32_t i;
+    uint16_t slot;
+
+    for (slot = nameMapState->lruHead; slot; slot = nameMapState->nameMap[slot - 1].lruNext) {
+        if (nameMapState->nameMap[slot - 1].replySerial == replySerial) {
+            return &nameMapState->nameMap[slot - 1];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Sets or clears the alias for a mapping, an alias can only refer to one mapping so it is removed
+ * from any older mapping.
+ */
+static void SetAlias(NameToGUID* mapping, const char* serviceName)
+{
+    uint16_t entry = (uint16_t)((mapping - nameMapState->nameMap) + 1) | NAME_HASH_ALIAS;
+
+    if (mapping->serviceName) {
+        HashRemove(entry);
+        mapping->serviceName = NULL;
+    }
+    if (serviceName && *serviceName) {
+        uint16_t older = FindName(serviceName, TRUE);
+        if (older) {
+            HashRemove(older);
+            nameMapState->nameMap[(older & ~NAME_HASH_ALIAS) - 1].serviceName = NULL;
+        }
+        mapping->serviceName = serviceName;
+        HashInsert(entry);
+    }
+}
+
+static NameToGUID* AllocMapping(void)
+{
+    if (nameMapState->numFree) {
+        return &nameMapState->nameMap[nameMapState->freeSlots[--nameMapState->numFree]];
+    }
+    if (nameMapState->slotsHighWater < AJ_NAME_MAP_GUID_SIZE) {
+        return &nameMapState->nameMap[nameMapState->slotsHighWater++];
+    }
+    return NULL;
+}
+
+/*
+ * Evicts the least recently used mapping that is not waiting for a reply from the bus
+ */
+static NameToGUID* EvictMapping(AJ_BusAttachment* bus)
+{
+    uint16_t slot;
 
-    for (i = 0; i < AJ_NAME_MAP_GUID_SIZE; ++i) {
-        if (nameMap[i].replySerial == replySerial) {
-            return &nameMap[i];
+    for (slot = nameMapState->lruTail; slot; slot = nameMapState->nameMap[slot - 1].lruPrev) {
+        if (!nameMapState->nameMap[slot - 1].replySerial) {
+            AJ_InfoPrintf(("EvictMapping(): evicting \"%s\"\n", nameMapState->nameMap[slot - 1].uniqueName));
+            AJ_GUID_DeleteNameMapping(bus, nameMapState->nameMap[slot - 1].uniqueName);
+            return AllocMapping();
         }
     }
     return NULL;
 }
 
+static void ReleaseMapping(NameToGUID* mapping)
+{
+    uint16_t slot = (uint16_t)((mapping - nameMapState->nameMap) + 1);
+
+    SetAlias(mapping, NULL);
+    HashRemove(slot);
+    LruUnlink(slot);
+    /*
+     * The handshake code relies on the GUID being zeroed when a peer goes away
+     */
+    AJ_MemZeroSecure(mapping, sizeof(NameToGUID));
+    nameMapState->freeSlots[nameMapState->numFree++] = slot - 1;
+}
+
 AJ_Status AJ_GUID_AddNameMapping(AJ_BusAttachment* bus, const AJ_GUID* guid, const char* uniqueName, const char* serviceName)
 {
     AJ_Status status;
@@ -121,31 +331,43 @@ AJ_Status AJ_GUID_AddNameMapping(AJ_BusAttachment* bus, const AJ_GUID* guid, con
 
     AJ_InfoPrintf(("AJ_GUID_AddNameMapping(guid=0x%p, uniqueName=\"%s\", serviceName=\"%s\")\n", guid, uniqueName, serviceName));
 
+    if (!len || (len > AJ_MAX_NAME_SIZE)) {
+        AJ_ErrPrintf(("AJ_GUID_AddNameMapping(): AJ_ERR_RESOURCES\n"));
+        return AJ_ERR_RESOURCES;
+    }
     mapping = LookupName(uniqueName);
     isNew = !mapping;
     if (isNew) {
-        mapping = LookupName("");
+        mapping = AllocMapping();
+        if (!mapping) {
+            mapping = EvictMapping(bus);
+        }
+        if (!mapping) {
+            AJ_ErrPrintf(("AJ_GUID_AddNameMapping(): AJ_ERR_RESOURCES\n"));
+            return AJ_ERR_RESOURCES;
+        }
     }
-    if (mapping && (len <= AJ_MAX_NAME_SIZE)) {
-        if (isNew && (AJ_GetRoutingProtoVersion() >= 11)) {
-            status = SetNameOwnerChangedRule(bus, uniqueName, AJ_BUS_SIGNAL_ALLOW, &serialNum);
-            if (status != AJ_OK) {
-                AJ_ErrPrintf(("AJ_GUID_AddNameMapping(guid=0x%p, uniqueName=\"%s\", serviceName=\"%s\"): Add match rule error\n",
-                              guid, uniqueName, serviceName));
-                return status;
-            }
-            mapping->replySerial = serialNum;
+    if (isNew && (AJ_GetRoutingProtoVersion() >= 11)) {
+        status = SetNameOwnerChangedRule(bus, uniqueName, AJ_BUS_SIGNAL_ALLOW, &serialNum);
+        if (status != AJ_OK) {
+            AJ_ErrPrintf(("AJ_GUID_AddNameMapping(guid=0x%p, uniqueName=\"%s\", serviceName=\"%s\"): Add match rule error\n",
+                          guid, uniqueName, serviceName));
+            nameMapState->freeSlots[nameMapState->numFree++] = (uint16_t)(mapping - nameMapState->nameMap);
+            return status;
         }
-        memcpy(&mapping->guid, guid, sizeof(AJ_GUID));
+        mapping->replySerial = serialNum;
+    }
+    memcpy(&mapping->guid, guid, sizeof(AJ_GUID));
+    if (isNew) {
+        uint16_t slot = (uint16_t)((mapping - nameMapState->nameMap) + 1);
         memcpy(&mapping->uniqueName, uniqueName, len + 1);
-        mapping->serviceName = serviceName;
-        mapping->incoming.serial = 0;
-        mapping->incoming.offset = 0;
-        return AJ_OK;
-    } else {
-        AJ_ErrPrintf(("AJ_GUID_AddNameMapping(): AJ_ERR_RESOURCES\n"));
-        return AJ_ERR_RESOURCES;
+        HashInsert(slot);
+        LruPushFront(slot);
     }
+    SetAlias(mapping, serviceName);
+    mapping->incoming.serial = 0;
+    mapping->incoming.offset = 0;
+    return AJ_OK;
 }
 
 void AJ_GUID_DeleteNameMapping(AJ_BusAttachment* bus, const char* uniqueName)
@@ -162,7 +384,7 @@ void AJ_GUID_DeleteNameMapping(AJ_BusAttachment* bus, const char* uniqueName)
                 AJ_WarnPrintf(("AJ_GUID_DeleteNameMapping(uniqueName=\"%s\"): Remove match rule error\n", uniqueName));
             }
         }
-        memset(mapping, 0, sizeof(NameToGUID));
+        ReleaseMapping(mapping);
     }
 }
 
@@ -178,7 +400,37 @@ const AJ_GUID* AJ_GUID_Find(const char* name)
 void AJ_GUID_ClearNameMap(void)
 {
     AJ_InfoPrintf(("AJ_GUID_ClearNameMap()\n"));
-    memset(nameMap, 0, sizeof(nameMap));
+    AJ_MemZeroSecure(nameMapState->nameMap, sizeof(nameMapState->nameMap));
+    memset(nameMapState->nameHash, 0, sizeof(nameMapState->nameHash));
+    nameMapState->lruHead = 0;
+    nameMapState->lruTail = 0;
+    nameMapState->numFree = 0;
+    nameMapState->slotsHighWater = 0;
+}
+
+AJ_NameMapState* AJ_GUID_NameMapStateNew(void)
+{
+    AJ_NameMapState* state = (AJ_NameMapState*)AJ_Malloc(sizeof(AJ_NameMapState));
+    if (state) {
+        memset(state, 0, sizeof(AJ_NameMapState));
+    }
+    return state;
+}
+
+void AJ_GUID_NameMapStateFree(AJ_NameMapState* state)
+{
+    if (state) {
+        if (nameMapState == state) {
+            nameMapState = &defaultNameMapState;
+        }
+        AJ_MemZeroSecure(state, sizeof(AJ_NameMapState));
+        AJ_Free(state);
+    }
+}
+
+void AJ_GUID_NameMapStateSelect(AJ_NameMapState* state)
+{
+    nameMapState = state ? state : &defaultNameMapState;
 }
 
 AJ_Status AJ_SetGroupKey(const char* uniqueName, const uint8_t* key)
@@ -190,6 +442,9 @@ AJ_Status AJ_SetGroupKey(const char* uniqueName, const uint8_t* key)
     mapping = LookupName(uniqueName);
     if (mapping) {
         memcpy(mapping->groupKey, key, AJ_SESSION_KEY_LEN);
+#if AJ_AES_KEY_CACHE
+        AJ_AES_ExpandKey(&mapping->groupAesKey, key);
+#endif
         return AJ_OK;
     } else {
         AJ_WarnPrintf(("AJ_SetGroupKey(): AJ_ERR_NO_MATCH\n"));
@@ -208,6 +463,9 @@ AJ_Status AJ_SetSessionKey(const char* uniqueName, const uint8_t* key, uint8_t r
         mapping->keyRole = role;
         mapping->authVersion = authVersion;
         memcpy(mapping->sessionKey, key, AJ_SESSION_KEY_LEN);
+#if AJ_AES_KEY_CACHE
+        AJ_AES_ExpandKey(&mapping->sessionAesKey, key);
+#endif
         return AJ_OK;
     } else {
         AJ_WarnPrintf(("AJ_SetSessionKey(): AJ_ERR_NO_MATCH\n"));
@@ -241,7 +499,7 @@ AJ_Status AJ_GetPeerIndex(const char* name, uint32_t* peer)
 
     mapping = LookupName(name);
     if (mapping) {
-        *peer = (mapping - nameMap);
+        *peer = (mapping - nameMapState->nameMap);
         AJ_ASSERT(*peer < AJ_NAME_MAP_GUID_SIZE);
         return AJ_OK;
     } else {
@@ -298,13 +556,59 @@ AJ_Status AJ_GetGroupKey(const char* name, uint8_t* key)
          * Check if the group key needs to be initialized
          */
         memset(key, 0, AJ_SESSION_KEY_LEN);
-        if (memcmp(localGroupKey, key, AJ_SESSION_KEY_LEN) == 0) {
-            AJ_RandBytes(localGroupKey, AJ_SESSION_KEY_LEN);
+        if (memcmp(nameMapState->localGroupKey, key, AJ_SESSION_KEY_LEN) == 0) {
+            AJ_RandBytes(nameMapState->localGroupKey, AJ_SESSION_KEY_LEN);
+#if AJ_AES_KEY_CACHE
+            AJ_AES_ExpandKey(&nameMapState->localGroupAesKey, nameMapState->localGroupKey);
+#endif
+        }
+        memcpy(key, nameMapState->localGroupKey, AJ_SESSION_KEY_LEN);
+    }
+    return AJ_OK;
+}
+
+#if AJ_AES_KEY_CACHE
+AJ_Status AJ_GetSessionAesKey(const char* name, const AJ_AES_Key** aesKey, uint8_t* role, uint32_t* authVersion)
+{
+    NameToGUID* mapping;
+
+    AJ_InfoPrintf(("AJ_GetSessionAesKey(name=\"%s\", aesKey=0x%p, role=0x%p)\n", name, aesKey, role));
+
+    mapping = LookupName(name);
+    if (mapping) {
+        *role = mapping->keyRole;
+        *authVersion = mapping->authVersion;
+        *aesKey = &mapping->sessionAesKey;
+        return AJ_OK;
+    } else {
+        AJ_WarnPrintf(("AJ_GetSessionAesKey(): AJ_ERR_NO_MATCH\n"));
+        return AJ_ERR_NO_MATCH;
+    }
+}
+
+AJ_Status AJ_GetGroupAesKey(const char* name, const AJ_AES_Key** aesKey)
+{
+    uint8_t key[AJ_SESSION_KEY_LEN];
+
+    AJ_InfoPrintf(("AJ_GetGroupAesKey(name=\"%s\", aesKey=0x%p)\n", name, aesKey));
+    if (name) {
+        NameToGUID* mapping = LookupName(name);
+        if (!mapping) {
+            AJ_WarnPrintf(("AJ_GetGroupAesKey(): AJ_ERR_NO_MATCH\n"));
+            return AJ_ERR_NO_MATCH;
         }
-        memcpy(key, localGroupKey, AJ_SESSION_KEY_LEN);
+        *aesKey = &mapping->groupAesKey;
+    } else {
+        /*
+         * Makes sure the local group key has been initialized
+         */
+        AJ_GetGroupKey(NULL, key);
+        AJ_MemZeroSecure(key, sizeof(key));
+        *aesKey = &nameMapState->localGroupAesKey;
     }
     return AJ_OK;
 }
+#endif
 
 static AJ_Status SetNameOwnerChangedRule(AJ_BusAttachment* bus, const char* oldOwner, uint8_t rule, uint32_t* serialNum)
 {
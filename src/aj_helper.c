@@ -56,66 +56,200 @@ typedef struct {
     void* context;          /**< A context pointer passed in by the user */
     uint32_t abs_time;      /**< The absolute time when this timer will fire */
     uint32_t repeat;        /**< The amount of time between timer events */
+    uint16_t heapPos;       /**< Position of this timer in the timer heap */
 } Timer;
 
-static Timer Timers[AJ_MAX_TIMERS] = {
-    { NULL }
-};
+/*
+ * Pending timers are kept in a binary min-heap ordered by expiry time. Times are compared as signed
+ * differences so the heap keeps working when the millisecond clock wraps around. Free timer slots
+ * are kept on a stack, slots that have never been used are above TimersHighWater.
+ */
+typedef struct _AJ_TimerState {
+    Timer Timers[AJ_MAX_TIMERS];
+    uint16_t TimerHeap[AJ_MAX_TIMERS];
+    uint16_t TimerHeapSize;
+    uint16_t FreeTimers[AJ_MAX_TIMERS];
+    uint16_t FreeTimerCount;
+    uint16_t TimersHighWater;
+} AJ_TimerState;
+
+/*
+ * Timers for bus attachments that do not have their own context
+ */
+static AJ_TimerState defaultTimerState;
+
+/*
+ * Timers for the currently selected bus attachment
+ */
+static AJ_THREAD_LOCAL AJ_TimerState* timerState = &defaultTimerState;
+
+/*
+ * Relative times are limited so that signed differences between expiry times cannot overflow
+ */
+#define MAX_RELATIVE_TIME 0x7FFFFFFF
+
+#define TIME_BEFORE(a, b) ((int32_t)((a) - (b)) < 0)
+
+static uint32_t TimerNow(void)
+{
+    AJ_Time start = { 0, 0 };
+    return AJ_GetElapsedTime(&start, FALSE);
+}
 
-static uint32_t RunExpiredTimers(uint32_t now)
+static void TimerHeapSet(uint16_t pos, uint16_t idx)
 {
-    uint32_t i = 0;
-    uint32_t next = (uint32_t) -1;
+    timerState->TimerHeap[pos] = idx;
+    timerState->Timers[idx].heapPos = pos;
+}
 
-    for (; i < AJ_MAX_TIMERS; ++i) {
-        Timer* timer = Timers + i;
-        if (timer->handler != NULL && timer->abs_time <= now) {
-            (timer->handler)(timer->context);
+static void TimerSiftUp(uint16_t pos)
+{
+    uint16_t idx = timerState->TimerHeap[pos];
 
-            if (timer->repeat) {
-                timer->abs_time += timer->repeat;
-            } else {
-                memset(timer, 0, sizeof(Timer));
-            }
+    while (pos) {
+        uint16_t parent = (pos - 1) / 2;
+        if (!TIME_BEFORE(timerState->Timers[idx].abs_time, timerState->Timers[timerState->TimerHeap[parent]].abs_time)) {
+            break;
         }
+        TimerHeapSet(pos, timerState->TimerHeap[parent]);
+        pos = parent;
+    }
+    TimerHeapSet(pos, idx);
+}
+
+static void TimerSiftDown(uint16_t pos)
+{
+    uint16_t idx = timerState->TimerHeap[pos];
 
-        // track the next time we need to run
-        if (timer->handler != NULL && next > timer->abs_time) {
-            next = timer->abs_time;
+    while (TRUE) {
+        uint16_t child = 2 * pos + 1;
+        if (child >= timerState->TimerHeapSize) {
+            break;
+        }
+        if (((child + 1) < timerState->TimerHeapSize) && TIME_BEFORE(timerState->Timers[timerState->TimerHeap[child + 1]].abs_time, timerState->Timers[timerState->TimerHeap[child]].abs_time)) {
+            ++child;
+        }
+        if (!TIME_BEFORE(timerState->Timers[timerState->TimerHeap[child]].abs_time, timerState->Timers[idx].abs_time)) {
+            break;
         }
+        TimerHeapSet(pos, timerState->TimerHeap[child]);
+        pos = child;
     }
+    TimerHeapSet(pos, idx);
+}
 
-    // return the next timeout that will run
-    return next;
+static void TimerHeapRemove(uint16_t pos)
+{
+    if (pos < --timerState->TimerHeapSize) {
+        TimerHeapSet(pos, timerState->TimerHeap[timerState->TimerHeapSize]);
+        if (pos && TIME_BEFORE(timerState->Timers[timerState->TimerHeap[pos]].abs_time, timerState->Timers[timerState->TimerHeap[(pos - 1) / 2]].abs_time)) {
+            TimerSiftUp(pos);
+        } else {
+            TimerSiftDown(pos);
+        }
+    }
 }
 
-uint32_t AJ_SetTimer(uint32_t relative_time, TimeoutHandler handler, void* context, uint32_t repeat)
+static void FreeTimer(Timer* timer)
+{
+    memset(timer, 0, sizeof(Timer));
+    timerState->FreeTimers[timerState->FreeTimerCount++] = (uint16_t)(timer - timerState->Timers);
+}
+
+uint32_t AJ_RunExpiredTimers(void)
 {
-    uint32_t i;
-    for (i = 0; i < AJ_MAX_TIMERS; ++i) {
-        Timer* timer = Timers + i;
-        // need to find an available timer slot
-        if (timer->handler == NULL) {
-            AJ_Time start = { 0, 0 };
-            uint32_t now = AJ_GetElapsedTime(&start, FALSE);
-            timer->handler = handler;
-            timer->context = context;
-            timer->repeat = repeat;
-            timer->abs_time = now + relative_time;
-            return i + 1;
+    uint32_t now = TimerNow();
+
+    /*
+     * Fire all the expired timers in one batch. A repeating timer fires at most once per batch, if
+     * it is more than one period late the missed periods are skipped.
+     */
+    while (timerState->TimerHeapSize) {
+        Timer* timer = &timerState->Timers[timerState->TimerHeap[0]];
+        TimeoutHandler handler = timer->handler;
+        void* context = timer->context;
+
+        if (TIME_BEFORE(now, timer->abs_time)) {
+            // return the next timeout that will run
+            return timer->abs_time - now;
+        }
+        /*
+         * Reschedule or release the timer before calling the handler so the handler can set or
+         * cancel timers, including this one.
+         */
+        if (timer->repeat) {
+            timer->abs_time += timer->repeat;
+            if (!TIME_BEFORE(now, timer->abs_time)) {
+                timer->abs_time = now + timer->repeat;
+            }
+            TimerSiftDown(0);
+        } else {
+            TimerHeapRemove(0);
+            FreeTimer(timer);
         }
+        (handler)(context);
     }
+    return (uint32_t) AJ_TIMER_FOREVER;
+}
 
-    // available slot not found!
-    AJ_ErrPrintf(("AJ_SetTimer(): Slot not found\n"));
-    return 0;
+uint32_t AJ_SetTimer(uint32_t relative_time, TimeoutHandler handler, void* context, uint32_t repeat)
+{
+    Timer* timer;
+
+    // need to find an available timer slot
+    if (timerState->FreeTimerCount) {
+        timer = &timerState->Timers[timerState->FreeTimers[--timerState->FreeTimerCount]];
+    } else if (timerState->TimersHighWater < AJ_MAX_TIMERS) {
+        timer = &timerState->Timers[timerState->TimersHighWater++];
+    } else {
+        // available slot not found!
+        AJ_ErrPrintf(("AJ_SetTimer(): Slot not found\n"));
+        return 0;
+    }
+    timer->handler = handler;
+    timer->context = context;
+    timer->repeat = min(repeat, MAX_RELATIVE_TIME);
+    timer->abs_time = TimerNow() + min(relative_time, MAX_RELATIVE_TIME);
+    timerState->TimerHeap[timerState->TimerHeapSize] = (uint16_t)(timer - timerState->Timers);
+    TimerSiftUp(timerState->TimerHeapSize++);
+    return (uint32_t)(timer - timerState->Timers) + 1;
 }
 
 void AJ_CancelTimer(uint32_t id)
 {
-    Timer* timer = Timers + (id - 1);
+    Timer* timer = timerState->Timers + (id - 1);
     AJ_ASSERT(id > 0 && id <= AJ_MAX_TIMERS);
-    memset(timer, 0, sizeof(Timer));
+    /*
+     * The timer may have already fired
+     */
+    if (timer->handler) {
+        TimerHeapRemove(timer->heapPos);
+        FreeTimer(timer);
+    }
+}
+
+AJ_TimerState* AJ_TimerStateNew(void)
+{
+    AJ_TimerState* state = (AJ_TimerState*)AJ_Malloc(sizeof(AJ_TimerState));
+    if (state) {
+        memset(state, 0, sizeof(AJ_TimerState));
+    }
+    return state;
+}
+
+void AJ_TimerStateFree(AJ_TimerState* state)
+{
+    if (state) {
+        if (timerState == state) {
+            timerState = &defaultTimerState;
+        }
+        AJ_Free(state);
+    }
+}
+
+void AJ_TimerStateSelect(AJ_TimerState* state)
+{
+    timerState = state ? state : &defaultTimerState;
 }
 
 
@@ -126,13 +260,8 @@ AJ_Status AJ_RunAllJoynService(AJ_BusAttachment* bus, AllJoynConfiguration* conf
     AJ_InfoPrintf(("AJ_RunAllJoynService(bus=0x%p, config=0x%p)\n", bus, config));
 
     while (TRUE) {
-        AJ_Time start = { 0, 0 };
         AJ_Message msg;
-        uint32_t now;
-        // get the next timeout
-        uint32_t next;
-        // wait forever
-        uint32_t timeout = (uint32_t) -1;
+        uint32_t timeout;
 
         if (!connected) {
             status = AJ_StartService(
@@ -175,16 +304,12 @@ AJ_Status AJ_RunAllJoynService(AJ_BusAttachment* bus, AllJoynConfiguration* conf
             }
         }
 
-        // absolute time in milliseconds
-        now = AJ_GetElapsedTime(&start, FALSE);
-        next = RunExpiredTimers(now);
-
-        if (next != (uint32_t) -1) {
-            // if no timers running, wait forever
-            timeout = next;
-        }
-
-        status = AJ_UnmarshalMsg(bus, &msg, min(500, timeout));
+        /*
+         * Sleep until the next timer is due. The wait is capped so that the link state is still
+         * checked periodically when there are no timers and no messages.
+         */
+        timeout = AJ_RunExpiredTimers();
+        status = AJ_UnmarshalMsg(bus, &msg, min(AJ_BUS_LINK_PING_TIMEOUT, timeout));
         if (AJ_ERR_TIMEOUT == status && AJ_ERR_LINK_TIMEOUT == AJ_BusLinkStateProc(bus)) {
             AJ_ErrPrintf(("AJ_RunAllJoynService(): AJ_ERR_READ\n"));
             status = AJ_ERR_READ;
@@ -47,6 +47,7 @@
 #include <ajtcl/aj_debug.h>
 #include <ajtcl/aj_config.h>
 #include <ajtcl/aj_authorisation.h>
+#include <ajtcl/aj_about.h>
 /**
  * Turn on per-module debug printing by setting this variable to non-zero value
  * (usually in debugger).
@@ -59,16 +60,6 @@ uint8_t dbgINTROSPECT = 0;
 #define strcasecmp _stricmp
 #endif
 
-/**
- * The various object lists
- */
-static const AJ_Object* objectLists[AJ_MAX_OBJECT_LISTS] = { AJ_StandardObjects, NULL, NULL };
-
-/**
- * The language list
- */
-static const char* const* languageList = NULL;
-
 /**
  * The root object
  */
@@ -83,24 +74,107 @@ const AJ_Object AJ_ROOT_OBJECT = { "/", NULL, 0, NULL };
  * Struct for a reply context for a method call
  */
 typedef struct _ReplyContext {
-    AJ_Time callTime;    /**< Time the method call was made - used for timeouts */
-    uint32_t timeout;    /**< How long to wait for a reply */
-    uint32_t serial;     /**< Serial number for the reply message */
-    uint32_t messageId;  /**< The unique message id for the call */
+    uint32_t deadline;         /**< Time (relative to replyEpoch) when the method call times out */
+    uint32_t serial;           /**< Serial number for the reply message */
+    uint32_t messageId;        /**< The unique message id for the call */
+    AJ_ReplyHandler handler;   /**< Optional handler to call with the reply */
+    void* context;             /**< Application context passed to the handler */
+    uint16_t heapPos;          /**< Position in the deadline heap or NO_REPLY_CONTEXT */
     char uniqueName[AJ_MAX_NAME_SIZE + 1]; /**< Reply sender's unique name */
 } ReplyContext;
 
-static ReplyContext replyContexts[AJ_NUM_REPLY_CONTEXTS];
+/*
+ * Reply contexts are found by serial number through an open addressed hash table and ordered by
+ * deadline in a binary min-heap so checking for a timed-out call does not scan every context.
+ * Entries in the hash table are indexes into replyContexts plus one so that zero means empty.
+ */
+#define REPLY_HASH_SIZE    (2 * AJ_NUM_REPLY_CONTEXTS + 1)
+#define NO_REPLY_CONTEXT   0xFFFF
+
+/*
+ * Deadlines are compared as signed differences so timeouts are limited to half the range
+ */
+#define MAX_REPLY_TIMEOUT  0x7FFFFFFF
+
+/*
+ * Header for the error message passed to reply handlers when the reply contexts are released
+ */
+static const AJ_MsgHeader releasedErrorHdr = { HOST_ENDIANESS, AJ_MSG_ERROR, 0, 0, 0, 1, 0 };
 
 /**
  * Function used by XML generator to push generated XML
  */
 typedef void (*XMLWriterFunc)(void* context, const char* str, uint32_t len);
 
+#if AJ_MSGID_INDEX_SIZE
+/*
+ * The message id index maps a hash of (object path, interface, member, member type) to the message
+ * identifier that the linear scan of the object lists would compute. The index is built lazily from
+ * the registered object lists and is invalidated when the object lists, the proxy object paths, or
+ * the object flags are changed through the API. Every candidate is recorded, including members of
+ * disabled objects, so the lookup can verify each hit and apply the same first-match ordering as the
+ * linear scan.
+ */
+typedef struct _MsgIdIndexEntry {
+    uint32_t hash;      /**< Hash of the object path, interface, member and member type */
+    uint32_t msgId;     /**< Message id for the member or AJ_INVALID_MSG_ID if the slot is free */
+    uint8_t secure;     /**< Cached result of SecurityApplies() for the interface and object */
+} MsgIdIndexEntry;
+
+#endif
+
+#if AJ_INTROSPECT_CACHE_SIZE
+/*
+ * A cached introspection document. The XML is generated the first time an object path is
+ * introspected in a given language and replayed from the cache until the object lists, the object
+ * flags, or the description languages are changed through the API. The XML and the object path
+ * share a single allocation.
+ */
+typedef struct _IntrospectCacheEntry {
+    char* path;             /**< Object path the XML was generated for or NULL if the entry is free */
+    const char* language;   /**< Best matching description language, NULL if there is no language list */
+    uint8_t unified;        /**< TRUE if the XML has the unified description format */
+    char* xml;              /**< The NUL terminated XML followed by the object path */
+    uint32_t len;           /**< Length of the XML excluding the NUL */
+} IntrospectCacheEntry;
+
+#endif
+
+/*
+ * The registered objects and pending method calls for a bus attachment context
+ */
+typedef struct _AJ_IntrospectState {
+    const AJ_Object* objectLists[AJ_MAX_OBJECT_LISTS];                 /**< The various object lists */
+    AJ_DescriptionLookupFunc descriptionLookups[AJ_MAX_OBJECT_LISTS]; /**< Per object list description lookup function */
+    const char* const* languageList;                                  /**< The language list */
+    ReplyContext replyContexts[AJ_NUM_REPLY_CONTEXTS];
+    uint16_t replyHash[REPLY_HASH_SIZE];
+    uint16_t replyHeap[AJ_NUM_REPLY_CONTEXTS];
+    uint16_t replyHeapSize;
+    uint16_t replyFree[AJ_NUM_REPLY_CONTEXTS];
+    uint16_t replyFreeCount;
+    uint16_t replyHighWater;
+    AJ_Time replyEpoch;
+#if AJ_MSGID_INDEX_SIZE
+    MsgIdIndexEntry msgIdIndex[AJ_MSGID_INDEX_SIZE];
+    uint8_t msgIdIndexState;
+    uint8_t msgIdIndexDisabled;
+#endif
+#if AJ_INTROSPECT_CACHE_SIZE
+    IntrospectCacheEntry introspectCache[AJ_INTROSPECT_CACHE_SIZE];
+    uint16_t introspectCacheNext;
+#endif
+} AJ_IntrospectState;
+
+/*
+ * Objects and method calls for bus attachments that do not have their own context
+ */
+static AJ_IntrospectState defaultIntrospectState = { { AJ_StandardObjects } };
+
 /*
- * Per object list description lookup function
+ * Objects and method calls for the currently selected bus attachment
  */
-static AJ_DescriptionLookupFunc descriptionLookups[AJ_MAX_OBJECT_LISTS] = { NULL, NULL, NULL };
+static AJ_THREAD_LOCAL AJ_IntrospectState* introspectState = &defaultIntrospectState;
 
 #define IN_ARG     '<'  /* 0x3C */
 #define OUT_ARG    '>'  /* 0x3E */
@@ -218,12 +292,12 @@ static const char* GetDescription(AJ_DescriptionLookupFunc descLookup, uint32_t
 static uint8_t IsDescriptionAvailable(AJ_DescriptionLookupFunc descLookup, uint32_t descId)
 {
     size_t idx;
-    if (descLookup == NULL || languageList == NULL) {
+    if (descLookup == NULL || introspectState->languageList == NULL) {
         return FALSE;
     }
 
-    for (idx = 0; languageList[idx] != NULL; idx++) {
-        if (descLookup(descId, languageList[idx]) != NULL) {
+    for (idx = 0; introspectState->languageList[idx] != NULL; idx++) {
+        if (descLookup(descId, introspectState->languageList[idx]) != NULL) {
             return TRUE;
         }
     }
@@ -276,10 +350,10 @@ static void XMLWriteUnifiedDescription(XMLWriterFunc XMLWriter, void* context, u
 static void XMLWriteUnifiedDescriptions(XMLWriterFunc XMLWriter, void* context, uint8_t level, AJ_DescriptionLookupFunc descLookup, uint32_t descId)
 {
     size_t idx;
-    for (idx = 0; languageList[idx] != NULL; idx++) {
-        const char* description = GetDescription(descLookup, descId, languageList[idx]);
+    for (idx = 0; introspectState->languageList[idx] != NULL; idx++) {
+        const char* description = GetDescription(descLookup, descId, introspectState->languageList[idx]);
         if (description != NULL) {
-            XMLWriteUnifiedDescription(XMLWriter, context, level, description, languageList[idx]);
+            XMLWriteUnifiedDescription(XMLWriter, context, level, description, introspectState->languageList[idx]);
         }
     }
 }
@@ -564,7 +638,7 @@ static uint32_t SecurityApplies(const char* ifc, const AJ_Object* obj)
 #define MAX_LANG_SIZE 63
 static const char* GetBestLanguage(const char* requested)
 {
-    if ((requested != NULL) && (*requested != 0) && (languageList != NULL)) {
+    if ((requested != NULL) && (*requested != 0) && (introspectState->languageList != NULL)) {
         char languageToCheck[MAX_LANG_SIZE + 1];
         strncpy(languageToCheck, requested, MAX_LANG_SIZE);
         languageToCheck[MAX_LANG_SIZE] = '\0';
@@ -572,9 +646,9 @@ static const char* GetBestLanguage(const char* requested)
             // Look for a supported language matching the language to check.
             size_t idx;
             char* pos;
-            for (idx = 0; languageList[idx] != NULL; idx++) {
-                if (strcasecmp(languageList[idx], languageToCheck) == 0) {
-                    return languageList[idx];
+            for (idx = 0; introspectState->languageList[idx] != NULL; idx++) {
+                if (strcasecmp(introspectState->languageList[idx], languageToCheck) == 0) {
+                    return introspectState->languageList[idx];
                 }
             }
 
@@ -588,7 +662,7 @@ static const char* GetBestLanguage(const char* requested)
     }
 
     // No match found, so return the default language.
-    return (languageList != NULL) ? languageList[0] : NULL;
+    return (introspectState->languageList != NULL) ? introspectState->languageList[0] : NULL;
 }
 
 static AJ_Status GenXML(XMLWriterFunc XMLWriter, void* context, const AJ_ObjectIterator* objIter, const AJ_Object* virtualObject, const char* languageTag)
@@ -601,7 +675,7 @@ static AJ_Status GenXML(XMLWriterFunc XMLWriter, void* context, const AJ_ObjectI
     if (objIter == NULL) {
         obj = virtualObject;
     } else {
-        if (objIter->l >= ArraySize(objectLists)) {
+        if (objIter->l >= ArraySize(introspectState->objectLists)) {
             if (virtualObject == NULL) {
                 return AJ_OK;
             } else {
@@ -610,7 +684,7 @@ static AJ_Status GenXML(XMLWriterFunc XMLWriter, void* context, const AJ_ObjectI
             }
         }
 
-        obj = &(objectLists[objIter->l][objIter->n - 1]);
+        obj = &(introspectState->objectLists[objIter->l][objIter->n - 1]);
     }
     if (obj != NULL && obj->path != NULL) {
         AJ_ObjectIterator childObjectIter;
@@ -627,7 +701,7 @@ static AJ_Status GenXML(XMLWriterFunc XMLWriter, void* context, const AJ_ObjectI
          * Find matching description lookup function.
          */
         if (objIter != NULL) {
-            descLookup = descriptionLookups[objIter->l];
+            descLookup = introspectState->descriptionLookups[objIter->l];
         }
         if (!unifiedFormat) {
             languageTag = GetBestLanguage(languageTag);
@@ -677,7 +751,7 @@ static AJ_Status GenXML(XMLWriterFunc XMLWriter, void* context, const AJ_ObjectI
                     uint8_t descriptionAvailable = FALSE;
                     uint32_t descId = (childObjectIter.n - 1) << 24;
                     if (childObjectIter.l < AJ_MAX_OBJECT_LISTS) {
-                        descLookup = descriptionLookups[childObjectIter.l];
+                        descLookup = introspectState->descriptionLookups[childObjectIter.l];
                     } else {
                         descLookup = NULL;
                     }
@@ -798,6 +872,102 @@ void WriteXML(void* context, const char* str, uint32_t len)
     }
 }
 
+#if AJ_INTROSPECT_CACHE_SIZE
+typedef struct _BufferContext {
+    char* buf;
+    uint32_t len;
+    uint32_t size;
+} BufferContext;
+
+static void BufferXML(void* context, const char* str, uint32_t len)
+{
+    BufferContext* bctx = (BufferContext*)context;
+    if (!len) {
+        len = (uint32_t)strlen(str);
+    }
+    if ((bctx->len + len) <= bctx->size) {
+        memcpy(bctx->buf + bctx->len, str, len);
+    }
+    bctx->len += len;
+}
+
+static void FlushIntrospectCache(AJ_IntrospectState* state)
+{
+    uint16_t i;
+
+    for (i = 0; i < AJ_INTROSPECT_CACHE_SIZE; ++i) {
+        if (state->introspectCache[i].path) {
+            AJ_Free(state->introspectCache[i].xml);
+            state->introspectCache[i].path = NULL;
+        }
+    }
+    state->introspectCacheNext = 0;
+}
+
+static const IntrospectCacheEntry* FindIntrospectCache(const char* path, const char* languageTag)
+{
+    uint8_t unified = (languageTag == NULL) ? TRUE : FALSE;
+    const char* language = unified ? NULL : GetBestLanguage(languageTag);
+    uint16_t i;
+
+    for (i = 0; i < AJ_INTROSPECT_CACHE_SIZE; ++i) {
+        const IntrospectCacheEntry* entry = &introspectState->introspectCache[i];
+        if (entry->path && (entry->unified == unified) && (entry->language == language) && (strcmp(entry->path, path) == 0)) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Generates the XML for an object and adds it to the cache, replacing the oldest entry if the cache
+ * is full. Returns NULL if the XML could not be generated or there was not enough memory to cache it
+ * in which case the caller falls back to marshaling the XML as it is generated.
+ */
+static const IntrospectCacheEntry* AddIntrospectCache(const char* path, const char* languageTag, const AJ_ObjectIterator* objIter, const AJ_Object* virtualObject)
+{
+    IntrospectCacheEntry* entry;
+    BufferContext context;
+    size_t pathLen = strlen(path) + 1;
+    uint32_t len = 0;
+
+    if (GenXML(SizeXML, &len, objIter, virtualObject, languageTag) != AJ_OK) {
+        return NULL;
+    }
+    context.buf = (char*)AJ_Malloc(pathLen + len + 1);
+    if (!context.buf) {
+        AJ_WarnPrintf(("AddIntrospectCache(): Not enough memory to cache %u bytes of XML\n", len));
+        return NULL;
+    }
+    context.len = 0;
+    context.size = len;
+    if ((GenXML(BufferXML, &context, objIter, virtualObject, languageTag) != AJ_OK) || (context.len != len)) {
+        AJ_Free(context.buf);
+        return NULL;
+    }
+    context.buf[len] = '\0';
+    entry = &introspectState->introspectCache[introspectState->introspectCacheNext];
+    introspectState->introspectCacheNext = (introspectState->introspectCacheNext + 1) % AJ_INTROSPECT_CACHE_SIZE;
+    if (entry->path) {
+        AJ_Free(entry->xml);
+    }
+    entry->xml = context.buf;
+    entry->len = len;
+    entry->path = context.buf + len + 1;
+    memcpy(entry->path, path, pathLen);
+    entry->unified = (languageTag == NULL) ? TRUE : FALSE;
+    entry->language = entry->unified ? NULL : GetBestLanguage(languageTag);
+    return entry;
+}
+#else
+#define FlushIntrospectCache(state)
+#endif
+
+void AJ_IntrospectInvalidateCache(void)
+{
+    FlushIntrospectCache(introspectState);
+}
+
 AJ_Status AJ_HandleIntrospectRequestInternal(const AJ_Message* msg, AJ_Message* reply, const char* languageTag)
 {
     AJ_Status status = AJ_OK;
@@ -838,6 +1008,31 @@ AJ_Status AJ_HandleIntrospectRequestInternal(const AJ_Message* msg, AJ_Message*
         obj = AJ_NextObject(&objIter);
     }
     if (obj != NULL && obj->path != NULL) {
+#if AJ_INTROSPECT_CACHE_SIZE
+        const IntrospectCacheEntry* entry = FindIntrospectCache(msg->objPath, languageTag);
+        if (!entry) {
+            if (children > 0) {
+                entry = AddIntrospectCache(msg->objPath, languageTag, NULL, &virtualObject);
+            } else {
+                entry = AddIntrospectCache(msg->objPath, languageTag, &objIter, NULL);
+            }
+        }
+        if (entry) {
+            AJ_InfoPrintf(("AJ_HandleIntrospectRequest() %d bytes of cached XML\n", entry->len));
+            AJ_MarshalReplyMsg(msg, reply);
+            status = AJ_DeliverMsgPartial(reply, entry->len + 5);
+            if (status == AJ_OK) {
+                status = AJ_MarshalRaw(reply, &entry->len, 4);
+            }
+            /*
+             * The cached XML includes the terminating NUL
+             */
+            if (status == AJ_OK) {
+                status = AJ_MarshalRaw(reply, entry->xml, entry->len + 1);
+            }
+            return status;
+        }
+#endif
         /*
          * First pass computes the size of the XML string
          */
@@ -915,7 +1110,7 @@ AJ_Status AJ_HandleGetDescriptionLanguages(const AJ_Message* msg, AJ_Message* re
         status = AJ_MarshalContainer(reply, &languageListArray, AJ_ARG_ARRAY);
     }
     if (status == AJ_OK) {
-        languageTag = languageList;
+        languageTag = introspectState->languageList;
 
         while ((NULL != *languageTag) && status == AJ_OK) {
             status = AJ_MarshalArgs(reply, "s", *languageTag);
@@ -1097,13 +1292,13 @@ static uint8_t inline MatchPath(const char* path, AJ_Message* msg) {
     return strcmp(path, msg->objPath) == 0;
 }
 
-AJ_Status AJ_LookupMessageId(AJ_Message* msg, uint8_t* secure)
+static AJ_Status LinearLookupMessageId(AJ_Message* msg, uint8_t* secure)
 {
     uint8_t oIndex = 0;
 
-    for (oIndex = 0; oIndex < ArraySize(objectLists); ++oIndex) {
+    for (oIndex = 0; oIndex < ArraySize(introspectState->objectLists); ++oIndex) {
         uint8_t pIndex = 0;
-        const AJ_Object* obj = objectLists[oIndex];
+        const AJ_Object* obj = introspectState->objectLists[oIndex];
         if (!obj) {
             continue;
         }
@@ -1139,6 +1334,196 @@ AJ_Status AJ_LookupMessageId(AJ_Message* msg, uint8_t* secure)
     return AJ_ERR_NO_MATCH;
 }
 
+#if AJ_MSGID_INDEX_SIZE
+#define MSGID_INDEX_INVALID   0  /* Index must be rebuilt before it can be used */
+#define MSGID_INDEX_VALID     1  /* Index is up to date */
+#define MSGID_INDEX_OVERFLOW  2  /* Too many members to index - use the linear scan */
+
+#define FNV_OFFSET_BASIS  2166136261UL
+#define FNV_PRIME         16777619UL
+
+/*
+ * FNV-1a hash of a string terminated by a nul or the term character. A separator is mixed in so
+ * that the concatenation of consecutive strings cannot alias.
+ */
+static uint32_t HashStr(uint32_t hash, const char* str, char term)
+{
+    while (*str && (*str != term)) {
+        hash = (hash ^ (uint8_t)*str++) * FNV_PRIME;
+    }
+    return (hash ^ 0xFF) * FNV_PRIME;
+}
+
+static uint32_t MsgIdHash(const char* path, const char* iface, const char* member, uint8_t memberType)
+{
+    uint32_t hash = HashStr(FNV_OFFSET_BASIS, path, '\0');
+    hash = HashStr(hash, iface, '\0');
+    hash = HashStr(hash, member, SEPARATOR);
+    return (hash ^ memberType) * FNV_PRIME;
+}
+
+static void InvalidateMsgIdIndex(void)
+{
+    introspectState->msgIdIndexState = MSGID_INDEX_INVALID;
+}
+
+static void BuildMsgIdIndex(void)
+{
+    uint8_t oIndex;
+    uint32_t count = 0;
+
+    memset(introspectState->msgIdIndex, 0xFF, sizeof(introspectState->msgIdIndex));
+    introspectState->msgIdIndexState = MSGID_INDEX_VALID;
+
+    for (oIndex = 0; oIndex < ArraySize(introspectState->objectLists); ++oIndex) {
+        uint8_t pIndex = 0;
+        const AJ_Object* obj = introspectState->objectLists[oIndex];
+        if (!obj) {
+            continue;
+        }
+        for (; obj->path; ++pIndex, ++obj) {
+            uint8_t iIndex;
+            if (!obj->interfaces) {
+                continue;
+            }
+            for (iIndex = 0; obj->interfaces[iIndex]; ++iIndex) {
+                AJ_InterfaceDescription desc = obj->interfaces[iIndex];
+                const char* iface = *desc;
+                uint8_t first;
+                uint8_t mIndex;
+                uint8_t secure;
+
+                if ((*iface == SECURE_TRUE) || (*iface == SECURE_OFF)) {
+                    ++iface;
+                }
+                /*
+                 * FindInterface() only ever matches the first instance of an interface on an object
+                 */
+                FindInterface(obj->interfaces, iface, &first);
+                if (first != iIndex) {
+                    continue;
+                }
+                secure = SecurityApplies(*desc, obj);
+                for (mIndex = 0; desc[mIndex + 1]; ++mIndex) {
+                    const char* member = desc[mIndex + 1];
+                    uint8_t memberType = MEMBER_TYPE(*member++);
+                    uint32_t slot;
+                    uint32_t hash;
+
+                    if ((memberType != METHOD) && (memberType != SIGNAL)) {
+                        continue;
+                    }
+                    if ((memberType == SIGNAL) && IS_SESSIONLESS(*member)) {
+                        ++member;
+                    }
+                    /*
+                     * Always leave one free slot so that probing terminates
+                     */
+                    if (++count >= AJ_MSGID_INDEX_SIZE) {
+                        AJ_WarnPrintf(("BuildMsgIdIndex(): AJ_MSGID_INDEX_SIZE too small - using linear lookup\n"));
+                        introspectState->msgIdIndexState = MSGID_INDEX_OVERFLOW;
+                        return;
+                    }
+                    /*
+                     * Index wildcard objects under the single character key MatchPath() matches on
+                     */
+                    if (((*obj->path == '?') && (memberType == METHOD)) || ((*obj->path == '!') && (memberType == SIGNAL))) {
+                        hash = MsgIdHash((memberType == METHOD) ? "?" : "!", iface, member, memberType);
+                    } else {
+                        hash = MsgIdHash(obj->path, iface, member, memberType);
+                    }
+                    slot = hash % AJ_MSGID_INDEX_SIZE;
+                    while (introspectState->msgIdIndex[slot].msgId != AJ_INVALID_MSG_ID) {
+                        slot = (slot + 1) % AJ_MSGID_INDEX_SIZE;
+                    }
+                    introspectState->msgIdIndex[slot].hash = hash;
+                    introspectState->msgIdIndex[slot].msgId = (oIndex << 24) | (pIndex << 16) | (iIndex << 8) | mIndex;
+                    introspectState->msgIdIndex[slot].secure = secure;
+                }
+            }
+        }
+    }
+}
+
+/*
+ * Returns the lowest message id indexed under the path that matches the message, or best if there
+ * is no lower one. Lower message ids are the ones the linear scan would have found first.
+ */
+static const MsgIdIndexEntry* ProbeMsgIdIndex(const char* path, AJ_Message* msg, uint8_t memberType, const MsgIdIndexEntry* best)
+{
+    uint32_t hash = MsgIdHash(path, msg->iface, msg->member, memberType);
+    uint32_t slot = hash % AJ_MSGID_INDEX_SIZE;
+
+    while (introspectState->msgIdIndex[slot].msgId != AJ_INVALID_MSG_ID) {
+        const MsgIdIndexEntry* entry = &introspectState->msgIdIndex[slot];
+        if ((entry->hash == hash) && (!best || (entry->msgId < best->msgId))) {
+            const AJ_Object* obj = &introspectState->objectLists[entry->msgId >> 24][(uint8_t)(entry->msgId >> 16)];
+            AJ_InterfaceDescription desc = obj->interfaces[(uint8_t)(entry->msgId >> 8)];
+            const char* iface = *desc;
+
+            if ((*iface == SECURE_TRUE) || (*iface == SECURE_OFF)) {
+                ++iface;
+            }
+            /*
+             * Verify the hit, this rules out hash collisions and skips disabled objects
+             */
+            if (!(obj->flags & AJ_OBJ_FLAG_DISABLED) && MatchPath(obj->path, msg) && (strcmp(iface, msg->iface) == 0) && MatchMember(desc[(uint8_t)entry->msgId + 1], msg)) {
+                best = entry;
+            }
+        }
+        slot = (slot + 1) % AJ_MSGID_INDEX_SIZE;
+    }
+    return best;
+}
+
+static AJ_Status IndexLookupMessageId(AJ_Message* msg, uint8_t* secure)
+{
+    uint8_t memberType = (msg->hdr->msgType == AJ_MSG_METHOD_CALL) ? METHOD : SIGNAL;
+    const MsgIdIndexEntry* entry;
+
+    /*
+     * Members of objects with a wildcard path are indexed under the wildcard
+     */
+    entry = ProbeMsgIdIndex(msg->objPath, msg, memberType, NULL);
+    entry = ProbeMsgIdIndex((memberType == METHOD) ? "?" : "!", msg, memberType, entry);
+    if (entry) {
+        const AJ_Object* obj = &introspectState->objectLists[entry->msgId >> 24][(uint8_t)(entry->msgId >> 16)];
+        AJ_InterfaceDescription desc = obj->interfaces[(uint8_t)(entry->msgId >> 8)];
+
+        *secure = entry->secure;
+        msg->msgId = entry->msgId;
+        AJ_InfoPrintf(("Identified message %x\n", msg->msgId));
+        return CheckSignature(desc[(uint8_t)entry->msgId + 1], msg);
+    }
+    AJ_ErrPrintf(("LookupMessageId(): AJ_ERR_NO_MATCH\n"));
+    return AJ_ERR_NO_MATCH;
+}
+#else
+#define InvalidateMsgIdIndex()
+#endif
+
+void AJ_EnableMessageIdIndex(uint8_t enable)
+{
+#if AJ_MSGID_INDEX_SIZE
+    introspectState->msgIdIndexDisabled = !enable;
+#endif
+}
+
+AJ_Status AJ_LookupMessageId(AJ_Message* msg, uint8_t* secure)
+{
+#if AJ_MSGID_INDEX_SIZE
+    if (!introspectState->msgIdIndexDisabled) {
+        if (introspectState->msgIdIndexState == MSGID_INDEX_INVALID) {
+            BuildMsgIdIndex();
+        }
+        if (introspectState->msgIdIndexState == MSGID_INDEX_VALID) {
+            return IndexLookupMessageId(msg, secure);
+        }
+    }
+#endif
+    return LinearLookupMessageId(msg, secure);
+}
+
 /*
  * Validates an index into a NULL terminated array
  */
@@ -1166,11 +1551,11 @@ static AJ_Status UnpackMsgId(uint32_t msgId, const char** objPath, const char**
     const AJ_Object* obj;
     AJ_InterfaceDescription ifc;
 
-    if ((oIndex >= ArraySize(objectLists)) || !CheckIndex(objectLists[oIndex], pIndex, sizeof(AJ_Object))) {
+    if ((oIndex >= ArraySize(introspectState->objectLists)) || !CheckIndex(introspectState->objectLists[oIndex], pIndex, sizeof(AJ_Object))) {
         AJ_ErrPrintf(("UnpackMsgId(): AJ_ERR_INVALID\n"));
         return AJ_ERR_INVALID;
     }
-    obj = &objectLists[oIndex][pIndex];
+    obj = &introspectState->objectLists[oIndex][pIndex];
     if (!CheckIndex(obj->interfaces, iIndex, sizeof(AJ_InterfaceDescription))) {
         AJ_ErrPrintf(("UnpackMsgId(): AJ_ERR_INVALID\n"));
         return AJ_ERR_INVALID;
@@ -1211,6 +1596,29 @@ static AJ_Status UnpackMsgId(uint32_t msgId, const char** objPath, const char**
     return AJ_OK;
 }
 
+uint8_t AJ_StreamedMessageAllowed(const AJ_Message* msg)
+{
+    uint8_t oIndex = (msg->msgId >> 24);
+    uint8_t pIndex = (msg->msgId >> 16);
+    uint8_t iIndex = (msg->msgId >> 8);
+    const AJ_Object* obj;
+
+    if ((msg->hdr->msgType != AJ_MSG_METHOD_CALL) && (msg->hdr->msgType != AJ_MSG_SIGNAL)) {
+        return FALSE;
+    }
+    if ((oIndex != AJ_APP_ID_FLAG) || !CheckIndex(introspectState->objectLists[oIndex], pIndex, sizeof(AJ_Object))) {
+        return FALSE;
+    }
+    obj = &introspectState->objectLists[oIndex][pIndex];
+    if (!(obj->flags & AJ_OBJ_FLAG_STREAMED) || !CheckIndex(obj->interfaces, iIndex, sizeof(AJ_InterfaceDescription))) {
+        return FALSE;
+    }
+    /*
+     * Property get and set calls are handled by the built-in property code
+     */
+    return (obj->interfaces[iIndex] != AJ_PropertiesIface);
+}
+
 AJ_Status AJ_MarshalPropertyArgs(AJ_Message* msg, uint32_t propId)
 {
     AJ_Status status;
@@ -1270,12 +1678,12 @@ AJ_Status AJ_InitMessageFromMsgId(AJ_Message* msg, uint32_t msgId, uint8_t msgTy
 {
     /*
      * Static buffer for holding the signature for the message currently being marshaled. Since this
-     * implementation can only marshal one message at a time we only need one of these buffers. The
-     * size of the buffer dictates the maximum size signature we can marshal. The wire protocol
-     * allows up to 255 characters in a signature but that would represent an outgrageously complex
-     * message argument list.
+     * implementation can only marshal one message at a time on a thread we only need one of these
+     * buffers per thread. The size of the buffer dictates the maximum size signature we can marshal.
+     * The wire protocol allows up to 255 characters in a signature but that would represent an
+     * outgrageously complex message argument list.
      */
-    static char msgSignature[64];
+    static AJ_THREAD_LOCAL char msgSignature[64];
     AJ_Status status = AJ_OK;
 
 #if defined(GTEST_ENABLED) || defined(AJ_DEBUG_BUILD)
@@ -1369,16 +1777,121 @@ static AJ_Status CheckReturnSignature(AJ_Message* msg, uint32_t msgId)
     return status;
 }
 
-static ReplyContext* FindReplyContext(uint32_t serial) {
-    size_t i;
-    for (i = 0; i < ArraySize(replyContexts); ++i) {
-        if (replyContexts[i].serial == serial) {
-            return &replyContexts[i];
+static uint32_t ReplyHashSlot(uint32_t serial)
+{
+    return (serial * 2654435761UL) % REPLY_HASH_SIZE;
+}
+
+static ReplyContext* FindReplyContext(uint32_t serial)
+{
+    uint32_t slot = ReplyHashSlot(serial);
+
+    while (introspectState->replyHash[slot]) {
+        ReplyContext* repCtx = &introspectState->replyContexts[introspectState->replyHash[slot] - 1];
+        if (repCtx->serial == serial) {
+            return repCtx;
         }
+        slot = (slot + 1) % REPLY_HASH_SIZE;
     }
     return NULL;
 }
 
+static void ReplyHashRemove(const ReplyContext* repCtx)
+{
+    uint32_t slot = ReplyHashSlot(repCtx->serial);
+    uint32_t next;
+
+    while (&introspectState->replyContexts[introspectState->replyHash[slot] - 1] != repCtx) {
+        slot = (slot + 1) % REPLY_HASH_SIZE;
+    }
+    /*
+     * Backward shift deletion - move up any entry that would no longer be reachable from its home
+     * slot once this slot is emptied.
+     */
+    for (next = (slot + 1) % REPLY_HASH_SIZE; introspectState->replyHash[next]; next = (next + 1) % REPLY_HASH_SIZE) {
+        uint32_t home = ReplyHashSlot(introspectState->replyContexts[introspectState->replyHash[next] - 1].serial);
+        if ((next > slot) ? ((home <= slot) || (home > next)) : ((home <= slot) && (home > next))) {
+            introspectState->replyHash[slot] = introspectState->replyHash[next];
+            slot = next;
+        }
+    }
+    introspectState->replyHash[slot] = 0;
+}
+
+static uint8_t DeadlineBefore(uint16_t a, uint16_t b)
+{
+    return (int32_t)(introspectState->replyContexts[a].deadline - introspectState->replyContexts[b].deadline) < 0;
+}
+
+static void HeapSet(uint16_t pos, uint16_t idx)
+{
+    introspectState->replyHeap[pos] = idx;
+    introspectState->replyContexts[idx].heapPos = pos;
+}
+
+static void HeapSiftUp(uint16_t pos)
+{
+    uint16_t idx = introspectState->replyHeap[pos];
+
+    while (pos) {
+        uint16_t parent = (pos - 1) / 2;
+        if (!DeadlineBefore(idx, introspectState->replyHeap[parent])) {
+            break;
+        }
+        HeapSet(pos, introspectState->replyHeap[parent]);
+        pos = parent;
+    }
+    HeapSet(pos, idx);
+}
+
+static void HeapSiftDown(uint16_t pos)
+{
+    uint16_t idx = introspectState->replyHeap[pos];
+
+    while (TRUE) {
+        uint16_t child = 2 * pos + 1;
+        if (child >= introspectState->replyHeapSize) {
+            break;
+        }
+        if (((child + 1) < introspectState->replyHeapSize) && DeadlineBefore(introspectState->replyHeap[child + 1], introspectState->replyHeap[child])) {
+            ++child;
+        }
+        if (!DeadlineBefore(introspectState->replyHeap[child], idx)) {
+            break;
+        }
+        HeapSet(pos, introspectState->replyHeap[child]);
+        pos = child;
+    }
+    HeapSet(pos, idx);
+}
+
+static void HeapRemove(ReplyContext* repCtx)
+{
+    uint16_t pos = repCtx->heapPos;
+
+    if (pos == NO_REPLY_CONTEXT) {
+        return;
+    }
+    repCtx->heapPos = NO_REPLY_CONTEXT;
+    if (pos < --introspectState->replyHeapSize) {
+        HeapSet(pos, introspectState->replyHeap[introspectState->replyHeapSize]);
+        if (pos && DeadlineBefore(introspectState->replyHeap[pos], introspectState->replyHeap[(pos - 1) / 2])) {
+            HeapSiftUp(pos);
+        } else {
+            HeapSiftDown(pos);
+        }
+    }
+}
+
+static void FreeReplyContext(ReplyContext* repCtx)
+{
+    HeapRemove(repCtx);
+    ReplyHashRemove(repCtx);
+    repCtx->serial = 0;
+    repCtx->handler = NULL;
+    introspectState->replyFree[introspectState->replyFreeCount++] = (uint16_t)(repCtx - introspectState->replyContexts);
+}
+
 AJ_Status AJ_IdentifyProperty(AJ_Message* msg, const char* iface, const char* prop, uint32_t* propId, const char** sigPtr, uint8_t* secure)
 {
     AJ_Status status = AJ_OK;
@@ -1389,13 +1902,13 @@ AJ_Status AJ_IdentifyProperty(AJ_Message* msg, const char* iface, const char* pr
     AJ_InterfaceDescription desc;
 
 #ifdef AJ_DEBUG_BUILD
-    if ((oIndex >= ArraySize(objectLists)) || !CheckIndex(objectLists[oIndex], pIndex, sizeof(AJ_Object))) {
+    if ((oIndex >= ArraySize(introspectState->objectLists)) || !CheckIndex(introspectState->objectLists[oIndex], pIndex, sizeof(AJ_Object))) {
         status = AJ_ERR_INVALID;
         AJ_ErrPrintf(("AJ_IdentifyProperty(): %s\n", AJ_StatusText(status)));
         return status;
     }
 #endif
-    obj = &objectLists[oIndex][pIndex];
+    obj = &introspectState->objectLists[oIndex][pIndex];
 
     *propId = AJ_INVALID_PROP_ID;
 
@@ -1474,7 +1987,7 @@ AJ_Status AJ_MarshalAllPropertiesArgs(AJ_Message* replyMsg, const char* iface, A
     uint8_t oIndex = (replyMsg->msgId >> 24) & ~AJ_REP_ID_FLAG;
     uint8_t pIndex = replyMsg->msgId >> 16;
     uint8_t iIndex;
-    const AJ_Object* obj = &objectLists[oIndex][pIndex];
+    const AJ_Object* obj = &introspectState->objectLists[oIndex][pIndex];
     uint8_t secure = SecurityApplies(iface, obj);
     AJ_InterfaceDescription desc;
     AJ_Arg array;
@@ -1627,9 +2140,13 @@ AJ_Status AJ_IdentifyMessage(AJ_Message* msg)
             }
 
             /*
-             * Release the reply context
+             * Release the reply context unless there is a reply handler in which case the context
+             * is released when the handler is called. If the reply was rejected the context is
+             * kept so the handler will get a timeout error.
              */
-            repCtx->serial = 0;
+            if (!repCtx->handler) {
+                FreeReplyContext(repCtx);
+            }
         }
     }
     return status;
@@ -1637,9 +2154,12 @@ AJ_Status AJ_IdentifyMessage(AJ_Message* msg)
 
 void AJ_RegisterObjects(const AJ_Object* localObjects, const AJ_Object* proxyObjects)
 {
-    AJ_ASSERT(AJ_PRX_ID_FLAG < ArraySize(objectLists));
-    objectLists[AJ_APP_ID_FLAG] = localObjects;
-    objectLists[AJ_PRX_ID_FLAG] = proxyObjects;
+    AJ_ASSERT(AJ_PRX_ID_FLAG < ArraySize(introspectState->objectLists));
+    introspectState->objectLists[AJ_APP_ID_FLAG] = localObjects;
+    introspectState->objectLists[AJ_PRX_ID_FLAG] = proxyObjects;
+    InvalidateMsgIdIndex();
+    FlushIntrospectCache(introspectState);
+    AJ_AboutInvalidateCache();
 }
 
 AJ_Status AJ_RegisterObjectsACL()
@@ -1648,7 +2168,7 @@ AJ_Status AJ_RegisterObjectsACL()
 
     int i;
     for (i = 0; i < AJ_MAX_OBJECT_LISTS; i++) {
-        status = AJ_AuthorisationRegister(objectLists[i], i);
+        status = AJ_AuthorisationRegister(introspectState->objectLists[i], i);
         if (AJ_OK != status) {
             AJ_WarnPrintf(("AJ_RegisterObjectsACL(): index(%d) %s\n", i, AJ_StatusText(status)));
             return status;
@@ -1658,16 +2178,20 @@ AJ_Status AJ_RegisterObjectsACL()
 }
 
 void AJ_RegisterDescriptionLanguages(const char* const* languages) {
-    languageList = languages;
+    introspectState->languageList = languages;
+    FlushIntrospectCache(introspectState);
 }
 
 AJ_Status AJ_RegisterObjectListWithDescriptions(const AJ_Object* objList, uint8_t idx, AJ_DescriptionLookupFunc descLookup)
 {
-    if (idx >= ArraySize(objectLists)) {
+    if (idx >= ArraySize(introspectState->objectLists)) {
         return AJ_ERR_RANGE;
     }
-    objectLists[idx] = objList;
-    descriptionLookups[idx] = descLookup;
+    introspectState->objectLists[idx] = objList;
+    introspectState->descriptionLookups[idx] = descLookup;
+    InvalidateMsgIdIndex();
+    FlushIntrospectCache(introspectState);
+    AJ_AboutInvalidateCache();
     return AJ_AuthorisationRegister(objList, idx);
 }
 
@@ -1682,7 +2206,7 @@ AJ_Status AJ_SetProxyObjectPath(AJ_Object* proxyObjects, uint32_t msgId, const c
     uint8_t oIndex = (msgId >> 24);
     uint8_t pIndex = (msgId >> 16);
 
-    if ((oIndex != AJ_PRX_ID_FLAG) || (proxyObjects != objectLists[oIndex])) {
+    if ((oIndex != AJ_PRX_ID_FLAG) || (proxyObjects != introspectState->objectLists[oIndex])) {
         AJ_ErrPrintf(("AJ_SetProxyObjectPath(): AJ_ERR_UNKNOWN\n"));
         return AJ_ERR_UNKNOWN;
     }
@@ -1693,6 +2217,8 @@ AJ_Status AJ_SetProxyObjectPath(AJ_Object* proxyObjects, uint32_t msgId, const c
         }
     }
     proxyObjects[pIndex].path = objPath;
+    InvalidateMsgIdIndex();
+    FlushIntrospectCache(introspectState);
     return AJ_OK;
 }
 
@@ -1704,18 +2230,43 @@ AJ_Status AJ_AllocReplyContext(AJ_Message* msg, uint32_t timeout)
          */
         return AJ_OK;
     } else {
-        ReplyContext* repCtx = FindReplyContext(0);
+        ReplyContext* repCtx = NULL;
 
         AJ_ASSERT(msg->hdr->msgType == AJ_MSG_METHOD_CALL);
 
+        if (introspectState->replyFreeCount) {
+            repCtx = &introspectState->replyContexts[introspectState->replyFree[--introspectState->replyFreeCount]];
+        } else if (introspectState->replyHighWater < ArraySize(introspectState->replyContexts)) {
+            repCtx = &introspectState->replyContexts[introspectState->replyHighWater++];
+        }
         if (repCtx) {
             AJ_Status status;
             const char* unique;
+            uint32_t slot;
 
+            /*
+             * Deadlines are relative to an epoch that is reset whenever there are no calls pending
+             */
+            if (!introspectState->replyHeapSize) {
+                AJ_InitTimer(&introspectState->replyEpoch);
+            }
+            timeout = timeout ? timeout : AJ_DEFAULT_REPLY_TIMEOUT;
+            if (timeout > MAX_REPLY_TIMEOUT) {
+                timeout = MAX_REPLY_TIMEOUT;
+            }
             repCtx->serial = msg->hdr->serialNum;
             repCtx->messageId = msg->msgId;
-            repCtx->timeout = timeout ? timeout : AJ_DEFAULT_REPLY_TIMEOUT;
-            AJ_InitTimer(&repCtx->callTime);
+            repCtx->deadline = AJ_GetElapsedTime(&introspectState->replyEpoch, TRUE) + timeout;
+            repCtx->handler = NULL;
+            repCtx->context = NULL;
+
+            slot = ReplyHashSlot(repCtx->serial);
+            while (introspectState->replyHash[slot]) {
+                slot = (slot + 1) % REPLY_HASH_SIZE;
+            }
+            introspectState->replyHash[slot] = (uint16_t)(repCtx - introspectState->replyContexts) + 1;
+            introspectState->replyHeap[introspectState->replyHeapSize] = (uint16_t)(repCtx - introspectState->replyContexts);
+            HeapSiftUp(introspectState->replyHeapSize++);
 
             status = AJ_GetRemoteUniqueName(msg->destination, &unique);
             if (AJ_OK == status) {
@@ -1733,46 +2284,150 @@ AJ_Status AJ_AllocReplyContext(AJ_Message* msg, uint32_t timeout)
     }
 }
 
+AJ_Status AJ_SetReplyHandler(const AJ_Message* msg, AJ_ReplyHandler handler, void* context)
+{
+    ReplyContext* repCtx = NULL;
+
+    if (msg->hdr && (msg->hdr->msgType == AJ_MSG_METHOD_CALL)) {
+        repCtx = FindReplyContext(msg->hdr->serialNum);
+    }
+    if (!repCtx) {
+        AJ_ErrPrintf(("AJ_SetReplyHandler(): No reply context.  status=AJ_ERR_NO_MATCH\n"));
+        return AJ_ERR_NO_MATCH;
+    }
+    repCtx->handler = handler;
+    repCtx->context = context;
+    return AJ_OK;
+}
+
+uint8_t AJ_DispatchReplyHandler(AJ_Message* msg)
+{
+    if ((msg->hdr->msgType == AJ_MSG_METHOD_RET) || (msg->hdr->msgType == AJ_MSG_ERROR)) {
+        ReplyContext* repCtx = FindReplyContext(msg->replySerial);
+        if (repCtx && repCtx->handler) {
+            AJ_ReplyHandler handler = repCtx->handler;
+            void* context = repCtx->context;
+
+            FreeReplyContext(repCtx);
+            handler(msg, context);
+            AJ_CloseMsg(msg);
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
 void AJ_ReleaseReplyContext(AJ_Message* msg)
 {
     if (msg->hdr->msgType == AJ_MSG_METHOD_CALL) {
         ReplyContext* repCtx = FindReplyContext(msg->hdr->serialNum);
         if (repCtx) {
-            repCtx->serial = 0;
+            FreeReplyContext(repCtx);
         }
     }
 }
 
 uint8_t AJ_TimedOutMethodCall(AJ_Message* msg)
 {
-    ReplyContext* repCtx = replyContexts;
-    size_t i;
-    for (i = 0; i < ArraySize(replyContexts); ++i, ++repCtx) {
-        if (repCtx->serial && (AJ_GetElapsedTime(&repCtx->callTime, TRUE) > repCtx->timeout)) {
+    if (introspectState->replyHeapSize) {
+        ReplyContext* repCtx = &introspectState->replyContexts[introspectState->replyHeap[0]];
+        if ((int32_t)(AJ_GetElapsedTime(&introspectState->replyEpoch, TRUE) - repCtx->deadline) > 0) {
             /*
              * Set the reply serial and message id for the timeout error
              */
             msg->replySerial = repCtx->serial;
             msg->msgId = AJ_REPLY_ID(repCtx->messageId);
             /*
-             * Release the reply context
+             * Release the reply context, if there is a reply handler the context is released
+             * when the timeout error is dispatched to the handler.
              */
-            repCtx->serial = 0;
+            if (repCtx->handler) {
+                HeapRemove(repCtx);
+            } else {
+                FreeReplyContext(repCtx);
+            }
             return TRUE;
         }
     }
     return FALSE;
 }
 
-void AJ_ReleaseReplyContexts(void)
+uint16_t AJ_GetPendingReplyCount(void)
 {
-    memset(replyContexts, 0, sizeof(replyContexts));
+    return introspectState->replyHighWater - introspectState->replyFreeCount;
+}
+
+void AJ_ReleaseReplyContexts(AJ_BusAttachment* bus)
+{
+    uint16_t i;
+    /*
+     * The pending method calls are never going to complete so report them as timed-out
+     */
+    for (i = 0; i < introspectState->replyHighWater; ++i) {
+        ReplyContext* repCtx = &introspectState->replyContexts[i];
+        AJ_ReplyHandler handler = repCtx->handler;
+
+        if (repCtx->serial && handler) {
+            AJ_Message msg;
+
+            memset(&msg, 0, sizeof(msg));
+            msg.bus = bus;
+            msg.hdr = (AJ_MsgHeader*)&releasedErrorHdr;
+            msg.msgId = AJ_REPLY_ID(repCtx->messageId);
+            msg.replySerial = repCtx->serial;
+            msg.error = AJ_ErrTimeout;
+            msg.sender = AJ_GetUniqueName(bus);
+            msg.destination = msg.sender;
+            repCtx->handler = NULL;
+            handler(&msg, repCtx->context);
+        }
+    }
+    memset(introspectState->replyContexts, 0, sizeof(introspectState->replyContexts));
+    memset(introspectState->replyHash, 0, sizeof(introspectState->replyHash));
+    introspectState->replyHeapSize = 0;
+    introspectState->replyFreeCount = 0;
+    introspectState->replyHighWater = 0;
+}
+
+AJ_IntrospectState* AJ_IntrospectStateNew(void)
+{
+    AJ_IntrospectState* state = (AJ_IntrospectState*)AJ_Malloc(sizeof(AJ_IntrospectState));
+    if (state) {
+        memset(state, 0, sizeof(AJ_IntrospectState));
+        state->objectLists[0] = AJ_StandardObjects;
+    }
+    return state;
+}
+
+void AJ_IntrospectStateFree(AJ_IntrospectState* state)
+{
+    if (state) {
+        if (introspectState == state) {
+            introspectState = &defaultIntrospectState;
+        }
+        FlushIntrospectCache(state);
+        AJ_Free(state);
+    }
+}
+
+void AJ_IntrospectStateSelect(AJ_IntrospectState* state)
+{
+    if (!state) {
+        state = &defaultIntrospectState;
+    }
+    /*
+     * The announced objects come from the selected object lists
+     */
+    if (state != introspectState) {
+        introspectState = state;
+        AJ_AboutInvalidateCache();
+    }
 }
 
 AJ_Status AJ_SetObjectFlags(const char* objPath, uint8_t setFlags, uint8_t clearFlags)
 {
     AJ_Status status = AJ_ERR_NO_MATCH;
-    AJ_Object* list = (AJ_Object*)objectLists[AJ_APP_ID_FLAG];
+    AJ_Object* list = (AJ_Object*)introspectState->objectLists[AJ_APP_ID_FLAG];
     uint32_t secure = FALSE;
 
     if (list && objPath) {
@@ -1792,9 +2447,14 @@ AJ_Status AJ_SetObjectFlags(const char* objPath, uint8_t setFlags, uint8_t clear
             ++list;
         }
     }
+    if (status == AJ_OK) {
+        InvalidateMsgIdIndex();
+        FlushIntrospectCache(introspectState);
+        AJ_AboutInvalidateCache();
+    }
     if (secure) {
         /* Object became secure, register with the ACL */
-        status = AJ_AuthorisationRegister(objectLists[AJ_APP_ID_FLAG], AJ_APP_ID_FLAG);
+        status = AJ_AuthorisationRegister(introspectState->objectLists[AJ_APP_ID_FLAG], AJ_APP_ID_FLAG);
     }
     return status;
 }
@@ -1828,8 +2488,8 @@ const AJ_Object* AJ_InitObjectIterator(AJ_ObjectIterator* iter, uint8_t inFlags,
 
 const AJ_Object* AJ_NextObject(AJ_ObjectIterator* iter)
 {
-    while (iter->l < ArraySize(objectLists)) {
-        const AJ_Object* list = objectLists[iter->l];
+    while (iter->l < ArraySize(introspectState->objectLists)) {
+        const AJ_Object* list = introspectState->objectLists[iter->l];
 
         if (list) {
             while (list[iter->n].path) {
@@ -261,9 +261,96 @@ size_t AJ_GetTypeSize(char typeId)
  * Checks that the current message is closed
  */
 #ifdef AJ_DEBUG_BUILD
-static AJ_Message* currentMsg = NULL;
+static AJ_THREAD_LOCAL AJ_Message* currentMsg = NULL;
 #endif
 
+#if AJ_MSG_ARENA_SIZE
+/*
+ * A chunk of a message arena, the allocations follow the chunk header
+ */
+typedef struct _AJ_MsgArena {
+    struct _AJ_MsgArena* next;  /* Next chunk of the same message */
+    struct _AJ_MsgArena* live;  /* Next chunk of any open message on this thread */
+    uint32_t size;              /* Bytes available for allocations */
+    uint32_t used;              /* Bytes allocated so far */
+} AJ_MsgArena;
+
+/*
+ * Arena allocations are aligned for any scalar type
+ */
+#define ARENA_ALIGN(n)  (((n) + 7) & ~((size_t)7))
+
+/*
+ * All arena chunks of open messages on this thread, AJ_MsgArenaFree checks pointers against these
+ */
+static AJ_THREAD_LOCAL AJ_MsgArena* liveArenas = NULL;
+
+static void ReleaseArena(AJ_Message* msg)
+{
+    while (msg->arena) {
+        AJ_MsgArena* chunk = msg->arena;
+        AJ_MsgArena** live = &liveArenas;
+        while (*live != chunk) {
+            live = &(*live)->live;
+        }
+        *live = chunk->live;
+        msg->arena = chunk->next;
+        AJ_Free(chunk);
+    }
+}
+#endif
+
+void* AJ_MsgArenaAlloc(AJ_Message* msg, size_t size)
+{
+#if AJ_MSG_ARENA_SIZE
+    if (msg->useArena) {
+        AJ_MsgArena* chunk = msg->arena;
+        uint8_t* mem;
+
+        size = ARENA_ALIGN(size);
+        if (!chunk || (size > (chunk->size - chunk->used))) {
+            uint32_t sz = (uint32_t)max(size, ARENA_ALIGN(AJ_MSG_ARENA_SIZE));
+            chunk = (AJ_MsgArena*)AJ_Malloc(sizeof(AJ_MsgArena) + sz);
+            if (!chunk) {
+                AJ_WarnPrintf(("AJ_MsgArenaAlloc(): AJ_ERR_RESOURCES\n"));
+                return NULL;
+            }
+            chunk->size = sz;
+            chunk->used = 0;
+            chunk->live = liveArenas;
+            liveArenas = chunk;
+            /*
+             * Keep allocating from the current chunk if it has more room left than the new one
+             */
+            if (msg->arena && ((sz - size) < (msg->arena->size - msg->arena->used))) {
+                chunk->next = msg->arena->next;
+                msg->arena->next = chunk;
+            } else {
+                chunk->next = msg->arena;
+                msg->arena = chunk;
+            }
+        }
+        mem = (uint8_t*)(chunk + 1) + chunk->used;
+        chunk->used += (uint32_t)size;
+        return mem;
+    }
+#endif
+    return AJ_Malloc(size);
+}
+
+void AJ_MsgArenaFree(void* mem)
+{
+#if AJ_MSG_ARENA_SIZE
+    AJ_MsgArena* chunk;
+    for (chunk = liveArenas; chunk; chunk = chunk->live) {
+        if (((uint8_t*)mem > (uint8_t*)chunk) && ((uint8_t*)mem < ((uint8_t*)(chunk + 1) + chunk->size))) {
+            return;
+        }
+    }
+#endif
+    AJ_Free(mem);
+}
+
 static void InitArg(AJ_Arg* arg, uint8_t typeId, const void* val)
 {
     if (arg) {
@@ -459,11 +546,89 @@ static AJ_Status InitNonce(AJ_Message* msg, uint8_t role, uint8_t* nonce, uint32
     return AJ_OK;
 }
 
+static AJ_Status LoadBytes(AJ_IOBuffer* ioBuf, uint16_t numBytes, uint8_t pad, AJ_Message* msg);
+
+/*
+ * State for a message that is decrypted as it is loaded because it is too large for the receive
+ * buffer
+ */
+typedef struct _AJ_RxStream {
+    AJ_CCM_Stream ccm;          /* CCM state */
+    uint32_t encrypted;         /* Body bytes still to be decrypted */
+    AJ_SerialNum* incoming;     /* Incoming serial numbers for the sender or NULL */
+    uint32_t serialNum;         /* Serial number of the message */
+    uint8_t msgType;            /* Type of the message */
+    uint8_t tagLen;             /* Length of the authentication tag */
+    uint8_t tagLoaded;          /* Bytes of the authentication tag loaded so far */
+    uint8_t tag[MAC_LENGTH];    /* The authentication tag */
+} AJ_RxStream;
+
+/*
+ * Decrypt body bytes that have just been loaded into the receive buffer and collect the
+ * authentication tag that follows them.
+ */
+static void DecryptLoaded(AJ_Message* msg, uint8_t* data)
+{
+    AJ_RxStream* rx = msg->rxStream;
+    uint32_t len = (uint32_t)(msg->bus->sock.rx.writePtr - data);
+    uint32_t n = min(len, rx->encrypted);
+
+    if (n) {
+        AJ_CCM_Update(&rx->ccm, data, n);
+        rx->encrypted -= n;
+        data += n;
+        len -= n;
+    }
+    n = min(len, (uint32_t)(rx->tagLen - rx->tagLoaded));
+    if (n) {
+        memcpy(rx->tag + rx->tagLoaded, data, n);
+        rx->tagLoaded += (uint8_t)n;
+    }
+}
+
+/*
+ * Verify the authentication tag of a message that was decrypted as it was loaded
+ */
+static AJ_Status CloseRxStream(AJ_Message* msg, uint8_t complete)
+{
+    AJ_RxStream* rx = msg->rxStream;
+    AJ_Status status = AJ_ERR_SECURITY;
+
+    if (complete && !rx->encrypted && (rx->tagLoaded == rx->tagLen)) {
+        status = AJ_CCM_Final(&rx->ccm, rx->tag);
+        if ((AJ_OK == status) && rx->incoming) {
+            if ((AJ_MSG_METHOD_CALL == rx->msgType) || (AJ_MSG_SIGNAL == rx->msgType)) {
+                /* Methods and signals */
+                status = AJ_CheckIncomingSerial(rx->incoming, rx->serialNum);
+            }
+        }
+    }
+    if (AJ_OK != status) {
+        AJ_ErrPrintf(("CloseRxStream(): %s\n", AJ_StatusText(status)));
+    }
+    AJ_MemZeroSecure(rx, sizeof(AJ_RxStream));
+    AJ_Free(rx);
+    msg->rxStream = NULL;
+    return status;
+}
+
+/*
+ * Decrypt a received message. Messages that fit in the receive buffer are loaded and authenticated
+ * before they are returned to the application. Larger messages are decrypted as they are loaded and
+ * authenticated when they are closed, UnmarshalMsg() only lets these through to application objects
+ * that opted in with AJ_OBJ_FLAG_STREAMED. This is only possible if the nonce is known before the
+ * body is received, later authentication versions append part of the nonce to the message.
+ */
 static AJ_Status DecryptMessage(AJ_Message* msg)
 {
     AJ_IOBuffer* ioBuf = &msg->bus->sock.rx;
     AJ_Status status;
+#if AJ_AES_KEY_CACHE
+    const AJ_AES_Key* aesKey;
+#else
     uint8_t key[16];
+    AJ_AES_Key expanded;
+#endif
     uint8_t nonce[MAX_NONCE_LENGTH];
     uint8_t role = AJ_ROLE_KEY_UNDEFINED;
     uint32_t mlen = MessageLen(msg);
@@ -472,16 +637,24 @@ static AJ_Status DecryptMessage(AJ_Message* msg)
     uint32_t nonceLen;
     uint32_t extraNonceLen;
     uint32_t cryptoValsLen;
-    AJ_SerialNum* incoming;
+    AJ_SerialNum* incoming = NULL;
 
     /*
      * Use the group key for multicast and broadcast signals the session key otherwise.
      */
     if ((msg->hdr->msgType == AJ_MSG_SIGNAL) && !msg->destination) {
+#if AJ_AES_KEY_CACHE
+        status = AJ_GetGroupAesKey(msg->sender, &aesKey);
+#else
         status = AJ_GetGroupKey(msg->sender, key);
+#endif
         msg->authVersion = MIN_AUTH_FALLBACK_VERSION;
     } else {
+#if AJ_AES_KEY_CACHE
+        status = AJ_GetSessionAesKey(msg->sender, &aesKey, &role, &msg->authVersion);
+#else
         status = AJ_GetSessionKey(msg->sender, key, &role, &msg->authVersion);
+#endif
         /*
          * We use the oppsite role when decrypting.
          */
@@ -498,26 +671,97 @@ static AJ_Status DecryptMessage(AJ_Message* msg)
         extraNonceLen = nonceLen - PREVIOUS_NONCE_LENGTH;
         cryptoValsLen = macLen + extraNonceLen;
         AJ_InfoPrintf(("DecryptMessage(): \n"));
-        InitNonce(msg, role, nonce, sizeof(nonce), ioBuf->bufStart + mlen - extraNonceLen, extraNonceLen);
-        EndianSwap(msg, AJ_ARG_INT32, &msg->hdr->bodyLen, 3);
-        status = AJ_Decrypt_CCM(key, ioBuf->bufStart, mlen - cryptoValsLen, hLen, macLen, nonce, nonceLen);
-        EndianSwap(msg, AJ_ARG_INT32, &msg->hdr->bodyLen, 3);
-        if (AJ_OK == status) {
-            if ((AJ_MSG_METHOD_CALL == msg->hdr->msgType) || (AJ_MSG_SIGNAL == msg->hdr->msgType)) {
-                /* Methods and signals */
-                status = AJ_CheckIncomingSerial(incoming, msg->hdr->serialNum);
+        if ((mlen <= ioBuf->bufSize) || extraNonceLen) {
+            if (mlen > ioBuf->bufSize) {
+                AJ_ErrPrintf(("DecryptMessage(): AJ_ERR_RESOURCES\n"));
+                status = AJ_ERR_RESOURCES;
+            } else {
+                status = LoadBytes(ioBuf, msg->hdr->bodyLen, 0, msg);
+            }
+            if (AJ_OK == status) {
+                InitNonce(msg, role, nonce, sizeof(nonce), ioBuf->bufStart + mlen - extraNonceLen, extraNonceLen);
+                EndianSwap(msg, AJ_ARG_INT32, &msg->hdr->bodyLen, 3);
+#if AJ_AES_KEY_CACHE
+                status = AJ_Decrypt_CCM_Key(aesKey, ioBuf->bufStart, mlen - cryptoValsLen, hLen, macLen, nonce, nonceLen);
+#else
+                status = AJ_Decrypt_CCM(key, ioBuf->bufStart, mlen - cryptoValsLen, hLen, macLen, nonce, nonceLen);
+#endif
+                EndianSwap(msg, AJ_ARG_INT32, &msg->hdr->bodyLen, 3);
+            }
+            if (AJ_OK == status) {
+                if ((AJ_MSG_METHOD_CALL == msg->hdr->msgType) || (AJ_MSG_SIGNAL == msg->hdr->msgType)) {
+                    /* Methods and signals */
+                    status = AJ_CheckIncomingSerial(incoming, msg->hdr->serialNum);
+                }
+            }
+        } else {
+            AJ_RxStream* rx = NULL;
+            /*
+             * Reject a replayed message before it is returned to the application. The serial
+             * number is only recorded once the authentication tag has been checked.
+             */
+            if (incoming && ((AJ_MSG_METHOD_CALL == msg->hdr->msgType) || (AJ_MSG_SIGNAL == msg->hdr->msgType))) {
+                AJ_SerialNum check = *incoming;
+                status = AJ_CheckIncomingSerial(&check, msg->hdr->serialNum);
+            }
+            if (AJ_OK == status) {
+                rx = (AJ_RxStream*)AJ_Malloc(sizeof(AJ_RxStream));
+            }
+            if (AJ_OK != status) {
+                AJ_ErrPrintf(("DecryptMessage(): %s\n", AJ_StatusText(status)));
+            } else if (!rx) {
+                AJ_ErrPrintf(("DecryptMessage(): AJ_ERR_RESOURCES\n"));
+                status = AJ_ERR_RESOURCES;
+            } else {
+                memset(rx, 0, sizeof(AJ_RxStream));
+                InitNonce(msg, role, nonce, sizeof(nonce), NULL, 0);
+                EndianSwap(msg, AJ_ARG_INT32, &msg->hdr->bodyLen, 3);
+#if AJ_AES_KEY_CACHE
+                status = AJ_CCM_Start(&rx->ccm, aesKey, ioBuf->bufStart, mlen - cryptoValsLen, hLen, macLen, nonce, nonceLen, TRUE);
+#else
+                AJ_AES_ExpandKey(&expanded, key);
+                status = AJ_CCM_Start(&rx->ccm, &expanded, ioBuf->bufStart, mlen - cryptoValsLen, hLen, macLen, nonce, nonceLen, TRUE);
+                AJ_MemZeroSecure(&expanded, sizeof(expanded));
+#endif
+                EndianSwap(msg, AJ_ARG_INT32, &msg->hdr->bodyLen, 3);
+                if (AJ_OK == status) {
+                    rx->encrypted = msg->hdr->bodyLen - cryptoValsLen;
+                    rx->incoming = incoming;
+                    rx->serialNum = msg->hdr->serialNum;
+                    rx->msgType = msg->hdr->msgType;
+                    rx->tagLen = (uint8_t)macLen;
+                    msg->rxStream = rx;
+                    /*
+                     * Decrypt any body bytes that were loaded with the header
+                     */
+                    DecryptLoaded(msg, ioBuf->readPtr);
+                } else {
+                    AJ_Free(rx);
+                }
             }
         }
     }
+#if !AJ_AES_KEY_CACHE
     AJ_MemZeroSecure(key, 16);
+#endif
     return status;
 }
 
-static AJ_Status EncryptMessage(AJ_Message* msg)
+/*
+ * Encrypt a message in the transmit buffer. If the message references application buffers the
+ * ccm stream is started instead and the body is encrypted as it is sent by DeliverRefs.
+ */
+static AJ_Status EncryptMessage(AJ_Message* msg, AJ_CCM_Stream* ccm)
 {
     AJ_IOBuffer* ioBuf = &msg->bus->sock.tx;
     AJ_Status status;
+    uint8_t* trailer = ioBuf->writePtr;
+#if AJ_AES_KEY_CACHE
+    const AJ_AES_Key* aesKey;
+#else
     uint8_t key[16];
+    AJ_AES_Key expanded;
+#endif
     uint8_t nonce[MAX_NONCE_LENGTH];
     uint8_t role = AJ_ROLE_KEY_UNDEFINED;
     uint32_t mlen = MessageLen(msg);
@@ -531,12 +775,20 @@ static AJ_Status EncryptMessage(AJ_Message* msg)
      * Use the group key for multicast and broadcast signals the session key otherwise.
      */
     if ((msg->hdr->msgType == AJ_MSG_SIGNAL) && !msg->destination) {
+#if AJ_AES_KEY_CACHE
+        status = AJ_GetGroupAesKey(NULL, &aesKey);
+#else
         status = AJ_GetGroupKey(NULL, key);
+#endif
         if (AJ_OK == status) {
             msg->authVersion = MIN_AUTH_FALLBACK_VERSION;
         }
     } else {
+#if AJ_AES_KEY_CACHE
+        status = AJ_GetSessionAesKey(msg->destination, &aesKey, &role, &msg->authVersion);
+#else
         status = AJ_GetSessionKey(msg->destination, key, &role, &msg->authVersion);
+#endif
     }
 
     if (AJ_OK == status) {
@@ -550,25 +802,43 @@ static AJ_Status EncryptMessage(AJ_Message* msg)
          */
         if (AJ_IO_BUF_SPACE(ioBuf) < cryptoValsLen) {
             AJ_ErrPrintf(("EncryptMessage(): AJ_ERR_RESOURCES\n"));
+#if !AJ_AES_KEY_CACHE
             AJ_MemZeroSecure(key, 16);
+#endif
             return AJ_ERR_RESOURCES;
         }
         msg->hdr->bodyLen += cryptoValsLen;
         ioBuf->writePtr += cryptoValsLen;
 
         if (MessageRequiresLongerCryptoValues(msg, MIN_AUTH_FULL_NONCE_LENGTH)) {
-            AJ_RandBytes(ioBuf->bufStart + mlen + macLen, extraNonceLen);
+            AJ_RandBytes(trailer + macLen, extraNonceLen);
         }
         AJ_InfoPrintf(("EncryptMessage(): "));
-        InitNonce(msg, role, nonce, sizeof(nonce), ioBuf->bufStart + mlen + macLen, extraNonceLen);
-        status = AJ_Encrypt_CCM(key, ioBuf->bufStart, mlen, hlen, macLen, nonce, nonceLen);
+        InitNonce(msg, role, nonce, sizeof(nonce), trailer + macLen, extraNonceLen);
+        if (ccm) {
+#if AJ_AES_KEY_CACHE
+            status = AJ_CCM_Start(ccm, aesKey, ioBuf->bufStart, mlen, hlen, macLen, nonce, nonceLen, FALSE);
+#else
+            AJ_AES_ExpandKey(&expanded, key);
+            status = AJ_CCM_Start(ccm, &expanded, ioBuf->bufStart, mlen, hlen, macLen, nonce, nonceLen, FALSE);
+            AJ_MemZeroSecure(&expanded, sizeof(expanded));
+#endif
+        } else {
+#if AJ_AES_KEY_CACHE
+            status = AJ_Encrypt_CCM_Key(aesKey, ioBuf->bufStart, mlen, hlen, macLen, nonce, nonceLen);
+#else
+            status = AJ_Encrypt_CCM(key, ioBuf->bufStart, mlen, hlen, macLen, nonce, nonceLen);
+#endif
+        }
     } else {
         AJ_ErrPrintf(("EncryptMesssage(): peer %s not authenticated", msg->destination));
         /* Leave status from AJ_GetGroupKey/AJ_GetStatusKey unmodified.
          * Caller checks for AJ_ERR_NO_MATCH.
          */
     }
+#if !AJ_AES_KEY_CACHE
     AJ_MemZeroSecure(key, 16);
+#endif
     return status;
 }
 
@@ -590,16 +860,185 @@ static AJ_Status AuthoriseIncomingMessage(const AJ_Message* msg)
     return AJ_AccessControlCheckMessage(msg, msg->sender, AJ_ACCESS_INCOMING);
 }
 
+/*
+ * Send everything in the transmit buffer
+ */
+static AJ_Status SendAll(AJ_IOBuffer* ioBuf)
+{
+    AJ_Status status = AJ_OK;
+
+    while ((status == AJ_OK) && AJ_IO_BUF_AVAIL(ioBuf)) {
+        //#pragma calls = AJ_Net_Send
+        status = ioBuf->send(ioBuf);
+    }
+    return status;
+}
+
+/*
+ * Returns the largest piece of the transmit buffer that is not holding unsent data. Everything
+ * before unsent has already been sent and everything after txEnd is unused.
+ */
+static uint8_t* BounceSpace(AJ_IOBuffer* ioBuf, const uint8_t* unsent, const uint8_t* txEnd, uint32_t* len)
+{
+    uint32_t front = (uint32_t)(unsent - ioBuf->bufStart);
+    uint32_t tail = (uint32_t)(ioBuf->bufStart + ioBuf->bufSize - txEnd);
+
+    if (front >= tail) {
+        *len = front;
+        return ioBuf->bufStart;
+    } else {
+        *len = tail;
+        return (uint8_t*)txEnd;
+    }
+}
+
+/*
+ * Send a list of pieces, some of which are in the transmit buffer and some of which are application
+ * buffers. If the transport cannot gather the application buffers are sent through transmit buffer
+ * space that is not in use.
+ */
+static AJ_Status SendVec(AJ_IOBuffer* ioBuf, const AJ_IOVec* iov, uint16_t iovCount, const uint8_t* txEnd)
+{
+    AJ_Status status = AJ_OK;
+    uint16_t i;
+
+    if (!iovCount) {
+        return AJ_OK;
+    }
+    if (ioBuf->sendv) {
+        status = ioBuf->sendv(ioBuf, iov, iovCount);
+        AJ_IO_BUF_RESET(ioBuf);
+        return status;
+    }
+    for (i = 0; (status == AJ_OK) && (i < iovCount); ++i) {
+        const uint8_t* data = iov[i].data;
+        uint32_t len = iov[i].len;
+
+        if ((data >= ioBuf->bufStart) && (data < ioBuf->bufStart + ioBuf->bufSize)) {
+            ioBuf->readPtr = (uint8_t*)data;
+            ioBuf->writePtr = (uint8_t*)data + len;
+            status = SendAll(ioBuf);
+        } else {
+            const uint8_t* unsent = txEnd;
+            uint32_t bounceLen;
+            uint8_t* bounce;
+            uint16_t j;
+            /*
+             * Find the next piece of the transmit buffer that has not been sent
+             */
+            for (j = i + 1; j < iovCount; ++j) {
+                if ((iov[j].data >= ioBuf->bufStart) && (iov[j].data < txEnd)) {
+                    unsent = iov[j].data;
+                    break;
+                }
+            }
+            bounce = BounceSpace(ioBuf, unsent, txEnd, &bounceLen);
+            while ((status == AJ_OK) && len) {
+                uint32_t sz = min(len, bounceLen);
+                memcpy(bounce, data, sz);
+                ioBuf->readPtr = bounce;
+                ioBuf->writePtr = bounce + sz;
+                status = SendAll(ioBuf);
+                data += sz;
+                len -= sz;
+            }
+        }
+    }
+    AJ_IO_BUF_RESET(ioBuf);
+    return status;
+}
+
+/*
+ * Deliver a message that references application buffers. The transmit buffer holds the message
+ * with a gap at each point where referenced data is to be inserted. For encrypted messages the
+ * pieces in the transmit buffer are encrypted in place and the referenced data is encrypted in
+ * transmit buffer space that is not in use, the application buffers are never modified.
+ */
+static AJ_Status DeliverRefs(AJ_Message* msg, uint8_t* bodyEnd, AJ_CCM_Stream* ccm)
+{
+    AJ_BusAttachment* bus = msg->bus;
+    AJ_IOBuffer* ioBuf = &bus->sock.tx;
+    uint8_t* txEnd = ioBuf->writePtr;
+    uint8_t* body = ioBuf->bufStart + MessageLen(msg) - msg->hdr->bodyLen;
+    uint8_t* piece = ioBuf->bufStart;
+    AJ_IOVec iov[2 * AJ_MAX_TX_REFS + 1];
+    AJ_Status status = AJ_OK;
+    uint16_t n = 0;
+    uint8_t i;
+
+    for (i = 0; (status == AJ_OK) && (i <= bus->numTxRefs); ++i) {
+        AJ_TxRef* ref = (i < bus->numTxRefs) ? &bus->txRefs[i] : NULL;
+        uint8_t* end = ref ? ioBuf->bufStart + ref->offset : bodyEnd;
+
+        if (ccm) {
+            uint8_t* start = (piece > body) ? piece : body;
+            if (end > start) {
+                AJ_CCM_Update(ccm, start, (uint32_t)(end - start));
+            }
+            if (!ref) {
+                status = AJ_CCM_Final(ccm, bodyEnd);
+            }
+        }
+        if (!ref) {
+            /*
+             * The last piece includes the MAC and nonce if the message is encrypted
+             */
+            end = txEnd;
+        }
+        if (end > piece) {
+            iov[n].data = piece;
+            iov[n].len = (uint32_t)(end - piece);
+            ++n;
+        }
+        if (!ref) {
+            break;
+        }
+        piece = end + ref->gap;
+        if (!ccm) {
+            iov[n++] = ref->data;
+        } else {
+            const uint8_t* data = ref->data.data;
+            uint32_t len = ref->data.len;
+            uint32_t bounceLen;
+            uint8_t* bounce;
+
+            status = SendVec(ioBuf, iov, n, txEnd);
+            n = 0;
+            bounce = BounceSpace(ioBuf, piece, txEnd, &bounceLen);
+            while ((status == AJ_OK) && len) {
+                AJ_IOVec chunk;
+                chunk.data = bounce;
+                chunk.len = min(len, bounceLen);
+                memcpy(bounce, data, chunk.len);
+                AJ_CCM_Update(ccm, bounce, chunk.len);
+                status = SendVec(ioBuf, &chunk, 1, txEnd);
+                data += chunk.len;
+                len -= chunk.len;
+            }
+        }
+    }
+    if (status == AJ_OK) {
+        status = SendVec(ioBuf, iov, n, txEnd);
+    }
+    return status;
+}
+
 AJ_Status AJ_DeliverMsg(AJ_Message* msg)
 {
     AJ_Status status = AJ_OK;
     AJ_IOBuffer* ioBuf;
+    AJ_BusAttachment* bus;
+    AJ_CCM_Stream stream;
+    AJ_CCM_Stream* ccm = NULL;
+    uint8_t* bodyEnd;
 
     if (!msg || !msg->bus) {
         return AJ_ERR_MARSHAL;
     }
 
-    ioBuf = &msg->bus->sock.tx;
+    bus = msg->bus;
+    ioBuf = &bus->sock.tx;
+    bodyEnd = ioBuf->writePtr;
 
     /*
      * If the header has already been marshaled (due to partial delivery) it will be NULL
@@ -608,12 +1047,15 @@ AJ_Status AJ_DeliverMsg(AJ_Message* msg)
         /*
          * Write the final body length to the header
          */
-        msg->hdr->bodyLen = msg->bodyBytes;
-        AJ_DumpMsg("SENDING", msg, TRUE);
+        msg->hdr->bodyLen = msg->bodyBytes + bus->txRefBytes;
+        AJ_DumpMsg("SENDING", msg, !bus->numTxRefs);
         if (msg->hdr->flags & AJ_FLAG_ENCRYPTED) {
             status = AuthoriseOutgoingMessage(msg);
             if (AJ_OK == status) {
-                status = EncryptMessage(msg);
+                status = EncryptMessage(msg, bus->numTxRefs ? &stream : NULL);
+                if ((AJ_OK == status) && bus->numTxRefs) {
+                    ccm = &stream;
+                }
             }
 
             if (AJ_ERR_NO_MATCH == status && AJ_MSG_ERROR == msg->hdr->msgType && msg->error == AJ_ErrSecurityViolation) {
@@ -631,9 +1073,18 @@ AJ_Status AJ_DeliverMsg(AJ_Message* msg)
         }
     }
     if (status == AJ_OK) {
-        //#pragma calls = AJ_Net_Send
-        status = ioBuf->send(ioBuf);
+        if (bus->numTxRefs) {
+            status = DeliverRefs(msg, bodyEnd, ccm);
+        } else {
+            //#pragma calls = AJ_Net_Send
+            status = ioBuf->send(ioBuf);
+        }
+    }
+    if (ccm) {
+        AJ_MemZeroSecure(ccm, sizeof(AJ_CCM_Stream));
     }
+    bus->numTxRefs = 0;
+    bus->txRefBytes = 0;
     memset(msg, 0, sizeof(AJ_Message));
     return status;
 }
@@ -659,9 +1110,13 @@ static AJ_Status LoadBytes(AJ_IOBuffer* ioBuf, uint16_t numBytes, uint8_t pad, A
 
     AJ_InfoPrintf(("LoadBytes(): Start loop numBytes=%u, ioBufBytes=%u\n", numBytes, AJ_IO_BUF_AVAIL(ioBuf)));
     while (AJ_IO_BUF_AVAIL(ioBuf) < numBytes) {
+        uint8_t* loaded = ioBuf->writePtr;
         //#pragma calls = AJ_Net_Recv
         AJ_InfoPrintf(("LoadBytes(): numBytes=%u, ioBufBytes=%u\n", numBytes, AJ_IO_BUF_AVAIL(ioBuf)));
         status = ioBuf->recv(ioBuf, numBytes - AJ_IO_BUF_AVAIL(ioBuf), *timeout);
+        if (msg->rxStream) {
+            DecryptLoaded(msg, loaded);
+        }
 
         if (status != AJ_OK) {
             /*
@@ -784,7 +1239,16 @@ AJ_Status AJ_CloseMsg(AJ_Message* msg)
                 ioBuf->readPtr += sz;
             }
         }
+        if (msg->rxStream) {
+            AJ_Status authStatus = CloseRxStream(msg, (status == AJ_OK) && !msg->expired);
+            if (status == AJ_OK) {
+                status = authStatus;
+            }
+        }
 
+#if AJ_MSG_ARENA_SIZE
+        ReleaseArena(msg);
+#endif
         memset(msg, 0, sizeof(AJ_Message));
 #ifdef AJ_DEBUG_BUILD
         currentMsg = NULL;
@@ -872,7 +1336,7 @@ static AJ_Status UnmarshalStruct(AJ_Message* msg, const char** sig, AJ_Arg* arg,
  * in AJ_UnmarshalContainer() for the duration of a single call to AJ_UnmarshalArgs(). If we ever
  * have to make the unmarshaler thread-safe this will need to be moved into AJ_Message.
  */
-static uint8_t unmarshalScalarAsElement = FALSE;
+static AJ_THREAD_LOCAL uint8_t unmarshalScalarAsElement = FALSE;
 
 /*
  * Unmarshal an array argument.
@@ -1175,7 +1639,7 @@ static AJ_Status ProcessBusMessages(AJ_Message* msg)
     return status;
 }
 
-AJ_Status AJ_UnmarshalMsg(AJ_BusAttachment* bus, AJ_Message* msg, uint32_t timeout)
+static AJ_Status UnmarshalMsg(AJ_BusAttachment* bus, AJ_Message* msg, uint32_t timeout)
 {
     AJ_Status status;
     AJ_IOBuffer* ioBuf = &bus->sock.rx;
@@ -1194,6 +1658,7 @@ AJ_Status AJ_UnmarshalMsg(AJ_BusAttachment* bus, AJ_Message* msg, uint32_t timeo
     msg->msgId = AJ_INVALID_MSG_ID;
     msg->bus = bus;
     msg->timeout = timeout;
+    msg->useArena = TRUE;
     /*
      * Check that the read and write pointers are within the bounds of the recv buffer
      */
@@ -1297,7 +1762,7 @@ AJ_Status AJ_UnmarshalMsg(AJ_BusAttachment* bus, AJ_Message* msg, uint32_t timeo
      * the integers.
      */
     if ((msg->hdr->endianess != HOST_ENDIANESS)) {
-        hdrRaw = AJ_Malloc(msg->hdr->headerLen);
+        hdrRaw = AJ_MsgArenaAlloc(msg, msg->hdr->headerLen);
         if (hdrRaw) {
             memcpy(hdrRaw, ioBuf->readPtr, msg->hdr->headerLen);
         }
@@ -1411,7 +1876,7 @@ AJ_Status AJ_UnmarshalMsg(AJ_BusAttachment* bus, AJ_Message* msg, uint32_t timeo
      */
     if (hdrRaw) {
         memcpy(ioBuf->bufStart + sizeof(AJ_MsgHeader), hdrRaw, msg->hdr->headerLen);
-        AJ_Free(hdrRaw);
+        AJ_MsgArenaFree(hdrRaw);
         hdrRaw = NULL;
     }
     if (ioBuf->readPtr != endOfHeader) {
@@ -1424,28 +1889,26 @@ AJ_Status AJ_UnmarshalMsg(AJ_BusAttachment* bus, AJ_Message* msg, uint32_t timeo
          */
         ioBuf->readPtr += hdrPad;
         /*
-         * If the message is encrypted load the entire message body and decrypt it.
+         * If the message is encrypted load the message body and decrypt it. Messages too large for
+         * the receive buffer are decrypted as they are loaded.
          */
         if (msg->hdr->flags & AJ_FLAG_ENCRYPTED) {
-            status = LoadBytes(ioBuf, msg->hdr->bodyLen, 0, msg);
-            if (status == AJ_OK) {
-                status = DecryptMessage(msg);
-                /*
-                 * If session key missing, reply with error message.
-                 * If decryption failed, silently ignore message below.
-                 */
-                if ((AJ_ERR_NO_MATCH == status) && (msg->hdr->msgType == AJ_MSG_METHOD_CALL) && !(msg->hdr->flags & AJ_FLAG_NO_REPLY_EXPECTED)) {
-                    AJ_Message reply;
-                    AJ_Status replyStatus;
-                    status = AJ_ERR_SECURITY;
-                    replyStatus = AJ_MarshalStatusMsg(msg, &reply, status);
-                    if (AJ_OK == replyStatus) {
-                        replyStatus = AJ_DeliverMsg(&reply);
-                    }
-                    if (AJ_OK != replyStatus) {
-                        /* Fail to send an error reply, log and continue */
-                        AJ_InfoPrintf(("AJ_UnmarshalMsg(): %s\n", AJ_StatusText(replyStatus)));
-                    }
+            status = DecryptMessage(msg);
+            /*
+             * If session key missing, reply with error message.
+             * If decryption failed, silently ignore message below.
+             */
+            if ((AJ_ERR_NO_MATCH == status) && (msg->hdr->msgType == AJ_MSG_METHOD_CALL) && !(msg->hdr->flags & AJ_FLAG_NO_REPLY_EXPECTED)) {
+                AJ_Message reply;
+                AJ_Status replyStatus;
+                status = AJ_ERR_SECURITY;
+                replyStatus = AJ_MarshalStatusMsg(msg, &reply, status);
+                if (AJ_OK == replyStatus) {
+                    replyStatus = AJ_DeliverMsg(&reply);
+                }
+                if (AJ_OK != replyStatus) {
+                    /* Fail to send an error reply, log and continue */
+                    AJ_InfoPrintf(("AJ_UnmarshalMsg(): %s\n", AJ_StatusText(replyStatus)));
                 }
             }
         }
@@ -1461,6 +1924,14 @@ AJ_Status AJ_UnmarshalMsg(AJ_BusAttachment* bus, AJ_Message* msg, uint32_t timeo
         if (status == AJ_OK) {
             status = AJ_IdentifyMessage(msg);
         }
+        /*
+         * A message that is decrypted as it is loaded is not authenticated until it is closed so
+         * it is only delivered to application objects that expect this.
+         */
+        if ((AJ_OK == status) && msg->rxStream && !AJ_StreamedMessageAllowed(msg)) {
+            AJ_ErrPrintf(("AJ_UnmarshalMsg(): AJ_ERR_RESOURCES\n"));
+            status = AJ_ERR_RESOURCES;
+        }
 
         /*
          * If this is the Peer.Authentication interface,
@@ -1513,6 +1984,29 @@ AJ_Status AJ_UnmarshalMsg(AJ_BusAttachment* bus, AJ_Message* msg, uint32_t timeo
     return status;
 }
 
+AJ_Status AJ_UnmarshalMsg(AJ_BusAttachment* bus, AJ_Message* msg, uint32_t timeout)
+{
+    AJ_Time timer;
+
+    AJ_BusContextSelect(bus);
+    AJ_InitTimer(&timer);
+    while (TRUE) {
+        uint32_t elapsed;
+        AJ_Status status = UnmarshalMsg(bus, msg, timeout);
+        /*
+         * Replies to method calls that have a reply handler are not returned to the caller
+         */
+        if ((status != AJ_OK) || !AJ_DispatchReplyHandler(msg)) {
+            return status;
+        }
+        elapsed = AJ_GetElapsedTime(&timer, FALSE);
+        if (elapsed >= timeout) {
+            return AJ_ERR_TIMEOUT;
+        }
+        timeout -= elapsed;
+    }
+}
+
 AJ_Status AJ_SkipArg(AJ_Message* msg)
 {
     AJ_Status status;
@@ -1853,6 +2347,88 @@ AJ_Status AJ_UnmarshalRaw(AJ_Message* msg, const void** data, size_t len, size_t
     return status;
 }
 
+AJ_Status AJ_UnmarshalArrayChunk(AJ_Message* msg, uint8_t typeId, const void** data, size_t* len)
+{
+    AJ_Status status;
+    AJ_IOBuffer* ioBuf = &msg->bus->sock.rx;
+    size_t hdrSize = sizeof(AJ_MsgHeader) + msg->hdr->headerLen + HEADERPAD(msg->hdr->headerLen);
+    uint32_t elemSize = SizeOfType(typeId);
+    size_t sz;
+
+    if (!msg->chunkType) {
+        const char* sig = msg->signature + msg->sigOffset;
+        uint8_t* argStart = ioBuf->readPtr;
+        uint32_t numBytes;
+
+        if (msg->outer || msg->varOffset || (msg->sigOffset == 0xFF)) {
+            AJ_ErrPrintf(("AJ_UnmarshalArrayChunk(): AJ_ERR_UNEXPECTED\n"));
+            return AJ_ERR_UNEXPECTED;
+        }
+        if (!IsScalarType(typeId) || (sig[0] != AJ_ARG_ARRAY) || (sig[1] != typeId)) {
+            AJ_ErrPrintf(("AJ_UnmarshalArrayChunk(): AJ_ERR_SIGNATURE\n"));
+            return AJ_ERR_SIGNATURE;
+        }
+        /*
+         * Get the byte count for the array and skip any padding before the elements
+         */
+        status = LoadBytes(ioBuf, 4, PadForType(AJ_ARG_ARRAY, ioBuf), msg);
+        if (status != AJ_OK) {
+            return status;
+        }
+        EndianSwap(msg, AJ_ARG_UINT32, ioBuf->readPtr, 1);
+        numBytes = *((uint32_t*)ioBuf->readPtr);
+        ioBuf->readPtr += 4;
+        status = LoadBytes(ioBuf, 0, PadForType(typeId, ioBuf), msg);
+        if (status != AJ_OK) {
+            return status;
+        }
+        sz = ioBuf->readPtr - argStart;
+        if (((sz + numBytes) > msg->bodyBytes) || (numBytes % elemSize)) {
+            AJ_ErrPrintf(("AJ_UnmarshalArrayChunk(): AJ_ERR_UNMARSHAL\n"));
+            return AJ_ERR_UNMARSHAL;
+        }
+        msg->bodyBytes -= (uint32_t)sz;
+        msg->sigOffset += 2;
+        msg->chunkType = typeId;
+        msg->chunkBytes = numBytes;
+    } else if (typeId != msg->chunkType) {
+        AJ_ErrPrintf(("AJ_UnmarshalArrayChunk(): AJ_ERR_SIGNATURE\n"));
+        return AJ_ERR_SIGNATURE;
+    }
+    if (!msg->chunkBytes) {
+        /*
+         * Leave as much room as possible for unmarshaling the remaining arguments
+         */
+        AJ_IOBufRebase(ioBuf, hdrSize + (AJ_IO_BUF_CONSUMED(ioBuf) & 7));
+        msg->chunkType = 0;
+        return AJ_ERR_NO_MORE;
+    }
+    sz = AJ_IO_BUF_AVAIL(ioBuf);
+    if (sz < elemSize) {
+        /*
+         * Make room to load as much of the array as possible keeping the header and the current
+         * alignment so the remaining arguments can be unmarshaled as usual.
+         */
+        AJ_IOBufRebase(ioBuf, hdrSize + (AJ_IO_BUF_CONSUMED(ioBuf) & 7));
+        sz = min(msg->chunkBytes, ioBuf->bufSize - AJ_IO_BUF_CONSUMED(ioBuf));
+        sz -= sz % elemSize;
+        status = LoadBytes(ioBuf, (uint16_t)sz, 0, msg);
+        if (status != AJ_OK) {
+            return status;
+        }
+        sz = AJ_IO_BUF_AVAIL(ioBuf);
+    }
+    sz = min(sz, msg->chunkBytes);
+    sz -= sz % elemSize;
+    EndianSwap(msg, typeId, ioBuf->readPtr, (uint32_t)(sz / elemSize));
+    *data = ioBuf->readPtr;
+    *len = sz;
+    ioBuf->readPtr += sz;
+    msg->chunkBytes -= (uint32_t)sz;
+    msg->bodyBytes -= (uint32_t)sz;
+    return AJ_OK;
+}
+
 AJ_Status AJ_UnmarshalContainer(AJ_Message* msg, AJ_Arg* arg, uint8_t typeId)
 {
     AJ_Status status = AJ_ERR_UNMARSHAL;
@@ -2070,6 +2646,8 @@ static AJ_Status MarshalMsg(AJ_Message* msg, uint8_t msgType, uint32_t msgId, ui
     }
 
     AJ_IO_BUF_RESET(ioBuf);
+    msg->bus->numTxRefs = 0;
+    msg->bus->txRefBytes = 0;
 
     msg->hdr = (AJ_MsgHeader*)ioBuf->bufStart;
     memset(msg->hdr, 0, sizeof(AJ_MsgHeader));
@@ -2395,6 +2973,13 @@ AJ_Status AJ_DeliverMsgPartial(AJ_Message* msg, uint32_t bytesRemaining)
         AJ_ErrPrintf(("AJ_DeliverMsgPartial(): AJ_ERR_UNEXPECTED\n"));
         return AJ_ERR_UNEXPECTED;
     }
+    /*
+     * The transmit buffer cannot be flushed if it has gaps for referenced data
+     */
+    if (msg->bus->numTxRefs) {
+        AJ_ErrPrintf(("AJ_DeliverMsgPartial(): AJ_ERR_UNEXPECTED\n"));
+        return AJ_ERR_UNEXPECTED;
+    }
     /*
      * Partial delivery not currently supported for messages that must be encrypted.
      */
@@ -2460,6 +3045,71 @@ AJ_Status AJ_MarshalRaw(AJ_Message* msg, const void* data, size_t len)
     return WriteBytes(msg, data, len, 0);
 }
 
+AJ_Status AJ_MarshalArrayRef(AJ_Message* msg, uint8_t typeId, const void* data, size_t len)
+{
+    AJ_BusAttachment* bus = msg->bus;
+    AJ_IOBuffer* ioBuf = &bus->sock.tx;
+    const char* sig = msg->signature + msg->sigOffset;
+    uint8_t* argStart = ioBuf->writePtr;
+    uint32_t szu32 = (uint32_t)len;
+    uint8_t gap = (uint8_t)(len & 7);
+    AJ_Status status;
+
+    /*
+     * Referenced arrays are only supported as top-level arguments
+     */
+    if (!msg->hdr || msg->outer) {
+        AJ_ErrPrintf(("AJ_MarshalArrayRef(): AJ_ERR_UNEXPECTED\n"));
+        return AJ_ERR_UNEXPECTED;
+    }
+    if (!IsScalarType(typeId) || (sig[0] != AJ_ARG_ARRAY) || (sig[1] != typeId) || (len % SizeOfType(typeId))) {
+        AJ_ErrPrintf(("AJ_MarshalArrayRef(): AJ_ERR_MARSHAL\n"));
+        return AJ_ERR_MARSHAL;
+    }
+    if (len && !data) {
+        AJ_ErrPrintf(("AJ_MarshalArrayRef(): AJ_ERR_NULL\n"));
+        return AJ_ERR_NULL;
+    }
+    if (bus->numTxRefs == AJ_MAX_TX_REFS) {
+        AJ_ErrPrintf(("AJ_MarshalArrayRef(): AJ_ERR_RESOURCES\n"));
+        return AJ_ERR_RESOURCES;
+    }
+    status = WriteBytes(msg, &szu32, 4, PadForType(AJ_ARG_ARRAY, ioBuf));
+    if (status == AJ_OK) {
+        /*
+         * May need to pad if the elements required 8 byte alignment
+         */
+        status = WritePad(msg, PadForType(typeId, ioBuf));
+    }
+    if ((status == AJ_OK) && len) {
+        /*
+         * Skip the same number of bytes, modulo 8, as the referenced data so that arguments
+         * marshaled after this one are correctly aligned.
+         */
+        if (AJ_IO_BUF_SPACE(ioBuf) < gap) {
+            AJ_ErrPrintf(("AJ_MarshalArrayRef(): AJ_ERR_RESOURCES\n"));
+            status = AJ_ERR_RESOURCES;
+        } else {
+            AJ_TxRef* ref = &bus->txRefs[bus->numTxRefs++];
+            ref->data.data = (const uint8_t*)data;
+            ref->data.len = (uint32_t)len;
+            ref->offset = (uint16_t)(ioBuf->writePtr - ioBuf->bufStart);
+            ref->gap = gap;
+            bus->txRefBytes += (uint32_t)len;
+        }
+    }
+    if (status == AJ_OK) {
+        msg->bodyBytes += (uint16_t)(ioBuf->writePtr - argStart);
+        if (len) {
+            ioBuf->writePtr += gap;
+        }
+        msg->sigOffset += 2;
+    } else {
+        AJ_ReleaseReplyContext(msg);
+    }
+    return status;
+}
+
 AJ_Status AJ_MarshalContainer(AJ_Message* msg, AJ_Arg* arg, uint8_t typeId)
 {
     AJ_Status status;
@@ -2554,6 +3204,21 @@ AJ_Status AJ_MarshalMethodCall(AJ_BusAttachment* bus, AJ_Message* msg, uint32_t
     return status;
 }
 
+AJ_Status AJ_MarshalMethodCallWithHandler(AJ_BusAttachment* bus, AJ_Message* msg, uint32_t msgId, const char* destination, AJ_SessionId sessionId, uint8_t flags, uint32_t timeout, AJ_ReplyHandler handler, void* context)
+{
+    AJ_Status status;
+
+    if (flags & AJ_FLAG_NO_REPLY_EXPECTED) {
+        AJ_ErrPrintf(("AJ_MarshalMethodCallWithHandler(): No reply expected: AJ_ERR_INVALID\n"));
+        return AJ_ERR_INVALID;
+    }
+    status = AJ_MarshalMethodCall(bus, msg, msgId, destination, sessionId, flags, timeout);
+    if (status == AJ_OK) {
+        status = AJ_SetReplyHandler(msg, handler, context);
+    }
+    return status;
+}
+
 AJ_Status AJ_MarshalSignal(AJ_BusAttachment* bus, AJ_Message* msg, uint32_t msgId, const char* destination, AJ_SessionId sessionId, uint8_t flags, uint32_t ttl)
 {
     memset(msg, 0, sizeof(AJ_Message));
@@ -103,9 +103,9 @@ typedef struct _PeerContext {
     char nonce[2 * AJ_NONCE_LEN + 1];   /* Nonce as ascii hex */
 } PeerContext;
 
-static PeerContext peerContext;
-static AJ_AuthenticationContext authContext = { 0 };
-static uint8_t sentManifests = FALSE;
+static AJ_THREAD_LOCAL PeerContext peerContext;
+static AJ_THREAD_LOCAL AJ_AuthenticationContext authContext = { 0 };
+static AJ_THREAD_LOCAL uint8_t sentManifests = FALSE;
 
 static uint32_t GetAcceptableVersion(uint32_t srcV)
 {
@@ -2086,7 +2086,7 @@ static void UnmarshalCertificates(AJ_Message* msg)
         if (AJ_OK != status) {
             break;
         }
-        node = (X509CertificateChain*) AJ_Malloc(sizeof (X509CertificateChain));
+        node = (X509CertificateChain*) AJ_MsgArenaAlloc(msg, sizeof (X509CertificateChain));
         if (NULL == node) {
             AJ_WarnPrintf(("UnmarshalCertificates(msg=%p): Resource error\n", msg));
             goto Exit;
@@ -2169,7 +2169,7 @@ Exit:
     while (root) {
         node = root;
         root = root->next;
-        AJ_Free(node);
+        AJ_MsgArenaFree(node);
     }
 }
 
@@ -43,6 +43,8 @@
 #include <ajtcl/aj_serial.h>
 #include <ajtcl/aj_serial_rx.h>
 #include <ajtcl/aj_serial_tx.h>
+#include <ajtcl/aj_serio.h>
+#include <ajtcl/aj_util.h>
 #include <ajtcl/aj_debug.h>
 
 /**
@@ -53,7 +55,7 @@
 uint8_t dbgSERIAL = 0;
 #endif
 
-#define SLAP_VERSION 1
+#define SLAP_VERSION 2
 
 /**
  * SLAP added a disconnect feature in version 1
@@ -80,9 +82,16 @@ const uint32_t NEGO_TIMEOUT = 200;
  */
 const uint32_t DISC_TIMEOUT = 200;
 
+#ifdef AJ_SERIO_POLL
+/**
+ * longest time the state machine waits for the UART when no timer is due sooner in milliseconds
+ */
+static const uint32_t POLL_TIMEOUT = 10;
+#endif
+
 
 #define LINK_PACKET_SIZE    4
-#define NEGO_PACKET_SIZE    3
+#define NEGO_PACKET_SIZE    4
 
 /** link packet types */
 typedef enum {
@@ -130,19 +139,24 @@ static void AdjustTimeoutValues(uint32_t packetSize)
 {
     // one start bit, eight data bits, one parity, and one stop bit equals eleven bits sent per byte
     // acknowledgement packets should be sent within twice the time to send one packet
-    // resends should be sent shortly after three times the packet delivery time
+    // resends should be sent shortly after a full window and the ack have been delivered, this is
+    // only the starting point, the transmit side adapts it to the measured round trip time
     AJ_SerialLinkParams.txAckTimeout = (packetSize * 11 * 1000 * 2) / AJ_SerialLinkParams.bitRate;
-    AJ_SerialLinkParams.txResendTimeout = (packetSize * 11 * 1000 * 3) / AJ_SerialLinkParams.bitRate;
+    AJ_SerialLinkParams.txResendTimeout = (packetSize * 11 * 1000 * (AJ_SerialLinkParams.windowSize + 2)) / AJ_SerialLinkParams.bitRate;
     AJ_InfoPrintf(("new ack timeout %i, new resend timeout %i\n", AJ_SerialLinkParams.txAckTimeout,  AJ_SerialLinkParams.txResendTimeout));
 }
 
 // Converge the remote endpoint's values with my own
-static void ProcessNegoPacket(const uint8_t* buffer)
+static void ProcessNegoPacket(const uint8_t* buffer, uint16_t len)
 {
     uint16_t max_payload;
     uint8_t proto_version;
     uint8_t window_size;
 
+    if (len < LINK_PACKET_SIZE + NEGO_PACKET_SIZE - 1) {
+        AJ_ErrPrintf(("Short negotiation packet %u\n", len));
+        return;
+    }
     max_payload = (((uint16_t) buffer[4]) << 8) | ((uint16_t) buffer[5]);
     AJ_AlwaysPrintf(("Read max payload: %u\n", max_payload));
     AJ_SerialLinkParams.packetSize = min(AJ_SerialLinkParams.packetSize, max_payload);
@@ -167,23 +181,29 @@ static void ProcessNegoPacket(const uint8_t* buffer)
         window_size = 4;
         break;
 
-    case 4:
+    case 3:
         window_size = 8;
         break;
-
-    default:
-        AJ_AlwaysPrintf(("Invalid window size: %u\n", window_size));
-        break;
     }
 
+    /*
+     * Peers that support selective acks append their actual maximum window size, older peers
+     * send three bytes and are held to a window that 3 bit sequence numbers can cover.
+     */
+    if ((proto_version >= SLAP_VERSION_SACK_FEATURE) && (len >= LINK_PACKET_SIZE + NEGO_PACKET_SIZE)) {
+        window_size = max(buffer[7], MIN_WINDOW_SIZE);
+    } else {
+        window_size = min(window_size, LEGACY_WINDOW_SIZE);
+    }
 
     AJ_AlwaysPrintf(("Read max window size: %u\n", window_size));
-    AJ_SerialLinkParams.windowSize = min(AJ_SerialLinkParams.maxWindowSize, window_size);
+    AJ_SerialLinkParams.windowSize = min(AJ_SerialLinkParams.windowSize, window_size);
 }
 
 static void SendNegotiationPacket(const char* pkt_type)
 {
     uint8_t encoded_window_size = 0;
+    uint8_t window_size = AJ_SerialLinkParams.windowSize;
 
     // NegoPkt is the packet type
     memset(&NegotiationPacket[0], 0, sizeof(NegotiationPacket));
@@ -194,28 +214,16 @@ static void SendNegotiationPacket(const char* pkt_type)
     NegotiationPacket[4] = (AJ_SerialLinkParams.packetSize & 0xFF00) >> 8;
     NegotiationPacket[5] = (AJ_SerialLinkParams.packetSize & 0x00FF);
 
-    switch (AJ_SerialLinkParams.maxWindowSize) {
-    case 1:
-        encoded_window_size = 0;
-        break;
-
-    case 2:
-        encoded_window_size = 1;
-        break;
-
-    case 4:
+    // older peers only understand the two bit window size
+    if (window_size >= LEGACY_WINDOW_SIZE) {
         encoded_window_size = 2;
-        break;
-
-    case 8:
-        encoded_window_size = 3;
-        break;
-
-    default:
-        break;
+    } else if (window_size >= 2) {
+        encoded_window_size = 1;
     }
 
     NegotiationPacket[6] = (AJ_SerialLinkParams.protoVersion << 2) | encoded_window_size;
+    // the actual window size, ignored by peers that do not support selective acks
+    NegotiationPacket[7] = window_size;
     AJ_SerialTX_EnqueueCtrl(NegotiationPacket, sizeof(NegotiationPacket), AJ_SERIAL_CTRL);
 }
 
@@ -344,10 +352,15 @@ void AJ_Serial_LinkPacket(uint8_t* buffer, uint16_t len)
         if (pktType == CONN_PKT) {
             AJ_SerialTX_EnqueueCtrl((uint8_t*) AcptPkt, sizeof(AcptPkt), AJ_SERIAL_CTRL);
         } else if (pktType == NEGO_PKT) {
-            ProcessNegoPacket(buffer);
+            ProcessNegoPacket(buffer, len);
             SendNegotiationPacket(NrspPkt);
         } else if (pktType == NRSP_PKT) {
             AJ_InfoPrintf(("Received nego response - Moving to LINK_ACTIVE\n"));
+            /*
+             * The response carries the converged values, pick them up in case the peer's own
+             * nego packet has not arrived yet so both ends agree on the packet format.
+             */
+            ProcessNegoPacket(buffer, len);
             AJ_SerialLinkParams.linkState = AJ_LINK_ACTIVE;
 
             // update the timeout values now that the link is active
@@ -360,7 +373,7 @@ void AJ_Serial_LinkPacket(uint8_t* buffer, uint16_t len)
          * In the initialized state we need to respond to nego-resp packets.
          */
         if (pktType == NEGO_PKT) {
-            ProcessNegoPacket(buffer);
+            ProcessNegoPacket(buffer, len);
             SendNegotiationPacket(NrspPkt);
         } else if (pktType == CONN_PKT) {
             // got a connection after active, so the link must have gone down without our knowledge
@@ -497,6 +510,67 @@ void AJ_StateMachine()
         /* Time to send a link packet to get the Link to the active state. */
         SendLinkPacket();
     }
+
+#ifdef AJ_SERIO_POLL
+    /*
+     * Wait for the UART until the next timer is due
+     */
+    {
+        uint32_t timeout = POLL_TIMEOUT;
+        AJ_Time limit = now;
+        AJ_Time* due[3];
+        size_t i;
+
+        due[0] = &resendTime;
+        due[1] = &ackTime;
+        due[2] = &sendLinkPacketTime;
+        AJ_TimeAddOffset(&limit, POLL_TIMEOUT);
+        for (i = 0; i < ArraySize(due); ++i) {
+            if (AJ_CompareTime(*due[i], limit) < 0) {
+                int32_t diff = AJ_GetTimeDifference(due[i], &now);
+                timeout = min(timeout, (diff > 0) ? (uint32_t)diff : 0);
+            }
+        }
+        if (dataSent) {
+            /* Queue any ack or link control packet the timers above just produced */
+            AJ_FillTxBufferList();
+        }
+        AJ_SerialIOPoll(timeout);
+        if (dataReceived) {
+            /* Hand over acks and data that just arrived without waiting for the next pass */
+            AJ_ProcessRxBufferList();
+        }
+    }
+#endif
+}
+
+uint16_t AJ_SlipScan(const uint8_t* buf, uint16_t len)
+{
+    /*
+     * A byte of w equals c exactly when the same byte of w ^ (c * ones) is zero and a zero byte
+     * is detected in a whole word with the usual (v - ones) & ~v & highs test.
+     */
+    const size_t ones = (size_t) -1 / 0xFF;
+    const size_t highs = ones << 7;
+    const uint8_t* p = buf;
+    const uint8_t* end = buf + len;
+
+    while ((size_t)(end - p) >= sizeof(size_t)) {
+        size_t w;
+        size_t b;
+        size_t e;
+        memcpy(&w, p, sizeof(w));
+        b = w ^ (ones * BOUNDARY_BYTE);
+        e = w ^ (ones * ESCAPE_BYTE);
+        if ((((b - ones) & ~b) | ((e - ones) & ~e)) & highs) {
+            break;
+        }
+        p += sizeof(size_t);
+    }
+    while ((p < end) && (*p != BOUNDARY_BYTE) && (*p != ESCAPE_BYTE)) {
+        ++p;
+    }
+    return (uint16_t)(p - buf);
 }
 
 void ClearSlippedBuffer(volatile AJ_SlippedBuffer* buf)
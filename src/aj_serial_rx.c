@@ -76,6 +76,7 @@ typedef struct _RX_PKT {
     uint8_t* buffer;
     uint16_t len;
     PKT_STATE state;
+    uint8_t seq;
     struct _RX_PKT volatile* next;
 } RX_PKT;
 
@@ -83,6 +84,8 @@ typedef struct _RX_PKT {
 static RX_PKT volatile* RxPacket;
 static RX_PKT volatile* RxRecv;
 static RX_PKT volatile* RxFreeList;
+/* Packets received ahead of a missing packet, in sequence order */
+static RX_PKT volatile* RxHeld;
 
 //Linked list of free buffers that can be used to recieve data.
 static AJ_SlippedBuffer volatile* bufferRxFreeList;
@@ -188,6 +191,8 @@ void AJ_SerialRX_Shutdown(void)
     RxFreeList = NULL;
     DeleteRxPacket(RxRecv);
     RxRecv = NULL;
+    DeleteRxPacket(RxHeld);
+    RxHeld = NULL;
 }
 
 /**
@@ -207,6 +212,7 @@ AJ_Status AJ_SerialRX_Init(void)
      */
     RxRecv = NULL;
     RxPacket = NULL;
+    RxHeld = NULL;
     pendingRecv = 0;
     expectedSeq = 0;
     dataReceived = 0;
@@ -293,6 +299,11 @@ AJ_Status AJ_SerialRX_Reset(void)
         RxRecv = RxRecv->next;
         AJ_SerialReturnPacketToFreeList(pkt);
     }
+    while (RxHeld != NULL) {
+        pkt = RxHeld;
+        RxHeld = RxHeld->next;
+        AJ_SerialReturnPacketToFreeList(pkt);
+    }
 
     AJ_DebugCheckPacketList(RxFreeList, "RxFreeList reset");
     AJ_DebugCheckPacketList(RxRecv, "RxRecv during reset");
@@ -351,7 +362,7 @@ AJ_Status AJ_SerialRecv(uint8_t* buffer,
 
             } else {
                 // move the data in the buffer over, then return from this function.
-                memmove(pkt->buffer + 4, pkt->buffer + 4 + num, pkt->len - num);
+                memmove(pkt->buffer + 4, pkt->buffer + 4 + num, pkt->len - 4 - num);
                 pkt->len -= num;
             }
         }
@@ -371,6 +382,80 @@ AJ_Status AJ_SerialRecv(uint8_t* buffer,
 }
 
 
+/*
+ * Hand the current packet to the upper layer and start a new one.
+ */
+static void DeliverPacket(RX_PKT volatile* pkt)
+{
+    RX_PKT volatile* last;
+
+    expectedSeq = (expectedSeq + 1) & AJ_SERIAL_SEQ_MASK;
+    /*
+     * Add to the end of the receive queue.
+     */
+    if (RxRecv == NULL) {
+        RxRecv = pkt;
+    } else {
+        last = RxRecv;
+        while (last->next != NULL) {
+            last = last->next;
+        }
+        last->next = pkt;
+    }
+    pkt->next = NULL;
+    ++pendingRecv; // we now have another packet enqueued.
+    AJ_SerialTx_ReceivedSeq(pkt->seq);
+}
+
+/*
+ * Keep a packet that arrived ahead of a missing one, unless it is already held.
+ */
+static void HoldPacket(uint8_t seq)
+{
+    RX_PKT volatile* pkt = RxPacket;
+    RX_PKT volatile* volatile* link = &RxHeld;
+    uint8_t rel = (seq - expectedSeq) & AJ_SERIAL_SEQ_MASK;
+
+    while ((*link != NULL) && (((*link)->seq - expectedSeq) & AJ_SERIAL_SEQ_MASK) < rel) {
+        link = &(*link)->next;
+    }
+    if ((*link != NULL) && ((*link)->seq == seq)) {
+        return;
+    }
+    if (RxFreeList == NULL) {
+        return;
+    }
+    pkt->seq = seq;
+    pkt->next = *link;
+    *link = pkt;
+    RxPacket = RxFreeList;
+    RxFreeList = RxFreeList->next;
+    RxPacket->next = NULL;
+}
+
+/*
+ * Send an explicit ACK that tells the peer which packets after the missing one are held.
+ */
+static void SendSack(void)
+{
+    RX_PKT volatile* pkt;
+    uint8_t sack[AJ_SERIAL_SACK_LEN];
+    uint32_t map = 0;
+
+    for (pkt = RxHeld; pkt != NULL; pkt = pkt->next) {
+        uint8_t rel = (pkt->seq - expectedSeq) & AJ_SERIAL_SEQ_MASK;
+        if ((rel >= 1) && (rel <= 32)) {
+            map |= 1UL << (rel - 1);
+        }
+    }
+    sack[0] = expectedSeq;
+    sack[1] = (uint8_t)(map >> 24);
+    sack[2] = (uint8_t)(map >> 16);
+    sack[3] = (uint8_t)(map >> 8);
+    sack[4] = (uint8_t)map;
+    AJ_SerialTX_EnqueueCtrl(sack, sizeof(sack), AJ_SERIAL_ACK);
+}
+
 /**
  * This function checks packet integrity and forwards good packets to the appropriate
  * upper-layer interface.
@@ -383,7 +468,6 @@ static void CompletePacket()
     uint8_t pktType;
     uint16_t expectedLen;
 
-    uint8_t checksum;
     uint8_t* rcvdCrc = &pkt->buffer[pkt->len - 2];
     uint8_t checkCrc[2];
     uint16_t crc = AJ_SERIAL_CRC_INIT;
@@ -413,8 +497,11 @@ static void CompletePacket()
     }
 
 
-    seq = (pkt->buffer[0] >> 4);
-    ack = pkt->buffer[0] & 0x0F;
+    /*
+     * SLAP version 2 extends the sequence and ack numbers with the upper bits of byte 1.
+     */
+    seq = (pkt->buffer[0] >> 4) | ((pkt->buffer[1] >> 6) << 4);
+    ack = (pkt->buffer[0] & 0x0F) | (((pkt->buffer[1] >> 4) & 0x03) << 4);
 
     pktType = pkt->buffer[1] & 0x0F;
 
@@ -451,15 +538,24 @@ static void CompletePacket()
      * Pass the ACK to the transmit side.
      */
     AJ_SerialTx_ReceivedAck(ack);
+    if ((pktType == AJ_SERIAL_ACK) && (expectedLen >= AJ_SERIAL_SACK_LEN) && AJ_SERIAL_SACK_ENABLED()) {
+        AJ_SerialTx_ReceivedSack(pkt->buffer + AJ_SERIAL_HDR_LEN);
+    }
 
     if (pktType == AJ_SERIAL_DATA) {
         /*
          * If a reliable packet does not have the expected sequence number, then
          * it is either a repeated packet or we missed a packet. In either case,
-         * we must ignore the packet but we need to ACK repeated packets.
+         * we must ignore the packet but we need to ACK repeated packets. A peer
+         * that supports selective acks is told about packets past the missing one
+         * which are held until the gap is filled.
          */
         if (seq != expectedSeq) {
-            if (SEQ_GT(seq, expectedSeq)) {
+            uint8_t rel = (seq - expectedSeq) & AJ_SERIAL_SEQ_MASK;
+            if (AJ_SERIAL_SACK_ENABLED() && (rel < AJ_SerialLinkParams.windowSize)) {
+                HoldPacket(seq);
+                SendSack();
+            } else if (SEQ_GT(seq, expectedSeq)) {
                 AJ_AlwaysPrintf(("Missing packet - expected = %d, got %d\n", expectedSeq, seq));
             } else {
                 AJ_AlwaysPrintf(("Repeated packet seq = %d, expected %d\n", seq, expectedSeq));
@@ -468,27 +564,22 @@ static void CompletePacket()
         } else {
             if (RxFreeList != NULL) {
                 // push the RxPacket on to the back of the RxRecv list.
-                RX_PKT volatile* last;
-                expectedSeq = (expectedSeq + 1) & 0x07;
+                pkt->seq = seq;
+                RxPacket = RxFreeList;
+                RxFreeList = RxFreeList->next;
+                RxPacket->next = NULL;
+                DeliverPacket(pkt);
                 /*
-                 * Add to the end of the receive queue.
+                 * Held packets that now follow in sequence can be delivered too.
                  */
-                if (RxRecv == NULL) {
-                    RxRecv = pkt;
-                } else {
-                    last = RxRecv;
-                    while (last->next != NULL) {
-                        last = last->next;
+                if (RxHeld != NULL) {
+                    while ((RxHeld != NULL) && (RxHeld->seq == expectedSeq)) {
+                        pkt = RxHeld;
+                        RxHeld = RxHeld->next;
+                        DeliverPacket(pkt);
                     }
-                    last->next = pkt;
+                    SendSack();
                 }
-                pkt->next = NULL;
-                RxPacket = RxFreeList;
-                RxFreeList = RxFreeList->next;
-                RxPacket->next = NULL;
-
-                ++pendingRecv; // we now have another packet enqueued.
-                AJ_SerialTx_ReceivedSeq(seq);
             }
         }
     }
@@ -504,9 +595,38 @@ static void CompletePacket()
 static uint32_t UART_RxComplete(uint8_t* buffer, uint16_t bytes)
 {
     uint8_t rx;
+    uint16_t run;
+    uint16_t room;
 
-    while (bytes-- > 0) {
+    while (bytes > 0) {
+        if (RxPacket->state == PACKET_OPEN) {
+            /*
+             * Copy the run of bytes up to the next boundary or escape byte in one go
+             */
+            run = AJ_SlipScan(buffer, bytes);
+            room = maxRxFrameSize - RxPacket->len;
+            if (run > room) {
+                /*
+                 * Packet overrun: discard the packet.
+                 */
+                memcpy(RxPacket->buffer + RxPacket->len, buffer, room);
+                RxPacket->len += room;
+                buffer += room + 1;
+                bytes -= room + 1;
+                RxPacket->state = PACKET_NEW;
+                AJ_AlwaysPrintf(("AJ_SerialRx_Receive: Packet overrun %d\n", RxPacket->len));
+                continue;
+            }
+            memcpy(RxPacket->buffer + RxPacket->len, buffer, run);
+            RxPacket->len += run;
+            buffer += run;
+            bytes -= run;
+            if (bytes == 0) {
+                break;
+            }
+        }
         rx = *buffer++;
+        --bytes;
         switch (RxPacket->state) {
         case PACKET_FLUSH:
             /*
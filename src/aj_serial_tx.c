@@ -45,6 +45,7 @@
 #include <ajtcl/aj_serial_tx.h>
 #include <ajtcl/aj_crc16.h>
 #include <ajtcl/aj_util.h>
+#include <ajtcl/aj_serio.h>
 #include <ajtcl/aj_debug.h>
 
 /**
@@ -69,6 +70,9 @@ typedef struct _TxPkt {
     uint8_t seq;
     uint8_t type;
     uint8_t* payload;
+    AJ_Time sent;       /* when the packet was first sent */
+    uint8_t resent;     /* packet was sent more than once so cannot be used to measure round trip time */
+    uint8_t sacked;     /* peer holds the packet but is waiting for an earlier one */
 } TxPkt;
 
 
@@ -122,6 +126,13 @@ static uint8_t currentTxAck;
 
 static uint8_t resendPrimed = FALSE;
 
+/**
+ * Round trip time estimate used to adapt the resend timeout, see RFC 6298
+ */
+static uint8_t rttMeasured;
+static uint32_t srtt8;      /* smoothed round trip time scaled by 8 */
+static uint32_t rttvar4;    /* round trip time variation scaled by 4 */
+
 /**
  * When to resend un-acked packets
  */
@@ -171,6 +182,7 @@ AJ_Status AJ_SerialTX_Init()
     txUnreliable = NULL;
     txSeqNum = 0;
     resendPrimed = FALSE;
+    rttMeasured = FALSE;
     pendingAcks = 0;
     currentTxAck = 0;
     dataSent = 1;
@@ -309,9 +321,60 @@ AJ_Status AJ_SerialTX_Reset(void)
     currentTxAck = 0;
     txSeqNum = 0;
     resendPrimed = FALSE;
+    rttMeasured = FALSE;
     return AJ_OK;
 }
 
+/**
+ * Move unacknowledged packets from txSent to the front of the transmit queue. Packets
+ * the peer has selectively acknowledged stay on txSent, as do packets that are more
+ * than limit sequence numbers past base. Unless again is set packets that have already
+ * been resent are also left alone.
+ */
+static void RequeueSent(uint8_t base, uint16_t limit, uint8_t again)
+{
+    TxPkt volatile* pkt = txSent;
+    TxPkt volatile* keep = NULL;
+    TxPkt volatile* resend = NULL;
+    TxPkt volatile* keepLast = NULL;
+    TxPkt volatile* resendLast = NULL;
+
+    while (pkt != NULL) {
+        TxPkt volatile* next = pkt->next;
+        pkt->next = NULL;
+        if (!pkt->sacked && (((pkt->seq - base) & AJ_SERIAL_SEQ_MASK) < limit) && (again || !pkt->resent)) {
+            pkt->resent = TRUE;
+            if (resendLast) {
+                resendLast->next = pkt;
+            } else {
+                resend = pkt;
+            }
+            resendLast = pkt;
+        } else {
+            if (keepLast) {
+                keepLast->next = pkt;
+            } else {
+                keep = pkt;
+            }
+            keepLast = pkt;
+        }
+        pkt = next;
+    }
+    txSent = keep;
+    if (resend != NULL) {
+        /*
+         * Put resend packets after the unreliable packet.
+         */
+        if (txQueue == txUnreliable) {
+            resendLast->next = txQueue->next;
+            txQueue->next = resend;
+        } else {
+            resendLast->next = txQueue;
+            txQueue = resend;
+        }
+    }
+}
+
 
 /**
  * This function is called if an acknowledgement is not received within the required
@@ -319,8 +382,6 @@ AJ_Status AJ_SerialTX_Reset(void)
  */
 void ResendPackets()
 {
-    TxPkt volatile* last;
-
     /*
      * Re-register the send timeout callback, it will not be primed until it
      * is needed.
@@ -337,25 +398,19 @@ void ResendPackets()
     }
     /*
      * To preserve packet order, all unacknowleged packets must be resent. This
-     * simply means moving packets on txSent to the head of txQueue.
+     * simply means moving packets on txSent to the head of txQueue. A peer that
+     * supports selective acks keeps the packets it has reported so those stay put.
      */
     if (txSent != NULL) {
-        last = txSent;
-        while (last->next != NULL) {
-            last = last->next;
-        }
         /*
-         * Put resend packets after the unreliable packet.
+         * Back off until acks start coming in again. Until a round trip time has been
+         * measured the peer may still be completing the handshake so keep the static
+         * timeout.
          */
-        if (txQueue == txUnreliable) {
-            last->next = txQueue->next;
-            txQueue->next = last;
-        } else {
-            last->next = txQueue;
-            txQueue = txSent;
+        if (rttMeasured) {
+            AJ_SerialLinkParams.txResendTimeout = min(AJ_SerialLinkParams.txResendTimeout * 2, AJ_SERIAL_MAX_RESEND_TIMEOUT);
         }
-
-        txSent = NULL;
+        RequeueSent(0, AJ_SERIAL_SEQ_MASK + 1, TRUE);
     }
 }
 
@@ -377,7 +432,12 @@ static void QueueUnreliable(void)
      * the unreliable packet to get queued twice.
      */
     if (txQueue == txUnreliable) {
-        AJ_AlwaysPrintf(("QueueUnreliable: type %i unreliable packet already queued! %p\n", txUnreliable->type, txUnreliable));
+        /*
+         * An ACK replacing an earlier ACK is expected when selective acks are sent.
+         */
+        if (txUnreliable->type != AJ_SERIAL_ACK) {
+            AJ_AlwaysPrintf(("QueueUnreliable: type %i unreliable packet already queued! %p\n", txUnreliable->type, txUnreliable));
+        }
     } else {
         txUnreliable->next = txQueue;
         txQueue = txUnreliable;
@@ -397,7 +457,7 @@ static void QueueReliable(TxPkt volatile* pkt)
     /*
      * updates sequence number
      */
-    txSeqNum = (txSeqNum + 1) & 0x7;
+    txSeqNum = (txSeqNum + 1) & AJ_SERIAL_SEQ_MASK;
     /*
      * Add to the end of the transmit queue.
      */
@@ -440,6 +500,8 @@ AJ_Status AJ_SerialSend(uint8_t* buffer,
             txFreeList = txFreeList->next;
             pkt->type = AJ_SERIAL_DATA;
             pkt->len  = num;
+            pkt->resent = FALSE;
+            pkt->sacked = FALSE;
             memcpy(pkt->payload, buffer + (bufLen - len), num);
 
             QueueReliable(pkt);
@@ -471,26 +533,37 @@ static uint16_t SlipBytes(AJ_SlippedBuffer volatile* slip,
                           uint8_t* data,
                           uint16_t len)
 {
-    uint16_t i;
+    uint16_t i = 0;
+    uint16_t run;
+    uint16_t room;
     uint8_t b;
 
-    for (i = 0; i < len; ++i) {
-        if (slip->actualLen == slip->allocatedLen) {
+    while (i < len) {
+        room = slip->allocatedLen - slip->actualLen;
+        if (room == 0) {
             AJ_ASSERT(FALSE);
             break;
         }
-        b = *data++;
-        if ((b == BOUNDARY_BYTE) || (b == ESCAPE_BYTE)) {
-            /*
-             * need room for two bytes
-             */
-            if ((slip->actualLen + 1) == slip->allocatedLen) {
-                break;
-            }
-            slip->buffer[slip->actualLen++] = ESCAPE_BYTE;
-            b = (b == ESCAPE_BYTE) ? ESCAPE_SUBSTITUTE : BOUNDARY_SUBSTITUTE;
+        /*
+         * Copy the run of bytes that need no escaping in one go
+         */
+        run = AJ_SlipScan(data + i, len - i);
+        if (run) {
+            run = min(run, room);
+            memcpy(slip->buffer + slip->actualLen, data + i, run);
+            slip->actualLen += run;
+            i += run;
+            continue;
         }
-        slip->buffer[slip->actualLen++] = b;
+        /*
+         * need room for two bytes
+         */
+        if (room == 1) {
+            break;
+        }
+        b = data[i++];
+        slip->buffer[slip->actualLen++] = ESCAPE_BYTE;
+        slip->buffer[slip->actualLen++] = (b == ESCAPE_BYTE) ? ESCAPE_SUBSTITUTE : BOUNDARY_SUBSTITUTE;
     }
     return i;
 }
@@ -539,7 +612,15 @@ void ConvertPacketToBytes(AJ_SlippedBuffer volatile* slip, TxPkt volatile* txCur
             AJ_ASSERT(FALSE);
         }
 
-        header[0] = (txCurrent->seq << 4);
+        /*
+         * The low four bits of the sequence number go in the high nibble of byte 0, the
+         * two high bits (always zero for a legacy peer) in the top of byte 1.
+         */
+        header[0] = (txCurrent->seq & 0x0F) << 4;
+        header[1] |= (txCurrent->seq >> 4) << 6;
+        if (!txCurrent->resent) {
+            AJ_InitTimer((AJ_Time*)&txCurrent->sent);
+        }
 //                AJ_AlwaysPrintf("Tx seq %d, ack %d\n",  txCurrent->seq, currentTxAck);
     } else {
         header[0] = 0;
@@ -551,6 +632,7 @@ void ConvertPacketToBytes(AJ_SlippedBuffer volatile* slip, TxPkt volatile* txCur
     if (txCurrent->type != AJ_SERIAL_CTRL) {
         // Acknowledge the last packet received.
         header[0] |= (currentTxAck & 0x0F);
+        header[1] |= (currentTxAck >> 4) << 4;
         /*
          * If there was an ACK backlog, we halt the explicit ACK timeout.
          */
@@ -577,54 +659,133 @@ void ConvertPacketToBytes(AJ_SlippedBuffer volatile* slip, TxPkt volatile* txCur
 }
 
 
+/*
+ * Adapt the resend timeout to a new round trip time sample.
+ */
+static void UpdateResendTimeout(uint32_t rtt)
+{
+    uint32_t rto;
+
+    if (!rttMeasured) {
+        srtt8 = rtt << 3;
+        rttvar4 = rtt << 1;
+        rttMeasured = TRUE;
+    } else {
+        int32_t delta = (int32_t)rtt - (int32_t)(srtt8 >> 3);
+        srtt8 = (uint32_t)((int32_t)srtt8 + delta);
+        if (delta < 0) {
+            delta = -delta;
+        }
+        rttvar4 = rttvar4 + (uint32_t)delta - (rttvar4 >> 2);
+    }
+    rto = (srtt8 >> 3) + max(rttvar4, 1);
+    /*
+     * The peer is allowed to hold an ack for up to the ack timeout.
+     */
+    rto = max(rto, AJ_SerialLinkParams.txAckTimeout + AJ_SERIAL_MIN_RESEND_TIMEOUT);
+    AJ_SerialLinkParams.txResendTimeout = min(rto, AJ_SERIAL_MAX_RESEND_TIMEOUT);
+}
+
+/*
+ * Return the data packets on a list that are acknowledged by ack to the free list.
+ * The round trip time of the most recently sent packet that was only sent once is
+ * returned in rtt.
+ */
+static uint8_t FreeAcked(TxPkt volatile* volatile* link, uint8_t ack, uint32_t* rtt)
+{
+    TxPkt volatile* pkt;
+    uint8_t acked = FALSE;
+    uint8_t newest = AJ_SERIAL_SEQ_MASK + 1;
+
+    while ((pkt = *link) != NULL) {
+        if ((pkt->type == AJ_SERIAL_DATA) && SEQ_GT(ack, pkt->seq)) {
+            *link = pkt->next;
+            //AJ_AlwaysPrintf("Releasing seq=%d (acked by %d)\n", pkt->seq, ack);
+            if (!pkt->resent) {
+                uint8_t age = (ack - 1 - pkt->seq) & AJ_SERIAL_SEQ_MASK;
+                if (age < newest) {
+                    newest = age;
+                    *rtt = AJ_GetElapsedTime((AJ_Time*)&pkt->sent, TRUE);
+                }
+            }
+            /*
+             * Return pkt to ACL free list.
+             */
+            pkt->next = txFreeList;
+            txFreeList = pkt;
+            acked = TRUE;
+        } else {
+            link = &pkt->next;
+        }
+    }
+    return acked;
+}
+
 /**
  * This function is called by the receive layer when a data packet or an explicit ACK
- * has been received. The ACK value is one greater (modulo 8) than the seq number of the
- * last packet successfully received.
+ * has been received. The ACK value is one greater (modulo the sequence space) than the
+ * seq number of the last packet successfully received.
  */
 void AJ_SerialTx_ReceivedAck(uint8_t ack)
 {
-    TxPkt volatile* ackedPkt = NULL;
+    uint32_t rtt = AJ_TIMER_FOREVER;
+    uint8_t acked;
 
     if (txSent == NULL) {
         return;
     }
 
     /*
-     * Remove acknowledged packets from sent queue.
+     * Remove acknowledged packets from sent queue and any that were queued for resend.
      */
-    while ((txSent != NULL) && SEQ_GT(ack, txSent->seq)) {
-        ackedPkt = txSent;
-        txSent = txSent->next;
-        //AJ_AlwaysPrintf("Releasing seq=%d (acked by %d)\n", ackedPkt->seq, ack);
-
-        AJ_ASSERT(ackedPkt->type == AJ_SERIAL_DATA);
-        /*
-         * Return pkt to ACL free list.
-         */
-        ackedPkt->next = txFreeList;
-        txFreeList = ackedPkt;
-
-        /*
-         * If all packet have been ack'd, halt the resend timer and return.
-         */
-        if (txSent == NULL) {
-            AJ_InitTimer(&resendTime);
-            AJ_TimeAddOffset(&resendTime, AJ_TIMER_FOREVER);
-            resendPrimed = FALSE;
-            return;
-        }
+    acked = FreeAcked(&txSent, ack, &rtt);
+    acked |= FreeAcked(&txQueue, ack, &rtt);
+    if (rtt != AJ_TIMER_FOREVER) {
+        UpdateResendTimeout(rtt);
+    }
+    /*
+     * If all packet have been ack'd, halt the resend timer.
+     */
+    if (txSent == NULL) {
+        AJ_InitTimer(&resendTime);
+        AJ_TimeAddOffset(&resendTime, AJ_TIMER_FOREVER);
+        resendPrimed = FALSE;
+        return;
     }
     /*
      * Reset the resend timer if one or more packets were ack'd.
      */
-    if (ackedPkt != NULL) {
+    if (acked) {
         AJ_InitTimer(&resendTime);
         AJ_TimeAddOffset(&resendTime, AJ_SerialLinkParams.txResendTimeout);
         resendPrimed = TRUE;
     }
 }
 
+/**
+ * This function is called by the receive layer when an explicit ACK carries a selective
+ * ack. The packets before the highest one the peer reported are resent immediately rather
+ * than waiting for the resend timer.
+ */
+void AJ_SerialTx_ReceivedSack(const uint8_t* sack)
+{
+    TxPkt volatile* pkt;
+    uint8_t base = sack[0];
+    uint32_t map = ((uint32_t)sack[1] << 24) | ((uint32_t)sack[2] << 16) | ((uint32_t)sack[3] << 8) | sack[4];
+    uint8_t highest = 0;
+
+    for (pkt = txSent; pkt != NULL; pkt = pkt->next) {
+        uint8_t rel = (pkt->seq - base) & AJ_SERIAL_SEQ_MASK;
+        if ((rel >= 1) && (rel <= 32) && (map & (1UL << (rel - 1)))) {
+            pkt->sacked = TRUE;
+            highest = max(highest, rel);
+        }
+    }
+    if (highest) {
+        RequeueSent(base, highest, FALSE);
+    }
+}
+
 
 /*
  * Send a explicit ACK (acknowledgement).
@@ -654,7 +815,7 @@ void AJ_SerialTx_ReceivedSeq(uint8_t seq)
      * the ack count.
      */
     if (!SEQ_GT(currentTxAck, seq)) {
-        currentTxAck = (seq + 1) & 0x7;
+        currentTxAck = (seq + 1) & AJ_SERIAL_SEQ_MASK;
     }
 
 #ifdef ALWAYS_ACK
@@ -675,9 +836,10 @@ void AJ_SerialTx_ReceivedSeq(uint8_t seq)
     }
 
     /*
-     * If we have hit our pending ACK limit send a explicit ACK packet immediately.
+     * If we have hit our pending ACK limit send a explicit ACK packet immediately. With
+     * large windows waiting for the whole window would stall the sender so ack at half.
      */
-    if (pendingAcks == AJ_SerialLinkParams.windowSize) {
+    if (pendingAcks == (AJ_SERIAL_SACK_ENABLED() ? (AJ_SerialLinkParams.windowSize + 1) / 2 : AJ_SerialLinkParams.windowSize)) {
         AJ_SerialTX_EnqueueCtrl(NULL, 0, AJ_SERIAL_ACK);
     }
 #endif
@@ -712,6 +874,13 @@ void AJ_FillTxBufferList()
     while (bufferTxFreeList && txQueue) {
         // Pull the head off the queue.
         TxPkt volatile* txCurrent;
+
+        /*
+         * Data packets have to wait for space in the negotiated window.
+         */
+        if ((txQueue->type == AJ_SERIAL_DATA) && (txSentPending() >= AJ_SerialLinkParams.windowSize)) {
+            break;
+        }
         currentSlippedBuffer = bufferTxFreeList;
         bufferTxFreeList = bufferTxFreeList->next;
         currentSlippedBuffer->next  = NULL;
@@ -740,7 +909,7 @@ void AJ_FillTxBufferList()
             if (!resendPrimed) {
                 AJ_InitTimer(&resendTime);
                 AJ_TimeAddOffset(&resendTime, AJ_SerialLinkParams.txResendTimeout);
-                resendPrimed = FALSE;
+                resendPrimed = TRUE;
             }
         }
         AJ_PauseTX();
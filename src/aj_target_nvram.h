@@ -98,4 +98,22 @@ uint8_t* _AJ_GetNVBlockBase(AJ_NVRAM_Block_Id blockId);
 uint8_t* _AJ_GetNVBlockEnd(AJ_NVRAM_Block_Id blockId);
 uint32_t _AJ_GetNVBlockSize(AJ_NVRAM_Block_Id blockId);
 
+/**
+ * Discard the NVRAM entry index (see AJ_NVRAM_INDEX_SIZE). The target calls this whenever entries
+ * are erased or moved other than by AJ_NVRAM_Create() or AJ_NVRAM_Delete(), that is when the NVRAM
+ * is initialized, cleared or compacted. The index is rebuilt the next time it is needed.
+ */
+void _AJ_InvalidateNVIndex(void);
+
+/**
+ * Get a count of the entries created and deleted in the NVRAM block that holds an id. The count
+ * changes whenever the set of entries in the block may have changed so callers can tell whether
+ * information they cached about the entries is still current.
+ *
+ * @param id  An NVRAM id in the block
+ *
+ * @return The change count for the block
+ */
+uint32_t _AJ_GetNVChangeCount(uint16_t id);
+
 #endif
\ No newline at end of file
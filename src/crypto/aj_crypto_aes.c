@@ -104,12 +104,11 @@ static void CBC_MAC(const uint8_t* key, const uint8_t* in, uint32_t len, CCM_Con
 }
 
 /**
- * Compute the AES-CCM authentication tag.
+ * Start the AES-CCM authentication tag, the message data is added to the tag by AJ_AES_CCM_128
  */
 static void Compute_CCM_AuthTag(const uint8_t* key,
                                 CCM_Context* context,
                                 const uint8_t* msg,
-                                uint32_t mLen,
                                 uint32_t hdrLen)
 {
     /*
@@ -146,15 +145,7 @@ static void Compute_CCM_AuthTag(const uint8_t* key,
          * Continue computing the CBC-MAC
          */
         CBC_MAC(key, msg, hdrLen, context);
-        msg += hdrLen;
     }
-    /*
-     * Continue computing CBC-MAC over the message data.
-     */
-    if (mLen) {
-        CBC_MAC(key, msg, mLen, context);
-    }
-    Trace("CBC-MAC", context->T.data, context->M);
 }
 
 static CCM_Context* InitCCMContext(const uint8_t* nonce, uint32_t nLen, uint32_t hdrLen, uint32_t msgLen, uint8_t M)
@@ -189,63 +180,67 @@ static CCM_Context* InitCCMContext(const uint8_t* nonce, uint32_t nLen, uint32_t
 }
 
 /*
- * Implements AES-CCM (Counter with CBC-MAC) encryption as described in RFC 3610
+ * Implements AES-CCM (Counter with CBC-MAC) encryption as described in RFC 3610. AES must already
+ * be enabled with the key, the key argument is only passed through to the block functions.
  */
-AJ_Status AJ_Encrypt_CCM(const uint8_t* key,
-                         uint8_t* msg,
-                         uint32_t msgLen,
-                         uint32_t hdrLen,
-                         uint8_t tagLen,
-                         const uint8_t* nonce,
-                         uint32_t nLen)
+static AJ_Status EncryptCCM(const uint8_t* key,
+                            uint8_t* msg,
+                            uint32_t msgLen,
+                            uint32_t hdrLen,
+                            uint8_t tagLen,
+                            const uint8_t* nonce,
+                            uint32_t nLen)
 {
-    AJ_Status status = AJ_OK;
     CCM_Context* context;
+    uint8_t i;
 
     if (!(context = InitCCMContext(nonce, nLen, hdrLen, msgLen, tagLen))) {
         AJ_ErrPrintf(("AJ_Encrypt_CCM(): AJ_ERR_RESOURCES\n"));
         return AJ_ERR_RESOURCES;
     }
     /*
-     * Do any platform specific operations to enable AES
-     */
-    AJ_AES_Enable(key);
-    /*
-     * Compute the authentication tag
+     * Start the authentication tag with the B_0 block and the header
      */
-    Compute_CCM_AuthTag(key, context, msg, msgLen - hdrLen, hdrLen);
+    Compute_CCM_AuthTag(key, context, msg, hdrLen);
     /*
-     * Encrypt the authentication tag
+     * The first counter block encrypts the authentication tag, it is saved in the working block
+     * because the tag is not known until the message has been processed.
      */
-    AJ_AES_CTR_128(key, context->T.data, msg + msgLen, tagLen, context->ivec.data);
+    ZERO(context->A);
+    AJ_AES_CTR_128(key, context->A.data, context->A.data, AJ_BLOCKSZ, context->ivec.data);
     Trace("CTR Start", context->ivec.data, AJ_BLOCKSZ);
     /*
-     * Encrypt the message
+     * Compute the authentication tag and encrypt the message in a single pass
      */
     if (msgLen != hdrLen) {
-        AJ_AES_CTR_128(key, msg + hdrLen, msg + hdrLen, msgLen - hdrLen, context->ivec.data);
+        AJ_AES_CCM_128(key, msg + hdrLen, msgLen - hdrLen, context->ivec.data, context->ivec0.data, FALSE);
     }
+    Trace("CBC-MAC", context->ivec0.data, AJ_BLOCKSZ);
     /*
-     * Balance the enable call above
+     * Encrypt the authentication tag
      */
-    AJ_AES_Disable();
+    for (i = 0; i < tagLen; ++i) {
+        msg[msgLen + i] = context->ivec0.data[i] ^ context->A.data[i];
+    }
+    ZERO(context->A);
     /*
      * Done with the context
      */
     AJ_Free(context);
-    return status;
+    return AJ_OK;
 }
 
 /*
- * Implements AES-CCM (Counter with CBC-MAC) decryption as described in RFC 3610
+ * Implements AES-CCM (Counter with CBC-MAC) decryption as described in RFC 3610. AES must already
+ * be enabled with the key, the key argument is only passed through to the block functions.
  */
-AJ_Status AJ_Decrypt_CCM(const uint8_t* key,
-                         uint8_t* msg,
-                         uint32_t msgLen,
-                         uint32_t hdrLen,
-                         uint8_t tagLen,
-                         const uint8_t* nonce,
-                         uint32_t nLen)
+static AJ_Status DecryptCCM(const uint8_t* key,
+                            uint8_t* msg,
+                            uint32_t msgLen,
+                            uint32_t hdrLen,
+                            uint8_t tagLen,
+                            const uint8_t* nonce,
+                            uint32_t nLen)
 {
     AJ_Status status = AJ_OK;
     CCM_Context* context;
@@ -254,29 +249,25 @@ AJ_Status AJ_Decrypt_CCM(const uint8_t* key,
         AJ_ErrPrintf(("AJ_Decrypt_CCM(): AJ_ERR_RESOURCES\n"));
         return AJ_ERR_RESOURCES;
     }
-    /*
-     * Do any platform specific operations to enable AES
-     */
-    AJ_AES_Enable(key);
     /*
      * Decrypt the authentication field
      */
     AJ_AES_CTR_128(key, msg + msgLen, msg + msgLen, tagLen, context->ivec.data);
     /*
-     * Decrypt message.
+     * Start the authentication tag with the B_0 block and the header
      */
-    if (msgLen != hdrLen) {
-        AJ_AES_CTR_128(key, msg + hdrLen, msg + hdrLen, msgLen - hdrLen, context->ivec.data);
-    }
+    Compute_CCM_AuthTag(key, context, msg, hdrLen);
     /*
-     * Compute and verify the authentication tag T.
+     * Decrypt the message and complete the authentication tag in a single pass
      */
-    Compute_CCM_AuthTag(key, context, msg, msgLen - hdrLen, hdrLen);
+    if (msgLen != hdrLen) {
+        AJ_AES_CCM_128(key, msg + hdrLen, msgLen - hdrLen, context->ivec.data, context->ivec0.data, TRUE);
+    }
+    Trace("CBC-MAC", context->ivec0.data, AJ_BLOCKSZ);
     /*
-     * Balance the enable call above
+     * Verify the authentication tag T.
      */
-    AJ_AES_Disable();
-    if (AJ_Crypto_Compare(context->T.data, msg + msgLen, tagLen) != 0) {
+    if (AJ_Crypto_Compare(context->ivec0.data, msg + msgLen, tagLen) != 0) {
         /*
          * Authentication failed Clear the decrypted data
          */
@@ -290,3 +281,196 @@ AJ_Status AJ_Decrypt_CCM(const uint8_t* key,
     AJ_Free(context);
     return status;
 }
+
+AJ_Status AJ_Encrypt_CCM(const uint8_t* key,
+                         uint8_t* msg,
+                         uint32_t msgLen,
+                         uint32_t hdrLen,
+                         uint8_t tagLen,
+                         const uint8_t* nonce,
+                         uint32_t nLen)
+{
+    AJ_Status status;
+
+    /*
+     * Do any platform specific operations to enable AES
+     */
+    AJ_AES_Enable(key);
+    status = EncryptCCM(key, msg, msgLen, hdrLen, tagLen, nonce, nLen);
+    /*
+     * Balance the enable call above
+     */
+    AJ_AES_Disable();
+    return status;
+}
+
+AJ_Status AJ_Decrypt_CCM(const uint8_t* key,
+                         uint8_t* msg,
+                         uint32_t msgLen,
+                         uint32_t hdrLen,
+                         uint8_t tagLen,
+                         const uint8_t* nonce,
+                         uint32_t nLen)
+{
+    AJ_Status status;
+
+    AJ_AES_Enable(key);
+    status = DecryptCCM(key, msg, msgLen, hdrLen, tagLen, nonce, nLen);
+    AJ_AES_Disable();
+    return status;
+}
+
+AJ_Status AJ_Encrypt_CCM_Key(const AJ_AES_Key* aesKey,
+                             uint8_t* msg,
+                             uint32_t msgLen,
+                             uint32_t hdrLen,
+                             uint8_t tagLen,
+                             const uint8_t* nonce,
+                             uint32_t nLen)
+{
+    AJ_Status status;
+
+    /*
+     * The key has already been expanded so the raw key is not available to the block functions
+     */
+    AJ_AES_EnableKey(aesKey);
+    status = EncryptCCM(NULL, msg, msgLen, hdrLen, tagLen, nonce, nLen);
+    AJ_AES_Disable();
+    return status;
+}
+
+AJ_Status AJ_Decrypt_CCM_Key(const AJ_AES_Key* aesKey,
+                             uint8_t* msg,
+                             uint32_t msgLen,
+                             uint32_t hdrLen,
+                             uint8_t tagLen,
+                             const uint8_t* nonce,
+                             uint32_t nLen)
+{
+    AJ_Status status;
+
+    AJ_AES_EnableKey(aesKey);
+    status = DecryptCCM(NULL, msg, msgLen, hdrLen, tagLen, nonce, nLen);
+    AJ_AES_Disable();
+    return status;
+}
+
+/*
+ * Process bytes of a block that is split across pieces
+ */
+static uint32_t StreamBytes(AJ_CCM_Stream* ccm, uint8_t* data, uint32_t len)
+{
+    uint32_t n = 0;
+
+    while ((n < len) && (ccm->pos < AJ_BLOCKSZ)) {
+        uint8_t b = data[n];
+        data[n] = b ^ ccm->ks[ccm->pos];
+        ccm->mb[ccm->pos++] = ccm->decrypt ? data[n] : b;
+        ++n;
+    }
+    if (ccm->pos == AJ_BLOCKSZ) {
+        AJ_AES_CBC_128_ENCRYPT(NULL, ccm->mb, ccm->ks, AJ_BLOCKSZ, ccm->mac);
+        ccm->pos = 0;
+    }
+    return n;
+}
+
+AJ_Status AJ_CCM_Start(AJ_CCM_Stream* ccm,
+                       const AJ_AES_Key* aesKey,
+                       const uint8_t* hdr,
+                       uint32_t msgLen,
+                       uint32_t hdrLen,
+                       uint8_t tagLen,
+                       const uint8_t* nonce,
+                       uint32_t nLen,
+                       uint8_t decrypt)
+{
+    CCM_Context* context;
+
+    if (!(context = InitCCMContext(nonce, nLen, hdrLen, msgLen, tagLen))) {
+        AJ_ErrPrintf(("AJ_CCM_Start(): AJ_ERR_RESOURCES\n"));
+        return AJ_ERR_RESOURCES;
+    }
+    memset(ccm, 0, sizeof(AJ_CCM_Stream));
+    memcpy(&ccm->key, aesKey, sizeof(AJ_AES_Key));
+    ccm->tagLen = tagLen;
+    ccm->decrypt = decrypt;
+
+    AJ_AES_EnableKey(&ccm->key);
+    Compute_CCM_AuthTag(NULL, context, hdr, hdrLen);
+    ZERO(context->A);
+    AJ_AES_CTR_128(NULL, context->A.data, context->A.data, AJ_BLOCKSZ, context->ivec.data);
+    AJ_AES_Disable();
+
+    memcpy(ccm->ctr, context->ivec.data, AJ_BLOCKSZ);
+    memcpy(ccm->mac, context->ivec0.data, AJ_BLOCKSZ);
+    memcpy(ccm->s0, context->A.data, AJ_BLOCKSZ);
+    AJ_MemZeroSecure(context, sizeof(CCM_Context));
+    AJ_Free(context);
+    return AJ_OK;
+}
+
+void AJ_CCM_Update(AJ_CCM_Stream* ccm, uint8_t* data, uint32_t len)
+{
+    uint32_t n;
+
+    AJ_AES_EnableKey(&ccm->key);
+    /*
+     * Finish a block that was started by the previous piece
+     */
+    if (ccm->pos) {
+        n = StreamBytes(ccm, data, len);
+        data += n;
+        len -= n;
+    }
+    /*
+     * Whole blocks go through the single pass implementation
+     */
+    n = len & ~(AJ_BLOCKSZ - 1);
+    if (n) {
+        AJ_AES_CCM_128(NULL, data, n, ccm->ctr, ccm->mac, ccm->decrypt);
+        data += n;
+        len -= n;
+    }
+    /*
+     * Start a block that will be finished by the next piece
+     */
+    if (len) {
+        memset(ccm->ks, 0, AJ_BLOCKSZ);
+        memset(ccm->mb, 0, AJ_BLOCKSZ);
+        AJ_AES_CTR_128(NULL, ccm->ks, ccm->ks, AJ_BLOCKSZ, ccm->ctr);
+        StreamBytes(ccm, data, len);
+    }
+    AJ_AES_Disable();
+}
+
+AJ_Status AJ_CCM_Final(AJ_CCM_Stream* ccm, uint8_t* tag)
+{
+    AJ_Status status = AJ_OK;
+    uint8_t i;
+
+    /*
+     * A trailing partial block is zero padded for the MAC
+     */
+    if (ccm->pos) {
+        AJ_AES_EnableKey(&ccm->key);
+        AJ_AES_CBC_128_ENCRYPT(NULL, ccm->mb, ccm->ks, AJ_BLOCKSZ, ccm->mac);
+        AJ_AES_Disable();
+    }
+    Trace("CBC-MAC", ccm->mac, AJ_BLOCKSZ);
+    if (ccm->decrypt) {
+        for (i = 0; i < ccm->tagLen; ++i) {
+            ccm->s0[i] ^= tag[i];
+        }
+        if (AJ_Crypto_Compare(ccm->mac, ccm->s0, ccm->tagLen) != 0) {
+            AJ_ErrPrintf(("AJ_CCM_Final(): AJ_ERR_SECURITY\n"));
+            status = AJ_ERR_SECURITY;
+        }
+    } else {
+        for (i = 0; i < ccm->tagLen; ++i) {
+            tag[i] = ccm->mac[i] ^ ccm->s0[i];
+        }
+    }
+    AJ_MemZeroSecure(ccm, sizeof(AJ_CCM_Stream));
+    return status;
+}
@@ -0,0 +1,625 @@
+/**
+ * @file
+ */
+/******************************************************************************
+ *    Copyright (c) Open Connectivity Foundation (OCF), AllJoyn Open Source
+ *    Project (AJOSP) Contributors and others.
+ *
+ *    SPDX-License-Identifier: Apache-2.0
+ *
+ *    All rights reserved. This program and the accompanying materials are
+ *    made available under the terms of the Apache License, Version 2.0
+ *    which accompanies this distribution, and is available at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Copyright (c) Open Connectivity Foundation and Contributors to AllSeen
+ *    Alliance. All rights reserved.
+ *
+ *    Permission to use, copy, modify, and/or distribute this software for
+ *    any purpose with or without fee is hereby granted, provided that the
+ *    above copyright notice and this permission notice appear in all
+ *    copies.
+ *
+ *    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ *    WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+ *    WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+ *    AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+ *    DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR
+ *    PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ *    TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ *    PERFORMANCE OF THIS SOFTWARE.
+ ******************************************************************************/
+
+#include <ajtcl/aj_target.h>
+#include <ajtcl/aj_crypto.h>
+#include <ajtcl/aj_crypto_aes_priv.h>
+#include <ajtcl/aj_util.h>
+#include <ajtcl/aj_config.h>
+
+#if AJ_AES_CT
+
+/*
+ * Constant-time AES-128 using a bitsliced representation. Two blocks are processed at a time, the
+ * 256 bits of state are spread across eight 32 bit words so that word i holds bit i of every byte.
+ * The S-box is computed with logic operations (Boyar-Peralta circuit) so there are no memory
+ * accesses that depend on the key or the data.
+ *
+ * The expanded key holds the standard key schedule followed by the bitsliced round keys.
+ */
+#define ROUNDS        10
+#define STD_SCHEDULE  0
+#define BS_SCHEDULE   48
+
+static AJ_THREAD_LOCAL AJ_AES_Key aes_context;
+
+/*
+ * The key used by the block functions, either aes_context or a key passed to AJ_AES_EnableKey
+ */
+static AJ_THREAD_LOCAL const uint32_t* aes_fkey;
+
+static uint32_t Dec32le(const uint8_t* p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void Enc32le(uint8_t* p, uint32_t x)
+{
+    p[0] = (uint8_t)x;
+    p[1] = (uint8_t)(x >> 8);
+    p[2] = (uint8_t)(x >> 16);
+    p[3] = (uint8_t)(x >> 24);
+}
+
+/*
+ * Converts between the normal and bitsliced representations, this transform is its own inverse
+ */
+#define SWAPN(cl, ch, s, x, y) \
+    do { \
+        uint32_t a_ = (x); \
+        uint32_t b_ = (y); \
+        (x) = (a_ & (uint32_t)(cl)) | ((b_ & (uint32_t)(cl)) << (s)); \
+        (y) = ((a_ & (uint32_t)(ch)) >> (s)) | (b_ & (uint32_t)(ch)); \
+    } while (0)
+
+static void Ortho(uint32_t* q)
+{
+    SWAPN(0x55555555, 0xAAAAAAAA, 1, q[0], q[1]);
+    SWAPN(0x55555555, 0xAAAAAAAA, 1, q[2], q[3]);
+    SWAPN(0x55555555, 0xAAAAAAAA, 1, q[4], q[5]);
+    SWAPN(0x55555555, 0xAAAAAAAA, 1, q[6], q[7]);
+
+    SWAPN(0x33333333, 0xCCCCCCCC, 2, q[0], q[2]);
+    SWAPN(0x33333333, 0xCCCCCCCC, 2, q[1], q[3]);
+    SWAPN(0x33333333, 0xCCCCCCCC, 2, q[4], q[6]);
+    SWAPN(0x33333333, 0xCCCCCCCC, 2, q[5], q[7]);
+
+    SWAPN(0x0F0F0F0F, 0xF0F0F0F0, 4, q[0], q[4]);
+    SWAPN(0x0F0F0F0F, 0xF0F0F0F0, 4, q[1], q[5]);
+    SWAPN(0x0F0F0F0F, 0xF0F0F0F0, 4, q[2], q[6]);
+    SWAPN(0x0F0F0F0F, 0xF0F0F0F0, 4, q[3], q[7]);
+}
+
+/*
+ * The AES S-box as a circuit of 113 logic gates, from Boyar and Peralta, "A depth-16 circuit for
+ * the AES S-box".
+ */
+static void SubBytes(uint32_t* q)
+{
+    uint32_t x0, x1, x2, x3, x4, x5, x6, x7;
+    uint32_t y1, y2, y3, y4, y5, y6, y7, y8, y9;
+    uint32_t y10, y11, y12, y13, y14, y15, y16, y17, y18, y19;
+    uint32_t y20, y21;
+    uint32_t z0, z1, z2, z3, z4, z5, z6, z7, z8, z9;
+    uint32_t z10, z11, z12, z13, z14, z15, z16, z17;
+    uint32_t t0, t1, t2, t3, t4, t5, t6, t7, t8, t9;
+    uint32_t t10, t11, t12, t13, t14, t15, t16, t17, t18, t19;
+    uint32_t t20, t21, t22, t23, t24, t25, t26, t27, t28, t29;
+    uint32_t t30, t31, t32, t33, t34, t35, t36, t37, t38, t39;
+    uint32_t t40, t41, t42, t43, t44, t45, t46, t47, t48, t49;
+    uint32_t t50, t51, t52, t53, t54, t55, t56, t57, t58, t59;
+    uint32_t t60, t61, t62, t63, t64, t65, t66, t67;
+    uint32_t s0, s1, s2, s3, s4, s5, s6, s7;
+
+    x0 = q[7];
+    x1 = q[6];
+    x2 = q[5];
+    x3 = q[4];
+    x4 = q[3];
+    x5 = q[2];
+    x6 = q[1];
+    x7 = q[0];
+
+    /*
+     * Top linear transformation
+     */
+    y14 = x3 ^ x5;
+    y13 = x0 ^ x6;
+    y9 = x0 ^ x3;
+    y8 = x0 ^ x5;
+    t0 = x1 ^ x2;
+    y1 = t0 ^ x7;
+    y4 = y1 ^ x3;
+    y12 = y13 ^ y14;
+    y2 = y1 ^ x0;
+    y5 = y1 ^ x6;
+    y3 = y5 ^ y8;
+    t1 = x4 ^ y12;
+    y15 = t1 ^ x5;
+    y20 = t1 ^ x1;
+    y6 = y15 ^ x7;
+    y10 = y15 ^ t0;
+    y11 = y20 ^ y9;
+    y7 = x7 ^ y11;
+    y17 = y10 ^ y11;
+    y19 = y10 ^ y8;
+    y16 = t0 ^ y11;
+    y21 = y13 ^ y16;
+    y18 = x0 ^ y16;
+
+    /*
+     * Non-linear section
+     */
+    t2 = y12 & y15;
+    t3 = y3 & y6;
+    t4 = t3 ^ t2;
+    t5 = y4 & x7;
+    t6 = t5 ^ t2;
+    t7 = y13 & y16;
+    t8 = y5 & y1;
+    t9 = t8 ^ t7;
+    t10 = y2 & y7;
+    t11 = t10 ^ t7;
+    t12 = y9 & y11;
+    t13 = y14 & y17;
+    t14 = t13 ^ t12;
+    t15 = y8 & y10;
+    t16 = t15 ^ t12;
+    t17 = t4 ^ t14;
+    t18 = t6 ^ t16;
+    t19 = t9 ^ t14;
+    t20 = t11 ^ t16;
+    t21 = t17 ^ y20;
+    t22 = t18 ^ y19;
+    t23 = t19 ^ y21;
+    t24 = t20 ^ y18;
+
+    t25 = t21 ^ t22;
+    t26 = t21 & t23;
+    t27 = t24 ^ t26;
+    t28 = t25 & t27;
+    t29 = t28 ^ t22;
+    t30 = t23 ^ t24;
+    t31 = t22 ^ t26;
+    t32 = t31 & t30;
+    t33 = t32 ^ t24;
+    t34 = t23 ^ t33;
+    t35 = t27 ^ t33;
+    t36 = t24 & t35;
+    t37 = t36 ^ t34;
+    t38 = t27 ^ t36;
+    t39 = t29 & t38;
+    t40 = t25 ^ t39;
+
+    t41 = t40 ^ t37;
+    t42 = t29 ^ t33;
+    t43 = t29 ^ t40;
+    t44 = t33 ^ t37;
+    t45 = t42 ^ t41;
+    z0 = t44 & y15;
+    z1 = t37 & y6;
+    z2 = t33 & x7;
+    z3 = t43 & y16;
+    z4 = t40 & y1;
+    z5 = t29 & y7;
+    z6 = t42 & y11;
+    z7 = t45 & y17;
+    z8 = t41 & y10;
+    z9 = t44 & y12;
+    z10 = t37 & y3;
+    z11 = t33 & y4;
+    z12 = t43 & y13;
+    z13 = t40 & y5;
+    z14 = t29 & y2;
+    z15 = t42 & y9;
+    z16 = t45 & y14;
+    z17 = t41 & y8;
+
+    /*
+     * Bottom linear transformation
+     */
+    t46 = z15 ^ z16;
+    t47 = z10 ^ z11;
+    t48 = z5 ^ z13;
+    t49 = z9 ^ z10;
+    t50 = z2 ^ z12;
+    t51 = z2 ^ z5;
+    t52 = z7 ^ z8;
+    t53 = z0 ^ z3;
+    t54 = z6 ^ z7;
+    t55 = z16 ^ z17;
+    t56 = z12 ^ t48;
+    t57 = t50 ^ t53;
+    t58 = z4 ^ t46;
+    t59 = z3 ^ t54;
+    t60 = t46 ^ t57;
+    t61 = z14 ^ t57;
+    t62 = t52 ^ t58;
+    t63 = t49 ^ t58;
+    t64 = z4 ^ t59;
+    t65 = t61 ^ t62;
+    t66 = z1 ^ t63;
+    s0 = t59 ^ t63;
+    s6 = t56 ^ ~t62;
+    s7 = t48 ^ ~t60;
+    t67 = t64 ^ t65;
+    s3 = t53 ^ t66;
+    s4 = t51 ^ t66;
+    s5 = t47 ^ t65;
+    s1 = t64 ^ ~s3;
+    s2 = t55 ^ ~t67;
+
+    q[7] = s0;
+    q[6] = s1;
+    q[5] = s2;
+    q[4] = s3;
+    q[3] = s4;
+    q[2] = s5;
+    q[1] = s6;
+    q[0] = s7;
+}
+
+static void ShiftRows(uint32_t* q)
+{
+    int i;
+
+    for (i = 0; i < 8; ++i) {
+        uint32_t x = q[i];
+        q[i] = (x & 0x000000FF) |
+               ((x & 0x0000FC00) >> 2) | ((x & 0x00000300) << 6) |
+               ((x & 0x00F00000) >> 4) | ((x & 0x000F0000) << 4) |
+               ((x & 0xC0000000) >> 6) | ((x & 0x3F000000) << 2);
+    }
+}
+
+#define ROTR8(x)  (((x) >> 8) | ((x) << 24))
+#define ROTR16(x) (((x) >> 16) | ((x) << 16))
+
+static void MixColumns(uint32_t* q)
+{
+    uint32_t q0 = q[0];
+    uint32_t q1 = q[1];
+    uint32_t q2 = q[2];
+    uint32_t q3 = q[3];
+    uint32_t q4 = q[4];
+    uint32_t q5 = q[5];
+    uint32_t q6 = q[6];
+    uint32_t q7 = q[7];
+    uint32_t r0 = ROTR8(q0);
+    uint32_t r1 = ROTR8(q1);
+    uint32_t r2 = ROTR8(q2);
+    uint32_t r3 = ROTR8(q3);
+    uint32_t r4 = ROTR8(q4);
+    uint32_t r5 = ROTR8(q5);
+    uint32_t r6 = ROTR8(q6);
+    uint32_t r7 = ROTR8(q7);
+
+    q[0] = q7 ^ r7 ^ r0 ^ ROTR16(q0 ^ r0);
+    q[1] = q0 ^ r0 ^ q7 ^ r7 ^ r1 ^ ROTR16(q1 ^ r1);
+    q[2] = q1 ^ r1 ^ r2 ^ ROTR16(q2 ^ r2);
+    q[3] = q2 ^ r2 ^ q7 ^ r7 ^ r3 ^ ROTR16(q3 ^ r3);
+    q[4] = q3 ^ r3 ^ q7 ^ r7 ^ r4 ^ ROTR16(q4 ^ r4);
+    q[5] = q4 ^ r4 ^ r5 ^ ROTR16(q5 ^ r5);
+    q[6] = q5 ^ r5 ^ r6 ^ ROTR16(q6 ^ r6);
+    q[7] = q6 ^ r6 ^ r7 ^ ROTR16(q7 ^ r7);
+}
+
+static void AddRoundKey(uint32_t* q, const uint32_t* sk)
+{
+    int i;
+
+    for (i = 0; i < 8; ++i) {
+        q[i] ^= sk[i];
+    }
+}
+
+/*
+ * Encrypt two blocks, a[] and b[] are each four little-endian words
+ */
+static void EncryptBlocks(uint32_t* a, uint32_t* b)
+{
+    const uint32_t* skey = aes_fkey + BS_SCHEDULE;
+    uint32_t q[8];
+    int i;
+
+    for (i = 0; i < 4; ++i) {
+        q[2 * i] = a[i];
+        q[2 * i + 1] = b[i];
+    }
+    Ortho(q);
+    AddRoundKey(q, skey);
+    for (i = 1; i < ROUNDS; ++i) {
+        SubBytes(q);
+        ShiftRows(q);
+        MixColumns(q);
+        AddRoundKey(q, skey + 8 * i);
+    }
+    SubBytes(q);
+    ShiftRows(q);
+    AddRoundKey(q, skey + 8 * ROUNDS);
+    Ortho(q);
+    for (i = 0; i < 4; ++i) {
+        a[i] = q[2 * i];
+        b[i] = q[2 * i + 1];
+    }
+    AJ_MemZeroSecure(q, sizeof(q));
+}
+
+static uint32_t SubWord(uint32_t x)
+{
+    uint32_t q[8];
+
+    memset(q, 0, sizeof(q));
+    q[0] = x;
+    Ortho(q);
+    SubBytes(q);
+    Ortho(q);
+    return q[0];
+}
+
+void AJ_AES_ExpandKey(AJ_AES_Key* aesKey, const uint8_t* key)
+{
+    static const uint8_t rcon[ROUNDS] = { 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1b, 0x36 };
+    uint32_t* w = aesKey->schedule + STD_SCHEDULE;
+    uint32_t* skey = aesKey->schedule + BS_SCHEDULE;
+    int i;
+
+    for (i = 0; i < 4; ++i) {
+        w[i] = Dec32le(key + 4 * i);
+    }
+    for (i = 4; i < 4 * (ROUNDS + 1); ++i) {
+        uint32_t tmp = w[i - 1];
+        if ((i % 4) == 0) {
+            tmp = SubWord(ROTR8(tmp)) ^ rcon[i / 4 - 1];
+        }
+        w[i] = w[i - 4] ^ tmp;
+    }
+    /*
+     * The round keys are duplicated for both blocks and converted to the bitsliced representation
+     */
+    for (i = 0; i <= ROUNDS; ++i) {
+        uint32_t* q = skey + 8 * i;
+        int j;
+        for (j = 0; j < 4; ++j) {
+            q[2 * j] = w[4 * i + j];
+            q[2 * j + 1] = w[4 * i + j];
+        }
+        Ortho(q);
+    }
+}
+
+void AJ_AES_Enable(const uint8_t* key)
+{
+    AJ_AES_ExpandKey(&aes_context, key);
+    aes_fkey = aes_context.schedule;
+}
+
+void AJ_AES_EnableKey(const AJ_AES_Key* aesKey)
+{
+    aes_fkey = aesKey->schedule;
+}
+
+void AJ_AES_Disable(void)
+{
+    AJ_MemZeroSecure(&aes_context, sizeof(aes_context));
+    aes_fkey = aes_context.schedule;
+}
+
+static void LoadBlock(uint32_t* w, const uint8_t* in)
+{
+    int i;
+
+    for (i = 0; i < 4; ++i) {
+        w[i] = Dec32le(in + 4 * i);
+    }
+}
+
+static void StoreBlock(uint8_t* out, const uint32_t* w)
+{
+    int i;
+
+    for (i = 0; i < 4; ++i) {
+        Enc32le(out + 4 * i, w[i]);
+    }
+}
+
+/*
+ * Gets the current counter block and increments the big-endian counter in the last four bytes
+ */
+static void NextCounter(uint32_t* w, uint8_t* ctr)
+{
+    uint32_t n = ((uint32_t)ctr[12] << 24) | ((uint32_t)ctr[13] << 16) | ((uint32_t)ctr[14] << 8) | ctr[15];
+
+    LoadBlock(w, ctr);
+    ++n;
+    ctr[12] = (uint8_t)(n >> 24);
+    ctr[13] = (uint8_t)(n >> 16);
+    ctr[14] = (uint8_t)(n >> 8);
+    ctr[15] = (uint8_t)n;
+}
+
+void AJ_AES_CTR_128(const uint8_t* key, const uint8_t* in, uint8_t* out, uint32_t len, uint8_t* ctr)
+{
+    uint32_t a[4];
+    uint32_t b[4];
+    uint8_t ks[32];
+
+    /*
+     * Two counter blocks are encrypted at a time
+     */
+    while (len) {
+        uint32_t n = min(len, 32);
+        uint32_t i;
+
+        NextCounter(a, ctr);
+        if (n > 16) {
+            NextCounter(b, ctr);
+        } else {
+            memset(b, 0, sizeof(b));
+        }
+        EncryptBlocks(a, b);
+        StoreBlock(ks, a);
+        StoreBlock(ks + 16, b);
+        for (i = 0; i < n; ++i) {
+            *out++ = *in++ ^ ks[i];
+        }
+        len -= n;
+    }
+    AJ_MemZeroSecure(ks, sizeof(ks));
+    AJ_MemZeroSecure(a, sizeof(a));
+    AJ_MemZeroSecure(b, sizeof(b));
+}
+
+void AJ_AES_CBC_128_ENCRYPT(const uint8_t* key, const uint8_t* in, uint8_t* out, uint32_t len, uint8_t* iv)
+{
+    uint32_t ivt[4];
+    uint32_t unused[4];
+
+    AJ_ASSERT((len % 16) == 0);
+
+    LoadBlock(ivt, iv);
+    while (len) {
+        uint32_t x[4];
+        int i;
+        LoadBlock(x, in);
+        for (i = 0; i < 4; ++i) {
+            ivt[i] ^= x[i];
+        }
+        memset(unused, 0, sizeof(unused));
+        EncryptBlocks(ivt, unused);
+        StoreBlock(out, ivt);
+        AJ_MemZeroSecure(x, sizeof(x));
+        out += 16;
+        in += 16;
+        len -= 16;
+    }
+    StoreBlock(iv, ivt);
+}
+
+void AJ_AES_ECB_128_ENCRYPT(const uint8_t* key, const uint8_t* in, uint8_t* out)
+{
+    uint32_t a[4];
+    uint32_t b[4];
+
+    LoadBlock(a, in);
+    memset(b, 0, sizeof(b));
+    EncryptBlocks(a, b);
+    StoreBlock(out, a);
+}
+
+#if AJ_AES_NI
+/*
+ * -1 until the processor has been checked for AES-NI support
+ */
+static int8_t aesni = -1;
+
+void AJ_AESNI_Enable(uint8_t enable)
+{
+    aesni = enable ? AJ_AESNI_Available() : 0;
+}
+#endif
+
+/*
+ * Loads a data block, a partial final block is padded with zeroes
+ */
+static void LoadPartial(uint32_t* w, const uint8_t* data, uint32_t n)
+{
+    uint8_t pad[16];
+
+    memset(pad, 0, sizeof(pad));
+    memcpy(pad, data, n);
+    LoadBlock(w, pad);
+    AJ_MemZeroSecure(pad, sizeof(pad));
+}
+
+static void StorePartial(uint8_t* data, const uint32_t* w, uint32_t n)
+{
+    uint8_t pad[16];
+
+    StoreBlock(pad, w);
+    memcpy(data, pad, n);
+    AJ_MemZeroSecure(pad, sizeof(pad));
+}
+
+void AJ_AES_CCM_128(const uint8_t* key, uint8_t* data, uint32_t len, uint8_t* ctr, uint8_t* mac, uint8_t decrypt)
+{
+    uint32_t t[4];
+    uint32_t k[4];
+    uint32_t p[4];
+    int i;
+
+#if AJ_AES_NI
+    if (aesni < 0) {
+        aesni = AJ_AESNI_Available();
+    }
+    if (aesni) {
+        AJ_AESNI_CCM_128(aes_fkey + STD_SCHEDULE, data, len, ctr, mac, decrypt);
+        return;
+    }
+#endif
+    LoadBlock(t, mac);
+    if (decrypt) {
+        /*
+         * The plaintext is needed for the MAC so the MAC of each block is computed together with
+         * the keystream for the following block.
+         */
+        memset(p, 0, sizeof(p));
+        NextCounter(k, ctr);
+        EncryptBlocks(k, p);
+        while (len) {
+            uint32_t n = min(len, 16);
+            LoadPartial(p, data, n);
+            for (i = 0; i < 4; ++i) {
+                p[i] ^= k[i];
+            }
+            StorePartial(data, p, n);
+            if (n < 16) {
+                LoadPartial(p, data, n);
+            }
+            for (i = 0; i < 4; ++i) {
+                t[i] ^= p[i];
+            }
+            len -= n;
+            data += n;
+            if (len) {
+                NextCounter(k, ctr);
+            } else {
+                memset(k, 0, sizeof(k));
+            }
+            EncryptBlocks(t, k);
+        }
+    } else {
+        /*
+         * The MAC block and the keystream block are encrypted together
+         */
+        while (len) {
+            uint32_t n = min(len, 16);
+            LoadPartial(p, data, n);
+            for (i = 0; i < 4; ++i) {
+                t[i] ^= p[i];
+            }
+            NextCounter(k, ctr);
+            EncryptBlocks(t, k);
+            for (i = 0; i < 4; ++i) {
+                p[i] ^= k[i];
+            }
+            StorePartial(data, p, n);
+            len -= n;
+            data += n;
+        }
+    }
+    StoreBlock(mac, t);
+    AJ_MemZeroSecure(k, sizeof(k));
+    AJ_MemZeroSecure(p, sizeof(p));
+}
+
+#endif
@@ -0,0 +1,192 @@
+/**
+ * @file
+ */
+/******************************************************************************
+ *    Copyright (c) Open Connectivity Foundation (OCF), AllJoyn Open Source
+ *    Project (AJOSP) Contributors and others.
+ *
+ *    SPDX-License-Identifier: Apache-2.0
+ *
+ *    All rights reserved. This program and the accompanying materials are
+ *    made available under the terms of the Apache License, Version 2.0
+ *    which accompanies this distribution, and is available at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Copyright (c) Open Connectivity Foundation and Contributors to AllSeen
+ *    Alliance. All rights reserved.
+ *
+ *    Permission to use, copy, modify, and/or distribute this software for
+ *    any purpose with or without fee is hereby granted, provided that the
+ *    above copyright notice and this permission notice appear in all
+ *    copies.
+ *
+ *    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ *    WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+ *    WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+ *    AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+ *    DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR
+ *    PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ *    TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ *    PERFORMANCE OF THIS SOFTWARE.
+ ******************************************************************************/
+
+#include <ajtcl/aj_target.h>
+#include <ajtcl/aj_crypto.h>
+#include <ajtcl/aj_crypto_aes_priv.h>
+#include <ajtcl/aj_util.h>
+
+#if AJ_AES_NI
+
+#include <cpuid.h>
+#include <wmmintrin.h>
+
+/*
+ * The intrinsics are only enabled for these functions so the rest of the library can run on
+ * processors without AES-NI.
+ */
+#define AESNI_TARGET __attribute__((target("aes,sse2")))
+
+uint8_t AJ_AESNI_Available(void)
+{
+    unsigned int eax;
+    unsigned int ebx;
+    unsigned int ecx;
+    unsigned int edx;
+
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        return FALSE;
+    }
+    return (ecx & bit_AES) ? TRUE : FALSE;
+}
+
+/*
+ * Encrypt two independent blocks, interleaving the rounds so they overlap in the pipeline
+ */
+#define AESNI_ENCRYPT2(a, b, rk) \
+    do { \
+        int r_; \
+        a = _mm_xor_si128(a, rk[0]); \
+        b = _mm_xor_si128(b, rk[0]); \
+        for (r_ = 1; r_ < 10; ++r_) { \
+            a = _mm_aesenc_si128(a, rk[r_]); \
+            b = _mm_aesenc_si128(b, rk[r_]); \
+        } \
+        a = _mm_aesenclast_si128(a, rk[10]); \
+        b = _mm_aesenclast_si128(b, rk[10]); \
+    } while (0)
+
+#define AESNI_ENCRYPT1(a, rk) \
+    do { \
+        int r_; \
+        a = _mm_xor_si128(a, rk[0]); \
+        for (r_ = 1; r_ < 10; ++r_) { \
+            a = _mm_aesenc_si128(a, rk[r_]); \
+        } \
+        a = _mm_aesenclast_si128(a, rk[10]); \
+    } while (0)
+
+/*
+ * Loads the next counter block and increments the big-endian counter in the last four bytes
+ */
+static AESNI_TARGET __m128i NextCounter(uint8_t* ctr)
+{
+    __m128i block = _mm_loadu_si128((const __m128i*)ctr);
+    uint32_t n = ((uint32_t)ctr[12] << 24) | ((uint32_t)ctr[13] << 16) | ((uint32_t)ctr[14] << 8) | ctr[15];
+    ++n;
+    ctr[12] = (uint8_t)(n >> 24);
+    ctr[13] = (uint8_t)(n >> 16);
+    ctr[14] = (uint8_t)(n >> 8);
+    ctr[15] = (uint8_t)n;
+    return block;
+}
+
+/*
+ * Loads a data block, a partial final block is padded with zeroes
+ */
+static AESNI_TARGET __m128i LoadBlock(const uint8_t* data, uint32_t n)
+{
+    uint8_t pad[16];
+
+    if (n == 16) {
+        return _mm_loadu_si128((const __m128i*)data);
+    }
+    memset(pad, 0, sizeof(pad));
+    memcpy(pad, data, n);
+    return _mm_loadu_si128((const __m128i*)pad);
+}
+
+static AESNI_TARGET void StoreBlock(uint8_t* data, __m128i block, uint32_t n)
+{
+    uint8_t pad[16];
+
+    if (n == 16) {
+        _mm_storeu_si128((__m128i*)data, block);
+    } else {
+        _mm_storeu_si128((__m128i*)pad, block);
+        memcpy(data, pad, n);
+        AJ_MemZeroSecure(pad, sizeof(pad));
+    }
+}
+
+AESNI_TARGET void AJ_AESNI_CCM_128(const uint32_t* schedule, uint8_t* data, uint32_t len, uint8_t* ctr, uint8_t* mac, uint8_t decrypt)
+{
+    __m128i rk[11];
+    __m128i t = _mm_loadu_si128((const __m128i*)mac);
+    __m128i k;
+    int i;
+
+    /*
+     * The table code schedule has the same byte layout as the AES-NI round keys on little-endian hosts
+     */
+    for (i = 0; i < 11; ++i) {
+        rk[i] = _mm_loadu_si128((const __m128i*)(schedule + 4 * i));
+    }
+    if (decrypt) {
+        /*
+         * The plaintext is needed for the MAC so the MAC of each block is computed together with
+         * the keystream for the following block.
+         */
+        k = NextCounter(ctr);
+        AESNI_ENCRYPT1(k, rk);
+        while (len) {
+            uint32_t n = min(len, 16);
+            __m128i p = _mm_xor_si128(LoadBlock(data, n), k);
+            if (n < 16) {
+                /*
+                 * Discard the keystream bytes past the end of the data before adding to the MAC
+                 */
+                StoreBlock(data, p, n);
+                p = LoadBlock(data, n);
+            } else {
+                StoreBlock(data, p, n);
+            }
+            t = _mm_xor_si128(t, p);
+            len -= n;
+            data += n;
+            if (len) {
+                k = NextCounter(ctr);
+                AESNI_ENCRYPT2(t, k, rk);
+            } else {
+                AESNI_ENCRYPT1(t, rk);
+            }
+        }
+    } else {
+        while (len) {
+            uint32_t n = min(len, 16);
+            __m128i p = LoadBlock(data, n);
+            t = _mm_xor_si128(t, p);
+            k = NextCounter(ctr);
+            AESNI_ENCRYPT2(t, k, rk);
+            StoreBlock(data, _mm_xor_si128(p, k), n);
+            len -= n;
+            data += n;
+        }
+    }
+    _mm_storeu_si128((__m128i*)mac, t);
+    k = _mm_setzero_si128();
+    for (i = 0; i < 11; ++i) {
+        rk[i] = k;
+    }
+}
+
+#endif
@@ -34,15 +34,19 @@
 #include <ajtcl/aj_crypto.h>
 #include <ajtcl/aj_crypto_aes_priv.h>
 #include <ajtcl/aj_util.h>
+#include <ajtcl/aj_config.h>
 
+#if !AJ_AES_CT
 
-#define MAX_SCHEDULE_LEN 48
-
-typedef struct {
-    uint32_t fkey[MAX_SCHEDULE_LEN];
-} AES_CTX;
+/*
+ * Key schedule expanded by AJ_AES_Enable
+ */
+static AJ_THREAD_LOCAL AJ_AES_Key aes_context;
 
-static AES_CTX aes_context;
+/*
+ * The key schedule used by the block functions, either aes_context or a key passed to AJ_AES_EnableKey
+ */
+static AJ_THREAD_LOCAL const uint32_t* aes_fkey;
 
 #define ROTL8(x)  ((((uint32_t)(x)) << 8)  | (((uint32_t)(x)) >> 24))
 #define ROTL16(x) ((((uint32_t)(x)) << 16) | (((uint32_t)(x)) >> 16))
@@ -180,7 +184,7 @@ static uint32_t SubBytes(uint32_t a)
 #define ROUNDS 10
 
 
-static void EncryptRounds(uint32_t* out, uint32_t* in, uint32_t* key)
+static void EncryptRounds(uint32_t* out, uint32_t* in, const uint32_t* key)
 {
     int i;
     uint32_t x0 = in[0];
@@ -206,10 +210,10 @@ static void EncryptRounds(uint32_t* out, uint32_t* in, uint32_t* key)
     out[3] = x3;
 }
 
-void AJ_AES_Enable(const uint8_t* key)
+void AJ_AES_ExpandKey(AJ_AES_Key* aesKey, const uint8_t* key)
 {
     int i;
-    uint32_t* fkey = aes_context.fkey;
+    uint32_t* fkey = aesKey->schedule;
 
     Pack32(fkey, key);
     for (i = 0; i <= ROUNDS; ++i, fkey += 4) {
@@ -220,9 +224,33 @@ void AJ_AES_Enable(const uint8_t* key)
     }
 }
 
+void AJ_AES_Enable(const uint8_t* key)
+{
+    AJ_AES_ExpandKey(&aes_context, key);
+    aes_fkey = aes_context.schedule;
+}
+
+void AJ_AES_EnableKey(const AJ_AES_Key* aesKey)
+{
+    aes_fkey = aesKey->schedule;
+}
+
 void AJ_AES_Disable(void)
 {
     AJ_MemZeroSecure(&aes_context, sizeof(aes_context));
+    aes_fkey = aes_context.schedule;
+}
+
+static void IncrementCounter(uint32_t* counter)
+{
+    /*
+     * The counter field is big-endian
+     */
+#if HOST_IS_LITTLE_ENDIAN
+    counter[3] = AJ_ByteSwap32(1 + AJ_ByteSwap32(counter[3]));
+#else
+    counter[3] += 1;
+#endif
 }
 
 void AJ_AES_CTR_128(const uint8_t* key, const uint8_t* in, uint8_t* out, uint32_t len, uint8_t* ctr)
@@ -238,22 +266,15 @@ void AJ_AES_CTR_128(const uint8_t* key, const uint8_t* in, uint8_t* out, uint32_
         uint8_t* p = (uint8_t*)tmp;
 
         for (i = 0; i < 4; ++i) {
-            tmp[i] = counter[i] ^ aes_context.fkey[i];
+            tmp[i] = counter[i] ^ aes_fkey[i];
         }
-        EncryptRounds(tmp, tmp, &aes_context.fkey[4]);
+        EncryptRounds(tmp, tmp, &aes_fkey[4]);
         len -= n;
         while (n--) {
             *out++ = *p++ ^ *in++;
         }
         AJ_MemZeroSecure((uint8_t*)tmp, sizeof(tmp));
-        /*
-         * The counter field is big-endian
-         */
-#if HOST_IS_LITTLE_ENDIAN
-        counter[3] = AJ_ByteSwap32(1 + AJ_ByteSwap32(counter[3]));
-#else
-        counter[3] += 1;
-#endif
+        IncrementCounter(counter);
     }
 
     Unpack32(ctr, counter);
@@ -271,9 +292,9 @@ void AJ_AES_CBC_128_ENCRYPT(const uint8_t* key, const uint8_t* in, uint8_t* out,
         int i;
         Pack32(xorbuf, in);
         for (i = 0; i < 4; ++i) {
-            xorbuf[i] ^= ivt[i] ^ aes_context.fkey[i];
+            xorbuf[i] ^= ivt[i] ^ aes_fkey[i];
         }
-        EncryptRounds(ivt, xorbuf, &aes_context.fkey[4]);
+        EncryptRounds(ivt, xorbuf, &aes_fkey[4]);
         AJ_MemZeroSecure((uint8_t*)xorbuf, sizeof(xorbuf));
         Unpack32(out, ivt);
         out += 16;
@@ -289,6 +310,83 @@ void AJ_AES_ECB_128_ENCRYPT(const uint8_t* key, const uint8_t* in, uint8_t* out)
     uint32_t out32[4];
 
     Pack32(in32, in);
-    EncryptRounds(out32, in32, &aes_context.fkey[4]);
+    EncryptRounds(out32, in32, &aes_fkey[4]);
     Unpack32(out, out32);
-}
\ No newline at end of file
+}
+
+#if AJ_AES_NI
+/*
+ * -1 until the processor has been checked for AES-NI support
+ */
+static int8_t aesni = -1;
+
+void AJ_AESNI_Enable(uint8_t enable)
+{
+    aesni = enable ? AJ_AESNI_Available() : 0;
+}
+#endif
+
+void AJ_AES_CCM_128(const uint8_t* key, uint8_t* data, uint32_t len, uint8_t* ctr, uint8_t* mac, uint8_t decrypt)
+{
+    uint32_t counter[4];
+    uint32_t t[4];
+    uint32_t k[4];
+    uint32_t p[4];
+
+#if AJ_AES_NI
+    if (aesni < 0) {
+        aesni = AJ_AESNI_Available();
+    }
+    if (aesni) {
+        AJ_AESNI_CCM_128(aes_fkey, data, len, ctr, mac, decrypt);
+        return;
+    }
+#endif
+    Pack32(counter, ctr);
+    Pack32(t, mac);
+    while (len) {
+        uint32_t n = min(len, 16);
+        uint32_t i;
+
+        for (i = 0; i < 4; ++i) {
+            k[i] = counter[i] ^ aes_fkey[i];
+        }
+        EncryptRounds(k, k, &aes_fkey[4]);
+        IncrementCounter(counter);
+        if (n == 16) {
+            Pack32(p, data);
+            for (i = 0; i < 4; ++i) {
+                k[i] ^= p[i];
+            }
+            Unpack32(data, k);
+            if (decrypt) {
+                memcpy(p, k, sizeof(p));
+            }
+        } else {
+            /*
+             * The MAC is computed over the final block padded with zeroes
+             */
+            uint8_t* ks = (uint8_t*)k;
+            uint8_t pad[16];
+            memset(pad, 0, sizeof(pad));
+            for (i = 0; i < n; ++i) {
+                data[i] ^= ks[i];
+                pad[i] = decrypt ? data[i] : (data[i] ^ ks[i]);
+            }
+            Pack32(p, pad);
+            AJ_MemZeroSecure(pad, sizeof(pad));
+        }
+        for (i = 0; i < 4; ++i) {
+            t[i] ^= p[i] ^ aes_fkey[i];
+        }
+        EncryptRounds(t, t, &aes_fkey[4]);
+        data += n;
+        len -= n;
+    }
+    AJ_MemZeroSecure(k, sizeof(k));
+    AJ_MemZeroSecure(p, sizeof(p));
+    Unpack32(ctr, counter);
+    Unpack32(mac, t);
+}
+
+#endif
@@ -51,13 +51,27 @@
 uint8_t dbgMALLOC = 0;
 #endif
 
+/*
+ * Debug builds track use, high-water mark and largest allocation for AJ_PoolDump()
+ */
+#if AJ_POOL_STATS || defined(AJ_DEBUG_BUILD)
+#define POOL_USAGE 1
+#else
+#define POOL_USAGE 0
+#endif
+
 typedef struct {
-    void* endOfPool; /* Address of end of this pool */
-    void* freeList;  /* Free list for this pool */
-#ifdef AJ_DEBUG_BUILD
-    uint16_t use;    /* Number of entries in use */
-    uint16_t hwm;    /* High-water mark */
-    uint16_t max;    /* Max allocation from this pool */
+    void* endOfPool;   /* Address of end of this pool */
+    void* freeList;    /* Free list for this pool */
+#if AJ_POOL_STATS
+    uint32_t allocs;   /* Allocations served from this pool */
+    uint32_t failures; /* Allocations that best fit this pool and could not be served */
+    uint32_t borrows;  /* Allocations that best fit this pool and were served by a larger pool */
+#endif
+#if POOL_USAGE
+    uint16_t use;      /* Number of entries in use */
+    uint16_t hwm;      /* High-water mark */
+    uint16_t max;      /* Max allocation from this pool */
 #endif
 } Pool;
 
@@ -71,9 +85,48 @@ static Pool* heapPools;
 static uint8_t numPools;
 static uint8_t* heapStart;
 
+#if AJ_POOL_INDEX
+/*
+ * Maps an allocation size, in units of AJ_HEAP_POOL_ROUNDING bytes rounded up, to the index of the
+ * smallest pool that can hold it. The table is stored in the heap after the pool info block.
+ */
+static uint8_t* poolIndex;
+#endif
+
+/*
+ * Size of the pool info block and pool lookup table at the start of the heap
+ */
+static size_t PoolHeaderSize(const AJ_HeapConfig* poolConfig, uint8_t poolCnt)
+{
+    size_t sz = 0;
+
+#if AJ_POOL_INDEX
+    if (poolCnt) {
+        sz = (poolConfig[poolCnt - 1].size + AJ_HEAP_POOL_ROUNDING - 1) / AJ_HEAP_POOL_ROUNDING + 1;
+        sz = (sz + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+    }
+#endif
+    return sizeof(Pool) * poolCnt + sz;
+}
+
+/*
+ * Locate the pool a block was allocated from. The comparisons are summed rather than tested so
+ * freeing a block takes the same straight line path whichever pool it belongs to.
+ */
+static uint8_t PoolOf(const void* mem)
+{
+    uint8_t n = 0;
+    uint8_t i;
+
+    for (i = 0; i < numPools - 1; ++i) {
+        n += ((ptrdiff_t)mem >= (ptrdiff_t)heapPools[i].endOfPool);
+    }
+    return n;
+}
+
 size_t AJ_PoolRequired(const AJ_HeapConfig* poolConfig, uint8_t poolCnt)
 {
-    size_t heapSz = sizeof(Pool) * poolCnt;
+    size_t heapSz = PoolHeaderSize(poolConfig, poolCnt);
     uint8_t i;
 
     for (i = 0; i < poolCnt; ++i) {
@@ -93,9 +146,18 @@ AJ_Status AJ_PoolInit(void* heap, size_t heapSz, const AJ_HeapConfig* poolConfig
 {
     uint8_t i;
     uint16_t n;
-    uint8_t* heapEnd = (uint8_t*)heap + sizeof(Pool) * num;
+    size_t headerSz = PoolHeaderSize(poolConfig, num);
+    uint8_t* heapEnd = (uint8_t*)heap + headerSz;
     Pool* p = (Pool*)heap;
+#if AJ_POOL_INDEX
+    size_t c;
+#endif
 
+    if (!num || (headerSz > heapSz)) {
+        AJ_ErrPrintf(("Heap is too small for the requested pool allocations\n"));
+        return AJ_ERR_RESOURCES;
+    }
+    heapSz -= headerSz;
     heapPools = p;
     heapStart = heapEnd;
     heapConfig = poolConfig;
@@ -106,6 +168,20 @@ AJ_Status AJ_PoolInit(void* heap, size_t heapSz, const AJ_HeapConfig* poolConfig
      */
     memset(heapPools, 0, heapStart - (uint8_t*)heap);
 
+#if AJ_POOL_INDEX
+    /*
+     * Fill in the size to pool lookup table
+     */
+    poolIndex = (uint8_t*)(p + num);
+    for (i = 0, c = 0; c <= (poolConfig[num - 1].size + AJ_HEAP_POOL_ROUNDING - 1) / AJ_HEAP_POOL_ROUNDING; ++c) {
+        size_t smallest = c ? (c - 1) * AJ_HEAP_POOL_ROUNDING + 1 : 0;
+        while (poolConfig[i].size < smallest) {
+            ++i;
+        }
+        poolIndex[c] = i;
+    }
+#endif
+
     for (i = 0; i < numPools; ++i, ++p) {
         size_t sz = poolConfig[i].size;
         sz += AJ_HEAP_POOL_ROUNDING - (sz & (AJ_HEAP_POOL_ROUNDING - 1));
@@ -116,6 +192,7 @@ AJ_Status AJ_PoolInit(void* heap, size_t heapSz, const AJ_HeapConfig* poolConfig
             MemBlock* block = (MemBlock*)heapEnd;
             if (sz > heapSz) {
                 AJ_ErrPrintf(("Heap is too small for the requested pool allocations\n"));
+                heapPools = NULL;
                 return AJ_ERR_RESOURCES;
             }
             block->next = (MemBlock*)p->freeList;
@@ -127,11 +204,6 @@ AJ_Status AJ_PoolInit(void* heap, size_t heapSz, const AJ_HeapConfig* poolConfig
          * Save end of pool pointer for use by AJ_PoolFree
          */
         p->endOfPool = (void*)heapEnd;
-#ifdef AJ_DEBUG_BUILD
-        p->use = 0;
-        p->hwm = 0;
-        p->max = 0;
-#endif
     }
     return AJ_OK;
 }
@@ -144,37 +216,71 @@ uint8_t AJ_PoolIsInitialized()
 void* AJ_PoolAlloc(size_t sz)
 {
     Pool* p = heapPools;
+#if AJ_POOL_STATS
+    Pool* best;
+#endif
     uint8_t i;
 
     if (!p) {
         AJ_ErrPrintf(("Heap not initialized\n"));
         return NULL;
     }
+    if (sz > heapConfig[numPools - 1].size) {
+#if AJ_POOL_STATS
+        /*
+         * Too big for any pool, counted as a failure of the largest pool
+         */
+        ++p[numPools - 1].failures;
+#endif
+        AJ_ErrPrintf(("AJ_PoolAlloc of %d bytes failed\n", (int)sz));
+        AJ_PoolDump();
+        return NULL;
+    }
     /*
      * Find pool that can satisfy the allocation
      */
-    for (i = 0; i < numPools; ++i, ++p) {
-        if (sz <= heapConfig[i].size) {
-            MemBlock* block = (MemBlock*)p->freeList;
-            if (!block) {
-                /*
-                 * Are we allowed to borrowing from next pool?
-                 */
-                if (heapConfig[i].borrow) {
-                    continue;
-                }
-                break;
-            }
+#if AJ_POOL_INDEX
+    i = poolIndex[(sz + AJ_HEAP_POOL_ROUNDING - 1) / AJ_HEAP_POOL_ROUNDING];
+#else
+    i = 0;
+#endif
+    /*
+     * With the lookup table this is only needed if the pool sizes are not multiples of
+     * AJ_HEAP_POOL_ROUNDING
+     */
+    while (sz > heapConfig[i].size) {
+        ++i;
+    }
+    p = &heapPools[i];
+#if AJ_POOL_STATS
+    best = p;
+#endif
+    for (; i < numPools; ++i, ++p) {
+        MemBlock* block = (MemBlock*)p->freeList;
+        if (block) {
             AJ_InfoPrintf(("AJ_PoolAlloc pool[%d] allocated %d\n", heapConfig[i].size, (int)sz));
             p->freeList = block->next;
-#ifdef AJ_DEBUG_BUILD
+#if AJ_POOL_STATS
+            ++p->allocs;
+            best->borrows += (p != best);
+#endif
+#if POOL_USAGE
             ++p->use;
             p->hwm = max(p->use, p->hwm);
             p->max = max(p->max, sz);
 #endif
             return (void*)block;
         }
+        /*
+         * Are we allowed to borrowing from next pool?
+         */
+        if (!heapConfig[i].borrow) {
+            break;
+        }
     }
+#if AJ_POOL_STATS
+    ++best->failures;
+#endif
     AJ_ErrPrintf(("AJ_PoolAlloc of %d bytes failed\n", (int)sz));
     AJ_PoolDump();
     return NULL;
@@ -182,33 +288,24 @@ void* AJ_PoolAlloc(size_t sz)
 
 void AJ_PoolFree(void* mem)
 {
-    Pool* p = heapPools;
-    uint8_t i;
-
     if (mem) {
+        Pool* p = &heapPools[PoolOf(mem)];
+        MemBlock* block = (MemBlock*)mem;
+
         assert((ptrdiff_t)mem >= (ptrdiff_t)heapStart);
-        /*
-         * Locate the pool from which the released memory was allocated
-         */
-        for (i = 0; i < numPools; ++i, ++p) {
-            if ((ptrdiff_t)mem < (ptrdiff_t)p->endOfPool) {
-                MemBlock* block = (MemBlock*)mem;
-                block->next = (MemBlock*)p->freeList;
-                p->freeList = block;
-                AJ_InfoPrintf(("AJ_PoolFree pool[%d]\n", heapConfig[i].size));
-#ifdef AJ_DEBUG_BUILD
-                --p->use;
+        assert((ptrdiff_t)mem < (ptrdiff_t)heapPools[numPools - 1].endOfPool);
+        block->next = (MemBlock*)p->freeList;
+        p->freeList = block;
+#if POOL_USAGE
+        --p->use;
 #endif
-                break;
-            }
-        }
-        assert(i < numPools);
+        AJ_InfoPrintf(("AJ_PoolFree pool[%d]\n", heapConfig[p - heapPools].size));
     }
 }
 
 void* AJ_PoolRealloc(void* mem, size_t newSz)
 {
-    Pool* p = heapPools;
+    Pool* p;
     uint8_t i;
 
     if (mem) {
@@ -216,32 +313,32 @@ void* AJ_PoolRealloc(void* mem, size_t newSz)
         /*
          * Locate the pool from which the released memory was allocated
          */
-        for (i = 0; i < numPools; ++i, ++p) {
-            if ((ptrdiff_t)mem < (ptrdiff_t)p->endOfPool) {
-                size_t oldSz = heapConfig[i].size;
-                /*
-                 * Don't need to do anything if the same block would be reused
-                 */
-                if ((newSz <= oldSz) && ((i == 0) || (newSz > heapConfig[i - 1].size))) {
-                    AJ_InfoPrintf(("AJ_Realloc pool[%d] %d bytes in place\n", (int)oldSz, (int)newSz));
-                } else {
-                    MemBlock* block = (MemBlock*)mem;
-                    AJ_InfoPrintf(("AJ_Realloc pool[%d] by AJ_Alloc(%d)\n", (int)oldSz, (int)newSz));
-                    mem = AJ_PoolAlloc(newSz);
-                    if (mem) {
-                        memcpy(mem, (void*)block, min(oldSz, newSz));
-                        /*
-                         * Put old block on the free list
-                         */
-                        block->next = (MemBlock*)p->freeList;
-                        p->freeList = block;
-#ifdef AJ_DEBUG_BUILD
-                        --p->use;
+        i = PoolOf(mem);
+        p = &heapPools[i];
+        if ((ptrdiff_t)mem < (ptrdiff_t)p->endOfPool) {
+            size_t oldSz = heapConfig[i].size;
+            /*
+             * Don't need to do anything if the same block would be reused
+             */
+            if ((newSz <= oldSz) && ((i == 0) || (newSz > heapConfig[i - 1].size))) {
+                AJ_InfoPrintf(("AJ_Realloc pool[%d] %d bytes in place\n", (int)oldSz, (int)newSz));
+            } else {
+                MemBlock* block = (MemBlock*)mem;
+                AJ_InfoPrintf(("AJ_Realloc pool[%d] by AJ_Alloc(%d)\n", (int)oldSz, (int)newSz));
+                mem = AJ_PoolAlloc(newSz);
+                if (mem) {
+                    memcpy(mem, (void*)block, min(oldSz, newSz));
+                    /*
+                     * Put old block on the free list
+                     */
+                    block->next = (MemBlock*)p->freeList;
+                    p->freeList = block;
+#if POOL_USAGE
+                    --p->use;
 #endif
-                    }
                 }
-                return mem;
             }
+            return mem;
         }
     } else {
         return AJ_PoolAlloc(newSz);
@@ -251,6 +348,46 @@ void* AJ_PoolRealloc(void* mem, size_t newSz)
     return NULL;
 }
 
+uint8_t AJ_PoolCount(void)
+{
+    return heapPools ? numPools : 0;
+}
+
+#if AJ_POOL_STATS
+AJ_Status AJ_PoolGetStats(uint8_t pool, AJ_PoolStats* stats)
+{
+    const Pool* p;
+
+    if (!heapPools || (pool >= numPools)) {
+        return AJ_ERR_RANGE;
+    }
+    p = &heapPools[pool];
+    stats->size = heapConfig[pool].size;
+    stats->entries = heapConfig[pool].entries;
+    stats->use = p->use;
+    stats->hwm = p->hwm;
+    stats->max = p->max;
+    stats->allocs = p->allocs;
+    stats->failures = p->failures;
+    stats->borrows = p->borrows;
+    return AJ_OK;
+}
+
+void AJ_PoolResetStats(void)
+{
+    Pool* p = heapPools;
+    uint8_t i;
+
+    for (i = 0; p && (i < numPools); ++i, ++p) {
+        p->allocs = 0;
+        p->failures = 0;
+        p->borrows = 0;
+        p->hwm = p->use;
+        p->max = 0;
+    }
+}
+#endif
+
 #ifdef AJ_DEBUG_BUILD
 void AJ_PoolDump(void)
 {
@@ -262,7 +399,11 @@ void AJ_PoolDump(void)
 
     AJ_AlwaysPrintf(("======= dump of %d heap pools ======\n", numPools));
     for (i = 0; i < numPools; ++i, ++p) {
+#if AJ_POOL_STATS
+        AJ_AlwaysPrintf(("pool[%d] used=%d free=%d high-water=%d max-alloc=%d allocs=%u failures=%u borrows=%u\n", heapConfig[i].size, p->use, heapConfig[i].entries - p->use, p->hwm, p->max, p->allocs, p->failures, p->borrows));
+#else
         AJ_AlwaysPrintf(("pool[%d] used=%d free=%d high-water=%d max-alloc=%d\n", heapConfig[i].size, p->use, heapConfig[i].entries - p->use, p->hwm, p->max));
+#endif
         memUse += p->use * heapConfig[i].size;
         memHigh += p->hwm * heapConfig[i].size;
         memTotal += p->hwm * p->max;
@@ -31,6 +31,7 @@
  ******************************************************************************/
 
 #include <ajtcl/aj_target.h>
+#include <ajtcl/aj_config.h>
 
 
 /*
@@ -45,6 +46,23 @@ typedef struct _Aj_HeapConfig {
     const uint8_t borrow;    /* Indicates if pool can borrow from then next larger pool */
 } AJ_HeapConfig;
 
+#if AJ_POOL_STATS
+/*
+ * Usage counters for one pool, see AJ_PoolGetStats()
+ */
+typedef struct _AJ_PoolStats {
+    uint16_t size;      /* Size of the pool entries in bytes */
+    uint16_t entries;   /* Number of entries in this pool */
+    uint16_t use;       /* Number of entries in use */
+    uint16_t hwm;       /* Most entries in use at once */
+    uint16_t max;       /* Largest allocation served from this pool */
+    uint32_t allocs;    /* Allocations served from this pool */
+    uint32_t failures;  /* Allocations that best fit this pool and could not be served, allocations
+                           too big for any pool are counted against the largest pool */
+    uint32_t borrows;   /* Allocations that best fit this pool and were served by a larger pool */
+} AJ_PoolStats;
+#endif
+
 /*
  * This should be 4 or 8
  */
@@ -68,7 +86,9 @@ typedef struct _Aj_HeapConfig {
 
 
 /**
- * Compute the required size of the heap for the given pool list.
+ * Compute the required size of the heap for the given pool list. This includes the pool info block
+ * and, if AJ_POOL_INDEX is set, a lookup table from allocation size to pool with one byte for every
+ * AJ_HEAP_POOL_ROUNDING bytes of the largest pool size.
  *
  * @param heapConfig Description of the pools to require.
  * @param numPools   The number of different sized memory pools, maximum is 255.
@@ -130,6 +150,33 @@ void AJ_PoolFree(void* mem);
  */
 void* AJ_PoolRealloc(void* mem, size_t newSz);
 
+/**
+ * Get the number of pools in the heap
+ *
+ * @return The number of pools or 0 if the heap is not initialized
+ */
+uint8_t AJ_PoolCount(void);
+
+#if AJ_POOL_STATS
+/**
+ * Get the usage counters for a pool. The counters are only maintained if AJ_POOL_STATS is set and
+ * cost a few increments per allocation.
+ *
+ * @param pool   Index of the pool, pools are numbered in the order of the heap configuration
+ * @param stats  Returns the counters
+ *
+ * @return - AJ_OK if the counters were returned
+ *         - AJ_ERR_RANGE if the heap is not initialized or there is no such pool
+ */
+AJ_Status AJ_PoolGetStats(uint8_t pool, AJ_PoolStats* stats);
+
+/**
+ * Reset the allocation, failure and borrow counters of all pools and set the high-water marks to
+ * the current use.
+ */
+void AJ_PoolResetStats(void);
+#endif
+
 #ifdef AJ_DEBUG_BUILD
 void AJ_PoolDump(void);
 #else
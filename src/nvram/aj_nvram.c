@@ -38,6 +38,7 @@
 
 #include <ajtcl/aj_nvram.h>
 #include <ajtcl/aj_debug.h>
+#include <ajtcl/aj_config.h>
 #ifdef ARDUINO
 #include <ajtcl/aj_target_nvram.h>
 #else
@@ -84,6 +85,143 @@ static AJ_NVRAM_Block_Id _AJ_NVRAM_Find_NV_Storage(uint16_t id)
     return ((idx == AJ_NVRAM_ID_END_SENTINEL) ? AJ_NVRAM_ID_END_SENTINEL : nvMemoryMap[idx].blockId);
 }
 
+/*
+ * Count of the entries created and deleted in each block, see _AJ_GetNVChangeCount()
+ */
+static uint32_t nvChanges[AJ_NVRAM_ID_END_SENTINEL];
+
+#if AJ_NVRAM_INDEX_SIZE
+/*
+ * The NVRAM index maps an entry id to the offset of the entry in its block and records where the
+ * free space at the end of each block starts, so finding an entry, or the place for a new one, does
+ * not walk the packed entry list. The index is built from the blocks the first time it is needed
+ * and is updated as entries are created and deleted. The target invalidates it when entries are
+ * erased or moved. If there are more entries than AJ_NVRAM_INDEX_SIZE slots the entry lists are
+ * walked instead.
+ */
+typedef struct _NV_IndexEntry {
+    uint16_t id;        /**< Entry id, INVALID_DATA if the slot is free or INVALID_ID if the entry was deleted */
+    uint32_t offset;    /**< Offset of the entry from the start of its block */
+} NV_IndexEntry;
+
+#define NV_INDEX_INVALID  0
+#define NV_INDEX_VALID    1
+#define NV_INDEX_OVERFLOW 2
+
+static NV_IndexEntry nvIndex[AJ_NVRAM_INDEX_SIZE];
+static uint32_t nvIndexFree[AJ_NVRAM_ID_END_SENTINEL];
+static uint32_t nvIndexUsed;
+static uint8_t nvIndexState = NV_INDEX_INVALID;
+
+static uint8_t IndexInsert(uint16_t id, uint32_t offset)
+{
+    uint32_t slot = id % AJ_NVRAM_INDEX_SIZE;
+
+    while ((nvIndex[slot].id != INVALID_DATA) && (nvIndex[slot].id != INVALID_ID)) {
+        slot = (slot + 1) % AJ_NVRAM_INDEX_SIZE;
+    }
+    if (nvIndex[slot].id == INVALID_DATA) {
+        /*
+         * Always leave one free slot so that probing terminates
+         */
+        if ((nvIndexUsed + 1) >= AJ_NVRAM_INDEX_SIZE) {
+            return FALSE;
+        }
+        ++nvIndexUsed;
+    }
+    nvIndex[slot].id = id;
+    nvIndex[slot].offset = offset;
+    return TRUE;
+}
+
+static NV_IndexEntry* IndexLookup(uint16_t id)
+{
+    uint32_t slot = id % AJ_NVRAM_INDEX_SIZE;
+
+    while (nvIndex[slot].id != INVALID_DATA) {
+        if (nvIndex[slot].id == id) {
+            return &nvIndex[slot];
+        }
+        slot = (slot + 1) % AJ_NVRAM_INDEX_SIZE;
+    }
+    return NULL;
+}
+
+static void BuildNVIndex(void)
+{
+    AJ_NVRAM_Block_Id blockId = (AJ_NVRAM_Block_Id)(isOldNVRAMLayout ? AJ_NVRAM_ID_ALL_BLOCKS : AJ_NVRAM_ID_ALL_BLOCKS + 1);
+
+    memset(nvIndex, 0xFF, sizeof(nvIndex));
+    nvIndexUsed = 0;
+    nvIndexState = NV_INDEX_VALID;
+    for (; blockId < AJ_NVRAM_ID_END_SENTINEL; blockId = (AJ_NVRAM_Block_Id)(blockId + 1)) {
+        uint8_t* base = _AJ_GetNVBlockBase(blockId);
+        uint16_t* data = (uint16_t*)(base + SENTINEL_OFFSET);
+
+        while (((uint8_t*)data < _AJ_GetNVBlockEnd(blockId)) && (*data != INVALID_DATA)) {
+            if ((*data != INVALID_ID) && !IndexInsert(*data, (uint32_t)((uint8_t*)data - base))) {
+                AJ_WarnPrintf(("BuildNVIndex(): AJ_NVRAM_INDEX_SIZE too small - using linear lookup\n"));
+                nvIndexState = NV_INDEX_OVERFLOW;
+                return;
+            }
+            data += (ENTRY_HEADER_SIZE + *(data + 1)) >> 1;
+        }
+        nvIndexFree[blockId] = (uint32_t)((uint8_t*)data - base);
+        if (isOldNVRAMLayout) {
+            break;
+        }
+    }
+}
+
+/*
+ * Record an entry that was just created at the start of the free space of a block
+ */
+static void IndexAdd(AJ_NVRAM_Block_Id blockId, const uint8_t* entry)
+{
+    if (nvIndexState == NV_INDEX_VALID) {
+        uint32_t offset = (uint32_t)(entry - _AJ_GetNVBlockBase(blockId));
+        const NV_EntryHeader* header = (const NV_EntryHeader*)entry;
+
+        if (IndexInsert(header->id, offset)) {
+            nvIndexFree[blockId] = offset + ENTRY_HEADER_SIZE + header->capacity;
+        } else {
+            nvIndexState = NV_INDEX_INVALID;
+        }
+    }
+}
+
+static void IndexRemove(uint16_t id)
+{
+    if (nvIndexState == NV_INDEX_VALID) {
+        NV_IndexEntry* entry = IndexLookup(id);
+        if (entry) {
+            entry->id = INVALID_ID;
+        }
+    }
+}
+#else
+#define IndexAdd(blockId, entry)
+#define IndexRemove(id)
+#endif
+
+void _AJ_InvalidateNVIndex(void)
+{
+    uint8_t i;
+
+#if AJ_NVRAM_INDEX_SIZE
+    nvIndexState = NV_INDEX_INVALID;
+#endif
+    for (i = 0; i < AJ_NVRAM_ID_END_SENTINEL; ++i) {
+        ++nvChanges[i];
+    }
+}
+
+uint32_t _AJ_GetNVChangeCount(uint16_t id)
+{
+    AJ_NVRAM_Block_Id blockId = _AJ_NVRAM_Find_NV_Storage(id);
+    return (blockId < AJ_NVRAM_ID_END_SENTINEL) ? nvChanges[blockId] : 0;
+}
+
 static uint32_t _AJ_GetNVRAMBlockUsedSize(uint8_t* beginAddress, uint8_t* endAddress)
 {
     uint32_t size = 0;
@@ -101,7 +239,7 @@ static uint32_t _AJ_GetNVRAMBlockUsedSize(uint8_t* beginAddress, uint8_t* endAdd
     return size + SENTINEL_OFFSET;
 }
 
-uint32_t AJ_NVRAM_GetSize_NewLayout(AJ_NVRAM_Block_Id blockId)
+static uint32_t GetUsedSize(AJ_NVRAM_Block_Id blockId)
 {
     if ((blockId == AJ_NVRAM_ID_ALL_BLOCKS) && !isOldNVRAMLayout) {
         uint32_t sum = 0;
@@ -115,6 +253,15 @@ uint32_t AJ_NVRAM_GetSize_NewLayout(AJ_NVRAM_Block_Id blockId)
     }
 }
 
+uint32_t AJ_NVRAM_GetSize_NewLayout(AJ_NVRAM_Block_Id blockId)
+{
+    uint32_t result;
+    AJ_SHARED_LOCK();
+    result = GetUsedSize(blockId);
+    AJ_SHARED_UNLOCK();
+    return result;
+}
+
 uint32_t AJ_NVRAM_GetSize()
 {
     return AJ_NVRAM_GetSize_NewLayout(AJ_NVRAM_ID_ALL_BLOCKS);
@@ -122,7 +269,7 @@ uint32_t AJ_NVRAM_GetSize()
 
 extern AJ_Status _AJ_CompactNVStorage(AJ_NVRAM_Block_Id blockId);
 
-uint32_t AJ_NVRAM_GetSizeRemaining_NewLayout(AJ_NVRAM_Block_Id blockId)
+static uint32_t GetSizeRemaining(AJ_NVRAM_Block_Id blockId)
 {
     if ((blockId == AJ_NVRAM_ID_ALL_BLOCKS) && !isOldNVRAMLayout) {
         uint32_t sum = 0;
@@ -131,14 +278,23 @@ uint32_t AJ_NVRAM_GetSizeRemaining_NewLayout(AJ_NVRAM_Block_Id blockId)
             _AJ_CompactNVStorage(_blockId);
             sum += _AJ_GetNVBlockSize(_blockId);
         }
-        sum -= AJ_NVRAM_GetSize_NewLayout(blockId);
+        sum -= GetUsedSize(blockId);
         return sum;
     } else {
         _AJ_CompactNVStorage(isOldNVRAMLayout ? AJ_NVRAM_ID_ALL_BLOCKS : blockId);
-        return _AJ_GetNVBlockSize(blockId) - AJ_NVRAM_GetSize_NewLayout(blockId);
+        return _AJ_GetNVBlockSize(blockId) - GetUsedSize(blockId);
     }
 }
 
+uint32_t AJ_NVRAM_GetSizeRemaining_NewLayout(AJ_NVRAM_Block_Id blockId)
+{
+    uint32_t result;
+    AJ_SHARED_LOCK();
+    result = GetSizeRemaining(blockId);
+    AJ_SHARED_UNLOCK();
+    return result;
+}
+
 uint32_t AJ_NVRAM_GetSizeRemaining()
 {
     return AJ_NVRAM_GetSizeRemaining_NewLayout(AJ_NVRAM_ID_ALL_BLOCKS);
@@ -186,6 +342,29 @@ uint8_t* AJ_FindNVEntry(AJ_NVRAM_Block_Id blockId, uint16_t id)
 
     AJ_InfoPrintf(("AJ_FindNVEntry(id=%d.)\n", id));
 
+#if AJ_NVRAM_INDEX_SIZE
+    if (nvIndexState == NV_INDEX_INVALID) {
+        BuildNVIndex();
+    }
+    if ((nvIndexState == NV_INDEX_VALID) && (id != INVALID_ID)) {
+        uint8_t* base = _AJ_GetNVBlockBase(blockId);
+        uint8_t* entry = NULL;
+
+        if (id == INVALID_DATA) {
+            if ((base + nvIndexFree[blockId]) < _AJ_GetNVBlockEnd(blockId)) {
+                entry = base + nvIndexFree[blockId];
+            }
+        } else {
+            const NV_IndexEntry* index = IndexLookup(id);
+            if (index) {
+                entry = base + index->offset;
+            }
+        }
+        AJ_InfoPrintf(("AJ_FindNVEntry(): data=0x%p\n", entry));
+        return entry;
+    }
+#endif
+
     while ((uint8_t*)data < (uint8_t*)_AJ_GetNVBlockEnd(blockId)) {
         if (*data != id) {
             capacity = *(data + 1);
@@ -202,7 +381,7 @@ uint8_t* AJ_FindNVEntry(AJ_NVRAM_Block_Id blockId, uint16_t id)
     return NULL;
 }
 
-AJ_Status AJ_NVRAM_Create(uint16_t id, uint16_t capacity)
+static AJ_Status CreateEntry(uint16_t id, uint16_t capacity)
 {
     uint8_t* ptr;
     NV_EntryHeader header;
@@ -229,10 +408,21 @@ AJ_Status AJ_NVRAM_Create(uint16_t id, uint16_t capacity)
     header.id = id;
     header.capacity = capacity;
     _AJ_NV_Write(blockId, ptr, &header, ENTRY_HEADER_SIZE, TRUE);
+    IndexAdd(blockId, ptr);
+    ++nvChanges[blockId];
     return AJ_OK;
 }
 
-AJ_Status AJ_NVRAM_SecureDelete(uint16_t id)
+AJ_Status AJ_NVRAM_Create(uint16_t id, uint16_t capacity)
+{
+    AJ_Status result;
+    AJ_SHARED_LOCK();
+    result = CreateEntry(id, capacity);
+    AJ_SHARED_UNLOCK();
+    return result;
+}
+
+static AJ_Status SecureDeleteEntry(uint16_t id)
 {
     NV_EntryHeader newHeader;
     uint8_t* ptr = NULL;
@@ -254,6 +444,8 @@ AJ_Status AJ_NVRAM_SecureDelete(uint16_t id)
     memcpy(&newHeader, ptr, ENTRY_HEADER_SIZE);
     newHeader.id = 0;
     _AJ_NV_Write(blockId, ptr, &newHeader, ENTRY_HEADER_SIZE, FALSE);
+    IndexRemove(id);
+    ++nvChanges[blockId];
 
     buf = (uint8_t*)AJ_Malloc(newHeader.capacity);
 
@@ -269,7 +461,16 @@ AJ_Status AJ_NVRAM_SecureDelete(uint16_t id)
     return AJ_OK;
 }
 
-AJ_Status AJ_NVRAM_Delete(uint16_t id)
+AJ_Status AJ_NVRAM_SecureDelete(uint16_t id)
+{
+    AJ_Status result;
+    AJ_SHARED_LOCK();
+    result = SecureDeleteEntry(id);
+    AJ_SHARED_UNLOCK();
+    return result;
+}
+
+static AJ_Status DeleteEntry(uint16_t id)
 {
     NV_EntryHeader newHeader;
     uint8_t* ptr = NULL;
@@ -290,10 +491,21 @@ AJ_Status AJ_NVRAM_Delete(uint16_t id)
     memcpy(&newHeader, ptr, ENTRY_HEADER_SIZE);
     newHeader.id = 0;
     _AJ_NV_Write(blockId, ptr, &newHeader, ENTRY_HEADER_SIZE, FALSE);
+    IndexRemove(id);
+    ++nvChanges[blockId];
 
     return AJ_OK;
 }
 
+AJ_Status AJ_NVRAM_Delete(uint16_t id)
+{
+    AJ_Status result;
+    AJ_SHARED_LOCK();
+    result = DeleteEntry(id);
+    AJ_SHARED_UNLOCK();
+    return result;
+}
+
 AJ_NV_DATASET* AJ_NVRAM_Open(uint16_t id, const char* mode, uint16_t capacity)
 {
     AJ_Status status = AJ_OK;
@@ -303,6 +515,11 @@ AJ_NV_DATASET* AJ_NVRAM_Open(uint16_t id, const char* mode, uint16_t capacity)
 
     AJ_InfoPrintf(("AJ_NVRAM_Open(id=%d., mode=\"%s\", capacity=%d.)\n", id, mode, capacity));
 
+    /*
+     * The lock is held until the data set is closed so other threads cannot move the entry
+     */
+    AJ_SHARED_LOCK();
+
     if (!id || (id == INVALID_DATA)) {
         AJ_ErrPrintf(("AJ_NVRAM_Open(): invalid id\n"));
         goto OPEN_ERR_EXIT;
@@ -363,6 +580,7 @@ OPEN_ERR_EXIT:
         handle = NULL;
     }
     AJ_ErrPrintf(("AJ_NVRAM_Open(): failure: status=%s\n", AJ_StatusText(status)));
+    AJ_SHARED_UNLOCK();
     return NULL;
 }
 
@@ -461,26 +679,36 @@ AJ_Status AJ_NVRAM_Close(AJ_NV_DATASET* handle)
 
     AJ_Free(handle);
     handle = NULL;
+    AJ_SHARED_UNLOCK();
     return AJ_OK;
 }
 
 uint8_t AJ_NVRAM_Exist(uint16_t id)
 {
+    uint8_t exists;
+
     AJ_InfoPrintf(("AJ_NVRAM_Exist(id=%d.)\n", id));
 
     if (!id || (id == INVALID_DATA)) {
         AJ_ErrPrintf(("AJ_NVRAM_Exist(): AJ_ERR_INVALID\n"));
         return FALSE; // the unique id is not allowed to be 0 or 0xffff
     }
-    return (NULL != AJ_FindNVEntry(_AJ_NVRAM_Find_NV_Storage(id), id));
+    AJ_SHARED_LOCK();
+    exists = (NULL != AJ_FindNVEntry(_AJ_NVRAM_Find_NV_Storage(id), id));
+    AJ_SHARED_UNLOCK();
+    return exists;
 }
 
 void AJ_NVRAM_Clear()
 {
+    AJ_SHARED_LOCK();
     _AJ_NVRAM_Clear(AJ_NVRAM_ID_ALL_BLOCKS);
+    AJ_SHARED_UNLOCK();
 }
 
 void AJ_NVRAM_Clear_NewLayout(AJ_NVRAM_Block_Id blockId)
 {
+    AJ_SHARED_LOCK();
     _AJ_NVRAM_Clear(isOldNVRAMLayout ? AJ_NVRAM_ID_ALL_BLOCKS : blockId);
+    AJ_SHARED_UNLOCK();
 }
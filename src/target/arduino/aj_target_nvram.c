@@ -52,6 +52,7 @@ uint8_t isOldNVRAMLayout = TRUE;
 
 static void _AJ_NVRAM_Init(uint8_t index, uint8_t size)
 {
+    _AJ_InvalidateNVIndex();
     for (; index < size; ++index) {
         if (*((uint32_t*)nvStorages[index].blockStart) != AJ_NV_SENTINEL) {
             _AJ_NVRAM_Clear((AJ_NVRAM_Block_Id)index);
@@ -165,6 +166,7 @@ static void _AJ_NV_Clear(uint8_t index)
 
 void _AJ_NVRAM_Clear(AJ_NVRAM_Block_Id blockId)
 {
+    _AJ_InvalidateNVIndex();
     if ((blockId == AJ_NVRAM_ID_ALL_BLOCKS) && !isOldNVRAMLayout) {
         AJ_NVRAM_Block_Id _blockId;
         for (_blockId = (AJ_NVRAM_Block_Id)(blockId + 1); _blockId < AJ_NVRAM_ID_END_SENTINEL; _blockId = (AJ_NVRAM_Block_Id)(_blockId + 1)) {
@@ -201,11 +203,15 @@ AJ_Status _AJ_CompactNVStorage(AJ_NVRAM_Block_Id blockId)
     }
 
     memset(writePtr, INVALID_DATA_BYTE, garbage);
+    if (garbage) {
+        _AJ_InvalidateNVIndex();
+    }
     nvStorages[blockId].isCompact = TRUE;
     return AJ_OK;
 }
 
 void _AJ_NVRAM_ResetLayout()
 {
+    _AJ_InvalidateNVIndex();
     nvStorages = NULL;
 }
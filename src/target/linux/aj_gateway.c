@@ -0,0 +1,124 @@
+/**
+ * @file
+ */
+/******************************************************************************
+ *    Copyright (c) Open Connectivity Foundation (OCF), AllJoyn Open Source
+ *    Project (AJOSP) Contributors and others.
+ *
+ *    SPDX-License-Identifier: Apache-2.0
+ *
+ *    All rights reserved. This program and the accompanying materials are
+ *    made available under the terms of the Apache License, Version 2.0
+ *    which accompanies this distribution, and is available at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Copyright (c) Open Connectivity Foundation and Contributors to AllSeen
+ *    Alliance. All rights reserved.
+ *
+ *    Permission to use, copy, modify, and/or distribute this software for
+ *    any purpose with or without fee is hereby granted, provided that the
+ *    above copyright notice and this permission notice appear in all
+ *    copies.
+ *
+ *    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ *    WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+ *    WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+ *    AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+ *    DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR
+ *    PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ *    TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ *    PERFORMANCE OF THIS SOFTWARE.
+ ******************************************************************************/
+
+/**
+ * Per-module definition of the current module for debug logging.  Must be defined
+ * prior to first inclusion of aj_debug.h
+ */
+#define AJ_MODULE GATEWAY
+
+#include <pthread.h>
+#include <ajtcl/alljoyn.h>
+#include <ajtcl/aj_helper.h>
+#include <ajtcl/aj_util.h>
+#include <ajtcl/aj_debug.h>
+
+#ifdef AJ_GATEWAY
+
+/**
+ * Turn on per-module debug printing by setting this variable to non-zero value
+ * (usually in debugger).
+ */
+#ifdef AJ_DEBUG_BUILD
+uint8_t dbgGATEWAY = 0;
+#endif
+
+typedef struct {
+    pthread_t thread;
+    AJ_BusAttachment* bus;
+    AJ_GatewayFunc func;
+    void* context;
+    uint8_t ownContext;   /* Context was created by AJ_GatewayRun() */
+    uint8_t running;
+} GatewayWorker;
+
+static void* WorkerMain(void* arg)
+{
+    GatewayWorker* worker = (GatewayWorker*)arg;
+
+    AJ_InfoPrintf(("WorkerMain(): bus=0x%p\n", worker->bus));
+    /*
+     * The current bus state is per-thread so this selection is only seen by this worker
+     */
+    AJ_BusContextSelect(worker->bus);
+    worker->func(worker->bus, worker->context);
+    AJ_BusContextSelect(NULL);
+    return NULL;
+}
+
+AJ_Status AJ_GatewayRun(AJ_BusAttachment* buses, uint16_t numBuses, AJ_GatewayFunc func, void* context)
+{
+    AJ_Status status = AJ_OK;
+    GatewayWorker* workers;
+    uint16_t i;
+
+    if (!buses || !func) {
+        return AJ_ERR_NULL;
+    }
+    workers = (GatewayWorker*)AJ_Malloc(numBuses * sizeof(GatewayWorker));
+    if (!workers) {
+        return AJ_ERR_RESOURCES;
+    }
+    memset(workers, 0, numBuses * sizeof(GatewayWorker));
+    for (i = 0; i < numBuses; ++i) {
+        GatewayWorker* worker = &workers[i];
+        worker->bus = &buses[i];
+        worker->func = func;
+        worker->context = context;
+        if (!worker->bus->context) {
+            status = AJ_BusContextCreate(worker->bus);
+            if (status != AJ_OK) {
+                break;
+            }
+            worker->ownContext = TRUE;
+        }
+        if (pthread_create(&worker->thread, NULL, WorkerMain, worker) != 0) {
+            AJ_ErrPrintf(("AJ_GatewayRun(): pthread_create() failed for bus %u\n", i));
+            status = AJ_ERR_RESOURCES;
+            break;
+        }
+        worker->running = TRUE;
+    }
+    for (i = 0; i < numBuses; ++i) {
+        GatewayWorker* worker = &workers[i];
+        if (worker->running) {
+            pthread_join(worker->thread, NULL);
+        }
+        if (worker->ownContext) {
+            AJ_BusContextDestroy(worker->bus);
+        }
+    }
+    AJ_Free(workers);
+    return status;
+}
+
+#endif // AJ_GATEWAY
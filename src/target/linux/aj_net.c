@@ -41,7 +41,10 @@
 #include <limits.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/eventfd.h>
+#include <sys/epoll.h>
+#include <poll.h>
 #include <sys/fcntl.h>
 #include <arpa/inet.h>
 #include <sys/ioctl.h>
@@ -130,7 +133,7 @@ typedef struct {
 } MCastContext;
 
 static NetContext netContext = { INVALID_SOCKET, INVALID_SOCKET };
-static MCastContext mCastContext = { INVALID_SOCKET, INVALID_SOCKET, INVALID_SOCKET, INVALID_SOCKET };
+static AJ_THREAD_LOCAL MCastContext mCastContext = { INVALID_SOCKET, INVALID_SOCKET, INVALID_SOCKET, INVALID_SOCKET };
 
 #ifdef AJ_ARDP
 /**
@@ -142,6 +145,276 @@ static AJ_Status RewriteSenderInfo(AJ_IOBuffer* buf, struct sockaddr* saddr);
 
 #endif // AJ_ARDP
 
+/*
+ * An eventfd handle used for interrupting a network read blocked waiting for events. The interrupt
+ * is process-wide except in gateway builds where each thread has its own event loop.
+ */
+static AJ_THREAD_LOCAL int interruptFd = INVALID_SOCKET;
+static AJ_THREAD_LOCAL uint32_t interruptRefs;
+
+/*
+ * Set while waiting for events
+ */
+static AJ_THREAD_LOCAL uint8_t blocked;
+
+/*
+ * Maximum number of file descriptors in the event loop, this includes the bus attachment,
+ * multicast and interrupt sockets as well as any application file descriptors.
+ */
+#if !defined(AJ_MAX_EVENT_FDS)
+#define AJ_MAX_EVENT_FDS 16
+#endif
+
+/*
+ * A file descriptor in the event loop. Readiness is edge-triggered so a network socket is marked
+ * ready when an event is reported and stays ready until a read would block. Application file
+ * descriptors have a handler that is called when an event is reported.
+ */
+typedef struct {
+    int fd;
+    uint8_t ready;
+    AJ_FdHandler handler;
+    void* context;
+} EventFd;
+
+/*
+ * In gateway builds each thread runs its own event loop so bus attachments on different threads
+ * never wait on each other's sockets
+ */
+static AJ_THREAD_LOCAL int epollFd = INVALID_SOCKET;
+static AJ_THREAD_LOCAL EventFd eventFds[AJ_MAX_EVENT_FDS];
+static AJ_THREAD_LOCAL uint8_t numEventFds;
+
+static EventFd* FindEventFd(int fd)
+{
+    uint8_t i;
+    for (i = 0; i < numEventFds; ++i) {
+        if (eventFds[i].fd == fd) {
+            return &eventFds[i];
+        }
+    }
+    return NULL;
+}
+
+static AJ_Status AddEventFd(int fd, AJ_FdHandler handler, void* context)
+{
+    struct epoll_event ev;
+    EventFd* efd;
+
+    if ((fd < 0) || FindEventFd(fd)) {
+        return AJ_ERR_FAILURE;
+    }
+    if (numEventFds == AJ_MAX_EVENT_FDS) {
+        AJ_ErrPrintf(("AddEventFd(): AJ_ERR_RESOURCES\n"));
+        return AJ_ERR_RESOURCES;
+    }
+    if (epollFd == INVALID_SOCKET) {
+        epollFd = epoll_create(AJ_MAX_EVENT_FDS);
+        if (epollFd < 0) {
+            AJ_ErrPrintf(("AddEventFd(): epoll_create() failed. errno=\"%s\"\n", strerror(errno)));
+            epollFd = INVALID_SOCKET;
+            return AJ_ERR_FAILURE;
+        }
+        fcntl(epollFd, F_SETFD, FD_CLOEXEC);
+    }
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+    ev.data.fd = fd;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        AJ_ErrPrintf(("AddEventFd(): epoll_ctl() failed. errno=\"%s\"\n", strerror(errno)));
+        return AJ_ERR_FAILURE;
+    }
+    efd = &eventFds[numEventFds++];
+    efd->fd = fd;
+    efd->ready = FALSE;
+    efd->handler = handler;
+    efd->context = context;
+    return AJ_OK;
+}
+
+static void RemoveEventFd(int fd)
+{
+    EventFd* efd = FindEventFd(fd);
+    if (efd) {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, NULL);
+        *efd = eventFds[--numEventFds];
+        if (!numEventFds) {
+            close(epollFd);
+            epollFd = INVALID_SOCKET;
+        }
+    }
+}
+
+/*
+ * Called when a read on a network socket would block
+ */
+static void NotReady(int fd)
+{
+    EventFd* efd = FindEventFd(fd);
+    if (efd) {
+        efd->ready = FALSE;
+    }
+}
+
+/*
+ * Wait for and dispatch events. Returns AJ_OK if any events were reported.
+ */
+static AJ_Status DispatchEvents(uint32_t timeout)
+{
+    struct epoll_event events[AJ_MAX_EVENT_FDS];
+    uint8_t interrupted = FALSE;
+    int rc;
+    int i;
+
+    if (epollFd == INVALID_SOCKET) {
+        return AJ_ERR_READ;
+    }
+    blocked = TRUE;
+    rc = epoll_wait(epollFd, events, AJ_MAX_EVENT_FDS, (int)min(timeout, (uint32_t)INT_MAX));
+    blocked = FALSE;
+    if (rc < 0) {
+        if (errno == EINTR) {
+            return AJ_ERR_TIMEOUT;
+        }
+        AJ_ErrPrintf(("DispatchEvents(): epoll_wait() failed. errno=\"%s\"\n", strerror(errno)));
+        return AJ_ERR_READ;
+    }
+    if (rc == 0) {
+        return AJ_ERR_TIMEOUT;
+    }
+    for (i = 0; i < rc; ++i) {
+        EventFd* efd;
+        if (events[i].data.fd == interruptFd) {
+            uint64_t u64;
+            if (read(interruptFd, &u64, sizeof(u64)) < 0) {
+                AJ_ErrPrintf(("DispatchEvents(): read() failed during interrupt. errno=\"%s\"\n", strerror(errno)));
+            }
+            interrupted = TRUE;
+            continue;
+        }
+        /*
+         * Look up each time in case a handler removed a file descriptor
+         */
+        efd = FindEventFd(events[i].data.fd);
+        if (efd) {
+            if (efd->handler) {
+                efd->handler(efd->fd, efd->context);
+            } else {
+                efd->ready = TRUE;
+            }
+        }
+    }
+    return interrupted ? AJ_ERR_INTERRUPTED : AJ_OK;
+}
+
+/*
+ * Wait until one of the network sockets is ready to read. Application file descriptors are serviced
+ * while waiting.
+ */
+static AJ_Status WaitForReady(const int* fds, uint8_t numFds, uint32_t timeout, int* readyFd)
+{
+    AJ_Status status;
+    AJ_Time timer;
+
+    AJ_InitTimer(&timer);
+    while (TRUE) {
+        uint32_t elapsed;
+        uint8_t i;
+        for (i = 0; i < numFds; ++i) {
+            EventFd* efd = FindEventFd(fds[i]);
+            if (efd && efd->ready) {
+                *readyFd = fds[i];
+                return AJ_OK;
+            }
+        }
+        elapsed = AJ_GetElapsedTime(&timer, TRUE);
+        if (elapsed >= timeout) {
+            return AJ_ERR_TIMEOUT;
+        }
+        status = DispatchEvents(timeout - elapsed);
+        if ((status != AJ_OK) && (status != AJ_ERR_TIMEOUT)) {
+            return status;
+        }
+    }
+}
+
+/*
+ * The interrupt event is shared by all bus attachments and application file descriptors in the
+ * same event loop
+ */
+static int OpenInterruptFd(void)
+{
+    if (interruptFd != INVALID_SOCKET) {
+        ++interruptRefs;
+        return interruptFd;
+    }
+    interruptFd = eventfd(0, O_NONBLOCK);  // Use O_NONBLOCK instead of EFD_NONBLOCK due to bug in OpenWrt's uCLibc
+    if (interruptFd < 0) {
+        interruptFd = INVALID_SOCKET;
+    } else if (AddEventFd(interruptFd, NULL, NULL) != AJ_OK) {
+        close(interruptFd);
+        interruptFd = INVALID_SOCKET;
+    } else {
+        interruptRefs = 1;
+    }
+    return interruptFd;
+}
+
+static void CloseInterruptFd(void)
+{
+    if ((interruptFd != INVALID_SOCKET) && !--interruptRefs) {
+        RemoveEventFd(interruptFd);
+        close(interruptFd);
+        interruptFd = INVALID_SOCKET;
+    }
+}
+
+AJ_Status AJ_Net_AddFd(int fd, AJ_FdHandler handler, void* context)
+{
+    AJ_Status status;
+
+    if (!handler) {
+        return AJ_ERR_FAILURE;
+    }
+    /*
+     * Open the interrupt event so AJ_Net_Interrupt() can wake AJ_Net_Poll()
+     */
+    if (OpenInterruptFd() == INVALID_SOCKET) {
+        return AJ_ERR_RESOURCES;
+    }
+    status = AddEventFd(fd, handler, context);
+    if (status != AJ_OK) {
+        CloseInterruptFd();
+    }
+    return status;
+}
+
+void AJ_Net_RemoveFd(int fd)
+{
+    if ((fd != interruptFd) && FindEventFd(fd)) {
+        RemoveEventFd(fd);
+        CloseInterruptFd();
+    }
+}
+
+AJ_Status AJ_Net_Poll(uint32_t timeout)
+{
+    return DispatchEvents(timeout);
+}
+
+/*
+ * This function is called to cancel a pending wait for events.
+ */
+void AJ_Net_Interrupt()
+{
+    if (blocked) {
+        uint64_t u64 = 1;
+        if (write(interruptFd, &u64, sizeof(u64)) < 0) {
+            AJ_ErrPrintf(("AJ_Net_Interrupt(): write() failed. errno=\"%s\"\n", strerror(errno)));
+        }
+    }
+}
+
 #ifdef AJ_TCP
 static AJ_Status CloseNetSock(AJ_NetSocket* netSock)
 {
@@ -153,6 +426,7 @@ static AJ_Status CloseNetSock(AJ_NetSocket* netSock)
             l.l_linger = 0;
             setsockopt(context->tcpSock, SOL_SOCKET, SO_LINGER, (void*)&l, sizeof(l));
             shutdown(context->tcpSock, SHUT_RDWR);
+            RemoveEventFd(context->tcpSock);
             close(context->tcpSock);
         }
         context->tcpSock = INVALID_SOCKET;
@@ -167,9 +441,11 @@ static AJ_Status CloseMCastSock(AJ_MCastSocket* mcastSock)
     MCastContext* context = (MCastContext*)mcastSock->rx.context;
     if (context) {
         if (context->udpSock != INVALID_SOCKET) {
+            RemoveEventFd(context->udpSock);
             close(context->udpSock);
         }
         if (context->udp6Sock != INVALID_SOCKET) {
+            RemoveEventFd(context->udp6Sock);
             close(context->udp6Sock);
         }
         if (context->mDnsSock != INVALID_SOCKET) {
@@ -179,9 +455,11 @@ static AJ_Status CloseMCastSock(AJ_MCastSocket* mcastSock)
             close(context->mDns6Sock);
         }
         if (context->mDnsRecvSock != INVALID_SOCKET) {
+            RemoveEventFd(context->mDnsRecvSock);
             close(context->mDnsRecvSock);
         }
         if (context->mDns6RecvSock != INVALID_SOCKET) {
+            RemoveEventFd(context->mDns6RecvSock);
             close(context->mDns6RecvSock);
         }
         context->udpSock = context->udp6Sock = context->mDnsSock = context->mDns6Sock = context->mDnsRecvSock = context->mDns6RecvSock = INVALID_SOCKET;
@@ -216,30 +494,59 @@ AJ_Status AJ_Net_Send(AJ_IOBuffer* buf)
     AJ_InfoPrintf(("AJ_Net_Send(): status=AJ_OK\n"));
     return AJ_OK;
 }
-#endif
-
-/*
- * An eventfd handle used for interrupting a network read blocked on select
- */
-static int interruptFd = INVALID_SOCKET;
 
 /*
- * The socket that is blocked in select
+ * Maximum number of pieces passed to a single sendmsg call
  */
-static uint8_t blocked;
+#define MAX_SEND_IOV 16
 
-/*
- * This function is called to cancel a pending select.
- */
-void AJ_Net_Interrupt()
+static AJ_Status AJ_Net_SendV(AJ_IOBuffer* buf, const AJ_IOVec* iov, uint16_t iovCount)
 {
-    if (blocked) {
-        uint64_t u64;
-        if (write(interruptFd, &u64, sizeof(u64)) < 0) {
-            AJ_ErrPrintf(("AJ_Net_Interrupt(): write() failed. errno=\"%s\"\n", strerror(errno)));
+    NetContext* context = (NetContext*) buf->context;
+    struct iovec vec[MAX_SEND_IOV];
+    struct msghdr msgHdr;
+    size_t skip = 0;
+    ssize_t ret;
+
+    AJ_InfoPrintf(("AJ_Net_SendV(buf=0x%p, iovCount=%u)\n", buf, iovCount));
+
+    AJ_ASSERT(buf->direction == AJ_IO_BUF_TX);
+
+    while (iovCount) {
+        size_t n;
+        /*
+         * The first piece may have been partially sent by the previous sendmsg call
+         */
+        for (n = 0; (n < iovCount) && (n < MAX_SEND_IOV); ++n) {
+            vec[n].iov_base = (void*)(iov[n].data + (n ? 0 : skip));
+            vec[n].iov_len = iov[n].len - (n ? 0 : skip);
         }
+        memset(&msgHdr, 0, sizeof(msgHdr));
+        msgHdr.msg_iov = vec;
+        msgHdr.msg_iovlen = n;
+        ret = sendmsg(context->tcpSock, &msgHdr, MSG_NOSIGNAL);
+        if (ret == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            AJ_ErrPrintf(("AJ_Net_SendV(): sendmsg() failed. errno=\"%s\", status=AJ_ERR_WRITE\n", strerror(errno)));
+            return AJ_ERR_WRITE;
+        }
+        /*
+         * Skip over the pieces that were completely sent
+         */
+        ret += skip;
+        while (iovCount && ((size_t)ret >= iov->len)) {
+            ret -= iov->len;
+            ++iov;
+            --iovCount;
+        }
+        skip = (size_t)ret;
     }
+    AJ_InfoPrintf(("AJ_Net_SendV(): status=AJ_OK\n"));
+    return AJ_OK;
 }
+#endif
 
 #ifdef AJ_TCP
 AJ_Status AJ_Net_Recv(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
@@ -247,37 +554,27 @@ AJ_Status AJ_Net_Recv(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
     NetContext* context = (NetContext*) buf->context;
     AJ_Status status = AJ_OK;
     size_t rx = AJ_IO_BUF_SPACE(buf);
-    fd_set fds;
-    int rc = 0;
-    int maxFd = context->tcpSock;
-    struct timeval tv = { timeout / 1000, 1000 * (timeout % 1000) };
+    int fd;
 
     // AJ_InfoPrintf(("AJ_Net_Recv(buf=0x%p, len=%d, timeout=%d)\n", buf, len, timeout));
 
     AJ_ASSERT(buf->direction == AJ_IO_BUF_RX);
 
-    FD_ZERO(&fds);
-    FD_SET(context->tcpSock, &fds);
-    if (interruptFd >= 0) {
-        FD_SET(interruptFd, &fds);
-        maxFd = max(maxFd, interruptFd);
-    }
-    blocked = TRUE;
-    rc = select(maxFd + 1, &fds, NULL, NULL, &tv);
-    blocked = FALSE;
-    if (rc == 0) {
-        return AJ_ERR_TIMEOUT;
-    }
-    if ((interruptFd >= 0) && FD_ISSET(interruptFd, &fds)) {
-        uint64_t u64;
-        if (read(interruptFd, &u64, sizeof(u64)) < 0) {
-            AJ_ErrPrintf(("AJ_Net_Recv(): read() failed during interrupt. errno=\"%s\"\n", strerror(errno)));
-        }
-        return AJ_ERR_INTERRUPTED;
-    }
     rx = min(rx, len);
-    if (rx) {
-        ssize_t ret = recv(context->tcpSock, buf->writePtr, rx, 0);
+    while (TRUE) {
+        ssize_t ret;
+        status = WaitForReady(&context->tcpSock, 1, timeout, &fd);
+        if ((status != AJ_OK) || !rx) {
+            break;
+        }
+        ret = recv(context->tcpSock, buf->writePtr, rx, MSG_DONTWAIT);
+        if ((ret == -1) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+            /*
+             * Drained the socket, wait for the next edge
+             */
+            NotReady(context->tcpSock);
+            continue;
+        }
         if ((ret == -1) || (ret == 0)) {
             AJ_ErrPrintf(("AJ_Net_Recv(): recv() failed. errno=\"%s\"\n", strerror(errno)));
             status = AJ_ERR_READ;
@@ -285,6 +582,7 @@ AJ_Status AJ_Net_Recv(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
             AJ_InfoPrintf(("AJ_Net_Recv(): recv'd %d from tcp\n", ret));
             buf->writePtr += ret;
         }
+        break;
     }
     return status;
 }
@@ -293,6 +591,46 @@ AJ_Status AJ_Net_Recv(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
 static uint8_t rxData[AJ_RX_DATA_SIZE];
 static uint8_t txData[AJ_TX_DATA_SIZE];
 
+/*
+ * Bus attachments that have their own context also have their own connection state and buffers
+ */
+typedef struct {
+    NetContext net;
+    uint8_t rxData[AJ_RX_DATA_SIZE];
+    uint8_t txData[AJ_TX_DATA_SIZE];
+} NetConnection;
+
+static NetContext* InitNetSock(AJ_BusAttachment* bus, AJ_RxFunc recv, AJ_TxFunc send)
+{
+    NetContext* context = &netContext;
+    uint8_t* rx = rxData;
+    uint8_t* tx = txData;
+
+    if (bus->context) {
+        NetConnection* connection = (NetConnection*)AJ_Malloc(sizeof(NetConnection));
+        if (!connection) {
+            return NULL;
+        }
+        context = &connection->net;
+        context->tcpSock = INVALID_SOCKET;
+        context->udpSock = INVALID_SOCKET;
+        rx = connection->rxData;
+        tx = connection->txData;
+    }
+    AJ_IOBufInit(&bus->sock.rx, rx, AJ_RX_DATA_SIZE, AJ_IO_BUF_RX, context);
+    bus->sock.rx.recv = recv;
+    AJ_IOBufInit(&bus->sock.tx, tx, AJ_TX_DATA_SIZE, AJ_IO_BUF_TX, context);
+    bus->sock.tx.send = send;
+    return context;
+}
+
+static void FreeNetContext(NetContext* context)
+{
+    if (context && (context != &netContext)) {
+        AJ_Free(context);
+    }
+}
+
 #ifdef AJ_TCP
 static AJ_Status AJ_TCP_Connect(AJ_BusAttachment* bus, const AJ_Service* service)
 {
@@ -300,9 +638,9 @@ static AJ_Status AJ_TCP_Connect(AJ_BusAttachment* bus, const AJ_Service* service
     struct sockaddr_storage addrBuf;
     socklen_t addrSize;
     int tcpSock = INVALID_SOCKET;
+    NetContext* context;
 
-    interruptFd = eventfd(0, O_NONBLOCK);  // Use O_NONBLOCK instead of EFD_NONBLOCK due to bug in OpenWrt's uCLibc
-    if (interruptFd < 0) {
+    if (OpenInterruptFd() < 0) {
         AJ_ErrPrintf(("AJ_TCP_Connect(): failed to created interrupt event\n"));
         goto ConnectError;
     }
@@ -337,24 +675,26 @@ static AJ_Status AJ_TCP_Connect(AJ_BusAttachment* bus, const AJ_Service* service
     if (ret < 0) {
         AJ_ErrPrintf(("AJ_TCP_Connect(): connect() failed. errno=\"%s\", status=AJ_ERR_CONNECT\n", strerror(errno)));
         goto ConnectError;
-    } else {
-        netContext.tcpSock = tcpSock;
-        AJ_IOBufInit(&bus->sock.rx, rxData, sizeof(rxData), AJ_IO_BUF_RX, &netContext);
-        bus->sock.rx.recv = AJ_Net_Recv;
-        AJ_IOBufInit(&bus->sock.tx, txData, sizeof(txData), AJ_IO_BUF_TX, &netContext);
-        bus->sock.tx.send = AJ_Net_Send;
-        AJ_InfoPrintf(("AJ_TCP_Connect(): status=AJ_OK\n"));
+    } else if (AddEventFd(tcpSock, NULL, NULL) != AJ_OK) {
+        AJ_ErrPrintf(("AJ_TCP_Connect(): failed to add socket to event loop. status=AJ_ERR_CONNECT\n"));
+        goto ConnectError;
+    }
+    context = InitNetSock(bus, AJ_Net_Recv, AJ_Net_Send);
+    if (!context) {
+        AJ_ErrPrintf(("AJ_TCP_Connect(): failed to allocate connection. status=AJ_ERR_CONNECT\n"));
+        goto ConnectError;
     }
+    context->tcpSock = tcpSock;
+    bus->sock.tx.sendv = AJ_Net_SendV;
+    AJ_InfoPrintf(("AJ_TCP_Connect(): status=AJ_OK\n"));
 
     return AJ_OK;
 
 ConnectError:
-    if (interruptFd != INVALID_SOCKET) {
-        close(interruptFd);
-        interruptFd = INVALID_SOCKET;
-    }
+    CloseInterruptFd();
 
     if (tcpSock != INVALID_SOCKET) {
+        RemoveEventFd(tcpSock);
         close(tcpSock);
     }
 
@@ -387,24 +727,153 @@ AJ_Status AJ_Net_Connect(AJ_BusAttachment* bus, const AJ_Service* service)
     return status;
 }
 
-void AJ_Net_Disconnect(AJ_NetSocket* netSock)
+/*
+ * Start a non-blocking TCP connect to a routing node, returns the socket or INVALID_SOCKET
+ */
+static int StartProbe(const AJ_Service* service, uint8_t* connected)
 {
-    if (interruptFd >= 0) {
-        close(interruptFd);
-        interruptFd = INVALID_SOCKET;
+    struct sockaddr_storage addrBuf;
+    socklen_t addrSize;
+    int sock;
+
+    memset(&addrBuf, 0, sizeof(addrBuf));
+    if (service->addrTypes & AJ_ADDR_TCP4) {
+        struct sockaddr_in* sa = (struct sockaddr_in*)&addrBuf;
+        sa->sin_family = AF_INET;
+        sa->sin_port = htons(service->ipv4port);
+        sa->sin_addr.s_addr = service->ipv4;
+        addrSize = sizeof(struct sockaddr_in);
+    } else if (service->addrTypes & AJ_ADDR_TCP6) {
+        struct sockaddr_in6* sa = (struct sockaddr_in6*)&addrBuf;
+        sa->sin6_family = AF_INET6;
+        sa->sin6_port = htons(service->ipv6port);
+        memcpy(sa->sin6_addr.s6_addr, service->ipv6, sizeof(sa->sin6_addr.s6_addr));
+        addrSize = sizeof(struct sockaddr_in6);
+    } else {
+        return INVALID_SOCKET;
+    }
+    sock = socket(addrBuf.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sock == INVALID_SOCKET) {
+        AJ_ErrPrintf(("StartProbe(): socket() failed. errno=\"%s\"\n", strerror(errno)));
+        return INVALID_SOCKET;
+    }
+    *connected = FALSE;
+    if (connect(sock, (struct sockaddr*)&addrBuf, addrSize) == 0) {
+        *connected = TRUE;
+    } else if (errno != EINPROGRESS) {
+        AJ_InfoPrintf(("StartProbe(): connect() failed. errno=\"%s\"\n", strerror(errno)));
+        close(sock);
+        return INVALID_SOCKET;
+    }
+    return sock;
+}
+
+AJ_Status AJ_Net_Probe(const AJ_Service* services, uint8_t numServices, uint32_t* rtt, uint32_t timeout, uint32_t grace)
+{
+    struct pollfd* fds;
+    AJ_Time timer;
+    uint32_t elapsed = 0;
+    uint8_t pending = 0;
+    uint8_t answered = 0;
+    uint8_t i;
+
+    fds = (struct pollfd*)AJ_Malloc(numServices * sizeof(struct pollfd));
+    if (!fds) {
+        return AJ_ERR_RESOURCES;
+    }
+    /*
+     * All the connects are started at once so the total wait is the round trip time of the
+     * fastest routing node rather than the sum of the connect timeouts of the dead ones.
+     */
+    AJ_InitTimer(&timer);
+    for (i = 0; i < numServices; ++i) {
+        uint8_t connected;
+        rtt[i] = AJ_NET_PROBE_UNREACHABLE;
+        fds[i].fd = StartProbe(&services[i], &connected);
+        fds[i].events = POLLOUT;
+        fds[i].revents = 0;
+        if (fds[i].fd == INVALID_SOCKET) {
+            continue;
+        }
+        if (connected) {
+            rtt[i] = 0;
+            ++answered;
+            close(fds[i].fd);
+            fds[i].fd = INVALID_SOCKET;
+        } else {
+            ++pending;
+        }
+    }
+    if (answered) {
+        timeout = grace;
+    }
+    while (pending && (elapsed < timeout)) {
+        int rc = poll(fds, numServices, (int)min(timeout - elapsed, (uint32_t)INT_MAX));
+        elapsed = AJ_GetElapsedTime(&timer, TRUE);
+        if (rc < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            AJ_ErrPrintf(("AJ_Net_Probe(): poll() failed. errno=\"%s\"\n", strerror(errno)));
+            break;
+        }
+        for (i = 0; i < numServices; ++i) {
+            int err = 0;
+            socklen_t len = sizeof(err);
+            if ((fds[i].fd == INVALID_SOCKET) || !fds[i].revents) {
+                continue;
+            }
+            if ((getsockopt(fds[i].fd, SOL_SOCKET, SO_ERROR, &err, &len) == 0) && !err) {
+                rtt[i] = elapsed;
+                /*
+                 * Once one routing node has answered only wait a little longer for the others
+                 */
+                if (!answered++) {
+                    timeout = min(timeout, elapsed + grace);
+                }
+            }
+            close(fds[i].fd);
+            fds[i].fd = INVALID_SOCKET;
+            --pending;
+        }
+    }
+    for (i = 0; i < numServices; ++i) {
+        if (fds[i].fd != INVALID_SOCKET) {
+            /*
+             * Still connecting, this routing node is at least as far away as the time waited
+             */
+            if (answered) {
+                rtt[i] = elapsed;
+            }
+            close(fds[i].fd);
+        }
     }
+    AJ_Free(fds);
+    AJ_InfoPrintf(("AJ_Net_Probe(): %u of %u routing nodes answered in %u ms\n", answered, numServices, elapsed));
+    return answered ? AJ_OK : AJ_ERR_CONNECT;
+}
+
+void AJ_Net_Disconnect(AJ_NetSocket* netSock)
+{
+    NetContext* context = (NetContext*)netSock->rx.context;
+
+    CloseInterruptFd();
 
-    if (netContext.udpSock != INVALID_SOCKET) {
+    if (!context) {
+        return;
+    }
+    if (context->udpSock != INVALID_SOCKET) {
 #ifdef AJ_ARDP
         // we are using UDP!
         AJ_Net_ARDP_Disconnect(netSock);
         memset(netSock, 0, sizeof(AJ_NetSocket));
 #endif
-    } else if (netContext.tcpSock != INVALID_SOCKET) {
+    } else if (context->tcpSock != INVALID_SOCKET) {
 #ifdef AJ_TCP
         CloseNetSock(netSock);
 #endif
     }
+    FreeNetContext(context);
 }
 
 static uint8_t sendToBroadcast(int sock, uint16_t port, AJ_IOBuffer* buf, size_t tx)
@@ -664,130 +1133,74 @@ AJ_Status AJ_Net_RecvFrom(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
     AJ_Status status = AJ_OK;
     ssize_t ret;
     size_t rx;
-    fd_set fds;
-    int maxFd = INVALID_SOCKET;
-    struct timeval tv = { timeout / 1000, 1000 * (timeout % 1000) };
+    int fds[4];
+    uint8_t numFds = 0;
+    int fd;
     struct sockaddr_storage sa;
     socklen_t addrlen;
-    int rc = 0;
 
     AJ_InfoPrintf(("AJ_Net_RecvFrom(buf=0x%p, len=%d, timeout=%d)\n", buf, len, timeout));
 
     AJ_ASSERT(buf->direction == AJ_IO_BUF_RX);
 
-    FD_ZERO(&fds);
-
     if (context->mDnsRecvSock != INVALID_SOCKET) {
-        FD_SET(context->mDnsRecvSock, &fds);
-        maxFd = context->mDnsRecvSock;
+        fds[numFds++] = context->mDnsRecvSock;
     }
-
     if (context->mDns6RecvSock != INVALID_SOCKET) {
-        FD_SET(context->mDns6RecvSock, &fds);
-        maxFd = max(maxFd, context->mDns6RecvSock);
+        fds[numFds++] = context->mDns6RecvSock;
     }
-
-    if (context->udpSock != INVALID_SOCKET) {
-        FD_SET(context->udpSock, &fds);
-        maxFd = max(maxFd, context->udpSock);
-    }
-
     if (context->udp6Sock != INVALID_SOCKET) {
-        FD_SET(context->udp6Sock, &fds);
-        maxFd = max(maxFd, context->udp6Sock);
+        fds[numFds++] = context->udp6Sock;
     }
-
-    rc = select(maxFd + 1, &fds, NULL, NULL, &tv);
-    if (rc == 0) {
-        AJ_InfoPrintf(("AJ_Net_RecvFrom(): select() timed out. status=AJ_ERR_TIMEOUT\n"));
-        return AJ_ERR_TIMEOUT;
+    if (context->udpSock != INVALID_SOCKET) {
+        fds[numFds++] = context->udpSock;
     }
 
-    // we need to read from the first socket that has data available.
-
-    rx = AJ_IO_BUF_SPACE(buf);
-    if (context->mDnsRecvSock != INVALID_SOCKET && FD_ISSET(context->mDnsRecvSock, &fds)) {
-        rx = min(rx, len);
-        if (rx) {
-            ret = recvfrom(context->mDnsRecvSock, buf->writePtr, rx, 0, NULL, 0);
-            if (ret == -1) {
-                AJ_ErrPrintf(("AJ_Net_RecvFrom(): mDnsRecvSock recvfrom() failed. errno=\"%s\"\n", strerror(errno)));
-                status = AJ_ERR_READ;
-            } else {
-                AJ_InfoPrintf(("AJ_Net_RecvFrom(): recv'd %d from mDNS over IPv4\n", (int) ret));
-                buf->flags |= AJ_IO_BUF_MDNS;
-                buf->writePtr += ret;
-                status = AJ_OK;
-                goto Finished;
-            }
+    rx = min(AJ_IO_BUF_SPACE(buf), len);
+    while (TRUE) {
+        // we need to read from the first socket that has data available.
+        status = WaitForReady(fds, numFds, timeout, &fd);
+        if (status == AJ_ERR_TIMEOUT) {
+            AJ_InfoPrintf(("AJ_Net_RecvFrom(): timed out. status=AJ_ERR_TIMEOUT\n"));
+            return AJ_ERR_TIMEOUT;
         }
-    }
-
-    rx = AJ_IO_BUF_SPACE(buf);
-    if (context->mDns6RecvSock != INVALID_SOCKET && FD_ISSET(context->mDns6RecvSock, &fds)) {
-        rx = min(rx, len);
-        if (rx) {
-            addrlen = sizeof(sa);
-            ret = recvfrom(context->mDns6RecvSock, buf->writePtr, rx, 0, (struct sockaddr*)&sa, &addrlen);
-            if (ret == -1) {
-                AJ_ErrPrintf(("AJ_Net_RecvFrom(): mDns6RecvSock recvfrom() failed. errno=\"%s\"\n", strerror(errno)));
-                status = AJ_ERR_READ;
-            } else {
-                AJ_InfoPrintf(("AJ_Net_RecvFrom(): recv'd %d from mDNS over IPv6\n", (int) ret));
-                if (sa.ss_family == AF_INET6) {
-                    struct sockaddr_in6* sin6 = (struct sockaddr_in6*)&sa;
-                    buf->scope_id = sin6->sin6_scope_id;
-                }
-                buf->flags |= AJ_IO_BUF_MDNS;
-                buf->writePtr += ret;
-                status = AJ_OK;
-                goto Finished;
-            }
+        if ((status != AJ_OK) || !rx) {
+            break;
         }
-    }
-
-    rx = AJ_IO_BUF_SPACE(buf);
-    if (context->udp6Sock != INVALID_SOCKET && FD_ISSET(context->udp6Sock, &fds)) {
-        rx = min(rx, len);
-        if (rx) {
-            addrlen = sizeof(sa);
-            ret = recvfrom(context->udp6Sock, buf->writePtr, rx, 0, (struct sockaddr*)&sa, &addrlen);
-            if (ret == -1) {
-                AJ_ErrPrintf(("AJ_Net_RecvFrom(): recvfrom() failed. errno=\"%s\"\n", strerror(errno)));
-                status = AJ_ERR_READ;
-            } else {
-                AJ_InfoPrintf(("AJ_Net_RecvFrom(): recv'd %d from udp6\n", (int) ret));
-                if (sa.ss_family == AF_INET6) {
-                    struct sockaddr_in6* sin6 = (struct sockaddr_in6*)&sa;
-                    buf->scope_id = sin6->sin6_scope_id;
-                }
-                buf->flags |= AJ_IO_BUF_AJ;
-                buf->writePtr += ret;
-                status = AJ_OK;
-                goto Finished;
-            }
+        addrlen = sizeof(sa);
+        ret = recvfrom(fd, buf->writePtr, rx, MSG_DONTWAIT, (struct sockaddr*)&sa, &addrlen);
+        if ((ret == -1) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+            /*
+             * Drained the socket, wait for the next edge
+             */
+            NotReady(fd);
+            continue;
         }
-    }
-
-    rx = AJ_IO_BUF_SPACE(buf);
-    if (context->udpSock != INVALID_SOCKET && FD_ISSET(context->udpSock, &fds)) {
-        rx = min(rx, len);
-        if (rx) {
-            ret = recvfrom(context->udpSock, buf->writePtr, rx, 0, NULL, 0);
-            if (ret == -1) {
-                AJ_ErrPrintf(("AJ_Net_RecvFrom(): recvfrom() failed. errno=\"%s\"\n", strerror(errno)));
-                status = AJ_ERR_READ;
-            } else {
-                AJ_InfoPrintf(("AJ_Net_RecvFrom(): recv'd %d from udp\n", (int) ret));
-                buf->flags |= AJ_IO_BUF_AJ;
-                buf->writePtr += ret;
-                status = AJ_OK;
-                goto Finished;
-            }
+        if (ret == -1) {
+            AJ_ErrPrintf(("AJ_Net_RecvFrom(): recvfrom() failed. errno=\"%s\"\n", strerror(errno)));
+            status = AJ_ERR_READ;
+            break;
+        }
+        if (fd == context->mDnsRecvSock) {
+            AJ_InfoPrintf(("AJ_Net_RecvFrom(): recv'd %d from mDNS over IPv4\n", (int) ret));
+            buf->flags |= AJ_IO_BUF_MDNS;
+        } else if (fd == context->mDns6RecvSock) {
+            AJ_InfoPrintf(("AJ_Net_RecvFrom(): recv'd %d from mDNS over IPv6\n", (int) ret));
+            buf->flags |= AJ_IO_BUF_MDNS;
+        } else if (fd == context->udp6Sock) {
+            AJ_InfoPrintf(("AJ_Net_RecvFrom(): recv'd %d from udp6\n", (int) ret));
+            buf->flags |= AJ_IO_BUF_AJ;
+        } else {
+            AJ_InfoPrintf(("AJ_Net_RecvFrom(): recv'd %d from udp\n", (int) ret));
+            buf->flags |= AJ_IO_BUF_AJ;
         }
+        if ((fd != context->mDnsRecvSock) && (sa.ss_family == AF_INET6)) {
+            struct sockaddr_in6* sin6 = (struct sockaddr_in6*)&sa;
+            buf->scope_id = sin6->sin6_scope_id;
+        }
+        buf->writePtr += ret;
+        break;
     }
-
-Finished:
     if (status != AJ_OK) {
         AJ_InfoPrintf(("AJ_Net_RecvFrom(): status=%s\n", AJ_StatusText(status)));
     }
@@ -801,8 +1214,8 @@ Finished:
  * max(NS WHO-HAS for one name (4 + 2 + 256 = 262),
  *     mDNS query for one name (194 + 5 + 5 + 15 + 256 = 475)) = 475
  */
-static uint8_t rxDataMCast[1454];
-static uint8_t txDataMCast[475];
+static AJ_THREAD_LOCAL uint8_t rxDataMCast[1454];
+static AJ_THREAD_LOCAL uint8_t txDataMCast[475];
 
 static int MCastUp4(const char group[], uint16_t port)
 {
@@ -1145,6 +1558,13 @@ AJ_Status AJ_Net_MCastUp(AJ_MCastSocket* mcastSock)
         mcastSock->rx.recv = AJ_Net_RecvFrom;
         AJ_IOBufInit(&mcastSock->tx, txDataMCast, sizeof(txDataMCast), AJ_IO_BUF_TX, &mCastContext);
         mcastSock->tx.send = AJ_Net_SendTo;
+        /*
+         * Failing to add a socket to the event loop just means it will never be read
+         */
+        AddEventFd(mCastContext.mDnsRecvSock, NULL, NULL);
+        AddEventFd(mCastContext.mDns6RecvSock, NULL, NULL);
+        AddEventFd(mCastContext.udpSock, NULL, NULL);
+        AddEventFd(mCastContext.udp6Sock, NULL, NULL);
         return AJ_OK;
     }
 
@@ -1210,58 +1630,43 @@ static AJ_Status AJ_ARDP_UDP_Send(void* context, uint8_t* buf, size_t len, size_
 
 static AJ_Status AJ_ARDP_UDP_Recv(void* context, uint8_t** data, uint32_t* recved, uint32_t timeout)
 {
-    fd_set fds;
-    struct timeval tv = { timeout / 1000, 1000 * (timeout % 1000) };
+    AJ_Status status;
     int ret;
+    int fd;
     NetContext* ctx = (NetContext*) context;
-    int maxFd = max(ctx->udpSock, interruptFd);
 
     /**
      * Let the platform code own this buffer.  This makes it easier to avoid double-buffering
      * on platforms that allow it.
      */
-    static uint8_t buffer[UDP_SEGBMAX];
+    static AJ_THREAD_LOCAL uint8_t buffer[UDP_SEGBMAX];
 
     *data = NULL;
 
     AJ_InfoPrintf(("AJ_ARDP_UDP_Recv(data=0x%p, recved=0x%p, timeout=%u)\n", data, recved, timeout));
 
-    FD_ZERO(&fds);
-    FD_SET(ctx->udpSock, &fds);
-    if (interruptFd > 0) {
-        FD_SET(interruptFd, &fds);
-    }
-
-    blocked = TRUE;
-    ret = select(maxFd + 1, &fds, NULL, NULL, &tv);
-    blocked = FALSE;
-
-    if (ret == 0) {
-        // timeout!
-        return AJ_ERR_TIMEOUT;
-    } else if (ret == -1) {
-        perror("select");
-        return AJ_ERR_READ;
-    } else if ((interruptFd > 0) && FD_ISSET(interruptFd, &fds)) {
-        uint64_t u64;
-        if (read(interruptFd, &u64, sizeof(u64)) < 0) {
-            AJ_ErrPrintf(("AJ_ARDP_UDP_Recv(): read() failed during interrupt. errno=\"%s\"\n", strerror(errno)));
+    while (TRUE) {
+        status = WaitForReady(&ctx->udpSock, 1, timeout, &fd);
+        if (status != AJ_OK) {
+            return status;
+        }
+        ret = recvfrom(ctx->udpSock, buffer, sizeof(buffer), MSG_DONTWAIT, NULL, 0);
+        if ((ret == -1) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+            /*
+             * Drained the socket, wait for the next edge
+             */
+            NotReady(ctx->udpSock);
+            continue;
         }
-        return AJ_ERR_INTERRUPTED;
-    } else if (FD_ISSET(ctx->udpSock, &fds)) {
-        ret = recvfrom(ctx->udpSock, buffer, sizeof(buffer), 0, NULL, 0);
-
         if (ret == -1) {
             // this will only happen if we are on a local machine
             perror("recvfrom");
             return AJ_ERR_READ;
         }
-
         *recved = ret;
         *data = buffer;
+        return AJ_OK;
     }
-
-    return AJ_OK;
 }
 
 static int AJ_Net_ARDP_PrepareConnectIPv4(const AJ_Service* service, struct sockaddr_storage* destAddr)
@@ -1317,23 +1722,31 @@ static AJ_Status AJ_Net_ARDP_DoConnect(AJ_BusAttachment* bus, const AJ_Service*
     // Therefore, we don't have to make the address a global variable and can
     // simply use send() rather than sendto().  See: man 7 udp
     int ret = connect(udpSock, (struct sockaddr*)destAddr, destAddrSize);
+    NetContext* context;
 
-    // must do this before calling AJ_MarshalMethodCall!
-    if (ret == 0) {
-        netContext.udpSock = udpSock;
-        AJ_IOBufInit(&bus->sock.rx, rxData, sizeof(rxData), AJ_IO_BUF_RX, &netContext);
-        bus->sock.rx.recv = AJ_ARDP_Recv;
-        AJ_IOBufInit(&bus->sock.tx, txData, sizeof(txData), AJ_IO_BUF_TX, &netContext);
-        bus->sock.tx.send = AJ_ARDP_Send;
-    } else {
+    if (ret != 0) {
         AJ_ErrPrintf(("%s(): Error connecting\n", __FUNCTION__));
         perror("connect");
         return AJ_ERR_CONNECT;
     }
+    // must do this before calling AJ_MarshalMethodCall!
+    context = InitNetSock(bus, AJ_ARDP_Recv, AJ_ARDP_Send);
+    if (!context) {
+        AJ_ErrPrintf(("%s(): Failed to allocate connection\n", __FUNCTION__));
+        return AJ_ERR_CONNECT;
+    }
+    if (AddEventFd(udpSock, NULL, NULL) != AJ_OK) {
+        AJ_ErrPrintf(("%s(): Failed to add socket to event loop\n", __FUNCTION__));
+        FreeNetContext(context);
+        memset(&bus->sock, 0, sizeof(AJ_NetSocket));
+        return AJ_ERR_CONNECT;
+    }
+    context->udpSock = udpSock;
 
-    if (AJ_ARDP_UDP_Connect(bus, &netContext, service, &bus->sock) != AJ_OK) {
+    if (AJ_ARDP_UDP_Connect(bus, context, service, &bus->sock) != AJ_OK) {
         AJ_ErrPrintf(("%s(): ARDP_Connect failed\n", __FUNCTION__));
         AJ_Net_ARDP_Disconnect(&bus->sock);
+        FreeNetContext(context);
         return AJ_ERR_CONNECT;
     }
 
@@ -1349,8 +1762,7 @@ static AJ_Status AJ_Net_ARDP_Connect(AJ_BusAttachment* bus, const AJ_Service* se
 
     memset(&destAddr, 0, sizeof(destAddr));
 
-    interruptFd = eventfd(0, O_NONBLOCK);  // Use O_NONBLOCK instead of EFD_NONBLOCK due to bug in OpenWrt's uCLibc
-    if (interruptFd < 0) {
+    if (OpenInterruptFd() < 0) {
         AJ_ErrPrintf(("%s(): failed to create interrupt event\n", __FUNCTION__));
         goto ConnectError;
     }
@@ -1379,20 +1791,20 @@ static AJ_Status AJ_Net_ARDP_Connect(AJ_BusAttachment* bus, const AJ_Service* se
 
 ConnectError:
     AJ_ErrPrintf(("%s(): failed to connect\n", __FUNCTION__));
-    if (interruptFd != INVALID_SOCKET) {
-        close(interruptFd);
-        interruptFd = INVALID_SOCKET;
-    }
+    CloseInterruptFd();
 
     return AJ_ERR_CONNECT;
 }
 
 static void AJ_Net_ARDP_Disconnect(AJ_NetSocket* netSock)
 {
+    NetContext* context = (NetContext*)netSock->rx.context;
+
     AJ_ARDP_Disconnect(FALSE);
 
-    close(netContext.udpSock);
-    netContext.udpSock = INVALID_SOCKET;
+    RemoveEventFd(context->udpSock);
+    close(context->udpSock);
+    context->udpSock = INVALID_SOCKET;
     memset(netSock, 0, sizeof(AJ_NetSocket));
 }
 
@@ -82,6 +82,7 @@ void AJ_Printf(const char* fmat, ...);
 
 #ifdef AJ_DEBUG_BUILD
 extern uint8_t dbgCONFIGUREME;
+extern uint8_t dbgGATEWAY;
 extern uint8_t dbgINIT;
 extern uint8_t dbgNET;
 extern uint8_t dbgTARGET_CRYPTO;
@@ -94,6 +95,11 @@ extern uint8_t dbgTARGET_UTIL;
 
 #define AJ_ASSERT(x) assert(x)
 
+/*
+ * Serial I/O is completed from the SLAP state machine rather than from interrupts
+ */
+#define AJ_SERIO_POLL
+
 #define AJ_UNUSED(x) ((void)(x))
 
 /*
@@ -110,6 +116,41 @@ extern uint8_t dbgTARGET_UTIL;
  */
 #define MAIN_ALLOWS_ARGS
 
+/*
+ * Network I/O is driven by an event loop that application file descriptors can be added to
+ */
+#define AJ_NET_EVENT_LOOP
+
+/*
+ * Routing nodes can be probed in parallel before one is selected
+ */
+#define AJ_NET_PROBE
+
+/*
+ * Gateway builds (scons GATEWAY=yes) run bus attachments on their own threads with AJ_GatewayRun().
+ * The current bus state and the network event loop are then per-thread so a bus attachment must be
+ * used on the thread it connected on. Other builds keep a single process-wide event loop.
+ */
+#ifdef AJ_GATEWAY
+#define AJ_THREAD_LOCAL __thread
+#endif
+
+/*
+ * NVRAM and the random number generator are serialized by a process-wide lock
+ */
+#define AJ_SHARED_LOCK() AJ_SharedLock()
+#define AJ_SHARED_UNLOCK() AJ_SharedUnlock()
+
+/**
+ * Acquire the process-wide lock, the lock is recursive
+ */
+void AJ_SharedLock(void);
+
+/**
+ * Release the process-wide lock
+ */
+void AJ_SharedUnlock(void);
+
 #define AJ_GetDebugTime(x) _AJ_GetDebugTime(x)
 
 #define GCC_VERSION ((__GNUC__ * 10000) + (__GNUC_MINOR__ * 100) + __GNUC_PATCHLEVEL__)
@@ -41,6 +41,7 @@
 #include <ajtcl/aj_crypto_aes_priv.h>
 #include <ajtcl/aj_crypto_drbg.h>
 #include <ajtcl/aj_debug.h>
+#include <ajtcl/aj_config.h>
 
 /**
  * Turn on per-module debug printing by setting this variable to non-zero value
@@ -51,7 +52,7 @@ uint8_t dbgTARGET_CRYPTO = 0;
 #endif
 
 /*
- * Context for AES-128 CTR DRBG
+ * Context for AES-128 CTR DRBG, shared by all threads
  */
 static CTR_DRBG_CTX drbgctx;
 
@@ -71,6 +72,7 @@ void AJ_RandBytes(uint8_t* randBuf, uint32_t size)
     AJ_Status status = AJ_ERR_SECURITY;
     uint8_t seed[SEEDLEN];
 
+    AJ_SHARED_LOCK();
     if ((NULL != randBuf) && (size > 0)) {
         status = AES_CTR_DRBG_Generate(&drbgctx, randBuf, size);
         if (AJ_OK != status) {
@@ -80,11 +82,9 @@ void AJ_RandBytes(uint8_t* randBuf, uint32_t size)
                 status = AES_CTR_DRBG_Generate(&drbgctx, randBuf, size);
                 if (AJ_OK != status) {
                     AJ_ErrPrintf(("AJ_RandBytes(): AES_CTR_DRBG_Generate second attempt failed, status: 0x%x\n", status));
-                    return;
                 }
             } else {
                 AJ_ErrPrintf(("AJ_RandBytes(): AES_CTR_DRBG_Generate status: 0x%x, AJ_PlatformEntropy failed during reseed.\n", status));
-                return;
             }
         }
     } else {
@@ -93,4 +93,5 @@ void AJ_RandBytes(uint8_t* randBuf, uint32_t size)
         drbgctx.df = (SEEDLEN == size) ? 0 : 1;
         AES_CTR_DRBG_Instantiate(&drbgctx, seed, sizeof (seed), drbgctx.df);
     }
+    AJ_SHARED_UNLOCK();
 }
@@ -30,6 +30,7 @@
  *    PERFORMANCE OF THIS SOFTWARE.
  ******************************************************************************/
 
+
 /**
  * Per-module definition of the current module for debug logging.  Must be defined
  * prior to first inclusion of aj_debug.h
@@ -48,53 +49,282 @@
 uint8_t dbgTARGET_SERIAL = 0;
 #endif
 
+#ifdef AJ_SERIAL_CONNECTION
+
+#include <ajtcl/aj_serio.h>
+#include <ajtcl/aj_serial.h>
+#include <ajtcl/aj_util.h>
 #include <sys/types.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
 
-/**
- * This function initialized the UART piece of the transport.
+/*
+ * Defaults for AJ_Serial_Up(), the device can be overridden at runtime with the
+ * AJ_SERIAL_TTY environment variable
+ */
+#if !defined(AJ_SERIAL_TTY)
+#define AJ_SERIAL_TTY          "/dev/ttyUSB0"
+#endif
+#if !defined(AJ_SERIAL_BITRATE)
+#define AJ_SERIAL_BITRATE      115200
+#endif
+#if !defined(AJ_SERIAL_WINDOW_SIZE)
+#define AJ_SERIAL_WINDOW_SIZE  4
+#endif
+#if !defined(AJ_SERIAL_PACKET_SIZE)
+#define AJ_SERIAL_PACKET_SIZE  1000
+#endif
+
+typedef struct {
+    uint32_t bitRate;
+    speed_t speed;
+} BitRate;
+
+static const BitRate bitRates[] = {
+    { 9600, B9600 },
+    { 19200, B19200 },
+    { 38400, B38400 },
+    { 57600, B57600 },
+    { 115200, B115200 },
+    { 230400, B230400 },
+    { 460800, B460800 },
+    { 500000, B500000 },
+    { 921600, B921600 },
+    { 1000000, B1000000 },
+    { 1500000, B1500000 },
+    { 2000000, B2000000 },
+    { 3000000, B3000000 }
+};
+
+static int ttyFd = -1;
+
+static AJ_SerIORxCompleteFunc rxCB;
+static AJ_SerIOTxCompleteFunc txCB;
+static AJ_SerialTxFunc txFunc;
+
+static uint8_t rxEnabled;
+static uint8_t txEnabled;
+
+/*
+ * Buffers posted by the SLAP layer with AJ_RX() and AJ_TX(), at most one in each direction
  */
-AJ_Status AJ_SerialTargetInit(const char* ttyName)
+static uint8_t* rxBuf;
+static uint32_t rxLen;
+static uint8_t* txBuf;
+static uint32_t txLen;
+static uint32_t txOffset;
+
+AJ_Status AJ_SerialTargetInit(const char* ttyName, uint32_t bitRate)
 {
-    AJ_ErrPrintf(("AJ_SerialTargetInit(): Serial undefined on this target\n"));
-    assert(0);
-    return AJ_ERR_UNEXPECTED;
+    struct termios tio;
+    size_t i;
+
+    AJ_InfoPrintf(("AJ_SerialTargetInit(ttyName=\"%s\", bitRate=%u)\n", ttyName, bitRate));
+
+    for (i = 0; i < ArraySize(bitRates); ++i) {
+        if (bitRates[i].bitRate == bitRate) {
+            break;
+        }
+    }
+    if (i == ArraySize(bitRates)) {
+        AJ_ErrPrintf(("AJ_SerialTargetInit(): Unsupported bit rate %u\n", bitRate));
+        return AJ_ERR_DRIVER;
+    }
+    if (ttyFd >= 0) {
+        close(ttyFd);
+    }
+    ttyFd = open(ttyName, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (ttyFd < 0) {
+        AJ_ErrPrintf(("AJ_SerialTargetInit(): open %s failed errno=\"%s\"\n", ttyName, strerror(errno)));
+        return AJ_ERR_DRIVER;
+    }
+    /*
+     * Raw 8N1 with no flow control, reads return whatever has arrived
+     */
+    if (tcgetattr(ttyFd, &tio) < 0) {
+        goto ExitFail;
+    }
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cflag &= ~(CSTOPB | CRTSCTS);
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    if ((cfsetispeed(&tio, bitRates[i].speed) < 0) || (cfsetospeed(&tio, bitRates[i].speed) < 0)) {
+        goto ExitFail;
+    }
+    if (tcsetattr(ttyFd, TCSANOW, &tio) < 0) {
+        goto ExitFail;
+    }
+    tcflush(ttyFd, TCIOFLUSH);
+
+    rxBuf = NULL;
+    txBuf = NULL;
+    rxEnabled = TRUE;
+    txEnabled = TRUE;
+    return AJ_OK;
+
+ExitFail:
+    AJ_ErrPrintf(("AJ_SerialTargetInit(): configuring %s failed errno=\"%s\"\n", ttyName, strerror(errno)));
+    close(ttyFd);
+    ttyFd = -1;
+    return AJ_ERR_DRIVER;
 }
 
+AJ_Status AJ_Serial_Up()
+{
+    const char* ttyName = getenv("AJ_SERIAL_TTY");
 
+    if (!ttyName) {
+        ttyName = AJ_SERIAL_TTY;
+    }
+    return AJ_SerialInit(ttyName, AJ_SERIAL_BITRATE, AJ_SERIAL_WINDOW_SIZE, AJ_SERIAL_PACKET_SIZE);
+}
 
-AJ_Status AJ_UART_Tx(uint8_t* buffer, uint16_t len)
+AJ_Status AJ_SerialIOInit(AJ_SerIOConfig* config)
 {
-    AJ_ErrPrintf(("AJ_UART_Tx(): Serial undefined on this target\n"));
-    assert(0);
-    return AJ_ERR_UNEXPECTED;
+    if (!config) {
+        return AJ_SerialTargetInit(AJ_SERIAL_TTY, AJ_SERIAL_BITRATE);
+    }
+    if ((config->bits != 8) || (config->stopBits != 1) || config->parity) {
+        return AJ_ERR_UNEXPECTED;
+    }
+    /*
+     * The platform specific configuration is the device name
+     */
+    return AJ_SerialTargetInit(config->config ? (const char*)config->config : AJ_SERIAL_TTY, config->bitrate);
 }
 
+AJ_Status AJ_SerialIOEnable(uint32_t direction, uint8_t enable)
+{
+    if (direction == AJ_SERIO_RX) {
+        rxEnabled = enable;
+    } else if (direction == AJ_SERIO_TX) {
+        txEnabled = enable;
+    } else {
+        return AJ_ERR_UNEXPECTED;
+    }
+    return AJ_OK;
+}
 
+AJ_Status AJ_SerialIOShutdown(void)
+{
+    rxEnabled = FALSE;
+    txEnabled = FALSE;
+    rxBuf = NULL;
+    txBuf = NULL;
+    if (ttyFd >= 0) {
+        close(ttyFd);
+        ttyFd = -1;
+    }
+    return AJ_OK;
+}
+
+void AJ_SetRxCB(AJ_SerIORxCompleteFunc rx_cb)
+{
+    rxCB = rx_cb;
+}
+
+void AJ_SetTxCB(AJ_SerIOTxCompleteFunc tx_cb)
+{
+    txCB = tx_cb;
+}
 
-void OI_HCIIfc_DeviceHasBeenReset(void)
+void AJ_SetTxSerialTransmit(AJ_SerialTxFunc tx_func)
 {
-    AJ_ErrPrintf(("OI_HCIIfc_DeviceHasBeenReset(): Serial undefined on this target\n"));
-    assert(0);
+    txFunc = tx_func;
 }
 
+void AJ_RX(uint8_t* buf, uint32_t len)
+{
+    rxBuf = buf;
+    rxLen = len;
+}
 
-const char* OI_HciDataTypeText(uint8_t hciDataType)
+void AJ_TX(uint8_t* buf, uint32_t len)
 {
-    AJ_ErrPrintf(("OI_HciDataTypeText(): Serial undefined on this target\n"));
-    assert(0);
-    return("ERROR: Serial undefined on this target \n");
+    if (txFunc) {
+        txFunc(buf, len);
+    }
 }
 
-void WaitForAck(void)
+void __AJ_TX(uint8_t* buf, uint32_t len)
 {
-    AJ_ErrPrintf(("WaitForAck(): Serial undefined on this target\n"));
-    assert(0);
+    txBuf = buf;
+    txLen = len;
+    txOffset = 0;
 }
 
-void OI_HCIIfc_SendCompleted(uint8_t sendType,
-                             AJ_Status status)
+/*
+ * Completion callbacks are only ever made from AJ_SerialIOPoll() on the thread running the
+ * state machine so there is nothing to pause.
+ */
+void AJ_PauseRX()
 {
-    AJ_ErrPrintf(("OI_HCIIfc_SendCompleted(): Serial undefined on this target\n"));
-    assert(0);
 }
 
+void AJ_ResumeRX()
+{
+}
+
+void AJ_PauseTX()
+{
+}
+
+void AJ_ResumeTX()
+{
+}
+
+void AJ_SerialIOPoll(uint32_t timeout)
+{
+    struct pollfd pfd;
+    ssize_t ret;
+
+    if (ttyFd < 0) {
+        return;
+    }
+    pfd.fd = ttyFd;
+    pfd.events = 0;
+    pfd.revents = 0;
+    if (rxBuf && rxEnabled) {
+        pfd.events |= POLLIN;
+    }
+    if (txBuf && txEnabled) {
+        pfd.events |= POLLOUT;
+    }
+    if (poll(&pfd, 1, (int)timeout) <= 0) {
+        return;
+    }
+    /*
+     * The callbacks post the next buffer, keep going until the UART stops accepting or
+     * delivering bytes.
+     */
+    while ((pfd.revents & POLLOUT) && txBuf) {
+        uint8_t* buf = txBuf;
+        ret = write(ttyFd, txBuf + txOffset, txLen - txOffset);
+        if (ret <= 0) {
+            break;
+        }
+        txOffset += (uint32_t)ret;
+        if (txOffset < txLen) {
+            break;
+        }
+        txBuf = NULL;
+        if (txCB) {
+            txCB(buf, (uint16_t)txLen);
+        }
+    }
+    while ((pfd.revents & POLLIN) && rxBuf) {
+        uint8_t* buf = rxBuf;
+        ret = read(ttyFd, rxBuf, rxLen);
+        if (ret <= 0) {
+            break;
+        }
+        rxBuf = NULL;
+        if (rxCB) {
+            rxCB(buf, (uint16_t)ret);
+        }
+    }
+}
+
+#endif /* AJ_SERIAL_CONNECTION */
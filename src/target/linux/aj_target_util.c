@@ -157,22 +157,74 @@ uint64_t AJ_DecodeTime(char* der, const char* fmt)
     return (uint64_t) timegm(&tm);
 }
 
+#ifdef AJ_DEBUG_BUILD
+/*
+ * If the environment variable AJ_MALLOC_TRACE names a file every heap operation is written to it,
+ * one per line, as "a <ptr> <size>", "r <old ptr> <new ptr> <size>" or "f <ptr>". The heapreplay
+ * test program turns a trace into a pool configuration for targets that use the pool allocator.
+ */
+static FILE* mallocTrace;
+static pthread_once_t mallocTraceOnce = PTHREAD_ONCE_INIT;
+
+static void MallocTraceOpen(void)
+{
+    char* env = getenv("AJ_MALLOC_TRACE");
+
+    if (env) {
+        mallocTrace = fopen(env, "w");
+    }
+}
+
+#define MALLOC_TRACE(fmt, ...) \
+    do { \
+        pthread_once(&mallocTraceOnce, MallocTraceOpen); \
+        if (mallocTrace) { \
+            fprintf(mallocTrace, fmt, __VA_ARGS__); \
+        } \
+    } while (0)
+#else
+#define MALLOC_TRACE(fmt, ...)
+#endif
+
 void* AJ_Malloc(size_t sz)
 {
-    return malloc(sz);
+    void* mem = malloc(sz);
+    MALLOC_TRACE("a %p %u\n", mem, (unsigned)sz);
+    return mem;
 }
 void* AJ_Realloc(void* ptr, size_t size)
 {
-    return realloc(ptr, size);
+#ifdef AJ_DEBUG_BUILD
+    unsigned long old = (unsigned long)ptr;
+#endif
+    void* mem = realloc(ptr, size);
+    MALLOC_TRACE("r 0x%lx %p %u\n", old, mem, (unsigned)size);
+    return mem;
 }
 
 void AJ_Free(void* mem)
 {
     if (mem) {
+        MALLOC_TRACE("f %p\n", mem);
         free(mem);
     }
 }
 
+/*
+ * Serializes access to process-wide state from bus attachments running on different threads
+ */
+static pthread_mutex_t sharedLock = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+
+void AJ_SharedLock(void)
+{
+    pthread_mutex_lock(&sharedLock);
+}
+
+void AJ_SharedUnlock(void)
+{
+    pthread_mutex_unlock(&sharedLock);
+}
+
 void AJ_MemZeroSecure(void* s, size_t n)
 {
     volatile unsigned char* p = s;
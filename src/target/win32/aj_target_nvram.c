@@ -39,6 +39,16 @@
 #include <ajtcl/aj_nvram.h>
 #include <ajtcl/aj_debug.h>
 #include "../../aj_target_nvram.h"
+#if AJ_NVRAM_JOURNAL
+#if defined(_WIN32)
+#error "AJ_NVRAM_JOURNAL requires mmap and is only supported on POSIX targets"
+#endif
+#include <ajtcl/aj_crc16.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#endif
 
 /**
  * Turn on per-module debug printing by setting this variable to non-zero value
@@ -57,20 +67,224 @@ typedef struct _nvEmulatedNvram {
     uint8_t* blockStart;
     uint32_t blockSize;
     uint8_t isCompact;
+#if AJ_NVRAM_JOURNAL
+    uint8_t* mapping;      /* The mapped block file, NULL if the block lives in emulatedBlock */
+    int journal;           /* Write-ahead journal for the mapped block file */
+    uint32_t journalSize;  /* Bytes appended to the journal since the mapping was last synced */
+#endif
 } nvEmulatedNvramBlock;
 
 /*
  * Pointer initialized inside AJ_NVRAM_Init() or AJ_NVRAM_Init_NewLayout()
  */
 static nvEmulatedNvramBlock* nvStorages = NULL;
+static uint8_t nvStorageCount = 0;
+
+#if AJ_NVRAM_JOURNAL
+/*
+ * With the journal enabled each block file is mapped into memory and the NVRAM code reads directly
+ * from the mapping. Rather than rewriting the whole file, every change is appended to a small
+ * write-ahead journal (the block file name with a ".journal" suffix) as a record holding the new
+ * contents of the bytes that change. The record is flushed with fdatasync() before the mapping is
+ * touched, so the block file never holds a change the journal does not. The mapping is synced to
+ * the block file, and only then is the journal truncated and flushed, once the journal grows past
+ * AJ_NVRAM_JOURNAL_SIZE bytes. Records still in the journal when the block file is mapped again are
+ * replayed so a change that had not reached the block file, or reached it only partially, is
+ * recovered. A torn record, or one with a bad CRC, ends the replay; the change it held was never
+ * applied to the mapping.
+ */
+#define JOURNAL_MAGIC 0x4A4E
+
+typedef struct _JournalRecord {
+    uint32_t offset;   /* Offset of the changed bytes in the block */
+    uint32_t len;      /* Number of changed bytes following the record */
+    uint16_t magic;    /* JOURNAL_MAGIC */
+    uint16_t crc;      /* CRC16 over the offset, the length and the changed bytes */
+} JournalRecord;
+
+#define BlockStart(idx) (nvStorages[idx].mapping ? nvStorages[idx].mapping : nvStorages[idx].blockStart)
+
+static uint16_t JournalCRC(const JournalRecord* rec, const uint8_t* data)
+{
+    uint16_t crc = 0xFFFF;
+    uint32_t len = rec->len;
+
+    AJ_CRC16_Compute((const uint8_t*)rec, 8, &crc);
+    while (len) {
+        uint16_t chunk = (uint16_t)min(len, 0x8000);
+        AJ_CRC16_Compute(data, chunk, &crc);
+        data += chunk;
+        len -= chunk;
+    }
+    return crc;
+}
+
+/*
+ * Writes the mapping back to the block file and restarts the journal
+ */
+static AJ_Status SyncNVFile(uint8_t idx)
+{
+    nvEmulatedNvramBlock* nv = &nvStorages[idx];
+
+    if (msync(nv->mapping, nv->blockSize, MS_SYNC) != 0) {
+        AJ_ErrPrintf(("SyncNVFile(): msync(\"%s\") failed errno=%d\n", nv->nvFile, errno));
+        return AJ_ERR_FAILURE;
+    }
+    if ((ftruncate(nv->journal, 0) != 0) || (fsync(nv->journal) != 0)) {
+        AJ_ErrPrintf(("SyncNVFile(): truncating the journal of \"%s\" failed errno=%d\n", nv->nvFile, errno));
+        return AJ_ERR_FAILURE;
+    }
+    nv->journalSize = 0;
+    return AJ_OK;
+}
+
+/*
+ * Journals the new contents of a range of a mapped block and then applies them to the mapping
+ */
+static AJ_Status JournalNV(uint8_t idx, uint8_t* dest, const uint8_t* src, uint32_t len)
+{
+    nvEmulatedNvramBlock* nv = &nvStorages[idx];
+    JournalRecord rec;
+    struct iovec iov[2];
+
+    rec.offset = (uint32_t)(dest - nv->mapping);
+    rec.len = len;
+    rec.magic = JOURNAL_MAGIC;
+    rec.crc = JournalCRC(&rec, src);
+    iov[0].iov_base = &rec;
+    iov[0].iov_len = sizeof(rec);
+    iov[1].iov_base = (void*)src;
+    iov[1].iov_len = len;
+    if ((writev(nv->journal, iov, 2) != (ssize_t)(sizeof(rec) + len)) || (fdatasync(nv->journal) != 0)) {
+        /*
+         * The change cannot be journaled so write it straight through to the block file
+         */
+        AJ_WarnPrintf(("JournalNV(): journal write for \"%s\" failed errno=%d\n", nv->nvFile, errno));
+        memmove(dest, src, len);
+        return SyncNVFile(idx);
+    }
+    memmove(dest, src, len);
+    nv->journalSize += sizeof(rec) + len;
+    if (nv->journalSize >= AJ_NVRAM_JOURNAL_SIZE) {
+        return SyncNVFile(idx);
+    }
+    return AJ_OK;
+}
+
+static void ReplayJournal(uint8_t idx)
+{
+    nvEmulatedNvramBlock* nv = &nvStorages[idx];
+    JournalRecord rec;
+    uint32_t records = 0;
+
+    lseek(nv->journal, 0, SEEK_SET);
+    while (read(nv->journal, &rec, sizeof(rec)) == sizeof(rec)) {
+        uint8_t* data;
+
+        if ((rec.magic != JOURNAL_MAGIC) || (rec.offset > nv->blockSize) || (rec.len > (nv->blockSize - rec.offset))) {
+            break;
+        }
+        data = (uint8_t*)AJ_Malloc(rec.len);
+        if (!data) {
+            break;
+        }
+        if ((read(nv->journal, data, rec.len) != (ssize_t)rec.len) || (JournalCRC(&rec, data) != rec.crc)) {
+            AJ_Free(data);
+            break;
+        }
+        memcpy(nv->mapping + rec.offset, data, rec.len);
+        AJ_Free(data);
+        ++records;
+    }
+    if (records) {
+        AJ_InfoPrintf(("ReplayJournal(): replayed %u records into \"%s\"\n", records, nv->nvFile));
+    }
+    SyncNVFile(idx);
+}
+
+static AJ_Status MapNVFile(uint8_t idx)
+{
+    nvEmulatedNvramBlock* nv = &nvStorages[idx];
+    char name[128];
+    struct stat st;
+    uint8_t* mapping;
+    int fd;
+
+    fd = open(nv->nvFile, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return AJ_ERR_FAILURE;
+    }
+    if ((fstat(fd, &st) != 0) || ((st.st_size < nv->blockSize) && (ftruncate(fd, nv->blockSize) != 0))) {
+        close(fd);
+        return AJ_ERR_FAILURE;
+    }
+    mapping = (uint8_t*)mmap(NULL, nv->blockSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return AJ_ERR_FAILURE;
+    }
+    snprintf(name, sizeof(name), "%s.journal", nv->nvFile);
+    nv->journal = open(name, O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (nv->journal < 0) {
+        munmap(mapping, nv->blockSize);
+        return AJ_ERR_FAILURE;
+    }
+    /*
+     * Bytes past the end of a short file read as erased NVRAM
+     */
+    if (st.st_size < nv->blockSize) {
+        memset(mapping + st.st_size, INVALID_DATA_BYTE, nv->blockSize - st.st_size);
+    }
+    nv->mapping = mapping;
+    ReplayJournal(idx);
+    return AJ_OK;
+}
+
+static void UnmapNVFile(uint8_t idx)
+{
+    nvEmulatedNvramBlock* nv = &nvStorages[idx];
+
+    if (nv->mapping) {
+        SyncNVFile(idx);
+        munmap(nv->mapping, nv->blockSize);
+        close(nv->journal);
+        nv->mapping = NULL;
+    }
+}
+#else
+#define BlockStart(idx) (nvStorages[idx].blockStart)
+#endif
+
+/*
+ * Copies len bytes from src, which may overlap, to dest in a block and makes the change persistent
+ */
+static AJ_Status UpdateNV(uint8_t idx, uint8_t* dest, const uint8_t* src, uint32_t len)
+{
+#if AJ_NVRAM_JOURNAL
+    if (nvStorages[idx].mapping) {
+        return JournalNV(idx, dest, src, len);
+    }
+#endif
+    memmove(dest, src, len);
+    return _AJ_StoreNVToFile(idx);
+}
 
 uint8_t isOldNVRAMLayout = TRUE;
 
 static void _AJ_NVRAM_Init(uint8_t idx, uint8_t size)
 {
+    nvStorageCount = size;
+    _AJ_InvalidateNVIndex();
     for (; idx < size; ++idx) {
+#if AJ_NVRAM_JOURNAL
+        if (MapNVFile(idx) != AJ_OK) {
+            AJ_WarnPrintf(("_AJ_NVRAM_Init(): Unable to map \"%s\", using whole file writes\n", nvStorages[idx].nvFile));
+            _AJ_LoadNVFromFile(idx);
+        }
+#else
         _AJ_LoadNVFromFile(idx);
-        if (*((uint32_t*)nvStorages[idx].blockStart) != AJ_NV_SENTINEL) {
+#endif
+        if (*((uint32_t*)BlockStart(idx)) != AJ_NV_SENTINEL) {
             _AJ_NVRAM_Clear(idx);
         }
     }
@@ -143,12 +357,12 @@ AJ_Status AJ_NVRAM_Init_NewLayout()
 
 uint8_t* _AJ_GetNVBlockBase(AJ_NVRAM_Block_Id blockId)
 {
-    return nvStorages[isOldNVRAMLayout ? 0 : blockId].blockStart;
+    return BlockStart(isOldNVRAMLayout ? 0 : blockId);
 }
 
 uint8_t* _AJ_GetNVBlockEnd(AJ_NVRAM_Block_Id blockId)
 {
-    return nvStorages[isOldNVRAMLayout ? 0 : blockId].blockStart + nvStorages[isOldNVRAMLayout ? 0 : blockId].blockSize;
+    return BlockStart(isOldNVRAMLayout ? 0 : blockId) + nvStorages[isOldNVRAMLayout ? 0 : blockId].blockSize;
 }
 
 uint32_t _AJ_GetNVBlockSize(AJ_NVRAM_Block_Id blockId)
@@ -161,14 +375,13 @@ void _AJ_NV_Write(AJ_NVRAM_Block_Id blockId, void* dest, const void* buf, uint16
 #ifdef AJ_DEBUG_BUILD
     AJ_Status status = AJ_OK;
 #endif
-    memcpy(dest, buf, size);
     if (!isCompact) {
         nvStorages[blockId].isCompact = FALSE;
     }
 #ifdef AJ_DEBUG_BUILD
     status =
 #endif
-    _AJ_StoreNVToFile(blockId);
+    UpdateNV(blockId, (uint8_t*)dest, (const uint8_t*)buf, size);
     AJ_ASSERT(AJ_OK == status);
 }
 
@@ -177,11 +390,10 @@ void _AJ_NV_Move(AJ_NVRAM_Block_Id blockId, void* dest, const void* buf, uint16_
 #ifdef AJ_DEBUG_BUILD
     AJ_Status status = AJ_OK;
 #endif
-    memmove(dest, buf, size);
 #ifdef AJ_DEBUG_BUILD
     status =
 #endif
-    _AJ_StoreNVToFile(blockId);
+    UpdateNV(blockId, (uint8_t*)dest, (const uint8_t*)buf, size);
     AJ_ASSERT(AJ_OK == status);
 }
 
@@ -195,17 +407,38 @@ static void _AJ_NV_Clear(uint8_t idx)
 #ifdef AJ_DEBUG_BUILD
     AJ_Status status = AJ_OK;
 #endif
-    memset(nvStorages[idx].blockStart, INVALID_DATA_BYTE, nvStorages[idx].blockSize);
-    *((uint32_t*)(nvStorages[idx].blockStart)) = AJ_NV_SENTINEL;
+    uint8_t* image = NULL;
+
+#if AJ_NVRAM_JOURNAL
+    /*
+     * The erased block is built in a copy so it can be journaled before it is applied
+     */
+    if (nvStorages[idx].mapping) {
+        image = (uint8_t*)AJ_Malloc(nvStorages[idx].blockSize);
+    }
+#endif
+    if (image) {
+        memset(image, INVALID_DATA_BYTE, nvStorages[idx].blockSize);
+        *((uint32_t*)image) = AJ_NV_SENTINEL;
 #ifdef AJ_DEBUG_BUILD
-    status =
+        status =
 #endif
-    _AJ_StoreNVToFile(idx);
+        UpdateNV(idx, BlockStart(idx), image, nvStorages[idx].blockSize);
+        AJ_Free(image);
+    } else {
+        memset(BlockStart(idx), INVALID_DATA_BYTE, nvStorages[idx].blockSize);
+        *((uint32_t*)(BlockStart(idx))) = AJ_NV_SENTINEL;
+#ifdef AJ_DEBUG_BUILD
+        status =
+#endif
+        _AJ_StoreNVToFile(idx);
+    }
     AJ_ASSERT(AJ_OK == status);
 }
 
 void _AJ_NVRAM_Clear(AJ_NVRAM_Block_Id blockId)
 {
+    _AJ_InvalidateNVIndex();
     if ((blockId == AJ_NVRAM_ID_ALL_BLOCKS) && !isOldNVRAMLayout) {
         AJ_NVRAM_Block_Id _blockId;
         for (_blockId = blockId + 1; _blockId < AJ_NVRAM_ID_END_SENTINEL; ++_blockId) {
@@ -226,8 +459,8 @@ AJ_Status _AJ_LoadNVFromFile(AJ_NVRAM_Block_Id blockId)
         status = AJ_ERR_FAILURE;
         goto Exit;
     }
-    memset(nvStorages[blockId].blockStart, INVALID_DATA_BYTE, nvStorages[blockId].blockSize);
-    readCount = fread(nvStorages[blockId].blockStart, nvStorages[blockId].blockSize, 1, f);
+    memset(BlockStart(blockId), INVALID_DATA_BYTE, nvStorages[blockId].blockSize);
+    readCount = fread(BlockStart(blockId), nvStorages[blockId].blockSize, 1, f);
     if (readCount != 1) {
         status = AJ_ERR_FAILURE;
     }
@@ -245,12 +478,17 @@ AJ_Status _AJ_StoreNVToFile(AJ_NVRAM_Block_Id blockId)
     AJ_Status status = AJ_OK;
     FILE* f;
     size_t writeCount;
+#if AJ_NVRAM_JOURNAL
+    if (nvStorages[blockId].mapping) {
+        return SyncNVFile(blockId);
+    }
+#endif
     f = fopen(nvStorages[blockId].nvFile, "wb");
     if (!f) {
         status = AJ_ERR_FAILURE;
         goto Exit;
     }
-    writeCount = fwrite(nvStorages[blockId].blockStart, nvStorages[blockId].blockSize, 1, f);
+    writeCount = fwrite(BlockStart(blockId), nvStorages[blockId].blockSize, 1, f);
     if (writeCount != 1) {
         status = AJ_ERR_FAILURE;
     }
@@ -268,19 +506,41 @@ AJ_Status _AJ_CompactNVStorage(AJ_NVRAM_Block_Id blockId)
 {
     uint16_t capacity = 0;
     uint16_t id = 0;
-    uint16_t* data = (uint16_t*)(nvStorages[blockId].blockStart + SENTINEL_OFFSET);
-    uint8_t* writePtr = (uint8_t*)data;
+    uint8_t* base = BlockStart(blockId);
+    uint8_t* image = NULL;
+    uint16_t* data;
+    uint8_t* writePtr;
+    uint8_t* moved = NULL;
     uint16_t entrySize = 0;
     uint16_t garbage = 0;
     if (nvStorages[blockId].isCompact) {
         return AJ_OK;
     }
-    while ((uint8_t*)data < (nvStorages[blockId].blockStart + nvStorages[blockId].blockSize) && *data != INVALID_DATA) {
+#if AJ_NVRAM_JOURNAL
+    /*
+     * A mapped block is compacted in a copy so the result can be journaled before it is applied
+     */
+    if (nvStorages[blockId].mapping) {
+        image = (uint8_t*)AJ_Malloc(nvStorages[blockId].blockSize);
+        if (image) {
+            memcpy(image, base, nvStorages[blockId].blockSize);
+            base = image;
+        }
+    }
+#endif
+    data = (uint16_t*)(base + SENTINEL_OFFSET);
+    writePtr = (uint8_t*)data;
+    while ((uint8_t*)data < (base + nvStorages[blockId].blockSize) && *data != INVALID_DATA) {
         id = *data;
         capacity = *(data + 1);
         entrySize = ENTRY_HEADER_SIZE + capacity;
         if (id != INVALID_ID) {
-            _AJ_NV_Move(blockId, writePtr, data, entrySize);
+            if (writePtr != (uint8_t*)data) {
+                memmove(writePtr, data, entrySize);
+                if (!moved) {
+                    moved = writePtr;
+                }
+            }
             writePtr += entrySize;
         } else {
             garbage += entrySize;
@@ -289,12 +549,34 @@ AJ_Status _AJ_CompactNVStorage(AJ_NVRAM_Block_Id blockId)
     }
 
     memset(writePtr, INVALID_DATA_BYTE, garbage);
-    _AJ_StoreNVToFile(blockId);
+    /*
+     * The moves are stored together rather than one entry at a time
+     */
+    if (garbage) {
+        _AJ_InvalidateNVIndex();
+        if (!moved) {
+            moved = writePtr;
+        }
+        if (image) {
+            UpdateNV(blockId, BlockStart(blockId) + (moved - image), moved, (uint32_t)(writePtr + garbage - moved));
+        } else {
+            _AJ_StoreNVToFile(blockId);
+        }
+    }
+    AJ_Free(image);
     nvStorages[blockId].isCompact = TRUE;
     return AJ_OK;
 }
 
 void _AJ_NVRAM_ResetLayout()
 {
+#if AJ_NVRAM_JOURNAL
+    uint8_t idx;
+
+    for (idx = 0; nvStorages && (idx < nvStorageCount); ++idx) {
+        UnmapNVFile(idx);
+    }
+#endif
+    _AJ_InvalidateNVIndex();
     nvStorages = NULL;
 }
@@ -0,0 +1,322 @@
+/**
+ * @file
+ */
+/******************************************************************************
+ *    Copyright (c) Open Connectivity Foundation (OCF), AllJoyn Open Source
+ *    Project (AJOSP) Contributors and others.
+ *
+ *    SPDX-License-Identifier: Apache-2.0
+ *
+ *    All rights reserved. This program and the accompanying materials are
+ *    made available under the terms of the Apache License, Version 2.0
+ *    which accompanies this distribution, and is available at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Copyright (c) Open Connectivity Foundation and Contributors to AllSeen
+ *    Alliance. All rights reserved.
+ *
+ *    Permission to use, copy, modify, and/or distribute this software for
+ *    any purpose with or without fee is hereby granted, provided that the
+ *    above copyright notice and this permission notice appear in all
+ *    copies.
+ *
+ *    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ *    WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+ *    WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+ *    AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+ *    DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR
+ *    PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ *    TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ *    PERFORMANCE OF THIS SOFTWARE.
+ ******************************************************************************/
+
+#include <ajtcl/alljoyn.h>
+#include <ajtcl/aj_util.h>
+#include <ajtcl/aj_debug.h>
+#include <ajtcl/aj_bufio.h>
+
+/*
+ * Checks that Announce signals and GetAboutData replies served from the About cache are byte for
+ * byte the same as ones built from scratch, that the cache is dropped when the objects or the
+ * About data change, and measures how much a cached announcement saves.
+ */
+
+#define WIRE_SIZE   4096
+#define BENCH_LOOPS 10000
+#define ABOUT_PORT  900
+
+static uint8_t Wire[WIRE_SIZE];
+static size_t WireBytes;
+static size_t WirePos;
+static uint8_t Expect[WIRE_SIZE];
+static size_t ExpectBytes;
+
+static uint8_t TxBuffer[WIRE_SIZE];
+static uint8_t RxBuffer[WIRE_SIZE];
+
+static uint32_t GetterCalls;
+static const char* Model = "first model";
+
+static const char* const testInterface[] = {
+    "org.alljoyn.test.about",
+    "?Ping str<s",
+    NULL
+};
+
+static const AJ_InterfaceDescription testInterfaces[] = {
+    testInterface,
+    NULL
+};
+
+static AJ_Object AppObjects[] = {
+    { "/test/about", testInterfaces, AJ_OBJ_FLAG_ANNOUNCED },
+    { "/test/about/child", testInterfaces, AJ_OBJ_FLAG_ANNOUNCED },
+    { NULL }
+};
+
+static AJ_Status TxFunc(AJ_IOBuffer* buf)
+{
+    size_t tx = AJ_IO_BUF_AVAIL(buf);
+
+    if ((WireBytes + tx) > sizeof(Wire)) {
+        return AJ_ERR_WRITE;
+    }
+    memcpy(Wire + WireBytes, buf->readPtr, tx);
+    WireBytes += tx;
+    AJ_IO_BUF_RESET(buf);
+    return AJ_OK;
+}
+
+static AJ_Status RxFunc(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
+{
+    size_t rx = min(len, AJ_IO_BUF_SPACE(buf));
+
+    rx = min(rx, WireBytes - WirePos);
+    if (!rx) {
+        return AJ_ERR_TIMEOUT;
+    }
+    memcpy(buf->writePtr, Wire + WirePos, rx);
+    buf->writePtr += rx;
+    WirePos += rx;
+    return AJ_OK;
+}
+
+/*
+ * Property getter that marshals a few strings in the requested language
+ */
+static AJ_Status Getter(AJ_Message* reply, const char* language)
+{
+    AJ_Status status;
+    AJ_Arg array;
+    AJ_Arg dict;
+    const char* keys[] = { "AppName", "Manufacturer", "ModelNumber", "Description" };
+    const char* values[] = { "About cache test", "AllJoyn", Model, language };
+    size_t i;
+
+    ++GetterCalls;
+    status = AJ_MarshalContainer(reply, &array, AJ_ARG_ARRAY);
+    for (i = 0; (status == AJ_OK) && (i < ArraySize(keys)); ++i) {
+        status = AJ_MarshalContainer(reply, &dict, AJ_ARG_DICT_ENTRY);
+        if (status == AJ_OK) {
+            status = AJ_MarshalArgs(reply, "sv", keys[i], "s", values[i]);
+        }
+        if (status == AJ_OK) {
+            status = AJ_MarshalCloseContainer(reply, &dict);
+        }
+    }
+    if (status == AJ_OK) {
+        status = AJ_MarshalCloseContainer(reply, &array);
+    }
+    return status;
+}
+
+static void InitTx(AJ_BusAttachment* bus)
+{
+    AJ_IOBufInit(&bus->sock.tx, TxBuffer, sizeof(TxBuffer), AJ_IO_BUF_TX, NULL);
+    bus->sock.tx.send = TxFunc;
+    bus->serial = 1;
+    WireBytes = 0;
+}
+
+static AJ_Status Announce(AJ_BusAttachment* bus)
+{
+    InitTx(bus);
+    return AJ_AboutInit(bus, ABOUT_PORT);
+}
+
+/*
+ * Sends GetAboutData to ourselves and leaves the reply on the wire
+ */
+static AJ_Status GetAboutData(AJ_BusAttachment* bus, const char* language)
+{
+    AJ_Status status;
+    AJ_Message call;
+    AJ_Message msg;
+    AJ_Message reply;
+
+    InitTx(bus);
+    status = AJ_MarshalMethodCall(bus, &call, AJ_METHOD_ABOUT_GET_ABOUT_DATA, ":dest.1", 0, AJ_FLAG_NO_REPLY_EXPECTED, 0);
+    if (status == AJ_OK) {
+        status = AJ_MarshalArgs(&call, "s", language);
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&call);
+    }
+    if (status != AJ_OK) {
+        return status;
+    }
+    AJ_IOBufInit(&bus->sock.rx, RxBuffer, sizeof(RxBuffer), AJ_IO_BUF_RX, NULL);
+    bus->sock.rx.recv = RxFunc;
+    WirePos = 0;
+    status = AJ_UnmarshalMsg(bus, &msg, 1000);
+    if (status != AJ_OK) {
+        return status;
+    }
+    InitTx(bus);
+    status = AJ_AboutHandleGetAboutData(&msg, &reply);
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&reply);
+    }
+    AJ_CloseMsg(&msg);
+    return status;
+}
+
+static void SaveExpect(void)
+{
+    memcpy(Expect, Wire, WireBytes);
+    ExpectBytes = WireBytes;
+}
+
+static int SameAsExpect(void)
+{
+    return (WireBytes == ExpectBytes) && (memcmp(Wire, Expect, WireBytes) == 0);
+}
+
+int AJ_Main(void)
+{
+    AJ_Status status;
+    AJ_BusAttachment bus;
+    AJ_Time timer;
+    uint32_t cached;
+    uint32_t uncached;
+    uint32_t calls;
+    uint32_t i;
+
+    AJ_Initialize();
+#if !AJ_ABOUT_CACHE
+    AJ_AlwaysPrintf(("About cache disabled, test skipped\n"));
+    return 0;
+#endif
+    memset(&bus, 0, sizeof(bus));
+    strcpy(bus.uniqueName, ":test.1");
+    AJ_RegisterObjects(AppObjects, NULL);
+    AJ_AboutRegisterPropStoreGetter(Getter);
+
+    /*
+     * Announcing again, for example after reconnecting, reuses the cached body
+     */
+    status = Announce(&bus);
+    if ((status != AJ_OK) || (GetterCalls != 1)) {
+        AJ_AlwaysPrintf(("Announce failed %s\n", AJ_StatusText(status)));
+        goto ErrorExit;
+    }
+    SaveExpect();
+    status = Announce(&bus);
+    if ((status != AJ_OK) || (GetterCalls != 1) || !SameAsExpect()) {
+        AJ_AlwaysPrintf(("Cached announcement differs\n"));
+        goto ErrorExit;
+    }
+
+    /*
+     * Hiding an object or changing the About data rebuilds the announcement
+     */
+    AJ_SetObjectFlags("/test/about/child", AJ_OBJ_FLAG_HIDDEN, 0);
+    status = Announce(&bus);
+    if ((status != AJ_OK) || (GetterCalls != 2) || SameAsExpect()) {
+        AJ_AlwaysPrintf(("Announcement not rebuilt after hiding an object\n"));
+        goto ErrorExit;
+    }
+    AJ_SetObjectFlags("/test/about/child", 0, AJ_OBJ_FLAG_HIDDEN);
+    status = Announce(&bus);
+    if ((status != AJ_OK) || (GetterCalls != 3) || !SameAsExpect()) {
+        AJ_AlwaysPrintf(("Announcement not restored after showing an object\n"));
+        goto ErrorExit;
+    }
+    Model = "second model";
+    AJ_AboutSetShouldAnnounce();
+    status = Announce(&bus);
+    if ((status != AJ_OK) || (GetterCalls != 4) || SameAsExpect()) {
+        AJ_AlwaysPrintf(("Announcement not rebuilt after the About data changed\n"));
+        goto ErrorExit;
+    }
+    SaveExpect();
+    status = Announce(&bus);
+    if ((status != AJ_OK) || (GetterCalls != 4) || !SameAsExpect()) {
+        AJ_AlwaysPrintf(("Cached announcement differs\n"));
+        goto ErrorExit;
+    }
+
+    /*
+     * GetAboutData replies are cached per language
+     */
+    status = GetAboutData(&bus, "fr");
+    if ((status != AJ_OK) || (GetterCalls != 5)) {
+        AJ_AlwaysPrintf(("GetAboutData failed %s\n", AJ_StatusText(status)));
+        goto ErrorExit;
+    }
+    SaveExpect();
+    status = GetAboutData(&bus, "en");
+    if ((status != AJ_OK) || (GetterCalls != 6) || SameAsExpect()) {
+        AJ_AlwaysPrintf(("GetAboutData for a second language failed\n"));
+        goto ErrorExit;
+    }
+    status = GetAboutData(&bus, "fr");
+    if ((status != AJ_OK) || (GetterCalls != 6) || !SameAsExpect()) {
+        AJ_AlwaysPrintf(("Cached GetAboutData reply differs\n"));
+        goto ErrorExit;
+    }
+    AJ_AboutInvalidateCache();
+    status = GetAboutData(&bus, "fr");
+    if ((status != AJ_OK) || (GetterCalls != 7) || !SameAsExpect()) {
+        AJ_AlwaysPrintf(("GetAboutData not rebuilt after invalidating\n"));
+        goto ErrorExit;
+    }
+
+    /*
+     * Cost of an announcement with and without the cache
+     */
+    Announce(&bus);
+    calls = GetterCalls;
+    AJ_InitTimer(&timer);
+    for (i = 0; i < BENCH_LOOPS; ++i) {
+        Announce(&bus);
+    }
+    cached = AJ_GetElapsedTime(&timer, TRUE);
+    AJ_InitTimer(&timer);
+    for (i = 0; i < BENCH_LOOPS; ++i) {
+        AJ_AboutInvalidateCache();
+        Announce(&bus);
+    }
+    uncached = AJ_GetElapsedTime(&timer, TRUE);
+    if (GetterCalls != calls + BENCH_LOOPS) {
+        AJ_AlwaysPrintf(("Unexpected property getter calls %u\n", GetterCalls - calls));
+        goto ErrorExit;
+    }
+    AJ_AlwaysPrintf(("%u announcements: %u ms cached, %u ms rebuilt\n", BENCH_LOOPS, cached, uncached));
+
+    AJ_AboutInvalidateCache();
+    AJ_AlwaysPrintf(("About cache test PASSED\n"));
+    return 0;
+
+ErrorExit:
+
+    AJ_AlwaysPrintf(("About cache test FAILED\n"));
+    return 1;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
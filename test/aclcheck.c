@@ -0,0 +1,302 @@
+/**
+ * @file
+ */
+/******************************************************************************
+ *    Copyright (c) Open Connectivity Foundation (OCF), AllJoyn Open Source
+ *    Project (AJOSP) Contributors and others.
+ *
+ *    SPDX-License-Identifier: Apache-2.0
+ *
+ *    All rights reserved. This program and the accompanying materials are
+ *    made available under the terms of the Apache License, Version 2.0
+ *    which accompanies this distribution, and is available at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Copyright (c) Open Connectivity Foundation and Contributors to AllSeen
+ *    Alliance. All rights reserved.
+ *
+ *    Permission to use, copy, modify, and/or distribute this software for
+ *    any purpose with or without fee is hereby granted, provided that the
+ *    above copyright notice and this permission notice appear in all
+ *    copies.
+ *
+ *    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ *    WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+ *    WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+ *    AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+ *    DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR
+ *    PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ *    TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ *    PERFORMANCE OF THIS SOFTWARE.
+ ******************************************************************************/
+#include <ajtcl/alljoyn.h>
+#include <ajtcl/aj_authorisation.h>
+#include <ajtcl/aj_authentication.h>
+#include <ajtcl/aj_creds.h>
+#include <ajtcl/aj_guid.h>
+#include <ajtcl/aj_debug.h>
+
+/*
+ * Applies a policy for many peers, checks the access each peer gets to methods, signals and
+ * properties, that reset and re-registration clear the access, and measures access checks.
+ */
+
+#if AJ_NAME_MAP_GUID_SIZE > 100
+#define NUM_PEERS     100
+#else
+#define NUM_PEERS     (AJ_NAME_MAP_GUID_SIZE - 1)
+#endif
+#define CHECK_ROUNDS  100000
+
+static const char* const TestInterface[] = {
+    "$org.acl.Test",
+    "?Ping in<s out>s",
+    "?Pong",
+    "!Alarm level>u",
+    "@Level>u",
+    NULL
+};
+static const AJ_InterfaceDescription TestInterfaces[] = { AJ_PropertiesIface, TestInterface, NULL };
+static AJ_Object AppObjects[] = {
+    { "/acl/test", TestInterfaces },
+    { NULL }
+};
+
+#define PING_ID      AJ_APP_MESSAGE_ID(0, 1, 0)
+#define PONG_ID      AJ_APP_MESSAGE_ID(0, 1, 1)
+#define ALARM_ID     AJ_APP_MESSAGE_ID(0, 1, 2)
+#define LEVEL_ID     AJ_APP_PROPERTY_ID(0, 1, 3)
+
+static AJ_PermissionMember Members[] = {
+    { "Ping", AJ_MEMBER_TYPE_METHOD, AJ_ACTION_PROVIDE | AJ_ACTION_MODIFY, &Members[1] },
+    { "Alarm", AJ_MEMBER_TYPE_SIGNAL, AJ_ACTION_OBSERVE, &Members[2] },
+    { "Level", AJ_MEMBER_TYPE_PROPERTY, AJ_ACTION_OBSERVE, NULL }
+};
+
+static char PeerNames[NUM_PEERS][16];
+
+static AJ_Status AddPeers(void)
+{
+    AJ_Status status = AJ_OK;
+    AJ_GUID guid;
+    size_t i;
+
+    for (i = 0; (status == AJ_OK) && (i < NUM_PEERS); ++i) {
+        sprintf(PeerNames[i], ":peer.%u", (unsigned)i);
+        memset(&guid, (int)(i + 1), sizeof(guid));
+        status = AJ_GUID_AddNameMapping(NULL, &guid, PeerNames[i], NULL);
+    }
+    return status;
+}
+
+static AJ_Status InstallPolicy(void)
+{
+    AJ_Status status;
+    AJ_PermissionPeer peer;
+    AJ_PermissionRule rule;
+    AJ_PermissionACL acl;
+    AJ_Policy policy;
+    AJ_CredField field;
+
+    memset(&peer, 0, sizeof(peer));
+    peer.type = AJ_PEER_TYPE_ALL;
+    rule.obj = "/acl/*";
+    rule.ifn = "org.acl.Test";
+    rule.members = Members;
+    rule.next = NULL;
+    acl.peers = &peer;
+    acl.rules = &rule;
+    acl.next = NULL;
+    policy.specification = 1;
+    policy.version = 1;
+    policy.acls = &acl;
+
+    field.size = 1024;
+    field.data = (uint8_t*)AJ_Malloc(field.size);
+    if (!field.data) {
+        return AJ_ERR_RESOURCES;
+    }
+    status = AJ_PolicyToBuffer(&policy, &field);
+    if (status == AJ_OK) {
+        status = AJ_CredentialSet(AJ_POLICY_INSTALLED | AJ_CRED_TYPE_POLICY, NULL, 0xFFFFFFFF, &field);
+    }
+    AJ_CredFieldFree(&field);
+    if (status == AJ_OK) {
+        status = AJ_PolicyLoad();
+    }
+    return status;
+}
+
+static AJ_Status Check(uint32_t msgId, const char* name, uint8_t direction)
+{
+    AJ_Message msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msgId = msgId;
+    msg.objPath = "/acl/test";
+    msg.iface = "org.acl.Test";
+    msg.member = "";
+    return AJ_AccessControlCheckMessage(&msg, name, direction);
+}
+
+static AJ_Status CheckProperty(uint32_t propId, uint8_t method, const char* name, uint8_t direction)
+{
+    AJ_Message msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msgId = AJ_APP_MESSAGE_ID(0, 0, method);
+    return AJ_AccessControlCheckProperty(&msg, propId, name, direction);
+}
+
+/*
+ * The policy grants incoming and outgoing calls of Ping, outgoing Alarm signals and incoming
+ * Level gets, without ECDSA there is no manifest so the policy grants the manifest access too
+ */
+static AJ_Status CheckPolicyAccess(const char* name)
+{
+    if ((Check(PING_ID, name, AJ_ACCESS_INCOMING) != AJ_OK) || (Check(PING_ID, name, AJ_ACCESS_OUTGOING) != AJ_OK)) {
+        return AJ_ERR_FAILURE;
+    }
+    if ((Check(PONG_ID, name, AJ_ACCESS_INCOMING) != AJ_ERR_ACCESS) || (Check(PONG_ID, name, AJ_ACCESS_OUTGOING) != AJ_ERR_ACCESS)) {
+        return AJ_ERR_FAILURE;
+    }
+    if ((Check(ALARM_ID, name, AJ_ACCESS_OUTGOING) != AJ_OK) || (Check(ALARM_ID, name, AJ_ACCESS_INCOMING) != AJ_ERR_ACCESS)) {
+        return AJ_ERR_FAILURE;
+    }
+    if ((CheckProperty(LEVEL_ID, AJ_PROP_GET, name, AJ_ACCESS_INCOMING) != AJ_OK) ||
+        (CheckProperty(LEVEL_ID, AJ_PROP_SET, name, AJ_ACCESS_INCOMING) != AJ_ERR_ACCESS)) {
+        return AJ_ERR_FAILURE;
+    }
+    return AJ_OK;
+}
+
+static AJ_Status CheckNoAccess(const char* name)
+{
+    if ((Check(PING_ID, name, AJ_ACCESS_INCOMING) != AJ_ERR_ACCESS) || (Check(ALARM_ID, name, AJ_ACCESS_OUTGOING) != AJ_ERR_ACCESS) ||
+        (CheckProperty(LEVEL_ID, AJ_PROP_GET, name, AJ_ACCESS_INCOMING) != AJ_ERR_ACCESS)) {
+        return AJ_ERR_FAILURE;
+    }
+    return AJ_OK;
+}
+
+int AJ_Main(void)
+{
+    AJ_AuthenticationContext ctx;
+    AJ_ECCPublicKey pub;
+    AJ_Time timer;
+    uint32_t elapsed;
+    uint32_t i;
+    uint32_t allowed = 0;
+
+    AJ_Initialize();
+    AJ_GUID_ClearNameMap();
+    AJ_CredentialDelete(AJ_POLICY_INSTALLED | AJ_CRED_TYPE_POLICY, NULL);
+
+    if ((AJ_AuthorisationRegister(AJ_StandardObjects, AJ_BUS_ID_FLAG) != AJ_OK) || (AJ_AuthorisationRegister(AppObjects, AJ_APP_ID_FLAG) != AJ_OK)) {
+        AJ_AlwaysPrintf(("Register failed\n"));
+        goto ErrorExit;
+    }
+    if (AddPeers() != AJ_OK) {
+        AJ_AlwaysPrintf(("Failed to add peers\n"));
+        goto ErrorExit;
+    }
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.suite = AUTH_SUITE_ECDHE_NULL;
+    /*
+     * Without a policy application members are open to all peers (Security 1.0)
+     */
+    if (AJ_PolicyApply(&ctx, PeerNames[0]) != AJ_OK) {
+        goto ErrorExit;
+    }
+    if ((Check(PONG_ID, PeerNames[0], AJ_ACCESS_INCOMING) != AJ_OK) || (CheckNoAccess(PeerNames[1]) != AJ_OK)) {
+        AJ_AlwaysPrintf(("Default access wrong\n"));
+        goto ErrorExit;
+    }
+    if (InstallPolicy() != AJ_OK) {
+        AJ_AlwaysPrintf(("Failed to install policy\n"));
+        goto ErrorExit;
+    }
+    for (i = 0; i < NUM_PEERS; ++i) {
+        if ((AJ_AccessControlReset(PeerNames[i]) != AJ_OK) || (AJ_PolicyApply(&ctx, PeerNames[i]) != AJ_OK)) {
+            AJ_AlwaysPrintf(("Failed to apply policy for peer %u\n", i));
+            goto ErrorExit;
+        }
+    }
+    for (i = 0; i < NUM_PEERS; ++i) {
+        if (CheckPolicyAccess(PeerNames[i]) != AJ_OK) {
+            AJ_AlwaysPrintf(("Policy access wrong for peer %u\n", i));
+            goto ErrorExit;
+        }
+    }
+    /*
+     * With ECDSA the policy only grants access once a manifest has been applied
+     */
+    memset(&pub, 0x5A, sizeof(pub));
+    ctx.suite = AUTH_SUITE_ECDHE_ECDSA;
+    ctx.kactx.ecdsa.key = &pub;
+    ctx.kactx.ecdsa.num = 1;
+    if ((AJ_AccessControlReset(PeerNames[1]) != AJ_OK) || (AJ_PolicyApply(&ctx, PeerNames[1]) != AJ_OK) || (CheckNoAccess(PeerNames[1]) != AJ_OK)) {
+        AJ_AlwaysPrintf(("Access granted without manifest\n"));
+        goto ErrorExit;
+    }
+    ctx.suite = AUTH_SUITE_ECDHE_NULL;
+    /*
+     * Resetting a peer only clears that peer
+     */
+    if ((AJ_AccessControlReset(PeerNames[0]) != AJ_OK) || (CheckNoAccess(PeerNames[0]) != AJ_OK) || (CheckPolicyAccess(PeerNames[NUM_PEERS - 1]) != AJ_OK)) {
+        AJ_AlwaysPrintf(("Reset wrong\n"));
+        goto ErrorExit;
+    }
+    /*
+     * Registering the objects again starts them with no access
+     */
+    if ((AJ_AuthorisationRegister(AppObjects, AJ_APP_ID_FLAG) != AJ_OK) || (CheckNoAccess(PeerNames[NUM_PEERS - 1]) != AJ_OK)) {
+        AJ_AlwaysPrintf(("Re-registration wrong\n"));
+        goto ErrorExit;
+    }
+    if ((AJ_PolicyApply(&ctx, PeerNames[NUM_PEERS - 1]) != AJ_OK) || (CheckPolicyAccess(PeerNames[NUM_PEERS - 1]) != AJ_OK)) {
+        AJ_AlwaysPrintf(("Policy access wrong after re-registration\n"));
+        goto ErrorExit;
+    }
+
+    /*
+     * Time checks of an application member and of a bus member registered long before it
+     */
+    AJ_InitTimer(&timer);
+    for (i = 0; i < CHECK_ROUNDS; ++i) {
+        allowed += (Check(PING_ID, PeerNames[NUM_PEERS - 1], AJ_ACCESS_INCOMING) == AJ_OK);
+    }
+    elapsed = AJ_GetElapsedTime(&timer, FALSE);
+    AJ_AlwaysPrintf(("%u application member checks in %u ms\n", CHECK_ROUNDS, elapsed));
+    AJ_InitTimer(&timer);
+    for (i = 0; i < CHECK_ROUNDS; ++i) {
+        allowed += (Check(AJ_METHOD_CLAIMABLE_CLAIM, PeerNames[NUM_PEERS - 1], AJ_ACCESS_INCOMING) == AJ_OK);
+    }
+    elapsed = AJ_GetElapsedTime(&timer, FALSE);
+    AJ_AlwaysPrintf(("%u bus member checks in %u ms\n", CHECK_ROUNDS, elapsed));
+    if (allowed != CHECK_ROUNDS) {
+        AJ_AlwaysPrintf(("Access changed while checking\n"));
+        goto ErrorExit;
+    }
+
+    AJ_PolicyUnload();
+    AJ_CredentialDelete(AJ_POLICY_INSTALLED | AJ_CRED_TYPE_POLICY, NULL);
+    AJ_AuthorisationClose();
+    AJ_AlwaysPrintf(("Access control test PASSED\n"));
+    return 0;
+
+ErrorExit:
+
+    AJ_PolicyUnload();
+    AJ_CredentialDelete(AJ_POLICY_INSTALLED | AJ_CRED_TYPE_POLICY, NULL);
+    AJ_AuthorisationClose();
+    AJ_AlwaysPrintf(("Access control test FAILED\n"));
+    return 1;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
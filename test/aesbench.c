@@ -35,50 +35,131 @@
 
 #include <ajtcl/alljoyn.h>
 #include <ajtcl/aj_crypto.h>
+#include <ajtcl/aj_crypto_aes_priv.h>
 #include <ajtcl/aj_debug.h>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define CYCLES() __rdtsc()
+#endif
+
+#if AJ_AES_CT
+#define SW_BACKEND "constant-time"
+#else
+#define SW_BACKEND "table"
+#endif
+
+#define CYCLE_ITERATIONS 20000
+
 static const uint8_t key[] = { 0xC6, 0xC4, 0xFC, 0xEF, 0x31, 0x85, 0xFB, 0x66, 0xAA, 0xB8, 0x62, 0xBC, 0x03, 0x76, 0xAB, 0xBE };
 
 static uint8_t msg[1024];
 static uint32_t nonce[2] = { 0x2AC45FAD, 0xD617159A };
 
-int main(void)
+static AJ_Status RunBench(const AJ_AES_Key* aesKey)
 {
     AJ_Status status = AJ_OK;
     size_t i;
     uint8_t cmp[1024];
 
-    for (i = 0; i < sizeof(msg); ++i) {
-        msg[i] = (uint8_t)(127 + i * 11 + i * 13 + i * 17);
-    }
-
     for (i = 0; i < 10000; ++i) {
         uint8_t hdrLen;
 
         for (hdrLen = 10; hdrLen < 60; hdrLen += 3) {
             memcpy(cmp, msg, sizeof(msg));
 
-            status = AJ_Encrypt_CCM(key, msg, sizeof(msg), hdrLen, 12, (const uint8_t*) nonce, sizeof(nonce));
+            if (aesKey) {
+                status = AJ_Encrypt_CCM_Key(aesKey, msg, sizeof(msg), hdrLen, 12, (const uint8_t*) nonce, sizeof(nonce));
+            } else {
+                status = AJ_Encrypt_CCM(key, msg, sizeof(msg), hdrLen, 12, (const uint8_t*) nonce, sizeof(nonce));
+            }
             if (status != AJ_OK) {
                 AJ_AlwaysPrintf(("Encryption failed (%d) for test #%zu\n", status, i));
-                goto ErrorExit;
+                return status;
+            }
+            if (aesKey) {
+                status = AJ_Decrypt_CCM_Key(aesKey, msg, sizeof(msg), hdrLen, 12, (const uint8_t*) nonce, sizeof(nonce));
+            } else {
+                status = AJ_Decrypt_CCM(key, msg, sizeof(msg), hdrLen, 12, (const uint8_t*) nonce, sizeof(nonce));
             }
-            status = AJ_Decrypt_CCM(key, msg, sizeof(msg), hdrLen, 12, (const uint8_t*) nonce, sizeof(nonce));
             if (status != AJ_OK) {
                 AJ_AlwaysPrintf(("Authentication failure (%d) for test #%zu\n", status, i));
-                goto ErrorExit;
+                return status;
             }
             if (memcmp(cmp, msg, sizeof(msg)) != 0) {
                 AJ_AlwaysPrintf(("Decrypt verification failure \n"));
-                goto ErrorExit;
+                return AJ_ERR_FAILURE;
             }
             nonce[0] += 1;
         }
     }
+    return status;
+}
+
+/*
+ * Reports the cost of CCM encryption for the backend that is currently selected
+ */
+static void Throughput(const char* backend, const AJ_AES_Key* aesKey)
+{
+    AJ_Time timer;
+    uint32_t elapsed;
+    size_t i;
+    uint64_t bytes = (uint64_t)CYCLE_ITERATIONS * sizeof(msg);
+#ifdef CYCLES
+    uint64_t cycles = CYCLES();
+#endif
+
+    AJ_InitTimer(&timer);
+    for (i = 0; i < CYCLE_ITERATIONS; ++i) {
+        AJ_Encrypt_CCM_Key(aesKey, msg, sizeof(msg) - 16, 16, 12, (const uint8_t*) nonce, sizeof(nonce));
+    }
+    elapsed = AJ_GetElapsedTime(&timer, FALSE);
+#ifdef CYCLES
+    cycles = CYCLES() - cycles;
+    AJ_AlwaysPrintf(("%s: %u.%02u cycles/byte, %u ms\n", backend, (uint32_t)(cycles / bytes), (uint32_t)((cycles * 100 / bytes) % 100), elapsed));
+#else
+    AJ_AlwaysPrintf(("%s: %u KB/s\n", backend, elapsed ? (uint32_t)(bytes / elapsed) : 0));
+#endif
+}
+
+int main(void)
+{
+    size_t i;
+    AJ_Time timer;
+    AJ_AES_Key aesKey;
+
+    for (i = 0; i < sizeof(msg); ++i) {
+        msg[i] = (uint8_t)(127 + i * 11 + i * 13 + i * 17);
+    }
+
+    AJ_InitTimer(&timer);
+    if (RunBench(NULL) != AJ_OK) {
+        goto ErrorExit;
+    }
+    AJ_AlwaysPrintf(("Raw key: %u ms\n", AJ_GetElapsedTime(&timer, FALSE)));
+
+    AJ_InitTimer(&timer);
+    AJ_AES_ExpandKey(&aesKey, key);
+    if (RunBench(&aesKey) != AJ_OK) {
+        goto ErrorExit;
+    }
+    AJ_AlwaysPrintf(("Expanded key: %u ms\n", AJ_GetElapsedTime(&timer, FALSE)));
+
+#if AJ_AES_NI
+    AJ_AESNI_Enable(FALSE);
+    Throughput(SW_BACKEND, &aesKey);
+    if (AJ_AESNI_Available()) {
+        AJ_AESNI_Enable(TRUE);
+        Throughput("AES-NI", &aesKey);
+    }
+#else
+    Throughput(SW_BACKEND, &aesKey);
+#endif
+    AJ_MemZeroSecure(&aesKey, sizeof(aesKey));
     return 0;
 
 ErrorExit:
 
     AJ_AlwaysPrintf(("AES CCM unit test FAILED\n"));
     return 1;
-}
\ No newline at end of file
+}
@@ -372,6 +372,7 @@ int AJ_Main(void)
     for (i = 0; i < ArraySize(testVector); i++) {
 
         uint8_t key[16];
+        AJ_AES_Key aesKey;
         uint8_t input[64];
         uint8_t* msg;
         uint8_t nonce[16];
@@ -427,6 +428,66 @@ int AJ_Main(void)
                 goto ErrorExit;
             }
         }
+        /*
+         * Verify the expanded key functions produce the same results
+         */
+        AJ_AES_ExpandKey(&aesKey, key);
+        status = AJ_Encrypt_CCM_Key(&aesKey, msg, mlen, testVector[i].hdrLen, testVector[i].authLen, nonce, nlen);
+        if (status != AJ_OK) {
+            AJ_AlwaysPrintf(("Expanded key encryption failed (%d) for test #%u\n", status, i));
+            goto ErrorExit;
+        }
+        AJ_RawToHex(msg, mlen + testVector[i].authLen, out, olen, FALSE);
+        if (strcmp(out, testVector[i].output) != 0) {
+            AJ_AlwaysPrintf(("Expanded key encrypt verification failure for test #%u\n%s\n", i, out));
+            goto ErrorExit;
+        }
+        status = AJ_Decrypt_CCM_Key(&aesKey, msg, mlen, testVector[i].hdrLen, testVector[i].authLen, nonce, nlen);
+        if (status != AJ_OK) {
+            AJ_AlwaysPrintf(("Expanded key authentication failure (%d) for test #%u\n", status, i));
+            goto ErrorExit;
+        }
+        AJ_RawToHex(msg, mlen, out, olen, FALSE);
+        for (j = 0; j < testVector[i].repeat; j++) {
+            if (strncmp(&out[2 * ilen * j], testVector[i].input, ilen * 2) != 0) {
+                AJ_AlwaysPrintf(("Expanded key decrypt verification failure for test #%u\n%s\n", i, out));
+                goto ErrorExit;
+            }
+        }
+        /*
+         * Verify streaming in uneven pieces produces the same results
+         */
+        for (j = 0; j < 2; j++) {
+            AJ_CCM_Stream ccm;
+            uint32_t pos = testVector[i].hdrLen;
+            uint32_t piece = 1;
+
+            status = AJ_CCM_Start(&ccm, &aesKey, msg, mlen, testVector[i].hdrLen, testVector[i].authLen, nonce, nlen, (uint8_t)j);
+            if (status != AJ_OK) {
+                AJ_AlwaysPrintf(("Stream start failed (%d) for test #%u\n", status, i));
+                goto ErrorExit;
+            }
+            while (pos < mlen) {
+                uint32_t len = min(piece, mlen - pos);
+                AJ_CCM_Update(&ccm, msg + pos, len);
+                pos += len;
+                piece = (piece * 7 + 3) % 37 + 1;
+            }
+            status = AJ_CCM_Final(&ccm, msg + mlen);
+            if (status != AJ_OK) {
+                AJ_AlwaysPrintf(("Stream final failed (%d) for test #%u\n", status, i));
+                goto ErrorExit;
+            }
+            AJ_RawToHex(msg, j ? mlen : mlen + testVector[i].authLen, out, olen, FALSE);
+            if ((j == 0) && (strcmp(out, testVector[i].output) != 0)) {
+                AJ_AlwaysPrintf(("Stream encrypt verification failure for test #%u\n%s\n", i, out));
+                goto ErrorExit;
+            }
+            if ((j == 1) && (strncmp(out, testVector[i].input, ilen * 2) != 0)) {
+                AJ_AlwaysPrintf(("Stream decrypt verification failure for test #%u\n%s\n", i, out));
+                goto ErrorExit;
+            }
+        }
         AJ_AlwaysPrintf(("Passed and verified test #%zu\n", i));
         AJ_Free(msg);
         AJ_Free(out);
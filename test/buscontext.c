@@ -0,0 +1,188 @@
+/**
+ * @file
+ */
+/******************************************************************************
+ *    Copyright (c) Open Connectivity Foundation (OCF), AllJoyn Open Source
+ *    Project (AJOSP) Contributors and others.
+ *
+ *    SPDX-License-Identifier: Apache-2.0
+ *
+ *    All rights reserved. This program and the accompanying materials are
+ *    made available under the terms of the Apache License, Version 2.0
+ *    which accompanies this distribution, and is available at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Copyright (c) Open Connectivity Foundation and Contributors to AllSeen
+ *    Alliance. All rights reserved.
+ *
+ *    Permission to use, copy, modify, and/or distribute this software for
+ *    any purpose with or without fee is hereby granted, provided that the
+ *    above copyright notice and this permission notice appear in all
+ *    copies.
+ *
+ *    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ *    WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+ *    WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+ *    AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+ *    DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR
+ *    PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ *    TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ *    PERFORMANCE OF THIS SOFTWARE.
+ ******************************************************************************/
+
+#include <ajtcl/alljoyn.h>
+#include <ajtcl/aj_util.h>
+#include <ajtcl/aj_debug.h>
+#include <ajtcl/aj_guid.h>
+
+/*
+ * Checks that bus attachments with their own context have separate name maps, registered objects
+ * and timers, and that bus attachments without a context share the default state.
+ */
+
+static const char* const LampInterface[] = {
+    "org.example.Lamp",
+    "?Toggle",
+    NULL
+};
+
+static const char* const DoorInterface[] = {
+    "org.example.Door",
+    "?Open",
+    NULL
+};
+
+static const AJ_InterfaceDescription LampInterfaces[] = {
+    LampInterface,
+    NULL
+};
+
+static const AJ_InterfaceDescription DoorInterfaces[] = {
+    DoorInterface,
+    NULL
+};
+
+static const AJ_Object LampObjects[] = {
+    { "/lamp", LampInterfaces },
+    { NULL }
+};
+
+static const AJ_Object DoorObjects[] = {
+    { "/door", DoorInterfaces },
+    { NULL }
+};
+
+static uint32_t Fired;
+
+static void OnTimer(void* context)
+{
+    ++Fired;
+}
+
+static const char* MemberOf(const AJ_BusAttachment* bus)
+{
+    const char* member = NULL;
+    AJ_BusContextSelect(bus);
+    if (AJ_GetMemberType(AJ_APP_MESSAGE_ID(0, 0, 0), &member, NULL) == 0) {
+        return "";
+    }
+    return member;
+}
+
+int AJ_Main(void)
+{
+    AJ_BusAttachment lamp;
+    AJ_BusAttachment door;
+    AJ_BusAttachment legacy;
+    AJ_GUID guid;
+
+    AJ_Initialize();
+    memset(&lamp, 0, sizeof(lamp));
+    memset(&door, 0, sizeof(door));
+    memset(&legacy, 0, sizeof(legacy));
+    memset(&guid, 0x11, sizeof(guid));
+
+    if ((AJ_BusContextCreate(&lamp) != AJ_OK) || (AJ_BusContextCreate(&door) != AJ_OK)) {
+        AJ_AlwaysPrintf(("Failed to create contexts\n"));
+        goto ErrorExit;
+    }
+    /*
+     * Name maps
+     */
+    AJ_BusContextSelect(&legacy);
+    AJ_GUID_AddNameMapping(NULL, &guid, ":legacy.1", NULL);
+    AJ_BusContextSelect(&lamp);
+    AJ_GUID_AddNameMapping(NULL, &guid, ":lamp.1", NULL);
+    AJ_BusContextSelect(&door);
+    AJ_GUID_AddNameMapping(NULL, &guid, ":door.1", NULL);
+    if (AJ_GUID_Find(":lamp.1") || AJ_GUID_Find(":legacy.1") || !AJ_GUID_Find(":door.1")) {
+        AJ_AlwaysPrintf(("Name map shared with door\n"));
+        goto ErrorExit;
+    }
+    AJ_BusContextSelect(&lamp);
+    if (!AJ_GUID_Find(":lamp.1") || AJ_GUID_Find(":legacy.1") || AJ_GUID_Find(":door.1")) {
+        AJ_AlwaysPrintf(("Name map shared with lamp\n"));
+        goto ErrorExit;
+    }
+    AJ_BusContextSelect(NULL);
+    if (AJ_GUID_Find(":lamp.1") || !AJ_GUID_Find(":legacy.1") || AJ_GUID_Find(":door.1")) {
+        AJ_AlwaysPrintf(("Default name map not separate\n"));
+        goto ErrorExit;
+    }
+    /*
+     * Registered objects
+     */
+    AJ_BusContextSelect(&lamp);
+    AJ_RegisterObjects(LampObjects, NULL);
+    AJ_BusContextSelect(&door);
+    AJ_RegisterObjects(DoorObjects, NULL);
+    if ((strcmp(MemberOf(&lamp), "Toggle") != 0) || (strcmp(MemberOf(&door), "Open") != 0) || (strcmp(MemberOf(&legacy), "") != 0)) {
+        AJ_AlwaysPrintf(("Objects not separate\n"));
+        goto ErrorExit;
+    }
+    /*
+     * Timers
+     */
+    AJ_BusContextSelect(&lamp);
+    if (!AJ_SetTimer(0, OnTimer, NULL, 0)) {
+        goto ErrorExit;
+    }
+    AJ_BusContextSelect(&door);
+    AJ_RunExpiredTimers();
+    AJ_BusContextSelect(&legacy);
+    AJ_RunExpiredTimers();
+    if (Fired) {
+        AJ_AlwaysPrintf(("Timer fired in the wrong context\n"));
+        goto ErrorExit;
+    }
+    AJ_BusContextSelect(&lamp);
+    AJ_RunExpiredTimers();
+    if (Fired != 1) {
+        AJ_AlwaysPrintf(("Timer did not fire\n"));
+        goto ErrorExit;
+    }
+    /*
+     * Destroying a selected context selects the default state
+     */
+    AJ_BusContextDestroy(&lamp);
+    AJ_BusContextDestroy(&door);
+    if (lamp.context || door.context || !AJ_GUID_Find(":legacy.1")) {
+        AJ_AlwaysPrintf(("Default state not selected after destroy\n"));
+        goto ErrorExit;
+    }
+
+    AJ_AlwaysPrintf(("Bus context test PASSED\n"));
+    return 0;
+
+ErrorExit:
+
+    AJ_AlwaysPrintf(("Bus context test FAILED\n"));
+    return 1;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
@@ -0,0 +1,243 @@
+/**
+ * @file
+ */
+/******************************************************************************
+ *    Copyright (c) Open Connectivity Foundation (OCF), AllJoyn Open Source
+ *    Project (AJOSP) Contributors and others.
+ *
+ *    SPDX-License-Identifier: Apache-2.0
+ *
+ *    All rights reserved. This program and the accompanying materials are
+ *    made available under the terms of the Apache License, Version 2.0
+ *    which accompanies this distribution, and is available at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Copyright (c) Open Connectivity Foundation and Contributors to AllSeen
+ *    Alliance. All rights reserved.
+ *
+ *    Permission to use, copy, modify, and/or distribute this software for
+ *    any purpose with or without fee is hereby granted, provided that the
+ *    above copyright notice and this permission notice appear in all
+ *    copies.
+ *
+ *    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ *    WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+ *    WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+ *    AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+ *    DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR
+ *    PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ *    TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ *    PERFORMANCE OF THIS SOFTWARE.
+ ******************************************************************************/
+
+#include <ajtcl/alljoyn.h>
+#include <ajtcl/aj_creds.h>
+#include <ajtcl/aj_nvram.h>
+#include <ajtcl/aj_debug.h>
+
+/*
+ * Stores many peer credentials, checks they are found again after restarts, deletions made
+ * directly through the NVRAM API and eviction of the oldest credentials, and measures lookups.
+ */
+
+#if AJ_MAX_CREDS >= 200
+#define NUM_PEERS     100
+#else
+#define NUM_PEERS     (AJ_MAX_CREDS / 2)
+#endif
+#define EXTRA_PEERS   200
+#define LOOKUP_ROUNDS 20
+
+extern void _AJ_NVRAM_ResetLayout();
+
+static const char* const BlockFiles[] = {
+    "ajtcl_creds.nvram",
+    "ajtcl_services.nvram",
+    "ajtcl_framework.nvram",
+    "ajtcl_ajjs.nvram",
+    "ajtcl_reserved.nvram",
+    "ajtcl_apps.nvram"
+};
+
+static void RemoveFiles(void)
+{
+    char name[64];
+    size_t i;
+
+    for (i = 0; i < ArraySize(BlockFiles); ++i) {
+        remove(BlockFiles[i]);
+        snprintf(name, sizeof(name), "%s.journal", BlockFiles[i]);
+        remove(name);
+    }
+}
+
+static void MakePeer(uint16_t n, AJ_GUID* guid, uint8_t* secret)
+{
+    memset(guid, 0, sizeof(AJ_GUID));
+    guid->val[0] = (uint8_t)(n >> 8);
+    guid->val[1] = (uint8_t)n;
+    guid->val[15] = 0xA5;
+    memset(secret, n & 0xFF, AJ_MASTER_SECRET_LEN);
+}
+
+static AJ_Status SetPeer(uint16_t n)
+{
+    AJ_GUID guid;
+    uint8_t secret[AJ_MASTER_SECRET_LEN];
+
+    MakePeer(n, &guid, secret);
+    return AJ_CredentialSetPeer(AJ_GENERIC_MASTER_SECRET, &guid, 1000 + n, secret, sizeof(secret));
+}
+
+static int PeerIs(uint16_t n)
+{
+    AJ_GUID guid;
+    uint8_t expect[AJ_MASTER_SECRET_LEN];
+    uint8_t secret[AJ_MASTER_SECRET_LEN];
+    AJ_CredField data;
+    uint32_t expiration = 0;
+
+    MakePeer(n, &guid, expect);
+    data.size = sizeof(secret);
+    data.data = secret;
+    if (AJ_CredentialGetPeer(AJ_GENERIC_MASTER_SECRET, &guid, &expiration, &data) != AJ_OK) {
+        return FALSE;
+    }
+    return (expiration == (uint32_t)(1000 + n)) && (data.size == sizeof(secret)) && (memcmp(secret, expect, sizeof(secret)) == 0);
+}
+
+static AJ_Status Restart(void)
+{
+    _AJ_NVRAM_ResetLayout();
+    return AJ_NVRAM_Init_NewLayout();
+}
+
+int AJ_Main(void)
+{
+    AJ_Status status;
+    AJ_Time timer;
+    uint32_t elapsed;
+    AJ_GUID guid;
+    uint8_t secret[AJ_MASTER_SECRET_LEN];
+    AJ_CredField id;
+    uint16_t slot;
+    uint16_t i;
+    uint16_t r;
+
+    RemoveFiles();
+    status = AJ_NVRAM_Init_NewLayout();
+    if (status != AJ_OK) {
+        AJ_AlwaysPrintf(("AJ_NVRAM_Init_NewLayout failed %s\n", AJ_StatusText(status)));
+        goto ErrorExit;
+    }
+    AJ_ClearCredentials(0);
+
+    AJ_InitTimer(&timer);
+    for (i = 0; i < NUM_PEERS; ++i) {
+        status = SetPeer(i);
+        if (status != AJ_OK) {
+            AJ_AlwaysPrintf(("Storing peer %u failed %s\n", i, AJ_StatusText(status)));
+            goto ErrorExit;
+        }
+    }
+    elapsed = AJ_GetElapsedTime(&timer, TRUE);
+    AJ_AlwaysPrintf(("Stored %u peer credentials: %u ms\n", NUM_PEERS, elapsed));
+
+    AJ_InitTimer(&timer);
+    for (r = 0; r < LOOKUP_ROUNDS; ++r) {
+        for (i = 0; i < NUM_PEERS; ++i) {
+            if (!PeerIs(i)) {
+                AJ_AlwaysPrintf(("Peer %u not found\n", i));
+                goto ErrorExit;
+            }
+        }
+    }
+    elapsed = AJ_GetElapsedTime(&timer, TRUE);
+    AJ_AlwaysPrintf(("%u peer credential lookups: %u ms\n", LOOKUP_ROUNDS * NUM_PEERS, elapsed));
+
+    /*
+     * Unknown peers are not found and deleted peers are gone
+     */
+    if (PeerIs(NUM_PEERS)) {
+        AJ_AlwaysPrintf(("Found a peer that was never stored\n"));
+        goto ErrorExit;
+    }
+    MakePeer(0, &guid, secret);
+    AJ_CredentialDeletePeer(&guid);
+    if (PeerIs(0) || !PeerIs(1)) {
+        AJ_AlwaysPrintf(("Deleting a peer failed\n"));
+        goto ErrorExit;
+    }
+
+    /*
+     * Credentials survive a restart
+     */
+    status = Restart();
+    for (i = 1; (status == AJ_OK) && (i < NUM_PEERS); ++i) {
+        if (!PeerIs(i)) {
+            status = AJ_ERR_FAILURE;
+        }
+    }
+    if (status != AJ_OK) {
+        AJ_AlwaysPrintf(("Credentials lost across a restart %s\n", AJ_StatusText(status)));
+        goto ErrorExit;
+    }
+
+    /*
+     * A credential deleted without going through the credentials API is no longer found
+     */
+    MakePeer(1, &guid, secret);
+    id.size = sizeof(guid);
+    id.data = (uint8_t*) &guid;
+    slot = AJ_CREDS_NV_ID_BEGIN;
+    status = AJ_CredentialGetNext(AJ_GENERIC_MASTER_SECRET | AJ_CRED_TYPE_GENERIC, &id, NULL, NULL, &slot);
+    if (status == AJ_OK) {
+        status = AJ_NVRAM_Delete(slot);
+    }
+    if ((status != AJ_OK) || PeerIs(1) || !PeerIs(2)) {
+        AJ_AlwaysPrintf(("Direct NVRAM delete not noticed %s\n", AJ_StatusText(status)));
+        goto ErrorExit;
+    }
+
+    /*
+     * When the credentials block fills up the credentials that expire first are evicted
+     */
+    for (i = NUM_PEERS; i < NUM_PEERS + EXTRA_PEERS; ++i) {
+        status = SetPeer(i);
+        if (status != AJ_OK) {
+            AJ_AlwaysPrintf(("Storing peer %u failed %s\n", i, AJ_StatusText(status)));
+            goto ErrorExit;
+        }
+    }
+    if (PeerIs(2) || !PeerIs(NUM_PEERS + EXTRA_PEERS - 1) || !PeerIs(NUM_PEERS + EXTRA_PEERS - 2)) {
+        AJ_AlwaysPrintf(("Oldest credentials were not evicted\n"));
+        goto ErrorExit;
+    }
+    for (i = NUM_PEERS + EXTRA_PEERS - 1; PeerIs(i); --i) {
+    }
+    AJ_AlwaysPrintf(("%u credentials held after eviction\n", NUM_PEERS + EXTRA_PEERS - 1 - i));
+
+    AJ_ClearCredentials(0);
+    if (PeerIs(NUM_PEERS + EXTRA_PEERS - 1)) {
+        AJ_AlwaysPrintf(("Clearing credentials failed\n"));
+        goto ErrorExit;
+    }
+
+    _AJ_NVRAM_ResetLayout();
+    RemoveFiles();
+    AJ_AlwaysPrintf(("credindex test PASSED\n"));
+    return 0;
+
+ErrorExit:
+    _AJ_NVRAM_ResetLayout();
+    RemoveFiles();
+    AJ_AlwaysPrintf(("credindex test FAILED\n"));
+    return 1;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
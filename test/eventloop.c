@@ -0,0 +1,206 @@
+/**
+ * @file
+ */
+/******************************************************************************
+ *    Copyright (c) Open Connectivity Foundation (OCF), AllJoyn Open Source
+ *    Project (AJOSP) Contributors and others.
+ *
+ *    SPDX-License-Identifier: Apache-2.0
+ *
+ *    All rights reserved. This program and the accompanying materials are
+ *    made available under the terms of the Apache License, Version 2.0
+ *    which accompanies this distribution, and is available at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Copyright (c) Open Connectivity Foundation and Contributors to AllSeen
+ *    Alliance. All rights reserved.
+ *
+ *    Permission to use, copy, modify, and/or distribute this software for
+ *    any purpose with or without fee is hereby granted, provided that the
+ *    above copyright notice and this permission notice appear in all
+ *    copies.
+ *
+ *    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ *    WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+ *    WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+ *    AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+ *    DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR
+ *    PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ *    TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ *    PERFORMANCE OF THIS SOFTWARE.
+ ******************************************************************************/
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <ajtcl/alljoyn.h>
+#include <ajtcl/aj_util.h>
+#include <ajtcl/aj_debug.h>
+#include <ajtcl/aj_net.h>
+
+/*
+ * Checks that application file descriptors added to the network event loop are dispatched once per
+ * edge and can be removed again, and that a wait for events can be interrupted from another thread.
+ */
+
+#define MAX_PIPES 64
+
+static int Pipes[MAX_PIPES][2];
+static uint32_t Calls;
+static uint32_t BytesRead;
+
+static void OnReadable(int fd, void* context)
+{
+    uint8_t data[4];
+    ssize_t ret;
+
+    ++Calls;
+    /*
+     * Read until the read would block
+     */
+    while ((ret = read(fd, data, sizeof(data))) > 0) {
+        BytesRead += (uint32_t)ret;
+    }
+    *((int*)context) = fd;
+}
+
+#ifndef AJ_GATEWAY
+static volatile uint8_t Interrupted;
+
+/*
+ * AJ_Net_Interrupt() only signals a thread that is blocked so keep calling it until the wait ends
+ */
+static void* InterruptThread(void* arg)
+{
+    uint32_t i;
+
+    for (i = 0; (i < 500) && !Interrupted; ++i) {
+        AJ_Sleep(10);
+        AJ_Net_Interrupt();
+    }
+    return NULL;
+}
+#endif
+
+int AJ_Main(void)
+{
+    AJ_Status status;
+    int readFd = -1;
+    uint32_t numPipes = 0;
+    uint32_t i;
+
+    AJ_Initialize();
+
+    for (i = 0; i < MAX_PIPES; ++i) {
+        if ((pipe(Pipes[i]) < 0) || (fcntl(Pipes[i][0], F_SETFL, O_NONBLOCK) < 0)) {
+            AJ_AlwaysPrintf(("pipe() failed\n"));
+            goto ErrorExit;
+        }
+    }
+    if (AJ_Net_AddFd(Pipes[0][0], OnReadable, &readFd) != AJ_OK) {
+        goto ErrorExit;
+    }
+    ++numPipes;
+    if (AJ_Net_AddFd(Pipes[0][0], OnReadable, &readFd) == AJ_OK) {
+        AJ_AlwaysPrintf(("Added the same file descriptor twice\n"));
+        goto ErrorExit;
+    }
+    if (AJ_Net_Poll(10) != AJ_ERR_TIMEOUT) {
+        AJ_AlwaysPrintf(("Event dispatched with nothing to read\n"));
+        goto ErrorExit;
+    }
+    if (write(Pipes[0][1], "0123456789", 10) != 10) {
+        goto ErrorExit;
+    }
+    status = AJ_Net_Poll(1000);
+    if ((status != AJ_OK) || (Calls != 1) || (BytesRead != 10) || (readFd != Pipes[0][0])) {
+        AJ_AlwaysPrintf(("Event not dispatched %s calls=%u read=%u\n", AJ_StatusText(status), Calls, BytesRead));
+        goto ErrorExit;
+    }
+    /*
+     * Edge-triggered so the drained pipe does not fire again
+     */
+    if (AJ_Net_Poll(10) != AJ_ERR_TIMEOUT) {
+        AJ_AlwaysPrintf(("Event dispatched twice\n"));
+        goto ErrorExit;
+    }
+#ifndef AJ_GATEWAY
+    /*
+     * A wait on this thread is interrupted from another thread. In gateway builds the event loop
+     * is per-thread so this only applies to the default build.
+     */
+    {
+        pthread_t thread;
+        AJ_Time timer;
+
+        if (pthread_create(&thread, NULL, InterruptThread, NULL) != 0) {
+            goto ErrorExit;
+        }
+        AJ_InitTimer(&timer);
+        status = AJ_Net_Poll(10000);
+        Interrupted = TRUE;
+        pthread_join(thread, NULL);
+        if ((status != AJ_ERR_INTERRUPTED) || (AJ_GetElapsedTime(&timer, TRUE) >= 5000)) {
+            AJ_AlwaysPrintf(("Wait not interrupted from another thread %s\n", AJ_StatusText(status)));
+            goto ErrorExit;
+        }
+        /*
+         * Consume any interrupt signalled after the wait ended
+         */
+        while (AJ_Net_Poll(0) == AJ_ERR_INTERRUPTED) {
+        }
+    }
+#endif
+    /*
+     * Fill the event loop then check an event on the last file descriptor is dispatched
+     */
+    while (numPipes < MAX_PIPES) {
+        status = AJ_Net_AddFd(Pipes[numPipes][0], OnReadable, &readFd);
+        if (status != AJ_OK) {
+            break;
+        }
+        ++numPipes;
+    }
+    if ((status != AJ_ERR_RESOURCES) || (numPipes < 2)) {
+        AJ_AlwaysPrintf(("Expected the event loop to fill up %s\n", AJ_StatusText(status)));
+        goto ErrorExit;
+    }
+    if (write(Pipes[numPipes - 1][1], "x", 1) != 1) {
+        goto ErrorExit;
+    }
+    if ((AJ_Net_Poll(1000) != AJ_OK) || (Calls != 2) || (readFd != Pipes[numPipes - 1][0])) {
+        AJ_AlwaysPrintf(("Event on last file descriptor not dispatched\n"));
+        goto ErrorExit;
+    }
+    /*
+     * Removed file descriptors are not dispatched
+     */
+    for (i = 0; i < numPipes; ++i) {
+        AJ_Net_RemoveFd(Pipes[i][0]);
+        if (write(Pipes[i][1], "y", 1) != 1) {
+            goto ErrorExit;
+        }
+    }
+    if ((AJ_Net_Poll(10) == AJ_OK) || (Calls != 2)) {
+        AJ_AlwaysPrintf(("Event dispatched after removal\n"));
+        goto ErrorExit;
+    }
+    for (i = 0; i < MAX_PIPES; ++i) {
+        close(Pipes[i][0]);
+        close(Pipes[i][1]);
+    }
+
+    AJ_AlwaysPrintf(("Event loop test PASSED\n"));
+    return 0;
+
+ErrorExit:
+
+    AJ_AlwaysPrintf(("Event loop test FAILED\n"));
+    return 1;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
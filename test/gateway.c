@@ -0,0 +1,215 @@
+/**
+ * @file
+ */
+/******************************************************************************
+ *    Copyright (c) Open Connectivity Foundation (OCF), AllJoyn Open Source
+ *    Project (AJOSP) Contributors and others.
+ *
+ *    SPDX-License-Identifier: Apache-2.0
+ *
+ *    All rights reserved. This program and the accompanying materials are
+ *    made available under the terms of the Apache License, Version 2.0
+ *    which accompanies this distribution, and is available at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Copyright (c) Open Connectivity Foundation and Contributors to AllSeen
+ *    Alliance. All rights reserved.
+ *
+ *    Permission to use, copy, modify, and/or distribute this software for
+ *    any purpose with or without fee is hereby granted, provided that the
+ *    above copyright notice and this permission notice appear in all
+ *    copies.
+ *
+ *    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ *    WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+ *    WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+ *    AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+ *    DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR
+ *    PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ *    TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ *    PERFORMANCE OF THIS SOFTWARE.
+ ******************************************************************************/
+
+#include <ajtcl/alljoyn.h>
+#include <ajtcl/aj_util.h>
+#include <ajtcl/aj_debug.h>
+#include <ajtcl/aj_guid.h>
+#include <ajtcl/aj_nvram.h>
+#include <ajtcl/aj_creds.h>
+
+/*
+ * Runs bus attachments on their own threads and checks that each thread sees only its own name
+ * map, objects and timers while sharing NVRAM and the credentials safely with the others.
+ */
+
+#define NUM_BUSES   4
+#define ITERATIONS  500
+
+static const char* const Interface[] = {
+    "org.example.Gateway",
+    "?Ping",
+    NULL
+};
+
+static const AJ_InterfaceDescription Interfaces[] = {
+    Interface,
+    NULL
+};
+
+static const AJ_Object Objects[NUM_BUSES][2] = {
+    { { "/gateway/0", Interfaces }, { NULL } },
+    { { "/gateway/1", Interfaces }, { NULL } },
+    { { "/gateway/2", Interfaces }, { NULL } },
+    { { "/gateway/3", Interfaces }, { NULL } }
+};
+
+static AJ_BusAttachment Buses[NUM_BUSES];
+static uint32_t Errors[NUM_BUSES];
+static uint32_t Fired[NUM_BUSES];
+
+static void OnTimer(void* context)
+{
+    ++Fired[(uintptr_t)context];
+}
+
+static void MakePeer(uint16_t n, uint32_t i, AJ_GUID* guid, uint8_t* secret)
+{
+    memset(guid, 0, sizeof(AJ_GUID));
+    guid->val[0] = (uint8_t)n;
+    guid->val[1] = (uint8_t)(i >> 8);
+    guid->val[2] = (uint8_t)i;
+    memset(secret, (uint8_t)(n + i), AJ_MASTER_SECRET_LEN);
+}
+
+static int PeerIs(uint16_t n, uint32_t i)
+{
+    AJ_GUID guid;
+    uint8_t expect[AJ_MASTER_SECRET_LEN];
+    uint8_t secret[AJ_MASTER_SECRET_LEN];
+    AJ_CredField data;
+    uint32_t expiration = 0;
+
+    MakePeer(n, i, &guid, expect);
+    data.size = sizeof(secret);
+    data.data = secret;
+    if (AJ_CredentialGetPeer(AJ_GENERIC_MASTER_SECRET, &guid, &expiration, &data) != AJ_OK) {
+        return FALSE;
+    }
+    return (expiration == i) && (memcmp(secret, expect, sizeof(secret)) == 0);
+}
+
+static void Worker(AJ_BusAttachment* bus, void* context)
+{
+    uint16_t n = (uint16_t)(bus - Buses);
+    uint16_t nvId = AJ_NVRAM_ID_APPS_BEGIN + n;
+    char name[16];
+    char other[16];
+    AJ_GUID guid;
+    AJ_GUID peer;
+    uint8_t secret[AJ_MASTER_SECRET_LEN];
+    uint32_t i;
+
+    snprintf(name, sizeof(name), ":bus%u.1", n);
+    snprintf(other, sizeof(other), ":bus%u.1", (n + 1) % NUM_BUSES);
+    memset(&guid, n, sizeof(guid));
+    AJ_RegisterObjects(Objects[n], NULL);
+    AJ_GUID_AddNameMapping(NULL, &guid, name, NULL);
+    if (!AJ_SetTimer(0, OnTimer, (void*)(uintptr_t)n, 0)) {
+        ++Errors[n];
+    }
+    for (i = 0; i < ITERATIONS; ++i) {
+        AJ_NV_DATASET* ds;
+        uint32_t val = (n << 16) | i;
+        uint32_t readBack = 0;
+        AJ_Message msg;
+        uint8_t secure;
+        uint8_t rand[16];
+
+        if (!AJ_GUID_Find(name) || AJ_GUID_Find(other)) {
+            ++Errors[n];
+        }
+        memset(&msg, 0, sizeof(msg));
+        if ((AJ_InitMessageFromMsgId(&msg, AJ_APP_MESSAGE_ID(0, 0, 0), AJ_MSG_METHOD_CALL, &secure) != AJ_OK) ||
+            (strcmp(msg.objPath, Objects[n][0].path) != 0)) {
+            ++Errors[n];
+        }
+        AJ_RandBytes(rand, sizeof(rand));
+        ds = AJ_NVRAM_Open(nvId, "w", sizeof(val));
+        if (!ds) {
+            ++Errors[n];
+            continue;
+        }
+        AJ_NVRAM_Write(&val, sizeof(val), ds);
+        AJ_NVRAM_Close(ds);
+        ds = AJ_NVRAM_Open(nvId, "r", 0);
+        if (!ds) {
+            ++Errors[n];
+            continue;
+        }
+        AJ_NVRAM_Read(&readBack, sizeof(readBack), ds);
+        AJ_NVRAM_Close(ds);
+        if (readBack != val) {
+            ++Errors[n];
+        }
+        /*
+         * Credentials created and deleted on other threads must not overwrite this thread's
+         */
+        MakePeer(n, i, &peer, secret);
+        if ((AJ_CredentialSetPeer(AJ_GENERIC_MASTER_SECRET, &peer, i, secret, sizeof(secret)) != AJ_OK) || !PeerIs(n, i)) {
+            ++Errors[n];
+        }
+        if (i) {
+            if (!PeerIs(n, i - 1)) {
+                ++Errors[n];
+            }
+            MakePeer(n, i - 1, &peer, secret);
+            AJ_CredentialDeletePeer(&peer);
+        }
+    }
+    MakePeer(n, ITERATIONS - 1, &peer, secret);
+    AJ_CredentialDeletePeer(&peer);
+    AJ_RunExpiredTimers();
+    AJ_NVRAM_Delete(nvId);
+}
+
+int AJ_Main(void)
+{
+    AJ_Status status;
+    uint16_t n;
+
+    AJ_Initialize();
+    memset(Buses, 0, sizeof(Buses));
+    status = AJ_GatewayRun(Buses, NUM_BUSES, Worker, NULL);
+    if (status != AJ_OK) {
+        AJ_AlwaysPrintf(("AJ_GatewayRun() returned %s\n", AJ_StatusText(status)));
+        goto ErrorExit;
+    }
+    for (n = 0; n < NUM_BUSES; ++n) {
+        if (Errors[n] || (Fired[n] != 1) || Buses[n].context) {
+            AJ_AlwaysPrintf(("Bus %u: errors=%u fired=%u\n", n, Errors[n], Fired[n]));
+            goto ErrorExit;
+        }
+    }
+    /*
+     * The main thread still has the default state
+     */
+    if (AJ_GUID_Find(":bus0.1")) {
+        AJ_AlwaysPrintf(("Name map leaked into the default state\n"));
+        goto ErrorExit;
+    }
+
+    AJ_AlwaysPrintf(("Gateway test PASSED\n"));
+    return 0;
+
+ErrorExit:
+
+    AJ_AlwaysPrintf(("Gateway test FAILED\n"));
+    return 1;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
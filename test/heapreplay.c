@@ -0,0 +1,634 @@
+/**
+ * @file
+ */
+/******************************************************************************
+ *    Copyright (c) Open Connectivity Foundation (OCF), AllJoyn Open Source
+ *    Project (AJOSP) Contributors and others.
+ *
+ *    SPDX-License-Identifier: Apache-2.0
+ *
+ *    All rights reserved. This program and the accompanying materials are
+ *    made available under the terms of the Apache License, Version 2.0
+ *    which accompanies this distribution, and is available at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Copyright (c) Open Connectivity Foundation and Contributors to AllSeen
+ *    Alliance. All rights reserved.
+ *
+ *    Permission to use, copy, modify, and/or distribute this software for
+ *    any purpose with or without fee is hereby granted, provided that the
+ *    above copyright notice and this permission notice appear in all
+ *    copies.
+ *
+ *    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ *    WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+ *    WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+ *    AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+ *    DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR
+ *    PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ *    TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ *    PERFORMANCE OF THIS SOFTWARE.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <ajtcl/alljoyn.h>
+#include <ajtcl/aj_debug.h>
+#include "aj_malloc.h"
+
+/*
+ * Replays a heap trace recorded by setting AJ_MALLOC_TRACE (see AJ_Malloc() in the linux target)
+ * and suggests the pool configuration that serves the trace with the least memory, then replays the
+ * trace through the pool allocator with that configuration to check it.
+ *
+ *     heapreplay [<trace file> [<max pools>]]
+ *
+ * Without a trace file a synthetic trace is replayed and, if AJ_POOL_STATS is set, the
+ * pool allocator counters are checked.
+ */
+
+#define MAX_CLASSES  64
+#define TRACE_FILE   "heapreplay.trace"
+
+typedef struct {
+    uint32_t id;      /* Allocation the event applies to */
+    uint32_t size;    /* Size of the allocation */
+    uint8_t alloc;    /* TRUE for an allocation, FALSE for a free */
+} Event;
+
+static Event* events;
+static size_t numEvents;
+static uint32_t numIds;
+
+/*
+ * Maps the addresses in the trace to the allocations that are live at them
+ */
+typedef struct {
+    uint64_t addr;    /* 0 if the slot is free, ~0 if the allocation was freed */
+    uint32_t id;
+    uint32_t size;
+} Live;
+
+static Live* liveMap;
+static size_t liveCap;
+static size_t liveUsed;
+
+#define LIVE_FREED ((uint64_t)-1)
+
+static Live* LiveFind(uint64_t addr)
+{
+    size_t i = (size_t)((addr >> 3) * 2654435761u) & (liveCap - 1);
+
+    while (liveCap && liveMap[i].addr) {
+        if (liveMap[i].addr == addr) {
+            return &liveMap[i];
+        }
+        i = (i + 1) & (liveCap - 1);
+    }
+    return NULL;
+}
+
+static void LiveAdd(uint64_t addr, uint32_t id, uint32_t size)
+{
+    size_t i;
+
+    if (2 * (liveUsed + 1) > liveCap) {
+        Live* old = liveMap;
+        size_t oldCap = liveCap;
+
+        liveCap = liveCap ? 2 * liveCap : 1024;
+        liveMap = (Live*)calloc(liveCap, sizeof(Live));
+        liveUsed = 0;
+        for (i = 0; i < oldCap; ++i) {
+            if (old[i].addr && (old[i].addr != LIVE_FREED)) {
+                LiveAdd(old[i].addr, old[i].id, old[i].size);
+            }
+        }
+        free(old);
+    }
+    i = (size_t)((addr >> 3) * 2654435761u) & (liveCap - 1);
+    while (liveMap[i].addr && (liveMap[i].addr != LIVE_FREED)) {
+        i = (i + 1) & (liveCap - 1);
+    }
+    liveUsed += (liveMap[i].addr == 0);
+    liveMap[i].addr = addr;
+    liveMap[i].id = id;
+    liveMap[i].size = size;
+}
+
+static void AddEvent(uint32_t id, uint32_t size, uint8_t alloc)
+{
+    static size_t maxEvents;
+
+    if (numEvents == maxEvents) {
+        maxEvents = maxEvents ? 2 * maxEvents : 4096;
+        events = (Event*)realloc(events, maxEvents * sizeof(Event));
+    }
+    events[numEvents].id = id;
+    events[numEvents].size = size;
+    events[numEvents].alloc = alloc;
+    ++numEvents;
+}
+
+static void TraceAlloc(uint64_t addr, uint32_t size)
+{
+    if (addr) {
+        Live* live = LiveFind(addr);
+        if (live) {
+            /* Freed outside the trace */
+            live->addr = LIVE_FREED;
+        }
+        AddEvent(numIds, size, TRUE);
+        LiveAdd(addr, numIds++, size);
+    }
+}
+
+static void TraceFree(uint64_t addr)
+{
+    Live* live = addr ? LiveFind(addr) : NULL;
+
+    if (live) {
+        AddEvent(live->id, live->size, FALSE);
+        live->addr = LIVE_FREED;
+    }
+}
+
+static AJ_Status LoadTrace(const char* name)
+{
+    FILE* f = fopen(name, "r");
+    char line[128];
+    char op;
+    char a[40];
+    char b[40];
+    unsigned size;
+
+    if (!f) {
+        AJ_AlwaysPrintf(("Cannot open %s\n", name));
+        return AJ_ERR_READ;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        if ((sscanf(line, "%c %39s %39s %u", &op, a, b, &size) == 4) && (op == 'r')) {
+            uint64_t from = strtoull(a, NULL, 16);
+            uint64_t to = strtoull(b, NULL, 16);
+
+            if (to == from) {
+                TraceFree(from);
+                TraceAlloc(to, size);
+            } else if (to) {
+                /*
+                 * Moving the contents needs the old and new blocks at the same time
+                 */
+                TraceAlloc(to, size);
+                TraceFree(from);
+            } else if (!size) {
+                TraceFree(from);
+            }
+        } else if ((sscanf(line, "%c %39s %u", &op, a, &size) == 3) && (op == 'a')) {
+            TraceAlloc(strtoull(a, NULL, 16), size);
+        } else if ((sscanf(line, "%c %39s", &op, a) == 2) && (op == 'f')) {
+            TraceFree(strtoull(a, NULL, 16));
+        }
+    }
+    fclose(f);
+    AJ_AlwaysPrintf(("%s: %u allocations, %u events\n", name, numIds, (unsigned)numEvents));
+    return numIds ? AJ_OK : AJ_ERR_READ;
+}
+
+/*
+ * Writes a synthetic trace shaped like a bus attachment: many small short lived allocations, a
+ * steady population of mid sized ones and a few large buffers that are grown with realloc.
+ */
+static void WriteSyntheticTrace(const char* name)
+{
+    static const uint16_t sizes[] = { 8, 12, 20, 24, 40, 44, 64, 100, 128, 300, 512, 1400 };
+    uint32_t addr[64];
+    uint32_t size[64];
+    uint32_t seed = 12345;
+    uint32_t i;
+    FILE* f = fopen(name, "w");
+
+    if (!f) {
+        return;
+    }
+    memset(addr, 0, sizeof(addr));
+    for (i = 0; i < 40000; ++i) {
+        uint32_t r;
+        uint32_t slot;
+
+        seed = seed * 1103515245 + 12345;
+        r = seed >> 8;
+        slot = (r % 64) & ((r & 0x100) ? 0x3F : 0x0F);
+        if (!addr[slot]) {
+            addr[slot] = 0x10000 + slot * 0x1000;
+            size[slot] = sizes[(r >> 12) % (slot < 16 ? 6 : ArraySize(sizes))] - ((r >> 20) & 3);
+            fprintf(f, "a 0x%x %u\n", addr[slot], size[slot]);
+        } else if ((slot > 48) && (size[slot] < 1024) && ((r >> 16) & 1)) {
+            uint32_t moved = addr[slot] ^ 0x800;
+            size[slot] *= 2;
+            fprintf(f, "r 0x%x 0x%x %u\n", addr[slot], moved, size[slot]);
+            addr[slot] = moved;
+        } else {
+            fprintf(f, "f 0x%x\n", addr[slot]);
+            addr[slot] = 0;
+        }
+    }
+    fclose(f);
+}
+
+static uint16_t classSize[MAX_CLASSES];
+static uint16_t numClasses;
+
+static uint16_t RoundSize(uint32_t size, uint32_t granularity)
+{
+    size = (size + granularity - 1) & ~(granularity - 1);
+    return (uint16_t)(size ? size : granularity);
+}
+
+static uint16_t ClassOf(uint32_t size)
+{
+    uint16_t lo = 0;
+    uint16_t hi = numClasses - 1;
+
+    while (lo < hi) {
+        uint16_t mid = (lo + hi) / 2;
+        if (classSize[mid] < size) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/*
+ * Memory taken by one pool entry, see AJ_PoolRequired()
+ */
+static size_t BlockSize(uint16_t size)
+{
+    return size + AJ_HEAP_POOL_ROUNDING - (size & (AJ_HEAP_POOL_ROUNDING - 1));
+}
+
+static AJ_Status SuggestConfig(uint8_t maxPools, AJ_HeapConfig** config, uint8_t* numPools)
+{
+    static const AJ_HeapConfig onePool[] = { { AJ_HEAP_POOL_ROUNDING, 0, 0 }, { AJ_HEAP_POOL_ROUNDING, 0, 0 } };
+    uint32_t granularity = AJ_HEAP_POOL_ROUNDING;
+    size_t poolOverhead = AJ_PoolRequired(onePool, 2) - AJ_PoolRequired(onePool, 1);
+    uint16_t* evClass;
+    uint32_t* peak;
+    size_t* best;
+    uint16_t* from;
+    size_t e;
+    uint16_t a;
+    uint16_t b;
+    uint16_t k;
+    uint16_t n;
+
+    /*
+     * The size classes are the distinct request sizes rounded to the pool granularity, coarsened
+     * until there are no more than MAX_CLASSES
+     */
+    for (;;) {
+        numClasses = 0;
+        for (e = 0; e < numEvents; ++e) {
+            uint32_t sz = RoundSize(events[e].size, granularity);
+            uint16_t c;
+
+            if (sz > 0xFFF0) {
+                AJ_AlwaysPrintf(("Allocation of %u bytes is too big for the pool allocator\n", events[e].size));
+                return AJ_ERR_RANGE;
+            }
+            if (numClasses && (classSize[ClassOf(sz)] == sz)) {
+                continue;
+            }
+            if (numClasses == MAX_CLASSES) {
+                break;
+            }
+            for (c = numClasses++; c && (classSize[c - 1] > sz); --c) {
+                classSize[c] = classSize[c - 1];
+            }
+            classSize[c] = (uint16_t)sz;
+        }
+        if (e == numEvents) {
+            break;
+        }
+        granularity *= 2;
+    }
+    if (maxPools > numClasses) {
+        maxPools = (uint8_t)numClasses;
+    }
+
+    /*
+     * peak[a * numClasses + b] is the most allocations in classes a..b live at once
+     */
+    evClass = (uint16_t*)malloc(numEvents * sizeof(uint16_t));
+    peak = (uint32_t*)calloc(numClasses * numClasses, sizeof(uint32_t));
+    best = (size_t*)malloc((maxPools + 1) * (numClasses + 1) * sizeof(size_t));
+    from = (uint16_t*)malloc((maxPools + 1) * (numClasses + 1) * sizeof(uint16_t));
+    for (e = 0; e < numEvents; ++e) {
+        evClass[e] = ClassOf(RoundSize(events[e].size, granularity));
+    }
+    for (a = 0; a < numClasses; ++a) {
+        for (b = a; b < numClasses; ++b) {
+            uint32_t live = 0;
+            uint32_t hwm = 0;
+
+            for (e = 0; e < numEvents; ++e) {
+                if ((evClass[e] >= a) && (evClass[e] <= b)) {
+                    if (events[e].alloc) {
+                        ++live;
+                        hwm = max(hwm, live);
+                    } else {
+                        --live;
+                    }
+                }
+            }
+            peak[a * numClasses + b] = hwm;
+        }
+    }
+
+    /*
+     * best[k][b] is the least memory that serves classes 0..b-1 with k pools, each pool serving a
+     * contiguous range of classes without borrowing
+     */
+#define BEST(k, b) best[(k) * (numClasses + 1) + (b)]
+#define FROM(k, b) from[(k) * (numClasses + 1) + (b)]
+    for (k = 0; k <= maxPools; ++k) {
+        for (b = 0; b <= numClasses; ++b) {
+            BEST(k, b) = ((b == 0) && (k == 0)) ? 0 : (size_t)-1;
+        }
+    }
+    for (k = 1; k <= maxPools; ++k) {
+        for (b = 1; b <= numClasses; ++b) {
+            for (a = k - 1; a < b; ++a) {
+                size_t cost;
+
+                if (BEST(k - 1, a) == (size_t)-1) {
+                    continue;
+                }
+                cost = BEST(k - 1, a) + BlockSize(classSize[b - 1]) * peak[a * numClasses + b - 1] + poolOverhead;
+                if (cost < BEST(k, b)) {
+                    BEST(k, b) = cost;
+                    FROM(k, b) = a;
+                }
+            }
+        }
+    }
+    n = 1;
+    for (k = 2; k <= maxPools; ++k) {
+        if (BEST(k, numClasses) < BEST(n, numClasses)) {
+            n = k;
+        }
+    }
+
+    /*
+     * Walk back through the choices to build the configuration
+     */
+    *numPools = (uint8_t)n;
+    *config = (AJ_HeapConfig*)malloc(n * sizeof(AJ_HeapConfig));
+    for (b = numClasses, k = n; k > 0; --k) {
+        a = FROM(k, b);
+        {
+            AJ_HeapConfig pool = { classSize[b - 1], (uint16_t)peak[a * numClasses + b - 1], 0 };
+            memcpy(&(*config)[k - 1], &pool, sizeof(pool));
+        }
+        b = a;
+    }
+#undef BEST
+#undef FROM
+    free(evClass);
+    free(peak);
+    free(best);
+    free(from);
+    return AJ_OK;
+}
+
+/*
+ * Replays the trace through the pool allocator and returns the number of failed allocations, or
+ * just whether an allocation failed if not verbose
+ */
+static uint32_t Replay(const AJ_HeapConfig* config, uint8_t numPools, uint8_t verbose)
+{
+    size_t heapSz = AJ_PoolRequired(config, numPools);
+    void* heap = malloc(heapSz);
+    void** mem = (void**)calloc(numIds, sizeof(void*));
+    uint32_t failures = 0;
+#if AJ_POOL_STATS
+    AJ_PoolStats stats;
+    uint8_t i;
+#endif
+    size_t e;
+
+    if (AJ_PoolInit(heap, heapSz, config, numPools) != AJ_OK) {
+        return numIds;
+    }
+    for (e = 0; e < numEvents; ++e) {
+        if (events[e].alloc) {
+            mem[events[e].id] = AJ_PoolAlloc(events[e].size);
+            if (!mem[events[e].id]) {
+                ++failures;
+                if (!verbose) {
+                    /* Only need to know if the configuration fails */
+                    break;
+                }
+            }
+        } else {
+            AJ_PoolFree(mem[events[e].id]);
+            mem[events[e].id] = NULL;
+        }
+    }
+#if AJ_POOL_STATS
+    for (i = 0; verbose && (i < numPools); ++i) {
+        AJ_PoolGetStats(i, &stats);
+        AJ_AlwaysPrintf(("pool[%u] entries=%u high-water=%u max-alloc=%u allocs=%u failures=%u borrows=%u\n",
+                         stats.size, stats.entries, stats.hwm, stats.max, stats.allocs, stats.failures, stats.borrows));
+    }
+#endif
+    AJ_PoolTerminate(heap);
+    free(mem);
+    free(heap);
+    return failures;
+}
+
+#if AJ_POOL_STATS
+static const AJ_HeapConfig testPools[] = {
+    { 16, 2, AJ_POOL_BORROW },
+    { 32, 1 },
+    { 64, 1 }
+};
+
+static const AJ_HeapConfig oddPools[] = {
+    { 10, 1 },
+    { 11, 1 },
+    { 12, 1 },
+    { 20, 1 }
+};
+
+static uint8_t StatsAre(uint8_t pool, uint16_t use, uint16_t hwm, uint32_t allocs, uint32_t failures, uint32_t borrows)
+{
+    AJ_PoolStats stats;
+
+    if (AJ_PoolGetStats(pool, &stats) != AJ_OK) {
+        return FALSE;
+    }
+    return (stats.use == use) && (stats.hwm == hwm) && (stats.allocs == allocs) && (stats.failures == failures) && (stats.borrows == borrows);
+}
+
+static AJ_Status CheckCounters(void)
+{
+    static uint32_t heap[256];
+    void* a1;
+    void* a2;
+    void* a3;
+    void* a4;
+
+    if (AJ_PoolInit(heap, sizeof(heap), testPools, ArraySize(testPools)) != AJ_OK) {
+        return AJ_ERR_RESOURCES;
+    }
+    a1 = AJ_PoolAlloc(10);
+    a2 = AJ_PoolAlloc(16);
+    a3 = AJ_PoolAlloc(12);     /* Borrowed from the 32 byte pool */
+    a4 = AJ_PoolAlloc(8);      /* Both pools exhausted */
+    if (!a1 || !a2 || !a3 || a4 || AJ_PoolAlloc(100) || !StatsAre(0, 2, 2, 2, 1, 1) || !StatsAre(1, 1, 1, 1, 0, 0) || !StatsAre(2, 0, 0, 0, 1, 0)) {
+        AJ_AlwaysPrintf(("Allocation counters are wrong\n"));
+        return AJ_ERR_FAILURE;
+    }
+    a1 = AJ_PoolRealloc(a1, 40);
+    AJ_PoolFree(a2);
+    AJ_PoolFree(a3);
+    a4 = AJ_PoolAlloc(30);
+    if (!a1 || !a4 || (a4 != a3) || !StatsAre(0, 0, 2, 2, 1, 1) || !StatsAre(1, 1, 1, 2, 0, 0) || !StatsAre(2, 1, 1, 1, 1, 0)) {
+        AJ_AlwaysPrintf(("Blocks were not returned to their pools\n"));
+        return AJ_ERR_FAILURE;
+    }
+    AJ_PoolFree(a1);
+    AJ_PoolFree(a4);
+    AJ_PoolResetStats();
+    if (!StatsAre(0, 0, 0, 0, 0, 0) || !StatsAre(1, 0, 0, 0, 0, 0) || !StatsAre(2, 0, 0, 0, 0, 0)) {
+        AJ_AlwaysPrintf(("Resetting the counters failed\n"));
+        return AJ_ERR_FAILURE;
+    }
+    AJ_PoolTerminate(heap);
+
+    /*
+     * Pool sizes that are not multiples of AJ_HEAP_POOL_ROUNDING
+     */
+    if (AJ_PoolInit(heap, sizeof(heap), oddPools, ArraySize(oddPools)) != AJ_OK) {
+        return AJ_ERR_RESOURCES;
+    }
+    a1 = AJ_PoolAlloc(11);
+    a2 = AJ_PoolAlloc(12);
+    a3 = AJ_PoolAlloc(9);
+    if (!a1 || !a2 || !a3 || !StatsAre(0, 1, 1, 1, 0, 0) || !StatsAre(1, 1, 1, 1, 0, 0) || !StatsAre(2, 1, 1, 1, 0, 0)) {
+        AJ_AlwaysPrintf(("Wrong pool selected\n"));
+        return AJ_ERR_FAILURE;
+    }
+    AJ_PoolFree(a1);
+    AJ_PoolFree(a2);
+    AJ_PoolFree(a3);
+    AJ_PoolTerminate(heap);
+    return AJ_OK;
+}
+#endif
+
+#ifdef MAIN_ALLOWS_ARGS
+int AJ_Main(int argc, char** argv)
+#else
+int AJ_Main(void)
+#endif
+{
+    AJ_Status status;
+    AJ_HeapConfig* config = NULL;
+    uint8_t numPools = 0;
+    uint8_t maxPools = 16;
+    const char* trace = NULL;
+    AJ_Time timer;
+    uint32_t failures;
+    uint8_t i;
+
+#ifdef MAIN_ALLOWS_ARGS
+    if (argc > 1) {
+        trace = argv[1];
+    }
+    if (argc > 2) {
+        maxPools = (uint8_t)atoi(argv[2]);
+    }
+#endif
+    if (!trace) {
+#if AJ_POOL_STATS
+        status = CheckCounters();
+        if (status != AJ_OK) {
+            goto ErrorExit;
+        }
+#endif
+        WriteSyntheticTrace(TRACE_FILE);
+    }
+    status = LoadTrace(trace ? trace : TRACE_FILE);
+    if (status != AJ_OK) {
+        goto ErrorExit;
+    }
+    AJ_InitTimer(&timer);
+    status = SuggestConfig(maxPools ? maxPools : 1, &config, &numPools);
+    if (status != AJ_OK) {
+        goto ErrorExit;
+    }
+    AJ_AlwaysPrintf(("Suggested configuration (%u ms)\n", AJ_GetElapsedTime(&timer, TRUE)));
+    AJ_AlwaysPrintf(("static const AJ_HeapConfig heapConfig[] = {\n"));
+    for (i = 0; i < numPools; ++i) {
+        AJ_AlwaysPrintf(("    { %5u, %5u }%s\n", config[i].size, config[i].entries, (i + 1 < numPools) ? "," : ""));
+    }
+    AJ_AlwaysPrintf(("};\n"));
+    AJ_AlwaysPrintf(("AJ_PoolRequired() = %u bytes\n", (unsigned)AJ_PoolRequired(config, numPools)));
+
+    failures = Replay(config, numPools, TRUE);
+    if (failures) {
+        AJ_AlwaysPrintf(("%u allocations failed\n", failures));
+        status = AJ_ERR_RESOURCES;
+        goto ErrorExit;
+    }
+    if (!trace) {
+        /*
+         * One entry fewer in any pool must make the trace fail
+         */
+        for (i = 0; i < numPools; ++i) {
+            AJ_HeapConfig pool = { config[i].size, config[i].entries, 0 };
+            AJ_HeapConfig smaller = { config[i].size, (uint16_t)(config[i].entries - 1), 0 };
+
+            memcpy(&config[i], &smaller, sizeof(smaller));
+            failures = Replay(config, numPools, FALSE);
+            memcpy(&config[i], &pool, sizeof(pool));
+            if (!failures) {
+                AJ_AlwaysPrintf(("Pool %u is bigger than it needs to be\n", config[i].size));
+                status = AJ_ERR_FAILURE;
+                goto ErrorExit;
+            }
+        }
+        remove(TRACE_FILE);
+    }
+
+    free(config);
+    AJ_AlwaysPrintf(("Heap replay test PASSED\n"));
+    return 0;
+
+ErrorExit:
+    free(config);
+    if (!trace) {
+        remove(TRACE_FILE);
+    }
+    AJ_AlwaysPrintf(("Heap replay test FAILED\n"));
+    return 1;
+}
+
+#ifdef AJ_MAIN
+#ifdef MAIN_ALLOWS_ARGS
+int main(int argc, char** argv)
+{
+    return AJ_Main(argc, argv);
+}
+#else
+int main()
+{
+    return AJ_Main();
+}
+#endif
+#endif
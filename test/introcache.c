@@ -0,0 +1,324 @@
+/**
+ * @file
+ */
+/******************************************************************************
+ *    Copyright (c) Open Connectivity Foundation (OCF), AllJoyn Open Source
+ *    Project (AJOSP) Contributors and others.
+ *
+ *    SPDX-License-Identifier: Apache-2.0
+ *
+ *    All rights reserved. This program and the accompanying materials are
+ *    made available under the terms of the Apache License, Version 2.0
+ *    which accompanies this distribution, and is available at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Copyright (c) Open Connectivity Foundation and Contributors to AllSeen
+ *    Alliance. All rights reserved.
+ *
+ *    Permission to use, copy, modify, and/or distribute this software for
+ *    any purpose with or without fee is hereby granted, provided that the
+ *    above copyright notice and this permission notice appear in all
+ *    copies.
+ *
+ *    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ *    WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+ *    WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+ *    AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+ *    DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR
+ *    PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ *    TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ *    PERFORMANCE OF THIS SOFTWARE.
+ ******************************************************************************/
+
+#include <ajtcl/alljoyn.h>
+#include <ajtcl/aj_util.h>
+#include <ajtcl/aj_debug.h>
+#include <ajtcl/aj_bufio.h>
+
+/*
+ * Checks that introspection replies served from the introspection cache are the same as ones
+ * generated from scratch, that the cache is flushed when the objects, the object flags, or the
+ * description languages change, and measures how much a cached reply saves.
+ */
+
+#define WIRE_SIZE   8192
+#define BENCH_LOOPS 10000
+
+static uint8_t Wire[WIRE_SIZE];
+static size_t WireBytes;
+
+static uint8_t TxBuffer[WIRE_SIZE];
+
+static uint32_t LookupCalls;
+static const char* Greeting = "Hello";
+
+static const char* const testInterface[] = {
+    "org.alljoyn.test.introspect",
+    "?Ping str<s reply>s",
+    "!Chirp >s",
+    "@Level=u",
+    NULL
+};
+
+static const AJ_InterfaceDescription testInterfaces[] = {
+    testInterface,
+    NULL
+};
+
+static AJ_Object AppObjects[] = {
+    { "/test", testInterfaces },
+    { "/test/child", testInterfaces },
+    { "/test/other", testInterfaces },
+    { "/virtual/leaf", testInterfaces },
+    { NULL }
+};
+
+static const char* const Languages[] = { "en", "fr", NULL };
+static const char* const French[] = { "fr", NULL };
+
+/*
+ * Unified format introspection of /test/other with the descriptions from Lookup()
+ */
+static const char ExpectOther[] =
+    "<!DOCTYPE node PUBLIC \"-//allseen//DTD ALLJOYN Object Introspection 1.1//EN\"\n"
+    "\"http://www.allseen.org/alljoyn/introspect-1.1.dtd\">\n"
+    "<node name=\"/test/other\">\n"
+    "<annotation name=\"org.alljoyn.Bus.DocString.en\" value=\"Hello\"/>\n"
+    "<annotation name=\"org.alljoyn.Bus.DocString.fr\" value=\"Bonjour\"/>\n"
+    "<interface name=\"org.alljoyn.test.introspect\">\n"
+    "  <method name=\"Ping\">\n"
+    "    <arg name=\"str\" type=\"s\" direction=\"in\"/>\n"
+    "    <arg name=\"reply\" type=\"s\" direction=\"out\"/>\n"
+    "  </method>\n"
+    "  <signal name=\"Chirp\">\n"
+    "    <arg type=\"s\"/>\n"
+    "  </signal>\n"
+    "  <property name=\"Level\" type=\"u\" access=\"readwrite\"/>\n"
+    "</interface>\n"
+    "</node>\n";
+
+static const char* Lookup(uint32_t descId, const char* lang)
+{
+    ++LookupCalls;
+    if (descId == AJ_DESCRIPTION_ID(2, 0, 0, 0)) {
+        if (lang && (strcmp(lang, "fr") == 0)) {
+            return "Bonjour";
+        }
+        return Greeting;
+    }
+    return NULL;
+}
+
+static AJ_Status TxFunc(AJ_IOBuffer* buf)
+{
+    size_t tx = AJ_IO_BUF_AVAIL(buf);
+
+    if ((WireBytes + tx) > sizeof(Wire)) {
+        return AJ_ERR_WRITE;
+    }
+    memcpy(Wire + WireBytes, buf->readPtr, tx);
+    WireBytes += tx;
+    AJ_IO_BUF_RESET(buf);
+    return AJ_OK;
+}
+
+/*
+ * Handles an introspection request for an object path and leaves the reply on the wire. A NULL
+ * language requests the unified format.
+ */
+static AJ_Status Introspect(AJ_BusAttachment* bus, const char* path, const char* language)
+{
+    AJ_Status status;
+    AJ_MsgHeader hdr;
+    AJ_Message call;
+    AJ_Message reply;
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.msgType = AJ_MSG_METHOD_CALL;
+    hdr.serialNum = 1;
+    memset(&call, 0, sizeof(call));
+    call.hdr = &hdr;
+    call.bus = bus;
+    call.sender = ":test.2";
+    call.objPath = path;
+    if (language) {
+        call.msgId = AJ_METHOD_INTROSPECT_WITH_DESC;
+        status = AJ_HandleIntrospectRequest(&call, &reply, language);
+    } else {
+        call.msgId = AJ_METHOD_INTROSPECT;
+        status = AJ_GetIntrospectionData(&call, &reply);
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&reply);
+    }
+    return status;
+}
+
+/*
+ * Introspects an object and copies the XML from the body of the reply into xml
+ */
+static AJ_Status GetXML(AJ_BusAttachment* bus, const char* path, const char* language, char* xml)
+{
+    AJ_Status status;
+    uint32_t bodyLen;
+
+    AJ_IOBufInit(&bus->sock.tx, TxBuffer, sizeof(TxBuffer), AJ_IO_BUF_TX, NULL);
+    bus->sock.tx.send = TxFunc;
+    WireBytes = 0;
+    status = Introspect(bus, path, language);
+    if (status != AJ_OK) {
+        return status;
+    }
+    /*
+     * The body is a single string, a 4 byte length followed by the NUL terminated XML
+     */
+    memcpy(&bodyLen, Wire + 4, 4);
+    if ((Wire[1] != AJ_MSG_METHOD_RET) || (bodyLen < 5) || (bodyLen > WireBytes)) {
+        return AJ_ERR_UNMARSHAL;
+    }
+    memcpy(xml, Wire + WireBytes - bodyLen + 4, bodyLen - 4);
+    return AJ_OK;
+}
+
+int AJ_Main(void)
+{
+    static const char* const paths[] = { "/test", "/test/child", "/test/other", "/virtual" };
+    static const char* const languages[] = { NULL, "en", "fr-CA", "de" };
+    static char first[ArraySize(paths) * ArraySize(languages)][2048];
+    static char xml[WIRE_SIZE];
+    AJ_Status status;
+    AJ_BusAttachment bus;
+    AJ_Time timer;
+    uint32_t cached;
+    uint32_t uncached;
+    uint32_t calls;
+    size_t p;
+    size_t l;
+    uint32_t i;
+
+    AJ_Initialize();
+    memset(&bus, 0, sizeof(bus));
+    strcpy(bus.uniqueName, ":test.1");
+    AJ_RegisterObjectListWithDescriptions(AppObjects, 1, Lookup);
+    AJ_RegisterDescriptionLanguages(Languages);
+
+    status = GetXML(&bus, "/test/other", NULL, xml);
+    if ((status != AJ_OK) || (strcmp(xml, ExpectOther) != 0)) {
+        AJ_AlwaysPrintf(("Unexpected XML for /test/other %s\n%s", AJ_StatusText(status), xml));
+        goto ErrorExit;
+    }
+
+    /*
+     * Introspecting the same object in the same language again gives the same XML without any
+     * description lookups. There are more combinations than cache entries so some are evicted.
+     */
+    for (p = 0; p < ArraySize(paths); ++p) {
+        for (l = 0; l < ArraySize(languages); ++l) {
+            char* saved = first[p * ArraySize(languages) + l];
+            status = GetXML(&bus, paths[p], languages[l], saved);
+            if (status == AJ_OK) {
+                calls = LookupCalls;
+                status = GetXML(&bus, paths[p], languages[l], xml);
+            }
+            if ((status != AJ_OK) || (strcmp(xml, saved) != 0)) {
+                AJ_AlwaysPrintf(("Repeated introspection of %s differs %s\n", paths[p], AJ_StatusText(status)));
+                goto ErrorExit;
+            }
+#if AJ_INTROSPECT_CACHE_SIZE
+            if (LookupCalls != calls) {
+                AJ_AlwaysPrintf(("Introspection of %s not cached\n", paths[p]));
+                goto ErrorExit;
+            }
+#endif
+        }
+    }
+    for (p = 0; p < ArraySize(paths); ++p) {
+        for (l = 0; l < ArraySize(languages); ++l) {
+            status = GetXML(&bus, paths[p], languages[l], xml);
+            if ((status != AJ_OK) || (strcmp(xml, first[p * ArraySize(languages) + l]) != 0)) {
+                AJ_AlwaysPrintf(("Introspection of %s differs after eviction %s\n", paths[p], AJ_StatusText(status)));
+                goto ErrorExit;
+            }
+        }
+    }
+    if (!strstr(first[ArraySize(languages) * 2 + 2], "Bonjour") || !strstr(first[ArraySize(languages) * 2 + 3], "Hello")) {
+        AJ_AlwaysPrintf(("Wrong description language\n"));
+        goto ErrorExit;
+    }
+
+    /*
+     * Descriptions that change over time need an explicit invalidation
+     */
+    Greeting = "Hi";
+#if AJ_INTROSPECT_CACHE_SIZE
+    status = GetXML(&bus, "/test/other", NULL, xml);
+    if ((status != AJ_OK) || (strcmp(xml, ExpectOther) != 0)) {
+        AJ_AlwaysPrintf(("Cached XML for /test/other differs\n"));
+        goto ErrorExit;
+    }
+#endif
+    AJ_IntrospectInvalidateCache();
+    status = GetXML(&bus, "/test/other", NULL, xml);
+    if ((status != AJ_OK) || !strstr(xml, "\"Hi\"")) {
+        AJ_AlwaysPrintf(("XML for /test/other not regenerated after invalidating\n"));
+        goto ErrorExit;
+    }
+    Greeting = "Hello";
+    AJ_IntrospectInvalidateCache();
+
+    /*
+     * Hiding an object or changing the description languages flushes the cache
+     */
+    AJ_SetObjectFlags("/test/child", AJ_OBJ_FLAG_HIDDEN, 0);
+    status = GetXML(&bus, "/test", NULL, xml);
+    if ((status != AJ_OK) || strstr(xml, "child")) {
+        AJ_AlwaysPrintf(("XML for /test not regenerated after hiding a child\n"));
+        goto ErrorExit;
+    }
+    AJ_SetObjectFlags("/test/child", 0, AJ_OBJ_FLAG_HIDDEN);
+    status = GetXML(&bus, "/test", NULL, xml);
+    if ((status != AJ_OK) || (strcmp(xml, first[0]) != 0)) {
+        AJ_AlwaysPrintf(("XML for /test not restored after showing a child\n"));
+        goto ErrorExit;
+    }
+    AJ_RegisterDescriptionLanguages(French);
+    status = GetXML(&bus, "/test/other", "en", xml);
+    if ((status != AJ_OK) || !strstr(xml, "Bonjour")) {
+        AJ_AlwaysPrintf(("XML for /test/other not regenerated after changing languages\n"));
+        goto ErrorExit;
+    }
+    AJ_RegisterDescriptionLanguages(Languages);
+
+    /*
+     * Cost of introspecting an object tree with and without the cache
+     */
+    GetXML(&bus, "/test", "en", xml);
+    AJ_InitTimer(&timer);
+    for (i = 0; i < BENCH_LOOPS; ++i) {
+        GetXML(&bus, "/test", "en", xml);
+    }
+    cached = AJ_GetElapsedTime(&timer, TRUE);
+    AJ_InitTimer(&timer);
+    for (i = 0; i < BENCH_LOOPS; ++i) {
+        AJ_IntrospectInvalidateCache();
+        GetXML(&bus, "/test", "en", xml);
+    }
+    uncached = AJ_GetElapsedTime(&timer, TRUE);
+    AJ_AlwaysPrintf(("%u introspections: %u ms cached, %u ms generated\n", BENCH_LOOPS, cached, uncached));
+
+    AJ_RegisterObjectListWithDescriptions(NULL, 1, NULL);
+    AJ_AlwaysPrintf(("Introspection cache test PASSED\n"));
+    return 0;
+
+ErrorExit:
+
+    AJ_AlwaysPrintf(("Introspection cache test FAILED\n"));
+    return 1;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
@@ -0,0 +1,258 @@
+/**
+ * @file
+ */
+/******************************************************************************
+ *    Copyright (c) Open Connectivity Foundation (OCF), AllJoyn Open Source
+ *    Project (AJOSP) Contributors and others.
+ *
+ *    SPDX-License-Identifier: Apache-2.0
+ *
+ *    All rights reserved. This program and the accompanying materials are
+ *    made available under the terms of the Apache License, Version 2.0
+ *    which accompanies this distribution, and is available at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Copyright (c) Open Connectivity Foundation and Contributors to AllSeen
+ *    Alliance. All rights reserved.
+ *
+ *    Permission to use, copy, modify, and/or distribute this software for
+ *    any purpose with or without fee is hereby granted, provided that the
+ *    above copyright notice and this permission notice appear in all
+ *    copies.
+ *
+ *    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ *    WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+ *    WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+ *    AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+ *    DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR
+ *    PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ *    TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ *    PERFORMANCE OF THIS SOFTWARE.
+ ******************************************************************************/
+
+#include <ajtcl/alljoyn.h>
+#include <ajtcl/aj_util.h>
+#include <ajtcl/aj_debug.h>
+#include <ajtcl/aj_bufio.h>
+#include <ajtcl/aj_guid.h>
+
+/*
+ * Checks that messages with arrays marshaled by reference are sent byte for byte the same as
+ * messages with the arrays copied into a large transmit buffer, with and without a gathering send
+ * function and with and without encryption.
+ */
+
+#define WIRE_SIZE (32 * 1024)
+
+static uint8_t Wire[WIRE_SIZE];
+static size_t WireBytes;
+static uint8_t Expect[WIRE_SIZE];
+static size_t ExpectBytes;
+
+static uint8_t BigTxBuffer[WIRE_SIZE];
+static uint8_t SmallTxBuffer[512];
+
+static uint8_t Blob8[6001];
+static uint16_t Blob16[1501];
+static double Doubles[300];
+
+static const char* const Destination = ":dest.1";
+
+static AJ_Status TxFunc(AJ_IOBuffer* buf)
+{
+    size_t tx = AJ_IO_BUF_AVAIL(buf);
+
+    if ((WireBytes + tx) > sizeof(Wire)) {
+        return AJ_ERR_WRITE;
+    }
+    memcpy(Wire + WireBytes, buf->readPtr, tx);
+    WireBytes += tx;
+    AJ_IO_BUF_RESET(buf);
+    return AJ_OK;
+}
+
+static AJ_Status TxvFunc(AJ_IOBuffer* buf, const AJ_IOVec* iov, uint16_t iovCount)
+{
+    while (iovCount--) {
+        if ((WireBytes + iov->len) > sizeof(Wire)) {
+            return AJ_ERR_WRITE;
+        }
+        memcpy(Wire + WireBytes, iov->data, iov->len);
+        WireBytes += iov->len;
+        ++iov;
+    }
+    return AJ_OK;
+}
+
+#ifdef AJ_DEBUG_BUILD
+static AJ_Status MsgInit(AJ_Message* msg, uint32_t msgId, uint8_t msgType)
+{
+    msg->objPath = "/test/marshalref";
+    /*
+     * Messages on the peer authentication interface are not subject to access control
+     */
+    msg->iface = "org.alljoyn.Bus.Peer.Authentication";
+    msg->member = "blobs";
+    msg->msgId = msgId;
+    msg->signature = "yayuaqsad";
+    return AJ_OK;
+}
+
+extern AJ_MutterHook MutterHook;
+#endif
+
+static void InitTx(AJ_BusAttachment* bus, uint8_t* buffer, uint16_t size, AJ_TxvFunc sendv)
+{
+    AJ_IOBufInit(&bus->sock.tx, buffer, size, AJ_IO_BUF_TX, NULL);
+    bus->sock.tx.send = TxFunc;
+    bus->sock.tx.sendv = sendv;
+    bus->serial = 1;
+    WireBytes = 0;
+}
+
+static AJ_Status SendMsg(AJ_BusAttachment* bus, uint8_t flags, uint8_t byRef)
+{
+    AJ_Status status;
+    AJ_Message msg;
+
+    status = AJ_MarshalSignal(bus, &msg, 0, Destination, 0, flags, 0);
+    if (status != AJ_OK) {
+        return status;
+    }
+    if (!byRef) {
+        status = AJ_MarshalArgs(&msg, "yayuaqsad", 0x55, Blob8, sizeof(Blob8), 0x12345678, Blob16, sizeof(Blob16),
+                                "after the blobs", Doubles, sizeof(Doubles));
+        if (status == AJ_OK) {
+            status = AJ_DeliverMsg(&msg);
+        }
+        return status;
+    }
+    status = AJ_MarshalArgs(&msg, "y", 0x55);
+    if (status == AJ_OK) {
+        status = AJ_MarshalArrayRef(&msg, AJ_ARG_BYTE, Blob8, sizeof(Blob8));
+    }
+    if (status == AJ_OK) {
+        status = AJ_MarshalArgs(&msg, "u", 0x12345678);
+    }
+    if (status == AJ_OK) {
+        status = AJ_MarshalArrayRef(&msg, AJ_ARG_UINT16, Blob16, sizeof(Blob16));
+    }
+    if (status == AJ_OK) {
+        status = AJ_MarshalArgs(&msg, "s", "after the blobs");
+    }
+    if (status == AJ_OK) {
+        status = AJ_MarshalArrayRef(&msg, AJ_ARG_DOUBLE, Doubles, sizeof(Doubles));
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    return status;
+}
+
+static AJ_Status CheckRefs(AJ_BusAttachment* bus, uint8_t flags)
+{
+    AJ_Status status;
+    uint8_t sendv;
+
+    /*
+     * The reference output with the arrays copied into the transmit buffer
+     */
+    InitTx(bus, BigTxBuffer, sizeof(BigTxBuffer), NULL);
+    status = SendMsg(bus, flags, FALSE);
+    if (status != AJ_OK) {
+        AJ_AlwaysPrintf(("Copy marshal failed %s\n", AJ_StatusText(status)));
+        return status;
+    }
+    memcpy(Expect, Wire, WireBytes);
+    ExpectBytes = WireBytes;
+
+    for (sendv = 0; sendv < 2; ++sendv) {
+        InitTx(bus, SmallTxBuffer, sizeof(SmallTxBuffer), sendv ? TxvFunc : NULL);
+        status = SendMsg(bus, flags, TRUE);
+        if (status != AJ_OK) {
+            AJ_AlwaysPrintf(("Reference marshal failed %s\n", AJ_StatusText(status)));
+            return status;
+        }
+        if ((WireBytes != ExpectBytes) || (memcmp(Wire, Expect, ExpectBytes) != 0)) {
+            AJ_AlwaysPrintf(("Wire mismatch flags=%x sendv=%u %u bytes expected %u\n", flags, sendv, (uint32_t)WireBytes, (uint32_t)ExpectBytes));
+            return AJ_ERR_FAILURE;
+        }
+    }
+    return AJ_OK;
+}
+
+int AJ_Main(void)
+{
+    AJ_BusAttachment bus;
+    AJ_GUID guid;
+    uint8_t key[AJ_SESSION_KEY_LEN];
+    AJ_Message msg;
+    size_t i;
+
+#ifdef AJ_DEBUG_BUILD
+    MutterHook = MsgInit;
+#else
+    AJ_AlwaysPrintf(("marshalref only works in debug build.\n"));
+    return -1;
+#endif
+
+    AJ_Initialize();
+    memset(&bus, 0, sizeof(bus));
+    strcpy(bus.uniqueName, ":sender.1");
+
+    for (i = 0; i < ArraySize(Blob8); ++i) {
+        Blob8[i] = (uint8_t)(i * 7);
+    }
+    for (i = 0; i < ArraySize(Blob16); ++i) {
+        Blob16[i] = (uint16_t)(i * 31);
+    }
+    for (i = 0; i < ArraySize(Doubles); ++i) {
+        Doubles[i] = i * 1.5;
+    }
+
+    if (CheckRefs(&bus, 0) != AJ_OK) {
+        goto ErrorExit;
+    }
+    /*
+     * Encrypted with a session key for the destination
+     */
+    memset(&guid, 0x11, sizeof(guid));
+    memset(key, 0x22, sizeof(key));
+    if ((AJ_GUID_AddNameMapping(NULL, &guid, Destination, NULL) != AJ_OK) || (AJ_SetSessionKey(Destination, key, 0, 0) != AJ_OK)) {
+        AJ_AlwaysPrintf(("Failed to set session key\n"));
+        goto ErrorExit;
+    }
+    if (CheckRefs(&bus, AJ_FLAG_ENCRYPTED) != AJ_OK) {
+        goto ErrorExit;
+    }
+    /*
+     * Referenced arrays must match the signature and cannot be delivered partially
+     */
+    InitTx(&bus, SmallTxBuffer, sizeof(SmallTxBuffer), NULL);
+    AJ_MarshalSignal(&bus, &msg, 0, Destination, 0, 0, 0);
+    if (AJ_MarshalArrayRef(&msg, AJ_ARG_BYTE, Blob8, sizeof(Blob8)) != AJ_ERR_MARSHAL) {
+        AJ_AlwaysPrintf(("Signature mismatch not detected\n"));
+        goto ErrorExit;
+    }
+    AJ_MarshalArgs(&msg, "y", 0x55);
+    AJ_MarshalArrayRef(&msg, AJ_ARG_BYTE, Blob8, sizeof(Blob8));
+    if (AJ_DeliverMsgPartial(&msg, 100) != AJ_ERR_UNEXPECTED) {
+        AJ_AlwaysPrintf(("Partial delivery not rejected\n"));
+        goto ErrorExit;
+    }
+
+    AJ_AlwaysPrintf(("Marshal by reference test PASSED\n"));
+    return 0;
+
+ErrorExit:
+
+    AJ_AlwaysPrintf(("Marshal by reference test FAILED\n"));
+    return 1;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
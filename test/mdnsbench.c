@@ -0,0 +1,395 @@
+/**
+ * @file
+ */
+/******************************************************************************
+ *    Copyright (c) Open Connectivity Foundation (OCF), AllJoyn Open Source
+ *    Project (AJOSP) Contributors and others.
+ *
+ *    SPDX-License-Identifier: Apache-2.0
+ *
+ *    All rights reserved. This program and the accompanying materials are
+ *    made available under the terms of the Apache License, Version 2.0
+ *    which accompanies this distribution, and is available at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Copyright (c) Open Connectivity Foundation and Contributors to AllSeen
+ *    Alliance. All rights reserved.
+ *
+ *    Permission to use, copy, modify, and/or distribute this software for
+ *    any purpose with or without fee is hereby granted, provided that the
+ *    above copyright notice and this permission notice appear in all
+ *    copies.
+ *
+ *    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ *    WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+ *    WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+ *    AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+ *    DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR
+ *    PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ *    TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ *    PERFORMANCE OF THIS SOFTWARE.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <ajtcl/alljoyn.h>
+#include <ajtcl/aj_disco.h>
+#include <ajtcl/aj_connect.h>
+#include <ajtcl/aj_debug.h>
+
+/*
+ * Checks the mDNS response parser against responses laid out the way routing nodes and other mDNS
+ * responders send them, fuzzes it with corrupted and truncated copies and measures how many
+ * responses per second it gets through on a busy network where most responses do not match.
+ */
+
+#define PREFIX          "org.alljoyn.BusNode"
+#define NUM_FUZZ        200000
+#define NUM_PACKETS     20
+#define NUM_ITERATIONS  20000
+
+#define GUID_A  "1b2c3d4e5f60718293a4b5c6d7e8f901"
+#define GUID_B  "ab2c3d4e5f60718293a4b5c6d7e8f901"
+
+typedef struct {
+    uint8_t data[512];
+    uint16_t len;
+} Packet;
+
+static Packet Packets[NUM_PACKETS];
+
+static void Put8(Packet* pkt, uint8_t v)
+{
+    pkt->data[pkt->len++] = v;
+}
+
+static void Put16(Packet* pkt, uint16_t v)
+{
+    Put8(pkt, v >> 8);
+    Put8(pkt, v & 0xFF);
+}
+
+/*
+ * Writes a dotted name as labels without the terminator and returns its offset
+ */
+static uint16_t PutLabels(Packet* pkt, const char* name)
+{
+    uint16_t offset = pkt->len;
+    while (*name) {
+        size_t len = strcspn(name, ".");
+        Put8(pkt, (uint8_t)len);
+        memcpy(pkt->data + pkt->len, name, len);
+        pkt->len += (uint16_t)len;
+        name += name[len] ? len + 1 : len;
+    }
+    return offset;
+}
+
+static void PutPointer(Packet* pkt, uint16_t offset)
+{
+    Put16(pkt, 0xC000 | offset);
+}
+
+/*
+ * Writes the fixed part of a resource record and returns the offset of the rdata length
+ */
+static uint16_t PutRR(Packet* pkt, uint16_t type)
+{
+    uint16_t offset;
+    Put16(pkt, type);
+    Put16(pkt, 0x8001);
+    Put16(pkt, 0);
+    Put16(pkt, 120);
+    offset = pkt->len;
+    Put16(pkt, 0);
+    return offset;
+}
+
+static void EndRR(Packet* pkt, uint16_t offset)
+{
+    uint16_t rdlen = pkt->len - offset - 2;
+    pkt->data[offset] = rdlen >> 8;
+    pkt->data[offset + 1] = rdlen & 0xFF;
+}
+
+static void PutText(Packet* pkt, const char* str)
+{
+    Put8(pkt, (uint8_t)strlen(str));
+    memcpy(pkt->data + pkt->len, str, strlen(str));
+    pkt->len += (uint16_t)strlen(str);
+}
+
+static void PutHeader(Packet* pkt, uint16_t anCount, uint16_t arCount)
+{
+    pkt->len = 0;
+    Put16(pkt, 0);
+    Put16(pkt, 0x8400);
+    Put16(pkt, 0);
+    Put16(pkt, anCount);
+    Put16(pkt, 0);
+    Put16(pkt, arCount);
+}
+
+/*
+ * A routing node response: PTR and SRV answers for TCP and optionally UDP, then the advertise and
+ * sender-info TXT records and the A record as additional records
+ */
+static void RoutingNodeResponse(Packet* pkt, const char* guid, const char* name, uint32_t pv, uint8_t udp, const char* addrGuid)
+{
+    uint16_t tcp;
+    uint16_t local;
+    uint16_t ptr;
+    uint16_t target;
+    uint16_t rr;
+    char str[64];
+
+    PutHeader(pkt, udp ? 4 : 2, 3);
+    tcp = PutLabels(pkt, "_alljoyn._tcp.local");
+    Put8(pkt, 0);
+    local = tcp + 14;
+    rr = PutRR(pkt, 12);
+    ptr = PutLabels(pkt, guid);
+    PutPointer(pkt, tcp);
+    EndRR(pkt, rr);
+    PutPointer(pkt, ptr);
+    rr = PutRR(pkt, 33);
+    Put16(pkt, 0);
+    Put16(pkt, 0);
+    Put16(pkt, 9955);
+    target = PutLabels(pkt, guid);
+    PutPointer(pkt, local);
+    EndRR(pkt, rr);
+    if (udp) {
+        uint16_t udpName = PutLabels(pkt, "_alljoyn._udp");
+        PutPointer(pkt, local);
+        rr = PutRR(pkt, 12);
+        ptr = PutLabels(pkt, guid);
+        PutPointer(pkt, udpName);
+        EndRR(pkt, rr);
+        PutPointer(pkt, ptr);
+        rr = PutRR(pkt, 33);
+        Put16(pkt, 0);
+        Put16(pkt, 0);
+        Put16(pkt, 9956);
+        PutPointer(pkt, target);
+        EndRR(pkt, rr);
+    }
+    PutLabels(pkt, "advertise");
+    PutPointer(pkt, target);
+    rr = PutRR(pkt, 16);
+    PutText(pkt, "txtvers=0");
+    PutText(pkt, "t_1=3");
+    sprintf(str, "n_1=%s", name);
+    PutText(pkt, str);
+    EndRR(pkt, rr);
+    PutLabels(pkt, "sender-info");
+    PutPointer(pkt, target);
+    rr = PutRR(pkt, 16);
+    PutText(pkt, "txtvers=0");
+    sprintf(str, "ajpv=%u", pv);
+    PutText(pkt, str);
+    PutText(pkt, "pv=2");
+    PutText(pkt, "ipv4=10.0.0.1");
+    PutText(pkt, "upcv4=9956");
+    EndRR(pkt, rr);
+    if (addrGuid == guid) {
+        PutPointer(pkt, target);
+    } else {
+        PutLabels(pkt, addrGuid);
+        PutPointer(pkt, local);
+    }
+    rr = PutRR(pkt, 1);
+    Put8(pkt, 10);
+    Put8(pkt, 0);
+    Put8(pkt, 0);
+    Put8(pkt, 1);
+    EndRR(pkt, rr);
+}
+
+/*
+ * A response from some other mDNS service on the network
+ */
+static void OtherResponse(Packet* pkt, uint32_t n)
+{
+    uint16_t service;
+    uint16_t instance;
+    uint16_t target;
+    uint16_t rr;
+    char str[64];
+
+    PutHeader(pkt, 2, 2);
+    service = PutLabels(pkt, "_googlecast._tcp.local");
+    Put8(pkt, 0);
+    rr = PutRR(pkt, 12);
+    sprintf(str, "Chromecast-%08x", n);
+    instance = PutLabels(pkt, str);
+    PutPointer(pkt, service);
+    EndRR(pkt, rr);
+    PutPointer(pkt, instance);
+    rr = PutRR(pkt, 33);
+    Put16(pkt, 0);
+    Put16(pkt, 0);
+    Put16(pkt, 8009);
+    target = PutLabels(pkt, str);
+    PutPointer(pkt, service + 17);
+    EndRR(pkt, rr);
+    PutPointer(pkt, instance);
+    rr = PutRR(pkt, 16);
+    PutText(pkt, "id=0123456789abcdef0123456789abcdef");
+    PutText(pkt, "md=Chromecast");
+    PutText(pkt, "fn=Living Room TV");
+    PutText(pkt, "ve=05");
+    EndRR(pkt, rr);
+    PutPointer(pkt, target);
+    rr = PutRR(pkt, 1);
+    Put16(pkt, 0x0A00);
+    Put16(pkt, n & 0xFFFF);
+    EndRR(pkt, rr);
+}
+
+/*
+ * Parses the packet from a buffer that is exactly the size of the packet so that out of bounds
+ * reads are caught by memory checkers
+ */
+static AJ_Status Parse(const uint8_t* data, uint16_t len, AJ_Service* service)
+{
+    AJ_IOBuffer rxBuf;
+    AJ_Status status;
+    uint8_t* copy = (uint8_t*)malloc(len ? len : 1);
+
+    memcpy(copy, data, len);
+    AJ_IOBufInit(&rxBuf, copy, len, AJ_IO_BUF_RX, NULL);
+    rxBuf.writePtr += len;
+    memset(service, 0, sizeof(AJ_Service));
+    status = AJ_ParseMDNSResponse(&rxBuf, PREFIX, service);
+    free(copy);
+    return status;
+}
+
+int AJ_Main(void)
+{
+    Packet pkt;
+    AJ_Service service;
+    AJ_IOBuffer rxBuf;
+    AJ_Time timer;
+    uint32_t elapsed;
+    uint32_t matches;
+    uint32_t i;
+    uint32_t n;
+
+    AJ_Initialize();
+
+    /*
+     * Matching responses
+     */
+    RoutingNodeResponse(&pkt, GUID_A, PREFIX ".Lamp", 12, FALSE, GUID_A);
+    if ((Parse(pkt.data, pkt.len, &service) != AJ_OK) || (service.ipv4port != 9955) || (service.pv != 12) ||
+        !(service.addrTypes & AJ_ADDR_TCP4) || (service.ipv4 != 0x0100000A)) {
+        AJ_AlwaysPrintf(("TCP response not parsed\n"));
+        goto ErrorExit;
+    }
+#ifdef AJ_ARDP
+    RoutingNodeResponse(&pkt, GUID_A, PREFIX, 12, TRUE, GUID_A);
+    if ((Parse(pkt.data, pkt.len, &service) != AJ_OK) || (service.ipv4portUdp != 9956) || !(service.addrTypes & AJ_ADDR_UDP4)) {
+        AJ_AlwaysPrintf(("UDP response not parsed\n"));
+        goto ErrorExit;
+    }
+#endif
+    /*
+     * Responses that must not match
+     */
+    RoutingNodeResponse(&pkt, GUID_A, "org.example.Thermostat", 12, FALSE, GUID_A);
+    if (Parse(pkt.data, pkt.len, &service) != AJ_ERR_NO_MATCH) {
+        AJ_AlwaysPrintf(("Response without the prefix matched\n"));
+        goto ErrorExit;
+    }
+    RoutingNodeResponse(&pkt, GUID_A, PREFIX, 12, FALSE, GUID_B);
+    if (Parse(pkt.data, pkt.len, &service) != AJ_ERR_NO_MATCH) {
+        AJ_AlwaysPrintf(("Address record for another guid matched\n"));
+        goto ErrorExit;
+    }
+    AJ_SetMinProtoVersion(13);
+    RoutingNodeResponse(&pkt, GUID_A, PREFIX, 12, FALSE, GUID_A);
+    if (Parse(pkt.data, pkt.len, &service) != AJ_ERR_NO_MATCH) {
+        AJ_AlwaysPrintf(("Old routing node matched\n"));
+        goto ErrorExit;
+    }
+    AJ_SetMinProtoVersion(10);
+    OtherResponse(&pkt, 0);
+    if (Parse(pkt.data, pkt.len, &service) != AJ_ERR_NO_MATCH) {
+        AJ_AlwaysPrintf(("Other service matched\n"));
+        goto ErrorExit;
+    }
+    for (i = 0; i < pkt.len; ++i) {
+        RoutingNodeResponse(&pkt, GUID_A, PREFIX, 12, TRUE, GUID_A);
+        if (Parse(pkt.data, (uint16_t)i, &service) != AJ_ERR_NO_MATCH) {
+            AJ_AlwaysPrintf(("Truncated response matched\n"));
+            goto ErrorExit;
+        }
+    }
+
+    /*
+     * Fuzz with corrupted copies of the responses, they must not crash or read out of bounds
+     */
+    srand(1);
+    for (i = 0; i < NUM_FUZZ; ++i) {
+        uint32_t flips = 1 + rand() % 4;
+        if (i & 1) {
+            RoutingNodeResponse(&pkt, GUID_A, PREFIX, 10 + rand() % 4, rand() & 1, GUID_A);
+        } else {
+            OtherResponse(&pkt, rand());
+        }
+        while (flips--) {
+            pkt.data[rand() % pkt.len] = (uint8_t)rand();
+        }
+        Parse(pkt.data, (uint16_t)(rand() % (pkt.len + 1)), &service);
+        Parse(pkt.data, pkt.len, &service);
+    }
+
+    /*
+     * Throughput on a busy network: one in NUM_PACKETS responses is from a routing node with the
+     * prefix, the rest are other services or routing nodes advertising other names
+     */
+    for (i = 0; i < NUM_PACKETS; ++i) {
+        if (i == 0) {
+            RoutingNodeResponse(&Packets[i], GUID_A, PREFIX ".Lamp", 12, TRUE, GUID_A);
+        } else if (i & 1) {
+            RoutingNodeResponse(&Packets[i], GUID_B, "org.example.Thermostat", 12, TRUE, GUID_B);
+        } else {
+            OtherResponse(&Packets[i], i);
+        }
+    }
+    matches = 0;
+    AJ_InitTimer(&timer);
+    for (n = 0; n < NUM_ITERATIONS; ++n) {
+        for (i = 0; i < NUM_PACKETS; ++i) {
+            AJ_IOBufInit(&rxBuf, Packets[i].data, Packets[i].len, AJ_IO_BUF_RX, NULL);
+            rxBuf.writePtr += Packets[i].len;
+            memset(&service, 0, sizeof(service));
+            if (AJ_ParseMDNSResponse(&rxBuf, PREFIX, &service) == AJ_OK) {
+                ++matches;
+            }
+        }
+    }
+    elapsed = AJ_GetElapsedTime(&timer, FALSE);
+    if (matches != NUM_ITERATIONS) {
+        AJ_AlwaysPrintf(("Expected %u matches, got %u\n", NUM_ITERATIONS, matches));
+        goto ErrorExit;
+    }
+    AJ_AlwaysPrintf(("%u responses in %u ms\n", NUM_ITERATIONS * NUM_PACKETS, elapsed));
+    AJ_AlwaysPrintf(("mDNS parser benchmark PASSED\n"));
+    return 0;
+
+ErrorExit:
+
+    AJ_AlwaysPrintf(("mDNS parser benchmark FAILED\n"));
+    return 1;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
@@ -0,0 +1,466 @@
+/**
+ * @file
+ */
+/******************************************************************************
+ *    Copyright (c) Open Connectivity Foundation (OCF), AllJoyn Open Source
+ *    Project (AJOSP) Contributors and others.
+ *
+ *    SPDX-License-Identifier: Apache-2.0
+ *
+ *    All rights reserved. This program and the accompanying materials are
+ *    made available under the terms of the Apache License, Version 2.0
+ *    which accompanies this distribution, and is available at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Copyright (c) Open Connectivity Foundation and Contributors to AllSeen
+ *    Alliance. All rights reserved.
+ *
+ *    Permission to use, copy, modify, and/or distribute this software for
+ *    any purpose with or without fee is hereby granted, provided that the
+ *    above copyright notice and this permission notice appear in all
+ *    copies.
+ *
+ *    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ *    WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+ *    WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+ *    AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+ *    DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR
+ *    PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ *    TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ *    PERFORMANCE OF THIS SOFTWARE.
+ ******************************************************************************/
+#include <ajtcl/alljoyn.h>
+#include <ajtcl/aj_util.h>
+#include <ajtcl/aj_debug.h>
+#include <ajtcl/aj_bufio.h>
+#include <ajtcl/aj_authorisation.h>
+#include <ajtcl/aj_creds.h>
+
+/*
+ * Checks that manifests and policies unmarshaled from a received message can be allocated from the
+ * message arena and freed, also as part of a list mixed with heap allocated nodes, that the arena
+ * is released when the message is closed and that structures unmarshaled from a local buffer are
+ * still allocated from the heap.
+ */
+
+#define WIRE_SIZE (16 * 1024)
+
+#define NUM_MANIFESTS 4
+#define NUM_RULES     3
+#define NUM_MEMBERS   3
+#define NUM_ACLS      2
+#define NUM_PEERS     2
+
+#define BENCH_LOOPS   1000
+
+static uint8_t Wire[WIRE_SIZE];
+static size_t WireBytes;
+static size_t WirePos;
+
+static uint8_t TxBuffer[WIRE_SIZE];
+static uint8_t RxBuffer[WIRE_SIZE];
+
+static const char* const Sender = ":sender.1";
+static const char* const Destination = ":dest.1";
+
+static const char* const Objects[NUM_RULES] = { "/test/one", "/test/two", "*" };
+static const char* const Interfaces[NUM_RULES] = { "org.test.One", "org.test.Two", "*" };
+static const char* const Members[NUM_MEMBERS] = { "Ping", "Pong", "*" };
+
+static AJ_PermissionMember MemberNodes[NUM_RULES][NUM_MEMBERS];
+static AJ_PermissionRule RuleNodes[NUM_RULES];
+static AJ_Manifest ManifestNodes[NUM_MANIFESTS];
+static AJ_ManifestArray ManifestArrayNodes[NUM_MANIFESTS];
+static AJ_PermissionPeer PeerNodes[NUM_PEERS];
+static AJ_PermissionACL ACLNodes[NUM_ACLS];
+static AJ_Policy Policy;
+
+static uint8_t Thumbprint[32];
+static uint8_t Signature[64];
+
+static AJ_Status TxFunc(AJ_IOBuffer* buf)
+{
+    size_t tx = AJ_IO_BUF_AVAIL(buf);
+
+    if ((WireBytes + tx) > sizeof(Wire)) {
+        return AJ_ERR_WRITE;
+    }
+    memcpy(Wire + WireBytes, buf->readPtr, tx);
+    WireBytes += tx;
+    AJ_IO_BUF_RESET(buf);
+    return AJ_OK;
+}
+
+static AJ_Status RxFunc(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
+{
+    size_t rx = min(len, AJ_IO_BUF_SPACE(buf));
+
+    rx = min(rx, WireBytes - WirePos);
+    if (!rx) {
+        return AJ_ERR_TIMEOUT;
+    }
+    memcpy(buf->writePtr, Wire + WirePos, rx);
+    buf->writePtr += rx;
+    WirePos += rx;
+    return AJ_OK;
+}
+
+#ifdef AJ_DEBUG_BUILD
+static AJ_Status MsgInit(AJ_Message* msg, uint32_t msgId, uint8_t msgType)
+{
+    msg->objPath = "/test/msgarena";
+    /*
+     * Messages on the peer authentication interface are not subject to access control
+     */
+    msg->iface = "org.alljoyn.Bus.Peer.Authentication";
+    msg->member = "security";
+    msg->msgId = msgId;
+    msg->signature = "a(ua(ssa(syy))saysay)(qua(a(ya(yyayayay)ay)a(ssa(syy))))";
+    return AJ_OK;
+}
+
+extern AJ_MutterHook MutterHook;
+#endif
+
+static void InitStructures(void)
+{
+    size_t i;
+    size_t j;
+
+    for (i = 0; i < NUM_RULES; ++i) {
+        for (j = 0; j < NUM_MEMBERS; ++j) {
+            MemberNodes[i][j].mbr = Members[j];
+            MemberNodes[i][j].type = (uint8_t)(j + 1);
+            MemberNodes[i][j].action = (uint8_t)(1 << i);
+            MemberNodes[i][j].next = (j + 1 < NUM_MEMBERS) ? &MemberNodes[i][j + 1] : NULL;
+        }
+        RuleNodes[i].obj = Objects[i];
+        RuleNodes[i].ifn = Interfaces[i];
+        RuleNodes[i].members = MemberNodes[i];
+        RuleNodes[i].next = (i + 1 < NUM_RULES) ? &RuleNodes[i + 1] : NULL;
+    }
+    for (i = 0; i < sizeof(Thumbprint); ++i) {
+        Thumbprint[i] = (uint8_t)i;
+    }
+    for (i = 0; i < sizeof(Signature); ++i) {
+        Signature[i] = (uint8_t)(i * 3);
+    }
+    for (i = 0; i < NUM_MANIFESTS; ++i) {
+        ManifestNodes[i].version = (uint32_t)(i + 1);
+        ManifestNodes[i].rules = RuleNodes;
+        ManifestNodes[i].thumbprintAlgorithmOid = "2.16.840.1.101.3.4.2.1";
+        ManifestNodes[i].thumbprint = Thumbprint;
+        ManifestNodes[i].thumbprintSize = sizeof(Thumbprint);
+        ManifestNodes[i].signatureAlgorithmOid = "1.2.840.10045.4.3.2";
+        ManifestNodes[i].signature = Signature;
+        ManifestNodes[i].signatureSize = sizeof(Signature);
+        ManifestArrayNodes[i].manifest = &ManifestNodes[i];
+        ManifestArrayNodes[i].next = (i + 1 < NUM_MANIFESTS) ? &ManifestArrayNodes[i + 1] : NULL;
+    }
+    for (i = 0; i < NUM_PEERS; ++i) {
+        memset(&PeerNodes[i], 0, sizeof(AJ_PermissionPeer));
+        PeerNodes[i].type = (uint8_t)(i ? AJ_PEER_TYPE_ANY_TRUSTED : AJ_PEER_TYPE_ALL);
+        PeerNodes[i].next = (i + 1 < NUM_PEERS) ? &PeerNodes[i + 1] : NULL;
+    }
+    for (i = 0; i < NUM_ACLS; ++i) {
+        ACLNodes[i].peers = PeerNodes;
+        ACLNodes[i].rules = RuleNodes;
+        ACLNodes[i].next = (i + 1 < NUM_ACLS) ? &ACLNodes[i + 1] : NULL;
+    }
+    Policy.specification = 1;
+    Policy.version = 42;
+    Policy.acls = ACLNodes;
+}
+
+static AJ_Status CheckRules(const AJ_PermissionRule* rule)
+{
+    size_t i;
+    size_t j;
+
+    for (i = 0; i < NUM_RULES; ++i, rule = rule->next) {
+        const AJ_PermissionMember* member;
+        if (!rule || strcmp(rule->obj, Objects[i]) || strcmp(rule->ifn, Interfaces[i])) {
+            return AJ_ERR_FAILURE;
+        }
+        member = rule->members;
+        for (j = 0; j < NUM_MEMBERS; ++j, member = member->next) {
+            if (!member || strcmp(member->mbr, Members[j]) || (member->type != j + 1) || (member->action != (1 << i))) {
+                return AJ_ERR_FAILURE;
+            }
+        }
+        if (member) {
+            return AJ_ERR_FAILURE;
+        }
+    }
+    return rule ? AJ_ERR_FAILURE : AJ_OK;
+}
+
+static AJ_Status CheckManifests(const AJ_ManifestArray* manifests, size_t count)
+{
+    size_t i;
+
+    for (i = 0; i < count; ++i, manifests = manifests->next) {
+        const AJ_Manifest* manifest = manifests ? manifests->manifest : NULL;
+        if (!manifest || (manifest->version != (i % NUM_MANIFESTS) + 1) || (CheckRules(manifest->rules) != AJ_OK)) {
+            return AJ_ERR_FAILURE;
+        }
+        if ((manifest->signatureSize != sizeof(Signature)) || memcmp(manifest->signature, Signature, sizeof(Signature))) {
+            return AJ_ERR_FAILURE;
+        }
+    }
+    return manifests ? AJ_ERR_FAILURE : AJ_OK;
+}
+
+static AJ_Status CheckPolicy(const AJ_Policy* policy)
+{
+    const AJ_PermissionACL* acl = policy->acls;
+    size_t i;
+    size_t j;
+
+    if ((policy->specification != 1) || (policy->version != 42)) {
+        return AJ_ERR_FAILURE;
+    }
+    for (i = 0; i < NUM_ACLS; ++i, acl = acl->next) {
+        const AJ_PermissionPeer* peer;
+        if (!acl || (CheckRules(acl->rules) != AJ_OK)) {
+            return AJ_ERR_FAILURE;
+        }
+        peer = acl->peers;
+        for (j = 0; j < NUM_PEERS; ++j, peer = peer->next) {
+            if (!peer || (peer->type != PeerNodes[j].type)) {
+                return AJ_ERR_FAILURE;
+            }
+        }
+        if (peer) {
+            return AJ_ERR_FAILURE;
+        }
+    }
+    return acl ? AJ_ERR_FAILURE : AJ_OK;
+}
+
+static AJ_Status SendMsg(AJ_BusAttachment* bus)
+{
+    AJ_Status status;
+    AJ_Message msg;
+
+    AJ_IOBufInit(&bus->sock.tx, TxBuffer, sizeof(TxBuffer), AJ_IO_BUF_TX, NULL);
+    bus->sock.tx.send = TxFunc;
+    WireBytes = 0;
+
+    status = AJ_MarshalSignal(bus, &msg, 0, Destination, 0, 0, 0);
+    if (status == AJ_OK) {
+        status = AJ_ManifestArrayMarshal(ManifestArrayNodes, &msg);
+    }
+    if (status == AJ_OK) {
+        status = AJ_PolicyMarshal(&Policy, &msg);
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    return status;
+}
+
+static AJ_Status RecvMsg(AJ_BusAttachment* bus, AJ_Message* msg)
+{
+    AJ_IOBufInit(&bus->sock.rx, RxBuffer, sizeof(RxBuffer), AJ_IO_BUF_RX, NULL);
+    bus->sock.rx.recv = RxFunc;
+    WirePos = 0;
+
+    return AJ_UnmarshalMsg(bus, msg, 1000);
+}
+
+/*
+ * Unmarshal the manifests and the policy from a received message and free them before the message
+ * is closed. The received manifests are appended to a list unmarshaled from a buffer like
+ * AJ_SecurityInstallManifestsMethod does so the list freed has heap and arena nodes.
+ */
+static AJ_Status CheckReceived(AJ_BusAttachment* bus, const AJ_CredField* buffered)
+{
+    AJ_Status status;
+    AJ_Message msg;
+    AJ_ManifestArray* manifests = NULL;
+    AJ_ManifestArray* combined = NULL;
+    AJ_ManifestArray* last;
+    AJ_Policy* policy = NULL;
+    AJ_CredField field = *buffered;
+
+    status = RecvMsg(bus, &msg);
+    if (status != AJ_OK) {
+        AJ_AlwaysPrintf(("Unmarshal failed %s\n", AJ_StatusText(status)));
+        return status;
+    }
+    status = AJ_ManifestArrayUnmarshal(&manifests, &msg);
+    if (status == AJ_OK) {
+        status = AJ_PolicyUnmarshal(&policy, &msg);
+    }
+    if (status != AJ_OK) {
+        AJ_AlwaysPrintf(("Security unmarshal failed %s\n", AJ_StatusText(status)));
+        goto Exit;
+    }
+#if AJ_MSG_ARENA_SIZE
+    if (!msg.arena) {
+        AJ_AlwaysPrintf(("Nodes not allocated from the message arena\n"));
+        status = AJ_ERR_FAILURE;
+        goto Exit;
+    }
+#endif
+    status = CheckManifests(manifests, NUM_MANIFESTS);
+    if (status == AJ_OK) {
+        status = CheckPolicy(policy);
+    }
+    if (status != AJ_OK) {
+        AJ_AlwaysPrintf(("Unmarshaled structures differ\n"));
+        goto Exit;
+    }
+    status = AJ_ManifestArrayFromBuffer(&combined, &field);
+    if (status != AJ_OK) {
+        AJ_AlwaysPrintf(("Manifests from buffer failed %s\n", AJ_StatusText(status)));
+        goto Exit;
+    }
+    for (last = combined; last->next; last = last->next) {
+    }
+    last->next = manifests;
+    manifests = NULL;
+    status = CheckManifests(combined, 2 * NUM_MANIFESTS);
+    if (status != AJ_OK) {
+        AJ_AlwaysPrintf(("Combined manifests differ\n"));
+    }
+
+Exit:
+    AJ_ManifestArrayFree(combined);
+    AJ_ManifestArrayFree(manifests);
+    AJ_PolicyFree(policy);
+    AJ_CloseMsg(&msg);
+    if ((status == AJ_OK) && msg.arena) {
+        AJ_AlwaysPrintf(("Message arena not released\n"));
+        status = AJ_ERR_FAILURE;
+    }
+    return status;
+}
+
+/*
+ * Allocations from the arena must be aligned and must not overlap, including ones larger than
+ * an arena chunk.
+ */
+static AJ_Status CheckAllocations(AJ_BusAttachment* bus)
+{
+    static const size_t sizes[] = { 1, 7, 8, 100, 3, 5000, 24, 1000, 1000, 1000, 17, 9000, 2 };
+    uint8_t* mem[ArraySize(sizes)];
+    AJ_Status status;
+    AJ_Message msg;
+    size_t i;
+    size_t j;
+
+    status = RecvMsg(bus, &msg);
+    if (status != AJ_OK) {
+        return status;
+    }
+    for (i = 0; i < ArraySize(sizes); ++i) {
+        mem[i] = (uint8_t*)AJ_MsgArenaAlloc(&msg, sizes[i]);
+        if (!mem[i] || ((size_t)mem[i] & 7)) {
+            AJ_AlwaysPrintf(("Bad allocation of %u bytes\n", (uint32_t)sizes[i]));
+            status = AJ_ERR_FAILURE;
+            goto Exit;
+        }
+        memset(mem[i], (int)i, sizes[i]);
+    }
+    for (i = 0; i < ArraySize(sizes); ++i) {
+        for (j = 0; j < sizes[i]; ++j) {
+            if (mem[i][j] != i) {
+                AJ_AlwaysPrintf(("Allocation %u overwritten\n", (uint32_t)i));
+                status = AJ_ERR_FAILURE;
+                goto Exit;
+            }
+        }
+        AJ_MsgArenaFree(mem[i]);
+    }
+
+Exit:
+    AJ_CloseMsg(&msg);
+    return status;
+}
+
+int AJ_Main(void)
+{
+    AJ_BusAttachment bus;
+    AJ_Status status;
+    AJ_CredField field = { 0, NULL };
+    AJ_Policy* policy = NULL;
+    AJ_Time timer;
+    uint32_t elapsed;
+    uint32_t i;
+
+#ifdef AJ_DEBUG_BUILD
+    MutterHook = MsgInit;
+#else
+    AJ_AlwaysPrintf(("msgarena only works in debug build.\n"));
+    return -1;
+#endif
+
+    AJ_Initialize();
+    memset(&bus, 0, sizeof(bus));
+    strcpy(bus.uniqueName, Sender);
+    bus.serial = 1;
+    InitStructures();
+
+    field.size = WIRE_SIZE;
+    field.data = (uint8_t*)AJ_Malloc(field.size);
+    if (!field.data || (AJ_ManifestArrayToBuffer(ManifestArrayNodes, &field) != AJ_OK)) {
+        AJ_AlwaysPrintf(("Manifests to buffer failed\n"));
+        goto ErrorExit;
+    }
+    if ((SendMsg(&bus) != AJ_OK) || (CheckReceived(&bus, &field) != AJ_OK)) {
+        goto ErrorExit;
+    }
+    if ((SendMsg(&bus) != AJ_OK) || (CheckAllocations(&bus) != AJ_OK)) {
+        goto ErrorExit;
+    }
+    /*
+     * A policy unmarshaled from a buffer must outlive the local message so is allocated from the heap
+     */
+    field.size = WIRE_SIZE;
+    status = AJ_PolicyToBuffer(&Policy, &field);
+    if (status == AJ_OK) {
+        status = AJ_PolicyFromBuffer(&policy, &field);
+    }
+    if (status == AJ_OK) {
+        status = CheckPolicy(policy);
+    }
+    AJ_PolicyFree(policy);
+    if (status != AJ_OK) {
+        AJ_AlwaysPrintf(("Policy from buffer failed %s\n", AJ_StatusText(status)));
+        goto ErrorExit;
+    }
+    /*
+     * Time unmarshaling and freeing the structures
+     */
+    field.size = WIRE_SIZE;
+    if ((AJ_ManifestArrayToBuffer(ManifestArrayNodes, &field) != AJ_OK) || (SendMsg(&bus) != AJ_OK)) {
+        goto ErrorExit;
+    }
+    AJ_InitTimer(&timer);
+    for (i = 0; i < BENCH_LOOPS; ++i) {
+        if (CheckReceived(&bus, &field) != AJ_OK) {
+            goto ErrorExit;
+        }
+    }
+    elapsed = AJ_GetElapsedTime(&timer, FALSE);
+    AJ_AlwaysPrintf(("%u messages unmarshaled in %u ms\n", BENCH_LOOPS, elapsed));
+
+    AJ_CredFieldFree(&field);
+    AJ_AlwaysPrintf(("Message arena test PASSED\n"));
+    return 0;
+
+ErrorExit:
+
+    AJ_CredFieldFree(&field);
+    AJ_AlwaysPrintf(("Message arena test FAILED\n"));
+    return 1;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
@@ -0,0 +1,230 @@
+/**
+ * @file
+ */
+/******************************************************************************
+ *    Copyright (c) Open Connectivity Foundation (OCF), AllJoyn Open Source
+ *    Project (AJOSP) Contributors and others.
+ *
+ *    SPDX-License-Identifier: Apache-2.0
+ *
+ *    All rights reserved. This program and the accompanying materials are
+ *    made available under the terms of the Apache License, Version 2.0
+ *    which accompanies this distribution, and is available at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Copyright (c) Open Connectivity Foundation and Contributors to AllSeen
+ *    Alliance. All rights reserved.
+ *
+ *    Permission to use, copy, modify, and/or distribute this software for
+ *    any purpose with or without fee is hereby granted, provided that the
+ *    above copyright notice and this permission notice appear in all
+ *    copies.
+ *
+ *    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ *    WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+ *    WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+ *    AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+ *    DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR
+ *    PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ *    TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ *    PERFORMANCE OF THIS SOFTWARE.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <ajtcl/alljoyn.h>
+#include <ajtcl/aj_msg_priv.h>
+#include <ajtcl/aj_debug.h>
+
+/*
+ * Compares the message id index against the linear scan of the object lists. Every method and signal
+ * on every benchmark object is looked up both ways and the resulting message ids must be identical.
+ */
+
+#define NUM_OBJECTS     32
+#define NUM_ITERATIONS  2000
+
+static const char* const Iface0[] = { "org.alljoyn.bench.Lamp", "?On", "?Off", "?Toggle", "!StateChanged", "@Brightness=u", NULL };
+static const char* const Iface1[] = { "$org.alljoyn.bench.Lock", "?Open", "?Close", "!Opened", "!Closed", NULL };
+static const char* const Iface2[] = { "org.alljoyn.bench.Sensor", "?Reset", "?Calibrate", "!&Reading", "@Value>i", NULL };
+static const char* const Iface3[] = { "org.alljoyn.bench.Timer", "?Start", "?Stop", "?Reset", "!Expired", NULL };
+
+static const char* const WildIface[] = { "org.alljoyn.bench.Wild", "?Ping", "!Pong", NULL };
+
+static const AJ_InterfaceDescription WildInterfaces[] = {
+    WildIface,
+    NULL
+};
+
+static const AJ_InterfaceDescription Interfaces[] = {
+    AJ_PropertiesIface,
+    Iface0,
+    Iface1,
+    Iface2,
+    Iface3,
+    NULL
+};
+
+static char Paths[NUM_OBJECTS][16];
+static AJ_Object AppObjects[NUM_OBJECTS + 3];
+
+typedef struct {
+    const char* path;
+    const char* iface;
+    const char* member;
+    uint8_t msgType;
+} Query;
+
+static Query Queries[NUM_OBJECTS * 16];
+static size_t NumQueries;
+
+static void InitQueries(void)
+{
+    size_t o;
+    size_t i;
+
+    for (o = 0; o < NUM_OBJECTS; ++o) {
+        snprintf(Paths[o], sizeof(Paths[o]), "/bench/obj%u", (unsigned)o);
+        AppObjects[o].path = Paths[o];
+        AppObjects[o].interfaces = Interfaces;
+        for (i = 1; Interfaces[i]; ++i) {
+            const char* const* member = Interfaces[i] + 1;
+            const char* iface = Interfaces[i][0];
+            if (*iface == '$') {
+                ++iface;
+            }
+            for (; *member; ++member) {
+                Query* q = &Queries[NumQueries];
+                if (**member == '@') {
+                    continue;
+                }
+                q->path = Paths[o];
+                q->iface = iface;
+                q->member = *member + ((((*member)[1]) == '&') ? 2 : 1);
+                q->msgType = (**member == '?') ? AJ_MSG_METHOD_CALL : AJ_MSG_SIGNAL;
+                ++NumQueries;
+            }
+        }
+    }
+    /*
+     * Wildcard objects with paths longer than the wildcard character match any object path
+     */
+    AppObjects[NUM_OBJECTS].path = "?wildcard";
+    AppObjects[NUM_OBJECTS].interfaces = WildInterfaces;
+    AppObjects[NUM_OBJECTS + 1].path = "!wildcard";
+    AppObjects[NUM_OBJECTS + 1].interfaces = WildInterfaces;
+    Queries[NumQueries].path = "/bench/elsewhere";
+    Queries[NumQueries].iface = WildIface[0];
+    Queries[NumQueries].member = "Ping";
+    Queries[NumQueries].msgType = AJ_MSG_METHOD_CALL;
+    ++NumQueries;
+    Queries[NumQueries].path = "/bench/elsewhere";
+    Queries[NumQueries].iface = WildIface[0];
+    Queries[NumQueries].member = "Pong";
+    Queries[NumQueries].msgType = AJ_MSG_SIGNAL;
+    ++NumQueries;
+}
+
+static AJ_Status Lookup(const Query* q, uint32_t* msgId)
+{
+    AJ_Message msg;
+    AJ_MsgHeader hdr;
+    uint8_t secure;
+    AJ_Status status;
+
+    memset(&msg, 0, sizeof(msg));
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.msgType = q->msgType;
+    msg.hdr = &hdr;
+    msg.objPath = q->path;
+    msg.iface = q->iface;
+    msg.member = q->member;
+    msg.signature = "";
+
+    status = AJ_LookupMessageId(&msg, &secure);
+    *msgId = msg.msgId;
+    return status;
+}
+
+static uint32_t RunLookups(void)
+{
+    AJ_Time timer;
+    size_t i;
+    size_t n;
+    uint32_t msgId;
+
+    AJ_InitTimer(&timer);
+    for (i = 0; i < NUM_ITERATIONS; ++i) {
+        for (n = 0; n < NumQueries; ++n) {
+            Lookup(&Queries[n], &msgId);
+        }
+    }
+    return AJ_GetElapsedTime(&timer, TRUE);
+}
+
+int AJ_Main(void)
+{
+    size_t n;
+    uint32_t linearTime;
+    uint32_t indexTime;
+    uint32_t indexId;
+    uint32_t linearId;
+
+    AJ_Initialize();
+    InitQueries();
+    AJ_RegisterObjects(AppObjects, NULL);
+
+    /*
+     * Check the index produces exactly the same message ids as the linear scan
+     */
+    for (n = 0; n < NumQueries; ++n) {
+        AJ_Status indexStatus;
+        AJ_Status linearStatus;
+
+        AJ_EnableMessageIdIndex(TRUE);
+        indexStatus = Lookup(&Queries[n], &indexId);
+        AJ_EnableMessageIdIndex(FALSE);
+        linearStatus = Lookup(&Queries[n], &linearId);
+        if ((indexStatus != AJ_OK) || (linearStatus != AJ_OK) || (indexId != linearId)) {
+            AJ_AlwaysPrintf(("Mismatch for %s %s.%s index=%08x(%s) linear=%08x(%s)\n", Queries[n].path, Queries[n].iface, Queries[n].member,
+                             indexId, AJ_StatusText(indexStatus), linearId, AJ_StatusText(linearStatus)));
+            goto ErrorExit;
+        }
+    }
+    /*
+     * Disabled objects must not be found by either method
+     */
+    AJ_SetObjectFlags(Paths[NUM_OBJECTS / 2], AJ_OBJ_FLAG_DISABLED, 0);
+    for (n = 0; n < NumQueries; ++n) {
+        if (Queries[n].path == Paths[NUM_OBJECTS / 2]) {
+            AJ_EnableMessageIdIndex(TRUE);
+            if (Lookup(&Queries[n], &indexId) != AJ_ERR_NO_MATCH) {
+                AJ_AlwaysPrintf(("Disabled object %s was identified\n", Queries[n].path));
+                goto ErrorExit;
+            }
+        }
+    }
+    AJ_SetObjectFlags(Paths[NUM_OBJECTS / 2], 0, AJ_OBJ_FLAG_DISABLED);
+
+    AJ_EnableMessageIdIndex(FALSE);
+    linearTime = RunLookups();
+    AJ_EnableMessageIdIndex(TRUE);
+    indexTime = RunLookups();
+
+    AJ_AlwaysPrintf(("%u lookups over %u objects: linear scan %u ms, index %u ms\n", (unsigned)(NumQueries * NUM_ITERATIONS), NUM_OBJECTS, linearTime, indexTime));
+    AJ_AlwaysPrintf(("Message id lookup benchmark PASSED\n"));
+    return 0;
+
+ErrorExit:
+
+    AJ_AlwaysPrintf(("Message id lookup benchmark FAILED\n"));
+    return 1;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
@@ -0,0 +1,183 @@
+/**
+ * @file
+ */
+/******************************************************************************
+ *    Copyright (c) Open Connectivity Foundation (OCF), AllJoyn Open Source
+ *    Project (AJOSP) Contributors and others.
+ *
+ *    SPDX-License-Identifier: Apache-2.0
+ *
+ *    All rights reserved. This program and the accompanying materials are
+ *    made available under the terms of the Apache License, Version 2.0
+ *    which accompanies this distribution, and is available at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Copyright (c) Open Connectivity Foundation and Contributors to AllSeen
+ *    Alliance. All rights reserved.
+ *
+ *    Permission to use, copy, modify, and/or distribute this software for
+ *    any purpose with or without fee is hereby granted, provided that the
+ *    above copyright notice and this permission notice appear in all
+ *    copies.
+ *
+ *    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ *    WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+ *    WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+ *    AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+ *    DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR
+ *    PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ *    TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ *    PERFORMANCE OF THIS SOFTWARE.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <ajtcl/alljoyn.h>
+#include <ajtcl/aj_guid.h>
+#include <ajtcl/aj_debug.h>
+
+/*
+ * Checks the peer name map lookups, aliases and LRU eviction and measures the cost of looking up
+ * session keys with the name map full.
+ */
+
+#define NUM_PEERS       AJ_NAME_MAP_GUID_SIZE
+#define NUM_ITERATIONS  2000
+
+static char UniqueNames[NUM_PEERS + 1][AJ_MAX_NAME_SIZE + 1];
+static char Aliases[NUM_PEERS + 1][32];
+
+static AJ_Status AddPeer(size_t i)
+{
+    AJ_GUID guid;
+    uint8_t key[AJ_SESSION_KEY_LEN];
+    AJ_Status status;
+
+    memset(&guid, (int)(i + 1), sizeof(guid));
+    memset(key, (int)(i + 1), sizeof(key));
+    snprintf(UniqueNames[i], sizeof(UniqueNames[i]), ":peer%u.2", (unsigned)i);
+    snprintf(Aliases[i], sizeof(Aliases[i]), "org.alljoyn.bench.peer%u", (unsigned)i);
+    status = AJ_GUID_AddNameMapping(NULL, &guid, UniqueNames[i], Aliases[i]);
+    if (status == AJ_OK) {
+        status = AJ_SetSessionKey(UniqueNames[i], key, 0, 0);
+    }
+    return status;
+}
+
+static AJ_Status CheckPeer(size_t i, const char* name)
+{
+    uint8_t key[AJ_SESSION_KEY_LEN];
+    uint8_t expect[AJ_SESSION_KEY_LEN];
+    uint8_t role;
+    uint32_t authVersion;
+    const char* unique;
+    AJ_Status status;
+
+    memset(expect, (int)(i + 1), sizeof(expect));
+    status = AJ_GetSessionKey(name, key, &role, &authVersion);
+    if ((status == AJ_OK) && (memcmp(key, expect, sizeof(key)) != 0)) {
+        status = AJ_ERR_FAILURE;
+    }
+    if (status == AJ_OK) {
+        status = AJ_GetRemoteUniqueName(name, &unique);
+    }
+    if ((status == AJ_OK) && (strcmp(unique, UniqueNames[i]) != 0)) {
+        status = AJ_ERR_FAILURE;
+    }
+    return status;
+}
+
+int AJ_Main(void)
+{
+    AJ_Time timer;
+    size_t i;
+    size_t n;
+    uint32_t elapsed;
+    uint8_t key[AJ_SESSION_KEY_LEN];
+    uint8_t role;
+    uint32_t authVersion;
+
+    AJ_Initialize();
+    AJ_GUID_ClearNameMap();
+
+    for (i = 0; i < NUM_PEERS; ++i) {
+        if (AddPeer(i) != AJ_OK) {
+            AJ_AlwaysPrintf(("Failed to add peer %u\n", (unsigned)i));
+            goto ErrorExit;
+        }
+    }
+    for (i = 0; i < NUM_PEERS; ++i) {
+        if ((CheckPeer(i, UniqueNames[i]) != AJ_OK) || (CheckPeer(i, Aliases[i]) != AJ_OK)) {
+            AJ_AlwaysPrintf(("Lookup failed for peer %u\n", (unsigned)i));
+            goto ErrorExit;
+        }
+    }
+    /*
+     * Peer 0 was used least recently except for peer 1 so peer 1 is evicted when the map is full
+     */
+    CheckPeer(0, UniqueNames[0]);
+    if (AddPeer(NUM_PEERS) != AJ_OK) {
+        AJ_AlwaysPrintf(("Failed to add peer when the name map is full\n"));
+        goto ErrorExit;
+    }
+    if ((AJ_GetSessionKey(UniqueNames[1], key, &role, &authVersion) != AJ_ERR_NO_MATCH) ||
+        (AJ_GetSessionKey(Aliases[1], key, &role, &authVersion) != AJ_ERR_NO_MATCH)) {
+        AJ_AlwaysPrintf(("Least recently used peer was not evicted\n"));
+        goto ErrorExit;
+    }
+    if ((CheckPeer(0, UniqueNames[0]) != AJ_OK) || (CheckPeer(NUM_PEERS, Aliases[NUM_PEERS]) != AJ_OK)) {
+        AJ_AlwaysPrintf(("Lookup failed after eviction\n"));
+        goto ErrorExit;
+    }
+    /*
+     * An alias moves to the most recent mapping that claims it
+     */
+    {
+        AJ_GUID guid;
+        memset(&guid, 0, sizeof(guid));
+        if (AJ_GUID_AddNameMapping(NULL, &guid, UniqueNames[2], Aliases[3]) != AJ_OK) {
+            AJ_AlwaysPrintf(("Failed to update peer mapping\n"));
+            goto ErrorExit;
+        }
+    }
+    if ((CheckPeer(2, Aliases[3]) != AJ_OK) || (AJ_GUID_Find(Aliases[2]) != NULL) || (CheckPeer(3, UniqueNames[3]) != AJ_OK)) {
+        AJ_AlwaysPrintf(("Alias was not moved\n"));
+        goto ErrorExit;
+    }
+    AJ_GUID_DeleteNameMapping(NULL, UniqueNames[2]);
+    if (AJ_GUID_Find(Aliases[3]) || AJ_GUID_Find(UniqueNames[2])) {
+        AJ_AlwaysPrintf(("Deleted peer was found\n"));
+        goto ErrorExit;
+    }
+    for (i = 4; i < NUM_PEERS; ++i) {
+        if (CheckPeer(i, Aliases[i]) != AJ_OK) {
+            AJ_AlwaysPrintf(("Lookup failed for peer %u after delete\n", (unsigned)i));
+            goto ErrorExit;
+        }
+    }
+
+    AJ_InitTimer(&timer);
+    for (n = 0; n < NUM_ITERATIONS; ++n) {
+        for (i = 4; i < NUM_PEERS; ++i) {
+            AJ_GetSessionKey(UniqueNames[i], key, &role, &authVersion);
+        }
+    }
+    elapsed = AJ_GetElapsedTime(&timer, TRUE);
+    AJ_AlwaysPrintf(("%u session key lookups over %u peers: %u ms\n", (unsigned)((NUM_PEERS - 4) * NUM_ITERATIONS), NUM_PEERS, elapsed));
+    AJ_GUID_ClearNameMap();
+    AJ_AlwaysPrintf(("Name map test PASSED\n"));
+    return 0;
+
+ErrorExit:
+
+    AJ_AlwaysPrintf(("Name map test FAILED\n"));
+    return 1;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
@@ -0,0 +1,269 @@
+/**
+ * @file
+ */
+/******************************************************************************
+ *    Copyright (c) Open Connectivity Foundation (OCF), AllJoyn Open Source
+ *    Project (AJOSP) Contributors and others.
+ *
+ *    SPDX-License-Identifier: Apache-2.0
+ *
+ *    All rights reserved. This program and the accompanying materials are
+ *    made available under the terms of the Apache License, Version 2.0
+ *    which accompanies this distribution, and is available at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Copyright (c) Open Connectivity Foundation and Contributors to AllSeen
+ *    Alliance. All rights reserved.
+ *
+ *    Permission to use, copy, modify, and/or distribute this software for
+ *    any purpose with or without fee is hereby granted, provided that the
+ *    above copyright notice and this permission notice appear in all
+ *    copies.
+ *
+ *    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ *    WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+ *    WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+ *    AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+ *    DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR
+ *    PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ *    TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ *    PERFORMANCE OF THIS SOFTWARE.
+ ******************************************************************************/
+
+#include <ajtcl/alljoyn.h>
+#include <ajtcl/aj_nvram.h>
+#include <ajtcl/aj_debug.h>
+
+/*
+ * Checks that NVRAM datasets in the new layout survive a restart, that journaled changes which had
+ * not reached the block file are recovered when the NVRAM is initialized again, that a torn
+ * journal record is ignored, and measures the cost of credential sized updates.
+ */
+
+#define BENCH_WRITES 2000
+#define ENTRY_SIZE   96
+
+extern void _AJ_NVRAM_ResetLayout();
+
+static const char* const BlockFiles[] = {
+    "ajtcl_creds.nvram",
+    "ajtcl_services.nvram",
+    "ajtcl_framework.nvram",
+    "ajtcl_ajjs.nvram",
+    "ajtcl_reserved.nvram",
+    "ajtcl_apps.nvram"
+};
+
+static void RemoveFiles(void)
+{
+    char name[64];
+    size_t i;
+
+    for (i = 0; i < ArraySize(BlockFiles); ++i) {
+        remove(BlockFiles[i]);
+        snprintf(name, sizeof(name), "%s.journal", BlockFiles[i]);
+        remove(name);
+    }
+}
+
+#if AJ_NVRAM_JOURNAL
+static int CopyFile(const char* from, const char* to)
+{
+    static uint8_t buf[AJ_NVRAM_SIZE];
+    FILE* f = fopen(from, "rb");
+    size_t len;
+
+    if (!f) {
+        return FALSE;
+    }
+    len = fread(buf, 1, sizeof(buf), f);
+    fclose(f);
+    f = fopen(to, "wb");
+    if (!f) {
+        return FALSE;
+    }
+    fwrite(buf, 1, len, f);
+    fclose(f);
+    return TRUE;
+}
+
+static long FileSize(const char* name)
+{
+    FILE* f = fopen(name, "rb");
+    long len;
+
+    if (!f) {
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    len = ftell(f);
+    fclose(f);
+    return len;
+}
+#endif
+
+static AJ_Status WriteEntry(uint16_t id, const char* str)
+{
+    char buf[ENTRY_SIZE];
+    AJ_NV_DATASET* handle = AJ_NVRAM_Open(id, "w", sizeof(buf));
+
+    if (!handle) {
+        return AJ_ERR_FAILURE;
+    }
+    memset(buf, 0, sizeof(buf));
+    strncpy(buf, str, sizeof(buf) - 1);
+    if (AJ_NVRAM_Write(buf, sizeof(buf), handle) != sizeof(buf)) {
+        AJ_NVRAM_Close(handle);
+        return AJ_ERR_WRITE;
+    }
+    return AJ_NVRAM_Close(handle);
+}
+
+static int EntryIs(uint16_t id, const char* str)
+{
+    char buf[ENTRY_SIZE];
+    AJ_NV_DATASET* handle = AJ_NVRAM_Open(id, "r", 0);
+    size_t len;
+
+    if (!handle) {
+        return FALSE;
+    }
+    len = AJ_NVRAM_Read(buf, sizeof(buf), handle);
+    AJ_NVRAM_Close(handle);
+    return (len == sizeof(buf)) && (strcmp(buf, str) == 0);
+}
+
+static AJ_Status Restart(void)
+{
+    _AJ_NVRAM_ResetLayout();
+    return AJ_NVRAM_Init_NewLayout();
+}
+
+int AJ_Main(void)
+{
+    AJ_Status status;
+    AJ_Time timer;
+    uint32_t elapsed;
+    char str[32];
+    uint16_t i;
+
+    RemoveFiles();
+    status = AJ_NVRAM_Init_NewLayout();
+    if (status != AJ_OK) {
+        AJ_AlwaysPrintf(("AJ_NVRAM_Init_NewLayout failed %s\n", AJ_StatusText(status)));
+        goto ErrorExit;
+    }
+
+    /*
+     * Datasets survive a restart
+     */
+    status = WriteEntry(AJ_NVRAM_ID_APPS_BEGIN, "first");
+    if (status == AJ_OK) {
+        status = WriteEntry(AJ_NVRAM_ID_CREDS_BEGIN + 1, "credential");
+    }
+    if (status == AJ_OK) {
+        status = Restart();
+    }
+    if ((status != AJ_OK) || !EntryIs(AJ_NVRAM_ID_APPS_BEGIN, "first") || !EntryIs(AJ_NVRAM_ID_CREDS_BEGIN + 1, "credential")) {
+        AJ_AlwaysPrintf(("Datasets lost across a restart %s\n", AJ_StatusText(status)));
+        goto ErrorExit;
+    }
+
+    /*
+     * Rewriting datasets leaves garbage that is compacted away when the block fills up
+     */
+    AJ_InitTimer(&timer);
+    for (i = 0; i < BENCH_WRITES; ++i) {
+        snprintf(str, sizeof(str), "update %u", i);
+        status = WriteEntry(AJ_NVRAM_ID_CREDS_BEGIN + 2 + (i % 16), str);
+        if (status != AJ_OK) {
+            AJ_AlwaysPrintf(("Write %u failed %s\n", i, AJ_StatusText(status)));
+            goto ErrorExit;
+        }
+    }
+    elapsed = AJ_GetElapsedTime(&timer, TRUE);
+    AJ_AlwaysPrintf(("%u dataset updates: %u ms\n", BENCH_WRITES, elapsed));
+    status = Restart();
+    for (i = BENCH_WRITES - 16; (status == AJ_OK) && (i < BENCH_WRITES); ++i) {
+        snprintf(str, sizeof(str), "update %u", i);
+        if (!EntryIs(AJ_NVRAM_ID_CREDS_BEGIN + 2 + (i % 16), str)) {
+            status = AJ_ERR_FAILURE;
+        }
+    }
+    if ((status != AJ_OK) || !EntryIs(AJ_NVRAM_ID_CREDS_BEGIN + 1, "credential")) {
+        AJ_AlwaysPrintf(("Datasets lost after compaction %s\n", AJ_StatusText(status)));
+        goto ErrorExit;
+    }
+
+#if AJ_NVRAM_JOURNAL
+    /*
+     * Simulate losing power after a change was journaled but before the block file was written by
+     * putting back a copy of the block file taken before the change
+     */
+    if (!CopyFile("ajtcl_apps.nvram", "ajtcl_apps.nvram.old")) {
+        AJ_AlwaysPrintf(("Unable to copy the block file\n"));
+        goto ErrorExit;
+    }
+    status = WriteEntry(AJ_NVRAM_ID_APPS_BEGIN, "second");
+    if ((status != AJ_OK) || (FileSize("ajtcl_apps.nvram.journal") <= 0) || !CopyFile("ajtcl_apps.nvram.journal", "ajtcl_apps.nvram.saved")) {
+        AJ_AlwaysPrintf(("Change was not journaled\n"));
+        goto ErrorExit;
+    }
+    _AJ_NVRAM_ResetLayout();
+    if (FileSize("ajtcl_apps.nvram.journal") != 0) {
+        AJ_AlwaysPrintf(("Journal not truncated after syncing\n"));
+        goto ErrorExit;
+    }
+    rename("ajtcl_apps.nvram.old", "ajtcl_apps.nvram");
+    rename("ajtcl_apps.nvram.saved", "ajtcl_apps.nvram.journal");
+    status = AJ_NVRAM_Init_NewLayout();
+    if ((status != AJ_OK) || !EntryIs(AJ_NVRAM_ID_APPS_BEGIN, "second")) {
+        AJ_AlwaysPrintf(("Journaled change not recovered\n"));
+        goto ErrorExit;
+    }
+
+    /*
+     * A record cut short by losing power is not replayed, the records before it are
+     */
+    CopyFile("ajtcl_apps.nvram", "ajtcl_apps.nvram.old");
+    status = WriteEntry(AJ_NVRAM_ID_APPS_BEGIN + 1, "third");
+    if (status == AJ_OK) {
+        status = WriteEntry(AJ_NVRAM_ID_APPS_BEGIN + 2, "fourth");
+    }
+    if ((status != AJ_OK) || !CopyFile("ajtcl_apps.nvram.journal", "ajtcl_apps.nvram.saved")) {
+        AJ_AlwaysPrintf(("Change was not journaled\n"));
+        goto ErrorExit;
+    }
+    _AJ_NVRAM_ResetLayout();
+    rename("ajtcl_apps.nvram.old", "ajtcl_apps.nvram");
+    rename("ajtcl_apps.nvram.saved", "ajtcl_apps.nvram.journal");
+    if (truncate("ajtcl_apps.nvram.journal", FileSize("ajtcl_apps.nvram.journal") - 1) != 0) {
+        AJ_AlwaysPrintf(("Unable to truncate the journal\n"));
+        goto ErrorExit;
+    }
+    status = AJ_NVRAM_Init_NewLayout();
+    if ((status != AJ_OK) || !EntryIs(AJ_NVRAM_ID_APPS_BEGIN + 1, "third") || EntryIs(AJ_NVRAM_ID_APPS_BEGIN + 2, "fourth")) {
+        AJ_AlwaysPrintf(("Torn journal record not ignored\n"));
+        goto ErrorExit;
+    }
+#endif
+
+    _AJ_NVRAM_ResetLayout();
+    RemoveFiles();
+    AJ_AlwaysPrintf(("NVRAM journal test PASSED\n"));
+    return 0;
+
+ErrorExit:
+
+    _AJ_NVRAM_ResetLayout();
+    RemoveFiles();
+    AJ_AlwaysPrintf(("NVRAM journal test FAILED\n"));
+    return 1;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
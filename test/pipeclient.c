@@ -0,0 +1,134 @@
+/**
+ * @file
+ */
+/******************************************************************************
+ *    Copyright (c) Open Connectivity Foundation (OCF), AllJoyn Open Source
+ *    Project (AJOSP) Contributors and others.
+ *
+ *    SPDX-License-Identifier: Apache-2.0
+ *
+ *    All rights reserved. This program and the accompanying materials are
+ *    made available under the terms of the Apache License, Version 2.0
+ *    which accompanies this distribution, and is available at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Copyright (c) Open Connectivity Foundation and Contributors to AllSeen
+ *    Alliance. All rights reserved.
+ *
+ *    Permission to use, copy, modify, and/or distribute this software for
+ *    any purpose with or without fee is hereby granted, provided that the
+ *    above copyright notice and this permission notice appear in all
+ *    copies.
+ *
+ *    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ *    WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+ *    WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+ *    AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+ *    DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR
+ *    PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ *    TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ *    PERFORMANCE OF THIS SOFTWARE.
+ ******************************************************************************/
+
+#include <ajtcl/alljoyn.h>
+#include <ajtcl/aj_debug.h>
+
+/*
+ * Pipelines bus ping method calls to the routing node keeping up to PIPELINE_DEPTH calls in flight
+ * and counts completions through per-call reply handlers.
+ */
+
+#define CONNECT_TIMEOUT    (1000 * 60)
+#define METHOD_TIMEOUT     (1000 * 10)
+#define PIPELINE_DEPTH     (AJ_NUM_REPLY_CONTEXTS - 1)
+#define NUM_CALLS          1000
+
+typedef struct {
+    uint32_t completed;
+    uint32_t failed;
+} PipelineStats;
+
+static void PingReplyHandler(AJ_Message* reply, void* context)
+{
+    PipelineStats* stats = (PipelineStats*)context;
+
+    if (reply->hdr->msgType == AJ_MSG_ERROR) {
+        AJ_AlwaysPrintf(("Ping %u failed %s\n", reply->replySerial, reply->error));
+        ++stats->failed;
+    } else {
+        ++stats->completed;
+    }
+}
+
+static AJ_Status SendPing(AJ_BusAttachment* bus, PipelineStats* stats)
+{
+    AJ_Status status;
+    AJ_Message msg;
+
+    status = AJ_MarshalMethodCallWithHandler(bus, &msg, AJ_METHOD_BUS_PING, AJ_BusDestination, 0, 0, METHOD_TIMEOUT, PingReplyHandler, stats);
+    if (status == AJ_OK) {
+        status = AJ_MarshalArgs(&msg, "su", AJ_GetUniqueName(bus), METHOD_TIMEOUT);
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    return status;
+}
+
+int AJ_Main()
+{
+    AJ_Status status;
+    AJ_BusAttachment bus;
+    PipelineStats stats = { 0, 0 };
+    uint32_t sent = 0;
+    AJ_Time timer;
+
+    AJ_Initialize();
+
+    status = AJ_FindBusAndConnect(&bus, NULL, CONNECT_TIMEOUT);
+    if (status != AJ_OK) {
+        AJ_AlwaysPrintf(("Failed to connect %s\n", AJ_StatusText(status)));
+        return 1;
+    }
+    AJ_InitTimer(&timer);
+    while ((status == AJ_OK) && ((stats.completed + stats.failed) < NUM_CALLS)) {
+        AJ_Message msg;
+        /*
+         * Top up the pipeline
+         */
+        while ((sent < NUM_CALLS) && (AJ_GetPendingReplyCount() < PIPELINE_DEPTH)) {
+            status = SendPing(&bus, &stats);
+            if (status != AJ_OK) {
+                break;
+            }
+            ++sent;
+        }
+        if (status != AJ_OK) {
+            break;
+        }
+        /*
+         * Replies to the pings are dispatched to PingReplyHandler from inside AJ_UnmarshalMsg()
+         */
+        status = AJ_UnmarshalMsg(&bus, &msg, METHOD_TIMEOUT);
+        if (status == AJ_ERR_TIMEOUT) {
+            status = AJ_OK;
+            continue;
+        }
+        if (status == AJ_OK) {
+            status = AJ_BusHandleBusMessage(&msg);
+        }
+        AJ_CloseMsg(&msg);
+    }
+    AJ_AlwaysPrintf(("%u calls %u completed %u failed in %u ms with %u in flight: %s\n", sent, stats.completed, stats.failed,
+                     AJ_GetElapsedTime(&timer, TRUE), PIPELINE_DEPTH, AJ_StatusText(status)));
+    AJ_Disconnect(&bus);
+
+    return ((status == AJ_OK) && !stats.failed) ? 0 : 1;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
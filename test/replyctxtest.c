@@ -0,0 +1,204 @@
+/**
+ * @file
+ */
+/******************************************************************************
+ *    Copyright (c) Open Connectivity Foundation (OCF), AllJoyn Open Source
+ *    Project (AJOSP) Contributors and others.
+ *
+ *    SPDX-License-Identifier: Apache-2.0
+ *
+ *    All rights reserved. This program and the accompanying materials are
+ *    made available under the terms of the Apache License, Version 2.0
+ *    which accompanies this distribution, and is available at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Copyright (c) Open Connectivity Foundation and Contributors to AllSeen
+ *    Alliance. All rights reserved.
+ *
+ *    Permission to use, copy, modify, and/or distribute this software for
+ *    any purpose with or without fee is hereby granted, provided that the
+ *    above copyright notice and this permission notice appear in all
+ *    copies.
+ *
+ *    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ *    WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+ *    WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+ *    AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+ *    DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR
+ *    PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ *    TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ *    PERFORMANCE OF THIS SOFTWARE.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <ajtcl/alljoyn.h>
+#include <ajtcl/aj_debug.h>
+
+/*
+ * Exercises the reply context store: allocation up to AJ_NUM_REPLY_CONTEXTS, release of arbitrary
+ * contexts, timeouts being reported in deadline order, and pending reply handlers being called with
+ * a usable message when the bus disconnects.
+ */
+
+#define NUM_ROUNDS  20
+
+static AJ_Status AllocContext(uint32_t serial, uint32_t timeout)
+{
+    AJ_Message msg;
+    AJ_MsgHeader hdr;
+
+    memset(&msg, 0, sizeof(msg));
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.msgType = AJ_MSG_METHOD_CALL;
+    hdr.serialNum = serial;
+    msg.hdr = &hdr;
+    msg.msgId = AJ_METHOD_PING;
+    msg.destination = ":1.1";
+    return AJ_AllocReplyContext(&msg, timeout);
+}
+
+static void CountReply(AJ_Message* reply, void* context)
+{
+    if ((reply->hdr->msgType == AJ_MSG_ERROR) && (strcmp(reply->error, AJ_ErrTimeout) == 0)) {
+        ++*((uint32_t*)context);
+    }
+}
+
+static AJ_BusAttachment bus;
+
+/*
+ * The timeout error generated on release must look like the one generated on a timeout
+ */
+static void CheckReleasedReply(AJ_Message* reply, void* context)
+{
+    if ((reply->bus == &bus) && reply->sender && (strcmp(reply->sender, bus.uniqueName) == 0) &&
+        reply->destination && (strcmp(reply->destination, bus.uniqueName) == 0)) {
+        CountReply(reply, context);
+    }
+    AJ_CloseMsg(reply);
+}
+
+static AJ_Status SetHandler(uint32_t serial, uint32_t* count)
+{
+    AJ_Message msg;
+    AJ_MsgHeader hdr;
+
+    memset(&msg, 0, sizeof(msg));
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.msgType = AJ_MSG_METHOD_CALL;
+    hdr.serialNum = serial;
+    msg.hdr = &hdr;
+    return AJ_SetReplyHandler(&msg, CheckReleasedReply, count);
+}
+
+static void ReleaseContext(uint32_t serial)
+{
+    AJ_Message msg;
+    AJ_MsgHeader hdr;
+
+    memset(&msg, 0, sizeof(msg));
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.msgType = AJ_MSG_METHOD_CALL;
+    hdr.serialNum = serial;
+    msg.hdr = &hdr;
+    AJ_ReleaseReplyContext(&msg);
+}
+
+int AJ_Main(void)
+{
+    static uint32_t timeouts[AJ_NUM_REPLY_CONTEXTS + 1];
+    static uint8_t released[AJ_NUM_REPLY_CONTEXTS + 1];
+    uint32_t round;
+    uint32_t serial = 1;
+    uint32_t handled = 0;
+    uint32_t i;
+
+    AJ_Initialize();
+
+    for (round = 0; round < NUM_ROUNDS; ++round) {
+        uint32_t base = serial;
+        uint32_t lastTimeout = 0;
+        uint32_t expected = 0;
+        uint32_t count = 0;
+        AJ_Message msg;
+
+        for (i = 0; i < AJ_NUM_REPLY_CONTEXTS; ++i) {
+            timeouts[i] = 1 + (rand() % 50);
+            released[i] = FALSE;
+            if (AllocContext(serial++, timeouts[i]) != AJ_OK) {
+                AJ_AlwaysPrintf(("Failed to allocate reply context %u\n", i));
+                goto ErrorExit;
+            }
+        }
+        if (AllocContext(serial, 10) != AJ_ERR_RESOURCES) {
+            AJ_AlwaysPrintf(("Allocated more than AJ_NUM_REPLY_CONTEXTS reply contexts\n"));
+            goto ErrorExit;
+        }
+        for (i = 0; i < AJ_NUM_REPLY_CONTEXTS; ++i) {
+            if (rand() & 1) {
+                ReleaseContext(base + i);
+                released[i] = TRUE;
+            } else {
+                ++expected;
+            }
+        }
+        AJ_Sleep(60);
+        /*
+         * Timed-out calls must be reported in deadline order, allow some slack because the calls
+         * were not all made in the same millisecond.
+         */
+        while (AJ_TimedOutMethodCall(&msg)) {
+            i = msg.replySerial - base;
+            if ((i >= AJ_NUM_REPLY_CONTEXTS) || released[i] || ((timeouts[i] + 2) < lastTimeout)) {
+                AJ_AlwaysPrintf(("Unexpected timeout for serial %u\n", msg.replySerial));
+                goto ErrorExit;
+            }
+            if (msg.msgId != AJ_REPLY_ID(AJ_METHOD_PING)) {
+                AJ_AlwaysPrintf(("Wrong message id for serial %u\n", msg.replySerial));
+                goto ErrorExit;
+            }
+            released[i] = TRUE;
+            lastTimeout = timeouts[i];
+            ++count;
+        }
+        if (count != expected) {
+            AJ_AlwaysPrintf(("Expected %u timeouts got %u\n", expected, count));
+            goto ErrorExit;
+        }
+    }
+    /*
+     * Pending reply handlers are called when the reply contexts are released
+     */
+    for (i = 0; i < AJ_NUM_REPLY_CONTEXTS; ++i) {
+        if ((AllocContext(serial + i, 1000) != AJ_OK) || (SetHandler(serial + i, &handled) != AJ_OK)) {
+            AJ_AlwaysPrintf(("Failed to set reply handler %u\n", i));
+            goto ErrorExit;
+        }
+    }
+    if (AJ_GetPendingReplyCount() != AJ_NUM_REPLY_CONTEXTS) {
+        AJ_AlwaysPrintf(("Expected %u pending replies\n", AJ_NUM_REPLY_CONTEXTS));
+        goto ErrorExit;
+    }
+    strcpy(bus.uniqueName, ":1.42");
+    AJ_ReleaseReplyContexts(&bus);
+    if ((handled != AJ_NUM_REPLY_CONTEXTS) || AJ_GetPendingReplyCount()) {
+        AJ_AlwaysPrintf(("Expected %u reply handlers to be called got %u\n", AJ_NUM_REPLY_CONTEXTS, handled));
+        goto ErrorExit;
+    }
+    AJ_AlwaysPrintf(("Reply context test PASSED\n"));
+    return 0;
+
+ErrorExit:
+
+    AJ_AlwaysPrintf(("Reply context test FAILED\n"));
+    return 1;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
@@ -0,0 +1,162 @@
+/**
+ * @file
+ */
+/******************************************************************************
+ *    Copyright (c) Open Connectivity Foundation (OCF), AllJoyn Open Source
+ *    Project (AJOSP) Contributors and others.
+ *
+ *    SPDX-License-Identifier: Apache-2.0
+ *
+ *    All rights reserved. This program and the accompanying materials are
+ *    made available under the terms of the Apache License, Version 2.0
+ *    which accompanies this distribution, and is available at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Copyright (c) Open Connectivity Foundation and Contributors to AllSeen
+ *    Alliance. All rights reserved.
+ *
+ *    Permission to use, copy, modify, and/or distribute this software for
+ *    any purpose with or without fee is hereby granted, provided that the
+ *    above copyright notice and this permission notice appear in all
+ *    copies.
+ *
+ *    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ *    WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+ *    WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+ *    AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+ *    DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR
+ *    PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ *    TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ *    PERFORMANCE OF THIS SOFTWARE.
+ ******************************************************************************/
+
+#include <ajtcl/alljoyn.h>
+#include <ajtcl/aj_connect.h>
+#include <ajtcl/aj_debug.h>
+
+/*
+ * Checks the routing node cache: lookups by prefix, the failure count that stops a routing node
+ * being used and eviction when there are more prefixes than entries.
+ */
+
+static void Node(AJ_Service* service, uint32_t ipv4)
+{
+    memset(service, 0, sizeof(AJ_Service));
+    service->addrTypes = AJ_ADDR_TCP4;
+    service->ipv4 = ipv4;
+    service->ipv4port = 9955;
+    service->pv = 12;
+}
+
+static int Cached(const char* prefix, uint32_t ipv4)
+{
+    AJ_Service service;
+    if (AJ_GetCachedRoutingNode(prefix, &service) != AJ_OK) {
+        return ipv4 == 0;
+    }
+    return service.ipv4 == ipv4;
+}
+
+int AJ_Main(void)
+{
+    AJ_Service a;
+    AJ_Service b;
+    AJ_Service n;
+    char prefix[32];
+    uint32_t i;
+
+    AJ_Initialize();
+    AJ_ClearRoutingNodeCache();
+    Node(&a, 0x0A000001);
+    Node(&b, 0x0A000002);
+
+    if (!Cached("org.alljoyn.BusNode", 0)) {
+        AJ_AlwaysPrintf(("Empty cache returned a routing node\n"));
+        goto ErrorExit;
+    }
+    AJ_CacheRoutingNode("org.alljoyn.BusNode", &a, TRUE);
+    if (!Cached("org.alljoyn.BusNode", a.ipv4) || !Cached("org.example.BusNode", 0)) {
+        AJ_AlwaysPrintf(("Lookup by prefix failed\n"));
+        goto ErrorExit;
+    }
+    /*
+     * A failure of some other routing node does not count against the cached one
+     */
+    for (i = 0; i < AJ_ROUTING_NODE_CACHE_MAX_FAILURES; ++i) {
+        AJ_CacheRoutingNode("org.alljoyn.BusNode", &b, FALSE);
+    }
+    if (!Cached("org.alljoyn.BusNode", a.ipv4)) {
+        AJ_AlwaysPrintf(("Failure of another routing node counted\n"));
+        goto ErrorExit;
+    }
+    for (i = 0; i < AJ_ROUTING_NODE_CACHE_MAX_FAILURES; ++i) {
+        AJ_CacheRoutingNode("org.alljoyn.BusNode", &a, FALSE);
+    }
+    if (!Cached("org.alljoyn.BusNode", 0)) {
+        AJ_AlwaysPrintf(("Failed routing node still returned\n"));
+        goto ErrorExit;
+    }
+    AJ_CacheRoutingNode("org.alljoyn.BusNode", &a, TRUE);
+    if (!Cached("org.alljoyn.BusNode", a.ipv4)) {
+        AJ_AlwaysPrintf(("Success did not reset failures\n"));
+        goto ErrorExit;
+    }
+    /*
+     * Connecting to a different routing node replaces the cached one
+     */
+    AJ_CacheRoutingNode("org.alljoyn.BusNode", &b, TRUE);
+    if (!Cached("org.alljoyn.BusNode", b.ipv4)) {
+        AJ_AlwaysPrintf(("Routing node not replaced\n"));
+        goto ErrorExit;
+    }
+    /*
+     * A routing node below the minimum protocol version is not returned
+     */
+    AJ_SetMinProtoVersion(13);
+    if (!Cached("org.alljoyn.BusNode", 0)) {
+        AJ_AlwaysPrintf(("Old routing node returned\n"));
+        goto ErrorExit;
+    }
+    AJ_SetMinProtoVersion(10);
+    /*
+     * More prefixes than entries evicts the entry with the worst history
+     */
+    AJ_CacheRoutingNode("org.alljoyn.BusNode", &b, TRUE);
+    for (i = 0; i < AJ_ROUTING_NODE_CACHE_SIZE; ++i) {
+        Node(&n, 0x0A000100 + i);
+        sprintf(prefix, "org.example.Node%u", i);
+        AJ_CacheRoutingNode(prefix, &n, TRUE);
+    }
+    if (!Cached("org.alljoyn.BusNode", b.ipv4) || !Cached("org.example.Node0", 0)) {
+        AJ_AlwaysPrintf(("Wrong entry evicted\n"));
+        goto ErrorExit;
+    }
+    for (i = 1; i < AJ_ROUTING_NODE_CACHE_SIZE; ++i) {
+        sprintf(prefix, "org.example.Node%u", i);
+        if (!Cached(prefix, 0x0A000100 + i)) {
+            AJ_AlwaysPrintf(("Entry %s lost\n", prefix));
+            goto ErrorExit;
+        }
+    }
+    AJ_ClearRoutingNodeCache();
+    if (!Cached("org.alljoyn.BusNode", 0)) {
+        AJ_AlwaysPrintf(("Cache not cleared\n"));
+        goto ErrorExit;
+    }
+
+    AJ_AlwaysPrintf(("Routing node cache test PASSED\n"));
+    return 0;
+
+ErrorExit:
+
+    AJ_ClearRoutingNodeCache();
+    AJ_AlwaysPrintf(("Routing node cache test FAILED\n"));
+    return 1;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
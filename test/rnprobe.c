@@ -0,0 +1,155 @@
+/**
+ * @file
+ */
+/******************************************************************************
+ *    Copyright (c) Open Connectivity Foundation (OCF), AllJoyn Open Source
+ *    Project (AJOSP) Contributors and others.
+ *
+ *    SPDX-License-Identifier: Apache-2.0
+ *
+ *    All rights reserved. This program and the accompanying materials are
+ *    made available under the terms of the Apache License, Version 2.0
+ *    which accompanies this distribution, and is available at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Copyright (c) Open Connectivity Foundation and Contributors to AllSeen
+ *    Alliance. All rights reserved.
+ *
+ *    Permission to use, copy, modify, and/or distribute this software for
+ *    any purpose with or without fee is hereby granted, provided that the
+ *    above copyright notice and this permission notice appear in all
+ *    copies.
+ *
+ *    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ *    WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+ *    WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+ *    AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+ *    DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR
+ *    PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ *    TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ *    PERFORMANCE OF THIS SOFTWARE.
+ ******************************************************************************/
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <ajtcl/alljoyn.h>
+#include <ajtcl/aj_util.h>
+#include <ajtcl/aj_debug.h>
+#include <ajtcl/aj_connect.h>
+
+/*
+ * Probes routing nodes on the loopback interface and checks that nodes refusing connections are
+ * not selected.
+ */
+
+static int Listen(uint16_t* port)
+{
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if ((sock < 0) || (bind(sock, (struct sockaddr*)&addr, sizeof(addr)) < 0) || (listen(sock, 4) < 0)) {
+        return -1;
+    }
+    getsockname(sock, (struct sockaddr*)&addr, &len);
+    *port = ntohs(addr.sin_port);
+    return sock;
+}
+
+static void InitService(AJ_Service* service, uint16_t port, uint16_t priority)
+{
+    memset(service, 0, sizeof(AJ_Service));
+    service->addrTypes = AJ_ADDR_TCP4;
+    service->ipv4 = htonl(INADDR_LOOPBACK);
+    service->ipv4port = port;
+    service->priority = priority;
+    service->pv = 12;
+}
+
+int AJ_Main(void)
+{
+    AJ_Service near;
+    AJ_Service far;
+    AJ_Service down;
+    AJ_Service selected;
+    uint16_t nearPort;
+    uint16_t farPort;
+    uint16_t downPort;
+    int nearSock;
+    int farSock;
+    int downSock;
+
+    AJ_Initialize();
+    nearSock = Listen(&nearPort);
+    farSock = Listen(&farPort);
+    downSock = Listen(&downPort);
+    if ((nearSock < 0) || (farSock < 0) || (downSock < 0)) {
+        AJ_AlwaysPrintf(("Could not listen on loopback\n"));
+        goto ErrorExit;
+    }
+    /*
+     * Closing the listener makes connections to the port refused
+     */
+    close(downSock);
+
+    InitService(&near, nearPort, 100);
+    InitService(&far, farPort, 200);
+    InitService(&down, downPort, 1);
+    AJ_InitRoutingNodeResponselist();
+    AJ_AddRoutingNodeToResponseList(&far);
+    AJ_AddRoutingNodeToResponseList(&down);
+    AJ_AddRoutingNodeToResponseList(&near);
+    if (AJ_ProbeRoutingNodeResponseList(1000) != AJ_OK) {
+        AJ_AlwaysPrintf(("Probe failed\n"));
+        goto ErrorExit;
+    }
+    if ((AJ_SelectRoutingNodeFromResponseList(&selected) != AJ_OK) || (selected.ipv4port != nearPort)) {
+        AJ_AlwaysPrintf(("Expected the nearest reachable routing node\n"));
+        goto ErrorExit;
+    }
+    if ((AJ_SelectRoutingNodeFromResponseList(&selected) != AJ_OK) || (selected.ipv4port != farPort)) {
+        AJ_AlwaysPrintf(("Expected the other reachable routing node\n"));
+        goto ErrorExit;
+    }
+    if (AJ_SelectRoutingNodeFromResponseList(&selected) != AJ_ERR_END_OF_DATA) {
+        AJ_AlwaysPrintf(("Unreachable routing node was selected\n"));
+        goto ErrorExit;
+    }
+    /*
+     * When nothing answers the list is left alone
+     */
+    close(nearSock);
+    close(farSock);
+    AJ_InitRoutingNodeResponselist();
+    AJ_AddRoutingNodeToResponseList(&far);
+    AJ_AddRoutingNodeToResponseList(&down);
+    if (AJ_ProbeRoutingNodeResponseList(1000) == AJ_OK) {
+        AJ_AlwaysPrintf(("Probe of unreachable routing nodes succeeded\n"));
+        goto ErrorExit;
+    }
+    if ((AJ_SelectRoutingNodeFromResponseList(&selected) != AJ_OK) || (selected.ipv4port != downPort)) {
+        AJ_AlwaysPrintf(("Expected selection by priority\n"));
+        goto ErrorExit;
+    }
+    AJ_InitRoutingNodeResponselist();
+
+    AJ_AlwaysPrintf(("Routing node probe test PASSED\n"));
+    return 0;
+
+ErrorExit:
+
+    AJ_AlwaysPrintf(("Routing node probe test FAILED\n"));
+    return 1;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
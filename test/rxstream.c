@@ -0,0 +1,322 @@
+/**
+ * @file
+ */
+/******************************************************************************
+ *    Copyright (c) Open Connectivity Foundation (OCF), AllJoyn Open Source
+ *    Project (AJOSP) Contributors and others.
+ *
+ *    SPDX-License-Identifier: Apache-2.0
+ *
+ *    All rights reserved. This program and the accompanying materials are
+ *    made available under the terms of the Apache License, Version 2.0
+ *    which accompanies this distribution, and is available at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Copyright (c) Open Connectivity Foundation and Contributors to AllSeen
+ *    Alliance. All rights reserved.
+ *
+ *    Permission to use, copy, modify, and/or distribute this software for
+ *    any purpose with or without fee is hereby granted, provided that the
+ *    above copyright notice and this permission notice appear in all
+ *    copies.
+ *
+ *    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ *    WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+ *    WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+ *    AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+ *    DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR
+ *    PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ *    TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ *    PERFORMANCE OF THIS SOFTWARE.
+ ******************************************************************************/
+
+#include <ajtcl/alljoyn.h>
+#include <ajtcl/aj_util.h>
+#include <ajtcl/aj_debug.h>
+#include <ajtcl/aj_bufio.h>
+#include <ajtcl/aj_guid.h>
+
+/*
+ * Checks that messages larger than the receive buffer can be unmarshaled with the large arrays
+ * loaded in chunks, with and without encryption, that a replayed encrypted message is rejected
+ * before it is returned and that tampering with an encrypted message that is decrypted as it is
+ * loaded is detected when the message is closed. Large encrypted messages are only delivered to
+ * objects that have the AJ_OBJ_FLAG_STREAMED flag set.
+ */
+
+#define WIRE_SIZE (32 * 1024)
+
+static uint8_t Wire[WIRE_SIZE];
+static size_t WireBytes;
+static size_t WirePos;
+
+static uint8_t TxBuffer[WIRE_SIZE];
+static uint8_t RxBuffer[512];
+
+static uint8_t Blob8[6001];
+static uint16_t Blob16[1501];
+static double Doubles[300];
+
+static const char* const Sender = ":sender.1";
+static const char* const Destination = ":dest.1";
+
+static AJ_Status TxFunc(AJ_IOBuffer* buf)
+{
+    size_t tx = AJ_IO_BUF_AVAIL(buf);
+
+    if ((WireBytes + tx) > sizeof(Wire)) {
+        return AJ_ERR_WRITE;
+    }
+    memcpy(Wire + WireBytes, buf->readPtr, tx);
+    WireBytes += tx;
+    AJ_IO_BUF_RESET(buf);
+    return AJ_OK;
+}
+
+/*
+ * Deliver the wire bytes in uneven pieces
+ */
+static AJ_Status RxFunc(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
+{
+    size_t rx = min(len, AJ_IO_BUF_SPACE(buf));
+
+    rx = min(rx, WireBytes - WirePos);
+    rx = min(rx, 100 + (WirePos % 233));
+    if (!rx) {
+        return AJ_ERR_TIMEOUT;
+    }
+    memcpy(buf->writePtr, Wire + WirePos, rx);
+    buf->writePtr += rx;
+    WirePos += rx;
+    return AJ_OK;
+}
+
+/*
+ * Messages on the peer authentication interface are not subject to access control
+ */
+static const char* const TestIface[] = { "org.alljoyn.Bus.Peer.Authentication", "!blobs >y >ay >u >aq >s >ad", NULL };
+
+static const AJ_InterfaceDescription TestInterfaces[] = {
+    TestIface,
+    NULL
+};
+
+static AJ_Object AppObjects[] = {
+    { "/test/rxstream", TestInterfaces, AJ_OBJ_FLAG_STREAMED },
+    { NULL }
+};
+
+#define BLOBS_SIGNAL AJ_APP_MESSAGE_ID(0, 0, 0)
+
+static AJ_Status SendMsg(AJ_BusAttachment* bus, uint8_t flags)
+{
+    AJ_Status status;
+    AJ_Message msg;
+
+    AJ_IOBufInit(&bus->sock.tx, TxBuffer, sizeof(TxBuffer), AJ_IO_BUF_TX, NULL);
+    bus->sock.tx.send = TxFunc;
+    WireBytes = 0;
+
+    status = AJ_MarshalSignal(bus, &msg, BLOBS_SIGNAL, Destination, 0, flags, 0);
+    if (status == AJ_OK) {
+        status = AJ_MarshalArgs(&msg, "yayuaqsad", 0x55, Blob8, sizeof(Blob8), 0x12345678, Blob16, sizeof(Blob16),
+                                "after the blobs", Doubles, sizeof(Doubles));
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    return status;
+}
+
+/*
+ * Unmarshal an array in chunks and compare it with the array that was sent
+ */
+static AJ_Status CheckChunks(AJ_Message* msg, uint8_t typeId, const void* expect, size_t expectLen)
+{
+    AJ_Status status;
+    const void* data;
+    size_t len;
+    size_t offset = 0;
+    uint32_t chunks = 0;
+
+    while ((status = AJ_UnmarshalArrayChunk(msg, typeId, &data, &len)) == AJ_OK) {
+        if (((offset + len) > expectLen) || (memcmp((const uint8_t*)expect + offset, data, len) != 0)) {
+            AJ_AlwaysPrintf(("Array '%c' mismatch at offset %u\n", typeId, (uint32_t)offset));
+            return AJ_ERR_FAILURE;
+        }
+        offset += len;
+        ++chunks;
+    }
+    if (status != AJ_ERR_NO_MORE) {
+        AJ_AlwaysPrintf(("Array '%c' unmarshal failed %s\n", typeId, AJ_StatusText(status)));
+        return status;
+    }
+    if (offset != expectLen) {
+        AJ_AlwaysPrintf(("Array '%c' short %u bytes expected %u\n", typeId, (uint32_t)offset, (uint32_t)expectLen));
+        return AJ_ERR_FAILURE;
+    }
+    AJ_AlwaysPrintf(("Array '%c' %u bytes in %u chunks\n", typeId, (uint32_t)offset, chunks));
+    return AJ_OK;
+}
+
+static AJ_Status RecvMsg(AJ_BusAttachment* bus, uint8_t checkArgs)
+{
+    AJ_Status status;
+    AJ_Message msg;
+    uint8_t y = 0;
+    uint32_t u = 0;
+    const char* str = NULL;
+
+    AJ_IOBufInit(&bus->sock.rx, RxBuffer, sizeof(RxBuffer), AJ_IO_BUF_RX, NULL);
+    bus->sock.rx.recv = RxFunc;
+    WirePos = 0;
+
+    status = AJ_UnmarshalMsg(bus, &msg, 1000);
+    if (status != AJ_OK) {
+        AJ_AlwaysPrintf(("Unmarshal failed %s\n", AJ_StatusText(status)));
+        return status;
+    }
+    if (msg.msgId != BLOBS_SIGNAL) {
+        AJ_AlwaysPrintf(("Unexpected message id %08x\n", msg.msgId));
+        AJ_CloseMsg(&msg);
+        return AJ_ERR_FAILURE;
+    }
+    if (checkArgs) {
+        status = AJ_UnmarshalArgs(&msg, "y", &y);
+        if ((status == AJ_OK) && (y != 0x55)) {
+            status = AJ_ERR_FAILURE;
+        }
+        if (status == AJ_OK) {
+            status = CheckChunks(&msg, AJ_ARG_BYTE, Blob8, sizeof(Blob8));
+        }
+        if (status == AJ_OK) {
+            status = AJ_UnmarshalArgs(&msg, "u", &u);
+            if ((status == AJ_OK) && (u != 0x12345678)) {
+                status = AJ_ERR_FAILURE;
+            }
+        }
+        if (status == AJ_OK) {
+            status = CheckChunks(&msg, AJ_ARG_UINT16, Blob16, sizeof(Blob16));
+        }
+        if (status == AJ_OK) {
+            status = AJ_UnmarshalArgs(&msg, "s", &str);
+            if ((status == AJ_OK) && (strcmp(str, "after the blobs") != 0)) {
+                status = AJ_ERR_FAILURE;
+            }
+        }
+        if (status == AJ_OK) {
+            status = CheckChunks(&msg, AJ_ARG_DOUBLE, Doubles, sizeof(Doubles));
+        }
+        if (status != AJ_OK) {
+            AJ_AlwaysPrintf(("Argument check failed %s\n", AJ_StatusText(status)));
+            AJ_CloseMsg(&msg);
+            return status;
+        }
+    }
+    return AJ_CloseMsg(&msg);
+}
+
+int AJ_Main(void)
+{
+    AJ_BusAttachment bus;
+    AJ_GUID guid;
+    uint8_t key[AJ_SESSION_KEY_LEN];
+    AJ_Status status;
+    size_t i;
+
+    AJ_Initialize();
+    AJ_RegisterObjects(AppObjects, NULL);
+    memset(&bus, 0, sizeof(bus));
+    strcpy(bus.uniqueName, Sender);
+    bus.serial = 1;
+
+    for (i = 0; i < ArraySize(Blob8); ++i) {
+        Blob8[i] = (uint8_t)(i * 7);
+    }
+    for (i = 0; i < ArraySize(Blob16); ++i) {
+        Blob16[i] = (uint16_t)(i * 31);
+    }
+    for (i = 0; i < ArraySize(Doubles); ++i) {
+        Doubles[i] = i * 1.5;
+    }
+
+    if ((SendMsg(&bus, 0) != AJ_OK) || (RecvMsg(&bus, TRUE) != AJ_OK)) {
+        goto ErrorExit;
+    }
+    /*
+     * Skipping the arguments of a large message must also work
+     */
+    if ((SendMsg(&bus, 0) != AJ_OK) || (RecvMsg(&bus, FALSE) != AJ_OK)) {
+        goto ErrorExit;
+    }
+    /*
+     * Encrypted with a session key shared by the sender and the destination. Authentication
+     * version 0 has no extra nonce so the message can be decrypted as it is loaded.
+     */
+    memset(key, 0x22, sizeof(key));
+    memset(&guid, 0x11, sizeof(guid));
+    if ((AJ_GUID_AddNameMapping(NULL, &guid, Destination, NULL) != AJ_OK) || (AJ_SetSessionKey(Destination, key, 1, 0) != AJ_OK)) {
+        AJ_AlwaysPrintf(("Failed to set session key\n"));
+        goto ErrorExit;
+    }
+    memset(&guid, 0x33, sizeof(guid));
+    if ((AJ_GUID_AddNameMapping(NULL, &guid, Sender, NULL) != AJ_OK) || (AJ_SetSessionKey(Sender, key, 2, 0) != AJ_OK)) {
+        AJ_AlwaysPrintf(("Failed to set session key\n"));
+        goto ErrorExit;
+    }
+    if ((SendMsg(&bus, AJ_FLAG_ENCRYPTED) != AJ_OK) || (RecvMsg(&bus, TRUE) != AJ_OK)) {
+        goto ErrorExit;
+    }
+    if ((SendMsg(&bus, AJ_FLAG_ENCRYPTED) != AJ_OK) || (RecvMsg(&bus, FALSE) != AJ_OK)) {
+        goto ErrorExit;
+    }
+    /*
+     * A replayed message must be rejected before it is returned and one that was tampered with must
+     * be rejected when it is closed
+     */
+    status = RecvMsg(&bus, FALSE);
+    if (status != AJ_ERR_INVALID) {
+        AJ_AlwaysPrintf(("Replay not detected %s\n", AJ_StatusText(status)));
+        goto ErrorExit;
+    }
+    if (SendMsg(&bus, AJ_FLAG_ENCRYPTED) != AJ_OK) {
+        goto ErrorExit;
+    }
+    Wire[WireBytes - 100] ^= 1;
+    status = RecvMsg(&bus, FALSE);
+    if (status != AJ_ERR_SECURITY) {
+        AJ_AlwaysPrintf(("Tampering not detected %s\n", AJ_StatusText(status)));
+        goto ErrorExit;
+    }
+    /*
+     * Large encrypted messages to objects that have not opted in are discarded but large plain
+     * messages are still delivered
+     */
+    AJ_SetObjectFlags(AppObjects[0].path, 0, AJ_OBJ_FLAG_STREAMED);
+    if (SendMsg(&bus, AJ_FLAG_ENCRYPTED) != AJ_OK) {
+        goto ErrorExit;
+    }
+    status = RecvMsg(&bus, FALSE);
+    if (status != AJ_ERR_RESOURCES) {
+        AJ_AlwaysPrintf(("Streamed message not discarded %s\n", AJ_StatusText(status)));
+        goto ErrorExit;
+    }
+    if ((SendMsg(&bus, 0) != AJ_OK) || (RecvMsg(&bus, TRUE) != AJ_OK)) {
+        goto ErrorExit;
+    }
+
+    AJ_AlwaysPrintf(("Streaming unmarshal test PASSED\n"));
+    return 0;
+
+ErrorExit:
+
+    AJ_AlwaysPrintf(("Streaming unmarshal test FAILED\n"));
+    return 1;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
@@ -0,0 +1,489 @@
+/**
+ * @file
+ */
+/******************************************************************************
+ *    Copyright (c) Open Connectivity Foundation (OCF), AllJoyn Open Source
+ *    Project (AJOSP) Contributors and others.
+ *
+ *    SPDX-License-Identifier: Apache-2.0
+ *
+ *    All rights reserved. This program and the accompanying materials are
+ *    made available under the terms of the Apache License, Version 2.0
+ *    which accompanies this distribution, and is available at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Copyright (c) Open Connectivity Foundation and Contributors to AllSeen
+ *    Alliance. All rights reserved.
+ *
+ *    Permission to use, copy, modify, and/or distribute this software for
+ *    any purpose with or without fee is hereby granted, provided that the
+ *    above copyright notice and this permission notice appear in all
+ *    copies.
+ *
+ *    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ *    WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+ *    WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+ *    AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+ *    DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR
+ *    PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ *    TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ *    PERFORMANCE OF THIS SOFTWARE.
+ ******************************************************************************/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <sys/wait.h>
+
+#include <ajtcl/alljoyn.h>
+#include <ajtcl/aj_crc16.h>
+#include <ajtcl/aj_serial.h>
+#include <ajtcl/aj_serio.h>
+#include <ajtcl/aj_debug.h>
+
+/*
+ * Checks the CRC16 and SLIP scanner fast paths against byte at a time references, measures them
+ * and then runs the SLAP link between two processes over a pair of ptys. A bridge process copies
+ * bytes between the pty masters and, to emulate a real UART, paces them at the configured bit rate.
+ * It can also drop bytes so the link has to recover lost packets.
+ */
+
+#define BIT_RATE        3000000
+#define WINDOW_SIZE     4
+#define LARGE_WINDOW    16
+#define PACKET_SIZE     1000
+#define LINK_BYTES      (128 * 1024)
+#define LINK_TIMEOUT    (30 * 1000)
+#define BENCH_BYTES     (32 * 1024)
+#define BENCH_LOOPS     1000
+
+/*
+ * Bytes the bridge may forward back to back, about what a UART FIFO would burst
+ */
+#define BRIDGE_BURST    256
+
+/*
+ * One byte in this many is dropped on a lossy link
+ */
+#define LOSS_INTERVAL   20000
+
+static uint8_t data[BENCH_BYTES];
+static uint8_t linkBuf[8192];
+
+static uint16_t RefCRC16(const uint8_t* buf, size_t len, uint16_t crc)
+{
+    int i;
+
+    while (len--) {
+        crc ^= *buf++;
+        for (i = 0; i < 8; ++i) {
+            crc = (crc & 1) ? ((crc >> 1) ^ 0x8408) : (crc >> 1);
+        }
+    }
+    return crc;
+}
+
+static uint16_t RefSlipScan(const uint8_t* buf, uint16_t len)
+{
+    uint16_t i;
+
+    for (i = 0; i < len; ++i) {
+        if ((buf[i] == BOUNDARY_BYTE) || (buf[i] == ESCAPE_BYTE)) {
+            break;
+        }
+    }
+    return i;
+}
+
+/*
+ * Every byte value turns up and every 64th byte or so needs escaping
+ */
+static uint8_t Pattern(uint32_t i)
+{
+    return (uint8_t)((i * 7) + (i >> 8));
+}
+
+static uint64_t NowUs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int OpenPty(char* slave, size_t len)
+{
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+
+    if ((fd < 0) || (grantpt(fd) < 0) || (unlockpt(fd) < 0) || ptsname_r(fd, slave, len)) {
+        return -1;
+    }
+    return fd;
+}
+
+/*
+ * Put the slave in raw mode before either end of the link opens it so nothing is echoed back
+ */
+static int RawSlave(const char* slave)
+{
+    struct termios tio;
+    int fd = open(slave, O_RDWR | O_NOCTTY);
+
+    if ((fd < 0) || (tcgetattr(fd, &tio) < 0)) {
+        return -1;
+    }
+    cfmakeraw(&tio);
+    if (tcsetattr(fd, TCSANOW, &tio) < 0) {
+        return -1;
+    }
+    return fd;
+}
+
+typedef struct {
+    int from;
+    int to;
+    uint8_t buf[4096];
+    size_t len;
+    size_t off;
+    uint64_t credit;
+    uint32_t count;
+} Pipe;
+
+/*
+ * Copies bytes between the two pty masters until killed. With a non-zero bit rate each direction
+ * earns bitRate / 10 bytes per second of credit, ten bits per byte on the wire. With a non-zero
+ * loss interval every loss'th byte in each direction is dropped.
+ */
+static void Bridge(int a, int b, uint32_t bitRate, uint32_t loss)
+{
+    static Pipe pipes[2];
+    uint64_t last = NowUs();
+    int i;
+
+    fcntl(a, F_SETFL, O_NONBLOCK);
+    fcntl(b, F_SETFL, O_NONBLOCK);
+    pipes[0].from = a;
+    pipes[0].to = b;
+    pipes[1].from = b;
+    pipes[1].to = a;
+    while (1) {
+        struct pollfd pfd[2];
+        uint64_t now = NowUs();
+
+        for (i = 0; i < 2; ++i) {
+            pipes[i].credit += (now - last) * (bitRate / 10);
+            if (pipes[i].credit > (uint64_t)BRIDGE_BURST * 1000000) {
+                pipes[i].credit = (uint64_t)BRIDGE_BURST * 1000000;
+            }
+        }
+        last = now;
+        pfd[0].fd = a;
+        pfd[1].fd = b;
+        pfd[0].events = pfd[1].events = 0;
+        for (i = 0; i < 2; ++i) {
+            Pipe* p = &pipes[i];
+            if (p->len) {
+                pfd[1 - i].events |= POLLOUT;
+            } else if (!bitRate || (p->credit >= 1000000)) {
+                pfd[i].events |= POLLIN;
+            }
+        }
+        poll(pfd, 2, 1);
+        for (i = 0; i < 2; ++i) {
+            Pipe* p = &pipes[i];
+            ssize_t n;
+            if (!p->len && (pfd[i].revents & POLLIN)) {
+                size_t max = sizeof(p->buf);
+                if (bitRate && (p->credit / 1000000 < max)) {
+                    max = (size_t)(p->credit / 1000000);
+                }
+                n = read(p->from, p->buf, max);
+                if (n > 0) {
+                    p->len = (size_t)n;
+                    p->off = 0;
+                    if (bitRate) {
+                        p->credit -= (uint64_t)n * 1000000;
+                    }
+                    if (loss && ((p->count + (uint32_t)n) / loss != p->count / loss)) {
+                        size_t drop = loss - 1 - (p->count % loss);
+                        memmove(p->buf + drop, p->buf + drop + 1, p->len - drop - 1);
+                        --p->len;
+                    }
+                    p->count += (uint32_t)n;
+                }
+            }
+            if (p->len) {
+                n = write(p->to, p->buf + p->off, p->len - p->off);
+                if (n > 0) {
+                    p->off += (size_t)n;
+                    if (p->off == p->len) {
+                        p->len = 0;
+                    }
+                }
+            }
+        }
+    }
+}
+
+/*
+ * The far end of the link: receives LINK_BYTES, checks them and replies with the number of bad bytes
+ */
+static int Receiver(const char* tty, uint8_t window)
+{
+    uint32_t total = 0;
+    uint32_t bad = 0;
+    uint8_t reply[4];
+    AJ_Status status;
+    uint16_t i;
+
+    status = AJ_SerialInit(tty, BIT_RATE, window, PACKET_SIZE);
+    if (status != AJ_OK) {
+        return 1;
+    }
+    while (total < LINK_BYTES) {
+        uint16_t recv = 0;
+        uint16_t want = (uint16_t)min(sizeof(linkBuf), LINK_BYTES - total);
+        status = AJ_SerialRecv(linkBuf, want, LINK_TIMEOUT, &recv);
+        if (status != AJ_OK) {
+            AJ_AlwaysPrintf(("Receiver: AJ_SerialRecv %s after %u bytes\n", AJ_StatusText(status), total));
+            return 1;
+        }
+        for (i = 0; i < recv; ++i) {
+            if (linkBuf[i] != Pattern(total + i)) {
+                ++bad;
+            }
+        }
+        total += recv;
+    }
+    reply[0] = (uint8_t)(bad >> 24);
+    reply[1] = (uint8_t)(bad >> 16);
+    reply[2] = (uint8_t)(bad >> 8);
+    reply[3] = (uint8_t)bad;
+    AJ_SerialSend(reply, sizeof(reply));
+    /*
+     * Keep the state machine running until the reply has been acknowledged
+     */
+    AJ_SerialRecv(linkBuf, 1, 500, NULL);
+    return 0;
+}
+
+static AJ_Status RunLink(uint32_t bitRate, uint8_t window, uint32_t loss)
+{
+    AJ_Status status = AJ_ERR_DRIVER;
+    char slaveA[64];
+    char slaveB[64];
+    int masterA = OpenPty(slaveA, sizeof(slaveA));
+    int masterB = OpenPty(slaveB, sizeof(slaveB));
+    pid_t bridge = -1;
+    pid_t peer = -1;
+    int peerStatus;
+    uint8_t reply[4];
+    uint16_t recv = 0;
+    uint32_t sent;
+    uint32_t bad;
+    AJ_Time timer;
+    uint32_t elapsed;
+
+    if ((masterA < 0) || (masterB < 0) || (RawSlave(slaveA) < 0) || (RawSlave(slaveB) < 0)) {
+        AJ_AlwaysPrintf(("Could not set up ptys\n"));
+        return AJ_ERR_DRIVER;
+    }
+    bridge = fork();
+    if (bridge == 0) {
+        Bridge(masterA, masterB, bitRate, loss);
+        exit(0);
+    }
+    peer = fork();
+    if (peer == 0) {
+        exit(Receiver(slaveB, window));
+    }
+    if ((bridge < 0) || (peer < 0)) {
+        goto Exit;
+    }
+
+    status = AJ_SerialInit(slaveA, BIT_RATE, window, PACKET_SIZE);
+    if (status != AJ_OK) {
+        goto Exit;
+    }
+    AJ_InitTimer(&timer);
+    while (AJ_SerialLinkParams.linkState != AJ_LINK_ACTIVE) {
+        if (AJ_GetElapsedTime(&timer, TRUE) > LINK_TIMEOUT) {
+            AJ_AlwaysPrintf(("Link did not come up\n"));
+            status = AJ_ERR_TIMEOUT;
+            goto Exit;
+        }
+        AJ_StateMachine();
+    }
+
+    AJ_InitTimer(&timer);
+    for (sent = 0; sent < LINK_BYTES; sent += sizeof(linkBuf)) {
+        uint32_t i;
+        for (i = 0; i < sizeof(linkBuf); ++i) {
+            linkBuf[i] = Pattern(sent + i);
+        }
+        status = AJ_SerialSend(linkBuf, sizeof(linkBuf));
+        if (status != AJ_OK) {
+            goto Exit;
+        }
+    }
+    status = AJ_SerialRecv(reply, sizeof(reply), LINK_TIMEOUT, &recv);
+    elapsed = AJ_GetElapsedTime(&timer, TRUE);
+    if ((status != AJ_OK) || (recv != sizeof(reply))) {
+        AJ_AlwaysPrintf(("No reply from the receiver\n"));
+        status = AJ_ERR_TIMEOUT;
+        goto Exit;
+    }
+    bad = ((uint32_t)reply[0] << 24) | ((uint32_t)reply[1] << 16) | ((uint32_t)reply[2] << 8) | reply[3];
+    if (bad) {
+        AJ_AlwaysPrintf(("Receiver got %u corrupted bytes\n", bad));
+        status = AJ_ERR_FAILURE;
+        goto Exit;
+    }
+    if (bitRate) {
+        AJ_AlwaysPrintf(("%u bytes at %u baud window %u%s in %u ms, %u KB/s of %u KB/s line rate\n", LINK_BYTES, bitRate,
+                         AJ_SerialLinkParams.windowSize, loss ? " lossy" : "", elapsed, LINK_BYTES / max(elapsed, 1), bitRate / 10 / 1000));
+    } else {
+        AJ_AlwaysPrintf(("%u bytes over unpaced pty window %u in %u ms, %u KB/s\n", LINK_BYTES, AJ_SerialLinkParams.windowSize,
+                         elapsed, LINK_BYTES / max(elapsed, 1)));
+    }
+
+Exit:
+    AJ_SerialShutdown();
+    AJ_SerialIOShutdown();
+    if (peer > 0) {
+        if ((waitpid(peer, &peerStatus, 0) != peer) || !WIFEXITED(peerStatus) || WEXITSTATUS(peerStatus)) {
+            AJ_AlwaysPrintf(("Receiver failed\n"));
+            status = AJ_ERR_FAILURE;
+        }
+    }
+    if (bridge > 0) {
+        kill(bridge, SIGKILL);
+        waitpid(bridge, NULL, 0);
+    }
+    close(masterA);
+    close(masterB);
+    return status;
+}
+
+int AJ_Main(void)
+{
+    AJ_Time timer;
+    uint32_t elapsed;
+    uint32_t i;
+    uint32_t n;
+    uint16_t crc;
+
+    AJ_Initialize();
+
+    /*
+     * CRC16 against the bitwise definition, for every alignment and split of the running CRC
+     */
+    srand(1);
+    for (i = 0; i < sizeof(data); ++i) {
+        data[i] = (uint8_t)rand();
+    }
+    for (n = 0; n < 2000; ++n) {
+        uint16_t off = (uint16_t)(rand() % 64);
+        uint16_t len = (uint16_t)(rand() % 600);
+        uint16_t split = (uint16_t)(rand() % (len + 1));
+        crc = AJ_SERIAL_CRC_INIT;
+        AJ_CRC16_Compute(data + off, split, &crc);
+        AJ_CRC16_Compute(data + off + split, len - split, &crc);
+        if (crc != RefCRC16(data + off, len, AJ_SERIAL_CRC_INIT)) {
+            AJ_AlwaysPrintf(("CRC16 mismatch len %u split %u\n", len, split));
+            goto ErrorExit;
+        }
+    }
+
+    /*
+     * SLIP scanner against a byte at a time scan with specials at every position
+     */
+    for (n = 0; n < 20000; ++n) {
+        uint8_t buf[80];
+        uint16_t off = (uint16_t)(rand() % 8);
+        uint16_t len = (uint16_t)(rand() % (sizeof(buf) - off));
+        for (i = 0; i < sizeof(buf); ++i) {
+            uint32_t r = rand() % 64;
+            buf[i] = (r == 0) ? BOUNDARY_BYTE : (r == 1) ? ESCAPE_BYTE : (r == 2) ? ESCAPE_SUBSTITUTE : (uint8_t)rand();
+        }
+        if (AJ_SlipScan(buf + off, len) != RefSlipScan(buf + off, len)) {
+            AJ_AlwaysPrintf(("SLIP scan mismatch len %u\n", len));
+            goto ErrorExit;
+        }
+    }
+
+    /*
+     * Raw speed of the fast paths compared with the byte at a time loops they replace
+     */
+    crc = AJ_SERIAL_CRC_INIT;
+    AJ_InitTimer(&timer);
+    for (n = 0; n < BENCH_LOOPS; ++n) {
+        AJ_CRC16_Compute(data, sizeof(data), &crc);
+    }
+    elapsed = AJ_GetElapsedTime(&timer, TRUE);
+    AJ_AlwaysPrintf(("CRC16: %u KB in %u ms\n", BENCH_LOOPS * (uint32_t)sizeof(data) / 1024, elapsed));
+
+    for (i = 0; i < sizeof(data); ++i) {
+        data[i] = Pattern(i);
+    }
+    n = 0;
+    AJ_InitTimer(&timer);
+    for (i = 0; i < BENCH_LOOPS; ++i) {
+        uint32_t pos = 0;
+        while (pos < sizeof(data)) {
+            uint32_t len = min(PACKET_SIZE, BENCH_BYTES - pos);
+            pos += AJ_SlipScan(data + pos, (uint16_t)len) + 1;
+            ++n;
+        }
+    }
+    elapsed = AJ_GetElapsedTime(&timer, TRUE);
+    AJ_AlwaysPrintf(("SLIP scan: %u KB in %u ms, %u runs\n", BENCH_LOOPS * (uint32_t)sizeof(data) / 1024, elapsed, n));
+
+    n = 0;
+    AJ_InitTimer(&timer);
+    for (i = 0; i < BENCH_LOOPS; ++i) {
+        uint32_t pos = 0;
+        while (pos < sizeof(data)) {
+            uint32_t len = min(PACKET_SIZE, BENCH_BYTES - pos);
+            pos += RefSlipScan(data + pos, (uint16_t)len) + 1;
+            ++n;
+        }
+    }
+    elapsed = AJ_GetElapsedTime(&timer, TRUE);
+    AJ_AlwaysPrintf(("Byte at a time scan: %u KB in %u ms, %u runs\n", BENCH_LOOPS * (uint32_t)sizeof(data) / 1024, elapsed, n));
+
+    /*
+     * The SLAP link end to end, first as fast as the ptys go then paced like a 3 Mbaud UART with
+     * the legacy window, a large window and a large window on a link that loses packets
+     */
+    if (RunLink(0, WINDOW_SIZE, 0) != AJ_OK) {
+        goto ErrorExit;
+    }
+    if (RunLink(BIT_RATE, WINDOW_SIZE, 0) != AJ_OK) {
+        goto ErrorExit;
+    }
+    if (RunLink(BIT_RATE, LARGE_WINDOW, 0) != AJ_OK) {
+        goto ErrorExit;
+    }
+    if (RunLink(BIT_RATE, LARGE_WINDOW, LOSS_INTERVAL) != AJ_OK) {
+        goto ErrorExit;
+    }
+
+    AJ_AlwaysPrintf(("Serial benchmark PASSED\n"));
+    return 0;
+
+ErrorExit:
+
+    AJ_AlwaysPrintf(("Serial benchmark FAILED\n"));
+    return 1;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
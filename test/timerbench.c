@@ -0,0 +1,203 @@
+/**
+ * @file
+ */
+/******************************************************************************
+ *    Copyright (c) Open Connectivity Foundation (OCF), AllJoyn Open Source
+ *    Project (AJOSP) Contributors and others.
+ *
+ *    SPDX-License-Identifier: Apache-2.0
+ *
+ *    All rights reserved. This program and the accompanying materials are
+ *    made available under the terms of the Apache License, Version 2.0
+ *    which accompanies this distribution, and is available at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Copyright (c) Open Connectivity Foundation and Contributors to AllSeen
+ *    Alliance. All rights reserved.
+ *
+ *    Permission to use, copy, modify, and/or distribute this software for
+ *    any purpose with or without fee is hereby granted, provided that the
+ *    above copyright notice and this permission notice appear in all
+ *    copies.
+ *
+ *    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ *    WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+ *    WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+ *    AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+ *    DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR
+ *    PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ *    TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ *    PERFORMANCE OF THIS SOFTWARE.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <ajtcl/alljoyn.h>
+#include <ajtcl/aj_helper.h>
+#include <ajtcl/aj_debug.h>
+
+/*
+ * Checks the timer ordering and measures the cost of setting, cancelling and firing timers.
+ */
+
+#define NUM_TIMERS      ((AJ_MAX_TIMERS > 1000) ? 1000 : AJ_MAX_TIMERS)
+#define NUM_ITERATIONS  200
+
+static uint32_t TimerIds[NUM_TIMERS];
+static uint32_t Expiry[NUM_TIMERS];
+static uint32_t LastExpiry;
+static uint32_t Fired;
+static uint8_t OutOfOrder;
+
+static void OrderHandler(void* context)
+{
+    uint32_t expiry = Expiry[(size_t)context];
+    if (expiry < LastExpiry) {
+        OutOfOrder = TRUE;
+    }
+    LastExpiry = expiry;
+    ++Fired;
+}
+
+static void CountHandler(void* context)
+{
+    ++Fired;
+}
+
+static void CancelHandler(void* context)
+{
+    /*
+     * Cancels another pending timer and replaces it with one that is due immediately
+     */
+    AJ_CancelTimer(*(uint32_t*)context);
+    *(uint32_t*)context = AJ_SetTimer(0, CountHandler, NULL, 0);
+    ++Fired;
+}
+
+static void CancelAll(void)
+{
+    size_t i;
+    for (i = 0; i < NUM_TIMERS; ++i) {
+        if (TimerIds[i]) {
+            AJ_CancelTimer(TimerIds[i]);
+            TimerIds[i] = 0;
+        }
+    }
+}
+
+int AJ_Main(void)
+{
+    AJ_Time timer;
+    size_t i;
+    size_t n;
+    uint32_t setTime;
+    uint32_t cancelTime;
+    uint32_t fireTime;
+
+    AJ_Initialize();
+
+    /*
+     * Timers set in random order must fire in order of expiry
+     */
+    for (i = 0; i < NUM_TIMERS; ++i) {
+        Expiry[i] = rand() % 50;
+        TimerIds[i] = AJ_SetTimer(Expiry[i], OrderHandler, (void*)i, 0);
+        if (!TimerIds[i]) {
+            AJ_AlwaysPrintf(("AJ_SetTimer failed for timer %u\n", (unsigned)i));
+            goto ErrorExit;
+        }
+    }
+    /*
+     * Cancel every third timer
+     */
+    for (i = 0; i < NUM_TIMERS; i += 3) {
+        AJ_CancelTimer(TimerIds[i]);
+    }
+    AJ_Sleep(60);
+    if (AJ_RunExpiredTimers() != (uint32_t)AJ_TIMER_FOREVER) {
+        AJ_AlwaysPrintf(("Timers still pending after all expired\n"));
+        goto ErrorExit;
+    }
+    if (OutOfOrder || (Fired != (NUM_TIMERS - (NUM_TIMERS + 2) / 3))) {
+        AJ_AlwaysPrintf(("Timers fired out of order or wrong count %u\n", Fired));
+        goto ErrorExit;
+    }
+    memset(TimerIds, 0, sizeof(TimerIds));
+
+    /*
+     * Handlers can cancel and set timers
+     */
+    Fired = 0;
+    TimerIds[1] = AJ_SetTimer(1000, CountHandler, NULL, 0);
+    TimerIds[0] = AJ_SetTimer(0, CancelHandler, &TimerIds[1], 0);
+    AJ_RunExpiredTimers();
+    if (AJ_RunExpiredTimers() != (uint32_t)AJ_TIMER_FOREVER) {
+        AJ_AlwaysPrintf(("Cancelled timer still pending\n"));
+        goto ErrorExit;
+    }
+    if (Fired != 2) {
+        AJ_AlwaysPrintf(("Handler set/cancel fired %u timers\n", Fired));
+        goto ErrorExit;
+    }
+    TimerIds[0] = TimerIds[1] = 0;
+
+    /*
+     * A repeating timer fires once per batch and the next timeout reflects the repeat period
+     */
+    Fired = 0;
+    TimerIds[0] = AJ_SetTimer(0, CountHandler, NULL, 10000);
+    if ((AJ_RunExpiredTimers() > 10000) || (Fired != 1)) {
+        AJ_AlwaysPrintf(("Repeating timer failed\n"));
+        goto ErrorExit;
+    }
+    CancelAll();
+    if (AJ_RunExpiredTimers() != (uint32_t)AJ_TIMER_FOREVER) {
+        AJ_AlwaysPrintf(("Cancelled timer still pending\n"));
+        goto ErrorExit;
+    }
+
+    /*
+     * Throughput
+     */
+    setTime = cancelTime = fireTime = 0;
+    for (n = 0; n < NUM_ITERATIONS; ++n) {
+        AJ_InitTimer(&timer);
+        for (i = 0; i < NUM_TIMERS; ++i) {
+            TimerIds[i] = AJ_SetTimer(1000000 + rand() % 1000, CountHandler, NULL, 0);
+        }
+        setTime += AJ_GetElapsedTime(&timer, FALSE);
+        AJ_InitTimer(&timer);
+        CancelAll();
+        cancelTime += AJ_GetElapsedTime(&timer, FALSE);
+    }
+    Fired = 0;
+    for (n = 0; n < NUM_ITERATIONS; ++n) {
+        for (i = 0; i < NUM_TIMERS; ++i) {
+            AJ_SetTimer(rand() % 2, CountHandler, NULL, 0);
+        }
+        AJ_Sleep(2);
+        AJ_InitTimer(&timer);
+        AJ_RunExpiredTimers();
+        fireTime += AJ_GetElapsedTime(&timer, FALSE);
+    }
+    if (Fired != (NUM_TIMERS * NUM_ITERATIONS)) {
+        AJ_AlwaysPrintf(("Expected %u timers to fire, %u fired\n", NUM_TIMERS * NUM_ITERATIONS, Fired));
+        goto ErrorExit;
+    }
+    AJ_AlwaysPrintf(("%u timers x %u iterations: set %u ms, cancel %u ms, fire %u ms\n", NUM_TIMERS, NUM_ITERATIONS, setTime, cancelTime, fireTime));
+    AJ_AlwaysPrintf(("Timer benchmark PASSED\n"));
+    return 0;
+
+ErrorExit:
+
+    AJ_AlwaysPrintf(("Timer benchmark FAILED\n"));
+    return 1;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif